@@ -0,0 +1,536 @@
+/**
+ * @file    at_replay.c
+ * @brief   Replay a recorded modem session (AT capture) against the host-built MQTT driver
+ *
+ * Usage: at_replay [options] session.cap [out.json]   (default build/at_replay.json)
+ *   -t <ms>        Run length (default: the capture's length + 10 s)
+ *   -p <ms>        Publish interval once connected, 0: none (default 1000)
+ *   -l <bytes>     Publish payload length (default 64)
+ *   -d             Print the capture as text and exit
+ *
+ * A capture is what the AT_CAPTURE build streams on RTT up channel 1
+ * (at_engine.h): every USART2 byte as <'R'|'T'|'D'><len LE16><tick LE32>
+ * <bytes>. It is cut into exchanges - what the MCU sent, then what the
+ * modem answered up to the next send, each RX chunk at its delay after
+ * the send. RX before the first send (boot URCs) plays at its own time.
+ *
+ * a7600_mqtt.c, at_engine.c and uart_dma.c run unchanged on a simulated
+ * millisecond clock. Each send is matched to the next exchange of the
+ * capture with the same command (text up to '=', '?' or CR; payloads
+ * match payloads) and that exchange's answer is played back with its
+ * recorded delays. A send the capture does not have within the next
+ * REPLAY_WINDOW exchanges gets "ERROR"; the exchanges passed over count
+ * as skipped. So a driver that sends fewer or other commands still runs,
+ * and its connect, publish and reconnect times can be compared with the
+ * driver the capture came from - on the same modem and network timing.
+ *
+ * The report:
+ *   {"ms":..,"connects":[{"ms":..,"ok":..},...],"reconnects":..,
+ *    "publish":{"delivered":..,"failed":..,"lat_avg_ms":..,"lat_max_ms":..,"payload_pm":..},
+ *    "capture":{"exchanges":..,"matched":..,"skipped":..,"unmatched":..,"lost":..}}
+ * Check matched/unmatched before trusting the times: many unmatched
+ * sends mean the two drivers talk too differently for this capture.
+ */
+
+#include "bench.h"
+#include "app.h"
+#include "a7600_mqtt.h"
+#include "at_engine.h"
+#include "metrics.h"
+#if APP_MQTT_VERIFY_TLS
+#include "certificates.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_TAIL_MS      10000       /* Run on after the capture ends */
+#define REPLAY_WINDOW       8           /* Exchanges a send may skip ahead */
+#define REPLAY_PLAYING      16          /* Answers playing at once (late URCs overlap the next send) */
+#define REPLAY_CHUNK        (SIM_UART_RX_BUFFER_SIZE / 2)
+#define REPLAY_TX_MAX       2048        /* One send, bytes */
+#define REPLAY_CONNECTS     32          /* Connects listed in the report */
+#define REPLAY_KEY_LEN      24
+#define REPLAY_RETRY_MS     1000        /* After a failed connect */
+
+/* An RX chunk of the capture */
+typedef struct {
+    uint32_t delay;                     /* After the exchange's send (boot: after the start) */
+    size_t pos;                         /* Bytes in the file */
+    size_t len;
+} Replay_Rx_t;
+
+/* A send and the answer up to the next one */
+typedef struct {
+    char key[REPLAY_KEY_LEN];
+    size_t rx_first;
+    size_t rx_count;
+} Replay_Exchange_t;
+
+static uint8_t *cap;
+static size_t cap_size;
+static Replay_Rx_t *rx_list;
+static Replay_Exchange_t *ex_list;      /* [0]: boot, before the first send */
+static size_t ex_count;
+static uint32_t cap_ms;                 /* First to last record */
+static uint32_t cap_lost;               /* Bytes the capture dropped ('D') */
+
+/* Answers being played */
+static struct {
+    const Replay_Exchange_t *ex;
+    size_t next;                        /* RX chunk due next */
+    uint32_t start;
+} playing[REPLAY_PLAYING];
+
+static size_t ex_next = 1;              /* Next exchange a send may match */
+static uint32_t matched, skipped, unmatched;
+
+/* The send being collected */
+static uint8_t tx_buf[REPLAY_TX_MAX];
+static size_t tx_len;
+
+/* Modules under test */
+static UART_HandleTypeDef sim_huart;
+static UART_DMA_Handle_t sim;
+static uint8_t sim_rx[SIM_UART_RX_BUFFER_SIZE], sim_tx[SIM_UART_TX_BUFFER_SIZE];
+static A7600_MQTT_Handle_t mqtt;
+static uint32_t now;
+
+/* Mini app (app.c task_link, reduced) */
+static enum { LINK_WAIT, LINK_CONNECTING, LINK_UP, LINK_RETRY } link;
+static uint32_t link_tick;
+static bool was_up;
+static uint32_t connect_ms[REPLAY_CONNECTS];
+static bool connect_ok[REPLAY_CONNECTS];
+static uint32_t connects, reconnects;
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Command of a send: "AT+CMQTTPUB" of "AT+CMQTTPUB=0,1,60\r", "<data>" for payloads
+ */
+static void send_key(char *key, const uint8_t *data, size_t len)
+{
+    size_t n = 0;
+    
+    if (len < 2 || data[0] != 'A' || data[1] != 'T') {
+        strcpy(key, "<data>");
+        return;
+    }
+    while (n < len && n < REPLAY_KEY_LEN - 1 && data[n] != '=' && data[n] != '?' &&
+           data[n] != '\r' && data[n] != ';') {
+        key[n] = (char)data[n];
+        n++;
+    }
+    key[n] = '\0';
+}
+
+/**
+ * @brief Read the capture and cut it into exchanges
+ */
+static bool load_capture(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    long size;
+    size_t pos = 0;
+    size_t rx_count = 0;
+    bool first = true;
+    bool in_tx = false;
+    uint32_t t0 = 0, last = 0, tx_tick = 0;
+    
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0) {
+        return false;
+    }
+    rewind(f);
+    cap_size = (size_t)size;
+    cap = malloc(cap_size + 1);
+    rx_list = malloc((cap_size / AT_CAPTURE_HDR + 1) * sizeof(*rx_list));
+    ex_list = malloc((cap_size / AT_CAPTURE_HDR + 2) * sizeof(*ex_list));
+    if (cap == NULL || rx_list == NULL || ex_list == NULL || fread(cap, 1, cap_size, f) != cap_size) {
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    
+    memset(&ex_list[0], 0, sizeof(ex_list[0]));
+    strcpy(ex_list[0].key, "<boot>");
+    ex_count = 1;
+    
+    while (pos + AT_CAPTURE_HDR <= cap_size) {
+        uint8_t type = cap[pos];
+        size_t len = le16(&cap[pos + 1]);
+        uint32_t tick = le32(&cap[pos + 3]);
+        const uint8_t *data = &cap[pos + AT_CAPTURE_HDR];
+        
+        if (pos + AT_CAPTURE_HDR + len > cap_size) {
+            break;                      /* Cut short - RTT reader stopped mid-record */
+        }
+        if (first) {
+            t0 = tick;
+            first = false;
+        }
+        last = tick;
+        
+        if (type == AT_CAPTURE_TX) {
+            if (!in_tx) {
+                /* A new send: its key comes from its first bytes */
+                Replay_Exchange_t *ex = &ex_list[ex_count++];
+                
+                send_key(ex->key, data, len);
+                ex->rx_first = rx_count;
+                ex->rx_count = 0;
+                tx_tick = tick;
+                in_tx = true;
+            }
+        } else if (type == AT_CAPTURE_RX) {
+            Replay_Exchange_t *ex = &ex_list[ex_count - 1];
+            
+            if (ex->rx_count == 0) {
+                ex->rx_first = rx_count;
+            }
+            rx_list[rx_count++] = (Replay_Rx_t){ (ex_count == 1) ? tick - t0 : tick - tx_tick,
+                                                 pos + AT_CAPTURE_HDR, len };
+            ex->rx_count++;
+            in_tx = false;
+        } else if (type == AT_CAPTURE_DROP && len >= 4) {
+            cap_lost += le32(data);
+        } else if (type != AT_CAPTURE_DROP && type != METRICS_RTT_TYPE) {
+            return false;               /* Not a capture, or out of step (metrics records are skipped) */
+        }
+        pos += AT_CAPTURE_HDR + len;
+    }
+    cap_ms = last - t0;
+    return ex_count > 1;
+}
+
+/**
+ * @brief Print the capture as text, one record per line
+ */
+static void dump_capture(void)
+{
+    size_t pos = 0;
+    
+    while (pos + AT_CAPTURE_HDR <= cap_size) {
+        size_t len = le16(&cap[pos + 1]);
+        
+        if (pos + AT_CAPTURE_HDR + len > cap_size) {
+            break;
+        }
+        printf("%10u %c ", (unsigned)le32(&cap[pos + 3]), cap[pos]);
+        if (cap[pos] == AT_CAPTURE_DROP && len >= 4) {
+            printf("%u bytes lost", (unsigned)le32(&cap[pos + AT_CAPTURE_HDR]));
+        }
+        if (cap[pos] == METRICS_RTT_TYPE) {
+            printf("metrics, %u bytes (MDK-ARM/metrics_decode.py)", (unsigned)len);
+        }
+        for (size_t i = 0; i < len && cap[pos] != AT_CAPTURE_DROP && cap[pos] != METRICS_RTT_TYPE; i++) {
+            uint8_t c = cap[pos + AT_CAPTURE_HDR + i];
+            
+            if (c == '\r') {
+                printf("\\r");
+            } else if (c == '\n') {
+                printf("\\n");
+            } else if (c >= 0x20 && c < 0x7F) {
+                putchar(c);
+            } else {
+                printf("\\x%02x", c);
+            }
+        }
+        putchar('\n');
+        pos += AT_CAPTURE_HDR + len;
+    }
+}
+
+static void play(const Replay_Exchange_t *ex)
+{
+    for (size_t i = 0; i < REPLAY_PLAYING; i++) {
+        if (playing[i].ex == NULL) {
+            playing[i].ex = ex;
+            playing[i].next = 0;
+            playing[i].start = now;
+            return;
+        }
+    }
+    /* All busy: the oldest answer gives way (its tail is lost) */
+    memmove(&playing[0], &playing[1], (REPLAY_PLAYING - 1) * sizeof(playing[0]));
+    playing[REPLAY_PLAYING - 1].ex = ex;
+    playing[REPLAY_PLAYING - 1].next = 0;
+    playing[REPLAY_PLAYING - 1].start = now;
+}
+
+/**
+ * @brief Answer one send from the capture, or with ERROR
+ */
+static void answer(const uint8_t *data, size_t len)
+{
+    static const uint8_t error_text[] = "\r\nERROR\r\n";
+    char key[REPLAY_KEY_LEN];
+    
+    send_key(key, data, len);
+    for (size_t i = ex_next; i < ex_count && i < ex_next + REPLAY_WINDOW; i++) {
+        if (strcmp(ex_list[i].key, key) == 0) {
+            skipped += (uint32_t)(i - ex_next);
+            matched++;
+            ex_next = i + 1;
+            play(&ex_list[i]);
+            return;
+        }
+    }
+    unmatched++;
+    Bench_UartReceive(&sim, error_text, sizeof(error_text) - 1);
+}
+
+static void collect_tx(void *ctx, const uint8_t *data, size_t len)
+{
+    (void)ctx;
+    if (tx_len + len > sizeof(tx_buf)) {
+        len = sizeof(tx_buf) - tx_len;
+    }
+    memcpy(&tx_buf[tx_len], data, len);
+    tx_len += len;
+}
+
+/**
+ * @brief One simulated millisecond of the modem and its UART
+ */
+static void sim_step(void)
+{
+    Bench_SetTick(++now);
+    
+    /* What the driver sent in the last millisecond: AT commands split after their CR LF */
+    Bench_UartTxDone(&sim);
+    for (size_t pos = 0; pos < tx_len; ) {
+        size_t end = pos;
+        
+        if (tx_len - pos >= 2 && tx_buf[pos] == 'A' && tx_buf[pos + 1] == 'T') {
+            while (end < tx_len && tx_buf[end] != '\r') {
+                end++;
+            }
+            while (end < tx_len && (tx_buf[end] == '\r' || tx_buf[end] == '\n')) {
+                end++;
+            }
+        } else {
+            end = tx_len;
+        }
+        answer(&tx_buf[pos], end - pos);
+        pos = end;
+    }
+    tx_len = 0;
+    
+    /* Answers falling due */
+    for (size_t i = 0; i < REPLAY_PLAYING; i++) {
+        while (playing[i].ex != NULL) {
+            const Replay_Exchange_t *ex = playing[i].ex;
+            const Replay_Rx_t *rx = &rx_list[ex->rx_first + playing[i].next];
+            
+            if (playing[i].next >= ex->rx_count) {
+                playing[i].ex = NULL;
+                break;
+            }
+            if (now - playing[i].start < rx->delay) {
+                break;
+            }
+            for (size_t off = 0; off < rx->len; off += REPLAY_CHUNK) {
+                size_t n = rx->len - off;
+                
+                Bench_UartReceive(&sim, &cap[rx->pos + off], (n > REPLAY_CHUNK) ? REPLAY_CHUNK : n);
+            }
+            playing[i].next++;
+        }
+    }
+}
+
+/* ==================== Mini app ==================== */
+
+static void connect_done(void *ctx, MQTT_Result_t result)
+{
+    (void)ctx;
+    if (connects < REPLAY_CONNECTS) {
+        connect_ms[connects] = A7600_MQTT_GetConnectStats(&mqtt)->total_ms;
+        connect_ok[connects] = (result == MQTT_OK);
+    }
+    connects++;
+    link = (result == MQTT_OK) ? LINK_UP : LINK_RETRY;
+    link_tick = now;
+}
+
+static void app_step(uint32_t publish_ms, const uint8_t *payload, size_t payload_len)
+{
+    static uint32_t publish_tick;
+    
+    switch (link) {
+    case LINK_WAIT:
+        if (A7600_MQTT_ModuleReady(&mqtt)) {
+            if (A7600_MQTT_ConnectAsync(&mqtt, connect_done, NULL) == MQTT_OK) {
+                link = LINK_CONNECTING;
+            }
+        } else if (now - link_tick >= APP_MODULE_PROBE_INTERVAL) {
+            link_tick = now;
+            A7600_MQTT_ProbeModule(&mqtt);
+        }
+        break;
+    
+    case LINK_CONNECTING:
+        break;
+    
+    case LINK_UP:
+        was_up = true;
+        if (!A7600_MQTT_IsConnected(&mqtt)) {
+            link = LINK_RETRY;
+            link_tick = now - REPLAY_RETRY_MS;
+            break;
+        }
+        if (publish_ms > 0 && now - publish_tick >= publish_ms && !A7600_MQTT_IsBusy(&mqtt)) {
+            publish_tick = now;
+            A7600_MQTT_PublishAsync(&mqtt, APP_TOPIC_SENSOR, payload, payload_len, MQTT_QOS_1, NULL, NULL);
+        }
+        break;
+    
+    case LINK_RETRY:
+        if (now - link_tick >= REPLAY_RETRY_MS &&
+            A7600_MQTT_ReconnectAsync(&mqtt, connect_done, NULL) == MQTT_OK) {
+            reconnects += was_up;
+            link = LINK_CONNECTING;
+        }
+        break;
+    }
+}
+
+/* ==================== Main ==================== */
+
+int main(int argc, char **argv)
+{
+    uint32_t run_ms = 0;
+    uint32_t publish_ms = 1000;
+    size_t payload_len = 64;
+    bool dump = false;
+    const char *out = "build/at_replay.json";
+    int arg = 1;
+    
+    while (arg < argc && argv[arg][0] == '-') {
+        if (argv[arg][1] == 'd') {
+            dump = true;
+            arg++;
+            continue;
+        }
+        if (arg + 1 >= argc) {
+            arg = argc;
+            break;
+        }
+        switch (argv[arg][1]) {
+        case 't': run_ms = (uint32_t)strtoul(argv[arg + 1], NULL, 10); break;
+        case 'p': publish_ms = (uint32_t)strtoul(argv[arg + 1], NULL, 10); break;
+        case 'l': payload_len = (size_t)strtoul(argv[arg + 1], NULL, 10); break;
+        default: arg = argc; break;
+        }
+        arg += 2;
+    }
+    if (arg >= argc || payload_len == 0 || payload_len > 1024) {
+        fprintf(stderr, "usage: at_replay [-t run_ms] [-p publish_ms] [-l payload_len] [-d]\n"
+                        "                 session.cap [out.json]\n");
+        return 2;
+    }
+    if (!load_capture(argv[arg])) {
+        fprintf(stderr, "at_replay: no AT capture in %s\n", argv[arg]);
+        return 1;
+    }
+    if (dump) {
+        dump_capture();
+        return 0;
+    }
+    if (arg + 1 < argc) {
+        out = argv[arg + 1];
+    }
+    if (run_ms == 0) {
+        run_ms = cap_ms + REPLAY_TAIL_MS;
+    }
+    
+    /* As App_Init configures it */
+    MQTT_Config_t config = {
+        .broker = APP_MQTT_BROKER,
+        .port = APP_MQTT_PORT,
+        .username = APP_MQTT_USERNAME,
+        .password = APP_MQTT_PASSWORD,
+        .client_id = APP_MQTT_CLIENT_ID,
+        .use_ssl = true,
+        .keepalive = APP_MQTT_KEEPALIVE,
+        .adaptive_keepalive = (APP_MQTT_ADAPTIVE_KA != 0),
+        .baudrate = APP_MODEM_BAUD,
+        .clients = APP_MQTT_CLIENTS,
+        .persistent_session = (APP_MQTT_PERSISTENT != 0),
+        .transport = APP_MQTT_TRANSPORT,
+        .udp_host = APP_UDP_HOST,
+        .udp_port = APP_UDP_PORT,
+        .connect_by_ip = (APP_MQTT_CONNECT_BY_IP != 0),
+#if APP_MQTT_VERIFY_TLS
+        .ca_cert = isrg_root_x1,
+        .ca_cert_len = sizeof(isrg_root_x1) - 1
+#endif
+    };
+    uint8_t *payload = malloc(payload_len);
+    
+    if (payload == NULL) {
+        return 1;
+    }
+    memset(payload, 'x', payload_len);
+    
+    Bench_UartSetup(&sim_huart, 115200);
+    UART_DMA_Init(&sim, &sim_huart, sim_rx, sizeof(sim_rx), sim_tx, sizeof(sim_tx));
+    Bench_UartTxSink(&sim, collect_tx, NULL);
+    Bench_SetIdle(sim_step);            /* Blocking driver waits let simulated time pass */
+    if (A7600_MQTT_Init(&mqtt, &sim, &config) != MQTT_OK) {
+        fprintf(stderr, "at_replay: driver init failed\n");
+        return 1;
+    }
+    play(&ex_list[0]);
+    
+    while (now < run_ms) {
+        sim_step();
+        A7600_MQTT_Process(&mqtt);
+        app_step(publish_ms, payload, payload_len);
+    }
+    
+    const MQTT_PubStats_t *pub = A7600_MQTT_GetPublishStats(&mqtt);
+    const MQTT_WireStats_t *eff = A7600_MQTT_GetWireStats(&mqtt);
+    uint32_t payload_pm = (eff->wire / 1000U) ? eff->payload / (eff->wire / 1000U) : 0;
+    FILE *f = fopen(out, "w");
+    
+    if (f == NULL) {
+        fprintf(stderr, "at_replay: cannot write %s\n", out);
+        return 1;
+    }
+    fprintf(f, "{\"ms\":%u,\"connects\":[", (unsigned)now);
+    for (uint32_t i = 0; i < connects && i < REPLAY_CONNECTS; i++) {
+        fprintf(f, "%s{\"ms\":%u,\"ok\":%s}", i ? "," : "", (unsigned)connect_ms[i],
+                connect_ok[i] ? "true" : "false");
+    }
+    fprintf(f, "],\"reconnects\":%u,", (unsigned)reconnects);
+    fprintf(f, "\"publish\":{\"delivered\":%u,\"failed\":%u,\"lat_avg_ms\":%u,\"lat_max_ms\":%u,"
+            "\"payload_pm\":%u},", (unsigned)pub->delivered, (unsigned)pub->failed,
+            (unsigned)(pub->delivered ? pub->latency_ms_total / pub->delivered : 0),
+            (unsigned)pub->latency_ms_max, (unsigned)payload_pm);
+    fprintf(f, "\"capture\":{\"exchanges\":%u,\"matched\":%u,\"skipped\":%u,\"unmatched\":%u,\"lost\":%u}}\n",
+            (unsigned)(ex_count - 1), (unsigned)matched, (unsigned)skipped, (unsigned)unmatched,
+            (unsigned)cap_lost);
+    fclose(f);
+    
+    printf("%u ms: %u connects (%u reconnects), first %u ms\n", (unsigned)now, (unsigned)connects,
+           (unsigned)reconnects, (unsigned)(connects ? connect_ms[0] : 0));
+    printf("publish: %u delivered, %u failed, latency avg %u max %u ms, %u per mille of the AT bytes payload\n",
+           (unsigned)pub->delivered, (unsigned)pub->failed,
+           (unsigned)(pub->delivered ? pub->latency_ms_total / pub->delivered : 0),
+           (unsigned)pub->latency_ms_max, (unsigned)payload_pm);
+    printf("capture: %u exchanges, %u matched, %u skipped, %u unmatched, %u bytes lost\n",
+           (unsigned)(ex_count - 1), (unsigned)matched, (unsigned)skipped, (unsigned)unmatched,
+           (unsigned)cap_lost);
+    printf("report: %s\n", out);
+    return 0;
+}
@@ -0,0 +1,365 @@
+/**
+ * @file    bench.c
+ * @brief   Host benchmark of the bridge codecs, the uplink frame parser,
+ *          the AT line parser and UART_DMA_Read
+ *
+ * Usage: bench [out.json]   (default build/bench.json)
+ *
+ * Each case runs BENCH_ROUNDS rounds of at least BENCH_ROUND_NS and keeps
+ * the fastest; "bytes" is the input one call handles. Results are printed
+ * and written as JSON:
+ *   {"compiler":"...","results":[{"name":"to_base64","bytes":256,
+ *    "ns_per_call":..,"ns_per_byte":..,"mb_per_s":..}, ...]}
+ */
+
+#include "bench.h"
+#include "at_engine.h"
+#include "mavlink_bridge.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ROUNDS        5
+#define BENCH_ROUND_NS      50000000.0  /* 50 ms */
+#define BENCH_RESULTS_MAX   16
+
+#define CODEC_CHUNK         256         /* Raw bytes per encode call (one batch) */
+#define STREAM_MAX          4096        /* Frame / text streams */
+#define RX_CHUNK            256         /* Bytes per simulated DMA burst (<= half a ring) */
+
+typedef struct {
+    const char *name;
+    size_t bytes;
+    double ns;                          /* Per call, best round */
+} Bench_Result_t;
+
+static Bench_Result_t results[BENCH_RESULTS_MAX];
+static size_t result_count;
+
+/* Data sets */
+static uint8_t raw[CODEC_CHUNK];
+static char text_out[CODEC_CHUNK * 2 + 1];
+static uint8_t frames[STREAM_MAX];      /* Valid MAVLink v2 stream */
+static size_t frames_len;
+static uint32_t frames_count;
+static uint8_t hex_text[STREAM_MAX * 2];
+static size_t hex_text_len;
+static uint8_t b64_text[STREAM_MAX * 4 / 3 + 4];
+static size_t b64_text_len;
+static uint8_t at_text[STREAM_MAX];
+static size_t at_text_len;
+
+/* Modules under test */
+static UART_HandleTypeDef telem_huart, sim_huart;
+static UART_DMA_Handle_t telem, sim;
+static uint8_t telem_rx[TELEM_UART_RX_BUFFER_SIZE], telem_tx[TELEM_UART_TX_BUFFER_SIZE];
+static uint8_t sim_rx[SIM_UART_RX_BUFFER_SIZE], sim_tx[SIM_UART_TX_BUFFER_SIZE];
+static A7600_MQTT_Handle_t mqtt;
+static AT_Engine_t at;
+static uint32_t at_lines;
+static uint32_t tick;
+static size_t read_size;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Time fn: calls per round are doubled until a round is long enough
+ */
+static void bench_run(const char *name, void (*fn)(void), size_t bytes)
+{
+    unsigned long calls = 1;
+    double best = 0;
+    
+    for (;;) {
+        double start = now_ns();
+        for (unsigned long i = 0; i < calls; i++) {
+            fn();
+        }
+        if (now_ns() - start >= BENCH_ROUND_NS) {
+            break;
+        }
+        calls *= 2;
+    }
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double start = now_ns();
+        for (unsigned long i = 0; i < calls; i++) {
+            fn();
+        }
+        double ns = (now_ns() - start) / calls;
+        if (round == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    
+    if (result_count < BENCH_RESULTS_MAX) {
+        results[result_count++] = (Bench_Result_t){ name, bytes, best };
+    }
+    printf("%-16s %6zu B %12.1f ns/call %8.3f ns/B %9.1f MB/s\n",
+           name, bytes, best, best / bytes, bytes * 1e3 / best);
+}
+
+/* ==================== Data ==================== */
+
+static uint32_t rng = 0x12345678;
+
+static uint8_t rand8(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (uint8_t)(rng >> 24) | 1;    /* Never 0: frame_seal would trim it */
+}
+
+/**
+ * @brief Telemetry mix as an autopilot streams it
+ */
+static void make_frames(void)
+{
+    static const struct { uint32_t msgid; uint8_t len; } mix[] = {
+        { 30, 28 }, { 33, 28 }, { 74, 20 }, { 30, 28 }, { 1, 31 }, { 24, 30 }, { 0, 9 }
+    };
+    uint8_t payload[255];
+    uint8_t seq = 0;
+    
+    for (size_t i = 0; ; i = (i + 1) % (sizeof(mix) / sizeof(mix[0]))) {
+        if (frames_len + 10 + mix[i].len + 2 > sizeof(frames)) {
+            break;
+        }
+        for (size_t j = 0; j < mix[i].len; j++) {
+            payload[j] = rand8();
+        }
+        frames_len += Bench_Frame(&frames[frames_len], payload, mix[i].len, seq++, mix[i].msgid);
+        frames_count++;
+    }
+}
+
+/**
+ * @brief Modem output: received MQTT messages, publish results, polls
+ */
+static void make_at_text(void)
+{
+    static const char *const burst =
+        "+CMQTTRXSTART: 0,18,44\r\n"
+        "+CMQTTRXTOPIC: 0,18\r\n"
+        "uav4g/mavlink/down\r\n"
+        "+CMQTTRXPAYLOAD: 0,44\r\n"
+        "/RwAAAEB/wAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=\r\n"
+        "+CMQTTRXEND: 0\r\n"
+        "OK\r\n"
+        "+CMQTTPUB: 0,0\r\n"
+        "AT+CSQ\r\r\n"
+        "+CSQ: 21,99\r\n"
+        "\r\n"
+        "OK\r\n";
+    size_t n = strlen(burst);
+    
+    while (at_text_len + n <= sizeof(at_text)) {
+        memcpy(&at_text[at_text_len], burst, n);
+        at_text_len += n;
+    }
+}
+
+/* ==================== Cases ==================== */
+
+static void case_to_hex(void)
+{
+    Bench_ToHex(raw, sizeof(raw), text_out);
+}
+
+static void case_to_base64(void)
+{
+    Bench_ToBase64(raw, sizeof(raw), text_out);
+}
+
+static void case_to_hex_table(void)
+{
+    Bench_ToHexTable(raw, sizeof(raw), text_out);
+}
+
+static void case_to_base64_table(void)
+{
+    Bench_ToBase64Table(raw, sizeof(raw), text_out);
+}
+
+static void case_from_hex(void)
+{
+    Bench_DownlinkReset();
+    Bench_FromHex(hex_text, hex_text_len);
+}
+
+static void case_from_base64(void)
+{
+    Bench_DownlinkReset();
+    Bench_FromBase64(b64_text, b64_text_len);
+}
+
+static void case_frame_parser(void)
+{
+    for (size_t pos = 0; pos < frames_len; pos += RX_CHUNK) {
+        size_t n = (frames_len - pos < RX_CHUNK) ? frames_len - pos : RX_CHUNK;
+        
+        Bench_SetTick(++tick);
+        Bench_UartReceive(&telem, &frames[pos], n);
+        MavlinkBridge_Process();
+    }
+}
+
+static void case_uart_read(void)
+{
+    uint8_t buf[RX_CHUNK];
+    
+    Bench_UartReceive(&telem, NULL, RX_CHUNK);
+    while (UART_DMA_Read(&telem, buf, read_size) == read_size) {
+    }
+}
+
+static void count_line(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    (void)ctx;
+    (void)line;
+    (void)len;
+    (void)type;
+    at_lines++;
+}
+
+static void case_at_parser(void)
+{
+    for (size_t pos = 0; pos < at_text_len; pos += RX_CHUNK / 2) {
+        size_t n = (at_text_len - pos < RX_CHUNK / 2) ? at_text_len - pos : RX_CHUNK / 2;
+        
+        Bench_UartReceive(&sim, &at_text[pos], n);
+        while (AT_Engine_Process(&at) > 0) {
+        }
+    }
+}
+
+/**
+ * @brief RX DMA restart (transfer error) with the reader near the ring end and
+ *        more than half the ring unread, wrapped: every byte must read back in order
+ */
+static bool restart_check(void)
+{
+    static uint8_t in[TELEM_UART_RX_BUFFER_SIZE], out[TELEM_UART_RX_BUFFER_SIZE];
+    DMA_HandleTypeDef *rx = telem_huart.hdmarx;
+    size_t size = sizeof(telem_rx);
+    size_t unread = size - size / 4;
+    size_t after = 8;                   /* Received once DMA runs again */
+    size_t n = 0;
+    
+    for (size_t i = 0; i < unread + after; i++) {
+        in[i] = rand8();
+    }
+    
+    /* Reader 16 bytes before the ring end, nothing unread */
+    while (UART_DMA_Read(&telem, out, sizeof(out)) > 0) {
+    }
+    Bench_UartReceive(&telem, NULL, (size - 16 - UART_DMA_GetDMAPos(&telem)) & (size - 1));
+    while (UART_DMA_Read(&telem, out, sizeof(out)) > 0) {
+    }
+    
+    Bench_UartReceive(&telem, in, unread);
+    rx->DmaBaseAddress->ISR |= DMA_ISR_TEIF1 << rx->ChannelIndex;
+    UART_DMA_DMA_IRQHandler(&telem);
+    rx->DmaBaseAddress->ISR &= ~(DMA_ISR_TEIF1 << rx->ChannelIndex);
+    Bench_UartReceive(&telem, &in[unread], after);
+    
+    for (size_t got; (got = UART_DMA_Read(&telem, &out[n], sizeof(out) - n)) > 0; ) {
+        n += got;
+    }
+    return n == unread + after && memcmp(in, out, n) == 0;
+}
+
+/* ==================== Main ==================== */
+
+static bool write_json(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    
+    if (f == NULL) {
+        return false;
+    }
+    fprintf(f, "{\"compiler\":\"%s\",\"results\":[", __VERSION__);
+    for (size_t i = 0; i < result_count; i++) {
+        const Bench_Result_t *r = &results[i];
+        
+        fprintf(f, "%s\n  {\"name\":\"%s\",\"bytes\":%zu,\"ns_per_call\":%.1f,\"ns_per_byte\":%.4f,\"mb_per_s\":%.2f}",
+                i ? "," : "", r->name, r->bytes, r->ns, r->ns / r->bytes, r->bytes * 1e3 / r->ns);
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const AT_Urc_t urcs[] = {
+        { "+CMQTTRXSTART:", count_line },
+        { "+CMQTTRXPAYLOAD:", count_line },
+        { "+CMQTTPUB:", count_line },
+        { "+CSQ:", count_line },
+    };
+    const char *out = (argc > 1) ? argv[1] : "build/bench.json";
+    
+    for (size_t i = 0; i < sizeof(raw); i++) {
+        raw[i] = rand8();
+    }
+    make_frames();
+    make_at_text();
+    
+    Bench_UartSetup(&telem_huart, 921600);
+    Bench_UartSetup(&sim_huart, 115200);
+    UART_DMA_Init(&telem, &telem_huart, telem_rx, sizeof(telem_rx), telem_tx, sizeof(telem_tx));
+    UART_DMA_Init(&sim, &sim_huart, sim_rx, sizeof(sim_rx), sim_tx, sizeof(sim_tx));
+    MavlinkBridge_Init(&telem, &mqtt);
+    AT_Engine_Init(&at, &sim);
+    AT_Engine_SetLineHandler(&at, urcs, sizeof(urcs) / sizeof(urcs[0]), count_line, NULL);
+    
+    /* Downlink text: the frame stream as the broker would deliver it */
+    for (size_t pos = 0; pos < frames_len; pos += CODEC_CHUNK) {
+        size_t n = (frames_len - pos < CODEC_CHUNK) ? frames_len - pos : CODEC_CHUNK;
+        hex_text_len += Bench_ToHex(&frames[pos], n, (char *)&hex_text[hex_text_len]);
+    }
+    b64_text_len = Bench_ToBase64(frames, frames_len, (char *)b64_text);
+    
+    /* The encoders in use must give the table ones' text, or their figures mean nothing */
+    if (!Bench_CodecCheck(frames, frames_len)) {
+        fprintf(stderr, "bench: encoder check failed (SWAR and table text differ)\n");
+        return 1;
+    }
+    if (!restart_check()) {
+        fprintf(stderr, "bench: RX restart check failed (unread bytes lost or reordered)\n");
+        return 1;
+    }
+    
+    bench_run("to_hex", case_to_hex, sizeof(raw));
+    bench_run("to_base64", case_to_base64, sizeof(raw));
+    bench_run("to_hex_table", case_to_hex_table, sizeof(raw));
+    bench_run("to_base64_table", case_to_base64_table, sizeof(raw));
+    bench_run("from_hex", case_from_hex, hex_text_len);
+    bench_run("from_base64", case_from_base64, b64_text_len);
+    bench_run("frame_parser", case_frame_parser, frames_len);
+    read_size = 16;
+    bench_run("uart_read_16", case_uart_read, RX_CHUNK);
+    read_size = RX_CHUNK;
+    bench_run("uart_read_256", case_uart_read, RX_CHUNK);
+    bench_run("at_parser", case_at_parser, at_text_len);
+    
+    /* The parsers must have seen what was fed, or the figures mean nothing */
+    if (Bench_BridgeFrames() == 0 || Bench_BridgeFrames() % frames_count != 0 || at_lines == 0) {
+        fprintf(stderr, "bench: parser check failed (%u frames of %u per pass, %u AT lines)\n",
+                (unsigned)Bench_BridgeFrames(), (unsigned)frames_count, (unsigned)at_lines);
+        return 1;
+    }
+    if (!write_json(out)) {
+        fprintf(stderr, "bench: cannot write %s\n", out);
+        return 1;
+    }
+    printf("Results written to %s\n", out);
+    return 0;
+}
@@ -0,0 +1,286 @@
+/**
+ * @file    bench.h
+ * @brief   Host benchmark: hooks into the modules under test and the HAL shim
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "uart_dma.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ==================== HAL shim (shim.c) ==================== */
+
+/**
+ * @brief Set the HAL tick
+ * @param ms Milliseconds
+ */
+void Bench_SetTick(uint32_t ms);
+
+/**
+ * @brief Let time pass in __WFI and HAL_Delay - a blocking wait spins on a frozen tick otherwise
+ * @param fn Advances the tick by 1 ms and plays the peripherals (NULL: __WFI returns at once)
+ */
+void Bench_SetIdle(void (*fn)(void));
+
+/**
+ * @brief A model has something due at ms: a jump of the clock must not pass it
+ * @note  Virtual time. Models call it whenever they know; the earliest since the
+ *        last Bench_NextWake counts
+ */
+void Bench_WakeAt(uint32_t ms);
+
+/**
+ * @brief Where the clock may jump while nothing moves, and forget the wakes
+ * @param limit Furthest it may go (the firmware's own timers are not known here)
+ * @return Earliest of the wakes and limit, at least the next millisecond
+ */
+uint32_t Bench_NextWake(uint32_t limit);
+
+/**
+ * @brief No TX transfer handed to a sink is waiting for its completion
+ */
+bool Bench_TxIdle(void);
+
+/**
+ * @brief Attach a host "peripheral" to a UART handle before UART_DMA_Init
+ * @param huart Handle to set up
+ * @param baud Baud rate reported by the handle
+ */
+void Bench_UartSetup(UART_HandleTypeDef *huart, uint32_t baud);
+
+/**
+ * @brief Give a UART's far end its own baud rate
+ * @note  Auto baud rate detection then measures it from the first byte
+ *        received; while BRR is off it by more than 3% bytes arrive as 0x00
+ *        (framing). Without a call the far end follows BRR
+ * @param huart Handle set up by Bench_UartSetup
+ * @param baud Rate the far end sends at
+ */
+void Bench_UartLineRate(UART_HandleTypeDef *huart, uint32_t baud);
+
+/**
+ * @brief Play the RX DMA: append bytes at the DMA position and raise IDLE
+ * @param handle Driver handle (its ring wraps as the circular DMA would)
+ * @param data Bytes received (NULL: only advance - the ring keeps its old bytes)
+ * @param len At most half the ring, so HT/TC need not be modelled
+ */
+void Bench_UartReceive(UART_DMA_Handle_t *handle, const uint8_t *data, size_t len);
+
+/**
+ * @brief Receiver of a UART's TX DMA transfers
+ * @param ctx Context given to Bench_UartTxSink
+ * @param data Bytes of one transfer
+ * @param len Byte count
+ */
+typedef void (*Bench_TxFn_t)(void *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Hand a UART's TX transfers to fn; they complete on Bench_UartTxDone
+ *        (without a sink they never complete)
+ * @param handle Driver handle
+ * @param fn Receiver
+ * @param ctx Receiver context
+ */
+void Bench_UartTxSink(UART_DMA_Handle_t *handle, Bench_TxFn_t fn, void *ctx);
+
+/**
+ * @brief Complete the TX transfer in flight, and those it starts
+ * @param handle Driver handle
+ */
+void Bench_UartTxDone(UART_DMA_Handle_t *handle);
+
+/* ==================== Modem stand-in (bench_stubs.c) ==================== */
+
+/**
+ * @brief Publish figures of the online modem
+ */
+typedef struct {
+    uint32_t publishes;
+    uint32_t bytes;             /* Payload bytes (encoded MAVLink text) */
+    uint32_t max_len;
+} Bench_ModemStats_t;
+
+/**
+ * @brief Choose the modem the bridge sees (default: offline, as bench uses it)
+ * @param online true: connected, publishes complete after publish_ms plus their
+ *        bytes at baud on the modem UART, one at a time
+ * @param publish_ms Fixed part of a publish (AT round trips, radio)
+ * @param baud Modem UART rate
+ */
+void Bench_ModemSetup(bool online, uint32_t publish_ms, uint32_t baud);
+
+/**
+ * @brief Complete the publish in flight once it is due (call every tick)
+ */
+void Bench_ModemPoll(void);
+
+/**
+ * @brief Publishes started so far
+ */
+const Bench_ModemStats_t* Bench_ModemStats(void);
+
+/* ==================== Modem model (modem_sim.c) ==================== */
+
+/**
+ * @brief A7600 behaviour and the faults it injects (rates in per mille)
+ */
+typedef struct {
+    uint32_t seed;              /* Fault dice - same seed, same run */
+    uint32_t boot_ms;           /* Power on to RDY */
+    uint32_t connect_ms;        /* AT+CMQTTCONNECT to +CMQTTCONNECT */
+    uint32_t publish_ms;        /* AT+CMQTTPUB to +CMQTTPUB */
+    uint32_t uplink_bps;        /* Network uplink, payload bytes per second - adds to publish_ms (0: no limit) */
+    uint16_t connlost;          /* Of publishes: +CMQTTCONNLOST while it is in flight */
+    uint16_t payload_error;     /* Of publishes: ERROR after the AT+CMQTTPAYLOAD data */
+    uint16_t garbage;           /* Of seconds: a burst of noise from the modem */
+    const char *warm;           /* Module up from before, every client connected to this server
+                                   ("tcp://host:port"): an MCU reset alone (NULL: power on) */
+} Bench_SimConfig_t;
+
+/**
+ * @brief Fault and traffic counters of the modem model
+ */
+typedef struct {
+    uint32_t connects;          /* Sessions brought up */
+    uint32_t publishes;         /* Reported delivered */
+    uint32_t publish_bytes;
+    uint32_t connlost;          /* Faults injected */
+    uint32_t payload_errors;
+    uint32_t garbage;
+    uint32_t unknown;           /* Commands the model does not know (answered ERROR) */
+    uint32_t deaf;              /* Bytes sent while the module slept (AT+CSCLK=1, DTR) - lost */
+} Bench_SimStats_t;
+
+/**
+ * @brief What the broker got: called once per publish, when its outcome is known
+ * @param topic Topic
+ * @param payload Payload as sent on the modem UART
+ * @param len Payload length
+ * @param delivered false: failed (ERROR, or the session was lost under it)
+ */
+typedef void (*Bench_SimPublishFn_t)(const char *topic, const uint8_t *payload, size_t len, bool delivered);
+
+/**
+ * @brief Put the modem model on a UART (takes its TX sink) and power it on
+ * @param uart Modem UART handle, after UART_DMA_Init
+ * @param config Behaviour and fault rates (copied)
+ * @param publish Broker side, may be NULL
+ */
+void Bench_SimInit(UART_DMA_Handle_t *uart, const Bench_SimConfig_t *config, Bench_SimPublishFn_t publish);
+
+/**
+ * @brief Run the modem for the current millisecond (after Bench_SetTick)
+ */
+void Bench_SimStep(void);
+
+/**
+ * @brief A message from the broker to client 0, out on the modem UART in the next millisecond
+ * @param topic Topic
+ * @param payload Payload text (topic and payload together up to ~150 bytes)
+ * @return false: client 0 has no session, or too many answers are waiting
+ */
+bool Bench_SimInbound(const char *topic, const char *payload);
+
+/**
+ * @brief The driver's DTR line (MQTT_Config_t.dtr): high lets the module sleep
+ *        once AT+CSCLK=1 is set; after it goes low the UART is deaf a little longer
+ */
+void Bench_SimDtr(bool high);
+
+/**
+ * @brief Counters since Bench_SimInit
+ */
+const Bench_SimStats_t* Bench_SimStats(void);
+
+/* ==================== Bridge internals (bench_bridge.c) ==================== */
+
+size_t Bench_ToHex(const uint8_t *data, size_t len, char *out);
+size_t Bench_ToBase64(const uint8_t *data, size_t len, char *out);
+size_t Bench_ToHexTable(const uint8_t *data, size_t len, char *out);
+size_t Bench_ToBase64Table(const uint8_t *data, size_t len, char *out);
+
+/**
+ * @brief The encoders in use (BRIDGE_SWAR) give the table ones' text, every length up to
+ *        300 of data, four output alignments, Base64 split across two calls
+ */
+bool Bench_CodecCheck(const uint8_t *data, size_t len);
+void Bench_FromHex(const uint8_t *text, size_t len);
+void Bench_FromBase64(const uint8_t *text, size_t len);
+
+/**
+ * @brief Empty the downlink queue the decoders fill
+ */
+void Bench_DownlinkReset(void);
+
+/**
+ * @brief Decoded bytes into the downlink queue as they are (the raw encoding's decoder)
+ */
+void Bench_FromRaw(const uint8_t *data, size_t len);
+
+/**
+ * @brief Downlink queue and decoder as a fresh boot has them (counters and
+ *        the redelivery memory as well), so two runs can be compared
+ */
+void Bench_DownlinkClear(void);
+
+/**
+ * @brief What the decoders left in the downlink queue
+ */
+typedef struct {
+    const uint8_t *queue;       /* dl_q: committed frames, then the one being decoded */
+    uint16_t head;
+    uint16_t commit;
+    uint16_t cur;               /* Bytes of the frame being decoded */
+    uint16_t bad;               /* Characters outside the encoding */
+    uint16_t rejected;          /* Frames failing the CRC */
+    uint16_t unrouted;
+    uint16_t dropped;           /* ... not fitting the queue */
+} Bench_Downlink_t;
+
+void Bench_Downlink(Bench_Downlink_t *dl);
+
+/**
+ * @brief Build a valid MAVLink v2 frame (CRC with the bridge's CRC_EXTRA)
+ * @param f Output, header + payload + 2 bytes
+ * @param payload Payload bytes (trailing zeros are trimmed as on the wire)
+ * @param len Payload length
+ * @param seq Sequence number
+ * @param msgid Message ID - must be one the bridge forwards
+ * @return Frame length
+ */
+size_t Bench_Frame(uint8_t *f, const uint8_t *payload, size_t len, uint8_t seq, uint32_t msgid);
+
+/**
+ * @brief Build a valid MAVLink v1 frame (payload whole, as v1 sends it)
+ * @param f Output, 6-byte header + payload + 2 bytes
+ * @param msgid Message ID below 256 - must be one the bridge forwards
+ * @return Frame length
+ */
+size_t Bench_FrameV1(uint8_t *f, const uint8_t *payload, size_t len, uint8_t seq, uint32_t msgid);
+
+/**
+ * @brief Write the checksum of a frame (v1 or v2) rebuilt without one
+ * @param f Frame, header and payload in place; the checksum goes after them
+ */
+void Bench_FrameCrc(uint8_t *f);
+
+/**
+ * @brief Check the checksum of a frame (v1 or v2) of a message the bridge forwards
+ * @param f Frame, its length as the header declares
+ */
+bool Bench_FrameValid(const uint8_t *f);
+
+/**
+ * @brief Frames the uplink parser has accepted so far (offline: outage log kept + dropped)
+ */
+uint32_t Bench_BridgeFrames(void);
+
+/**
+ * @brief Frame bytes in the open batches (not yet handed to the modem)
+ */
+uint32_t Bench_BridgeQueued(void);
+
+#endif /* BENCH_H */
@@ -0,0 +1,176 @@
+/**
+ * @file    bench_bridge.c
+ * @brief   Benchmark access to the MAVLink bridge internals
+ * @note    Builds mavlink_bridge.c itself into this unit, so the static
+ *          codecs and the frame builder can be timed without changing the
+ *          firmware. Nothing else may include the bridge.
+ */
+
+#include "../Core/Src/mavlink_bridge.c"
+#include "bench.h"
+
+size_t Bench_ToHex(const uint8_t *data, size_t len, char *out)
+{
+    return CODEC_TO_HEX(&bridge.bulk, data, len, out);
+}
+
+size_t Bench_ToBase64(const uint8_t *data, size_t len, char *out)
+{
+    size_t n = CODEC_TO_BASE64(&bridge.bulk, data, len, out);
+    
+    return n + base64_finish(&bridge.bulk, &out[n]);
+}
+
+size_t Bench_ToHexTable(const uint8_t *data, size_t len, char *out)
+{
+    return to_hex(&bridge.bulk, data, len, out);
+}
+
+size_t Bench_ToBase64Table(const uint8_t *data, size_t len, char *out)
+{
+    size_t n = to_base64(&bridge.bulk, data, len, out);
+    
+    return n + base64_finish(&bridge.bulk, &out[n]);
+}
+
+bool Bench_CodecCheck(const uint8_t *data, size_t len)
+{
+    char want[2 * 300 + 8], got[2 * 300 + 8];
+    
+    for (size_t n = 0; n <= len && n <= 300; n++) {
+        for (size_t at = 0; at < 4; at++) {
+            size_t split = (n * 7 + at) % (n + 1);  /* Base64 in two calls, partial groups across */
+            Lane_t a = { 0 }, b = { 0 };
+            size_t wn, gn;
+            
+            wn = to_hex(&a, data, n, &want[at]);
+            gn = CODEC_TO_HEX(&b, data, n, &got[at]);
+            if (wn != gn || memcmp(&want[at], &got[at], wn + 1) != 0) {
+                return false;
+            }
+            wn = to_base64(&a, data, split, &want[at]);
+            wn += to_base64(&a, &data[split], n - split, &want[at + wn]);
+            wn += base64_finish(&a, &want[at + wn]);
+            gn = CODEC_TO_BASE64(&b, data, split, &got[at]);
+            gn += CODEC_TO_BASE64(&b, &data[split], n - split, &got[at + gn]);
+            gn += base64_finish(&b, &got[at + gn]);
+            if (wn != gn || memcmp(&want[at], &got[at], wn + 1) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Bench_FromHex(const uint8_t *text, size_t len)
+{
+    from_hex(text, len);
+}
+
+void Bench_FromBase64(const uint8_t *text, size_t len)
+{
+    from_base64(text, len);
+}
+
+void Bench_DownlinkReset(void)
+{
+    /* Frames decoded so far are taken as sent - the queue never fills */
+    bridge.dl_head = 0;
+    bridge.dl_commit = 0;
+    bridge.dl_sent = 0;
+    bridge.dl_cur = 0;
+    bridge.dl_busy = false;
+    bridge.dec_n = 0;
+    bridge.dec_acc = 0;
+}
+
+void Bench_FromRaw(const uint8_t *data, size_t len)
+{
+    from_raw(data, len);
+}
+
+void Bench_DownlinkClear(void)
+{
+    Bench_DownlinkReset();
+    bridge.dec_bad = 0;
+    bridge.dl_rejected = 0;
+    bridge.dl_unrouted = 0;
+    bridge.dl_dropped = 0;
+#if BRIDGE_DL_DEDUP
+    memset(&bridge.dl_seen, 0, sizeof(bridge.dl_seen));
+#endif
+}
+
+void Bench_Downlink(Bench_Downlink_t *dl)
+{
+    dl->queue = bridge.dl_q;
+    dl->head = bridge.dl_head;
+    dl->commit = bridge.dl_commit;
+    dl->cur = bridge.dl_cur;
+    dl->bad = bridge.dec_bad;
+    dl->rejected = bridge.dl_rejected;
+    dl->unrouted = bridge.dl_unrouted;
+    dl->dropped = bridge.dl_dropped;
+}
+
+size_t Bench_Frame(uint8_t *f, const uint8_t *payload, size_t len, uint8_t seq, uint32_t msgid)
+{
+    memcpy(&f[MAVLINK_HEADER_LEN], payload, len);
+    return frame_seal(f, len, seq, 1, 1, msgid);
+}
+
+size_t Bench_FrameV1(uint8_t *f, const uint8_t *payload, size_t len, uint8_t seq, uint32_t msgid)
+{
+    uint16_t crc = MAVLINK_CRC_INIT;
+    size_t end = MAVLINK_V1_HEADER_LEN + len;
+    
+    f[0] = MAVLINK_V1_MAGIC;
+    f[1] = (uint8_t)len;
+    f[2] = seq;
+    f[3] = 1;
+    f[4] = 1;
+    f[5] = (uint8_t)msgid;
+    memcpy(&f[MAVLINK_V1_HEADER_LEN], payload, len);
+    for (size_t i = 1; i < end; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ f[i]) & 0xFF];
+    }
+    crc = (crc >> 8) ^ crc_table[(crc ^ msg_table[msg_index(msgid)].extra) & 0xFF];
+    f[end] = (uint8_t)crc;
+    f[end + 1] = (uint8_t)(crc >> 8);
+    return end + MAVLINK_CHECKSUM_LEN;
+}
+
+void Bench_FrameCrc(uint8_t *f)
+{
+    bool v1 = (f[0] == MAVLINK_V1_MAGIC);
+    size_t end = (v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN) + f[1];
+    int idx = msg_index(v1 ? f[5] : f[7] | ((uint32_t)f[8] << 8) | ((uint32_t)f[9] << 16));
+    uint16_t crc = MAVLINK_CRC_INIT;
+    
+    for (size_t i = 1; i < end; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ f[i]) & 0xFF];
+    }
+    crc = (crc >> 8) ^ crc_table[(crc ^ ((idx >= 0) ? msg_table[idx].extra : 0)) & 0xFF];
+    f[end] = (uint8_t)crc;
+    f[end + 1] = (uint8_t)(crc >> 8);
+}
+
+bool Bench_FrameValid(const uint8_t *f)
+{
+    bool v1 = (f[0] == MAVLINK_V1_MAGIC);
+    size_t header_len = v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+    int idx = msg_index(v1 ? f[5] : f[7] | ((uint32_t)f[8] << 8) | ((uint32_t)f[9] << 16));
+    UART_DMA_Span_t part[2] = { { f, header_len + f[1] + MAVLINK_CHECKSUM_LEN }, { NULL, 0 } };
+    
+    return (idx >= 0 && frame_valid(part, header_len + f[1], msg_table[idx].extra));
+}
+
+uint32_t Bench_BridgeFrames(void)
+{
+    return bridge_link.outage_kept + bridge_link.outage_dropped;
+}
+
+uint32_t Bench_BridgeQueued(void)
+{
+    return (uint32_t)bridge.bulk.raw + bridge.crit.raw;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file    bench_stubs.c
+ * @brief   Stand-ins for the bridge's collaborators: a modem (offline, or
+ *          online with a publish time model) and an outage log that keeps
+ *          every frame (the stores are in store_stubs.c)
+ */
+
+#include "bench.h"
+#include "a7600_mqtt.h"
+#include "outage_log.h"
+#include <string.h>
+
+static MQTT_LinkQuality_t link_quality;
+
+static struct {
+    bool online;
+    uint32_t publish_ms;
+    uint32_t baud;
+    bool busy;                  /* One publish in flight, as the driver allows */
+    uint32_t start;
+    uint32_t duration;
+    MQTT_DoneCallback_t done;
+    void *ctx;
+    Bench_ModemStats_t stats;
+} modem;
+
+void Bench_ModemSetup(bool online, uint32_t publish_ms, uint32_t baud)
+{
+    modem.online = online;
+    modem.publish_ms = publish_ms;
+    modem.baud = baud;
+}
+
+void Bench_ModemPoll(void)
+{
+    if (modem.busy && HAL_GetTick() - modem.start >= modem.duration) {
+        modem.busy = false;
+        if (modem.done != NULL) {
+            modem.done(modem.ctx, MQTT_OK);
+        }
+    }
+}
+
+const Bench_ModemStats_t* Bench_ModemStats(void)
+{
+    return &modem.stats;
+}
+
+/* ==================== Modem driver ==================== */
+
+bool A7600_MQTT_IsConnected(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+    return modem.online;    /* Offline: every valid frame reaches OutageLog_Put */
+}
+
+bool A7600_MQTT_IsBusy(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+    return modem.busy;
+}
+
+uint8_t A7600_MQTT_PublishInFlight(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+    return modem.busy ? 1 : 0;
+}
+
+bool A7600_MQTT_DatagramReady(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+    return false;
+}
+
+MQTT_Result_t A7600_MQTT_SendDatagram(A7600_MQTT_Handle_t *handle, const uint8_t *data, size_t len)
+{
+    (void)handle;
+    (void)data;
+    (void)len;
+    return MQTT_ERROR;
+}
+
+MQTT_Result_t A7600_MQTT_PublishAsync(A7600_MQTT_Handle_t *handle, const char *topic,
+                                       const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                       MQTT_DoneCallback_t done, void *ctx)
+{
+    (void)handle;
+    (void)topic;
+    (void)payload;
+    (void)qos;
+    
+    if (!modem.online || modem.busy) {
+        return MQTT_ERROR;
+    }
+    /* AT+CMQTTPAYLOAD carries the text at the modem UART rate (10 bits a byte) */
+    modem.busy = true;
+    modem.start = HAL_GetTick();
+    modem.duration = modem.publish_ms + (uint32_t)((uint64_t)len * 10000U / modem.baud);
+    modem.done = done;
+    modem.ctx = ctx;
+    modem.stats.publishes++;
+    modem.stats.bytes += (uint32_t)len;
+    if (len > modem.stats.max_len) {
+        modem.stats.max_len = (uint32_t)len;
+    }
+    return MQTT_OK;
+}
+
+MQTT_Result_t A7600_MQTT_TopicDescInit(MQTT_TopicDesc_t *desc, uint8_t client, const char *topic)
+{
+    desc->topic = topic;
+    desc->len = (uint16_t)strlen(topic);
+    desc->client = client;
+    desc->cmd_len = 0;
+    return MQTT_OK;
+}
+
+MQTT_Result_t A7600_MQTT_PublishDescAsync(A7600_MQTT_Handle_t *handle, const MQTT_TopicDesc_t *desc,
+                                           const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                           MQTT_DoneCallback_t done, void *ctx)
+{
+    return A7600_MQTT_PublishAsync(handle, desc->topic, payload, len, qos, done, ctx);
+}
+
+const MQTT_LinkQuality_t* A7600_MQTT_GetLinkQuality(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+    return &link_quality;
+}
+
+bool A7600_MQTT_GetUnixTime(A7600_MQTT_Handle_t *handle, uint32_t tick, uint32_t *sec, uint16_t *ms)
+{
+    (void)handle;
+    (void)tick;
+    (void)sec;
+    (void)ms;
+    return false;       /* No network time: batches go out unstamped */
+}
+
+bool A7600_MQTT_Asleep(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+    return false;
+}
+
+void A7600_MQTT_Wake(A7600_MQTT_Handle_t *handle)
+{
+    (void)handle;
+}
+
+/* ==================== Outage log ==================== */
+
+bool OutageLog_Put(const UART_DMA_Span_t part[2], size_t len)
+{
+    (void)part;
+    (void)len;
+    return true;
+}
+
+size_t OutageLog_Peek(const uint8_t **frame)
+{
+    (void)frame;
+    return 0;
+}
+
+void OutageLog_Pop(void)
+{
+}
@@ -0,0 +1,784 @@
+/**
+ * @file    fuzz.c
+ * @brief   Host fuzz harness of the downlink decoders, the uplink encoders,
+ *          the uplink frame parser and the AT line tokenizer
+ *
+ * Usage: fuzz [options] [out.json]   (default build/fuzz.json)
+ *   -n <inputs>    Inputs per target (default 20000)
+ *   -s <seed>      Input dice (default 1) - the same seed gives the same run
+ *   -t <target>    Only this target (hex, base64, encode, frames, at)
+ *   -r <file>      Run one saved input (a failure written by an earlier run)
+ *
+ * One input goes through LLVMFuzzerTestOneInput: its first byte picks the
+ * target, the rest is the target's input. Without -DFUZZ_LIBFUZZER this
+ * file drives it itself: seeds built per target (encoded frame streams,
+ * frame recipes, modem output), each mutated a few times (bit flips, bytes
+ * of interest, inserts, deletes, repeats). With clang and
+ * -fsanitize=fuzzer -DFUZZ_LIBFUZZER, libFuzzer drives the same entry point
+ * instead, coverage-guided.
+ *
+ * `make fuzz` builds it with -fsanitize=address,undefined: a read or write
+ * past a buffer, or undefined arithmetic, ends the run with a report, the
+ * input written to build/fuzz-crash.bin. Each input is also checked against
+ * a reference model, and one that disagrees is written to
+ * build/fuzz-fail-<target>-<n>.bin (the run exits 1):
+ *   hex, base64   from_hex / from_base64, the text split at random points,
+ *                 leave the downlink queue as the reference decoder's bytes
+ *                 do through the raw decoder (one character at a time, no
+ *                 tables) - queue, counters and bad characters alike
+ *   encode        the encoders in use give the table encoders' text
+ *                 (Bench_CodecCheck) for every length of the input up to 300
+ *   frames        recipe inputs (first byte odd): valid frames between
+ *                 garbage without start bytes, some corrupted - every intact
+ *                 frame is parsed and no corrupted one, at any chunking;
+ *                 other inputs go into USART1 as bytes (safety only)
+ *   at            lines handed out as a split on LF does (CR and blanks
+ *                 stripped, empty lines skipped, classified), at any
+ *                 chunking; inputs with a '>' (prompt) or a line over half
+ *                 the response buffer are checked for safety only
+ *
+ * Throughput is not measured here (sanitized code): `make check` runs this
+ * and then the benchmark, so both come from the same build of the sources.
+ * Report: {"compiler":"...","seed":1,"targets":[{"name":"hex","inputs":..,
+ *          "checked":..,"bytes":..,"failures":0}, ...]}
+ */
+
+#include "bench.h"
+#include "at_engine.h"
+#include "mavlink_bridge.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define FUZZ_INPUT_MAX      4096        /* Bytes of one input, the target byte included */
+#define FUZZ_CHUNK_MAX      256         /* Largest piece a stream is fed in (<= half a ring) */
+#define FUZZ_FAIL_SAVED     4           /* Failing inputs written per target */
+#define FUZZ_LOG_MAX        (FUZZ_INPUT_MAX * 2)    /* Line records of one AT run */
+
+enum {
+    TARGET_HEX = 0,
+    TARGET_BASE64,
+    TARGET_ENCODE,
+    TARGET_FRAMES,
+    TARGET_AT,
+    TARGET_COUNT
+};
+
+typedef struct {
+    const char *name;
+    uint32_t inputs;
+    uint32_t checked;                   /* Held against the reference model, not only run */
+    uint64_t bytes;
+    uint32_t failures;
+} Fuzz_Target_t;
+
+static Fuzz_Target_t targets[TARGET_COUNT] = {
+    { "hex", 0, 0, 0, 0 }, { "base64", 0, 0, 0, 0 }, { "encode", 0, 0, 0, 0 }, { "frames", 0, 0, 0, 0 }, { "at", 0, 0, 0, 0 }
+};
+
+/* Peripherals under test */
+static UART_HandleTypeDef telem_huart, sim_huart;
+static UART_DMA_Handle_t telem, sim;
+static uint8_t telem_rx[TELEM_UART_RX_BUFFER_SIZE], telem_tx[TELEM_UART_TX_BUFFER_SIZE];
+static uint8_t sim_rx[SIM_UART_RX_BUFFER_SIZE], sim_tx[SIM_UART_TX_BUFFER_SIZE];
+static A7600_MQTT_Handle_t mqtt;
+static AT_Engine_t at;
+static uint32_t tick;
+
+/* Input being run, for the crash report */
+static const uint8_t *current;
+static size_t current_len;
+#ifndef FUZZ_LIBFUZZER
+static bool saving = true;      /* Failing inputs written (not when one is replayed) */
+#endif
+
+/* Telemetry mix of the frame streams (no HEARTBEAT: its presence fold keeps some back) */
+static const struct { uint32_t msgid; uint8_t len; } mix[] = {
+    { 30, 28 }, { 33, 28 }, { 74, 20 }, { 1, 31 }, { 24, 30 }
+};
+#define MIX_COUNT           (sizeof(mix) / sizeof(mix[0]))
+
+/* ==================== Chunking ==================== */
+
+static uint32_t chunk_rng;
+
+/**
+ * @brief Dice for where one input is split - follows from the input, so a saved one replays
+ */
+static void chunk_seed(const uint8_t *data, size_t len)
+{
+    chunk_rng = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        chunk_rng = (chunk_rng ^ data[i]) * 16777619U;
+    }
+    chunk_rng |= 1;
+}
+
+static size_t chunk_next(size_t left)
+{
+    size_t n;
+    
+    chunk_rng ^= chunk_rng << 13;
+    chunk_rng ^= chunk_rng >> 17;
+    chunk_rng ^= chunk_rng << 5;
+    n = 1 + chunk_rng % ((chunk_rng >> 28) < 4 ? 4U : FUZZ_CHUNK_MAX);    /* Mostly long, some tiny */
+    return (n < left) ? n : left;
+}
+
+/* ==================== Decoders ==================== */
+
+static int hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+static int base64_value(uint8_t c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    return (c == '+') ? 62 : (c == '/') ? 63 : -1;
+}
+
+/**
+ * @brief Reference decoder: one character at a time, blanks skipped, the rest counted bad
+ * @return Bytes written to out (at most len)
+ */
+static size_t ref_decode(const uint8_t *text, size_t len, bool base64, uint8_t *out, uint16_t *bad)
+{
+    uint32_t acc = 0;
+    unsigned n = 0;
+    size_t o = 0;
+    
+    *bad = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = text[i];
+        int v = base64 ? base64_value(c) : hex_value(c);
+        
+        if (v >= 0) {
+            acc = (acc << (base64 ? 6 : 4)) | (uint32_t)v;
+            if (++n == (base64 ? 4U : 2U)) {
+                if (base64) {
+                    out[o++] = (uint8_t)(acc >> 16);
+                    out[o++] = (uint8_t)(acc >> 8);
+                }
+                out[o++] = (uint8_t)acc;
+                acc = 0;
+                n = 0;
+            }
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            continue;
+        } else if (base64 && c == '=') {
+            /* Padding ends the group: what it holds so far */
+            if (n == 2) {
+                out[o++] = (uint8_t)(acc >> 4);
+            } else if (n == 3) {
+                out[o++] = (uint8_t)(acc >> 10);
+                out[o++] = (uint8_t)(acc >> 2);
+            }
+            acc = 0;
+            n = 0;
+        } else {
+            (*bad)++;
+        }
+    }
+    return o;
+}
+
+static bool fuzz_decode(const uint8_t *data, size_t len, bool base64)
+{
+    static uint8_t bytes[FUZZ_INPUT_MAX], want_q[FUZZ_INPUT_MAX];
+    Bench_Downlink_t want, got;
+    uint16_t bad;
+    size_t n = ref_decode(data, len, base64, bytes, &bad);
+    
+    Bench_DownlinkClear();
+    Bench_FromRaw(bytes, n);
+    Bench_Downlink(&want);
+    memcpy(want_q, want.queue, want.head);
+    want.bad = bad;
+    
+    Bench_DownlinkClear();
+    chunk_seed(data, len);
+    for (size_t pos = 0; pos < len; ) {
+        size_t k = chunk_next(len - pos);
+        
+        if (base64) {
+            Bench_FromBase64(&data[pos], k);
+        } else {
+            Bench_FromHex(&data[pos], k);
+        }
+        pos += k;
+    }
+    Bench_Downlink(&got);
+    
+    return got.head == want.head && got.commit == want.commit && got.cur == want.cur && got.bad == want.bad &&
+           got.rejected == want.rejected && got.unrouted == want.unrouted && got.dropped == want.dropped &&
+           memcmp(got.queue, want_q, want.head) == 0;
+}
+
+/* ==================== Uplink parser ==================== */
+
+static uint8_t no_start(uint8_t b)
+{
+    return (b == 0xFD || b == 0xFE) ? (uint8_t)(b & 0x7F) : b;
+}
+
+/**
+ * @brief Feed a stream into USART1 in pieces and let the bridge parse it (offline)
+ * @return Frames the parser accepted
+ */
+static uint32_t frames_feed(const uint8_t *stream, size_t len)
+{
+    Bench_SetTick(++tick);
+    UART_DMA_Init(&telem, &telem_huart, telem_rx, sizeof(telem_rx), telem_tx, sizeof(telem_tx));
+    MavlinkBridge_Init(&telem, &mqtt);
+    
+    chunk_seed(stream, len);
+    for (size_t pos = 0; pos < len; ) {
+        size_t k = chunk_next(len - pos);
+        
+        Bench_UartReceive(&telem, &stream[pos], k);
+        MavlinkBridge_Process();
+        pos += k;
+    }
+    MavlinkBridge_Process();
+    return Bench_BridgeFrames();
+}
+
+/**
+ * @brief Recipe: each op byte adds garbage, a frame, or corrupts the last frame
+ * @return true if the parser took every intact frame (exactly, when none was corrupted)
+ */
+static bool fuzz_recipe(const uint8_t *data, size_t len)
+{
+    static uint8_t stream[FUZZ_INPUT_MAX * 8];
+    uint8_t payload[255], sent[300];
+    size_t n = 0, last = 0, last_len = 0;
+    uint32_t intact = 0;
+    bool last_intact = true, corrupted = false;
+    uint8_t seq = 0;
+    size_t i = 0;
+    
+    while (i < len && n + 300 <= sizeof(stream)) {
+        uint8_t op = data[i++];
+        
+        switch (op >> 6) {
+        case 0:
+            /* Garbage without start bytes - the parser skips it, never a frame with it */
+            for (unsigned k = 0; k <= (op & 7U) && i < len; k++) {
+                stream[n++] = no_start(data[i++]);
+            }
+            break;
+        
+        case 1:
+        case 2: {
+            unsigned m = op % MIX_COUNT;
+            bool v1 = (op & 0x20) != 0;
+            
+            for (unsigned k = 0; k < mix[m].len; k++) {
+                payload[k] = no_start((i < len) ? data[i++] : (uint8_t)k);
+            }
+            corrupted = corrupted || !last_intact;     /* The frame before stays as it is */
+            last = n;
+            last_len = v1 ? Bench_FrameV1(&stream[n], payload, mix[m].len, seq, mix[m].msgid) :
+                            Bench_Frame(&stream[n], payload, mix[m].len, seq, mix[m].msgid);
+            seq = no_start((uint8_t)(seq + 1));
+            memcpy(sent, &stream[last], last_len);
+            n += last_len;
+            intact++;
+            last_intact = true;
+            break;
+        }
+        
+        default:
+            /* A byte of the last frame changed, its start byte excepted: the CRC catches it */
+            if (last_len > 0 && i < len) {
+                size_t at = 1 + (op & 63U) % (last_len - 1);
+                bool was = last_intact;
+                
+                stream[last + at] = no_start(stream[last + at] ^ data[i++]);
+                last_intact = (memcmp(&stream[last], sent, last_len) == 0);    /* A second change may undo one */
+                if (was != last_intact) {
+                    intact = last_intact ? intact + 1 : intact - 1;
+                }
+            }
+            break;
+        }
+    }
+    
+    uint32_t parsed = frames_feed(stream, n);
+    
+    corrupted = corrupted || !last_intact;
+    
+    return corrupted ? parsed <= intact : parsed == intact;
+}
+
+/* ==================== AT tokenizer ==================== */
+
+static uint8_t at_log[FUZZ_LOG_MAX];
+static size_t at_log_len;
+static bool at_log_full;
+
+static void log_line(uint8_t *log, size_t *log_len, bool *full, const char *line, size_t len, AT_LineType_t type)
+{
+    if (*log_len + 3 + len > FUZZ_LOG_MAX) {
+        *full = true;
+        return;
+    }
+    log[(*log_len)++] = (uint8_t)type;
+    log[(*log_len)++] = (uint8_t)len;
+    log[(*log_len)++] = (uint8_t)(len >> 8);
+    memcpy(&log[*log_len], line, len);
+    *log_len += len;
+}
+
+static void at_line(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    (void)ctx;
+    log_line(at_log, &at_log_len, &at_log_full, line, len, type);
+}
+
+/**
+ * @brief Reference classification: final results, "+" codes, the rest
+ */
+static AT_LineType_t ref_classify(const uint8_t *line, size_t len)
+{
+    if (len == 2 && memcmp(line, "OK", 2) == 0) {
+        return AT_LINE_OK;
+    }
+    if ((len == 5 && memcmp(line, "ERROR", 5) == 0) ||
+        (len >= 10 && (memcmp(line, "+CME ERROR", 10) == 0 || memcmp(line, "+CMS ERROR", 10) == 0))) {
+        return AT_LINE_ERROR;
+    }
+    return (line[0] == '+') ? AT_LINE_URC : AT_LINE_DATA;
+}
+
+static bool fuzz_at(const uint8_t *data, size_t len, bool *checked)
+{
+    static const AT_Urc_t urcs[] = {
+        { "+CMQTTRXSTART:", at_line },
+        { "+CMQTTRXPAYLOAD:", at_line },
+        { "+CMQTTPUB:", at_line },
+        { "+CSQ:", at_line },
+    };
+    static uint8_t want[FUZZ_LOG_MAX];
+    size_t want_len = 0, start = 0;
+    bool want_full = false;
+    
+    /* The engine's lines */
+    Bench_SetTick(++tick);
+    UART_DMA_Init(&sim, &sim_huart, sim_rx, sizeof(sim_rx), sim_tx, sizeof(sim_tx));
+    AT_Engine_Init(&at, &sim);
+    AT_Engine_SetLineHandler(&at, urcs, sizeof(urcs) / sizeof(urcs[0]), at_line, NULL);
+    at_log_len = 0;
+    at_log_full = false;
+    chunk_seed(data, len);
+    for (size_t pos = 0; pos < len; ) {
+        size_t k = chunk_next(len - pos);
+        
+        Bench_UartReceive(&sim, &data[pos], k);
+        while (AT_Engine_Process(&at) > 0) {
+        }
+        pos += k;
+    }
+    
+    /* A prompt depends on where the bytes broke off, a long line on the buffer: not modelled */
+    *checked = (memchr(data, '>', len) == NULL);
+    for (size_t i = 0; i <= len && *checked; i++) {
+        if (i == len || data[i] == '\n') {
+            if (i - start >= AT_RX_BUFFER_SIZE / 2) {
+                *checked = false;
+            }
+            start = i + 1;
+        }
+    }
+    if (!*checked) {
+        return true;
+    }
+    
+    /* Reference: split on LF, the unterminated rest waits */
+    start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != '\n') {
+            continue;
+        }
+        size_t n = i - start;
+        
+        while (n > 0 && (data[start + n - 1] == '\r' || data[start + n - 1] == ' ')) {
+            n--;
+        }
+        if (n > 0) {
+            log_line(want, &want_len, &want_full, (const char *)&data[start], n, ref_classify(&data[start], n));
+        }
+        start = i + 1;
+    }
+    return want_full == at_log_full && want_len == at_log_len && memcmp(want, at_log, want_len) == 0;
+}
+
+/* ==================== Entry point ==================== */
+
+/**
+ * @brief Run one input: the first byte picks the target
+ * @return 0 (libFuzzer convention); a disagreement is counted in its target
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    Fuzz_Target_t *t;
+    bool ok = true, checked = true;
+    
+    if (size == 0 || size > FUZZ_INPUT_MAX) {
+        return 0;
+    }
+    current = data;
+    current_len = size;
+    t = &targets[data[0] % TARGET_COUNT];
+    data++;
+    size--;
+    
+    switch (t - targets) {
+    case TARGET_HEX:
+        ok = fuzz_decode(data, size, false);
+        break;
+    case TARGET_BASE64:
+        ok = fuzz_decode(data, size, true);
+        break;
+    case TARGET_ENCODE:
+        ok = Bench_CodecCheck(data, (size < 300) ? size : 300);
+        break;
+    case TARGET_FRAMES:
+        if (size > 0 && (data[0] & 1)) {
+            ok = fuzz_recipe(&data[1], size - 1);
+        } else {
+            (void)frames_feed(data, size);
+            checked = false;
+        }
+        break;
+    default:
+        ok = fuzz_at(data, size, &checked);
+        break;
+    }
+    
+    t->inputs++;
+    t->checked += checked ? 1U : 0U;
+    t->bytes += size;
+    if (!ok) {
+#ifdef FUZZ_LIBFUZZER
+        abort();        /* libFuzzer keeps the input */
+#else
+        char path[64];
+        FILE *f;
+        
+        if (saving && t->failures < FUZZ_FAIL_SAVED) {
+            snprintf(path, sizeof(path), "build/fuzz-fail-%s-%u.bin", t->name, (unsigned)t->failures);
+            f = fopen(path, "wb");
+            if (f != NULL) {
+                fwrite(current, 1, current_len, f);
+                fclose(f);
+            }
+            fprintf(stderr, "fuzz: %s disagrees with its reference model (%zu B), saved as %s\n",
+                    t->name, size, path);
+        }
+        t->failures++;
+#endif
+    }
+    return 0;
+}
+
+/**
+ * @brief Bring up the peripherals and the bridge the targets use (libFuzzer calls it too)
+ */
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+    Bench_UartSetup(&telem_huart, 921600);
+    Bench_UartSetup(&sim_huart, 115200);
+    UART_DMA_Init(&telem, &telem_huart, telem_rx, sizeof(telem_rx), telem_tx, sizeof(telem_tx));
+    UART_DMA_Init(&sim, &sim_huart, sim_rx, sizeof(sim_rx), sim_tx, sizeof(sim_tx));
+    MavlinkBridge_Init(&telem, &mqtt);
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+/* ==================== Inputs ==================== */
+
+static uint32_t rng = 1;
+
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/**
+ * @brief A stream of valid frames from the mix, random payloads
+ */
+static size_t seed_frames(uint8_t *f, size_t max)
+{
+    uint8_t payload[255];
+    size_t n = 0;
+    unsigned count = 1 + rand32() % 12;
+    
+    for (unsigned i = 0; i < count; i++) {
+        unsigned m = rand32() % MIX_COUNT;
+        
+        if (n + 12 + mix[m].len + 2 > max) {
+            break;
+        }
+        for (unsigned k = 0; k < mix[m].len; k++) {
+            payload[k] = (uint8_t)rand32();
+        }
+        n += Bench_Frame(&f[n], payload, mix[m].len, (uint8_t)i, mix[m].msgid);
+    }
+    return n;
+}
+
+/**
+ * @brief A seed for the target: what it sees in service
+ * @return Input length, the target byte included
+ */
+static size_t seed_input(uint8_t target, uint8_t *in)
+{
+    static const char *const modem[] = {
+        "+CMQTTRXSTART: 0,18,44\r\n", "+CMQTTRXTOPIC: 0,18\r\n", "uav4g/mavlink/down\r\n",
+        "+CMQTTRXPAYLOAD: 0,44\r\n", "/RwAAAEB/wAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=\r\n", "+CMQTTRXEND: 0\r\n",
+        "OK\r\n", "ERROR\r\n", "+CME ERROR: 3\r\n", "+CMQTTPUB: 0,0\r\n", "AT+CSQ\r\r\n", "+CSQ: 21,99\r\n",
+        "\r\n", "+CMQTTCONNLOST: 0,1\r\n", "RDY\r\n", "> "
+    };
+    uint8_t frames[FUZZ_INPUT_MAX / 3];
+    size_t n = 1, len;
+    
+    in[0] = target;
+    switch (target) {
+    case TARGET_HEX:
+        len = seed_frames(frames, sizeof(frames) / 2 - 1);
+        n += Bench_ToHex(frames, len, (char *)&in[1]);
+        break;
+    case TARGET_BASE64:
+        len = seed_frames(frames, sizeof(frames) / 2 - 1);
+        n += Bench_ToBase64(frames, len, (char *)&in[1]);
+        break;
+    case TARGET_ENCODE:
+        len = rand32() % 301;
+        for (size_t i = 0; i < len; i++) {
+            in[n++] = (uint8_t)rand32();
+        }
+        break;
+    case TARGET_FRAMES:
+        if (rand32() & 1) {
+            in[n++] = 1;        /* Recipe */
+            len = 8 + rand32() % 512;
+            for (size_t i = 0; i < len; i++) {
+                in[n++] = (uint8_t)rand32();
+            }
+        } else {
+            in[n++] = 0;
+            n += seed_frames(&in[n], FUZZ_INPUT_MAX / 2);
+        }
+        break;
+    default:
+        for (unsigned k = 1 + rand32() % 24; k > 0; k--) {
+            const char *line = modem[rand32() % (sizeof(modem) / sizeof(modem[0]) - 1U)];
+            
+            len = strlen(line);
+            if (n + len > FUZZ_INPUT_MAX / 2) {
+                break;
+            }
+            memcpy(&in[n], line, len);
+            n += len;
+        }
+        if ((rand32() % 8) == 0) {
+            memcpy(&in[n], "> ", 2);    /* A data prompt at the end */
+            n += 2;
+        }
+        break;
+    }
+    return n;
+}
+
+/**
+ * @brief Change the input (its target byte stays) a few times
+ */
+static size_t mutate(uint8_t *in, size_t n)
+{
+    static const uint8_t interesting[] = { 0x00, 0xFF, 0xFD, 0xFE, '=', '\r', '\n', ' ', '>', '+', 0x80, 0x7F };
+    
+    for (unsigned k = rand32() % 5; k > 0; k--) {
+        size_t at = 1 + ((n > 1) ? rand32() % (n - 1) : 0);
+        
+        switch (rand32() % 6) {
+        case 0:
+            if (at < n) {
+                in[at] ^= (uint8_t)(1U << (rand32() % 8));
+            }
+            break;
+        case 1:
+            if (at < n) {
+                in[at] = interesting[rand32() % sizeof(interesting)];
+            }
+            break;
+        case 2:
+            if (n < FUZZ_INPUT_MAX) {
+                memmove(&in[at + 1], &in[at], n - at);
+                in[at] = (uint8_t)rand32();
+                n++;
+            }
+            break;
+        case 3:
+            if (at < n) {
+                memmove(&in[at], &in[at + 1], n - at - 1);
+                n--;
+            }
+            break;
+        case 4:
+            n = at;             /* Cut short */
+            break;
+        default: {
+            /* A piece repeated in place */
+            size_t from = 1 + ((n > 1) ? rand32() % (n - 1) : 0);
+            size_t len = (from < n) ? 1 + rand32() % (n - from) : 0;
+            
+            if (len > FUZZ_INPUT_MAX - n) {
+                len = FUZZ_INPUT_MAX - n;
+            }
+            memmove(&in[at + len], &in[at], n - at);
+            memmove(&in[at], &in[(from < at) ? from : from + len], len);
+            n += len;
+            break;
+        }
+        }
+    }
+    return n;
+}
+
+/* ==================== Main ==================== */
+
+#if defined(__SANITIZE_ADDRESS__)
+static void crash_save(void)
+{
+    FILE *f = fopen("build/fuzz-crash.bin", "wb");
+    
+    if (f != NULL && current != NULL) {
+        fwrite(current, 1, current_len, f);
+        fclose(f);
+        fprintf(stderr, "fuzz: input saved as build/fuzz-crash.bin (fuzz -r build/fuzz-crash.bin)\n");
+    }
+}
+#endif
+
+static bool write_json(const char *path, uint32_t seed)
+{
+    FILE *f = fopen(path, "w");
+    
+    if (f == NULL) {
+        return false;
+    }
+    fprintf(f, "{\"compiler\":\"%s\",\"seed\":%u,\"targets\":[", __VERSION__, (unsigned)seed);
+    for (size_t i = 0; i < TARGET_COUNT; i++) {
+        const Fuzz_Target_t *t = &targets[i];
+        
+        fprintf(f, "%s\n  {\"name\":\"%s\",\"inputs\":%u,\"checked\":%u,\"bytes\":%llu,\"failures\":%u}",
+                i ? "," : "", t->name, (unsigned)t->inputs, (unsigned)t->checked,
+                (unsigned long long)t->bytes, (unsigned)t->failures);
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t in[FUZZ_INPUT_MAX + 1];
+    const char *out = "build/fuzz.json", *only = NULL, *replay = NULL;
+    uint32_t inputs = 20000, seed = 1, failures = 0;
+    int arg = 1;
+    
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        const char *v = argv[arg + 1];
+        
+        switch (argv[arg][1]) {
+        case 'n': inputs = (uint32_t)strtoul(v, NULL, 10); break;
+        case 's': seed = (uint32_t)strtoul(v, NULL, 10); break;
+        case 't': only = v; break;
+        case 'r': replay = v; break;
+        default: arg = argc; break;
+        }
+    }
+    if (arg > argc) {
+        fprintf(stderr, "usage: fuzz [-n inputs] [-s seed] [-t hex|base64|encode|frames|at] [-r input.bin] [out.json]\n");
+        return 2;
+    }
+    if (arg < argc) {
+        out = argv[arg];
+    }
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(crash_save);
+#endif
+    LLVMFuzzerInitialize(&argc, &argv);
+    
+    if (replay != NULL) {
+        FILE *f = fopen(replay, "rb");
+        size_t n;
+        
+        if (f == NULL) {
+            fprintf(stderr, "fuzz: cannot read %s\n", replay);
+            return 2;
+        }
+        n = fread(in, 1, sizeof(in), f);
+        fclose(f);
+        saving = false;
+        LLVMFuzzerTestOneInput(in, n);
+        for (size_t i = 0; i < TARGET_COUNT; i++) {
+            failures += targets[i].failures;
+        }
+        printf("%s: %s\n", replay, failures ? "disagrees" : "ok");
+        return failures ? 1 : 0;
+    }
+    
+    rng = seed * 2654435761U | 1;
+    for (uint8_t t = 0; t < TARGET_COUNT; t++) {
+        if (only != NULL && strcmp(only, targets[t].name) != 0) {
+            continue;
+        }
+        for (uint32_t i = 0; i < inputs; ) {
+            size_t n = seed_input(t, in);
+            
+            /* The seed as it is, then mutants of it */
+            for (unsigned k = 0; k < 8 && i < inputs; k++, i++) {
+                LLVMFuzzerTestOneInput(in, n);
+                n = mutate(in, n);
+            }
+        }
+        failures += targets[t].failures;
+        printf("%-8s %8u inputs %8u checked %10llu B %6u failures\n", targets[t].name,
+               (unsigned)targets[t].inputs, (unsigned)targets[t].checked,
+               (unsigned long long)targets[t].bytes, (unsigned)targets[t].failures);
+    }
+    if (!write_json(out, seed)) {
+        fprintf(stderr, "fuzz: cannot write %s\n", out);
+        return 1;
+    }
+    printf("Results written to %s\n", out);
+    return failures ? 1 : 0;
+}
+
+#endif /* FUZZ_LIBFUZZER */
@@ -0,0 +1,1005 @@
+/**
+ * @file    modem_sim.c
+ * @brief   A7600 model for host runs of the MQTT driver: answers the AT
+ *          commands the driver sends, keeps the MQTT service, client and SSL
+ *          state, plays a broker, and injects faults at set rates
+ *
+ * Answers are queued with a due time and go into the UART's RX ring when
+ * it comes: the command's bytes at the UART rate first, then a fixed delay
+ * for what the network does (connect_ms, publish_ms, plus the payload at
+ * uplink_bps behind the publishes queued before it when that is set). There is no echo
+ * (ATE0), and a baud change is taken without a gap. Commands the model
+ * does not know get ERROR and are counted, so a driver change that starts
+ * sending something new shows up in the stats instead of hanging.
+ *
+ * Faults: +CMQTTCONNLOST in the middle of a publish (the session is down
+ * until the driver connects it again), ERROR in place of the OK after the
+ * AT+CMQTTPAYLOAD data, and bursts of random bytes at any time.
+ *
+ * Messages from the broker (Bench_SimInbound) go out in the next millisecond
+ * whatever the driver is doing - between a prompt and its data, or while a
+ * payload is still on the wire - as the module sends them.
+ *
+ * AT+CMUX (the MQTT_CMUX build) switches to 27.010 frames after its OK: the
+ * model opens the channels the driver asks for, answers modem status and
+ * close-down, runs the AT channel through the parser above and commands on
+ * the monitoring channel with their answers on that channel. Noise stays
+ * outside the frames.
+ *
+ * Each answer's due time and the next noise roll go to Bench_WakeAt, so a
+ * harness jumping the clock (soak -j) lands on them exactly.
+ */
+
+#include "bench.h"
+#include "a7600_mqtt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_EVENTS          32          /* Answers waiting for their time */
+#define SIM_TEXT_MAX        320         /* One answer */
+#define SIM_LINE_MAX        256         /* One command line */
+#define SIM_DATA_MAX        MQTT_PAYLOAD_MAX_LEN    /* Data after a prompt (the module's payload limit) */
+#define SIM_PUBS            4           /* Publishes in flight per client (driver window + 1) */
+#define SIM_TOPIC_MAX       64
+#define SIM_START_MS        30          /* AT+CMQTTSTART to +CMQTTSTART: 0 */
+#define SIM_GARBAGE_MAX     24          /* Bytes per noise burst */
+#define SIM_WAKE_MS         30          /* DTR low to the UART listening again */
+#define SIM_MUX_MAX         (CMUX_N1 + 8)   /* One frame from the driver */
+
+/* What an answer does when it goes out */
+enum {
+    EV_TEXT = 0,
+    EV_STARTED,         /* MQTT service up */
+    EV_CONNECTED,       /* Session of client up */
+    EV_PUB_DONE,        /* Publish of client delivered */
+    EV_CONNLOST,        /* Session of client lost, its publishes with it */
+    EV_MUX_ON,          /* AT+CMUX answered: frames from now on */
+    EV_FRAME,           /* A whole multiplexer frame, sent as is */
+    EV_MUX_OFF          /* ... the last one before plain text again */
+};
+
+/* Data expected after the prompt */
+enum {
+    DATA_NONE = 0,
+    DATA_TOPIC,
+    DATA_PAYLOAD,
+    DATA_SUB,
+    DATA_CERT,
+    DATA_FILE,
+    DATA_WILL
+};
+
+typedef struct {
+    uint32_t due;
+    uint8_t kind;
+    uint8_t client;
+    uint8_t dlc;                        /* Multiplexer channel of the text */
+    uint16_t len;
+    char text[SIM_TEXT_MAX];
+} Sim_Event_t;
+
+typedef struct {
+    char topic[SIM_TOPIC_MAX];
+    uint8_t payload[SIM_DATA_MAX];
+    size_t len;
+} Sim_Pub_t;
+
+static struct {
+    UART_DMA_Handle_t *uart;
+    Bench_SimConfig_t config;
+    Bench_SimPublishFn_t publish;
+    Bench_SimStats_t stats;
+    uint32_t rand;
+    uint32_t second;                    /* Last garbage roll */
+    uint32_t rdy;                       /* Boot done: deaf to commands before */
+    bool csclk;                         /* AT+CSCLK=1: asleep while DTR is high */
+    bool dtr_high;
+    uint32_t dtr_tick;                  /* DTR last changed */
+    uint32_t uplink_free;               /* Publishes queued for the network are through by then */
+    
+    Sim_Event_t events[SIM_EVENTS];
+    uint8_t event_count;
+    
+    /* Command parser */
+    char line[SIM_LINE_MAX];
+    size_t line_len;
+    bool skip_lf;
+    uint8_t data_kind;
+    uint8_t data_client;
+    size_t data_need;
+    size_t data_len;
+    uint8_t data[SIM_DATA_MAX];
+    
+    /* Multiplexer: frame being received, monitoring channel line */
+    bool mux;
+    bool mux_asked;                     /* AT+CMUX in the line being run */
+    uint8_t mux_open;                   /* Bit per DLC */
+    uint8_t dlc;                        /* Channel answers go on */
+    uint8_t mux_frame[SIM_MUX_MAX];
+    size_t mux_len;
+    size_t mux_need;                    /* Frame length once its length field is in (0: not yet) */
+    char mon[SIM_LINE_MAX];
+    size_t mon_len;
+    
+    /* Module state */
+    bool cgact;
+    char apn[32];
+    bool mqtt_started;
+    uint8_t acquired;                   /* Bit per client */
+    uint8_t connected;                  /* Bit per client */
+    char server[MQTT_MAX_CLIENTS][SIM_TOPIC_MAX];   /* AT+CMQTTCONNECT <server_addr> */
+    uint8_t ssl_version, ssl_auth, ssl_time, ssl_sni;
+    char ssl_ca[32];
+    char cert[32];                      /* File on the module */
+    
+    /* Broker side: topic of the next publish, payloads in flight */
+    char topic[MQTT_MAX_CLIENTS][SIM_TOPIC_MAX];
+    Sim_Pub_t pub[MQTT_MAX_CLIENTS][SIM_PUBS];
+    uint8_t pub_head[MQTT_MAX_CLIENTS];
+    uint8_t pub_count[MQTT_MAX_CLIENTS];
+    bool payload_ok[MQTT_MAX_CLIENTS];
+} sim;
+
+/**
+ * @brief Dice: 0 .. n-1 (xorshift32)
+ */
+static uint32_t sim_rand(uint32_t n)
+{
+    sim.rand ^= sim.rand << 13;
+    sim.rand ^= sim.rand >> 17;
+    sim.rand ^= sim.rand << 5;
+    return sim.rand % n;
+}
+
+static bool sim_roll(uint16_t per_mille)
+{
+    return per_mille > 0 && sim_rand(1000) < per_mille;
+}
+
+/**
+ * @brief Queue an answer due in ms (plus the line time of what was just sent)
+ */
+static Sim_Event_t *sim_queue(uint32_t ms, uint8_t kind, uint8_t client, const char *text)
+{
+    Sim_Event_t *ev;
+    
+    if (sim.event_count >= SIM_EVENTS) {
+        return NULL;                    /* The driver cannot have this much in flight */
+    }
+    ev = &sim.events[sim.event_count++];
+    ev->due = HAL_GetTick() + ms;
+    Bench_WakeAt(ev->due);
+    ev->kind = kind;
+    ev->client = client;
+    ev->dlc = sim.dlc;
+    ev->len = 0;
+    if (text != NULL) {
+        ev->len = (uint16_t)snprintf(ev->text, sizeof(ev->text), "%s", text);
+    }
+    return ev;
+}
+
+/**
+ * @brief Append a line "\r\n<text>\r\n" to an answer
+ */
+static void sim_line(Sim_Event_t *ev, const char *text)
+{
+    if (ev != NULL) {
+        ev->len += (uint16_t)snprintf(&ev->text[ev->len], sizeof(ev->text) - ev->len, "\r\n%s\r\n", text);
+        if (ev->len >= sizeof(ev->text)) {
+            ev->len = sizeof(ev->text) - 1;
+        }
+    }
+}
+
+/**
+ * @brief Bytes of a command or data block on the modem UART, in ms
+ */
+static uint32_t sim_wire_ms(size_t len)
+{
+    uint32_t baud = UART_DMA_GetBaudRate(sim.uart);
+    
+    return (uint32_t)(((uint64_t)len * 10000U + baud - 1) / baud);
+}
+
+/**
+ * @brief Numeric argument index of "x=a,b,c" (0 if there is none)
+ */
+static uint32_t sim_arg(const char *cmd, uint8_t index)
+{
+    const char *p = strchr(cmd, '=');
+    
+    if (p == NULL) {
+        return 0;
+    }
+    p++;
+    while (index-- > 0) {
+        p = strchr(p, ',');
+        if (p == NULL) {
+            return 0;
+        }
+        p++;
+    }
+    return (uint32_t)strtoul(p, NULL, 10);
+}
+
+/**
+ * @brief Quoted string argument index of "x=a,b,c" into out
+ */
+static void sim_str(const char *cmd, uint8_t index, char *out, size_t size)
+{
+    const char *p = strchr(cmd, '=');
+    size_t n = 0;
+    
+    out[0] = '\0';
+    if (p == NULL) {
+        return;
+    }
+    p++;
+    while (index-- > 0) {
+        p = strchr(p, ',');
+        if (p == NULL) {
+            return;
+        }
+        p++;
+    }
+    if (*p == '"') {
+        p++;
+    }
+    while (*p != '\0' && *p != '"' && *p != ',' && n + 1 < size) {
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+}
+
+static bool sim_prefix(const char *cmd, const char *prefix)
+{
+    return strncmp(cmd, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * @brief Drop the client's publishes in flight - the broker never got them
+ */
+static void sim_pub_fail_all(uint8_t client)
+{
+    while (sim.pub_count[client] > 0) {
+        Sim_Pub_t *p = &sim.pub[client][sim.pub_head[client]];
+        
+        if (sim.publish != NULL) {
+            sim.publish(p->topic, p->payload, p->len, false);
+        }
+        sim.pub_head[client] = (uint8_t)((sim.pub_head[client] + 1) % SIM_PUBS);
+        sim.pub_count[client]--;
+    }
+}
+
+/**
+ * @brief One command of a line ("AT+A;+B" is two); info lines go to ev
+ * @return false: ERROR for the whole line
+ */
+static bool sim_command(const char *cmd, Sim_Event_t *ev, uint32_t wire)
+{
+    char text[SIM_TEXT_MAX];
+    uint8_t c = (uint8_t)sim_arg(cmd, 0);
+    
+    if (c >= MQTT_MAX_CLIENTS) {
+        c = 0;
+    }
+    
+    if (cmd[0] == '\0' || sim_prefix(cmd, "+IPR=") || sim_prefix(cmd, "+IFC=") ||
+        sim_prefix(cmd, "+CREG=") || sim_prefix(cmd, "+CGREG=") || sim_prefix(cmd, "+CEREG=") ||
+        sim_prefix(cmd, "+CMQTTSSLCFG=") || sim_prefix(cmd, "+CMQTTUNSUB=") ||
+        sim_prefix(cmd, "+CGAUTH=") || sim_prefix(cmd, "+CNMP=") || sim_prefix(cmd, "+CNBP=")) {
+        return true;
+    }
+    if (strcmp(cmd, "+CPIN?") == 0) {
+        sim_line(ev, "+CPIN: READY");
+    } else if (strcmp(cmd, "+CREG?") == 0) {
+        sim_line(ev, "+CREG: 1,1");
+    } else if (strcmp(cmd, "+CGREG?") == 0) {
+        sim_line(ev, "+CGREG: 1,1");
+    } else if (strcmp(cmd, "+CEREG?") == 0) {
+        sim_line(ev, "+CEREG: 2,1");
+    } else if (strcmp(cmd, "+CGDCONT?") == 0) {
+        if (sim.apn[0] != '\0') {
+            snprintf(text, sizeof(text), "+CGDCONT: 1,\"IP\",\"%s\",\"0.0.0.0\",0,0", sim.apn);
+            sim_line(ev, text);
+        }
+    } else if (sim_prefix(cmd, "+CGDCONT=")) {
+        sim_str(cmd, 2, sim.apn, sizeof(sim.apn));
+    } else if (strcmp(cmd, "+CGACT?") == 0) {
+        sim_line(ev, sim.cgact ? "+CGACT: 1,1" : "+CGACT: 1,0");
+    } else if (sim_prefix(cmd, "+CGACT=")) {
+        sim.cgact = (c != 0);
+    } else if (strcmp(cmd, "+CICCID") == 0) {
+        sim_line(ev, "+ICCID: 89840480001234567890");
+    } else if (strcmp(cmd, "+CIMI") == 0) {
+        sim_line(ev, "452040123456789");
+    } else if (strcmp(cmd, "+CGPADDR=1") == 0) {
+        sim_line(ev, sim.cgact ? "+CGPADDR: 1,10.64.12.7" : "+CGPADDR: 1,0.0.0.0");
+    } else if (strcmp(cmd, "+CCLK?") == 0) {
+        uint32_t s = HAL_GetTick() / 1000U;     /* Network time: 2026-01-01 00:00 UTC+7 at tick 0 */
+        
+        snprintf(text, sizeof(text), "+CCLK: \"26/01/%02u,%02u:%02u:%02u+28\"", (unsigned)(s / 86400U % 31U + 1U),
+                 (unsigned)(s / 3600U % 24U), (unsigned)(s / 60U % 60U), (unsigned)(s % 60U));
+        sim_line(ev, text);
+    } else if (sim_prefix(cmd, "+CMUX=")) {
+        if (sim.mux || sim_arg(cmd, 0) != 0 || sim_arg(cmd, 1) != 0 || sim_arg(cmd, 3) > CMUX_N1) {
+            return false;
+        }
+        sim.mux_asked = true;
+    } else if (sim_prefix(cmd, "+CSCLK=")) {
+        sim.csclk = (c == 1);
+    } else if (strcmp(cmd, "+CSQ") == 0) {
+        sim_line(ev, "+CSQ: 21,99");
+    } else if (strcmp(cmd, "+CPSI?") == 0) {
+        sim_line(ev, "+CPSI: LTE,Online,452-04,0x3A2B,27446283,302,EUTRAN-BAND3,1850,5,5,-105,-920,-640,14");
+    } else if (strcmp(cmd, "+CMQTTSTART") == 0) {
+        if (sim.mqtt_started) {
+            return false;
+        }
+        sim_queue(wire + SIM_START_MS, EV_STARTED, 0, "\r\n+CMQTTSTART: 0\r\n");
+    } else if (strcmp(cmd, "+CMQTTSTOP") == 0) {
+        if (!sim.mqtt_started) {
+            return false;
+        }
+        sim.mqtt_started = false;
+        for (uint8_t i = 0; i < MQTT_MAX_CLIENTS; i++) {
+            sim_pub_fail_all(i);
+        }
+        sim.acquired = 0;
+        sim.connected = 0;
+        sim_queue(wire + SIM_START_MS, EV_TEXT, 0, "\r\n+CMQTTSTOP: 0\r\n");
+    } else if (sim_prefix(cmd, "+CMQTTACCQ=")) {
+        if (!sim.mqtt_started || (sim.acquired & (1u << c))) {
+            return false;
+        }
+        sim.acquired |= (uint8_t)(1u << c);
+    } else if (sim_prefix(cmd, "+CMQTTREL=")) {
+        if (!(sim.acquired & (1u << c)) || (sim.connected & (1u << c))) {
+            return false;
+        }
+        sim.acquired &= (uint8_t)~(1u << c);
+    } else if (sim_prefix(cmd, "+CMQTTDISC=")) {
+        if (!(sim.connected & (1u << c))) {
+            return false;
+        }
+        sim.connected &= (uint8_t)~(1u << c);
+        sim_pub_fail_all(c);
+        snprintf(text, sizeof(text), "\r\n+CMQTTDISC: %u,0\r\n", (unsigned)c);
+        sim_queue(wire + 20, EV_TEXT, c, text);
+    } else if (sim_prefix(cmd, "+CMQTTCONNECT=")) {
+        if (!(sim.acquired & (1u << c)) || (sim.connected & (1u << c))) {
+            return false;
+        }
+        sim_str(cmd, 1, sim.server[c], sizeof(sim.server[c]));
+        snprintf(text, sizeof(text), "\r\n+CMQTTCONNECT: %u,0\r\n", (unsigned)c);
+        sim_queue(wire + sim.config.connect_ms, EV_CONNECTED, c, text);
+    } else if (strcmp(cmd, "+CMQTTCONNECT?") == 0) {
+        if (!sim.mqtt_started) {
+            return false;
+        }
+        for (uint8_t i = 0; i < MQTT_MAX_CLIENTS; i++) {
+            if (sim.connected & (1u << i)) {
+                snprintf(text, sizeof(text), "+CMQTTCONNECT: %u,\"%s\",60,1", (unsigned)i, sim.server[i]);
+            } else {
+                snprintf(text, sizeof(text), "+CMQTTCONNECT: %u", (unsigned)i);
+            }
+            sim_line(ev, text);
+        }
+    } else if (strcmp(cmd, "+CSSLCFG?") == 0) {
+        snprintf(text, sizeof(text), "+CSSLCFG: 0,%u,%u,%u,120,\"%s\",\"\",\"\",%u", (unsigned)sim.ssl_version,
+                 (unsigned)sim.ssl_auth, (unsigned)sim.ssl_time, sim.ssl_ca, (unsigned)sim.ssl_sni);
+        sim_line(ev, text);
+    } else if (sim_prefix(cmd, "+CSSLCFG=")) {
+        char name[20];
+        
+        sim_str(cmd, 0, name, sizeof(name));
+        if (strcmp(name, "sslversion") == 0) {
+            sim.ssl_version = (uint8_t)sim_arg(cmd, 2);
+        } else if (strcmp(name, "authmode") == 0) {
+            sim.ssl_auth = (uint8_t)sim_arg(cmd, 2);
+        } else if (strcmp(name, "ignorelocaltime") == 0) {
+            sim.ssl_time = (uint8_t)sim_arg(cmd, 2);
+        } else if (strcmp(name, "enableSNI") == 0) {
+            sim.ssl_sni = (uint8_t)sim_arg(cmd, 2);
+        } else if (strcmp(name, "cacert") == 0) {
+            sim_str(cmd, 2, sim.ssl_ca, sizeof(sim.ssl_ca));
+        } else {
+            return false;
+        }
+    } else if (strcmp(cmd, "+CCERTLIST") == 0) {
+        if (sim.cert[0] != '\0') {
+            snprintf(text, sizeof(text), "+CCERTLIST: \"%s\"", sim.cert);
+            sim_line(ev, text);
+        }
+    } else if (strcmp(cmd, "+CMQTTSUB=0") == 0 || strcmp(cmd, "+CMQTTSUB=1") == 0) {
+        /* Multi-topic execute */
+        if (!(sim.connected & (1u << c))) {
+            return false;
+        }
+        snprintf(text, sizeof(text), "\r\n+CMQTTSUB: %u,0\r\n", (unsigned)c);
+        sim_queue(wire + 50, EV_TEXT, c, text);
+    } else {
+        sim.stats.unknown++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Commands followed by a data block: prompt now, the rest once it is in
+ * @return true if cmd is one of them
+ */
+static bool sim_data_command(const char *cmd, uint32_t wire)
+{
+    uint8_t kind = DATA_NONE;
+    size_t need = sim_arg(cmd, 1);
+    
+    if (sim_prefix(cmd, "AT+CMQTTTOPIC=")) {
+        kind = DATA_TOPIC;
+    } else if (sim_prefix(cmd, "AT+CMQTTPAYLOAD=")) {
+        kind = DATA_PAYLOAD;
+    } else if (sim_prefix(cmd, "AT+CMQTTSUB=") && strchr(cmd, ',') != NULL) {
+        kind = DATA_SUB;
+    } else if (sim_prefix(cmd, "AT+CMQTTSUBTOPIC=")) {
+        kind = DATA_TOPIC;                  /* Topic of a multi-topic subscribe - kept like one */
+    } else if (sim_prefix(cmd, "AT+CCERTDOWN=")) {
+        kind = DATA_CERT;
+    } else if (sim_prefix(cmd, "AT+CFTRANRX=")) {
+        kind = DATA_FILE;                   /* File system write - taken and dropped */
+    } else if (sim_prefix(cmd, "AT+CMQTTWILLTOPIC=") || sim_prefix(cmd, "AT+CMQTTWILLMSG=")) {
+        kind = DATA_WILL;                   /* Kept by the module, never published here */
+    } else {
+        return false;
+    }
+    
+    sim.data_client = (uint8_t)sim_arg(cmd, 0);
+    if (kind == DATA_CERT) {
+        sim_str(cmd, 0, sim.cert, sizeof(sim.cert));
+    }
+    if (kind == DATA_CERT || kind == DATA_FILE) {
+        sim.data_client = 0;
+    }
+    if (sim.data_client >= MQTT_MAX_CLIENTS || need == 0 || need > SIM_DATA_MAX) {
+        sim_queue(wire, EV_TEXT, 0, "\r\nERROR\r\n");
+        return true;
+    }
+    if (kind == DATA_SUB && !(sim.connected & (1u << sim.data_client))) {
+        sim_queue(wire, EV_TEXT, 0, "\r\nERROR\r\n");
+        return true;
+    }
+    sim.data_kind = kind;
+    sim.data_need = need;
+    sim.data_len = 0;
+    sim_queue(wire, EV_TEXT, 0, "\r\n>");
+    return true;
+}
+
+/**
+ * @brief A data block is complete
+ */
+static void sim_data_done(void)
+{
+    uint8_t c = sim.data_client;
+    uint32_t wire = sim_wire_ms(sim.data_len) + 1;
+    char text[SIM_TEXT_MAX];
+    
+    switch (sim.data_kind) {
+    case DATA_TOPIC:
+        memcpy(sim.topic[c], sim.data, (sim.data_len < SIM_TOPIC_MAX) ? sim.data_len : SIM_TOPIC_MAX - 1);
+        sim.topic[c][(sim.data_len < SIM_TOPIC_MAX) ? sim.data_len : SIM_TOPIC_MAX - 1] = '\0';
+        sim_queue(wire, EV_TEXT, c, "\r\nOK\r\n");
+        break;
+    
+    case DATA_PAYLOAD:
+        if (sim.pub_count[c] >= SIM_PUBS) {
+            sim_queue(wire, EV_TEXT, c, "\r\nERROR\r\n");
+            sim.payload_ok[c] = false;
+            break;
+        }
+        {
+            Sim_Pub_t *p = &sim.pub[c][(sim.pub_head[c] + sim.pub_count[c]) % SIM_PUBS];
+            
+            memcpy(p->topic, sim.topic[c], sizeof(p->topic));
+            memcpy(p->payload, sim.data, sim.data_len);
+            p->len = sim.data_len;
+        }
+        if (sim_roll(sim.config.payload_error)) {
+            Sim_Pub_t *p = &sim.pub[c][(sim.pub_head[c] + sim.pub_count[c]) % SIM_PUBS];
+            
+            sim.stats.payload_errors++;
+            sim.payload_ok[c] = false;
+            if (sim.publish != NULL) {
+                sim.publish(p->topic, p->payload, p->len, false);
+            }
+            sim_queue(wire, EV_TEXT, c, "\r\nERROR\r\n");
+        } else {
+            sim.payload_ok[c] = true;
+            sim_queue(wire, EV_TEXT, c, "\r\nOK\r\n");
+        }
+        break;
+    
+    case DATA_SUB:
+        sim_queue(wire, EV_TEXT, c, "\r\nOK\r\n");
+        snprintf(text, sizeof(text), "\r\n+CMQTTSUB: %u,0\r\n", (unsigned)c);
+        sim_queue(wire + 50, EV_TEXT, c, text);
+        break;
+    
+    case DATA_CERT:
+    case DATA_FILE:
+        sim_queue(wire, EV_TEXT, 0, "\r\nOK\r\n");
+        break;
+    
+    case DATA_WILL:
+        sim_queue(wire, EV_TEXT, c, "\r\nOK\r\n");
+        break;
+    
+    default:
+        break;
+    }
+    sim.data_kind = DATA_NONE;
+}
+
+/**
+ * @brief AT+CMQTTPUB: execute the payload taken last
+ */
+static void sim_publish(const char *cmd, uint32_t wire)
+{
+    uint8_t c = (uint8_t)sim_arg(cmd, 0);
+    char text[SIM_TEXT_MAX];
+    
+    if (c >= MQTT_MAX_CLIENTS || !sim.payload_ok[c] || !(sim.connected & (1u << c))) {
+        sim_queue(wire, EV_TEXT, 0, "\r\nERROR\r\n");
+        return;
+    }
+    sim.payload_ok[c] = false;
+    sim.pub_count[c]++;
+    sim_queue(wire, EV_TEXT, c, "\r\nOK\r\n");
+    
+    if (sim_roll(sim.config.connlost)) {
+        /* Network drops the session while the broker has not acknowledged yet */
+        snprintf(text, sizeof(text), "\r\n+CMQTTCONNLOST: %u,3\r\n", (unsigned)c);
+        sim_queue(wire + sim.config.publish_ms / 2, EV_CONNLOST, c, text);
+        sim.stats.connlost++;
+        return;
+    }
+    snprintf(text, sizeof(text), "\r\n+CMQTTPUB: %u,0\r\n", (unsigned)c);
+    if (sim.config.uplink_bps > 0) {
+        /* One uplink: a publish waits for those queued before it */
+        uint32_t now = HAL_GetTick();
+        
+        if ((int32_t)(sim.uplink_free - (now + wire)) < 0) {
+            sim.uplink_free = now + wire;
+        }
+        sim.uplink_free += (uint32_t)(sim.pub[c][(sim.pub_head[c] + sim.pub_count[c] - 1) % SIM_PUBS].len * 1000U /
+                                      sim.config.uplink_bps);
+        wire = sim.uplink_free - now;
+    }
+    sim_queue(wire + sim.config.publish_ms, EV_PUB_DONE, c, text);
+}
+
+/**
+ * @brief "AT+A;+B;+C": each in turn, one final result
+ */
+static void sim_chain(const char *line, size_t len, uint32_t wire)
+{
+    char cmd[SIM_LINE_MAX];
+    Sim_Event_t *ev = sim_queue(wire, EV_TEXT, 0, NULL);
+    bool ok = true;
+    char *part;
+    
+    memcpy(cmd, &line[2], len - 1);
+    part = cmd;
+    sim.mux_asked = false;
+    while (ok && part != NULL) {
+        char *next = strchr(part, ';');
+        
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        ok = sim_command(part, ev, wire);
+        part = next;
+    }
+    sim_line(ev, ok ? "OK" : "ERROR");
+    if (ok && sim.mux_asked && ev != NULL) {
+        ev->kind = EV_MUX_ON;
+    }
+}
+
+/**
+ * @brief A complete command line
+ */
+static void sim_execute(void)
+{
+    uint32_t wire = sim_wire_ms(sim.line_len + 2) + 1;
+    
+    sim.line[sim.line_len] = '\0';
+    if (sim.line_len < 2 || sim.line[0] != 'A' || sim.line[1] != 'T') {
+        return;                                 /* Not a command - the module ignores it */
+    }
+    if (sim_data_command(sim.line, wire)) {
+        return;
+    }
+    if (sim_prefix(sim.line, "AT+CMQTTPUB=")) {
+        sim_publish(sim.line, wire);
+        return;
+    }
+    
+    sim_chain(sim.line, sim.line_len, wire);
+}
+
+/**
+ * @brief Bytes of the AT interface (plain, or the AT channel)
+ */
+static void sim_plain(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        
+        /* The LF of the command line comes before the prompt, not in the data */
+        if (sim.skip_lf && b == '\n') {
+            sim.skip_lf = false;
+            continue;
+        }
+        sim.skip_lf = false;
+        if (sim.data_kind != DATA_NONE) {
+            sim.data[sim.data_len++] = b;
+            if (sim.data_len == sim.data_need) {
+                sim_data_done();
+            }
+            continue;
+        }
+        if (b == '\r') {
+            sim_execute();
+            sim.line_len = 0;
+            sim.skip_lf = true;
+        } else if (sim.line_len < SIM_LINE_MAX - 1) {
+            sim.line[sim.line_len++] = (char)b;
+        }
+    }
+}
+
+/**
+ * @brief 27.010 FCS: CRC-8 (x^8 + x^2 + x + 1, reflected) from 0xFF, sent inverted
+ */
+static uint8_t sim_fcs(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (uint8_t)((crc >> 1) ^ 0xE0) : (uint8_t)(crc >> 1);
+        }
+    }
+    return (uint8_t)(0xFF - crc);
+}
+
+/**
+ * @brief Build a frame from the module
+ * @param cr C/R bit of the address: set on responses (UA), clear on commands and data
+ * @return Frame length
+ */
+static size_t sim_mux_build(uint8_t *out, uint8_t dlc, bool cr, uint8_t ctrl, const void *info, size_t len)
+{
+    size_t n = 1;
+    
+    out[0] = 0xF9;
+    out[n++] = (uint8_t)((dlc << 2) | (cr ? 0x02 : 0) | 0x01);
+    out[n++] = ctrl;
+    if (len <= 0x7F) {
+        out[n++] = (uint8_t)((len << 1) | 0x01);
+    } else {
+        out[n++] = (uint8_t)(len << 1);
+        out[n++] = (uint8_t)(len >> 7);
+    }
+    if (len > 0) {
+        memcpy(&out[n], info, len);
+    }
+    out[n + len] = sim_fcs(&out[1], n - 1);     /* UIH: over the header only */
+    n += len + 1;
+    out[n++] = 0xF9;
+    return n;
+}
+
+/**
+ * @brief Queue a frame (control answers) due in ms
+ */
+static void sim_mux_queue(uint32_t ms, uint8_t kind, uint8_t dlc, bool cr, uint8_t ctrl,
+                          const uint8_t *info, size_t len)
+{
+    Sim_Event_t *ev = sim_queue(ms, kind, 0, NULL);
+    
+    if (ev != NULL) {
+        ev->len = (uint16_t)sim_mux_build((uint8_t *)ev->text, dlc, cr, ctrl, info, len);
+    }
+}
+
+/**
+ * @brief Monitoring channel bytes: its own command lines, answered on it
+ */
+static void sim_mon(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\r') {
+            sim.mon[sim.mon_len] = '\0';
+            if (sim.mon_len >= 2 && sim.mon[0] == 'A' && sim.mon[1] == 'T') {
+                sim.dlc = CMUX_DLC_MON;
+                sim_chain(sim.mon, sim.mon_len, sim_wire_ms(sim.mon_len + 2) + 1);
+                sim.dlc = CMUX_DLC_AT;
+            }
+            sim.mon_len = 0;
+        } else if (data[i] != '\n' && sim.mon_len < SIM_LINE_MAX - 1) {
+            sim.mon[sim.mon_len++] = (char)data[i];
+        }
+    }
+}
+
+/**
+ * @brief A whole frame from the driver
+ */
+static void sim_mux_frame(const uint8_t *f, size_t hdr, size_t len)
+{
+    uint8_t dlc = (uint8_t)(f[1] >> 2);
+    uint8_t ctrl = (uint8_t)(f[2] & ~0x10);
+    const uint8_t *info = &f[hdr];
+    
+    if (sim_fcs(&f[1], hdr - 1) != f[hdr + len] || dlc >= CMUX_DLCS) {
+        return;                                 /* Dropped, as the module would */
+    }
+    if (ctrl == 0x2F) {                         /* SABM: UA, then our modem status on a channel */
+        sim.mux_open |= (uint8_t)(1u << dlc);
+        sim_mux_queue(1, EV_FRAME, dlc, true, 0x73, NULL, 0);
+        if (dlc > 0) {
+            uint8_t msc[4] = { 0xE3, 0x05, (uint8_t)((dlc << 2) | 0x03), 0x8D };
+            
+            sim_mux_queue(2, EV_FRAME, 0, false, 0xEF, msc, sizeof(msc));
+        }
+    } else if (ctrl == 0x43) {                  /* DISC: UA; on DLC 0 the end of CMUX */
+        sim.mux_open &= (uint8_t)~(1u << dlc);
+        sim_mux_queue(1, dlc == 0 ? EV_MUX_OFF : EV_FRAME, dlc, true, 0x73, NULL, 0);
+    } else if (ctrl != 0xEF || !(sim.mux_open & (1u << dlc))) {
+        return;
+    } else if (dlc == 0 && len >= 2) {
+        if (info[0] == 0xE3 && len >= 4) {       /* MSC command: echoed as the response */
+            uint8_t msc[4] = { 0xE1, 0x05, info[2], info[3] };
+            
+            sim_mux_queue(1, EV_FRAME, 0, false, 0xEF, msc, sizeof(msc));
+        } else if (info[0] == 0xC3) {           /* CLD: answered, then plain text */
+            uint8_t cld[2] = { 0xC1, 0x01 };
+            
+            sim_mux_queue(1, EV_MUX_OFF, 0, false, 0xEF, cld, sizeof(cld));
+        }
+    } else if (dlc == CMUX_DLC_AT) {
+        sim_plain(info, len);
+    } else if (dlc == CMUX_DLC_MON) {
+        sim_mon(info, len);
+    }
+}
+
+/**
+ * @brief Bytes while multiplexed: frames by their length field
+ */
+static void sim_mux_rx(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        
+        if (sim.mux_len == 0) {
+            if (b == 0xF9) {
+                sim.mux_frame[sim.mux_len++] = b;
+                sim.mux_need = 0;
+            }
+            continue;
+        }
+        if (sim.mux_len == 1 && b == 0xF9) {
+            continue;                           /* Flags between frames */
+        }
+        sim.mux_frame[sim.mux_len++] = b;
+        if (sim.mux_need == 0 && sim.mux_len >= 4 && ((sim.mux_frame[3] & 1) || sim.mux_len == 5)) {
+            size_t hdr = sim.mux_len;
+            size_t info = (sim.mux_frame[3] >> 1) | ((hdr == 5) ? (size_t)sim.mux_frame[4] << 7 : 0);
+            
+            sim.mux_need = hdr + info + 2;
+            if (sim.mux_need > SIM_MUX_MAX) {
+                sim.mux_len = 0;                /* Not a frame we could take */
+                continue;
+            }
+        }
+        if (sim.mux_need != 0 && sim.mux_len == sim.mux_need) {
+            size_t hdr = (sim.mux_frame[3] & 1) ? 4 : 5;
+            
+            if (b == 0xF9) {
+                sim_mux_frame(sim.mux_frame, hdr, sim.mux_need - hdr - 2);
+            }
+            sim.mux_len = 0;
+        }
+    }
+}
+
+/**
+ * @brief Take what the driver sent
+ */
+static void sim_rx(void *ctx, const uint8_t *data, size_t len)
+{
+    (void)ctx;
+    if ((int32_t)(HAL_GetTick() - sim.rdy) < 0) {
+        return;                                 /* Still booting */
+    }
+    if (sim.csclk && (sim.dtr_high || HAL_GetTick() - sim.dtr_tick < SIM_WAKE_MS)) {
+        sim.stats.deaf += (uint32_t)len;        /* Asleep: the UART does not listen */
+        return;
+    }
+    if (sim.mux) {
+        sim_mux_rx(data, len);
+    } else {
+        sim_plain(data, len);
+    }
+}
+
+/**
+ * @brief An answer goes out: its text, then what it stands for
+ */
+static void sim_emit(const Sim_Event_t *ev)
+{
+    uint8_t c = ev->client;
+    
+    if (sim.mux && ev->kind != EV_FRAME && ev->kind != EV_MUX_OFF && ev->len > 0) {
+        uint8_t frame[SIM_TEXT_MAX + 8];
+        
+        Bench_UartReceive(sim.uart, frame, sim_mux_build(frame, ev->dlc, false, 0xEF, ev->text, ev->len));
+    } else if (ev->len > 0) {
+        Bench_UartReceive(sim.uart, (const uint8_t *)ev->text, ev->len);
+    }
+    switch (ev->kind) {
+    case EV_MUX_ON:
+        sim.mux = true;
+        sim.mux_open = 0;
+        sim.mux_len = 0;
+        break;
+    
+    case EV_MUX_OFF:
+        sim.mux = false;
+        sim.mux_open = 0;
+        break;
+    
+    case EV_STARTED:
+        sim.mqtt_started = true;
+        break;
+    
+    case EV_CONNECTED:
+        if (sim.acquired & (1u << c)) {
+            sim.connected |= (uint8_t)(1u << c);
+            sim.stats.connects++;
+        }
+        break;
+    
+    case EV_PUB_DONE:
+        if (sim.pub_count[c] > 0) {
+            Sim_Pub_t *p = &sim.pub[c][sim.pub_head[c]];
+            
+            sim.stats.publishes++;
+            sim.stats.publish_bytes += (uint32_t)p->len;
+            if (sim.publish != NULL) {
+                sim.publish(p->topic, p->payload, p->len, true);
+            }
+            sim.pub_head[c] = (uint8_t)((sim.pub_head[c] + 1) % SIM_PUBS);
+            sim.pub_count[c]--;
+        }
+        break;
+    
+    case EV_CONNLOST:
+        sim.connected &= (uint8_t)~(1u << c);
+        sim_pub_fail_all(c);
+        break;
+    
+    default:
+        break;
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+void Bench_SimInit(UART_DMA_Handle_t *uart, const Bench_SimConfig_t *config, Bench_SimPublishFn_t publish)
+{
+    memset(&sim, 0, sizeof(sim));
+    sim.uart = uart;
+    sim.config = *config;
+    sim.publish = publish;
+    sim.rand = config->seed ? config->seed : 1;
+    sim.second = HAL_GetTick();
+    sim.rdy = sim.second + config->boot_ms;
+    sim.dlc = CMUX_DLC_AT;
+    Bench_UartTxSink(uart, sim_rx, NULL);
+    
+    if (config->warm != NULL) {
+        /* MCU reset alone: the module is registered, its sessions up, its banners long gone */
+        sim.rdy = sim.second;
+        sim.cgact = true;
+        sim.mqtt_started = true;
+        sim.acquired = (uint8_t)((1u << MQTT_MAX_CLIENTS) - 1u);
+        sim.connected = sim.acquired;
+        for (uint8_t c = 0; c < MQTT_MAX_CLIENTS; c++) {
+            snprintf(sim.server[c], sizeof(sim.server[c]), "%s", config->warm);
+        }
+        return;
+    }
+    
+    /* Power on: boot banners, as a module that was off */
+    sim_queue(config->boot_ms, EV_TEXT, 0, "\r\nRDY\r\n");
+    sim_queue(config->boot_ms + 1500, EV_TEXT, 0, "\r\n+CPIN: READY\r\n");
+    sim_queue(config->boot_ms + 4000, EV_TEXT, 0, "\r\nSMS DONE\r\n\r\nPB DONE\r\n");
+}
+
+void Bench_SimStep(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t i = 0;
+    
+    /* What the driver sent - transfers complete at once, the wire time is in the answers */
+    Bench_UartTxDone(sim.uart);
+    
+    /* Answers due, in the order they were queued */
+    while (i < sim.event_count) {
+        if ((int32_t)(now - sim.events[i].due) >= 0) {
+            Sim_Event_t ev = sim.events[i];
+            
+            memmove(&sim.events[i], &sim.events[i + 1], (size_t)(sim.event_count - i - 1) * sizeof(ev));
+            sim.event_count--;
+            sim_emit(&ev);
+        } else {
+            i++;
+        }
+    }
+    
+    /* Noise on the modem's TX line */
+    if (now - sim.second >= 1000) {
+        sim.second = now;
+        if (sim_roll(sim.config.garbage)) {
+            uint8_t burst[SIM_GARBAGE_MAX];
+            uint32_t n = 1 + sim_rand(SIM_GARBAGE_MAX);
+            
+            for (uint32_t j = 0; j < n; j++) {
+                burst[j] = (uint8_t)sim_rand(256);
+            }
+            Bench_UartReceive(sim.uart, burst, n);
+            sim.stats.garbage++;
+        }
+    }
+    
+    /* Virtual time: the answers still waiting, and the next noise roll */
+    for (i = 0; i < sim.event_count; i++) {
+        Bench_WakeAt(sim.events[i].due);
+    }
+    Bench_WakeAt(sim.second + 1000);
+}
+
+bool Bench_SimInbound(const char *topic, const char *payload)
+{
+    char text[SIM_TEXT_MAX];
+    size_t topic_len = strlen(topic), len = strlen(payload);
+    
+    if (!(sim.connected & 1u)) {
+        return false;
+    }
+    snprintf(text, sizeof(text),
+             "\r\n+CMQTTRXSTART: 0,%u,%u\r\n+CMQTTRXTOPIC: 0,%u\r\n%s\r\n"
+             "+CMQTTRXPAYLOAD: 0,%u\r\n%s\r\n+CMQTTRXEND: 0\r\n",
+             (unsigned)topic_len, (unsigned)len, (unsigned)topic_len, topic, (unsigned)len, payload);
+    return sim_queue(0, EV_TEXT, 0, text) != NULL;
+}
+
+void Bench_SimDtr(bool high)
+{
+    if (high != sim.dtr_high) {
+        sim.dtr_high = high;
+        sim.dtr_tick = HAL_GetTick();
+    }
+}
+
+const Bench_SimStats_t* Bench_SimStats(void)
+{
+    return &sim.stats;
+}
@@ -0,0 +1,313 @@
+/**
+ * @file    replay.c
+ * @brief   Replay a recorded flight (.tlog) through the host-built bridge
+ *
+ * Usage: replay [options] flight.tlog [out.json]   (default build/replay.json)
+ *   -s <speed>     Time scale: 1 as recorded, 4 four times faster,
+ *                  0 as fast as the FC UART carries it (default 1)
+ *   -b <baud>      FC UART rate (default 115200, main.c)
+ *   -m <baud>      Modem UART rate (default APP_MODEM_BAUD)
+ *   -p <ms>        Fixed time per publish on top of its bytes (default 120)
+ *   -e <encoding>  Uplink encoding as the "enc" command takes it (default: bridge default)
+ *   -i <ms>        Queue sample interval (default 100)
+ *
+ * A .tlog is what ground stations record: each frame as received, behind
+ * an 8-byte big-endian UNIX time in microseconds. The frames go into the
+ * USART1 RX ring at their recorded times (scaled), but never faster than
+ * the FC UART, and the bridge runs every simulated millisecond against an
+ * online modem stand-in (bench_stubs.c). Parameter dumps, mission
+ * transfers and log streaming keep their bursts, which a synthetic stream
+ * does not have.
+ *
+ * The report gives what was fed, what the parser, rate limiter and dedup
+ * did with it, the uplink publishes and bytes, the latency histogram and
+ * the queue depth over time:
+ *   {"input":{...},"bridge":{...},"uplink":{...},"lat_ms":[...],
+ *    "queue":{"interval_ms":100,"max_ring":..,"max_batch":..,
+ *             "ring":[...],"batch":[...]}}
+ * ring: unread USART1 RX bytes, batch: frame bytes in the open batches.
+ * Compare the JSON of two builds on the same flight to catch regressions.
+ */
+
+#include "bench.h"
+#include "app.h"
+#include "mavlink_bridge.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_TAIL_MS      10000       /* Run on after the last frame so the batches drain */
+#define REPLAY_CHUNK        (TELEM_UART_RX_BUFFER_SIZE / 2)
+
+/* A record of the capture */
+typedef struct {
+    uint64_t us;                        /* Capture time */
+    size_t pos;                         /* Frame in the file */
+    size_t len;
+} Replay_Frame_t;
+
+static uint8_t *tlog;
+static Replay_Frame_t *list;
+static size_t list_count;
+static uint32_t skipped_bytes;          /* Not a frame (cut capture, v1 garbage) */
+
+/* Modules under test */
+static UART_HandleTypeDef telem_huart;
+static UART_DMA_Handle_t telem;
+static uint8_t telem_rx[TELEM_UART_RX_BUFFER_SIZE], telem_tx[TELEM_UART_TX_BUFFER_SIZE];
+static A7600_MQTT_Handle_t mqtt;
+
+/* Queue samples */
+static uint16_t *ring_depth, *batch_depth;
+static size_t samples;
+static uint32_t max_ring, max_batch;
+
+/**
+ * @brief Length of the MAVLink frame at f (0: not a frame start)
+ */
+static size_t frame_len(const uint8_t *f, size_t avail)
+{
+    if (avail >= 3 && f[0] == 0xFD) {
+        return 10 + f[1] + 2 + ((f[2] & 0x01) ? 13 : 0);    /* v2, signed: + signature */
+    }
+    if (avail >= 2 && f[0] == 0xFE) {
+        return 6 + f[1] + 2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Read the capture and index its frames
+ */
+static bool load_tlog(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    long size;
+    size_t pos = 0;
+    
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0) {
+        return false;
+    }
+    rewind(f);
+    tlog = malloc((size_t)size + 1);
+    list = malloc(((size_t)size / 16 + 1) * sizeof(*list));   /* Smallest record: 8 + v1 HEARTBEAT */
+    if (tlog == NULL || list == NULL || fread(tlog, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    
+    while (pos + 8 < (size_t)size) {
+        size_t len = frame_len(&tlog[pos + 8], (size_t)size - pos - 8);
+        
+        if (len == 0 || pos + 8 + len > (size_t)size) {
+            /* Resync on the next byte */
+            pos++;
+            skipped_bytes++;
+            continue;
+        }
+        uint64_t us = 0;
+        for (int i = 0; i < 8; i++) {
+            us = (us << 8) | tlog[pos + i];
+        }
+        list[list_count++] = (Replay_Frame_t){ us, pos + 8, len };
+        pos += 8 + len;
+    }
+    return list_count > 0;
+}
+
+static void sample_queue(void)
+{
+    uint32_t ring = (uint32_t)UART_DMA_Available(&telem);
+    uint32_t batch = Bench_BridgeQueued();
+    
+    ring_depth[samples] = (uint16_t)ring;
+    batch_depth[samples] = (uint16_t)batch;
+    samples++;
+    if (ring > max_ring) {
+        max_ring = ring;
+    }
+    if (batch > max_batch) {
+        max_batch = batch;
+    }
+}
+
+static void write_series(FILE *f, const char *name, const uint16_t *v)
+{
+    fprintf(f, ",\"%s\":[", name);
+    for (size_t i = 0; i < samples; i++) {
+        fprintf(f, "%s%u", i ? "," : "", (unsigned)v[i]);
+    }
+    fprintf(f, "]");
+}
+
+int main(int argc, char **argv)
+{
+    double speed = 1.0;
+    uint32_t baud = 115200;
+    uint32_t modem_baud = APP_MODEM_BAUD;
+    uint32_t publish_ms = 120;
+    uint32_t interval = 100;
+    const char *encoding = NULL;
+    const char *in = NULL;
+    const char *out = "build/replay.json";
+    int arg = 1;
+    
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        switch (argv[arg][1]) {
+        case 's': speed = atof(argv[arg + 1]); break;
+        case 'b': baud = (uint32_t)strtoul(argv[arg + 1], NULL, 10); break;
+        case 'm': modem_baud = (uint32_t)strtoul(argv[arg + 1], NULL, 10); break;
+        case 'p': publish_ms = (uint32_t)strtoul(argv[arg + 1], NULL, 10); break;
+        case 'e': encoding = argv[arg + 1]; break;
+        case 'i': interval = (uint32_t)strtoul(argv[arg + 1], NULL, 10); break;
+        default: arg = argc; break;
+        }
+    }
+    if (arg >= argc || speed < 0 || baud == 0 || modem_baud == 0 || interval == 0) {
+        fprintf(stderr, "usage: replay [-s speed] [-b baud] [-m modem_baud] [-p publish_ms]\n"
+                        "              [-e encoding] [-i sample_ms] flight.tlog [out.json]\n");
+        return 2;
+    }
+    in = argv[arg];
+    if (arg + 1 < argc) {
+        out = argv[arg + 1];
+    }
+    if (!load_tlog(in)) {
+        fprintf(stderr, "replay: no MAVLink frames in %s\n", in);
+        return 1;
+    }
+    
+    Bench_UartSetup(&telem_huart, baud);
+    UART_DMA_Init(&telem, &telem_huart, telem_rx, sizeof(telem_rx), telem_tx, sizeof(telem_tx));
+    Bench_ModemSetup(true, publish_ms, modem_baud);
+    MavlinkBridge_Init(&telem, &mqtt);
+    if (encoding != NULL && !MavlinkBridge_SetEncodingName(encoding)) {
+        fprintf(stderr, "replay: unknown encoding %s\n", encoding);
+        return 2;
+    }
+    
+    /* Arrival of each frame's last byte on the wire, in simulated us */
+    uint64_t wire = 0;
+    uint64_t *arrive = malloc(list_count * sizeof(*arrive));
+    uint64_t fed_bytes = 0;
+    
+    if (arrive == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < list_count; i++) {
+        uint64_t rel = (list[i].us > list[0].us) ? list[i].us - list[0].us : 0;
+        uint64_t due = (speed > 0) ? (uint64_t)(rel / speed) : 0;
+        
+        if (due < wire) {
+            due = wire;     /* The UART is still busy with the frames before */
+        }
+        wire = due + list[i].len * 10000000ULL / baud;
+        arrive[i] = wire;
+        fed_bytes += list[i].len;
+    }
+    uint32_t end_ms = (uint32_t)(wire / 1000) + REPLAY_TAIL_MS;
+    
+    ring_depth = malloc((end_ms / interval + 2) * sizeof(*ring_depth));
+    batch_depth = malloc((end_ms / interval + 2) * sizeof(*batch_depth));
+    if (ring_depth == NULL || batch_depth == NULL) {
+        return 1;
+    }
+    
+    /* One bridge pass per millisecond, as the scheduler runs the uplink task */
+    size_t next = 0;
+    for (uint32_t ms = 1; ms <= end_ms; ms++) {
+        uint8_t chunk[REPLAY_CHUNK];
+        size_t n = 0;
+        
+        Bench_SetTick(ms);
+        while (next < list_count && arrive[next] <= (uint64_t)ms * 1000) {
+            const Replay_Frame_t *fr = &list[next];
+            size_t done = 0;
+            
+            while (done < fr->len) {
+                size_t take = fr->len - done;
+                
+                if (take > sizeof(chunk) - n) {
+                    take = sizeof(chunk) - n;
+                }
+                memcpy(&chunk[n], &tlog[fr->pos + done], take);
+                n += take;
+                done += take;
+                if (n == sizeof(chunk)) {
+                    Bench_UartReceive(&telem, chunk, n);
+                    n = 0;
+                }
+            }
+            next++;
+        }
+        if (n > 0) {
+            Bench_UartReceive(&telem, chunk, n);
+        }
+        MavlinkBridge_Process();
+        Bench_ModemPoll();
+        if (ms % interval == 0) {
+            sample_queue();
+        }
+    }
+    
+    /* Results */
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    const Bench_ModemStats_t *modem = Bench_ModemStats();
+    uint32_t frames, bytes, rejected, overrun_events, overrun_bytes;
+    double secs = (list[list_count - 1].us > list[0].us) ? (list[list_count - 1].us - list[0].us) / 1e6 : 0;
+    bool compress;
+    const char *enc_name = MavlinkBridge_GetEncodingName(&compress);
+    FILE *f;
+    
+    MavlinkBridge_GetStats(&frames, &bytes, &rejected);
+    UART_DMA_GetOverrun(&telem, &overrun_events, &overrun_bytes);
+    
+    printf("input    %zu frames, %llu bytes, %.1f s recorded, %.1f s replayed (%u bytes skipped)\n",
+           list_count, (unsigned long long)fed_bytes, secs, wire / 1e6, (unsigned)skipped_bytes);
+    printf("bridge   %u frames, %u bytes forwarded; rejected %u, seq lost %u, timeouts %u\n",
+           (unsigned)frames, (unsigned)bytes, (unsigned)rejected, (unsigned)link->seq_lost,
+           (unsigned)link->timeouts);
+    printf("dropped  rate %u, route %u, dedup %u, rx overrun %u bytes (%u events)\n",
+           (unsigned)link->rate_dropped, (unsigned)link->route_dropped, (unsigned)link->deduped,
+           (unsigned)overrun_bytes, (unsigned)overrun_events);
+    printf("uplink   %u publishes, %u bytes (max %u)\n",
+           (unsigned)modem->publishes, (unsigned)modem->bytes, (unsigned)modem->max_len);
+    printf("queue    max %u ring bytes, %u batch bytes\n", (unsigned)max_ring, (unsigned)max_batch);
+    
+    f = fopen(out, "w");
+    if (f == NULL) {
+        fprintf(stderr, "replay: cannot write %s\n", out);
+        return 1;
+    }
+    fprintf(f, "{\"input\":{\"file\":\"%s\",\"frames\":%zu,\"bytes\":%llu,\"skipped\":%u,"
+               "\"recorded_s\":%.3f,\"replayed_s\":%.3f,\"speed\":%g,\"baud\":%u},\n",
+            in, list_count, (unsigned long long)fed_bytes, (unsigned)skipped_bytes,
+            secs, wire / 1e6, speed, (unsigned)baud);
+    fprintf(f, " \"bridge\":{\"frames\":%u,\"bytes\":%u,\"rejected\":%u,\"seq_lost\":%u,\"timeouts\":%u,"
+               "\"rate_dropped\":%u,\"route_dropped\":%u,\"deduped\":%u,\"param_answered\":%u,"
+               "\"rx_overrun\":%u},\n",
+            (unsigned)frames, (unsigned)bytes, (unsigned)rejected, (unsigned)link->seq_lost,
+            (unsigned)link->timeouts, (unsigned)link->rate_dropped, (unsigned)link->route_dropped,
+            (unsigned)link->deduped, (unsigned)link->param_answered, (unsigned)overrun_bytes);
+    fprintf(f, " \"uplink\":{\"encoding\":\"%s%s\",\"publishes\":%u,\"bytes\":%u,\"max_len\":%u},\n",
+            enc_name, compress ? "+lz" : "", (unsigned)modem->publishes, (unsigned)modem->bytes,
+            (unsigned)modem->max_len);
+    fprintf(f, " \"lat_ms\":[");
+    for (int i = 0; i < BRIDGE_LAT_BUCKETS; i++) {
+        fprintf(f, "%s%u", i ? "," : "", (unsigned)link->latency[i]);
+    }
+    fprintf(f, "],\n \"queue\":{\"interval_ms\":%u,\"max_ring\":%u,\"max_batch\":%u",
+            (unsigned)interval, (unsigned)max_ring, (unsigned)max_batch);
+    write_series(f, "ring", ring_depth);
+    write_series(f, "batch", batch_depth);
+    fprintf(f, "}}\n");
+    if (fclose(f) != 0) {
+        fprintf(stderr, "replay: cannot write %s\n", out);
+        return 1;
+    }
+    printf("Results written to %s\n", out);
+    
+    /* A flight the bridge forwarded nothing of is a broken build, not a result */
+    return (frames > 0) ? 0 : 1;
+}
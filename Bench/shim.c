@@ -0,0 +1,252 @@
+/**
+ * @file    shim.c
+ * @brief   Host HAL shim: tick, UART "peripherals" and the RX DMA model
+ */
+
+#include "bench.h"
+#include <string.h>
+
+#define BENCH_UARTS     2
+
+static uint32_t tick;
+SysTick_Type bench_systick = { 0, BENCH_PCLK1 / 1000 - 1, 0, 0 };
+
+/* One register block and DMA channel per UART handle set up */
+static USART_TypeDef usart_regs[BENCH_UARTS];
+static DMA_Channel_TypeDef dma_rx_regs[BENCH_UARTS];
+static DMA_Channel_TypeDef dma_tx_regs[BENCH_UARTS];
+static DMA_HandleTypeDef dma_rx[BENCH_UARTS];
+static DMA_HandleTypeDef dma_tx[BENCH_UARTS];
+static DMA_TypeDef dma_regs;                /* Flags are never raised - the benchmark calls the callbacks */
+static uint32_t line_baud[BENCH_UARTS];     /* Far end's rate (0: follows BRR) */
+static uint8_t uarts;
+static void (*idle_fn)(void);
+static uint32_t wake;                       /* Earliest Bench_WakeAt since the last Bench_NextWake */
+static bool wake_set;
+
+/* TX sinks, by UART */
+static struct {
+    Bench_TxFn_t fn;
+    void *ctx;
+    bool busy;              /* Transfer handed over, not completed yet */
+} tx_sink[BENCH_UARTS];
+
+void Bench_SetTick(uint32_t ms)
+{
+    tick = ms;
+}
+
+void Bench_SetIdle(void (*fn)(void))
+{
+    idle_fn = fn;
+}
+
+void Bench_Wfi(void)
+{
+    if (idle_fn != NULL) {
+        idle_fn();
+    }
+}
+
+void Bench_WakeAt(uint32_t ms)
+{
+    if (!wake_set || (int32_t)(ms - wake) < 0) {
+        wake = ms;
+        wake_set = true;
+    }
+}
+
+uint32_t Bench_NextWake(uint32_t limit)
+{
+    uint32_t at = (wake_set && (int32_t)(wake - limit) < 0) ? wake : limit;
+    
+    wake_set = false;
+    return ((int32_t)(at - tick) > 0) ? at : tick + 1;
+}
+
+bool Bench_TxIdle(void)
+{
+    for (size_t i = 0; i < uarts; i++) {
+        if (tx_sink[i].busy) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Bench_UartSetup(UART_HandleTypeDef *huart, uint32_t baud)
+{
+    uint8_t i = uarts++;
+    
+    memset(huart, 0, sizeof(*huart));
+    dma_rx[i].Instance = &dma_rx_regs[i];
+    dma_tx[i].Instance = &dma_tx_regs[i];
+    dma_rx[i].DmaBaseAddress = &dma_regs;
+    dma_tx[i].DmaBaseAddress = &dma_regs;
+    dma_tx[i].ChannelIndex = 8U * i;        /* Channel pairs, as USART1 (2, 3) and USART2 (4, 5) */
+    dma_rx[i].ChannelIndex = 8U * i + 4U;
+    huart->Instance = &usart_regs[i];
+    huart->hdmarx = &dma_rx[i];
+    huart->hdmatx = &dma_tx[i];
+    huart->Init.BaudRate = baud;
+    huart->Instance->BRR = (BENCH_PCLK1 + baud / 2) / baud;
+    huart->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->Instance->ISR = UART_FLAG_TC;    /* Line quiet: TX drains at once */
+}
+
+void Bench_UartLineRate(UART_HandleTypeDef *huart, uint32_t baud)
+{
+    line_baud[huart->Instance - usart_regs] = baud;
+}
+
+void Bench_UartRequest(UART_HandleTypeDef *huart, uint32_t req)
+{
+    if (req & UART_AUTOBAUD_REQUEST) {
+        huart->Instance->ISR &= ~(UART_FLAG_ABRF | UART_FLAG_ABRE);
+    }
+}
+
+void Bench_DmaEnable(DMA_HandleTypeDef *hdma)
+{
+    SET_BIT(hdma->Instance->CCR, DMA_CCR_EN);
+    
+    /* A TX span goes to the sink, as HAL_UART_Transmit_DMA's does */
+    for (size_t i = 0; i < BENCH_UARTS; i++) {
+        if (hdma == &dma_tx[i] && tx_sink[i].fn != NULL) {
+            tx_sink[i].fn(tx_sink[i].ctx, (const uint8_t *)hdma->Instance->CMAR, hdma->Instance->CNDTR);
+            tx_sink[i].busy = true;
+        }
+    }
+}
+
+/**
+ * @brief Auto baud rate detection and rate mismatch on bytes about to arrive
+ * @return true if they arrive intact
+ */
+static bool line_check(UART_HandleTypeDef *huart, uint8_t first)
+{
+    USART_TypeDef *regs = huart->Instance;
+    uint32_t line = line_baud[regs - usart_regs];
+    
+    if (line == 0) {
+        regs->ISR |= (regs->CR2 & USART_CR2_ABREN) ? UART_FLAG_ABRF : 0;
+        return true;
+    }
+    
+    /* Start bit measurement: the low time runs on through the low bits after it */
+    if ((regs->CR2 & USART_CR2_ABREN) && !(regs->ISR & (UART_FLAG_ABRF | UART_FLAG_ABRE))) {
+        uint32_t bits = 1;
+        
+        while (bits < 9 && !(first & (1U << (bits - 1)))) {
+            bits++;
+        }
+        regs->BRR = (BENCH_PCLK1 * bits + line / 2) / line;
+        regs->ISR |= UART_FLAG_ABRF;
+    }
+    
+    uint64_t want = (uint64_t)regs->BRR * line;
+    uint64_t off = (want > BENCH_PCLK1) ? want - BENCH_PCLK1 : BENCH_PCLK1 - want;
+    return (off * 100 <= (uint64_t)BENCH_PCLK1 * 3);
+}
+
+void Bench_UartReceive(UART_DMA_Handle_t *handle, const uint8_t *data, size_t len)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    size_t pos = UART_DMA_GetDMAPos(handle);
+    size_t first = handle->rx_size - pos;
+    
+    if (first > len) {
+        first = len;
+    }
+    if (data != NULL) {
+        memcpy(&handle->rx_buffer[pos], data, first);
+        memcpy(handle->rx_buffer, &data[first], len - first);
+        if (len > 0 && !line_check(huart, data[0])) {
+            memset(&handle->rx_buffer[pos], 0, first);
+            memset(handle->rx_buffer, 0, len - first);
+        }
+    }
+    
+    /* CNDTR counts down to the ring end and reloads */
+    huart->hdmarx->Instance->CNDTR = (uint32_t)(handle->rx_size - ((pos + len) & (handle->rx_size - 1)));
+    huart->Instance->ISR |= UART_FLAG_IDLE;
+    UART_DMA_IDLE_IRQHandler(handle);
+    huart->Instance->ISR &= ~UART_FLAG_IDLE;
+}
+
+void Bench_UartTxSink(UART_DMA_Handle_t *handle, Bench_TxFn_t fn, void *ctx)
+{
+    size_t i = (size_t)(handle->huart->Instance - usart_regs);
+    
+    tx_sink[i].fn = fn;
+    tx_sink[i].ctx = ctx;
+}
+
+void Bench_UartTxDone(UART_DMA_Handle_t *handle)
+{
+    size_t i = (size_t)(handle->huart->Instance - usart_regs);
+    
+    while (tx_sink[i].busy) {
+        tx_sink[i].busy = false;
+        UART_DMA_TxCplt_Callback(handle);   /* May start the next transfer */
+    }
+}
+
+/* ==================== HAL ==================== */
+
+uint32_t HAL_GetTick(void)
+{
+    return tick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    uint32_t start = tick;
+    
+    while (tick - start < Delay) {
+        if (idle_fn == NULL) {
+            tick = start + Delay;
+        } else {
+            idle_fn();
+        }
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    huart->Instance->BRR = (BENCH_PCLK1 + huart->Init.BaudRate / 2) / huart->Init.BaudRate;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    (void)pData;
+    huart->hdmarx->Instance->CNDTR = Size;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+    size_t i = (size_t)(huart->Instance - usart_regs);
+    
+    /* Without a sink it never completes - the codec and parser cases wait for no TX */
+    if (tx_sink[i].fn != NULL) {
+        tx_sink[i].fn(tx_sink[i].ctx, pData, Size);
+        tx_sink[i].busy = true;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart)
+{
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+}
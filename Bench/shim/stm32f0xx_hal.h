@@ -0,0 +1,174 @@
+/**
+ * @file    stm32f0xx_hal.h
+ * @brief   Host shim of the STM32F0 HAL for the benchmark build
+ * @note    Found before the real HAL (Bench/Makefile puts shim/ first), so
+ *          main.h and the modules compile unchanged on the host. Registers
+ *          are plain structs in host memory: the benchmark plays the DMA by
+ *          filling a ring and setting CNDTR; enabling a TX channel hands its
+ *          span to the link's sink. Interrupt masking is a no-op -
+ *          the benchmark is single threaded. __WFI and HAL_Delay let
+ *          simulated time pass (Bench_SetIdle).
+ */
+
+#ifndef STM32F0XX_HAL_H
+#define STM32F0XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ==================== Core ==================== */
+#define __IO                volatile
+#define SRAM_BASE           0x20000000UL
+#define BENCH_PCLK1         48000000UL  /* SystemClock_Config: HSI/2 x 12 */
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void) { }
+static inline void __DMB(void) { __sync_synchronize(); }
+void Bench_Wfi(void);
+#define __WFI()             Bench_Wfi()
+#define __NOP()             ((void)0)
+
+#define SET_BIT(REG, BIT)           ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)         ((REG) &= ~(BIT))
+#define READ_BIT(REG, BIT)          ((REG) & (BIT))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) ((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+
+/* ==================== Registers ==================== */
+typedef struct {
+    __IO uint32_t CR1, CR2, CR3, BRR, GTPR, RTOR, RQR, ISR, ICR, RDR, TDR;
+} USART_TypeDef;
+
+typedef struct {
+    __IO uint32_t CCR, CNDTR;
+    __IO uintptr_t CPAR, CMAR;          /* Host pointers */
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISR, IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t CTRL, LOAD, VAL, CALIB;
+} SysTick_Type;
+
+typedef struct {
+    __IO uint32_t BSRR;                 /* Last write kept, nothing driven */
+} GPIO_TypeDef;
+
+extern SysTick_Type bench_systick;     /* Never counts: handler timings read 0 */
+#define SysTick             (&bench_systick)
+
+#define USART_CR1_UE            (1UL << 0)
+#define USART_CR2_ADDM7         (1UL << 4)
+#define USART_CR2_ABREN         (1UL << 20)
+#define USART_CR2_ABRMODE       (3UL << 21)
+#define USART_CR2_RTOEN         (1UL << 23)
+#define USART_CR2_ADD_Pos       24U
+#define USART_CR2_ADD           (0xFFUL << USART_CR2_ADD_Pos)
+#define USART_RTOR_RTO          0x00FFFFFFUL
+#define USART_CR3_EIE           (1UL << 0)
+#define USART_CR3_DMAR          (1UL << 6)
+#define USART_CR3_DMAT          (1UL << 7)
+
+#define DMA_CCR_EN              (1UL << 0)
+#define DMA_CCR_TCIE            (1UL << 1)
+#define DMA_CCR_HTIE            (1UL << 2)
+#define DMA_CCR_TEIE            (1UL << 3)
+#define DMA_ISR_TCIF1           (1UL << 1)
+#define DMA_ISR_HTIF1           (1UL << 2)
+#define DMA_ISR_TEIF1           (1UL << 3)
+#define DMA_IFCR_CGIF1          (1UL << 0)
+#define DMA_IFCR_CTCIF1         (1UL << 1)
+#define DMA_IFCR_CHTIF1         (1UL << 2)
+
+/* ==================== HAL ==================== */
+typedef enum {
+    HAL_OK = 0,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET = 0x00,
+    HAL_UART_STATE_READY = 0x20,
+    HAL_UART_STATE_BUSY_RX = 0x22
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+    DMA_Channel_TypeDef *Instance;
+    DMA_TypeDef *DmaBaseAddress;
+    uint32_t ChannelIndex;
+} DMA_HandleTypeDef;
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t HwFlowCtl;
+} UART_InitTypeDef;
+
+typedef struct {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    __IO HAL_UART_StateTypeDef gState;
+    __IO HAL_UART_StateTypeDef RxState;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define UART_HWCONTROL_NONE     0x00000000UL
+#define UART_HWCONTROL_RTS_CTS  0x00000300UL
+
+#define HAL_UART_ERROR_PE       0x01UL
+#define HAL_UART_ERROR_NE       0x02UL
+#define HAL_UART_ERROR_FE       0x04UL
+#define HAL_UART_ERROR_ORE      0x08UL
+#define HAL_UART_ERROR_DMA      0x10UL
+
+#define UART_FLAG_PE            (1UL << 0)
+#define UART_FLAG_FE            (1UL << 1)
+#define UART_FLAG_NE            (1UL << 2)
+#define UART_FLAG_ORE           (1UL << 3)
+#define UART_FLAG_IDLE          (1UL << 4)
+#define UART_FLAG_TC            (1UL << 6)
+#define UART_FLAG_RTOF          (1UL << 11)
+#define UART_FLAG_ABRE          (1UL << 14)
+#define UART_FLAG_ABRF          (1UL << 15)
+#define UART_FLAG_CMF           (1UL << 17)
+#define UART_CLEAR_PEF          (1UL << 0)
+#define UART_CLEAR_FEF          (1UL << 1)
+#define UART_CLEAR_NEF          (1UL << 2)
+#define UART_CLEAR_OREF         (1UL << 3)
+#define UART_CLEAR_IDLEF        (1UL << 4)
+#define UART_CLEAR_RTOF         (1UL << 11)
+#define UART_CLEAR_CMF          (1UL << 17)
+#define UART_IT_IDLE            (1UL << 4)
+#define UART_IT_CM              (1UL << 14)
+#define UART_IT_RTO             (1UL << 26)
+#define UART_AUTOBAUD_REQUEST   (1UL << 0)
+
+#define __HAL_UART_ENABLE(h)            SET_BIT((h)->Instance->CR1, USART_CR1_UE)
+#define __HAL_UART_DISABLE(h)           CLEAR_BIT((h)->Instance->CR1, USART_CR1_UE)
+#define __HAL_UART_ENABLE_IT(h, it)     SET_BIT((h)->Instance->CR1, (it))
+#define __HAL_UART_GET_FLAG(h, flag)    (((h)->Instance->ISR & (flag)) == (flag))
+#define __HAL_UART_CLEAR_FLAG(h, flag)  ((h)->Instance->ICR = (flag))
+#define __HAL_UART_CLEAR_IDLEFLAG(h)    __HAL_UART_CLEAR_FLAG((h), UART_CLEAR_IDLEF)
+#define __HAL_DMA_GET_COUNTER(h)        ((h)->Instance->CNDTR)
+#define __HAL_UART_SEND_REQ(h, req)     Bench_UartRequest((h), (req))
+#define __HAL_DMA_ENABLE(h)             Bench_DmaEnable(h)
+#define __HAL_DMA_DISABLE(h)            CLEAR_BIT((h)->Instance->CCR, DMA_CCR_EN)
+
+void Bench_UartRequest(UART_HandleTypeDef *huart, uint32_t req);
+void Bench_DmaEnable(DMA_HandleTypeDef *hdma);
+uint32_t HAL_GetTick(void);
+static inline uint32_t HAL_RCC_GetPCLK1Freq(void) { return BENCH_PCLK1; }
+void HAL_Delay(uint32_t Delay);
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart);
+
+#endif /* STM32F0XX_HAL_H */
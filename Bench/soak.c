@@ -0,0 +1,1394 @@
+/**
+ * @file    soak.c
+ * @brief   Hours of simulated flight through the bridge and the MQTT driver,
+ *          with faults injected, checked against the link's invariants
+ *
+ * Usage: soak [options] [out.json]   (default build/soak.json)
+ *   -h <hours>     Simulated time (default 1)
+ *   -s <seed>      Fault dice (default 1) - the same seed gives the same run
+ *   -c <pm>        +CMQTTCONNLOST during a publish, per mille of publishes (default 5)
+ *   -e <pm>        ERROR after the AT+CMQTTPAYLOAD data, per mille of publishes (default 5)
+ *   -g <pm>        Noise burst from the modem, per mille of seconds (default 2)
+ *   -n <pm>        Noise burst on USART1 before a parameter frame of a dump (default 20)
+ *   -d <s>         Parameter dump interval (default 300)
+ *   -l <s>         Log download interval: SOAK_LOG_FRAMES LOG_DATA frames at
+ *                  SOAK_LOG_HZ, the first two minutes in (default 0, off).
+ *                  With -u it passes from 5000: below that a download's
+ *                  share of the frames is dropped past SOAK_DROP_LIMIT
+ *   -p <ms>        Publish time of the modem (default 150; passes up to 400)
+ *   -u <B/s>       Uplink capacity of the network: a publish takes its
+ *                  payload at this rate on top of -p (default 0, no limit;
+ *                  passes from 1000). Below what the stand-in streams the
+ *                  bridge sheds - see the deliberate drops below.
+ *                  `soak -u 2000 -j 100` (make check) passes: the shaper's
+ *                  estimate near 2000 B/s, the FC ring under SOAK_RING_LIMIT,
+ *                  nothing lost, about a tenth of the frames dropped
+ *   -i <ms>        Stick input from the ground: a MANUAL_CONTROL message on
+ *                  the rx topic every <ms> while connected (default 100, 0 off)
+ *   -z <0|1>       Let the modem sleep on the ground (default 0)
+ *   -b <baud>      Rate the autopilot sends at; USART1 boots at SOAK_FC_BAUD
+ *                  and has to learn it (default 115200)
+ *   -f <0|1>       QoS 0 publishes done at acceptance (qos0_fire, default
+ *                  APP_MQTT_QOS0_FIRE)
+ *   -1 <0|1>       The stand-in sends its numbered frames as MAVLink v1,
+ *                  payloads ending in zeros (default 0)
+ *   -k <0|1>       Bulk batches with compact headers ("hdr 1"), rebuilt
+ *                  at the broker (default 0)
+ *   -o <hz>        A companion on USART1 as well (sysid 1, SOAK_COMPANION)
+ *                  streaming TUNNEL frames at this rate (default 0, none).
+ *                  Past the uplink's capacity the sources' shares are what
+ *                  to read ("fair"): frames are lost by design then
+ *   -w <0|1>       Start after an MCU reset alone: the module is up, its
+ *                  sessions connected to the broker (default 0, power on)
+ *   -j <ms>        Virtual time: while nothing moves (no command out, rings
+ *                  read out, the wire quiet) the clock jumps to
+ *                  what the model and the stand-ins have due next, at most
+ *                  <ms> at once - the firmware's own timers then fire up
+ *                  to <ms> late (default 0, every millisecond)
+ *   -r <rev>       Build name for the history (default "-")
+ *   -H <file>      Append the report to this history, one JSON line per run
+ *
+ * mavlink_bridge.c (through bench_bridge.c), a7600_mqtt.c, at_engine.c and
+ * uart_dma.c run unchanged against the modem model (modem_sim.c) on a
+ * simulated millisecond clock. An autopilot stand-in streams a status mix
+ * into USART1 at line rate, with a full parameter dump every -d seconds.
+ * Every frame carries its number, and the broker side of the model decodes
+ * what each publish carried, so every frame is accounted for.
+ *
+ * Invariants (a run with violations exits 1):
+ *   - no stuck state: the link is back within SOAK_LINK_MAX_MS of a drop, no
+ *     driver operation runs longer than SOAK_OP_MAX_MS, and while connected
+ *     the uplink delivers at least every SOAK_STALL_MS
+ *   - bounded RX rings: neither UART ring fills past SOAK_RING_LIMIT percent
+ *     and none overruns
+ *   - no frame loss outside declared windows: a frame may go missing only if
+ *     it was fed while the link was down or SOAK_QUEUE_MS before it dropped
+ *     (outage log decimation, once parsed), sat in a publish the model
+ *     failed, or followed USART1 noise by less than SOAK_NOISE_SHADOW bytes.
+ *     Frames of the last SOAK_DRAIN_MS are not judged (still on their way).
+ *   - deliberate drops only: frames the bridge drops on purpose with the
+ *     uplink over its capacity (its shaper, congestion and fair share
+ *     counters) excuse as many frames missing otherwise ("dropped"), and
+ *     may not pass SOAK_DROP_LIMIT percent of the frames fed. The counters
+ *     take the stand-in's unnumbered frames too: they bound the excuse, they
+ *     do not name the frames
+ *   - downlink independent of uplink: every message from the broker reaches
+ *     the FC UART within SOAK_DL_MAX_MS, publishes streaming or not
+ *   - FC rate learned: USART1 locks at the autopilot's rate within
+ *     SOAK_BAUD_MAX_MS (frames before that are excused)
+ *   - streams shaped at the source: the stand-in sends RC_CHANNELS at
+ *     SOAK_RC_US and reboots every SOAK_REBOOT_MS (HEARTBEAT gap, interval
+ *     back to SOAK_RC_US); at the end it must send at the bridge's limit
+ *   - CMUX build (MQTT_CMUX): the channels open, and link samples arrive on
+ *     the monitoring channel
+ *   - warm start (-w 1): the first connect takes over the module's sessions
+ *   - frames intact: every frame the broker decodes passes its checksum
+ *     (-1 1: numbered frames arrive as v2, their zero tails cut)
+ *
+ * Throughput (delivered frames and bytes per hour) and recovery times (drop
+ * to connected again) go to the report. Append runs of each build to one
+ * history (-H, `make soak` does) and compare the lines to follow the trend.
+ */
+
+#include "bench.h"
+#include "app.h"
+#include "a7600_mqtt.h"
+#include "mavlink_bridge.h"
+#include "outage_log.h"
+#include "uplink_probe.h"
+#if APP_MQTT_VERIFY_TLS || PROBE_ENABLE
+#include "certificates.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOAK_FC_BAUD        115200      /* USART1 at boot (MX_USART1_UART_Init) */
+#define SOAK_BAUD_MAX_MS    5000        /* Boot to the FC rate locked in */
+#define SOAK_LINK_MAX_MS    120000      /* Drop to connected again */
+#define SOAK_OP_MAX_MS      120000      /* One driver operation */
+#define SOAK_STALL_MS       20000       /* Connected without a delivery while frames wait */
+#define SOAK_RING_LIMIT     90          /* Percent of an RX ring */
+#define SOAK_DROP_LIMIT     20          /* Percent of the frames fed the bridge may drop on purpose */
+#define SOAK_NOISE_SHADOW   300         /* Bytes after a noise burst whose frames may be lost */
+#define SOAK_DRAIN_MS       60000       /* Feeding stops this long before the end */
+#define SOAK_QUEUE_MS       1000        /* Frames fed this long before a drop may be parsed after it */
+#define SOAK_RETRY_MS       1000        /* After a failed connect */
+#define SOAK_FIFO           4096        /* Bytes waiting for the USART1 wire */
+#define SOAK_FRAME_MAX      280         /* Largest MAVLink v2 frame, signed */
+#define SOAK_DUMP_PARAMS    600
+#define SOAK_NOISE_MAX      16
+#define SOAK_VIOLATIONS     20          /* Listed in the report */
+#define SOAK_ID_OFFSET      8           /* Frame number in the payload, past every dedup prefix */
+#define SOAK_HC_FLAG        0x02        /* First byte of a compact header batch */
+#define SOAK_DL_MAX_MS      20          /* Broker message out of the modem to its frame on USART1 */
+#define SOAK_RC_US          100000      /* RC_CHANNELS interval of the stand-in until told otherwise */
+#define SOAK_RC_SHAPED_US   500000      /* Its interval at the bridge's limit (2 Hz) */
+#define SOAK_REBOOT_MS      600000      /* Stand-in reboots this often, the first two minutes in */
+#define SOAK_REBOOT_GAP     4000        /* HEARTBEAT silence of a reboot */
+#define SOAK_LOG_FRAMES     2000        /* LOG_DATA frames of a log download (180 kB of log) */
+#define SOAK_LOG_HZ         40          /* ... sent at this rate */
+
+/* Frame accounting */
+#define FRAME_EXCUSED       0x01        /* In a declared window */
+#define FRAME_DELIVERED     0x02
+
+/* Autopilot stand-in: message mix, frames per second */
+static const struct {
+    uint32_t msgid;
+    uint8_t len;
+    uint8_t hz;
+} soak_mix[] = {
+    {  1, 31, 2 },      /* SYS_STATUS */
+    { 33, 28, 5 },      /* GLOBAL_POSITION_INT */
+    { 62, 26, 2 },      /* NAV_CONTROLLER_OUTPUT */
+    { 74, 20, 4 },      /* VFR_HUD */
+};
+#define SOAK_MIX            (sizeof(soak_mix) / sizeof(soak_mix[0]))
+#define PARAM_VALUE_ID      22
+#define PARAM_VALUE_LEN     25
+#define MANUAL_CONTROL_ID   69
+#define MANUAL_CONTROL_LEN  11
+#define HEARTBEAT_ID        0
+#define HEARTBEAT_LEN       9
+#define RC_CHANNELS_ID      65
+#define RC_CHANNELS_LEN     42
+#define COMMAND_LONG_ID     76
+#define COMMAND_ACK_ID      77
+#define COMMAND_ACK_LEN     10
+#define MAV_CMD_SET_MESSAGE_INTERVAL    511
+#define LOG_DATA_ID         120
+#define LOG_DATA_LEN        97
+#define TUNNEL_ID           385
+#define TUNNEL_LEN          133
+#define SOAK_COMPANION      191         /* Component ID of the companion stand-in (MAV_COMP_ID_ONBOARD_COMPUTER) */
+
+/* Modules under test */
+static UART_HandleTypeDef sim_huart, fc_huart;
+static UART_DMA_Handle_t sim_uart, fc_uart;
+static uint8_t sim_rx[SIM_UART_RX_BUFFER_SIZE], sim_tx[SIM_UART_TX_BUFFER_SIZE];
+static uint8_t fc_rx[TELEM_UART_RX_BUFFER_SIZE], fc_tx[TELEM_UART_TX_BUFFER_SIZE];
+static A7600_MQTT_Handle_t mqtt;
+static uint32_t now;
+
+/* Frames */
+static uint8_t *frame_state;
+static uint32_t frame_count, frame_cap;
+static uint32_t delivered_bytes;
+static uint32_t broken;                 /* Frames failing their checksum at the broker */
+static uint32_t v1_seen;                /* ... still in v1 there */
+static uint32_t hc_batches;             /* Batches with compact headers */
+static uint32_t fc_bytes, comp_bytes;   /* Delivered frame bytes of the autopilot and the companion */
+
+/* Autopilot stand-in */
+static struct {
+    bool on;
+    uint32_t acc[SOAK_MIX];             /* Rate accumulators, 1000 per frame due */
+    uint8_t seq;
+    bool v1;                            /* Numbered frames as v1 (-1) */
+    uint8_t fifo[SOAK_FIFO];
+    size_t fifo_len;
+    uint32_t baud;                      /* Line rate */
+    uint32_t locked_ms;                 /* USART1 rate locked in (0: not yet) */
+    uint32_t wire;                      /* Bit budget of USART1 */
+    uint32_t dump_tick;
+    uint16_t dump_left;
+    uint32_t shadow;                    /* Bytes still behind the last noise burst */
+    uint32_t dumps, noise;
+    uint16_t noise_pm;
+    uint32_t dump_ms;
+    uint32_t rand;
+    uint32_t hb_next;                   /* Next HEARTBEAT (held back by a reboot) */
+    uint32_t rc_us;                     /* RC_CHANNELS interval (0: off) */
+    uint32_t rc_next;
+    uint32_t reboot_at;
+    uint32_t reboots, intervals;        /* SET_MESSAGE_INTERVAL commands obeyed */
+    uint32_t log_ms;                    /* Log download interval (0: none) */
+    uint32_t log_tick;
+    uint16_t log_left;
+    uint32_t log_acc;
+    uint32_t logs;
+    uint32_t comp_hz;                   /* Companion TUNNEL frames a second (0: none) */
+    uint32_t comp_acc;
+    uint8_t comp_seq;
+} fc;
+
+/* Link and invariants */
+static enum { LINK_WAIT, LINK_CONNECTING, LINK_UP, LINK_RETRY } link;
+static uint32_t link_tick;
+static bool up;                         /* A7600_MQTT_IsConnected last pass */
+static uint32_t down_since;             /* 0: link up */
+static uint32_t *recovery;
+static uint32_t recovery_count, recovery_cap;
+static uint32_t op_since, stall_since;
+static uint32_t last_publishes;
+static bool flagged_link, flagged_op, flagged_stall;
+static bool warm;                       /* -w: the first connect should resume */
+static bool resumed;                    /* ... and did */
+static uint32_t resume_ms;
+static uint32_t frame_at[SOAK_QUEUE_MS];    /* Frames fed by each of the last milliseconds */
+static size_t sim_ring_max, fc_ring_max;
+static uint32_t jump;                   /* -j: longest jump of the clock, ms (0: none) */
+static uint32_t passes;                 /* Firmware main loop passes run */
+
+/* Ground station stand-in: numbered stick messages and when each went out */
+static struct {
+    uint32_t ms;                        /* Interval, 0: none */
+    uint32_t tick;
+    uint32_t *sent_at;
+    uint32_t count, cap;
+    uint32_t *lat;                      /* Per message that reached USART1 */
+    uint32_t got;
+    uint32_t streaming;                 /* Sent while a publish was being staged or awaited */
+    uint32_t late;
+} gcs;
+static struct {
+    uint32_t t;
+    char what[48];
+} violations[SOAK_VIOLATIONS];
+static uint32_t violation_count;
+
+/* Outage log: a RAM ring the size of the flash one */
+static uint8_t outage[OUTAGE_LOG_PAGES * OUTAGE_LOG_PAGE_SIZE];
+static size_t outage_head, outage_len;
+
+static void violation(const char *what)
+{
+    if (violation_count < SOAK_VIOLATIONS) {
+        violations[violation_count].t = now;
+        snprintf(violations[violation_count].what, sizeof(violations[0].what), "%s", what);
+    }
+    violation_count++;
+}
+
+static uint32_t soak_rand(uint32_t n)
+{
+    fc.rand ^= fc.rand << 13;
+    fc.rand ^= fc.rand >> 17;
+    fc.rand ^= fc.rand << 5;
+    return fc.rand % n;
+}
+
+/* ==================== Autopilot stand-in ==================== */
+
+/**
+ * @brief Queue one numbered frame for the wire
+ */
+static void fc_frame(uint32_t msgid, size_t len)
+{
+    uint8_t payload[LOG_DATA_LEN];
+    uint8_t f[SOAK_FRAME_MAX];
+    size_t n;
+    
+    if (frame_count == frame_cap) {
+        frame_cap = frame_cap ? frame_cap * 2 : 65536;
+        frame_state = realloc(frame_state, frame_cap);
+        if (frame_state == NULL) {
+            exit(1);
+        }
+    }
+    for (size_t j = 0; j < len; j++) {
+        payload[j] = (uint8_t)(j | 0x80);           /* Nonzero to the end: nothing trimmed */
+    }
+    memcpy(&payload[SOAK_ID_OFFSET], &frame_count, 4);
+    if (fc.v1) {
+        /* Zeros past a marker after the number: the bridge cuts them */
+        memset(&payload[SOAK_ID_OFFSET + 5], 0, len - (SOAK_ID_OFFSET + 5));
+        n = Bench_FrameV1(f, payload, len, fc.seq++, msgid);
+    } else {
+        n = Bench_Frame(f, payload, len, fc.seq++, msgid);
+    }
+    
+    /* Declared windows: link down, in the shadow of USART1 noise, or USART1 still learning the rate */
+    frame_state[frame_count] = (!up || fc.shadow > 0 || fc.locked_ms == 0) ? FRAME_EXCUSED : 0;
+    fc.shadow = (fc.shadow > n) ? fc.shadow - (uint32_t)n : 0;
+    frame_count++;
+    
+    memcpy(&fc.fifo[fc.fifo_len], f, n);
+    fc.fifo_len += n;
+}
+
+/**
+ * @brief Queue a frame the accounting does not follow (no frame number)
+ */
+static void fc_extra(uint32_t msgid, const uint8_t *payload, size_t len)
+{
+    uint8_t f[SOAK_FRAME_MAX];
+    
+    if (fc.fifo_len + SOAK_FRAME_MAX <= SOAK_FIFO) {
+        size_t n = Bench_Frame(f, payload, len, fc.seq++, msgid);
+        
+        memcpy(&fc.fifo[fc.fifo_len], f, n);
+        fc.fifo_len += n;
+    }
+}
+
+/**
+ * @brief A frame of the companion sharing USART1 (sysid 1, SOAK_COMPANION), not followed
+ */
+static void fc_companion(void)
+{
+    uint8_t payload[TUNNEL_LEN];
+    uint8_t f[SOAK_FRAME_MAX];
+    size_t n;
+    
+    if (fc.fifo_len + SOAK_FRAME_MAX > SOAK_FIFO) {
+        return;
+    }
+    for (size_t j = 0; j < sizeof(payload); j++) {
+        payload[j] = (uint8_t)(j | 0x80);           /* Nonzero to the end: nothing trimmed */
+    }
+    n = Bench_Frame(f, payload, sizeof(payload), fc.comp_seq++, TUNNEL_ID);
+    f[6] = SOAK_COMPANION;
+    Bench_FrameCrc(f);
+    memcpy(&fc.fifo[fc.fifo_len], f, n);
+    fc.fifo_len += n;
+}
+
+/**
+ * @brief The stand-in's HEARTBEAT and RC_CHANNELS (at the interval it was told), and its reboots
+ */
+static void fc_streams(void)
+{
+    uint8_t p[RC_CHANNELS_LEN];
+    
+    if (now >= fc.reboot_at) {
+        fc.reboot_at += SOAK_REBOOT_MS;
+        fc.hb_next = now + SOAK_REBOOT_GAP;
+        fc.rc_us = SOAK_RC_US;
+        fc.reboots++;
+    }
+    if (now >= fc.hb_next) {
+        memset(p, 0, HEARTBEAT_LEN);
+        p[4] = 2;       /* MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA, disarmed, MAVLink 2 */
+        p[5] = 3;
+        p[8] = 3;
+        fc_extra(HEARTBEAT_ID, p, HEARTBEAT_LEN);
+        fc.hb_next = now + 1000;
+    }
+    if (fc.rc_us > 0 && now >= fc.rc_next) {
+        memset(p, 0x7F, sizeof(p));
+        memset(&p[SOAK_ID_OFFSET], 0xFF, 4);    /* Past any frame number */
+        fc_extra(RC_CHANNELS_ID, p, RC_CHANNELS_LEN);
+        fc.rc_next = now + fc.rc_us / 1000;
+    }
+    fc.comp_acc += fc.comp_hz;
+    if (fc.comp_acc >= 1000) {
+        fc.comp_acc -= 1000;
+        fc_companion();
+    }
+}
+
+/**
+ * @brief One millisecond of the autopilot: frames due, then the wire
+ */
+static void fc_step(void)
+{
+    size_t bytes;
+    
+    if (fc.locked_ms == 0 && !(fc_huart.Instance->CR2 & USART_CR2_ABREN)) {
+        fc.locked_ms = now;
+    }
+    if (fc.on) {
+        fc_streams();
+        for (size_t i = 0; i < SOAK_MIX; i++) {
+            fc.acc[i] += soak_mix[i].hz;
+            if (fc.acc[i] >= 1000 && fc.fifo_len + SOAK_FRAME_MAX <= SOAK_FIFO) {
+                fc.acc[i] -= 1000;
+                fc_frame(soak_mix[i].msgid, soak_mix[i].len);
+            }
+        }
+        if (now - fc.dump_tick >= fc.dump_ms) {
+            fc.dump_tick = now;
+            fc.dump_left = SOAK_DUMP_PARAMS;
+            fc.dumps++;
+        }
+        /* A dump goes as fast as the wire takes it */
+        while (fc.dump_left > 0 && fc.fifo_len + SOAK_FRAME_MAX + SOAK_NOISE_MAX <= SOAK_FIFO / 4) {
+            if (fc.noise_pm > 0 && soak_rand(1000) < fc.noise_pm) {
+                uint32_t n = 1 + soak_rand(SOAK_NOISE_MAX);
+                
+                for (uint32_t j = 0; j < n; j++) {
+                    fc.fifo[fc.fifo_len++] = (uint8_t)soak_rand(256);
+                }
+                fc.shadow = SOAK_NOISE_SHADOW;
+                fc.noise++;
+            }
+            fc_frame(PARAM_VALUE_ID, PARAM_VALUE_LEN);
+            fc.dump_left--;
+        }
+        
+        /* A log download at a steady rate, as the GCS requests it */
+        if (fc.log_ms > 0 && now - fc.log_tick >= fc.log_ms) {
+            fc.log_tick = now;
+            fc.log_left = SOAK_LOG_FRAMES;
+            fc.log_acc = 0;
+            fc.logs++;
+        }
+        if (fc.log_left > 0) {
+            fc.log_acc += SOAK_LOG_HZ;
+            if (fc.log_acc >= 1000 && fc.fifo_len + SOAK_FRAME_MAX <= SOAK_FIFO) {
+                fc.log_acc -= 1000;
+                fc_frame(LOG_DATA_ID, LOG_DATA_LEN);
+                fc.log_left--;
+            }
+        }
+    }
+    
+    /* 10 bits a byte at the line rate */
+    fc.wire += fc.baud / 1000;
+    bytes = fc.wire / 10;
+    if (bytes > fc.fifo_len) {
+        bytes = fc.fifo_len;
+        fc.wire = 0;
+    } else {
+        fc.wire -= (uint32_t)bytes * 10;
+    }
+    if (bytes > 0) {
+        Bench_UartReceive(&fc_uart, fc.fifo, bytes);
+        memmove(fc.fifo, &fc.fifo[bytes], fc.fifo_len - bytes);
+        fc.fifo_len -= bytes;
+    }
+}
+
+/* ==================== Broker side ==================== */
+
+static int b64_val(uint8_t c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    return (c == '+') ? 62 : (c == '/') ? 63 : -1;
+}
+
+/**
+ * @brief Rebuild the frames of a compact header batch (Core/Doc/mavlink_uplink_hc.md)
+ * @return Bytes of frames in out, as far as the records were whole
+ */
+static size_t hc_decode(const uint8_t *in, size_t n, uint8_t *out, size_t room)
+{
+    uint8_t seq = 0, sysid = 0, compid = 0;
+    size_t got = 0;
+    
+    for (size_t pos = 1; pos < n; ) {
+        uint8_t ctrl = in[pos++];
+        uint8_t iflags = 0, cflags = 0;
+        uint32_t msgid = 0;
+        uint8_t shift = 0;
+        uint8_t *f = &out[got];
+        size_t header_len = (ctrl & 0x04) ? 6 : 10;
+        size_t flen;
+        
+        seq = (ctrl & 0x02) ? (uint8_t)(seq + 1) : (pos < n) ? in[pos++] : 0;
+        if (!(ctrl & 0x01) && pos + 2 <= n) {
+            sysid = in[pos++];
+            compid = in[pos++];
+        }
+        if ((ctrl & 0x08) && pos + 2 <= n) {
+            iflags = in[pos++];
+            cflags = in[pos++];
+        }
+        while (pos < n && shift < 28) {
+            msgid |= (uint32_t)(in[pos] & 0x7F) << shift;
+            shift += 7;
+            if (!(in[pos++] & 0x80)) {
+                break;
+            }
+        }
+        if (pos >= n) {
+            break;
+        }
+        flen = header_len + in[pos] + 2 + ((iflags & 0x01) ? 13 : 0);
+        if (pos + 1 + flen - header_len - 2 > n || got + flen > room) {
+            break;
+        }
+        if (ctrl & 0x04) {
+            uint8_t h[6] = { 0xFE, in[pos], seq, sysid, compid, (uint8_t)msgid };
+            
+            memcpy(f, h, sizeof(h));
+        } else {
+            uint8_t h[10] = { 0xFD, in[pos], iflags, cflags, seq, sysid, compid,
+                              (uint8_t)msgid, (uint8_t)(msgid >> 8), (uint8_t)(msgid >> 16) };
+            
+            memcpy(f, h, sizeof(h));
+        }
+        pos++;
+        memcpy(&f[header_len], &in[pos], f[1]);
+        pos += f[1];
+        Bench_FrameCrc(f);
+        if (iflags & 0x01) {
+            memcpy(&f[header_len + f[1] + 2], &in[pos], 13);
+            pos += 13;
+        }
+        got += flen;
+    }
+    return got;
+}
+
+/**
+ * @brief A publish reached the broker, or failed: mark the frames it carried
+ */
+static void broker(const char *topic, const uint8_t *payload, size_t len, bool delivered)
+{
+    uint8_t raw[2048];
+    static uint8_t frames[4096];
+    size_t n = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    
+    if (strncmp(topic, "uav4g/mavlink/", 14) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < len && n < sizeof(raw); i++) {
+        int v = b64_val(payload[i]);
+        
+        if (v < 0) {
+            continue;
+        }
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            raw[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    if (delivered) {
+        delivered_bytes += (uint32_t)n;
+    }
+    if (n > 0 && raw[0] == SOAK_HC_FLAG) {
+        n = hc_decode(raw, n, frames, sizeof(frames));
+        hc_batches++;
+    } else {
+        memcpy(frames, raw, n);
+    }
+    
+    /* Batches are whole frames back to back (rebuilt from compact headers) */
+    for (size_t pos = 0; pos + 12 <= n; ) {
+        size_t flen = 12 + frames[pos + 1] + ((frames[pos + 2] & 0x01) ? 13 : 0);
+        uint32_t id;
+        
+        if (frames[pos] == 0xFE) {
+            v1_seen++;
+            break;
+        }
+        if (frames[pos] != 0xFD || pos + flen > n) {
+            break;
+        }
+        if (!Bench_FrameValid(&frames[pos])) {
+            broken++;
+        }
+        if (delivered) {
+            *((frames[pos + 6] == SOAK_COMPANION) ? &comp_bytes : &fc_bytes) += (uint32_t)flen;
+        }
+        memcpy(&id, &frames[pos + 10 + SOAK_ID_OFFSET], 4);
+        if (frames[pos + 5] == 1 && frames[pos + 6] == 1 && frames[pos + 1] > SOAK_ID_OFFSET + 4 &&
+            id < frame_count) {
+            frame_state[id] |= delivered ? FRAME_DELIVERED : FRAME_EXCUSED;
+        }
+        pos += flen;
+    }
+}
+
+/* ==================== Ground station side ==================== */
+
+static void b64_put(const uint8_t *in, size_t len, char *out)
+{
+    static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        
+        v |= (i + 1 < len) ? (uint32_t)in[i + 1] << 8 : 0;
+        v |= (i + 2 < len) ? in[i + 2] : 0;
+        *out++ = abc[v >> 18];
+        *out++ = abc[(v >> 12) & 0x3F];
+        *out++ = (i + 1 < len) ? abc[(v >> 6) & 0x3F] : '=';
+        *out++ = (i + 2 < len) ? abc[v & 0x3F] : '=';
+    }
+    *out = '\0';
+}
+
+/**
+ * @brief Stick input due: one numbered MANUAL_CONTROL for the autopilot (sysid 1)
+ */
+static void gcs_step(void)
+{
+    uint8_t payload[MANUAL_CONTROL_LEN] = { 0 };
+    uint8_t f[SOAK_FRAME_MAX];
+    char text[96];
+    size_t n;
+    
+    if (gcs.ms == 0 || now - gcs.tick < gcs.ms) {
+        return;
+    }
+    gcs.tick = now;
+    if (gcs.count == gcs.cap) {
+        gcs.cap = gcs.cap ? gcs.cap * 2 : 65536;
+        gcs.sent_at = realloc(gcs.sent_at, gcs.cap * sizeof(*gcs.sent_at));
+        gcs.lat = realloc(gcs.lat, gcs.cap * sizeof(*gcs.lat));
+        if (gcs.sent_at == NULL || gcs.lat == NULL) {
+            exit(1);
+        }
+    }
+    memcpy(payload, &gcs.count, 4);                 /* x, y: message number */
+    payload[8] = 0xFF;                              /* buttons: not trimmed */
+    payload[10] = 1;                                /* target */
+    n = Bench_Frame(f, payload, sizeof(payload), (uint8_t)gcs.count, MANUAL_CONTROL_ID);
+    b64_put(f, n, text);
+    if (Bench_SimInbound(BRIDGE_TOPIC_RX, text)) {
+        gcs.sent_at[gcs.count++] = now + 1;        /* Out of the modem in the next millisecond */
+        if (mqtt.op == MQTT_OP_PUBLISH || A7600_MQTT_PublishInFlight(&mqtt) > 0) {
+            gcs.streaming++;
+        }
+    }
+}
+
+/**
+ * @brief What the bridge writes to USART1: find the stick messages
+ */
+static void fc_sink(void *ctx, const uint8_t *data, size_t len)
+{
+    (void)ctx;
+    for (size_t pos = 0; pos + 12 <= len; ) {
+        size_t flen = 12 + data[pos + 1] + ((data[pos + 2] & 0x01) ? 13 : 0);
+        uint32_t id;
+        
+        if (data[pos] != 0xFD) {
+            pos++;
+            continue;
+        }
+        
+        /* SET_MESSAGE_INTERVAL: obeyed for RC_CHANNELS, accepted for anything */
+        if (data[pos + 7] == COMMAND_LONG_ID && data[pos + 8] == 0 && pos + flen <= len) {
+            uint8_t p[32] = { 0 };
+            float param[2];
+            
+            memcpy(p, &data[pos + 10], data[pos + 1] < sizeof(p) ? data[pos + 1] : sizeof(p));
+            memcpy(param, p, sizeof(param));
+            if ((p[28] | (p[29] << 8)) == MAV_CMD_SET_MESSAGE_INTERVAL) {
+                uint8_t ack[COMMAND_ACK_LEN] = { p[28], p[29], 0, 0, 0, 0, 0, 0, data[pos + 5], data[pos + 6] };
+                
+                if ((uint32_t)param[0] == RC_CHANNELS_ID) {
+                    fc.rc_us = (param[1] < 0) ? 0 : (param[1] == 0) ? SOAK_RC_US : (uint32_t)param[1];
+                }
+                fc.intervals++;
+                fc_extra(COMMAND_ACK_ID, ack, COMMAND_ACK_LEN);
+            }
+        }
+        if (data[pos + 7] == MANUAL_CONTROL_ID && data[pos + 8] == 0 && data[pos + 1] >= 4) {
+            memcpy(&id, &data[pos + 10], 4);
+            if (id < gcs.count) {
+                uint32_t lat = now - gcs.sent_at[id];
+                
+                gcs.lat[gcs.got++] = lat;
+                if (lat > SOAK_DL_MAX_MS && gcs.late++ == 0) {
+                    violation("downlink late");
+                }
+            }
+        }
+        pos += flen;
+    }
+}
+
+/* ==================== Harness ==================== */
+
+/**
+ * @brief One simulated millisecond of everything but the firmware's main loop
+ */
+static void soak_tick(void)
+{
+    size_t used;
+    
+    Bench_SetTick(++now);
+    Bench_SimStep();
+    Bench_UartTxDone(&fc_uart);             /* Downlink frames to the FC leave at once */
+    fc_step();
+    if (up) {
+        gcs_step();
+    }
+    frame_at[now % SOAK_QUEUE_MS] = frame_count;
+    
+    used = UART_DMA_Available(&sim_uart);
+    if (used > sim_ring_max) {
+        sim_ring_max = used;
+    }
+    used = UART_DMA_Available(&fc_uart);
+    if (used > fc_ring_max) {
+        fc_ring_max = used;
+    }
+}
+
+/**
+ * @brief Accrual of one millisecond the wire stays quiet in: the stand-in's rate accumulators
+ */
+static void fc_quiet(void)
+{
+    if (fc.on) {
+        for (size_t i = 0; i < SOAK_MIX; i++) {
+            fc.acc[i] += soak_mix[i].hz;
+        }
+        fc.comp_acc += fc.comp_hz;
+        if (fc.log_left > 0) {
+            fc.log_acc += SOAK_LOG_HZ;
+        }
+    }
+    fc.wire += fc.baud / 1000;
+    if (fc.wire >= 10) {
+        fc.wire = 0;
+    }
+}
+
+/**
+ * @brief Millisecond an accumulator gaining hz a millisecond reaches a frame
+ */
+static uint32_t fc_due(uint32_t acc, uint32_t hz)
+{
+    return (acc >= 1000) ? now + 1 : now + (1000 - acc + hz - 1) / hz;
+}
+
+/**
+ * @brief -j: jump the clock to the next thing due while nothing moves
+ *
+ * Nothing moves: the driver has no command out, no transfer waits for its
+ * completion, both RX rings are read out and the USART1 wire is quiet. The
+ * stand-ins and the link steps then say when they are next due, as the model
+ * does on its own; the firmware's timers are not known, so a jump is at most
+ * -j. The milliseconds jumped over see no bytes, only the accumulators and
+ * the frame window move.
+ */
+static void soak_jump(uint32_t end)
+{
+    uint32_t to;
+    
+    Bench_WakeAt(end);
+    if (fc.on) {
+        Bench_WakeAt(end - SOAK_DRAIN_MS);
+        for (size_t i = 0; i < SOAK_MIX; i++) {
+            Bench_WakeAt(fc_due(fc.acc[i], soak_mix[i].hz));
+        }
+        if (fc.comp_hz > 0) {
+            Bench_WakeAt(fc_due(fc.comp_acc, fc.comp_hz));
+        }
+        if (fc.log_left > 0) {
+            Bench_WakeAt(fc_due(fc.log_acc, SOAK_LOG_HZ));
+        }
+        if (fc.log_ms > 0) {
+            Bench_WakeAt(fc.log_tick + fc.log_ms);
+        }
+        if (fc.rc_us > 0) {
+            Bench_WakeAt(fc.rc_next);
+        }
+        Bench_WakeAt(fc.dump_tick + fc.dump_ms);
+        Bench_WakeAt(fc.hb_next);
+        Bench_WakeAt(fc.reboot_at);
+    }
+    if (up && gcs.ms > 0) {
+        Bench_WakeAt(gcs.tick + gcs.ms);
+    }
+    if (link == LINK_WAIT) {
+        Bench_WakeAt(link_tick + APP_MODULE_PROBE_INTERVAL);
+    } else if (link == LINK_RETRY) {
+        Bench_WakeAt(link_tick + SOAK_RETRY_MS);
+    }
+    to = Bench_NextWake(now + jump);
+    
+    if (A7600_MQTT_IsBusy(&mqtt) || !Bench_TxIdle() ||
+        UART_DMA_Available(&sim_uart) > 0 || UART_DMA_Available(&fc_uart) > 0 ||
+        fc.fifo_len > 0 || fc.dump_left > 0 || fc.locked_ms == 0) {
+        return;
+    }
+    while (now + 1 < to) {
+        now++;
+        fc_quiet();
+        frame_at[now % SOAK_QUEUE_MS] = frame_count;
+    }
+    Bench_SetTick(now);
+}
+
+static void idle_hook(void *ctx)
+{
+    (void)ctx;
+    MavlinkBridge_Idle();
+}
+
+static void connect_done(void *ctx, MQTT_Result_t result)
+{
+    (void)ctx;
+    if (warm && result == MQTT_OK && resume_ms == 0) {
+        resumed = A7600_MQTT_GetConnectStats(&mqtt)->resumed;
+        resume_ms = now;
+    }
+    link = (result == MQTT_OK) ? LINK_UP : LINK_RETRY;
+    link_tick = now;
+#if PROBE_ENABLE
+    if (result == MQTT_OK) {
+        UplinkProbe_Start();
+    }
+#endif
+}
+
+/**
+ * @brief The link task of app.c, reduced: connect, reconnect on loss
+ */
+static void link_step(void)
+{
+    switch (link) {
+    case LINK_WAIT:
+        if (warm && resume_ms == 0) {
+            /* As the link task does after an MCU reset alone: no boot URCs to wait for */
+            if (A7600_MQTT_ResumeAsync(&mqtt, connect_done, NULL) == MQTT_OK) {
+                link = LINK_CONNECTING;
+            }
+        } else if (A7600_MQTT_ModuleReady(&mqtt)) {
+            if (A7600_MQTT_ConnectAsync(&mqtt, connect_done, NULL) == MQTT_OK) {
+                link = LINK_CONNECTING;
+            }
+        } else if (now - link_tick >= APP_MODULE_PROBE_INTERVAL) {
+            link_tick = now;
+            A7600_MQTT_ProbeModule(&mqtt);
+        }
+        break;
+    
+    case LINK_UP:
+        if (!A7600_MQTT_IsConnected(&mqtt)) {
+            link = LINK_RETRY;
+            link_tick = now - SOAK_RETRY_MS;
+        }
+        break;
+    
+    case LINK_RETRY:
+        if (now - link_tick >= SOAK_RETRY_MS &&
+            A7600_MQTT_ReconnectAsync(&mqtt, connect_done, NULL) == MQTT_OK) {
+            link = LINK_CONNECTING;
+        }
+        break;
+    
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Check the stuck-state invariants once per pass
+ */
+static void check_states(void)
+{
+    bool connected = A7600_MQTT_IsConnected(&mqtt);
+    uint32_t publishes = Bench_SimStats()->publishes;
+    
+    /* Drops and recoveries (the first connect is not a recovery) */
+    if (up && !connected) {
+        down_since = now;
+        for (uint32_t i = frame_at[(now + 1) % SOAK_QUEUE_MS]; i < frame_count; i++) {
+            frame_state[i] |= FRAME_EXCUSED;
+        }
+    } else if (!up && connected && down_since != 0) {
+        if (recovery_count == recovery_cap) {
+            recovery_cap = recovery_cap ? recovery_cap * 2 : 256;
+            recovery = realloc(recovery, recovery_cap * sizeof(*recovery));
+            if (recovery == NULL) {
+                exit(1);
+            }
+        }
+        recovery[recovery_count++] = now - down_since;
+        down_since = 0;
+        flagged_link = false;
+    }
+    up = connected;
+    if (!up && now - (down_since ? down_since : 0) >= SOAK_LINK_MAX_MS && !flagged_link) {
+        violation("link down too long");
+        flagged_link = true;
+    }
+    
+    if (mqtt.op == MQTT_OP_NONE) {
+        op_since = now;
+        flagged_op = false;
+    } else if (now - op_since >= SOAK_OP_MAX_MS && !flagged_op) {
+        violation("driver operation stuck");
+        flagged_op = true;
+    }
+    
+    if (!up || publishes != last_publishes || frame_count == 0) {
+        stall_since = now;
+        last_publishes = publishes;
+        flagged_stall = false;
+    } else if (now - stall_since >= SOAK_STALL_MS && fc.on && !flagged_stall) {
+        violation("uplink stalled while connected");
+        flagged_stall = true;
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    
+    return (x > y) - (x < y);
+}
+
+/* ==================== Outage log ==================== */
+
+bool OutageLog_Put(const UART_DMA_Span_t part[2], size_t len)
+{
+    size_t need = len + 2;
+    
+    /* Full: the oldest frames make room, as the flash ring erases its oldest page */
+    while (outage_len + need > sizeof(outage) && outage_len > 0) {
+        size_t old = outage[outage_head] | (outage[(outage_head + 1) % sizeof(outage)] << 8);
+        
+        outage_head = (outage_head + old + 2) % sizeof(outage);
+        outage_len -= old + 2;
+    }
+    size_t pos = (outage_head + outage_len) % sizeof(outage);
+    uint8_t hdr[2] = { (uint8_t)len, (uint8_t)(len >> 8) };
+    
+    for (size_t i = 0; i < 2; i++, pos = (pos + 1) % sizeof(outage)) {
+        outage[pos] = hdr[i];
+    }
+    for (size_t k = 0; k < 2; k++) {
+        for (size_t i = 0; i < part[k].len; i++, pos = (pos + 1) % sizeof(outage)) {
+            outage[pos] = part[k].data[i];
+        }
+    }
+    outage_len += need;
+    return true;
+}
+
+size_t OutageLog_Peek(const uint8_t **frame)
+{
+    static uint8_t copy[SOAK_FRAME_MAX];
+    size_t len;
+    
+    if (outage_len == 0) {
+        return 0;
+    }
+    len = outage[outage_head] | (outage[(outage_head + 1) % sizeof(outage)] << 8);
+    for (size_t i = 0; i < len && i < sizeof(copy); i++) {
+        copy[i] = outage[(outage_head + 2 + i) % sizeof(outage)];
+    }
+    *frame = copy;
+    return len;
+}
+
+void OutageLog_Pop(void)
+{
+    size_t len;
+    
+    if (outage_len == 0) {
+        return;
+    }
+    len = outage[outage_head] | (outage[(outage_head + 1) % sizeof(outage)] << 8);
+    outage_head = (outage_head + len + 2) % sizeof(outage);
+    outage_len -= len + 2;
+}
+
+/* ==================== Main ==================== */
+
+int main(int argc, char **argv)
+{
+    double hours = 1.0;
+    Bench_SimConfig_t config = {
+        .seed = 1, .boot_ms = 3000, .connect_ms = 800, .publish_ms = 150,
+        .connlost = 5, .payload_error = 5, .garbage = 2
+    };
+    const char *rev = "-";
+    const char *history = NULL;
+    const char *out = "build/soak.json";
+    uint32_t dump_s = 300;
+    uint32_t log_s = 0;
+    bool sleep = false;
+    bool fire = (APP_MQTT_QOS0_FIRE != 0);
+    bool hdr = false;
+    bool bad = false;
+    int arg = 1;
+    
+    gcs.ms = 100;
+    fc.noise_pm = 20;
+    fc.baud = SOAK_FC_BAUD;
+    /* Options are one letter and always take a value: anything else is an error, never an output path */
+    for (; arg < argc && argv[arg][0] == '-' && !bad; arg += 2) {
+        const char *v = argv[arg + 1];
+        
+        if (arg + 1 >= argc || argv[arg][1] == '\0' || argv[arg][2] != '\0') {
+            bad = true;
+            break;
+        }
+        switch (argv[arg][1]) {
+        case 'h': hours = atof(v); break;
+        case 's': config.seed = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'c': config.connlost = (uint16_t)strtoul(v, NULL, 10); break;
+        case 'e': config.payload_error = (uint16_t)strtoul(v, NULL, 10); break;
+        case 'g': config.garbage = (uint16_t)strtoul(v, NULL, 10); break;
+        case 'n': fc.noise_pm = (uint16_t)strtoul(v, NULL, 10); break;
+        case 'd': dump_s = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'l': log_s = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'p': config.publish_ms = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'u': config.uplink_bps = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'r': rev = v; break;
+        case 'H': history = v; break;
+        case 'i': gcs.ms = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'z': sleep = (strtoul(v, NULL, 10) != 0); break;
+        case 'b': fc.baud = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'w': warm = (strtoul(v, NULL, 10) != 0); break;
+        case 'f': fire = (strtoul(v, NULL, 10) != 0); break;
+        case '1': fc.v1 = (strtoul(v, NULL, 10) != 0); break;
+        case 'k': hdr = (strtoul(v, NULL, 10) != 0); break;
+        case 'o': fc.comp_hz = (uint32_t)strtoul(v, NULL, 10); break;
+        case 'j': jump = (uint32_t)strtoul(v, NULL, 10); break;
+        default: bad = true; break;
+        }
+    }
+    if (bad || arg + 1 < argc || hours <= 0 || dump_s == 0 || fc.baud < 1000) {
+        fprintf(stderr, "usage: soak [-h hours] [-s seed] [-c pm] [-e pm] [-g pm] [-n pm] [-d dump_s]\n"
+                        "            [-p publish_ms] [-i stick_ms] [-r rev] [-H history.jsonl] [-z sleep]\n"
+                        "            [-b fc_baud] [-u uplink_Bps] [-l log_s] [-w warm] [-f fire] [-1 v1]\n"
+                        "            [-k hdr] [-o companion_hz] [-j jump_ms] [out.json]\n");
+        return 2;
+    }
+    if (arg < argc) {
+        out = argv[arg];
+    }
+    
+    /* Warm start: the module kept the sessions the last run opened to the broker */
+    static char warm_server[64];
+    
+    if (warm) {
+        snprintf(warm_server, sizeof(warm_server), "tcp://%s:%u", APP_MQTT_BROKER, (unsigned)APP_MQTT_PORT);
+        config.warm = warm_server;
+    }
+    
+    /* As App_Init configures it */
+    MQTT_Config_t mqtt_config = {
+        .broker = APP_MQTT_BROKER,
+        .port = APP_MQTT_PORT,
+        .username = APP_MQTT_USERNAME,
+        .password = APP_MQTT_PASSWORD,
+        .client_id = APP_MQTT_CLIENT_ID,
+        .use_ssl = true,
+        .keepalive = APP_MQTT_KEEPALIVE,
+        .adaptive_keepalive = (APP_MQTT_ADAPTIVE_KA != 0),
+        .baudrate = APP_MODEM_BAUD,
+        .clients = APP_MQTT_CLIENTS,
+        .persistent_session = (APP_MQTT_PERSISTENT != 0),
+        .transport = APP_MQTT_TRANSPORT,
+        .udp_host = APP_UDP_HOST,
+        .udp_port = APP_UDP_PORT,
+        .connect_by_ip = (APP_MQTT_CONNECT_BY_IP != 0),
+        .will = { APP_TOPIC_STATUS, "offline", MQTT_QOS_1, true },
+        .will_client = APP_CLIENT_CONTROL,
+        .qos0_fire = fire,
+        .dtr = sleep ? Bench_SimDtr : NULL,
+#if APP_MQTT_VERIFY_TLS
+        .ca_cert = isrg_root_x1,
+        .ca_cert_len = sizeof(isrg_root_x1) - 1
+#endif
+    };
+    uint32_t end = (uint32_t)(hours * 3600000.0);
+    uint32_t judged = 0;
+    
+    Bench_UartSetup(&sim_huart, 115200);
+    UART_DMA_Init(&sim_uart, &sim_huart, sim_rx, sizeof(sim_rx), sim_tx, sizeof(sim_tx));
+    Bench_UartSetup(&fc_huart, SOAK_FC_BAUD);
+    Bench_UartLineRate(&fc_huart, fc.baud);
+    UART_DMA_Init(&fc_uart, &fc_huart, fc_rx, sizeof(fc_rx), fc_tx, sizeof(fc_tx));
+    Bench_UartTxSink(&fc_uart, fc_sink, NULL);
+    Bench_SimInit(&sim_uart, &config, broker);
+    Bench_SetIdle(soak_tick);               /* Blocking driver waits let simulated time pass */
+    if (A7600_MQTT_Init(&mqtt, &sim_uart, &mqtt_config) != MQTT_OK) {
+        fprintf(stderr, "soak: driver init failed\n");
+        return 1;
+    }
+    A7600_MQTT_SetIdleHook(&mqtt, idle_hook, NULL);
+    A7600_MQTT_Route(&mqtt, BRIDGE_TOPIC_RX, MavlinkBridge_OnChunk);     /* As App_Init routes it */
+    MavlinkBridge_Init(&fc_uart, &mqtt);
+    if (hdr && !MavlinkBridge_SetHeaderPack(true)) {
+        fprintf(stderr, "soak: compact headers not built in (BRIDGE_HDR_PACK)\n");
+        return 1;
+    }
+#if PROBE_ENABLE
+    UplinkProbe_Init(&mqtt, (const uint8_t *)isrg_root_x1, sizeof(isrg_root_x1) - 1);
+#endif
+    
+    fc.on = true;
+    fc.rand = config.seed ^ 0x5A5A5A5AU;
+    fc.dump_ms = dump_s * 1000U;
+    fc.dump_tick = now - fc.dump_ms + 60000;    /* First dump a minute in */
+    fc.log_ms = log_s * 1000U;
+    fc.log_tick = now - fc.log_ms + 120000;
+    fc.rc_us = SOAK_RC_US;
+    fc.reboot_at = now + 120000;
+    
+    while (now < end) {
+        if (fc.on && end - now <= SOAK_DRAIN_MS) {
+            fc.on = false;
+            judged = frame_count;
+        }
+        soak_tick();
+        A7600_MQTT_SetSleep(&mqtt, sleep && MavlinkBridge_Grounded());    /* As the link task does */
+        A7600_MQTT_Process(&mqtt);
+#if PROBE_ENABLE
+        UplinkProbe_Process();          /* As the uplink task does */
+#endif
+        MavlinkBridge_Process();
+        link_step();
+        check_states();
+        passes++;
+        if (jump > 0) {
+            soak_jump(end);
+        }
+    }
+    if (fc.on) {
+        judged = frame_count;
+    }
+    
+    /* Frame accounting */
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    uint32_t delivered = 0, excused = 0, lost = 0, first_lost = UINT32_MAX;
+    uint32_t drops = link->shaper_thinned + link->bp_thinned + link->bp_shed + link->bp_dropped +
+                     link->fair_dropped + link->xfer_thinned;
+    uint32_t dropped = 0;
+    
+    for (uint32_t i = 0; i < judged; i++) {
+        if (frame_state[i] & FRAME_DELIVERED) {
+            delivered++;
+        } else if (frame_state[i] & FRAME_EXCUSED) {
+            excused++;
+        } else if (dropped < drops) {
+            dropped++;          /* One of the bridge's own drops */
+        } else {
+            lost++;
+            if (first_lost == UINT32_MAX) {
+                first_lost = i;
+            }
+        }
+    }
+    if (lost > 0) {
+        char what[48];
+        
+        snprintf(what, sizeof(what), "%u frames lost, first #%u", (unsigned)lost, (unsigned)first_lost);
+        violation(what);
+    }
+    if ((uint64_t)dropped * 100 > (uint64_t)judged * SOAK_DROP_LIMIT) {
+        violation("bridge dropped past its bound");
+    }
+    
+    /* Rings */
+    uint32_t sim_overrun, fc_overrun;
+    
+    UART_DMA_GetOverrun(&sim_uart, NULL, &sim_overrun);
+    UART_DMA_GetOverrun(&fc_uart, NULL, &fc_overrun);
+    if (sim_overrun > 0 || sim_ring_max * 100 > sizeof(sim_rx) * SOAK_RING_LIMIT) {
+        violation("modem RX ring over its bound");
+    }
+    if (fc_overrun > 0 || fc_ring_max * 100 > sizeof(fc_rx) * SOAK_RING_LIMIT) {
+        violation("FC RX ring over its bound");
+    }
+    
+    /* Modem sleep: nothing may go out while the module cannot hear it */
+    const MQTT_SleepStats_t *sl = A7600_MQTT_GetSleepStats(&mqtt);
+    
+    if (Bench_SimStats()->deaf > 0) {
+        violation("bytes sent to a sleeping modem");
+    }
+    
+    if (warm && !resumed) {
+        violation("warm start did not resume");
+    }
+    if (broken > 0 || v1_seen > 0) {
+        violation("frames broken on the way up");
+    }
+
+#if MQTT_CMUX
+    const Cmux_Stats_t *mux = Cmux_GetStats(A7600_MQTT_GetMux(&mqtt));
+    
+    if (mux->opens == 0 || A7600_MQTT_GetLinkQuality(&mqtt)->tick == 0) {
+        violation("CMUX channels not used");
+    }
+#endif
+    
+    /* Downlink: every stick message at the FC, none late (the last second may still be on its way) */
+    uint32_t dl_missing = 0;
+    
+    for (uint32_t i = 0; i < gcs.count; i++) {
+        if (now - gcs.sent_at[i] >= 1000) {
+            dl_missing++;
+        }
+    }
+    dl_missing = (dl_missing > gcs.got) ? dl_missing - gcs.got : 0;
+    if (dl_missing > 0) {
+        violation("downlink messages lost");
+    }
+    qsort(gcs.lat, gcs.got, sizeof(*gcs.lat), cmp_u32);
+    
+    /* FC rate */
+    uint32_t fc_baud = UART_DMA_GetBaudRate(&fc_uart);
+    
+    if (fc.locked_ms == 0 || fc.locked_ms > SOAK_BAUD_MAX_MS || fc_baud != fc.baud) {
+        violation("FC rate not learned");
+    }
+    if (fc.rc_us != SOAK_RC_SHAPED_US) {
+        violation("FC streams not shaped");
+    }
+    
+    /* Recovery times */
+    uint64_t sum = 0;
+    
+    qsort(recovery, recovery_count, sizeof(*recovery), cmp_u32);
+    for (uint32_t i = 0; i < recovery_count; i++) {
+        sum += recovery[i];
+    }
+    
+    const Bench_SimStats_t *st = Bench_SimStats();
+    uint16_t batch_bytes, batch_ms;
+    
+    MavlinkBridge_GetBatching(&batch_bytes, &batch_ms);
+    
+    /* AT efficiency: modem UART bytes by class, and the payload's share of what publishes took */
+    const MQTT_WireStats_t *eff = A7600_MQTT_GetWireStats(&mqtt);
+    uint32_t wire[AT_WIRE_CLASSES];
+    
+    AT_Engine_GetWire(&mqtt.at, wire);
+#if PROBE_ENABLE
+    const UplinkProbe_Result_t *probe = UplinkProbe_GetResult();
+#else
+    const UplinkProbe_Result_t *probe = &(const UplinkProbe_Result_t){ 0 };
+#endif
+    double h = now / 3600000.0;
+    char report[2048];
+    int n = snprintf(report, sizeof(report),
+        "{\"rev\":\"%s\",\"hours\":%.2f,\"seed\":%u,"
+        "\"faults\":{\"connlost\":%u,\"payload_error\":%u,\"modem_garbage\":%u,\"fc_noise\":%u,\"dumps\":%u},"
+        "\"frames\":{\"fed\":%u,\"delivered\":%u,\"excused\":%u,\"dropped\":%u,\"lost\":%u},"
+        "\"throughput\":{\"frames_h\":%.0f,\"bytes_h\":%.0f,\"publishes_h\":%.0f},"
+        "\"recovery_ms\":{\"count\":%u,\"avg\":%u,\"p90\":%u,\"max\":%u},"
+        "\"rings\":{\"modem_max\":%u,\"modem_size\":%u,\"modem_overrun\":%u,"
+        "\"fc_max\":%u,\"fc_size\":%u,\"fc_overrun\":%u},"
+        "\"sleep\":{\"sleeps\":%u,\"asleep_pct\":%.1f,\"wakes\":%u,\"prewakes\":%u,"
+        "\"wake_avg_ms\":%u,\"wake_max_ms\":%u,\"deaf\":%u},"
+        "\"downlink\":{\"sent\":%u,\"got\":%u,\"streaming\":%u,\"p50_ms\":%u,\"p99_ms\":%u,\"max_ms\":%u,"
+        "\"late\":%u},"
+        "\"fc_baud\":{\"line\":%u,\"locked\":%u,\"lock_ms\":%u},"
+        "\"shaping\":{\"intervals\":%u,\"reboots\":%u,\"rc_us\":%u},"
+        "\"uplink\":{\"capacity\":%u,\"estimate\":%u,\"thinned\":%u},"
+        "\"batching\":{\"bytes\":%u,\"ms\":%u,\"grown\":%u,\"cut\":%u},"
+        "\"congestion\":{\"rises\":%u,\"thinned\":%u,\"shed\":%u,\"dropped\":%u},"
+        "\"probe\":{\"bps\":%u,\"overhead_ms\":%u,\"probes\":%u,\"skipped\":%u,\"failed\":%u},"
+        "\"transfer\":{\"logs\":%u,\"seen\":%u,\"frames\":%u,\"thinned\":%u},"
+        "\"presence\":{\"folded\":%u},"
+        "\"pack\":{\"v1\":%d,\"frames\":%u,\"saved\":%u,\"broken\":%u,\"hc\":%u},"
+        "\"fair\":{\"companion_hz\":%u,\"fc_bytes\":%u,\"companion_bytes\":%u,\"dropped\":%u},"
+        "\"wire\":{\"cmd\":%u,\"tx_data\":%u,\"response\":%u,\"prompt\":%u,\"urc\":%u,\"rx_data\":%u,"
+        "\"pub_payload\":%u,\"pub_wire\":%u},"
+        "\"clock\":{\"jump\":%u,\"passes\":%u},"
+        "\"sessions\":%u,\"unknown_cmds\":%u,\"violations\":%u,\"list\":[",
+        rev, h, (unsigned)config.seed,
+        (unsigned)st->connlost, (unsigned)st->payload_errors, (unsigned)st->garbage, (unsigned)fc.noise,
+        (unsigned)fc.dumps,
+        (unsigned)judged, (unsigned)delivered, (unsigned)excused, (unsigned)dropped, (unsigned)lost,
+        delivered / h, delivered_bytes / h, st->publishes / h,
+        (unsigned)recovery_count, (unsigned)(recovery_count ? sum / recovery_count : 0),
+        (unsigned)(recovery_count ? recovery[recovery_count * 9 / 10] : 0),
+        (unsigned)(recovery_count ? recovery[recovery_count - 1] : 0),
+        (unsigned)sim_ring_max, (unsigned)sizeof(sim_rx), (unsigned)sim_overrun,
+        (unsigned)fc_ring_max, (unsigned)sizeof(fc_rx), (unsigned)fc_overrun,
+        (unsigned)sl->sleeps, sl->asleep_ms * 100.0 / (now ? now : 1), (unsigned)sl->wakes,
+        (unsigned)sl->prewakes, (unsigned)(sl->wakes ? sl->wake_ms_total / sl->wakes : 0),
+        (unsigned)sl->wake_ms_max, (unsigned)st->deaf,
+        (unsigned)gcs.count, (unsigned)gcs.got, (unsigned)gcs.streaming,
+        (unsigned)(gcs.got ? gcs.lat[gcs.got / 2] : 0), (unsigned)(gcs.got ? gcs.lat[gcs.got * 99 / 100] : 0),
+        (unsigned)(gcs.got ? gcs.lat[gcs.got - 1] : 0), (unsigned)gcs.late,
+        (unsigned)fc.baud, (unsigned)fc_baud, (unsigned)fc.locked_ms,
+        (unsigned)fc.intervals, (unsigned)fc.reboots, (unsigned)fc.rc_us,
+        (unsigned)config.uplink_bps, (unsigned)MavlinkBridge_GetUplinkRate(), (unsigned)link->shaper_thinned,
+        (unsigned)batch_bytes, (unsigned)batch_ms, (unsigned)link->batch_grown, (unsigned)link->batch_cut,
+        (unsigned)link->bp_rises, (unsigned)link->bp_thinned, (unsigned)link->bp_shed, (unsigned)link->bp_dropped,
+        (unsigned)probe->bps, (unsigned)probe->overhead_ms, (unsigned)probe->probes, (unsigned)probe->skipped,
+        (unsigned)probe->failed,
+        (unsigned)fc.logs, (unsigned)link->xfers, (unsigned)link->xfer_frames, (unsigned)link->xfer_thinned,
+        (unsigned)link->hb_folded,
+        fc.v1, (unsigned)link->packed, (unsigned)link->pack_saved, (unsigned)broken,
+        (unsigned)hc_batches,
+        (unsigned)fc.comp_hz, (unsigned)fc_bytes, (unsigned)comp_bytes, (unsigned)link->fair_dropped,
+        (unsigned)wire[AT_WIRE_CMD], (unsigned)wire[AT_WIRE_TX_DATA], (unsigned)wire[AT_WIRE_RESPONSE],
+        (unsigned)wire[AT_WIRE_PROMPT], (unsigned)wire[AT_WIRE_URC], (unsigned)wire[AT_WIRE_RX_DATA],
+        (unsigned)eff->payload, (unsigned)eff->wire,
+        (unsigned)jump, (unsigned)passes,
+        (unsigned)st->connects, (unsigned)st->unknown, (unsigned)violation_count);
+    
+    for (uint32_t i = 0; i < violation_count && i < SOAK_VIOLATIONS && n < (int)sizeof(report) - 80; i++) {
+        n += snprintf(&report[n], sizeof(report) - (size_t)n, "%s{\"t\":%u,\"what\":\"%s\"}", i ? "," : "",
+                      (unsigned)violations[i].t, violations[i].what);
+    }
+    snprintf(&report[n], sizeof(report) - (size_t)n, "]}");
+    
+    FILE *f = fopen(out, "w");
+    
+    if (f == NULL) {
+        fprintf(stderr, "soak: cannot write %s\n", out);
+        return 1;
+    }
+    fprintf(f, "%s\n", report);
+    fclose(f);
+    if (history != NULL && (f = fopen(history, "a")) != NULL) {
+        fprintf(f, "%s\n", report);
+        fclose(f);
+    }
+    
+    printf("%.2f h: %u frames fed, %u delivered, %u excused, %u dropped, %u lost\n", h, (unsigned)judged,
+           (unsigned)delivered, (unsigned)excused, (unsigned)dropped, (unsigned)lost);
+    printf("faults: %u connlost, %u payload errors, %u modem noise, %u FC noise (%u dumps)\n",
+           (unsigned)st->connlost, (unsigned)st->payload_errors, (unsigned)st->garbage, (unsigned)fc.noise,
+           (unsigned)fc.dumps);
+    printf("recovery: %u drops, avg %u ms, max %u ms; rings: modem %u/%u, FC %u/%u\n",
+           (unsigned)recovery_count, (unsigned)(recovery_count ? sum / recovery_count : 0),
+           (unsigned)(recovery_count ? recovery[recovery_count - 1] : 0),
+           (unsigned)sim_ring_max, (unsigned)sizeof(sim_rx), (unsigned)fc_ring_max, (unsigned)sizeof(fc_rx));
+    printf("downlink: %u of %u stick messages at the FC (%u sent while a publish streamed), "
+           "p99 %u ms, max %u ms\n", (unsigned)gcs.got, (unsigned)gcs.count, (unsigned)gcs.streaming,
+           (unsigned)(gcs.got ? gcs.lat[gcs.got * 99 / 100] : 0), (unsigned)(gcs.got ? gcs.lat[gcs.got - 1] : 0));
+    printf("FC rate: line %u, USART1 locked at %u after %u ms\n", (unsigned)fc.baud, (unsigned)fc_baud,
+           (unsigned)fc.locked_ms);
+    printf("shaping: %u intervals set, %u reboots, RC_CHANNELS every %u us\n", (unsigned)fc.intervals,
+           (unsigned)fc.reboots, (unsigned)fc.rc_us);
+    printf("uplink: capacity %u B/s (0: no limit), shaper estimate %u B/s, %u frames thinned\n",
+           (unsigned)config.uplink_bps, (unsigned)MavlinkBridge_GetUplinkRate(), (unsigned)link->shaper_thinned);
+    printf("batching: %u B, %u ms at the end; %u steps up, %u halvings\n", (unsigned)batch_bytes,
+           (unsigned)batch_ms, (unsigned)link->batch_grown, (unsigned)link->batch_cut);
+    printf("probe: %u B/s, %u ms a publish; %u probes, %u connects reused one, %u failed\n",
+           (unsigned)probe->bps, (unsigned)probe->overhead_ms, (unsigned)probe->probes, (unsigned)probe->skipped,
+           (unsigned)probe->failed);
+    printf("transfer: %u log downloads, %u seen by the bridge, %u frames; %u frames thinned for them\n",
+           (unsigned)fc.logs, (unsigned)link->xfers, (unsigned)link->xfer_frames, (unsigned)link->xfer_thinned);
+    printf("presence: %u HEARTBEATs folded into records\n", (unsigned)link->hb_folded);
+    printf("pack: %u frames re-encoded, %u B saved; %u batches with compact headers; %u broken\n",
+           (unsigned)link->packed, (unsigned)link->pack_saved, (unsigned)hc_batches, (unsigned)broken);
+    printf("fair: %u B from the autopilot, %u B from the companion delivered; %u frames over a share\n",
+           (unsigned)fc_bytes, (unsigned)comp_bytes, (unsigned)link->fair_dropped);
+    printf("wire: tx %u B commands, %u B data; rx %u B responses, %u B prompts, %u B URCs, %u B data; "
+           "publishes %.1f%% payload\n", (unsigned)wire[AT_WIRE_CMD], (unsigned)wire[AT_WIRE_TX_DATA],
+           (unsigned)wire[AT_WIRE_RESPONSE], (unsigned)wire[AT_WIRE_PROMPT], (unsigned)wire[AT_WIRE_URC],
+           (unsigned)wire[AT_WIRE_RX_DATA], eff->wire ? eff->payload * 100.0 / eff->wire : 0.0);
+    if (jump > 0) {
+        printf("clock: %u passes of the firmware for %u ms, jumps up to %u ms\n", (unsigned)passes,
+               (unsigned)now, (unsigned)jump);
+    }
+    if (warm) {
+        printf("warm: %s after %u ms\n", resumed ? "sessions resumed" : "full connect", (unsigned)resume_ms);
+    }
+#if MQTT_CMUX
+    printf("cmux: opened %u times; %u frames, %u bad, %u bytes outside frames\n",
+           (unsigned)mux->opens, (unsigned)mux->frames, (unsigned)mux->bad, (unsigned)mux->plain);
+#endif
+    printf("congestion: %u rises; %u frames thinned, %u shed, %u dropped before the ring lapped\n",
+           (unsigned)link->bp_rises, (unsigned)link->bp_thinned, (unsigned)link->bp_shed, (unsigned)link->bp_dropped);
+    for (uint32_t i = 0; i < violation_count && i < SOAK_VIOLATIONS; i++) {
+        printf("VIOLATION at %u ms: %s\n", (unsigned)violations[i].t, violations[i].what);
+    }
+    printf("%s: %s\n", violation_count ? "FAIL" : "PASS", out);
+    return violation_count ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file    store_stubs.c
+ * @brief   Stand-ins for the flash stores, the boot profiler and the
+ *          supervisor: nothing is kept, nothing is due
+ */
+
+#include "nv_store.h"
+#include "param_cache.h"
+#include "mission_store.h"
+#include "boot_profile.h"
+#include "supervisor.h"
+
+/* ==================== NV store ==================== */
+
+bool NV_Store_GetKeepalive(uint32_t plmn, uint16_t *good, uint16_t *bad)
+{
+    (void)plmn;
+    (void)good;
+    (void)bad;
+    return false;
+}
+
+HAL_StatusTypeDef NV_Store_SetKeepalive(uint32_t plmn, uint16_t good, uint16_t bad)
+{
+    (void)plmn;
+    (void)good;
+    (void)bad;
+    return HAL_OK;
+}
+
+bool NV_Store_GetHostIp(uint32_t host_hash, uint32_t *ip)
+{
+    (void)host_hash;
+    (void)ip;
+    return false;
+}
+
+HAL_StatusTypeDef NV_Store_SetHostIp(uint32_t host_hash, uint32_t ip)
+{
+    (void)host_hash;
+    (void)ip;
+    return HAL_OK;
+}
+
+bool NV_Store_GetCarrier(uint32_t iccid_hash, uint32_t *plmn)
+{
+    (void)iccid_hash;
+    (void)plmn;
+    return false;
+}
+
+HAL_StatusTypeDef NV_Store_SetCarrier(uint32_t iccid_hash, uint32_t plmn)
+{
+    (void)iccid_hash;
+    (void)plmn;
+    return HAL_OK;
+}
+
+bool NV_Store_GetCell(uint32_t *plmn, uint8_t *band)
+{
+    (void)plmn;
+    (void)band;
+    return false;
+}
+
+HAL_StatusTypeDef NV_Store_SetCell(uint32_t plmn, uint8_t band)
+{
+    (void)plmn;
+    (void)band;
+    return HAL_OK;
+}
+
+/* ==================== Parameter cache ==================== */
+
+int ParamCache_Find(int index, const char *id)
+{
+    (void)index;
+    (void)id;
+    return -1;
+}
+
+bool ParamCache_Complete(void)
+{
+    return false;
+}
+
+uint16_t ParamCache_Count(void)
+{
+    return 0;
+}
+
+bool ParamCache_Get(uint16_t record, ParamCache_Entry_t *entry)
+{
+    (void)record;
+    (void)entry;
+    return false;
+}
+
+bool ParamCache_Put(const ParamCache_Entry_t *report, uint16_t count)
+{
+    (void)report;
+    (void)count;
+    return false;
+}
+
+void ParamCache_Clear(void)
+{
+}
+
+/* ==================== Mission store ==================== */
+
+void MissionStore_Clear(void)
+{
+}
+
+bool MissionStore_Put(uint16_t seq, const uint8_t *item)
+{
+    (void)seq;
+    (void)item;
+    return false;
+}
+
+bool MissionStore_Has(uint16_t seq)
+{
+    (void)seq;
+    return false;
+}
+
+bool MissionStore_Get(uint16_t seq, uint8_t *item)
+{
+    (void)seq;
+    (void)item;
+    return false;
+}
+
+uint16_t MissionStore_Count(void)
+{
+    return 0;
+}
+
+/* ==================== Boot profile ==================== */
+
+void BootProfile_Mark(BootProfile_Mark_t mark)
+{
+    (void)mark;
+}
+
+/* ==================== Supervisor ==================== */
+
+void Supervisor_Service(void)
+{
+}
@@ -1,7 +1,7 @@
 /**
  * @file    a7600_mqtt.h
  * @brief   MQTT Library for A7600 SIM Module with HiveMQ support
- * @version 1.0
+ * @version 1.27 - Background file transfer
  */
 
 #ifndef A7600_MQTT_H
@@ -9,18 +9,76 @@
 
 #include "main.h"
 #include "uart_dma.h"
+#include "at_engine.h"
+#include "mqtt_packet.h"
+#include "carrier.h"
+#include "cmux.h"
 #include <stdint.h>
 #include <stdbool.h>
 
-/* Configuration */
+/* Configuration - longest MQTT_Config_t strings, terminator included */
 #define MQTT_BROKER_MAX_LEN         64
 #define MQTT_USERNAME_MAX_LEN       32
 #define MQTT_PASSWORD_MAX_LEN       32
 #define MQTT_CLIENT_ID_MAX_LEN      32
+#define MQTT_APN_MAX_LEN            32
+#define MQTT_CA_NAME_LEN            16      /* "ca_<hash>.pem" */
 #define MQTT_TOPIC_MAX_LEN          64
-#define MQTT_PAYLOAD_MAX_LEN        256
+#define MQTT_PAYLOAD_MAX_LEN        10240   /* Longest publish payload (AT+CMQTTPAYLOAD limit of the module) */
+#define MQTT_FILE_MAX_LEN           0xFFFF  /* Longest file write (one DMA transaction) */
 #define MQTT_RESPONSE_TIMEOUT       10000   /* 10 seconds */
 #define MQTT_CMD_TIMEOUT            5000    /* 5 seconds for AT commands */
+#define MQTT_REG_TIMEOUT            30000   /* Wait for network registration */
+#define MQTT_ACQ_TIMEOUT            10000   /* Registration on the remembered band before the full scan, ms */
+#define MQTT_ACQ_BANDS_2G3G         "0xFFFFFFFF7FFFFFFF"    /* AT+CNBP GSM / WCDMA mask, kept as set */
+#define MQTT_ACQ_BANDS_LTE          "0x000007FF3FDF3FFF"    /* AT+CNBP LTE mask of the full scan (module default) */
+#define MQTT_BOOT_TIMEOUT           10000   /* RDY to +CPIN before probing anyway */
+#define MQTT_LINK_POLL_INTERVAL     20000   /* Background CSQ / CPSI sample while connected */
+#define MQTT_KA_MIN                 30      /* Adaptive keepalive bounds, s */
+#define MQTT_KA_MAX                 900
+#define MQTT_KA_RESOLUTION          30      /* Stop probing once survived and lost are this close, s */
+#define MQTT_KA_PROVE               3       /* Keepalive periods a session must last to prove it */
+#define MQTT_CONNECT_STEPS          10      /* Reported connect steps (see GetErrorStep) */
+#define MQTT_MAX_CLIENTS            2       /* Client indices of the A7600 MQTT stack */
+#define MQTT_ALL_CLIENTS            0xFF
+#define MQTT_MAX_ROUTES             4       /* Exact-topic handlers (A7600_MQTT_Route) */
+#define MQTT_PUB_WINDOW             3       /* Publishes awaiting +CMQTTPUB */
+#define MQTT_PUB_ACK_TIMEOUT        65000   /* Module pub_timeout (60 s) plus margin */
+#define MQTT_FIRE_MAX               16      /* Fire-and-forget publishes of a client awaiting +CMQTTPUB */
+#define MQTT_TOPIC_CMD_MAX          24      /* "AT+CMQTTTOPIC=<client>,<len>\r\n" of a topic descriptor */
+#define MQTT_UDP_LOCAL_PORT         14551   /* Local port of the datagram link */
+#define MQTT_UDP_MAX_LEN            1024    /* Largest datagram per AT+CIPSEND */
+#define MQTT_SOCK_SEND_MAX          2048    /* Largest AT+CCHSEND - a longer PUBLISH goes in several */
+#define MQTT_DNS_TTL                3600000 /* Re-resolve the broker after this, ms (AT+CDNSGIP gives no TTL) */
+#define MQTT_CLOCK_POLL             20      /* AT+CCLK? pacing while waiting for the second to turn, ms */
+#define MQTT_CLOCK_POLLS            60      /* Readings before taking the clock without a second edge */
+#define MQTT_CLOCK_TTL              3600000 /* A kept network time that still reads right is re-polled after this, ms */
+#define MQTT_MAX_ENDPOINTS          3       /* Brokers: config.broker, then config.standby */
+#define MQTT_EP_FAILS               2       /* Failed CONNECTs in a row that move a connect to another broker */
+#define MQTT_EP_RETRY               600000  /* A failing broker is tried again after this, ms */
+#define MQTT_NTP_SERVER             "pool.ntp.org"  /* AT+CNTP when the network sends no time */
+#define MQTT_SLEEP_IDLE             200     /* AT channel quiet this long before DTR goes high, ms */
+#define MQTT_WAKE_MS                50      /* DTR low to the first command (module UART wake-up), ms */
+
+#ifndef MQTT_FAST_ACQ
+#define MQTT_FAST_ACQ               1       /* Cold full connect: search the last network's LTE band first */
+#endif
+#ifndef MQTT_ACQ_LTE_ONLY
+#define MQTT_ACQ_LTE_ONLY           1       /* ... with AT+CNMP=38 (LTE only) until registered */
+#endif
+#ifndef MQTT_CLOCK_SYNC
+#define MQTT_CLOCK_SYNC             1       /* Read network time at a full connect (A7600_MQTT_GetUnixTime) */
+#endif
+#ifndef MQTT_CMUX
+#define MQTT_CMUX                   0       /* AT+CMUX: link samples on their own channel (set project-wide) */
+#endif
+#if MQTT_CMUX && !UART_DMA_FRAMING
+#error "MQTT_CMUX must be defined for the whole build (uart_dma.h frames for it)"
+#endif
+#define MQTT_MON_TIMEOUT            2000    /* Link sample answer on the monitoring channel, ms */
+#define MQTT_MON_LINE_MAX           64      /* Longest monitoring line kept ("+CPSI: LTE,...") */
+#define A7600_DEFAULT_BAUD          115200  /* Module power-on UART rate */
+#define A7600_APN                   "internet" /* PDP context 1 APN of a SIM no carrier profile matches */
 
 /**
  * @brief MQTT QoS levels
@@ -31,6 +89,16 @@ typedef enum {
     MQTT_QOS_2 = 2      /**< Exactly once */
 } MQTT_QoS_t;
 
+/**
+ * @brief How MQTT packets reach the broker
+ */
+typedef enum {
+    MQTT_TRANSPORT_AT = 0,  /**< Module MQTT stack (AT+CMQTT*) */
+    MQTT_TRANSPORT_SOCKET   /**< Module TLS socket (AT+CCH*), packets framed on the MCU: one
+                                 AT+CCHSEND and one contiguous write per MQTT_SOCK_SEND_MAX
+                                 bytes of a publish */
+} MQTT_Transport_t;
+
 /**
  * @brief MQTT connection state
  */
@@ -63,17 +131,248 @@ typedef enum {
  */
 typedef void (*MQTT_MessageCallback_t)(const char *topic, const uint8_t *payload, size_t len);
 
+/**
+ * @brief Callback for received payload chunks (any message size)
+ * @param topic Message topic
+ * @param data Chunk bytes (valid during the call only)
+ * @param len Chunk length
+ * @param offset Position of the chunk in the payload
+ * @param total Payload length announced by +CMQTTRXSTART
+ */
+typedef void (*MQTT_ChunkCallback_t)(const char *topic, const uint8_t *data, size_t len,
+                                     size_t offset, size_t total);
+
+/**
+ * @brief Inbound topic routed to its own handler
+ */
+typedef struct {
+    const char *topic;                      /**< Exact topic (must outlive the handle) */
+    uint32_t hash;                          /**< FNV-1a of topic */
+    uint8_t len;                            /**< strlen(topic) */
+    MQTT_ChunkCallback_t handler;           /**< Gets the payload chunks of that topic */
+} MQTT_Route_t;
+
+/**
+ * @brief Publish priority of a topic
+ */
+typedef enum {
+    MQTT_PRIO_NORMAL = 0,   /**< Any free slot of the in-flight window */
+    MQTT_PRIO_LOW           /**< Leaves the last slot to normal publishes (MQTT_BUSY instead) */
+} MQTT_Priority_t;
+
+/**
+ * @brief Publish policy of a topic (A7600_MQTT_SetPolicy)
+ */
+typedef struct {
+    const char *topic;                      /**< Exact topic, or a prefix ending in "/#" */
+    uint8_t qos;                            /**< MQTT_QoS_t, in place of the caller's */
+    bool retain;                            /**< Broker keeps the last message for new subscribers */
+    uint8_t prio;                           /**< MQTT_Priority_t */
+} MQTT_TopicPolicy_t;
+
+/**
+ * @brief Completion callback of an asynchronous operation (main-loop context)
+ * @param ctx User context given when the operation was started
+ * @param result Operation outcome
+ */
+typedef void (*MQTT_DoneCallback_t)(void *ctx, MQTT_Result_t result);
+
+/**
+ * @brief Asynchronous operation in progress
+ */
+typedef enum {
+    MQTT_OP_NONE = 0,
+    MQTT_OP_CONNECT,
+    MQTT_OP_SUBSCRIBE,
+    MQTT_OP_PUBLISH,
+    MQTT_OP_FILE
+} MQTT_Op_t;
+
+/**
+ * @brief Destination of a file write
+ */
+typedef enum {
+    MQTT_FILE_CERT = 0,                     /**< Certificate store (AT+CCERTDOWN), for AT+CSSLCFG */
+    MQTT_FILE_FS                            /**< File system, drive C: (AT+CFTRANRX) */
+} MQTT_File_t;
+
+/**
+ * @brief Publish handed to the modem, waiting for its +CMQTTPUB result
+ */
+typedef struct {
+    MQTT_DoneCallback_t done;               /**< Delivery callback */
+    void *ctx;                              /**< Delivery callback context */
+    uint32_t tick;                          /**< Time the publish was requested */
+    uint16_t seq;                           /**< Publish sequence number */
+    uint8_t client;                         /**< Client index it was published on */
+    uint8_t result;                         /**< MQTT_Result_t once resolved */
+    bool resolved;                          /**< +CMQTTPUB seen (or given up) */
+    uint8_t fired_before;                   /**< Fire-and-forget publishes of the client ahead of it,
+                                             *   their +CMQTTPUB still due */
+} MQTT_InFlight_t;
+
+/**
+ * @brief Cell search of a full connect (MQTT_FAST_ACQ)
+ */
+typedef enum {
+    MQTT_ACQ_SCAN = 0,                      /**< Module's own search (no hint, or already registered) */
+    MQTT_ACQ_HINT,                          /**< Registered within the remembered band */
+    MQTT_ACQ_FALLBACK                       /**< Nothing there within MQTT_ACQ_TIMEOUT: full scan */
+} MQTT_Acq_t;
+
+/**
+ * @brief Where the last connect spent its time
+ * @note  Index = step number - 1, numbered as in A7600_MQTT_GetErrorStep
+ */
+typedef struct {
+    uint32_t start_tick;                    /**< HAL tick the connect started */
+    uint32_t total_ms;                      /**< Start to finish (0 while running) */
+    uint32_t step_ms[MQTT_CONNECT_STEPS];   /**< Time spent in each step */
+    uint8_t retries[MQTT_CONNECT_STEPS];    /**< Retries of each step */
+    uint8_t tier;                           /**< Tier it finished in (0 broker, 1 client, 2 full) */
+    uint8_t endpoint;                       /**< Broker it finished on (0 = config.broker) */
+    uint8_t failovers;                      /**< Switches to another broker during it */
+    bool pdp_kept;                          /**< PDP context found up with an address and left alone */
+    bool resumed;                           /**< Sessions found up after an MCU reset and taken over */
+    uint8_t acq;                            /**< MQTT_Acq_t: how registration was searched */
+} MQTT_ConnectStats_t;
+
+/**
+ * @brief A further broker: same credentials, client ID and CA as config.broker
+ */
+typedef struct {
+    const char *broker;                     /**< Host name (NULL or empty = unused) */
+    uint16_t port;                          /**< Port (0 = config.port) */
+} MQTT_Endpoint_t;
+
+/**
+ * @brief Health of a broker, measured by the connects made to it
+ */
+typedef struct {
+    uint16_t connack_ms;                    /**< CONNECT to CONNACK, running average (0 = not measured) */
+    uint8_t fails;                          /**< Failed CONNECTs in a row */
+    uint32_t fail_tick;                     /**< Last failure */
+    uint16_t connects;                      /**< Sessions connected to it */
+} MQTT_EndpointHealth_t;
+
+/**
+ * @brief Publish counters since init (delivery as reported by +CMQTTPUB)
+ */
+typedef struct {
+    uint32_t delivered;                     /**< Publishes reported delivered */
+    uint32_t failed;                        /**< Rejected, errored or timed out */
+    uint32_t bytes;                         /**< Payload bytes handed to the modem */
+    uint32_t latency_ms_total;              /**< Sum of request-to-delivery times */
+    uint32_t latency_ms_max;                /**< Worst request-to-delivery time */
+    uint32_t datagrams;                     /**< Datagrams the modem sent */
+    uint32_t datagram_errors;               /**< Datagrams refused or failed */
+    uint32_t fired;                         /**< QoS 0 publishes reported done at acceptance (qos0_fire);
+                                             *   their +CMQTTPUB counts them delivered or failed,
+                                             *   they take no part in the latency figures */
+} MQTT_PubStats_t;
+
+/**
+ * @brief AT efficiency of publishes since init: modem UART bytes both ways
+ *        from a publish's first stage to its acceptance, against its payload
+ * @note  Not carried over warm resets (retain.h has no room), as the
+ *        engine's wire counters it is measured with
+ */
+typedef struct {
+    uint32_t payload;                       /**< Payload bytes of the publishes measured */
+    uint32_t wire;                          /**< Their wire bytes (payload / wire: efficiency) */
+    uint16_t last_pm;                       /**< The last publish's payload per mille of its wire bytes */
+} MQTT_WireStats_t;
+
+/**
+ * @brief Radio link quality, sampled in the background (AT+CSQ;+CPSI?)
+ * @note  LTE fields are 0 when not camped on LTE
+ */
+typedef struct {
+    uint32_t tick;                          /**< Time of the last complete sample (0 = none) */
+    uint32_t cell_id;                       /**< LTE serving cell ID */
+    uint32_t plmn;                          /**< Serving network, MCC * 1000 + MNC (0 = unknown) */
+    int16_t rsrp;                           /**< LTE RSRP in 0.1 dBm */
+    int16_t rsrq;                           /**< LTE RSRQ in 0.1 dB */
+    int8_t sinr;                            /**< LTE SINR in dB */
+    uint8_t csq;                            /**< +CSQ <rssi> 0..31, 99 = unknown */
+    uint8_t ber;                            /**< +CSQ <ber> 0..7, 99 = unknown */
+    uint8_t cell_changes;                   /**< Serving cell changes seen since init */
+    uint8_t band;                           /**< LTE band of the serving cell (0 = unknown) */
+} MQTT_LinkQuality_t;
+
+/**
+ * @brief Publish topic prepared once (A7600_MQTT_TopicDescInit) for A7600_MQTT_PublishDescAsync
+ * @note  The module forgets the topic after each AT+CMQTTPUB, so the topic
+ *        still goes out with every publish - only measuring it and rendering
+ *        its AT+CMQTTTOPIC command are done ahead
+ */
+typedef struct {
+    const char *topic;                      /**< Topic, caller-owned for the life of the descriptor */
+    uint16_t len;                           /**< Topic length */
+    uint8_t client;                         /**< Session the topic is published on */
+    uint8_t cmd_len;                        /**< Length of cmd */
+    char cmd[MQTT_TOPIC_CMD_MAX];           /**< "AT+CMQTTTOPIC=<client>,<len>\r\n", no terminator */
+} MQTT_TopicDesc_t;
+
+/**
+ * @brief Hook run while a command waits for modem TX space or a response
+ * @note  Called from inside driver calls; driver commands issued from the
+ *        hook return MQTT_BUSY (one AT channel, one response buffer)
+ */
+typedef void (*MQTT_IdleHook_t)(void *ctx);
+
+/**
+ * @brief Drive the module's DTR line (modem sleep, AT+CSCLK=1)
+ * @param high true: the module may sleep, false: keep it awake
+ */
+typedef void (*MQTT_DtrFn_t)(bool high);
+
+/**
+ * @brief Modem sleep counters since init (A7600_MQTT_SetSleep)
+ */
+typedef struct {
+    uint32_t sleeps;                        /**< Times DTR went high */
+    uint32_t asleep_ms;                     /**< Time with DTR high */
+    uint32_t wakes;                         /**< Commands held for a wake-up */
+    uint32_t prewakes;                      /**< Wake-ups asked ahead of a flush (A7600_MQTT_Wake) */
+    uint32_t wake_ms_total;                 /**< Delay the wake-ups added to those commands */
+    uint32_t wake_ms_max;                   /**< Worst such delay */
+} MQTT_SleepStats_t;
+
 /**
  * @brief MQTT configuration structure
+ * @note  The strings are referenced, not copied: literals or config store
+ *        values in flash, caller-owned for the life of the handle
  */
 typedef struct {
-    char broker[MQTT_BROKER_MAX_LEN];       /**< Broker hostname */
+    const char *broker;                      /**< Broker hostname */
     uint16_t port;                           /**< Broker port (8883 for SSL, 1883 for non-SSL) */
-    char username[MQTT_USERNAME_MAX_LEN];   /**< Username */
-    char password[MQTT_PASSWORD_MAX_LEN];   /**< Password */
-    char client_id[MQTT_CLIENT_ID_MAX_LEN]; /**< Client ID */
+    const char *username;                    /**< Username */
+    const char *password;                    /**< Password */
+    const char *client_id;                   /**< Client ID */
+    const char *apn;                         /**< PDP context APN (NULL or empty = the SIM's carrier profile) */
     bool use_ssl;                            /**< Enable SSL/TLS */
-    uint16_t keepalive;                      /**< Keepalive interval in seconds */
+    uint16_t keepalive;                      /**< Keepalive interval in seconds (start value if adaptive) */
+    bool adaptive_keepalive;                 /**< Learn the longest keepalive the network keeps, per PLMN */
+    uint32_t baudrate;                       /**< Modem UART rate to negotiate (0 = keep default) */
+    bool hw_flow_control;                    /**< Enable RTS/CTS on both sides (AT+IFC=2,2) */
+    uint8_t clients;                         /**< Sessions to open: 1, or 2 for a separate control session */
+    bool persistent_session;                 /**< clean_session=0: broker keeps subscriptions and queued QoS1 */
+    MQTT_Transport_t transport;              /**< Module MQTT stack or TLS socket */
+    const char *udp_host;                    /**< Datagram endpoint, caller-owned (NULL = no datagram path) */
+    uint16_t udp_port;                       /**< Datagram endpoint port */
+    bool connect_by_ip;                      /**< Connect to the cached broker address - the module then
+                                                  sends the address as SNI, so not for SNI-routed brokers */
+    const char *ca_cert;                     /**< CA certificate (PEM) to verify the broker against, in
+                                                  flash, caller-owned (NULL = no server verification) */
+    size_t ca_cert_len;                      /**< Its length */
+    MQTT_Endpoint_t standby[MQTT_MAX_ENDPOINTS - 1]; /**< Warm standby brokers, in order of preference */
+    MQTT_DtrFn_t dtr;                        /**< Module DTR line (NULL = not wired, no modem sleep) */
+    MQTT_Will_t will;                        /**< Last will of session will_client (topic NULL = none); the
+                                                  module stack has no will retain flag - socket transport only */
+    uint8_t will_client;                     /**< Session that carries it */
+    bool qos0_fire;                          /**< QoS 0 publishes are done once AT+CMQTTPUB is accepted:
+                                                  no window slot, their +CMQTTPUB only counted */
 } MQTT_Config_t;
 
 /**
@@ -84,11 +383,164 @@ typedef struct {
     MQTT_Config_t config;                   /**< MQTT configuration */
     MQTT_State_t state;                     /**< Current state */
     MQTT_MessageCallback_t msg_callback;    /**< Message received callback */
+    MQTT_ChunkCallback_t chunk_callback;    /**< Payload chunk callback (takes precedence) */
+    MQTT_Route_t routes[MQTT_MAX_ROUTES];   /**< Topics with their own handler (ahead of the callbacks) */
+    uint8_t route_count;
+    const MQTT_TopicPolicy_t *policy;       /**< Publish policy per topic (A7600_MQTT_SetPolicy) */
+    uint8_t policy_count;
+    MQTT_IdleHook_t idle_hook;              /**< Work to keep running during waits */
+    void *idle_ctx;                         /**< Idle hook context */
+    bool in_hook;                           /**< Idle hook running (re-entry guard) */
     
-    /* Internal buffers */
-    uint8_t rx_buffer[512];                 /**< Response buffer */
-    size_t rx_len;                          /**< Current response length */
+    /* AT engine - owns the response buffer */
+    AT_Engine_t at;                         /**< Command queue and response buffer */
     uint32_t cmd_start_tick;                /**< Command start time */
+    uint8_t rx_state;                       /**< Inbound message parse state */
+    uint8_t rx_topic_len;                   /**< Topic bytes captured so far */
+    uint32_t rx_topic_hash;                 /**< FNV-1a of the whole topic so far */
+    uint8_t rx_route;                       /**< Route of the message (RX_ROUTE_x until looked up) */
+    size_t rx_offset;                       /**< Payload bytes delivered so far */
+    size_t rx_total;                        /**< Payload length from +CMQTTRXSTART */
+    uint8_t modem_flags;                    /**< Boot URCs seen (BOOT_x) */
+    uint32_t rdy_tick;                      /**< Time "RDY" was seen */
+    uint8_t reg_cs;                         /**< Last +CREG <stat> */
+    uint8_t reg_ps;                         /**< Last +CGREG / +CEREG <stat> */
+    bool ssl_cfg_ok;                        /**< SSL context 0 holds our settings (kept until module restart) */
+    bool pdp_suspect;                       /**< Data failed over a kept PDP context: recycle it once */
+    char ca_name[MQTT_CA_NAME_LEN];         /**< Module file of ca_cert, named by its hash */
+    bool cert_present;                      /**< AT+CCERTLIST showed ca_name */
+    MQTT_LinkQuality_t link;                /**< Last link-quality sample */
+    uint32_t link_poll_tick;                /**< Last link-quality poll */
+    
+    /* Adaptive keepalive (learned per network, saved in nv_store) */
+    uint32_t ka_plmn;                       /**< Network the values below belong to (0 = unknown) */
+    uint32_t up_tick;                       /**< Sessions came up */
+    uint16_t ka_next;                       /**< Keepalive for the next CONNECT, s */
+    uint16_t ka_used;                       /**< Keepalive of the running sessions, s */
+    uint16_t ka_good;                       /**< Longest keepalive that survived, s (0 = none) */
+    uint16_t ka_bad;                        /**< Shortest keepalive lost to an idle timeout, s (0 = none) */
+    bool ka_proven;                         /**< Running sessions outlived MQTT_KA_PROVE periods */
+    bool ka_dirty;                          /**< Learned values not saved yet */
+    
+    /* Cached broker address (connect_by_ip, saved in nv_store) */
+    uint32_t dns_hash;                      /**< Hash of config.broker */
+    uint32_t dns_ip;                        /**< Broker IPv4, first octet in the top byte (0 = none) */
+    uint32_t dns_tick;                      /**< Time of the last lookup (0 = none this boot) */
+    bool dns_skip;                          /**< Address failed - connect by name until a session is up */
+    bool dns_dirty;                         /**< dns_ip not saved yet */
+    
+    /* Carrier profile (no APN configured; the SIM's network kept in nv_store) */
+    bool carrier_auto;                      /**< config.apn comes from the profile */
+    const Carrier_Profile_t *carrier;       /**< Profile in use (NULL until the SIM is read) */
+    uint32_t iccid_hash;                    /**< SIM the profile is for (0 = ICCID not read) */
+    
+    /* Fast cell acquisition (last network and band, saved in nv_store) */
+    uint32_t acq_plmn;                      /**< Network of the last full connect (0 = none) */
+    uint8_t acq_band;                       /**< Its LTE band (0 = none) */
+    bool acq_locked;                        /**< Band lock (and LTE only) set in the module, not yet lifted */
+    bool acq_dirty;                         /**< acq_plmn / acq_band not saved yet */
+    
+    /* Asynchronous operation (one at a time, advanced by A7600_MQTT_Process) */
+    MQTT_Op_t op;                           /**< Operation in progress */
+    uint8_t op_step;                        /**< Current step of the operation */
+    uint8_t op_retry;                       /**< Retries of the current step */
+    bool op_issued;                         /**< Step command submitted */
+    volatile bool op_pending;               /**< Step command not finished yet */
+    AT_Result_t op_res;                     /**< Result of the step command */
+    MQTT_Result_t op_result;                /**< Result of the last finished operation */
+    const char *op_topic;                   /**< Topic (caller-owned until done) */
+    uint16_t op_topic_len;                  /**< Its length, taken once when the operation starts */
+    const MQTT_TopicDesc_t *op_desc;        /**< Publish: prepared topic (NULL: op_topic as given) */
+    const char *const *op_topics;           /**< Multi-topic subscribe: topics (caller-owned) */
+    const MQTT_QoS_t *op_qos_list;          /**< Multi-topic subscribe: QoS per topic */
+    uint8_t op_count;                       /**< Multi-topic subscribe: number of topics */
+    uint8_t op_index;                       /**< Multi-topic subscribe: topic being sent */
+    const uint8_t *op_payload;              /**< Payload (caller-owned until done) */
+    size_t op_len;                          /**< Payload length */
+    uint8_t op_qos;                         /**< QoS of subscribe / publish */
+    bool op_retain;                         /**< Publish: retained */
+    uint8_t op_client;                      /**< Client index the operation works on */
+    bool op_alt_baud;                       /**< Connect already tried the other baud rate */
+    bool op_warm;                           /**< Connect looks for the last run's sessions (ResumeAsync) */
+    uint8_t op_tier;                        /**< Connect tier (broker / client / full) */
+    uint32_t op_tick;                       /**< Start of a timed wait step / publish request */
+    uint32_t conn_tick;                     /**< Last connect timing mark */
+    MQTT_ConnectStats_t conn_stats;         /**< Timing of the last connect */
+    MQTT_DoneCallback_t op_done;            /**< Completion callback */
+    void *op_ctx;                           /**< Completion callback context */
+    
+    /* Publishes accepted by the modem, resolved in order by +CMQTTPUB */
+    MQTT_InFlight_t pub_window[MQTT_PUB_WINDOW]; /**< In-flight table (ring) */
+    uint8_t pub_head;                       /**< Oldest in-flight entry */
+    uint8_t pub_count;                      /**< Entries in flight */
+    uint16_t pub_seq;                       /**< Sequence number of the next publish */
+    uint8_t fired[MQTT_MAX_CLIENTS];        /**< Fire-and-forget publishes after the client's newest
+                                             *   entry, +CMQTTPUB due (older ones: fired_before) */
+    uint32_t fired_tick[MQTT_MAX_CLIENTS];  /**< Last one issued or counted */
+    MQTT_PubStats_t pub_stats;              /**< Publish counters */
+    uint32_t pub_wire;                      /**< AT_Engine_WireTotal when the publish's stages were queued */
+    MQTT_WireStats_t wire_stats;            /**< AT efficiency of publishes */
+    
+    /* Socket transport (MQTT framed here, carried by AT+CCH sessions 0 .. clients-1) */
+    MQTT_PacketRx_t sock_rx[MQTT_MAX_CLIENTS]; /**< Inbound packet decoder per session */
+    uint32_t sock_tx_tick[MQTT_MAX_CLIENTS]; /**< Last packet sent (PINGREQ timing) */
+    uint16_t sock_ack_id[MQTT_MAX_CLIENTS]; /**< Inbound QoS 1 PUBLISH to acknowledge (0 = none) */
+    uint16_t sock_pkt_id;                   /**< Last packet identifier used */
+    uint16_t sock_len;                      /**< Packet length for the next AT+CCHSEND */
+    uint16_t sock_sent;                     /**< PUBLISH bytes sent by earlier AT+CCHSENDs */
+    uint8_t sock_ctrl[4];                   /**< PUBACK / PINGREQ being sent */
+    uint8_t sock_ctrl_len;                  /**< Bytes in sock_ctrl */
+    uint8_t sock_ctrl_client;               /**< Session sock_ctrl goes to */
+    uint8_t sock_rx_client;                 /**< Session of the +CCHRECV being captured */
+    uint8_t sock_connack;                   /**< Bit per session: CONNACK accepted */
+    uint8_t sock_suback;                    /**< Bit per session: SUBACK received */
+    bool sock_hdr_sent;                     /**< PUBLISH header queued, payload not yet */
+    
+    /* Datagram path (UDP link 0, opened after the sessions) */
+    bool udp_up;                            /**< Link open */
+    uint16_t udp_len;                       /**< Length for the next AT+CIPSEND */
+    uint8_t udp_host_len;                   /**< Length of config.udp_host, taken when the link opens */
+    
+    /* Broker endpoints (0 = config.broker, then config.standby) */
+    uint8_t ep;                             /**< Broker connects go to */
+    uint32_t ep_tick;                       /**< CONNECT of the running attempt sent */
+    MQTT_EndpointHealth_t ep_health[MQTT_MAX_ENDPOINTS]; /**< Per broker */
+    
+    /* Network time (AT+CCLK? at a full connect) */
+    uint32_t clock_sec;                     /**< Unix time at clock_tick, s (0 = not known) */
+    uint32_t clock_tick;                    /**< HAL tick that second began at */
+    uint32_t clock_read;                    /**< Last +CCLK reading, Unix s (0 = none, or never set) */
+    uint32_t clock_read_tick;               /**< Its arrival */
+    uint32_t clock_last;                    /**< Reading before it in the running sync */
+    uint32_t clock_last_tick;
+    bool clock_ntp;                         /**< AT+CNTP tried in the running sync */
+    
+    /* Modem sleep (AT+CSCLK=1: the module sleeps while DTR is high) */
+    bool sleep_allowed;                     /**< A7600_MQTT_SetSleep */
+    bool csclk;                             /**< AT+CSCLK=1 accepted */
+    bool csclk_sent;                        /**< ... in flight */
+    uint8_t dtr_state;                      /**< Awake, asleep or waking up */
+    uint32_t dtr_tick;                      /**< DTR last changed */
+    bool wake_held;                         /**< A command is held for the wake-up */
+    uint32_t wake_tick;                     /**< Since when */
+    uint32_t quiet_tick;                    /**< Last command sent */
+    MQTT_SleepStats_t sleep_stats;
+    
+#if MQTT_CMUX
+    /* Multiplexer (AT engine on CMUX_DLC_AT, link samples on CMUX_DLC_MON) */
+    Cmux_t mux;
+    bool mux_failed;                        /**< Refused or never opened: plain AT until reset */
+    bool mux_cld;                           /**< Blind CLD sent in the running probe */
+    bool mon_busy;                          /**< Link sample out on the monitoring channel */
+    uint32_t mon_tick;                      /**< ... since */
+    char mon_line[MQTT_MON_LINE_MAX];       /**< Monitoring line being received */
+    uint8_t mon_len;
+#endif
+    
+    /* Sessions (client index 0 .. clients-1) */
+    uint8_t clients;                        /**< Sessions opened by connect */
+    uint8_t client_up;                      /**< Bit per connected session */
+    uint8_t subscribed;                     /**< Bit per session with a confirmed SUBACK */
     
     /* Debug info */
     uint8_t error_step;                     /**< Step where error occurred (1-10) */
@@ -97,7 +549,7 @@ typedef struct {
     /* Flags */
     volatile bool response_ready;           /**< Response received flag */
     volatile bool cmd_ok;                   /**< Command success flag */
-    volatile bool connected;                /**< Connection status */
+    volatile bool connected;                /**< All sessions connected */
 } A7600_MQTT_Handle_t;
 
 /**
@@ -116,6 +568,65 @@ MQTT_Result_t A7600_MQTT_Init(A7600_MQTT_Handle_t *handle, UART_DMA_Handle_t *ua
  */
 void A7600_MQTT_SetMessageCallback(A7600_MQTT_Handle_t *handle, MQTT_MessageCallback_t callback);
 
+/**
+ * @brief Set payload chunk callback - payloads are streamed, not buffered
+ * @note  Only messages that arrive in one chunk reach the message callback
+ * @param handle Pointer to MQTT handle
+ * @param callback Callback function (NULL to use the message callback)
+ */
+void A7600_MQTT_SetChunkCallback(A7600_MQTT_Handle_t *handle, MQTT_ChunkCallback_t callback);
+
+/**
+ * @brief Send the payload of one exact topic to its own handler
+ * @note  The topic hash is taken here and the inbound one as its bytes are
+ *        captured, so a message is routed by one hash compare per route
+ *        (confirmed with memcmp); topics without a route go to the callbacks
+ * @param handle Pointer to MQTT handle
+ * @param topic Exact topic, no wildcards (kept by pointer)
+ * @param handler Chunk handler for the topic
+ * @return MQTT_OK, or MQTT_ERROR if the table (MQTT_MAX_ROUTES) is full
+ */
+MQTT_Result_t A7600_MQTT_Route(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_ChunkCallback_t handler);
+
+/**
+ * @brief Set the publish policy: QoS, retain and priority per topic
+ * @note  Applied by every publish entry point - the first entry matching the
+ *        topic overrides the caller's QoS; topics not listed keep it, are not
+ *        retained and have normal priority. Retained publishes use the
+ *        retained form of AT+CMQTTPUB (the RETAIN bit on the socket transport).
+ * @param handle Pointer to MQTT handle
+ * @param policy Table (kept by pointer, NULL for none)
+ * @param count Entries
+ */
+void A7600_MQTT_SetPolicy(A7600_MQTT_Handle_t *handle, const MQTT_TopicPolicy_t *policy, uint8_t count);
+
+/**
+ * @brief Set hook run while blocking calls wait on the modem
+ * @param handle Pointer to MQTT handle
+ * @param hook Hook function (NULL to only refresh the watchdog)
+ * @param ctx Hook context
+ */
+void A7600_MQTT_SetIdleHook(A7600_MQTT_Handle_t *handle, MQTT_IdleHook_t hook, void *ctx);
+
+/**
+ * @brief Switch modem and MCU UART to a new baud rate (AT+IPR)
+ * @note  Falls back to the previous rate if the module stops answering.
+ *        Plain mode only: MQTT_ERROR while the multiplexer is up.
+ * @param handle Pointer to MQTT handle
+ * @param baudrate Target baud rate (e.g. 921600)
+ * @return MQTT_OK if both sides now run at baudrate
+ */
+MQTT_Result_t A7600_MQTT_SetBaudRate(A7600_MQTT_Handle_t *handle, uint32_t baudrate);
+
+/**
+ * @brief Enable/disable RTS/CTS on modem (AT+IFC) and MCU UART
+ * @note  Plain mode only, as A7600_MQTT_SetBaudRate
+ * @param handle Pointer to MQTT handle
+ * @param enable true for RTS/CTS
+ * @return MQTT_OK if both sides agree and the module still answers
+ */
+MQTT_Result_t A7600_MQTT_SetFlowControl(A7600_MQTT_Handle_t *handle, bool enable);
+
 /**
  * @brief Connect to MQTT broker (blocking)
  * @param handle Pointer to MQTT handle
@@ -123,8 +634,49 @@ void A7600_MQTT_SetMessageCallback(A7600_MQTT_Handle_t *handle, MQTT_MessageCall
  */
 MQTT_Result_t A7600_MQTT_Connect(A7600_MQTT_Handle_t *handle);
 
+/**
+ * @brief Start connecting to the MQTT broker (non-blocking)
+ * @note  Advanced by A7600_MQTT_Process; done runs when it finishes
+ * @param handle Pointer to MQTT handle
+ * @param done Completion callback (optional)
+ * @param ctx Callback context
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ */
+MQTT_Result_t A7600_MQTT_ConnectAsync(A7600_MQTT_Handle_t *handle, MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Recover a dropped session with as few steps as possible (non-blocking)
+ * @note  Tries CMQTTCONNECT on the still-acquired client first, then
+ *        re-acquires the client (ACCQ + SSL), and only then falls back to
+ *        the full sequence (modem, SIM, registration, PDP). Use after
+ *        +CMQTTCONNLOST, where the cause is usually broker or TCP side.
+ * @param handle Pointer to MQTT handle
+ * @param done Completion callback (optional)
+ * @param ctx Callback context
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ */
+MQTT_Result_t A7600_MQTT_ReconnectAsync(A7600_MQTT_Handle_t *handle, MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief First connect after an MCU reset that left the module running (non-blocking)
+ * @note  Probes and sets up the link as a full connect does, then asks the
+ *        module for its PDP context and MQTT sessions (AT+CGACT?;
+ *        +CMQTTCONNECT?). When every client is still connected to one of
+ *        the configured brokers, the sessions are taken over as they are and
+ *        the connect ends there (conn_stats.resumed). Otherwise the full
+ *        sequence goes on from the SIM check, keeping an active PDP context.
+ *        The AT MQTT stack only: the socket transport connects in full.
+ *        Subscriptions are not known - the caller subscribes again.
+ * @param handle Pointer to MQTT handle
+ * @param done Completion callback (optional)
+ * @param ctx Callback context
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ */
+MQTT_Result_t A7600_MQTT_ResumeAsync(A7600_MQTT_Handle_t *handle, MQTT_DoneCallback_t done, void *ctx);
+
 /**
  * @brief Disconnect from MQTT broker
+ * @note  A clean DISCONNECT: the broker discards the last will (config.will)
  * @param handle Pointer to MQTT handle
  * @return MQTT_OK on success
  */
@@ -132,6 +684,8 @@ MQTT_Result_t A7600_MQTT_Disconnect(A7600_MQTT_Handle_t *handle);
 
 /**
  * @brief Upload certificate file to module file system
+ * @note  A7600_MQTT_WriteFileAsync to the certificate store, waited for
+ *        (the idle hook runs meanwhile)
  * @param handle MQTT handle
  * @param filename Name of file on module (e.g. "ca_cert.pem")
  * @param data Certificate data pointer
@@ -140,6 +694,23 @@ MQTT_Result_t A7600_MQTT_Disconnect(A7600_MQTT_Handle_t *handle);
  */
 bool A7600_UploadCert(A7600_MQTT_Handle_t *handle, const char *filename, const char *data, size_t len);
 
+/**
+ * @brief Start writing a file to the module (non-blocking)
+ * @note  The data goes out zero-copy behind the module's ">" prompt, at line
+ *        rate, while A7600_MQTT_Process keeps serving the modem. Publishes
+ *        and other operations get MQTT_BUSY until it is done.
+ * @param handle Pointer to MQTT handle
+ * @param kind Certificate store or file system
+ * @param name File name on the module (must stay valid until done)
+ * @param data File contents (must stay valid until done)
+ * @param len Length of data, at most MQTT_FILE_MAX_LEN
+ * @param done Completion callback (optional)
+ * @param ctx Callback context
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ */
+MQTT_Result_t A7600_MQTT_WriteFileAsync(A7600_MQTT_Handle_t *handle, MQTT_File_t kind, const char *name,
+                                        const void *data, size_t len, MQTT_DoneCallback_t done, void *ctx);
+
 /**
  * @brief Subscribe to a topic
  * @param handle Pointer to MQTT handle
@@ -150,7 +721,49 @@ bool A7600_UploadCert(A7600_MQTT_Handle_t *handle, const char *filename, const c
 MQTT_Result_t A7600_MQTT_Subscribe(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_QoS_t qos);
 
 /**
- * @brief Unsubscribe from a topic
+ * @brief Start subscribing to a topic (non-blocking)
+ * @param handle Pointer to MQTT handle
+ * @param topic Topic to subscribe (must stay valid until done)
+ * @param qos QoS level
+ * @param done Completion callback (optional)
+ * @param ctx Callback context
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ */
+MQTT_Result_t A7600_MQTT_SubscribeAsync(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_QoS_t qos,
+                                        MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Start subscribing on a given session (non-blocking)
+ * @param client Client index (below MQTT_Config_t.clients)
+ * @note  Other parameters as A7600_MQTT_SubscribeAsync (which uses client 0)
+ */
+MQTT_Result_t A7600_MQTT_SubscribeClientAsync(A7600_MQTT_Handle_t *handle, uint8_t client, const char *topic,
+                                              MQTT_QoS_t qos, MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Subscribe to several topics with one SUBSCRIBE / SUBACK (blocking, client 0)
+ * @param handle Pointer to MQTT handle
+ * @param topics Topics to subscribe
+ * @param qos QoS per topic
+ * @param n Number of topics
+ * @return MQTT_OK on success
+ */
+MQTT_Result_t A7600_MQTT_SubscribeMany(A7600_MQTT_Handle_t *handle, const char *const topics[],
+                                       const MQTT_QoS_t qos[], uint8_t n);
+
+/**
+ * @brief Start a multi-topic subscribe on a given session (non-blocking)
+ * @note  Uses AT+CMQTTSUBTOPIC per topic and a single AT+CMQTTSUB, so N topics
+ *        cost one broker round trip. topics / qos must stay valid until done.
+ * @param client Client index (below MQTT_Config_t.clients)
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ */
+MQTT_Result_t A7600_MQTT_SubscribeManyClientAsync(A7600_MQTT_Handle_t *handle, uint8_t client,
+                                                  const char *const topics[], const MQTT_QoS_t qos[],
+                                                  uint8_t n, MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Unsubscribe from a topic (client 0 session)
  * @param handle Pointer to MQTT handle
  * @param topic Topic to unsubscribe
  * @return MQTT_OK on success
@@ -162,15 +775,107 @@ MQTT_Result_t A7600_MQTT_Unsubscribe(A7600_MQTT_Handle_t *handle, const char *to
  * @param handle Pointer to MQTT handle
  * @param topic Topic to publish to
  * @param payload Message payload
- * @param len Payload length
- * @param qos QoS level
- * @param retain Retain flag
- * @return MQTT_OK on success
+ * @param len Payload length, at most MQTT_PAYLOAD_MAX_LEN
+ * @param qos QoS level (the topic's policy has precedence)
+ * @param retain Retain flag (also set by the topic's policy)
+ * @return MQTT_OK once the modem reports delivery (PUBACK for QoS1), or
+ *         accepts a QoS 0 publish with config.qos0_fire
  */
 MQTT_Result_t A7600_MQTT_Publish(A7600_MQTT_Handle_t *handle, const char *topic, 
                                   const uint8_t *payload, size_t len, 
                                   MQTT_QoS_t qos, bool retain);
 
+/**
+ * @brief Start publishing a message (non-blocking)
+ * @param handle Pointer to MQTT handle
+ * @param topic Topic to publish to (must stay valid until done)
+ * @param payload Message payload (must stay valid until done, sent zero-copy)
+ * @param len Payload length, at most MQTT_PAYLOAD_MAX_LEN - streamed by DMA
+ *            from payload while the modem's data prompt is open, no copy
+ * @param qos QoS level
+ * @param done Delivery callback (optional) - runs once the modem reports
+ *             +CMQTTPUB (PUBACK for QoS1), or on failure / timeout; for a
+ *             QoS 0 publish with config.qos0_fire once the modem accepts it
+ *             (a failure it reports later is only counted)
+ * @param ctx Callback context
+ * @return MQTT_OK if started, MQTT_BUSY if another operation is running
+ *         or MQTT_PUB_WINDOW publishes (one less for MQTT_PRIO_LOW topics)
+ *         are still in flight (MQTT_FIRE_MAX of the client for qos0_fire),
+ *         MQTT_ERROR if the payload is too long
+ * @note  The operation ends as soon as the modem accepts the message, so
+ *        topic / payload may be reused and the next publish can start while
+ *        this one is still waiting for its acknowledgement
+ */
+MQTT_Result_t A7600_MQTT_PublishAsync(A7600_MQTT_Handle_t *handle, const char *topic,
+                                       const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                       MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Start publishing on a given session (non-blocking)
+ * @param client Client index (below MQTT_Config_t.clients)
+ * @note  Other parameters as A7600_MQTT_PublishAsync (which uses client 0).
+ *        Each session has its own TCP stream to the broker, so a bulk
+ *        stream on one does not hold up QoS1 acknowledgements on the other.
+ */
+MQTT_Result_t A7600_MQTT_PublishClientAsync(A7600_MQTT_Handle_t *handle, uint8_t client, const char *topic,
+                                             const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                             MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Prepare a topic for A7600_MQTT_PublishDescAsync (once, e.g. at init)
+ * @param desc Descriptor to fill (caller-owned, kept while publishes use it)
+ * @param client Session the topic is published on
+ * @param topic Topic (caller-owned, not copied)
+ * @return MQTT_OK, MQTT_ERROR if the topic is empty or longer than MQTT_TOPIC_MAX_LEN
+ */
+MQTT_Result_t A7600_MQTT_TopicDescInit(MQTT_TopicDesc_t *desc, uint8_t client, const char *topic);
+
+/**
+ * @brief Start publishing on a prepared topic (non-blocking fast path)
+ * @param desc Topic descriptor (A7600_MQTT_TopicDescInit)
+ * @note  Other parameters and results as A7600_MQTT_PublishAsync; the session
+ *        is the descriptor's. Nothing is measured or formatted for the topic.
+ */
+MQTT_Result_t A7600_MQTT_PublishDescAsync(A7600_MQTT_Handle_t *handle, const MQTT_TopicDesc_t *desc,
+                                           const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                           MQTT_DoneCallback_t done, void *ctx);
+
+/**
+ * @brief Send a datagram on the UDP path (non-blocking, no delivery report)
+ * @note  For loss-tolerant streams that should not wait behind TCP
+ *        retransmits. Sent zero-copy: data must stay valid until
+ *        A7600_MQTT_IsBusy returns false. Counted in the publish stats.
+ * @param handle Pointer to MQTT handle
+ * @param data Datagram bytes
+ * @param len Datagram length (1 .. MQTT_UDP_MAX_LEN)
+ * @return MQTT_OK if queued, MQTT_NOT_CONNECTED without a datagram path,
+ *         MQTT_BUSY while an operation runs
+ */
+MQTT_Result_t A7600_MQTT_SendDatagram(A7600_MQTT_Handle_t *handle, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check whether the datagram path is open
+ * @note  Opened at the end of connect when config.udp_host is set; a
+ *        failure there leaves the sessions connected without it
+ * @param handle Pointer to MQTT handle
+ * @return true if A7600_MQTT_SendDatagram can be used
+ */
+bool A7600_MQTT_DatagramReady(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Check whether an operation or AT command is in progress
+ * @param handle Pointer to MQTT handle
+ * @return true if a new asynchronous operation would return MQTT_BUSY
+ */
+bool A7600_MQTT_IsBusy(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Number of publishes waiting for their +CMQTTPUB result
+ * @param handle Pointer to MQTT handle
+ * @return Entries in the in-flight window
+ */
+uint8_t A7600_MQTT_PublishInFlight(A7600_MQTT_Handle_t *handle);
+
 /**
  * @brief Publish string message
  * @param handle Pointer to MQTT handle
@@ -184,6 +889,8 @@ MQTT_Result_t A7600_MQTT_PublishString(A7600_MQTT_Handle_t *handle, const char *
 
 /**
  * @brief Process MQTT - call regularly in main loop
+ * @note  Services the AT engine, advances asynchronous operations and
+ *        parses incoming messages / URCs
  * @param handle Pointer to MQTT handle
  */
 void A7600_MQTT_Process(A7600_MQTT_Handle_t *handle);
@@ -218,4 +925,175 @@ uint8_t A7600_MQTT_GetErrorStep(A7600_MQTT_Handle_t *handle);
  */
 const char* A7600_MQTT_GetLastResponse(A7600_MQTT_Handle_t *handle);
 
+/**
+ * @brief Check whether the module has finished booting
+ * @note  Tracks the RDY / +CPIN / SMS DONE / PB DONE boot URCs, which
+ *        A7600_MQTT_Process picks up. Ready once the SIM state is reported,
+ *        or once a probe from A7600_MQTT_ProbeModule was answered.
+ * @param handle Pointer to MQTT handle
+ * @return true if the connect sequence can start
+ */
+bool A7600_MQTT_ModuleReady(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Queue a single "AT" probe (non-blocking) for a module that booted before the MCU
+ * @note  Does nothing while a boot is seen in progress ("RDY" without +CPIN yet)
+ *        or while the driver is busy
+ * @param handle Pointer to MQTT handle
+ */
+void A7600_MQTT_ProbeModule(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Check whether a session's subscriptions survive on the broker
+ * @note  The A7600 does not report the CONNACK session-present flag. With
+ *        persistent_session set, the broker keeps subscriptions under the
+ *        client ID, so a session whose SUBACK was seen since init counts
+ *        as present and needs no resubscribe after a reconnect.
+ * @param handle Pointer to MQTT handle
+ * @param client Client index
+ * @return true if resubscribing can be skipped
+ */
+bool A7600_MQTT_SessionPresent(A7600_MQTT_Handle_t *handle, uint8_t client);
+
+/**
+ * @brief Get per-step timing and retries of the last connect / reconnect
+ * @param handle Pointer to MQTT handle
+ * @return Statistics, valid until the next connect starts
+ */
+const MQTT_ConnectStats_t* A7600_MQTT_GetConnectStats(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Get the health of a broker endpoint
+ * @note  A connect goes to the broker with the shortest measured CONNACK time
+ *        among those not failing (the current one unless another is a quarter
+ *        faster; unmeasured ones after measured ones, list order on ties).
+ *        MQTT_EP_FAILS failed CONNECTs in a row move the running connect to
+ *        the next such broker at once, from the client tier at most - PDP
+ *        and registration are kept. A failing broker is picked again after
+ *        MQTT_EP_RETRY. The cached address (connect_by_ip) is config.broker's only.
+ * @param handle Pointer to MQTT handle
+ * @param index 0 = config.broker, 1.. = config.standby
+ * @return Health, NULL if the endpoint is not configured
+ */
+const MQTT_EndpointHealth_t* A7600_MQTT_GetEndpoint(A7600_MQTT_Handle_t *handle, uint8_t index);
+
+/**
+ * @brief Get publish throughput and delivery latency counters
+ * @param handle Pointer to MQTT handle
+ * @return Counters since A7600_MQTT_Init
+ */
+const MQTT_PubStats_t* A7600_MQTT_GetPublishStats(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Get the AT efficiency of publishes (bytes by class: AT_Engine_GetWire)
+ * @param handle Pointer to MQTT handle
+ * @return Counters since A7600_MQTT_Init
+ */
+const MQTT_WireStats_t* A7600_MQTT_GetWireStats(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Get the keepalive the running sessions were connected with
+ * @note  With adaptive_keepalive this is what the driver learned for the
+ *        current network; a new value takes effect at the next connect
+ * @param handle Pointer to MQTT handle
+ * @return Keepalive in seconds
+ */
+uint16_t A7600_MQTT_GetKeepalive(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Change the keepalive for the next connect (a running session keeps its own)
+ * @param handle Pointer to MQTT handle
+ * @param seconds Keepalive, s (adaptive: start value where nothing was learned)
+ * @param adaptive Learn the longest keepalive per network instead of a fixed value
+ * @return MQTT_OK, MQTT_ERROR if seconds is 0
+ */
+MQTT_Result_t A7600_MQTT_SetKeepalive(A7600_MQTT_Handle_t *handle, uint16_t seconds, bool adaptive);
+
+/**
+ * @brief Freeze the AT transcript and get it for a dump
+ * @note  Record format in at_engine.h. Nothing is recorded until
+ *        A7600_MQTT_ResumeTranscript, so the data can be published zero-copy.
+ * @param handle Pointer to MQTT handle
+ * @param data Receives the oldest record
+ * @return Transcript bytes
+ */
+size_t A7600_MQTT_FreezeTranscript(A7600_MQTT_Handle_t *handle, const uint8_t **data);
+
+/**
+ * @brief Record the AT transcript again
+ * @param handle Pointer to MQTT handle
+ */
+void A7600_MQTT_ResumeTranscript(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Get the last link-quality sample
+ * @note  Refreshed every MQTT_LINK_POLL_INTERVAL by A7600_MQTT_Process while
+ *        connected and idle (busy too once the multiplexer is open), and early
+ *        when a +CEREG URC reports a new location
+ * @param handle Pointer to MQTT handle
+ * @return Link quality (csq 99 until the first sample)
+ */
+const MQTT_LinkQuality_t* A7600_MQTT_GetLinkQuality(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Wall-clock time of a HAL tick
+ * @note  Network time (NITZ, or one AT+CNTP sync if the network sends none) is
+ *        read at a full connect. AT+CCLK? counts whole seconds, so it is polled
+ *        until the second turns over: the tick is then known to about
+ *        MQTT_CLOCK_POLL. A tick the MCU clock has drifted from since is
+ *        corrected at the next full connect after MQTT_CLOCK_TTL.
+ * @param handle Pointer to MQTT handle
+ * @param tick HAL tick
+ * @param sec Receives seconds since 1970-01-01 UTC
+ * @param ms Receives the milliseconds
+ * @return false until network time has been read (MQTT_CLOCK_SYNC)
+ */
+bool A7600_MQTT_GetUnixTime(A7600_MQTT_Handle_t *handle, uint32_t tick, uint32_t *sec, uint16_t *ms);
+
+/**
+ * @brief Let the module sleep between commands while connected
+ * @note  Needs config.dtr. Once connected the driver sends AT+CSCLK=1; then
+ *        DTR goes high after MQTT_SLEEP_IDLE without commands, and a command
+ *        pulls it low and waits MQTT_WAKE_MS before it goes out. The module
+ *        still wakes on its own for URCs and received messages. Off (the
+ *        default), DTR stays low.
+ * @param handle Pointer to MQTT handle
+ * @param allow true to let the module sleep
+ */
+void A7600_MQTT_SetSleep(A7600_MQTT_Handle_t *handle, bool allow);
+
+/**
+ * @brief Start waking the module ahead of a command that is due soon
+ * @note  A batch flush calls it MQTT_WAKE_MS before its deadline, so the
+ *        publish finds the module awake; no effect while it is awake
+ * @param handle Pointer to MQTT handle
+ */
+void A7600_MQTT_Wake(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Check whether the module is asleep or waking up
+ * @param handle Pointer to MQTT handle
+ * @return true while DTR is high or the wake-up delay runs
+ */
+bool A7600_MQTT_Asleep(A7600_MQTT_Handle_t *handle);
+
+#if MQTT_CMUX
+/**
+ * @brief Get the multiplexer
+ * @note  Opened at the link setup of a full connect, after the baud rate and
+ *        flow control; link samples then go on their own channel, whatever
+ *        the AT channel is doing. Plain AT if the module refuses.
+ * @param handle Pointer to MQTT handle
+ * @return Multiplexer (Cmux_IsOpen, Cmux_GetStats)
+ */
+const Cmux_t* A7600_MQTT_GetMux(A7600_MQTT_Handle_t *handle);
+#endif
+
+/**
+ * @brief Get modem sleep counters
+ * @param handle Pointer to MQTT handle
+ * @return Counters since init
+ */
+const MQTT_SleepStats_t* A7600_MQTT_GetSleepStats(A7600_MQTT_Handle_t *handle);
+
 #endif /* A7600_MQTT_H */
@@ -0,0 +1,90 @@
+/**
+ * @file    anomaly.h
+ * @brief   Edge anomaly score of the autopilot state - raises the uplink rate of its streams on events
+ * @version 1.0
+ *
+ * Built with ANOMALY_ENABLE=1 (a compiler define, CMSIS-NN sources in the
+ * Keil project). The bridge hands over the autopilot's VIBRATION, ATTITUDE
+ * and SYS_STATUS payloads; their fields are reduced, in integer arithmetic
+ * (no soft-float library), to ANOMALY_FEATURES q7 levels per
+ * ANOMALY_STEP_MS step. At the end of a step the step's levels and their mean
+ * over the last ANOMALY_WINDOW steps go through a two-layer q7 fully
+ * connected model (arm_fully_connected_q7, ReLU in between). A score of
+ * ANOMALY_THRESHOLD or more raises the uplink limit of those three streams
+ * ANOMALY_RATE_BOOST times for ANOMALY_BOOST_MS, so an event reaches the
+ * ground at full detail while the steady state stays decimated.
+ *
+ * Budget: ~150 B of RAM, the weights (~150 B) and ~1.5 KB of code in flash.
+ * The model run is the "anomaly" profiler site (PROFILER_ENABLE).
+ */
+
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef ANOMALY_ENABLE
+#define ANOMALY_ENABLE      0
+#endif
+
+/* Configuration */
+#define ANOMALY_STEP_MS         250     /**< Model run period (at the first frame past it) */
+#define ANOMALY_WINDOW          8       /**< Steps in the baseline; no score until it is full */
+#define ANOMALY_FEATURES        8       /**< q7 levels per step */
+#define ANOMALY_THRESHOLD       24      /**< Score that starts a boost (0..127) */
+#define ANOMALY_BOOST_MS        5000    /**< Boost length, restarted by each score over the threshold */
+#define ANOMALY_RATE_BOOST      4       /**< Uplink limit multiplier while boosting */
+#define ANOMALY_PAYLOAD_MAX     32      /**< Payload bytes the model reads (VIBRATION is the longest) */
+
+/**
+ * @brief Model figures since boot
+ */
+typedef struct {
+    uint8_t score;          /**< Last score */
+    uint8_t peak;           /**< Highest score */
+    uint32_t runs;          /**< Model runs */
+    uint32_t boosts;        /**< Boosts started (not restarted) */
+} Anomaly_Stats_t;
+
+#if ANOMALY_ENABLE
+
+/**
+ * @brief Clear the window and the boost
+ */
+void Anomaly_Init(void);
+
+/**
+ * @brief Check whether the model reads a message
+ * @param msgid MAVLink message ID
+ * @return true for VIBRATION, ATTITUDE and SYS_STATUS
+ */
+bool Anomaly_Wants(uint32_t msgid);
+
+/**
+ * @brief Hand over an autopilot frame's payload; runs the model when a step is complete
+ * @note  A frame seen again (held by the bridge and parsed on the next pass)
+ *        is recognised by its sequence number and skipped
+ * @param msgid Message ID (Anomaly_Wants true)
+ * @param seq Frame sequence number
+ * @param payload ANOMALY_PAYLOAD_MAX bytes, zero-filled past the frame's payload
+ * @param now HAL tick
+ */
+void Anomaly_Feed(uint32_t msgid, uint8_t seq, const uint8_t *payload, uint32_t now);
+
+/**
+ * @brief Uplink limit multiplier of a message
+ * @param msgid MAVLink message ID
+ * @return ANOMALY_RATE_BOOST for the model's streams while boosting, else 1
+ */
+uint8_t Anomaly_RateBoost(uint32_t msgid);
+
+/**
+ * @brief Get the model figures
+ */
+const Anomaly_Stats_t *Anomaly_GetStats(void);
+
+#endif /* ANOMALY_ENABLE */
+
+#endif /* ANOMALY_H */
@@ -1,7 +1,7 @@
 /**
  * @file    app.h
  * @brief   Application Layer for UAV 4G Project
- * @version 1.0
+ * @version 1.20
  */
 
 #ifndef APP_H
@@ -10,6 +10,8 @@
 #include "main.h"
 #include "uart_dma.h"
 #include "a7600_mqtt.h"
+#include "scheduler.h"
+#include "topic_ns.h"
 
 /* ==================== Configuration ==================== */
 
@@ -19,17 +21,121 @@
 #define APP_MQTT_USERNAME       "uav4g"
 #define APP_MQTT_PASSWORD       "Uav4g_timelapse"
 #define APP_MQTT_CLIENT_ID      "stm32_uav4g"
-#define APP_MQTT_KEEPALIVE      120
+#define APP_MQTT_KEEPALIVE      120     /* Start value - learned per network from here */
+#define APP_MQTT_ADAPTIVE_KA    1       /* Probe for the longest keepalive the carrier NAT keeps */
+#define APP_MQTT_STANDBY        ""      /* Failover broker, same port / login / CA ("" = none, "cfg standby") */
 
-/* MQTT Topics */
+/* Modem sleep between batches while the autopilot is disarmed (needs MODEM_SLEEP_DTR) */
+#define APP_MODEM_SLEEP         1
+
+/* Modem UART rate negotiated with AT+IPR at connect (0 = stay at 115200) */
+#define APP_MODEM_BAUD          921600
+
+/* MQTT sessions: bulk telemetry QoS0 on one, commands / status QoS1 on the other */
+#define APP_MQTT_CLIENTS        2
+#define APP_CLIENT_TELEM        0       /* MAVLink bridge (A7600_MQTT_PublishAsync) */
+#define APP_CLIENT_CONTROL      1       /* Status publishes and command subscription */
+#define APP_MQTT_PERSISTENT     1       /* clean_session=0 - keep subscriptions across reconnects */
+#define APP_MQTT_TRANSPORT      MQTT_TRANSPORT_AT   /* MQTT_TRANSPORT_SOCKET: frame MQTT on the MCU */
+#define APP_MQTT_CONNECT_BY_IP  0       /* Skip DNS on reconnect - HiveMQ Cloud routes by SNI, so keep 0 */
+#define APP_MQTT_VERIFY_TLS     1       /* Verify the broker against isrg_root_x1 (uploaded once per module) */
+#define APP_MQTT_QOS0_FIRE      0       /* QoS 0 publishes done once the modem accepts them, not at +CMQTTPUB:
+                                         * the bridge's shaper and batching then see acceptance times */
+
+/* Datagram endpoint for loss-tolerant MAVLink streams (NULL = everything over MQTT) */
+#define APP_UDP_HOST            NULL
+#define APP_UDP_PORT            14550
+
+/* Broker, credentials, APN, keepalive and rates above are defaults: the
+ * values stored with APP_CMD_CFG (config_store.h) replace them at boot */
+
+/* MQTT Topics (per device with TOPIC_NS_ENABLE, see topic_ns.h) */
+#if TOPIC_NS_ENABLE
+#define APP_TOPIC_STATUS        TOPIC_NS(STATUS)
+#define APP_TOPIC_SENSOR        TOPIC_NS(SENSOR)
+#define APP_TOPIC_COMMAND       TOPIC_NS(COMMAND)
+#define APP_TOPIC_RESPONSE      TOPIC_NS(RESPONSE)
+#define APP_TOPIC_DIAG          TOPIC_NS(DIAG)
+#define APP_TOPIC_DIAG_ALL      TOPIC_NS(DIAG_ALL)
+#define APP_TOPIC_PERF          TOPIC_NS(PERF)
+#else
 #define APP_TOPIC_STATUS        "uav4g/status"
 #define APP_TOPIC_SENSOR        "uav4g/sensor"
 #define APP_TOPIC_COMMAND       "uav4g/command"
 #define APP_TOPIC_RESPONSE      "uav4g/response"
+#define APP_TOPIC_DIAG          "uav4g/diag"    /* AT transcript dumps (binary, see at_engine.h) */
+#define APP_TOPIC_DIAG_ALL      APP_TOPIC_DIAG "/#"
+#define APP_TOPIC_PERF          "uav4g/perf"    /* Performance records (binary, see metrics.h) */
+#endif
+
+/* Commands on APP_TOPIC_COMMAND - each is answered on APP_TOPIC_RESPONSE with
+ * {"cmd":<first word>,"ok":0|1} and the current encoding, keepalive and batching */
+#define APP_CMD_DIAG            "diag"          /* Publish the AT transcript */
+#define APP_CMD_GET             "get"           /* Only the reply */
+#define APP_CMD_RATE            "rate "         /* "rate <msgid> <hz>": uplink limit (0 drop, 255 all) */
+#define APP_CMD_ENC             "enc "          /* "enc <hex|base64|raw>[+lz]": MAVLink payload encoding */
+#define APP_CMD_ROUTE           "route "        /* "route <sysid> <compid> <0|1|2>": source normal/bulk/off */
+#define APP_CMD_SHARE           "share "        /* "share <sysid> <compid> <bytes>": uplink share when congested */
+#define APP_CMD_BATCH           "batch "        /* "batch <bytes> <ms>": uplink batch budget and deadline */
+#define APP_CMD_STAMP           "stamp "        /* "stamp <0|1>": live batches open with a SYSTEM_TIME stamp */
+#define APP_CMD_HDR             "hdr "          /* "hdr <0|1>": batch frames with compact headers */
+#define APP_CMD_SLEEP           "sleep "        /* "sleep <0|1>": modem sleep while the autopilot is disarmed */
+#define APP_CMD_KA              "ka "           /* "ka <s>|auto": keepalive from the next connect */
+#define APP_CMD_CFG             "cfg "          /* "cfg <name> [value]": store a setting, none = default at boot */
+#define APP_CMD_LOG             "log "          /* "log <module|all> <off|error|warn|info>": debug log level */
+#define APP_CMD_BENCH           "bench "        /* "bench <percent>": generator rate, new run (bench_bridge target) */
+#define APP_CMD_CODECS          "codecs"        /* Codec micro-benchmark on the status topic (profiler build) */
+#define APP_CMD_SUM             "sum "          /* "sum <ms>": ATTITUDE / VFR_HUD as summaries, 0 off (summary build) */
+#define APP_CMD_OTA             "ota "          /* "ota <size> <crc32 hex>" | "ota apply": firmware update (OTA build) */
+#define APP_CMD_SNAP            "snap"          /* Latest autopilot state frames again, in the next batch */
+#define APP_CMD_PROF            "prof "         /* "prof <full|reduced|minimal|ground|auto>": pin a telemetry profile
+                                                 * or switch on the link quality (profile build) */
 
 /* Timing */
 #define APP_PUBLISH_INTERVAL    5000    /* Publish status every 5 seconds */
-#define APP_RECONNECT_INTERVAL  30000   /* Reconnect attempt every 30 seconds */
+#define APP_STATUS_QUIET        6       /* Telemetry flowing: detailed report every 6th interval, or on a change */
+#define APP_METRICS_VERSION     6       /* "v" of the metrics publish - bump when its fields change */
+#define APP_STATUS_RECORD       64      /* ... the same fields as a record in an autopilot batch, bytes */
+#define APP_BACKOFF_STABLE      60000   /* Connected this long: the next failure retries fast again */
+#define APP_MODULE_PROBE_INTERVAL 2000  /* "AT" probe while no boot URC was seen */
+#define APP_SETTLE_TIME         1000    /* Modem settle time after a disconnect */
+
+/* Scheduler tasks (see app.c for periods and budgets) */
+#define APP_TASKS               6
+#define APP_SLICE_MODEM         0       /* modem, link, status: MQTT driver side */
+#define APP_SLICE_BRIDGE        3       /* uplink, downlink */
+#define APP_SLICE_HEALTH        5       /* watchdog, debug output */
+
+/* Threaded build (CMSIS-RTOS2 / RTX5, Keil target test_a7600_rtos): the
+ * slices above become threads woken by UART event flags */
+#ifndef APP_RTOS
+#define APP_RTOS                0
+#endif
+#define APP_THREADS             3
+
+/**
+ * @brief Metrics snapshot, published on APP_TOPIC_STATUS every APP_PUBLISH_INTERVAL
+ */
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t fc_rx;             /**< Bytes from the FC (free-running) */
+    uint32_t fc_tx;             /**< Bytes to the FC */
+    uint32_t modem_tx;          /**< Bytes to the modem - AT commands and uplink payloads */
+    uint32_t modem_rx;          /**< Bytes from the modem - responses and downlink payloads */
+    uint32_t pub_rate;          /**< Publishes delivered per second over the last interval */
+    uint32_t drops;             /**< Uplink frames lost in the bridge: failed publishes, outage log full */
+    uint32_t reconnects;
+    uint32_t loop_max_us;       /**< Longest scheduler pass since boot */
+    uint32_t ram_static;        /**< Data + bss, bytes (stack and heap excluded) */
+    uint32_t stack_used;        /**< Main stack high-water mark, bytes of RAM_STACK_SIZE */
+    uint8_t csq;                /**< +CSQ 0..31, 99 = unknown */
+    uint16_t batch_bytes;       /**< Uplink batch budget and flush deadline, as the batching controller left them */
+    uint16_t batch_ms;
+    uint32_t batch_cuts;        /**< Times the controller halved them (slow or failed publish) */
+    uint32_t resets;            /**< Warm resets the counters were carried over (retain.h) */
+    uint16_t cpu_pm;            /**< Core busy over the last interval, per mille (idle-loop accounting) */
+    uint16_t at_eff_pm;         /**< Payload per mille of the modem UART bytes its publishes took, last interval */
+} App_Metrics_t;
 
 /**
  * @brief Application state
@@ -52,6 +158,33 @@ typedef struct {
     uint32_t last_publish_tick;
     uint32_t last_reconnect_tick;
     uint32_t error_count;
+    bool stats_pending;         /* Connect timing not published yet */
+    bool reset_pending;         /* Reset cause not published yet (once per boot) */
+    bool boot_pending;          /* Boot profile not published yet (once per boot) */
+    bool warm_boot;             /* Watchdog / software reset: first connect takes over the modem's sessions */
+    bool detail_pending;        /* Metrics went out; the detailed status turn follows */
+    uint32_t connects;          /* Successful connects since power-on (carried over warm resets) */
+    uint32_t resets;            /* Warm resets the retained state came through */
+    uint32_t traffic_base[4];   /* UART bytes before them: FC RX, FC TX, modem TX, modem RX */
+    uint32_t retain_tick;       /* Last save of the retained state */
+    uint32_t metrics_tick;      /* Time and publish count of the last snapshot (rate base) */
+    uint32_t metrics_delivered;
+    uint32_t metrics_bytes;     /* Publish payload and wire bytes of the last snapshot (AT efficiency base) */
+    uint32_t metrics_wire;
+    App_Metrics_t metrics;      /* Last snapshot published */
+    uint32_t metrics_carried;   /* Snapshots that went up in an autopilot batch instead */
+    uint32_t details_quiet;     /* Detailed reports left out while telemetry flowed */
+    uint32_t detail_sig;        /* Drops + reconnects + batch cuts + cell changes at the last one */
+    uint8_t detail_skip;        /* Intervals left out since the last one */
+    uint8_t status_turn;        /* Next periodic status: link, throughput, latency, tasks (, profiler) */
+    bool diag_pending;          /* AT transcript frozen, waiting to be published */
+    bool settling;              /* ERROR: disconnected, waiting APP_SETTLE_TIME */
+    uint8_t backoff_tier;       /* Reconnect backoff tier of the last failure (see app.c) */
+    uint32_t backoff_ms;        /* Next backoff base (0: the tier's first) */
+    uint32_t retry_delay;       /* ERROR: wait before this retry, jitter included */
+    uint32_t connected_tick;    /* Last successful connect (backoff reset once stable) */
+    Sched_t sched;
+    Sched_Stats_t task_stats[APP_TASKS];
 } App_Handle_t;
 
 /**
@@ -63,15 +196,24 @@ typedef struct {
 bool App_Init(App_Handle_t *app, UART_DMA_Handle_t *uart);
 
 /**
- * @brief Run application main loop (call in while(1))
+ * @brief Run one scheduler pass: every due task once (call in while(1))
+ * @note  Consumes the UART RX events - check UART_DMA_HasEvents() before sleeping
  * @param app Pointer to app handle
  */
 void App_Run(App_Handle_t *app);
 
 /**
- * @brief Connect to MQTT broker
+ * @brief Sleep until the next task is due or an interrupt comes (call after App_Run)
+ * @note  Returns at once if a UART event is pending; see low_power.h
  * @param app Pointer to app handle
- * @return true on success
+ */
+void App_Sleep(App_Handle_t *app);
+
+/**
+ * @brief Start connecting to MQTT broker (non-blocking)
+ * @note  Progress is made by App_Run(); subscribe and "online" follow on success
+ * @param app Pointer to app handle
+ * @return true if the connect sequence was started
  */
 bool App_Connect(App_Handle_t *app);
 
@@ -90,10 +232,10 @@ void App_Disconnect(App_Handle_t *app);
 bool App_PublishSensor(App_Handle_t *app, const char *data);
 
 /**
- * @brief Publish status message
+ * @brief Publish status message (QoS1, non-blocking)
  * @param app Pointer to app handle
- * @param status Status string
- * @return true on success
+ * @param status Status string (must stay valid until sent, e.g. a literal)
+ * @return true if handed to the driver
  */
 bool App_PublishStatus(App_Handle_t *app, const char *status);
 
@@ -111,4 +253,35 @@ bool App_IsConnected(App_Handle_t *app);
  */
 App_State_t App_GetState(App_Handle_t *app);
 
+/**
+ * @brief Get the scheduler (task runtime statistics)
+ * @param app Pointer to app handle
+ * @return Scheduler instance
+ */
+const Sched_t *App_GetScheduler(App_Handle_t *app);
+
+/**
+ * @brief Get the last metrics snapshot published
+ * @param app Pointer to app handle
+ * @return Snapshot (zero until the first status publish)
+ */
+const App_Metrics_t *App_GetMetrics(App_Handle_t *app);
+
+#if APP_RTOS
+/**
+ * @brief Start the kernel with the modem, bridge and health threads (app_rtos.c)
+ * @note  Call after App_Init() instead of the App_Run() loop; does not return
+ * @param app Pointer to app handle
+ */
+void App_RtosStart(App_Handle_t *app);
+
+/**
+ * @brief Get a thread's stack headroom and longest wake latency
+ * @param thread 0 modem, 1 bridge, 2 health
+ * @param stack_free Receives the stack never used, bytes
+ * @param wake_max_us Receives the longest UART event to slice start, us
+ */
+void App_RtosGetThreadStats(uint8_t thread, uint32_t *stack_free, uint32_t *wake_max_us);
+#endif
+
 #endif /* APP_H */
@@ -0,0 +1,367 @@
+/**
+ * @file    at_engine.h
+ * @brief   Non-blocking AT command engine with a command queue
+ * @version 1.9 - Wire byte classes
+ *
+ * Commands are queued as {text, expected, timeout, on_done} entries and sent
+ * one at a time; AT_Engine_Process() is called every main-loop pass and never
+ * blocks, so other work keeps running while the modem is answering.
+ *
+ * Received text is split into lines as it arrives. Each line is classified
+ * once, matched against the pending command and handed to the URC table or
+ * the line handler, so parsing cost is linear in the bytes received. URCs
+ * are dispatched whatever command is pending; starting a command only drops
+ * lines already dispatched. A handler can claim the next <len> bytes after
+ * its line (AT_Engine_Capture), which are then streamed to it untokenized.
+ * A wake-up gate (AT_Engine_SetWake) holds each command back until the modem
+ * can listen, for a module that sleeps with its UART off between commands.
+ * A read source (AT_Engine_SetSource) takes the place of the UART's ring when
+ * the engine's bytes are one channel among others on the wire (cmux.h).
+ *
+ * The bytes on the wire are counted by class (AT_Engine_GetWire): sent as
+ * command text or as payload data (AT_FLAG_DATA entries), received as the
+ * data prompt, "+XXX:" lines, captured data or responses (echo, OK, other
+ * text - what the rest leaves). Command bytes are the rest of what the UART
+ * sent, so commands the driver writes past the queue count as well.
+ *
+ * Every command, received line and result is also appended to a small
+ * transcript ring (AT_TRACE_SIZE) for post-mortem reading. Records:
+ *   <type | len><tick lo><tick hi><len text bytes>
+ * with the low 16 bits of HAL_GetTick(); the oldest records are dropped.
+ *
+ * The AT capture build (AT_CAPTURE, with DEBUG_ENABLE) records a whole
+ * session for the host replay (Bench/at_replay.c) instead of the last few
+ * lines: every byte read from or queued to the modem UART goes to RTT up
+ * channel 1 with the full tick, nothing cut. Records:
+ *   <'R' | 'T' | 'D'><len LE16><tick LE32><len bytes>
+ * R: bytes read, T: bytes queued for TX, D: a 4-byte count of bytes lost
+ * because the probe fell behind (before the record that follows).
+ */
+
+#ifndef AT_ENGINE_H
+#define AT_ENGINE_H
+
+#include "main.h"
+#include "uart_dma.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define AT_QUEUE_LEN            5       /**< Commands that can wait for the wire (one publish) */
+#define AT_RX_BUFFER_SIZE       512     /**< Response / URC accumulation buffer */
+
+/* AT transcript ring (0 = off) - RAM bound: 1 KB does not fit next to the buffers on 8 KB */
+#ifndef AT_TRACE_SIZE
+#define AT_TRACE_SIZE           256
+#endif
+#define AT_TRACE_TEXT_MAX       40      /**< Text bytes kept per record */
+
+/* Modem UART capture over RTT (see above) - debug builds with DEBUG_RTT only */
+#ifndef AT_CAPTURE
+#define AT_CAPTURE              0
+#endif
+#define AT_CAPTURE_RX           'R'
+#define AT_CAPTURE_TX           'T'
+#define AT_CAPTURE_DROP         'D'
+#define AT_CAPTURE_HDR          7       /**< Type, length, tick */
+
+/* Transcript record types (top bits of the first byte, low bits are the text length) */
+#define AT_TRACE_TX             0x00    /**< Command text sent */
+#define AT_TRACE_CMD            0x40    /**< Built / binary / wait-only entry: its expected token */
+#define AT_TRACE_RX             0x80    /**< Received line */
+#define AT_TRACE_END            0xC0    /**< Command finished: one byte AT_Result_t */
+#define AT_TRACE_LEN_MASK       0x3F
+
+/* Idle gap before each command, in character times at the current baud
+ * (0 = send as soon as the previous final result / prompt is seen) */
+#ifndef AT_GUARD_CHARS
+#define AT_GUARD_CHARS          0
+#endif
+
+/* Command flags */
+#define AT_FLAG_ZC              0x01    /**< Send data zero-copy (stays caller-owned until done) */
+#define AT_FLAG_KEEP_RX         0x02    /**< Do not drop earlier lines before sending */
+#define AT_FLAG_CHAIN           0x04    /**< Skipped (no callback) if the command before failed */
+#define AT_FLAG_DATA            0x08    /**< Payload, not command text (wire byte classes) */
+
+/**
+ * @brief Command outcome
+ */
+typedef enum {
+    AT_OK = 0,          /**< Expected token seen */
+    AT_ERROR,           /**< "ERROR" seen first */
+    AT_TIMEOUT          /**< Neither seen in time (or could not be sent) */
+} AT_Result_t;
+
+/**
+ * @brief Class of a received line
+ */
+typedef enum {
+    AT_LINE_DATA = 0,   /**< Anything else (echo, raw data, information text) */
+    AT_LINE_URC,        /**< "+XXX: ..." result or unsolicited code */
+    AT_LINE_OK,         /**< Final "OK" */
+    AT_LINE_ERROR,      /**< Final "ERROR" / "+CME ERROR" / "+CMS ERROR" */
+    AT_LINE_PROMPT      /**< Data prompt "> " (no line end) */
+} AT_LineType_t;
+
+/**
+ * @brief Class of the bytes on the wire
+ */
+typedef enum {
+    AT_WIRE_CMD = 0,    /**< Sent: command text */
+    AT_WIRE_TX_DATA,    /**< Sent: AT_FLAG_DATA entries */
+    AT_WIRE_RESPONSE,   /**< Received: echo, final results, information text, line ends */
+    AT_WIRE_PROMPT,     /**< Received: data prompts */
+    AT_WIRE_URC,        /**< Received: "+XXX:" lines */
+    AT_WIRE_RX_DATA,    /**< Received: captured bytes (AT_Engine_Capture) */
+    AT_WIRE_CLASSES
+} AT_Wire_t;
+
+/**
+ * @brief Line handler, runs once per received line (inside AT_Engine_Process)
+ * @note  line points into the response buffer and is not NUL-terminated.
+ *        The handler must not submit commands or clear the buffer.
+ * @param ctx Handler context
+ * @param line Line text without CR/LF
+ * @param len Line length
+ * @param type Line class
+ */
+typedef void (*AT_LineFn_t)(void *ctx, const char *line, size_t len, AT_LineType_t type);
+
+/**
+ * @brief Receiver of captured raw bytes (called per arriving chunk)
+ * @param ctx Handler context
+ * @param data Bytes (point into the response buffer)
+ * @param len Number of bytes
+ */
+typedef void (*AT_RawFn_t)(void *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief URC table entry
+ */
+typedef struct {
+    const char *prefix;                 /**< Line start to match, e.g. "+CMQTTRXSTART:" */
+    AT_LineFn_t handler;                /**< Called with the whole line */
+} AT_Urc_t;
+
+/**
+ * @brief Completion callback (main-loop context, engine is ready for new commands)
+ * @param ctx User context from the command
+ * @param result Command outcome; the response is still in the engine buffer
+ */
+typedef void (*AT_DoneFn_t)(void *ctx, AT_Result_t result);
+
+/**
+ * @brief Builds and queues command text when the command reaches the wire
+ * @param ctx User context from the command
+ * @param uart Modem UART to write to
+ * @return true if queued, false to retry on the next pass (TX ring full)
+ */
+typedef bool (*AT_SendFn_t)(void *ctx, UART_DMA_Handle_t *uart);
+
+/**
+ * @brief Wake-up gate, asked each pass before a command goes on the wire
+ * @note  The command's timeout runs while it is held
+ * @param ctx Gate context
+ * @return true if the modem can take the command now, false to hold it
+ */
+typedef bool (*AT_WakeFn_t)(void *ctx);
+
+/**
+ * @brief Read source in place of the modem UART's ring
+ * @param ctx Source context
+ * @param buf Receives the bytes
+ * @param len Room in buf
+ * @return Bytes written to buf
+ */
+typedef size_t (*AT_ReadFn_t)(void *ctx, uint8_t *buf, size_t len);
+
+/**
+ * @brief Queued command
+ * @note  data (or whatever send reads) must stay valid until on_done runs.
+ *        With neither data nor send the entry only waits for expected.
+ */
+typedef struct {
+    const uint8_t *data;                /**< Bytes to send (NULL if send or wait-only) */
+    size_t len;                         /**< Length of data */
+    AT_SendFn_t send;                   /**< Dynamic command builder (optional) */
+    const char *expected;               /**< Success line prefix (">" = prompt) */
+    uint32_t timeout_ms;                /**< Response timeout */
+    uint16_t delay_ms;                  /**< Minimum gap after the previous command (retry pacing) */
+    uint8_t flags;                      /**< AT_FLAG_x */
+    AT_DoneFn_t on_done;                /**< Completion callback (optional) */
+    void *ctx;                          /**< Callback / builder context */
+} AT_Cmd_t;
+
+/**
+ * @brief AT engine state
+ */
+typedef struct {
+    UART_DMA_Handle_t *uart;            /**< Modem UART */
+    
+    AT_Cmd_t queue[AT_QUEUE_LEN];       /**< Pending commands, queue[head] is current */
+    uint8_t head;                       /**< Index of current command */
+    uint8_t count;                      /**< Commands queued (including current) */
+    bool sending;                       /**< Current command is trying to get on the wire */
+    bool active;                        /**< Current command sent, waiting for response */
+    uint32_t start_tick;                /**< Send attempt / response wait start */
+    uint32_t done_tick;                 /**< Completion time of the previous command */
+    
+    const AT_Urc_t *urcs;               /**< URC table (optional) */
+    uint8_t urc_count;                  /**< Entries in urcs */
+    AT_LineFn_t line_fn;                /**< Handler for lines no URC entry took (optional) */
+    void *line_ctx;                     /**< URC table / line handler context */
+    AT_RawFn_t raw_fn;                  /**< Receiver of captured bytes */
+    size_t raw_left;                    /**< Bytes still to capture (0 = tokenizing) */
+    AT_WakeFn_t wake_fn;                /**< Wake-up gate (optional) */
+    void *wake_ctx;                     /**< Its context */
+    AT_ReadFn_t read_fn;                /**< Read source (optional) */
+    void *read_ctx;                     /**< Its context */
+    
+    uint32_t wire[AT_WIRE_CLASSES];     /**< Bytes per class (CMD and RESPONSE filled in by AT_Engine_GetWire) */
+    uint32_t tx_base;                   /**< UART bytes sent before AT_Engine_Init */
+    uint32_t rx_total;                  /**< Bytes read */
+    
+    uint8_t rx_buf[AT_RX_BUFFER_SIZE];  /**< Response buffer (NUL at rx_len, stale bytes past it) */
+    size_t rx_len;                      /**< Bytes in rx_buf */
+    size_t line;                        /**< Start of the line being received */
+    size_t scan;                        /**< Bytes already searched for a line end */
+    
+#if AT_TRACE_SIZE > 0
+    uint8_t trace[AT_TRACE_SIZE];       /**< Transcript ring (see file header) */
+    uint16_t trace_head;                /**< Next write position */
+    uint16_t trace_used;                /**< Bytes of whole records held */
+    bool trace_paused;                  /**< Frozen for reading */
+#endif
+} AT_Engine_t;
+
+/**
+ * @brief Initialize engine
+ * @param eng Pointer to engine
+ * @param uart Modem UART (already running)
+ */
+void AT_Engine_Init(AT_Engine_t *eng, UART_DMA_Handle_t *uart);
+
+/**
+ * @brief Set URC table and handler for the remaining lines
+ * @note  A line goes to the first entry whose prefix it starts with, else to fn
+ * @param eng Pointer to engine
+ * @param urcs URC table (static, NULL for none)
+ * @param count Entries in urcs
+ * @param fn Handler for all other lines (NULL to ignore them)
+ * @param ctx Context passed to every handler
+ */
+void AT_Engine_SetLineHandler(AT_Engine_t *eng, const AT_Urc_t *urcs, uint8_t count,
+                              AT_LineFn_t fn, void *ctx);
+
+/**
+ * @brief Set the wake-up gate for commands (not asked for wait-only entries)
+ * @param eng Pointer to engine
+ * @param fn Gate (NULL: commands go out at once)
+ * @param ctx Gate context
+ */
+void AT_Engine_SetWake(AT_Engine_t *eng, AT_WakeFn_t fn, void *ctx);
+
+/**
+ * @brief Set where received bytes come from
+ * @note  Asked whenever the UART has unread bytes; it may take all of them
+ *        and return none (bytes for another channel)
+ * @param eng Pointer to engine
+ * @param fn Source (NULL: the UART's ring)
+ * @param ctx Source context
+ */
+void AT_Engine_SetSource(AT_Engine_t *eng, AT_ReadFn_t fn, void *ctx);
+
+/**
+ * @brief Stream the next count bytes after the current line to fn
+ * @note  Call from a line / URC handler, e.g. on "+XXX: <len>" headers that
+ *        precede binary data. The bytes bypass line splitting and matching.
+ * @param eng Pointer to engine
+ * @param count Number of bytes to capture
+ * @param fn Receiver (gets the handler context)
+ */
+void AT_Engine_Capture(AT_Engine_t *eng, size_t count, AT_RawFn_t fn);
+
+/**
+ * @brief Queue a command (copied, so cmd may be a temporary)
+ * @param eng Pointer to engine
+ * @param cmd Command description
+ * @return true if queued, false if the queue is full
+ */
+bool AT_Engine_Submit(AT_Engine_t *eng, const AT_Cmd_t *cmd);
+
+/**
+ * @brief Service the engine - call every main-loop pass (never blocks)
+ * @param eng Pointer to engine
+ * @return Bytes moved from the modem UART into the response buffer
+ */
+size_t AT_Engine_Process(AT_Engine_t *eng);
+
+/**
+ * @brief Run one command to completion (blocking helper on top of the queue)
+ * @param eng Pointer to engine
+ * @param cmd Command description (data or wait-only; send/on_done/ctx ignored)
+ * @param yield Hook run while waiting (NULL to just sleep)
+ * @param ctx Hook context
+ * @return Command outcome
+ */
+AT_Result_t AT_Engine_Exec(AT_Engine_t *eng, const AT_Cmd_t *cmd,
+                           UART_DMA_YieldFn_t yield, void *ctx);
+
+/**
+ * @brief Number of commands that can still be queued
+ * @param eng Pointer to engine
+ * @return Free queue entries
+ */
+uint8_t AT_Engine_Free(AT_Engine_t *eng);
+
+/**
+ * @brief Check whether no command is queued or in flight
+ * @param eng Pointer to engine
+ * @return true if idle
+ */
+bool AT_Engine_IsIdle(AT_Engine_t *eng);
+
+/**
+ * @brief Discard buffered response / URC text
+ * @param eng Pointer to engine
+ */
+void AT_Engine_ClearRx(AT_Engine_t *eng);
+
+/**
+ * @brief Drop complete lines, keeping a partially received one
+ * @param eng Pointer to engine
+ */
+void AT_Engine_DiscardLines(AT_Engine_t *eng);
+
+/**
+ * @brief Get the bytes on the wire by class since init (free-running)
+ * @param eng Pointer to engine
+ * @param wire Receives AT_WIRE_CLASSES counters
+ */
+void AT_Engine_GetWire(AT_Engine_t *eng, uint32_t wire[AT_WIRE_CLASSES]);
+
+/**
+ * @brief Get all bytes on the wire since init, both ways
+ * @param eng Pointer to engine
+ * @return Bytes sent and received (free-running)
+ */
+uint32_t AT_Engine_WireTotal(AT_Engine_t *eng);
+
+/**
+ * @brief Freeze the transcript and get it oldest record first
+ * @note  Rearranges the ring in place; nothing is recorded until
+ *        AT_Engine_TraceResume, so the data can be sent zero-copy
+ * @param eng Pointer to engine
+ * @param data Receives the first record
+ * @return Bytes of records (0 if AT_TRACE_SIZE is 0)
+ */
+size_t AT_Engine_TraceFreeze(AT_Engine_t *eng, const uint8_t **data);
+
+/**
+ * @brief Record again after AT_Engine_TraceFreeze
+ * @param eng Pointer to engine
+ */
+void AT_Engine_TraceResume(AT_Engine_t *eng);
+
+#endif /* AT_ENGINE_H */
@@ -0,0 +1,91 @@
+/**
+ * @file    bench_gen.h
+ * @brief   Synthetic MAVLink v2 source for on-target throughput runs
+ * @version 1.0
+ *
+ * Built by the bench_bridge Keil target (BENCH_BRIDGE=1). The generator
+ * plays the autopilot: it sends a fixed message mix (BENCH_MIX in
+ * bench_gen.c) out of USART1 at a chosen rate, and the frames come back in
+ * through the USART1 RX DMA, so the real bridge, encoder and modem carry
+ * them. With BENCH_LOOPBACK_EXTERNAL 0 USART1 runs half duplex, where TX
+ * and RX are joined inside the chip. Nothing needs wiring, but the FC
+ * must be unplugged. With 1 a jumper from PA9 to PA10 does the same job.
+ *
+ * Downlink frames (RADIO_STATUS, cloud commands) go out on the same wire,
+ * so they come back as uplink too. Their frames are counted by the bridge
+ * but not by the generator.
+ *
+ * "bench <percent>" on the command topic sets the rate as a percentage of
+ * the mix (0 stops) and starts a new run. The report (status topic, in
+ * turn with the other details) covers the run since then.
+ */
+
+#ifndef BENCH_GEN_H
+#define BENCH_GEN_H
+
+#include "main.h"
+#include "uart_dma.h"
+#include "mavlink_bridge.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef BENCH_BRIDGE
+#define BENCH_BRIDGE                0
+#endif
+
+#ifndef BENCH_LOOPBACK_EXTERNAL
+#define BENCH_LOOPBACK_EXTERNAL     0       /**< 1: PA9-PA10 jumper, 0: USART1 half duplex */
+#endif
+
+#define BENCH_RATE_BOOT             100     /**< Percent of BENCH_MIX from boot */
+#define BENCH_RATE_MAX              2000    /**< 20x the mix is ~14 KB/s, above 115200 baud */
+
+/**
+ * @brief Run figures since the last BenchGen_SetRate
+ */
+typedef struct {
+    uint32_t ms;                    /**< Run length */
+    uint16_t rate;                  /**< Percent of BENCH_MIX */
+    uint32_t gen_frames;            /**< Frames sent to USART1 */
+    uint32_t gen_bytes;
+    uint32_t gen_skipped;           /**< Frames due but not sent - USART1 TX could not keep up */
+    uint32_t fwd_frames;            /**< Frames the bridge forwarded */
+    uint32_t fwd_bytes;
+    uint32_t rx_overrun;            /**< Bytes the RX ring lost before the bridge read them */
+    uint32_t rejected;              /**< Bridge: invalid or unknown frames */
+    uint32_t seq_lost;              /**< Bridge: gaps in the generator's seq */
+    uint32_t rate_dropped;          /**< Bridge: over their uplink limit ("rate" command) */
+    uint32_t deduped;
+    uint32_t publish_lost;
+    uint32_t lat_ms[3];             /**< p50, p90, p99 of the publish latency, bucket upper bounds (ms) */
+} BenchGen_Report_t;
+
+#if BENCH_BRIDGE
+
+/**
+ * @brief Join USART1 TX to RX and start a run at BENCH_RATE_BOOT
+ * @param uart USART1 driver handle (bridge input)
+ */
+void BenchGen_Init(UART_DMA_Handle_t *uart);
+
+/**
+ * @brief Send the frames due by now (call every uplink pass, before the bridge)
+ */
+void BenchGen_Process(void);
+
+/**
+ * @brief Set the rate and start a new run
+ * @param percent Percent of BENCH_MIX, 0 stops
+ * @return false if above BENCH_RATE_MAX
+ */
+bool BenchGen_SetRate(uint16_t percent);
+
+/**
+ * @brief Get the figures of the current run
+ * @param report Filled in
+ */
+void BenchGen_GetReport(BenchGen_Report_t *report);
+
+#endif /* BENCH_BRIDGE */
+
+#endif /* BENCH_GEN_H */
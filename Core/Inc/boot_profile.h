@@ -0,0 +1,63 @@
+/**
+ * @file    boot_profile.h
+ * @brief   Boot-time profile: reset to the first MAVLink frame delivered
+ * @version 1.0
+ *
+ * Each milestone keeps the HAL tick it was first reached at (ms since
+ * reset). The record sits below the supervisor in the RAM kept out of the
+ * linker's IRAM range, so a boot cut short by the watchdog still tells at
+ * the next one how far it got. The app publishes the profile once per boot,
+ * when the first frame is through.
+ */
+
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define BOOT_PROFILE_ADDR       0x20001FA0U     /**< 64 bytes below SUPERVISOR_NOINIT_ADDR, not initialized */
+#define BOOT_PROFILE_STEPS      10              /**< Connect steps (MQTT_CONNECT_STEPS) */
+#define BOOT_PROFILE_UNSET      0xFFFFFFFFU     /**< Milestone not reached */
+
+/**
+ * @brief Milestones, in boot order
+ */
+typedef enum {
+    BOOT_MARK_HAL = 0,          /**< HAL_Init done */
+    BOOT_MARK_POWER,            /**< PWRKEY released - module powering up */
+    BOOT_MARK_RDY,              /**< Module "RDY" */
+    BOOT_MARK_STEP,             /**< + step - 1: end of connect step 1..BOOT_PROFILE_STEPS */
+    BOOT_MARK_SUBACK = BOOT_MARK_STEP + BOOT_PROFILE_STEPS,    /**< Subscriptions acknowledged */
+    BOOT_MARK_FRAME,            /**< First MAVLink publish delivered */
+    BOOT_MARKS
+} BootProfile_Mark_t;
+
+/**
+ * @brief Keep how far the previous boot got and start this one (call right after HAL_Init)
+ */
+void BootProfile_Start(void);
+
+/**
+ * @brief Record a milestone (only its first time counts; any context)
+ * @param mark Milestone
+ */
+void BootProfile_Mark(BootProfile_Mark_t mark);
+
+/**
+ * @brief Get this boot's milestones
+ * @return BOOT_MARKS ticks, BOOT_PROFILE_UNSET where not reached
+ */
+const uint32_t *BootProfile_Get(void);
+
+/**
+ * @brief How far the previous boot got, if it reset before its first frame
+ * @param mark Receives the last milestone it reached
+ * @param ms Receives the tick it reached it at
+ * @return false if it got through (or the record did not survive)
+ */
+bool BootProfile_GetPrevious(BootProfile_Mark_t *mark, uint32_t *ms);
+
+#endif /* BOOT_PROFILE_H */
@@ -0,0 +1,52 @@
+/**
+ * @file    carrier.h
+ * @brief   Carrier profiles: APN, PDP authentication and radio access per home network
+ * @version 1.0
+ *
+ * A flash table keyed by the SIM's home network, the MCC and MNC digits that
+ * open its IMSI. When no APN is configured the MQTT driver reads AT+CIMI
+ * once, takes the profile of that network and keeps the network in the NV
+ * page against the SIM's ICCID; later boots with the same SIM read it back
+ * after AT+CICCID and go to PDP activation without AT+CIMI. A network
+ * missing from the table gets the default profile (A7600_APN, no
+ * authentication, radio access left as the module has it).
+ */
+
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <stdint.h>
+
+/* Configuration */
+#define CARRIER_PLMN_DIGITS     6       /**< IMSI digits kept in the NV page (3-digit MNCs included) */
+
+/**
+ * @brief PDP authentication (AT+CGAUTH <auth_type>)
+ */
+typedef enum {
+    CARRIER_AUTH_NONE = 0,
+    CARRIER_AUTH_PAP,
+    CARRIER_AUTH_CHAP
+} Carrier_Auth_t;
+
+/**
+ * @brief One carrier
+ */
+typedef struct {
+    const char *plmn;           /**< MCC and MNC digits the IMSI starts with, e.g. "45204" */
+    const char *name;           /**< For the log */
+    const char *apn;            /**< PDP context 1 APN */
+    const char *user;           /**< PDP user name (auth only) */
+    const char *pass;           /**< PDP password (auth only) */
+    uint8_t auth;               /**< Carrier_Auth_t */
+    uint8_t rat;                /**< AT+CNMP mode set at selection (2 auto, 38 LTE only, 51 GSM and LTE), 0 = leave */
+} Carrier_Profile_t;
+
+/**
+ * @brief Profile of the network an IMSI belongs to
+ * @param imsi IMSI digits, or at least their first CARRIER_PLMN_DIGITS
+ * @return The matching profile, the default one if none matches (never NULL)
+ */
+const Carrier_Profile_t *Carrier_Find(const char *imsi);
+
+#endif /* CARRIER_H */
@@ -0,0 +1,173 @@
+/**
+ * @file    cmux.h
+ * @brief   GSM 07.10 (3GPP TS 27.010) basic-option multiplexer on the modem UART
+ * @version 1.0
+ *
+ * After AT+CMUX the one physical UART carries frames:
+ *   F9 <address> <control> <length (1-2 bytes)> <information> <FCS> F9
+ * for data link connections (DLCs): DLC 0 for the multiplexer's own control
+ * messages, CMUX_DLC_AT for the AT engine (commands, MQTT data, URCs) and
+ * CMUX_DLC_MON for monitoring queries, so a link-quality sample neither waits
+ * for the AT channel's command in flight nor holds it up.
+ *
+ * TX: the UART's framer (UART_DMA_SetFramer) wraps every write in a UIH
+ * frame of the channel being written, so the driver and the AT engine write
+ * as before. A zero-copy write is sent in frames of CMUX_N1 bytes straight
+ * from the caller's buffer. The wire is first come, first served: a frame
+ * queued behind a long payload waits for it.
+ *
+ * RX: Cmux_Read demultiplexes in place from the DMA ring. AT channel bytes
+ * go to the caller's buffer, other channels to the sink, control frames are
+ * handled here. For UIH frames the FCS covers the header only and comes
+ * after the information, which is handed on as it arrives: a bad FCS is
+ * counted, and the text it carried goes through the line parsers like noise
+ * would in plain mode. Bytes outside any frame are handed to the AT channel
+ * as well: a module that restarted (and left CMUX) is heard saying "RDY".
+ */
+
+#ifndef CMUX_H
+#define CMUX_H
+
+#include "uart_dma.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Configuration */
+#define CMUX_N1             1024    /**< Most information bytes in a frame, both ways (AT+CMUX <N1>) */
+#define CMUX_T1             300     /**< Wait for UA after SABM, ms */
+#define CMUX_N2             3       /**< SABM attempts per DLC */
+#define CMUX_DLC_AT         1       /**< AT engine channel */
+#define CMUX_DLC_MON        2       /**< Monitoring channel */
+#define CMUX_DLCS           3       /**< DLC 0 and the two channels */
+#define CMUX_CTL_MAX        8       /**< Control message bytes kept */
+
+/**
+ * @brief Multiplexer state
+ */
+typedef enum {
+    CMUX_OFF = 0,       /**< Plain AT mode */
+    CMUX_OPENING,       /**< SABM out on a DLC, waiting for its UA */
+    CMUX_OPEN,          /**< All DLCs open */
+    CMUX_FAILED         /**< A DLC refused or never answered (framer off) */
+} Cmux_State_t;
+
+/**
+ * @brief Receiver of a channel other than the AT channel (main loop context)
+ * @param ctx Context given to Cmux_Init
+ * @param dlc Channel
+ * @param data Information bytes (in the DMA ring, valid during the call)
+ * @param len Byte count (a frame may come in several calls)
+ */
+typedef void (*Cmux_SinkFn_t)(void *ctx, uint8_t dlc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Frame counters since Cmux_Init
+ */
+typedef struct {
+    uint32_t frames;                    /**< Frames received whole */
+    uint32_t bad;                       /**< Frames with a bad FCS or no closing flag */
+    uint32_t plain;                     /**< Bytes outside any frame */
+    uint32_t opens;                     /**< Times all DLCs came up */
+} Cmux_Stats_t;
+
+/**
+ * @brief Multiplexer
+ */
+typedef struct {
+    UART_DMA_Handle_t *uart;            /**< Physical link */
+    Cmux_SinkFn_t sink;                 /**< Receiver of the monitoring channel */
+    void *sink_ctx;                     /**< Its context */
+    Cmux_State_t state;
+    uint8_t open;                       /**< Bit per DLC that answered UA */
+    uint8_t opening;                    /**< DLC the SABM is out for */
+    uint8_t tries;                      /**< SABMs sent to it */
+    uint32_t tick;                      /**< Last SABM */
+    uint8_t tx_dlc;                     /**< Channel the framer frames for */
+    
+    /* Deframer */
+    uint8_t rx_state;
+    uint8_t rx_addr;
+    uint8_t rx_ctrl;
+    uint8_t rx_fcs;
+    uint16_t rx_len;                    /**< Information bytes the frame declares */
+    uint16_t rx_left;                   /**< ... still to come */
+    uint8_t ctl[CMUX_CTL_MAX];          /**< DLC 0 information */
+    
+    Cmux_Stats_t stats;
+} Cmux_t;
+
+/**
+ * @brief Set up in plain mode
+ * @param mux Multiplexer
+ * @param uart Modem UART
+ * @param sink Receiver of CMUX_DLC_MON
+ * @param ctx Its context
+ */
+void Cmux_Init(Cmux_t *mux, UART_DMA_Handle_t *uart, Cmux_SinkFn_t sink, void *ctx);
+
+/**
+ * @brief Open the DLCs - the module has just answered OK to AT+CMUX
+ * @note  DLC 0 first, then each channel once the one before answered UA;
+ *        Cmux_Process runs the retries
+ * @param mux Multiplexer
+ */
+void Cmux_Start(Cmux_t *mux);
+
+/**
+ * @brief SABM retries and timeouts - call every main-loop pass
+ * @param mux Multiplexer
+ */
+void Cmux_Process(Cmux_t *mux);
+
+/**
+ * @brief Back to plain mode on our side (the module left CMUX, e.g. restarted)
+ * @param mux Multiplexer
+ */
+void Cmux_Stop(Cmux_t *mux);
+
+/**
+ * @brief Ask the module to leave CMUX (CLD on DLC 0), then Cmux_Stop
+ * @note  Also sent blind: a module still multiplexed from before an MCU
+ *        reset takes it and answers AT again
+ * @param mux Multiplexer
+ */
+void Cmux_Close(Cmux_t *mux);
+
+/**
+ * @brief Check whether all DLCs are open
+ */
+bool Cmux_IsOpen(const Cmux_t *mux);
+
+/**
+ * @brief Get the state
+ */
+Cmux_State_t Cmux_GetState(const Cmux_t *mux);
+
+/**
+ * @brief Queue bytes on a channel (one UIH frame)
+ * @param mux Multiplexer
+ * @param dlc Channel
+ * @param data Bytes (copied into the TX ring)
+ * @param len Byte count
+ * @return true if queued
+ */
+bool Cmux_Write(Cmux_t *mux, uint8_t dlc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Take received AT channel bytes (plain mode: the UART's unread bytes)
+ * @note  Demultiplexes what is in the ring: other channels go to the sink,
+ *        control frames are answered; stops when buf is full
+ * @param mux Multiplexer
+ * @param buf Receives the bytes
+ * @param len Room in buf
+ * @return Bytes written to buf
+ */
+size_t Cmux_Read(Cmux_t *mux, uint8_t *buf, size_t len);
+
+/**
+ * @brief Get the frame counters
+ */
+const Cmux_Stats_t *Cmux_GetStats(const Cmux_t *mux);
+
+#endif /* CMUX_H */
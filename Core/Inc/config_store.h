@@ -0,0 +1,124 @@
+/**
+ * @file    config_store.h
+ * @brief   Runtime configuration: key/value records in two flash pages
+ * @version 1.1
+ *
+ * Two 1 KB pages below the settings page are kept out of the linker's IROM
+ * range. The active page holds <key:16><len:8><crc:8><value, padded to
+ * even> records appended a halfword at a time; the last record of a key
+ * wins, a zero-length one deletes it. When the page is full the live
+ * records are copied to the other page (header sequence + 1, magic written
+ * last) and the old one is erased, so each page is erased once per ~1 KB
+ * of updates. Values are read in place from the memory-mapped page - a
+ * boot load is a scan of one page, no copy. Text is stored with its
+ * terminator so it can be used in place too; a Set may move every value
+ * to the other page, so pointers taken before it must be fetched again.
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Configuration */
+#define CONFIG_STORE_ADDR       0x0800F400U     /**< First of the two pages (nv_store keeps 0x0800FC00) */
+#define CONFIG_STORE_PAGE_SIZE  0x400U
+#define CONFIG_STORE_MAGIC      0x43464731U     /**< "CFG1" - bump when the record layout changes */
+#define CONFIG_VALUE_MAX        64              /**< Longest value, bytes */
+
+/**
+ * @brief Keys (a page holds any mix; unknown keys are kept but ignored)
+ */
+typedef enum {
+    CONFIG_BROKER = 1,          /**< Broker host name (text) */
+    CONFIG_PORT,                /**< Broker port (u32) */
+    CONFIG_USERNAME,            /**< MQTT user name (text) */
+    CONFIG_PASSWORD,            /**< MQTT password (text) */
+    CONFIG_CLIENT_ID,           /**< MQTT client ID (text) */
+    CONFIG_APN,                 /**< PDP context APN (text) */
+    CONFIG_KEEPALIVE,           /**< Keepalive start value, s (u32) */
+    CONFIG_STANDBY,             /**< Standby broker host name, same port and login (text) */
+    CONFIG_BATCH_MIN,           /**< Batching controller: smallest batch budget, bytes (u32) */
+    CONFIG_BATCH_MAX,           /**< ... largest batch budget, bytes (u32) */
+    CONFIG_DEADLINE_MIN,        /**< ... shortest flush deadline, ms (u32) */
+    CONFIG_DEADLINE_MAX,        /**< ... longest flush deadline, ms (u32) */
+    CONFIG_DEVICE_ID,           /**< Device id of the topic namespace, next boot (text, topic_ns.h) */
+    CONFIG_PROFILE_FULL,        /**< Telemetry profile specs, replacing the built-in ones (text, link_profile.h) */
+    CONFIG_PROFILE_REDUCED,
+    CONFIG_PROFILE_MINIMAL,
+    CONFIG_PROFILE_GROUND,
+    CONFIG_PERF_INTERVAL,       /**< Performance record interval, s (u32, metrics.h) */
+    CONFIG_RATE = 0x8000        /**< | MAVLink msgid (< 0x7FFF): uplink limit, Hz (u8) */
+} ConfigStore_Key_t;
+
+/**
+ * @brief Record visitor (ConfigStore_ForEach)
+ * @param key Record key
+ * @param value Value, in flash
+ * @param len Value length
+ * @param ctx Caller context
+ */
+typedef void (*ConfigStore_VisitFn_t)(uint16_t key, const uint8_t *value, uint8_t len, void *ctx);
+
+/**
+ * @brief Pick the active page (call once at boot, before any other function)
+ */
+void ConfigStore_Init(void);
+
+/**
+ * @brief Find the current value of a key
+ * @param key Key
+ * @param len Receives the value length
+ * @return Value in flash, NULL if the key is not set
+ */
+const uint8_t *ConfigStore_Get(uint16_t key, uint8_t *len);
+
+/**
+ * @brief Copy a text value, NUL terminated
+ * @param key Key
+ * @param buf Destination (left untouched if the key is not set or does not fit)
+ * @param size Destination size
+ * @return true if copied
+ */
+bool ConfigStore_GetString(uint16_t key, char *buf, size_t size);
+
+/**
+ * @brief Get a text value in place
+ * @param key Key
+ * @return NUL-terminated text in flash (valid until the next Set), NULL if
+ *         the key is not set or its value has no terminator
+ */
+const char *ConfigStore_GetText(uint16_t key);
+
+/**
+ * @brief Read a u32 value
+ * @param key Key
+ * @param value Destination (left untouched if the key is not set)
+ * @return true if read
+ */
+bool ConfigStore_GetU32(uint16_t key, uint32_t *value);
+
+/**
+ * @brief Visit the current value of every key in a range
+ * @param first First key
+ * @param last Last key
+ * @param fn Visitor
+ * @param ctx Passed to fn
+ */
+void ConfigStore_ForEach(uint16_t first, uint16_t last, ConfigStore_VisitFn_t fn, void *ctx);
+
+/**
+ * @brief Set a key (len 0: delete it)
+ * @note  Blocks for the programming, plus a page erase when the page is
+ *        compacted; unchanged values are not written again
+ * @param key Key (not 0 or 0xFFFF)
+ * @param value Value
+ * @param len Value length, at most CONFIG_VALUE_MAX
+ * @return HAL status of the erase / program
+ */
+HAL_StatusTypeDef ConfigStore_Set(uint16_t key, const void *value, uint8_t len);
+
+#endif /* CONFIG_STORE_H */
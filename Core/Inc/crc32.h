@@ -0,0 +1,64 @@
+/**
+ * @file    crc32.h
+ * @brief   CRC-32 (IEEE, as zlib) on the STM32F0 CRC unit, DMA-fed for large blocks
+ * @version 1.0
+ *
+ * The CRC unit takes the 0x04C11DB7 polynomial a word per AHB write; with
+ * input and output bit-reversed it gives the reflected CRC-32 of zlib and
+ * of the OTA sender. Crc32_Update continues a running value, so a check may
+ * span calls and users may interleave: each call loads the unit from the
+ * value and reads it back. Blocks of CRC32_DMA_MIN bytes or more are fed by
+ * DMA1 channel 1 (memory to memory, taken with MemDma_Claim; the UARTs have
+ * 2-5) while the core waits; shorter ones, and any while a mem_dma.h copy
+ * has the channel, by the core.
+ *
+ * Crc32_Init checks the unit against the software table on a block of
+ * flash and times both (Crc32_Stats_t, in the metrics); a unit that
+ * disagrees is not used. Until then, while another call has the unit (an
+ * interrupt or a thread in between) and in a CRC32_HW=0 build, the nibble
+ * table does the work - same result, ~10x the cycles.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef CRC32_HW
+#define CRC32_HW                1
+#endif
+
+/* Configuration */
+#define CRC32_DMA_MIN           256     /**< Blocks from this size on are fed by DMA */
+#define CRC32_TEST_LEN          1024    /**< Flash bytes checked and timed at init */
+
+/**
+ * @brief Check and timing at init (also read in place by the metrics registry)
+ */
+typedef struct {
+    uint8_t hw;                         /**< CRC unit in use (passed its check) */
+    uint32_t sw_cycles;                 /**< CRC32_TEST_LEN bytes by the table, core cycles */
+    uint32_t hw_cycles;                 /**< ... by the core feeding the unit */
+    uint32_t dma_cycles;                /**< ... by DMA feeding it */
+} Crc32_Stats_t;
+
+extern Crc32_Stats_t crc32_stats;
+
+/**
+ * @brief Enable the CRC unit, check it and time it against the table
+ * @note  After MX_DMA_Init and before the first integrity check that should be fast
+ */
+void Crc32_Init(void);
+
+/**
+ * @brief Continue a CRC-32
+ * @param crc Running value, 0 to start (as zlib's crc32)
+ * @param data Bytes, any alignment
+ * @param len Length
+ * @return The CRC-32 of everything so far
+ */
+uint32_t Crc32_Update(uint32_t crc, const void *data, size_t len);
+
+#endif /* CRC32_H */
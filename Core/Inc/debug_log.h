@@ -1,6 +1,39 @@
 /**
  * @file    debug_log.h
- * @brief   Debug Logging Module using UART1
+ * @brief   Debug Logging Module (RTT memory channel or UART1)
+ * @note    With DEBUG_RTT records go to up channel 0 of an RTT control block
+ *          (_SEGGER_RTT), which a probe reads over SWD while the core runs;
+ *          no UART is involved. Otherwise they go to a RAM ring (readable
+ *          from a debugger as debug_log_ring) and drain through the telemetry
+ *          UART DMA queue when it is idle.
+ *
+ * With DEBUG_TOKENS a LOG_* call formats nothing: it stores a 16-bit token
+ * (LOG_FILE_ID of the calling file, source line) and its arguments as raw
+ * 32-bit words, so the format string is not even linked.
+ * MDK-ARM/log_decode.py rebuilds the string table from the sources and
+ * expands captured records. Record:
+ *
+ *   LOG_SYNC, token (LE16), len, nargs, strmask, args (LE32 x nargs),
+ *   strings (len8 + bytes, one per strmask bit), sum8 of token..strings
+ *
+ * len counts the bytes from nargs to the last string. An argument that
+ * points into RAM is copied too (up to LOG_STR_MAX bytes, bit set in
+ * strmask), as RAM is gone by the time the host decodes; pointers into
+ * flash are looked up in the .axf. Arguments must be 32 bits or narrower,
+ * at most LOG_ARGS_MAX per call, and a file's lines below 4096.
+ *
+ * Each call belongs to a module (LOG_MODULE of the file, or the one given to
+ * LOG_*_M) with its own level, changed at run time with Debug_SetLevelName
+ * ("log" command). LOG_LEVEL_MAX caps the levels at compile time: calls above
+ * it are not compiled. Below it a call costs one load and branch while its
+ * level is off - the arguments are only evaluated when the record is written.
+ *
+ * The RTT block follows SEGGER's layout, so J-Link RTT Viewer, OpenOCD
+ * "rtt" and probe-rs find it by its "SEGGER RTT" id. Records that do not fit
+ * the up buffer are dropped whole (the probe owns the read offset). Down
+ * channel 0 takes "<module|all> <level>" lines for Debug_SetLevelName.
+ * With DEBUG_RTT_CAPTURE up channel 1 ("Capture") carries binary records of
+ * other modules (the AT capture, the metrics registry), apart from the log.
  */
 
 #ifndef DEBUG_LOG_H
@@ -14,8 +47,53 @@
  */
 /* #define DEBUG_ENABLE */   /* Enabled for testing RX flow */
 
+#ifndef DEBUG_TOKENS
+#define DEBUG_TOKENS    1       /* 1: binary tokens for log_decode.py, 0: printf text lines */
+#endif
+
+#ifndef DEBUG_RTT
+#define DEBUG_RTT       1       /* 1: RTT memory channel over SWD, 0: shared USART1 */
+#endif
+
+/* RTT up channel 1 for binary captures (Debug_CaptureWrite), bytes - 0: no
+ * channel. The AT capture build (at_engine.h) and the metrics export (metrics.h) need it */
+#ifndef DEBUG_RTT_CAPTURE
+#if (defined(AT_CAPTURE) && AT_CAPTURE) || (defined(METRICS_RTT) && METRICS_RTT)
+#define DEBUG_RTT_CAPTURE   512
+#else
+#define DEBUG_RTT_CAPTURE   0
+#endif
+#endif
+
+/* Levels - a module logs calls at or below its level */
+#define LOG_LEVEL_OFF       0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3       /* LOG_RAW too */
+
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX       LOG_LEVEL_INFO  /* Compile-time ceiling */
+#endif
+
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT   LOG_LEVEL_WARN  /* Every module at boot; raise with the "log" command */
+#endif
+
+/* Modules - each file that logs defines LOG_MODULE as one of these */
+typedef enum {
+    LOG_MOD_UART = 0,       /* Modem UART setup (baud, flow control) */
+    LOG_MOD_AT,             /* AT command traffic */
+    LOG_MOD_MQTT,           /* Connection, publish and subscribe */
+    LOG_MOD_BRIDGE,         /* MAVLink bridge */
+    LOG_MOD_APP,            /* Application, scheduler, boot */
+    LOG_MOD_COUNT
+} Log_Module_t;
+
 #ifdef DEBUG_ENABLE
     
+    /* Run-time level per module (Log_Module_t) */
+    extern uint8_t debug_log_level[LOG_MOD_COUNT];
+    
     /**
      * @brief Initialize Debug UART (UART1)
      * @return true if successful
@@ -29,21 +107,87 @@
      */
     void Debug_Log(const char *fmt, ...);
     
-    /* Log wrapper macros - easy to expand later with levels/colors if needed */
-    #define LOG_INFO(fmt, ...)  Debug_Log("[INFO] " fmt "\r\n", ##__VA_ARGS__)
-    #define LOG_WARN(fmt, ...)  Debug_Log("[WARN] " fmt "\r\n", ##__VA_ARGS__)
-    #define LOG_ERROR(fmt, ...) Debug_Log("[ERROR] " fmt "\r\n", ##__VA_ARGS__)
-    #define LOG_RAW(fmt, ...)   Debug_Log(fmt, ##__VA_ARGS__)
+    /**
+     * @brief Store a tokenized record (no formatting)
+     * @param token LOG_TOKEN of the call site
+     * @param nargs Argument count
+     * @param ... Arguments, 32 bits or narrower
+     */
+    void Debug_LogT(uint16_t token, uint8_t nargs, ...);
+    
+    /**
+     * @brief Move buffered log lines to the telemetry UART when it is idle
+     *        (RTT: apply level lines from down channel 0)
+     * @note  Call from the main loop (and long waits); never blocks
+     */
+    void Debug_Flush(void);
+    
+    /**
+     * @brief Set module log levels by name
+     * @param args "<uart|at|mqtt|bridge|app|all> <off|error|warn|info>"
+     * @return false if a name is unknown; levels above LOG_LEVEL_MAX are clamped
+     */
+    bool Debug_SetLevelName(const char *args);
+    
+#if DEBUG_RTT && DEBUG_RTT_CAPTURE > 0
+    /**
+     * @brief Append one record to RTT up channel 1, whole or not at all
+     * @param head Record header
+     * @param head_len Header bytes
+     * @param data Record body (may be NULL if len is 0)
+     * @param len Body bytes
+     * @return false if it does not fit (the probe is behind) or Debug_Init has not run
+     */
+    bool Debug_CaptureWrite(const void *head, size_t head_len, const void *data, size_t len);
+#endif
+    
+    /* True when a call of level lvl in module mod is written (constant false above the ceiling) */
+    #define LOG_ON(mod, lvl)    ((lvl) <= LOG_LEVEL_MAX && debug_log_level[(mod)] >= (lvl))
+    
+#if DEBUG_TOKENS
+    #define LOG_SYNC            0xA5    /* First byte of a record */
+    #define LOG_ARGS_MAX        8
+    #define LOG_STR_MAX         40      /* Longest string copied per argument */
+    
+    /* Call site: each file that logs defines LOG_FILE_ID (1..15, unique) */
+    #define LOG_TOKEN           ((uint16_t)(((LOG_FILE_ID) << 12) | (__LINE__ & 0xFFF)))
+    #define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+    #define LOG_NARGS(...)      LOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+    
+    /* The level and the format are the host's: both are found from the token */
+    #define LOG_EMIT_(mod, lvl, tag, fmt, ...) \
+        do { if (LOG_ON(mod, lvl)) Debug_LogT(LOG_TOKEN, LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); } while (0)
+#else
+    #define LOG_EMIT_(mod, lvl, tag, fmt, ...) \
+        do { if (LOG_ON(mod, lvl)) Debug_Log(tag fmt, ##__VA_ARGS__); } while (0)
+#endif
+    
+    /* Log wrapper macros - the _M forms name the module of one call */
+    #define LOG_INFO_M(mod, fmt, ...)  LOG_EMIT_(mod, LOG_LEVEL_INFO, "[INFO] ", fmt "\r\n", ##__VA_ARGS__)
+    #define LOG_WARN_M(mod, fmt, ...)  LOG_EMIT_(mod, LOG_LEVEL_WARN, "[WARN] ", fmt "\r\n", ##__VA_ARGS__)
+    #define LOG_ERROR_M(mod, fmt, ...) LOG_EMIT_(mod, LOG_LEVEL_ERROR, "[ERROR] ", fmt "\r\n", ##__VA_ARGS__)
+    #define LOG_RAW_M(mod, fmt, ...)   LOG_EMIT_(mod, LOG_LEVEL_INFO, "", fmt, ##__VA_ARGS__)
+    #define LOG_INFO(fmt, ...)         LOG_INFO_M(LOG_MODULE, fmt, ##__VA_ARGS__)
+    #define LOG_WARN(fmt, ...)         LOG_WARN_M(LOG_MODULE, fmt, ##__VA_ARGS__)
+    #define LOG_ERROR(fmt, ...)        LOG_ERROR_M(LOG_MODULE, fmt, ##__VA_ARGS__)
+    #define LOG_RAW(fmt, ...)          LOG_RAW_M(LOG_MODULE, fmt, ##__VA_ARGS__)
 
 #else
     /* Empty macros when disabled - code optimizes away */
     #define Debug_Init()        ((void)0)
     #define Debug_Log(fmt, ...) ((void)0)
+    #define Debug_LogT(token, nargs, ...) ((void)0)
+    #define Debug_Flush()       ((void)0)
+    #define Debug_SetLevelName(args) (false)
     
     #define LOG_INFO(fmt, ...)  ((void)0)
     #define LOG_WARN(fmt, ...)  ((void)0)
     #define LOG_ERROR(fmt, ...) ((void)0)
     #define LOG_RAW(fmt, ...)   ((void)0)
+    #define LOG_INFO_M(mod, fmt, ...)  ((void)0)
+    #define LOG_WARN_M(mod, fmt, ...)  ((void)0)
+    #define LOG_ERROR_M(mod, fmt, ...) ((void)0)
+    #define LOG_RAW_M(mod, fmt, ...)   ((void)0)
 
 #endif /* DEBUG_ENABLE */
 
@@ -0,0 +1,84 @@
+/**
+ * @file    echo_probe.h
+ * @brief   Broker round trip from a timestamped publish to a topic we subscribe to
+ * @version 1.0
+ *
+ * The module answers PINGREQ itself and never says how long the broker
+ * took, and QoS 0 batches are reported done at the modem's acceptance: no
+ * publish shows the time to the broker. Every ECHO_INTERVAL one
+ * ECHO_PAYLOAD-byte message <seq LE16><tick LE32> goes out on the bridge's
+ * session to ECHO_TOPIC, which the control session subscribes to; the time
+ * until it comes back (+CMQTTRXSTART) is the round trip through the
+ * broker. About 20 bytes each way a probe, ~120 B a minute.
+ *
+ * A probe is sent with the driver idle, so it waits behind nothing at the
+ * modem; under traffic that never lets up it goes after ECHO_INTERVAL more
+ * anyway, and its sample is only counted (the modem queue is in it). One
+ * probe is out at a time: one not back in ECHO_TIMEOUT is lost, and a late
+ * or foreign echo (another bridge on the broker) is ignored by its seq.
+ *
+ * Idle samples go to the bridge (MavlinkBridge_RttSample) against the least
+ * of the last ECHO_SAMPLES; all of them into the percentiles.
+ */
+
+#ifndef ECHO_PROBE_H
+#define ECHO_PROBE_H
+
+#include "a7600_mqtt.h"
+#include "topic_ns.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef ECHO_ENABLE
+#define ECHO_ENABLE             1
+#endif
+
+/* Configuration */
+#if TOPIC_NS_ENABLE
+#define ECHO_TOPIC              TOPIC_NS(ECHO)
+#else
+#define ECHO_TOPIC              "uav4g/echo"
+#endif
+#define ECHO_PAYLOAD            6       /**< seq, tick */
+#define ECHO_INTERVAL           30000   /**< Between probes, ms */
+#define ECHO_TIMEOUT            10000   /**< A probe not back by then is lost, ms */
+#define ECHO_SAMPLES            16      /**< Round trips the percentiles are taken over */
+
+/**
+ * @brief Round trips (also read in place by the metrics registry)
+ */
+typedef struct {
+    uint16_t last_ms;                   /**< Last round trip (0: none yet) */
+    uint16_t p50_ms;                    /**< Median of the last ECHO_SAMPLES */
+    uint16_t p90_ms;                    /**< 90th percentile of them */
+    uint16_t min_ms;                    /**< Least of them */
+    uint32_t sent;                      /**< Probes published */
+    uint32_t received;                  /**< ... come back in time */
+    uint32_t lost;                      /**< ... not back within ECHO_TIMEOUT */
+} EchoProbe_Stats_t;
+
+extern EchoProbe_Stats_t echo_stats;
+
+#if ECHO_ENABLE
+
+/**
+ * @brief Set up the probe
+ * @param mqtt Driver (probes go out on session 0, the bridge's)
+ */
+void EchoProbe_Init(A7600_MQTT_Handle_t *mqtt);
+
+/**
+ * @brief Send a probe when due, expire the one out
+ * @note  Called before the bridge's pass, so the probe gets an idle driver first
+ */
+void EchoProbe_Process(void);
+
+/**
+ * @brief Route of ECHO_TOPIC (A7600_MQTT_Route)
+ */
+void EchoProbe_OnChunk(const char *topic, const uint8_t *data, size_t len, size_t offset, size_t total);
+
+#endif /* ECHO_ENABLE */
+
+#endif /* ECHO_PROBE_H */
@@ -0,0 +1,162 @@
+/**
+ * @file    link_profile.h
+ * @brief   Telemetry profiles (full / reduced / minimal / ground) switched from the link quality
+ *          and the autopilot's armed state
+ * @version 1.1
+ *
+ * Setting message rates one by one mid-flight does not scale to a fleet.
+ * Built with PROFILE_ENABLE=1, the uplink runs under one of three profiles,
+ * each a spec of uplink limits, batching bounds and encoding. Every
+ * PROFILE_INTERVAL the module grades four readings against two limits
+ * each: the serving cell's RSRP and SINR, the capacity the shaper measured
+ * and the 90th percentile publish latency since the last reading. The worst
+ * grade is the profile wanted; it is taken after PROFILE_DOWN_HOLD readings
+ * in a row ask for less, and the next one up after PROFILE_UP_HOLD readings
+ * in a row allow more - and to allow more, a reading must clear its limit
+ * by the band. A reading not to be had (no LTE, no publishes) is left out.
+ *
+ * Spec: space-separated tokens, applied over the stored settings:
+ *   <msgid>:<hz>      uplink limit (as "rate"; 255 no limit, 0 drop)
+ *   batch=<min>-<max> batch budget bounds, bytes (as cfg bmin / bmax)
+ *   wait=<min>-<max>  flush deadline bounds, ms (as cfg dmin / dmax)
+ *   enc=<name>        encoding (as "enc"); without it, the one at boot
+ * A spec stored with "cfg pfull|pred|pmin <spec>" replaces the built-in one.
+ * Each switch starts from the message table's limits and the stored "cfg
+ * rate" ones, so a "rate" command holds until the next switch only.
+ *
+ * With PROFILE_GROUND_AUTO, a fourth profile takes over while the bridge
+ * reports the autopilot on the ground (MavlinkBridge_Grounded: HEARTBEAT
+ * disarmed and system_status not active) - low rates, full batches, the
+ * longest deadline, and the modem is let sleep by the app. The check runs
+ * every LinkProfile_Process call, not per reading, so the flight profile in
+ * use before comes back within a HEARTBEAT of arming; the readings are not
+ * graded on the ground.
+ *
+ * A switch is announced on the status topic (LinkProfile_Report). "prof
+ * <name>" pins a profile, "prof auto" goes back to switching. Format and
+ * limits: Core/Doc/link_profile.md. RAM: ~80 B.
+ */
+
+#ifndef LINK_PROFILE_H
+#define LINK_PROFILE_H
+
+#include "a7600_mqtt.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE          0
+#endif
+
+/* Configuration */
+#define PROFILE_INTERVAL        5000    /**< Readings taken every, ms */
+#define PROFILE_DOWN_HOLD       2       /**< Readings in a row asking for less before a lower profile */
+#define PROFILE_UP_HOLD         6       /**< ... allowing more before the next one up */
+#define PROFILE_LAT_MIN         4       /**< Publishes in an interval for its latency to count */
+#define PROFILE_GROUND_AUTO     1       /**< Ground profile while the autopilot is on the ground */
+
+/* Limits: a reading under the first asks for reduced, under the second for minimal */
+#define PROFILE_RSRP_REDUCED    (-1050) /**< LTE RSRP, 0.1 dBm */
+#define PROFILE_RSRP_MINIMAL    (-1150)
+#define PROFILE_RSRP_BAND       30
+#define PROFILE_SINR_REDUCED    3       /**< LTE SINR, dB */
+#define PROFILE_SINR_MINIMAL    (-3)
+#define PROFILE_SINR_BAND       3
+#define PROFILE_BPS_REDUCED     3000    /**< Uplink capacity (MavlinkBridge_GetUplinkRate), B/s */
+#define PROFILE_BPS_MINIMAL     800
+#define PROFILE_BPS_BAND        500
+#define PROFILE_LAT_REDUCED     1024    /**< Publish latency, ms, over it (histogram buckets: powers of 2) */
+#define PROFILE_LAT_MINIMAL     4096
+#define PROFILE_LAT_BAND        512
+
+/* Built-in specs (MAVLink common IDs: 1 SYS_STATUS, 24 GPS_RAW_INT, 26/27/105 IMU, 29 SCALED_PRESSURE,
+ * 30/31 ATTITUDE(_QUATERNION), 32 LOCAL_POSITION_NED, 33 GLOBAL_POSITION_INT, 36 SERVO_OUTPUT_RAW,
+ * 62 NAV_CONTROLLER_OUTPUT, 65 RC_CHANNELS, 74 VFR_HUD, 230 ESTIMATOR_STATUS, 241 VIBRATION) */
+#define PROFILE_SPEC_FULL       ""
+#define PROFILE_SPEC_REDUCED    "wait=200-2000 30:4 33:2 74:2 24:1 26:0 27:0 31:0 105:0"
+#define PROFILE_SPEC_MINIMAL    "wait=1000-5000 1:1 24:1 30:1 33:1 74:1 26:0 27:0 29:0 31:0 32:0 36:0 " \
+                                "62:0 65:0 105:0 230:0 241:0"
+#define PROFILE_SPEC_GROUND     "batch=960-960 wait=5000-5000 1:1 24:1 33:1 30:0 74:0 26:0 27:0 29:0 31:0 " \
+                                "32:0 36:0 62:0 65:0 105:0 230:0 241:0"
+
+/**
+ * @brief Profiles, fullest first (the flight ones), then the ground one
+ */
+typedef enum {
+    PROFILE_FULL = 0,
+    PROFILE_REDUCED,
+    PROFILE_MINIMAL,
+    PROFILE_GROUND,                     /**< On the ground (PROFILE_GROUND_AUTO), not graded */
+    PROFILE_COUNT,
+    PROFILE_AUTO = PROFILE_COUNT        /**< LinkProfile_Set: switch on the readings */
+} LinkProfile_t;
+
+/**
+ * @brief Profile state (also read in place by the metrics registry)
+ */
+typedef struct {
+    uint8_t current;                    /**< LinkProfile_t in use */
+    uint8_t pinned;                     /**< Set by command, not switching (0/1) */
+    uint32_t switches;                  /**< Profile changes since boot */
+} LinkProfile_Stats_t;
+
+extern LinkProfile_Stats_t profile_stats;
+
+#if PROFILE_ENABLE
+
+/**
+ * @brief Start in the full profile, switching on the readings
+ * @param mqtt Driver (link quality)
+ * @note  Before the first LinkProfile_Reload; takes the encoding in use as the one specs go back to
+ */
+void LinkProfile_Init(A7600_MQTT_Handle_t *mqtt);
+
+/**
+ * @brief Configured batch bounds (the bridge's own until the first LinkProfile_Reload)
+ * @param base Receives min bytes, max bytes, min ms, max ms
+ */
+void LinkProfile_GetBase(uint16_t base[4]);
+
+/**
+ * @brief Take the configured batch bounds and apply the current profile again
+ * @param base Bounds with the stored ones in (min bytes, max bytes, min ms, max ms), the profile's go over them
+ * @return false if the bounds the result asks for were refused (the base ones are kept then)
+ */
+bool LinkProfile_Reload(const uint16_t base[4]);
+
+/**
+ * @brief Follow the armed state, take the readings when due and switch profiles
+ *        (scheduler task, cheap when not due)
+ */
+void LinkProfile_Process(void);
+
+/**
+ * @brief Pin a profile, or go back to switching on the readings
+ * @param profile LinkProfile_t, or PROFILE_AUTO
+ * @return false if unknown
+ */
+bool LinkProfile_Set(LinkProfile_t profile);
+
+/**
+ * @brief Look a profile up by name ("full", "reduced", "minimal", "ground", "auto")
+ * @return LinkProfile_t, PROFILE_AUTO for "auto", -1 if unknown
+ */
+int LinkProfile_Find(const char *name);
+
+/**
+ * @brief Write the announcement of the last switch, if not yet published
+ * @param buf Receives the JSON text (terminated)
+ * @param size Room in buf
+ * @return Text length, 0 if there is nothing to announce
+ */
+size_t LinkProfile_Report(char *buf, size_t size);
+
+/**
+ * @brief The announcement went out
+ */
+void LinkProfile_Reported(void);
+
+#endif /* PROFILE_ENABLE */
+
+#endif /* LINK_PROFILE_H */
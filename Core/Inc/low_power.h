@@ -0,0 +1,61 @@
+/**
+ * @file    low_power.h
+ * @brief   Idle sleep between events: WFI, tickless when nothing is due soon
+ * @version 1.1
+ *
+ * The core sleeps with WFI whenever no task is runnable. A sleep of two
+ * ticks or more masks the SysTick interrupt and lets TIM14 end it at the
+ * next task deadline instead, so an idle bridge is not woken every
+ * millisecond; any other interrupt (UART IDLE / DMA / character match,
+ * TX complete) ends it early. The HAL tick is advanced by the time slept.
+ * This is Sleep mode - clocks and DMA keep running, no byte is lost.
+ */
+
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define LOW_POWER_TICKLESS      1       /**< 0: plain WFI, woken by every SysTick */
+#define LOW_POWER_MAX_SLEEP     1000    /**< Longest tickless sleep, ms (IWDG runs out after ~5 s) */
+
+/**
+ * @brief Sleep statistics (the share of time asleep stands in for current draw)
+ */
+typedef struct {
+    uint32_t sleeps;        /**< WFI entries */
+    uint32_t tickless;      /**< Of them with SysTick masked */
+    uint32_t slept_ms;      /**< Time asleep */
+    uint32_t slept_cycles;  /**< The same in core cycles (wraps; take differences) */
+} LowPower_Stats_t;
+
+/**
+ * @brief Set up TIM14 as the wake-up timer (10 kHz)
+ */
+void LowPower_Init(void);
+
+/**
+ * @brief Sleep until an interrupt, at most max_ms
+ * @note  Call with interrupts masked, after checking that there is no work:
+ *        an interrupt pending in between still ends the sleep at once, and
+ *        its handler runs once the caller unmasks them (with the tick
+ *        already advanced)
+ * @param max_ms Time to the next due task (0 or 1: until the next tick)
+ */
+void LowPower_Sleep(uint32_t max_ms);
+
+/**
+ * @brief TIM14 interrupt (from TIM14_IRQHandler) - only clears a stray update
+ */
+void LowPower_TimerIRQHandler(void);
+
+/**
+ * @brief Get sleep statistics
+ * @return Statistics since boot
+ */
+const LowPower_Stats_t *LowPower_GetStats(void);
+
+#endif /* LOW_POWER_H */
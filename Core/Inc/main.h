@@ -59,7 +59,29 @@ void Error_Handler(void);
 /* Private defines -----------------------------------------------------------*/
 
 /* USER CODE BEGIN Private defines */
-
+/* Modem UART RTS/CTS (PA1 = USART2_RTS, PA0 = USART2_CTS) - set to 1 when wired */
+#ifndef MODEM_HW_FLOW_CONTROL
+#define MODEM_HW_FLOW_CONTROL   0
+#endif
+/* Modem DTR (PB12 = A7600 DTR) for modem sleep on the ground - set to 1 when wired */
+#ifndef MODEM_SLEEP_DTR
+#define MODEM_SLEEP_DTR         0
+#endif
+#define MODEM_DTR_Pin           GPIO_PIN_12
+#define MODEM_DTR_GPIO_Port     GPIOB
+/* FC RTS (PA12 = USART1_RTS as a GPIO): high from FC_RTS_HIGH unread bytes in the RX ring down to
+ * FC_RTS_LOW, while the bridge sheds frames, and while the outage log is nearly full - set to 1 when wired */
+#ifndef FC_FLOW_RTS
+#define FC_FLOW_RTS             0
+#endif
+#define FC_RTS_Pin              GPIO_PIN_12
+#define FC_RTS_GPIO_Port        GPIOA
+#define FC_RTS_HIGH             640     /* 5/8 of TELEM_UART_RX_BUFFER_SIZE: a half-ring event late still has room */
+#define FC_RTS_LOW              256
+/* FC CTS (PA11 = USART1_CTS): downlink to the FC paused by the USART while the FC holds its RTS - set to 1 when wired */
+#ifndef FC_FLOW_CTS
+#define FC_FLOW_CTS             0
+#endif
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
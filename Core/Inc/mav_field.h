@@ -0,0 +1,36 @@
+/**
+ * @file    mav_field.h
+ * @brief   MAVLink payload field readers for the on-board consumers (anomaly model, summaries)
+ * @version 1.0
+ *
+ * Payloads are little endian and may be unaligned. Float fields are turned
+ * into fixed point from their bits in integer arithmetic, so the firmware
+ * links no soft-float library.
+ */
+
+#ifndef MAV_FIELD_H
+#define MAV_FIELD_H
+
+#include <stdint.h>
+
+/**
+ * @brief Read a uint16_t field
+ * @param p First byte of the field
+ */
+uint16_t MavField_U16(const uint8_t *p);
+
+/**
+ * @brief Read a uint32_t field
+ * @param p First byte of the field
+ */
+uint32_t MavField_U32(const uint8_t *p);
+
+/**
+ * @brief Read a float field in fixed point
+ * @param p First byte of the field
+ * @param frac Fraction bits of the result
+ * @return Value * 2^frac, saturated to +-32767 (NaN and infinities saturate, denormals are 0)
+ */
+int32_t MavField_Fixed(const uint8_t *p, uint8_t frac);
+
+#endif /* MAV_FIELD_H */
@@ -0,0 +1,116 @@
+/**
+ * @file    mav_msgs.h
+ * @brief   MAVLink metadata of the bridged messages - generated by MDK-ARM/mav_gen.py, do not edit
+ *
+ * Dialects: common.xml
+ *
+ * The messages mavlink_bridge.c has a MSG_POLICY_<NAME> for, sorted by ID.
+ * X(name, msgid, crc_extra, min_len, max_len, target): min_len is the
+ * payload of the base fields (exactly a MAVLink 1 frame's), max_len with
+ * the extensions (a MAVLink 2 payload is at most that, trailing zeros
+ * cut); target is the payload offset of target_system, target_component
+ * after it, or MAV_TGT_NONE.
+ *
+ * MAV_MSGS_HASH maps an ID to a slot of MAV_MSGS_SLOTS holding its table
+ * index + 1 (0: none) - collision-free over the IDs below, so a lookup is
+ * one multiply and one compare of the entry's msgid (an ID not in the
+ * table may land on any slot).
+ */
+
+#ifndef MAV_MSGS_H
+#define MAV_MSGS_H
+
+#include <stdint.h>
+
+#define MAV_TGT_NONE            0xFF    /**< Not addressed */
+#define MAV_TGT_SYS_ONLY        0x80    /**< Flag: target_system without a target_component */
+
+#define MAV_MSGS_TABLE(X) \
+    X(HEARTBEAT,                          0,  50,   9,   9, MAV_TGT_NONE) \
+    X(SYS_STATUS,                         1, 124,  31,  43, MAV_TGT_NONE) \
+    X(SYSTEM_TIME,                        2, 137,  12,  12, MAV_TGT_NONE) \
+    X(PING,                               4, 237,  14,  14, 12) \
+    X(SET_MODE,                          11,  89,   6,   6, MAV_TGT_SYS_ONLY | 4) \
+    X(PARAM_REQUEST_READ,                20, 214,  20,  20, 2) \
+    X(PARAM_REQUEST_LIST,                21, 159,   2,   2, 0) \
+    X(PARAM_VALUE,                       22, 220,  25,  25, MAV_TGT_NONE) \
+    X(PARAM_SET,                         23, 168,  23,  23, 4) \
+    X(GPS_RAW_INT,                       24,  24,  30,  52, MAV_TGT_NONE) \
+    X(GPS_STATUS,                        25,  23, 101, 101, MAV_TGT_NONE) \
+    X(SCALED_IMU,                        26, 170,  22,  24, MAV_TGT_NONE) \
+    X(RAW_IMU,                           27, 144,  26,  29, MAV_TGT_NONE) \
+    X(SCALED_PRESSURE,                   29, 115,  14,  16, MAV_TGT_NONE) \
+    X(ATTITUDE,                          30,  39,  28,  28, MAV_TGT_NONE) \
+    X(ATTITUDE_QUATERNION,               31, 246,  32,  48, MAV_TGT_NONE) \
+    X(LOCAL_POSITION_NED,                32, 185,  28,  28, MAV_TGT_NONE) \
+    X(GLOBAL_POSITION_INT,               33, 104,  28,  28, MAV_TGT_NONE) \
+    X(RC_CHANNELS_RAW,                   35, 244,  22,  22, MAV_TGT_NONE) \
+    X(SERVO_OUTPUT_RAW,                  36, 222,  21,  37, MAV_TGT_NONE) \
+    X(MISSION_REQUEST_PARTIAL_LIST,      37, 212,   6,   7, 4) \
+    X(MISSION_WRITE_PARTIAL_LIST,        38,   9,   6,   7, 4) \
+    X(MISSION_ITEM,                      39, 254,  37,  38, 32) \
+    X(MISSION_REQUEST,                   40, 230,   4,   5, 2) \
+    X(MISSION_SET_CURRENT,               41,  28,   4,   4, 2) \
+    X(MISSION_CURRENT,                   42,  28,   2,  18, MAV_TGT_NONE) \
+    X(MISSION_REQUEST_LIST,              43, 132,   2,   3, 0) \
+    X(MISSION_COUNT,                     44, 221,   4,   9, 2) \
+    X(MISSION_CLEAR_ALL,                 45, 232,   2,   3, 0) \
+    X(MISSION_ITEM_REACHED,              46,  11,   2,   2, MAV_TGT_NONE) \
+    X(MISSION_ACK,                       47, 153,   3,   8, 0) \
+    X(SET_GPS_GLOBAL_ORIGIN,             48,  41,  13,  21, MAV_TGT_SYS_ONLY | 12) \
+    X(GPS_GLOBAL_ORIGIN,                 49,  39,  12,  20, MAV_TGT_NONE) \
+    X(MISSION_REQUEST_INT,               51, 196,   4,   5, 2) \
+    X(NAV_CONTROLLER_OUTPUT,             62, 183,  26,  26, MAV_TGT_NONE) \
+    X(RC_CHANNELS,                       65, 118,  42,  42, MAV_TGT_NONE) \
+    X(REQUEST_DATA_STREAM,               66, 148,   6,   6, 2) \
+    X(MANUAL_CONTROL,                    69, 243,  11,  30, MAV_TGT_SYS_ONLY | 10) \
+    X(RC_CHANNELS_OVERRIDE,              70, 124,  18,  38, 16) \
+    X(MISSION_ITEM_INT,                  73,  38,  37,  38, 32) \
+    X(VFR_HUD,                           74,  20,  20,  20, MAV_TGT_NONE) \
+    X(COMMAND_INT,                       75, 158,  35,  35, 30) \
+    X(COMMAND_LONG,                      76, 152,  33,  33, 30) \
+    X(COMMAND_ACK,                       77, 143,   3,  10, 8) \
+    X(SET_ATTITUDE_TARGET,               82,  49,  39,  51, 36) \
+    X(SET_POSITION_TARGET_LOCAL_NED,     84, 143,  53,  53, 50) \
+    X(SET_POSITION_TARGET_GLOBAL_INT,    86,   5,  53,  53, 50) \
+    X(POSITION_TARGET_GLOBAL_INT,        87, 150,  51,  51, MAV_TGT_NONE) \
+    X(HIGHRES_IMU,                      105,  93,  62,  63, MAV_TGT_NONE) \
+    X(RADIO_STATUS,                     109, 185,   9,   9, MAV_TGT_NONE) \
+    X(FILE_TRANSFER_PROTOCOL,           110,  84, 254, 254, 1) \
+    X(TIMESYNC,                         111,  34,  16,  18, 16) \
+    X(SCALED_IMU2,                      116,  76,  22,  24, MAV_TGT_NONE) \
+    X(LOG_REQUEST_LIST,                 117, 128,   6,   6, 4) \
+    X(LOG_ENTRY,                        118,  56,  14,  14, MAV_TGT_NONE) \
+    X(LOG_REQUEST_DATA,                 119, 116,  12,  12, 10) \
+    X(LOG_DATA,                         120, 134,  97,  97, MAV_TGT_NONE) \
+    X(LOG_ERASE,                        121, 237,   2,   2, 0) \
+    X(LOG_REQUEST_END,                  122, 203,   2,   2, 0) \
+    X(POWER_STATUS,                     125, 203,   6,   6, MAV_TGT_NONE) \
+    X(BATTERY_STATUS,                   147, 154,  36,  54, MAV_TGT_NONE) \
+    X(AUTOPILOT_VERSION,                148, 178,  60,  78, MAV_TGT_NONE) \
+    X(ESTIMATOR_STATUS,                 230, 163,  42,  42, MAV_TGT_NONE) \
+    X(GPS_RTCM_DATA,                    233,  35, 182, 182, MAV_TGT_NONE) \
+    X(VIBRATION,                        241,  90,  32,  32, MAV_TGT_NONE) \
+    X(HOME_POSITION,                    242, 104,  52,  60, MAV_TGT_NONE) \
+    X(SET_HOME_POSITION,                243,  85,  53,  61, MAV_TGT_SYS_ONLY | 52) \
+    X(EXTENDED_SYS_STATE,               245, 130,   2,   2, MAV_TGT_NONE) \
+    X(STATUSTEXT,                       253,  83,  51,  54, MAV_TGT_NONE) \
+    X(TUNNEL,                           385, 147, 133, 133, 2)
+
+#define MAV_MSGS_COUNT          70
+#define MAV_MSGS_HASH_BITS      7
+#define MAV_MSGS_HASH_MUL       0xDED8BED3U
+#define MAV_MSGS_HASH(msgid)    (((uint32_t)(msgid) * MAV_MSGS_HASH_MUL) >> (32 - MAV_MSGS_HASH_BITS))
+
+#define MAV_MSGS_SLOTS { \
+     1,  0,  9, 44,  0, 30,  0,  0, 38,  0, 22,  0,  0,  0, 15, 46, \
+     0, 70,  0,  8, 43,  0, 29,  0,  0, 59, 21, 63,  0,  0, 69, 14, \
+     0,  0, 68,  7, 42,  0, 28,  0,  0,  0, 58, 20,  0,  0,  0,  0, \
+    45,  0, 34, 49,  6, 41,  0, 27,  0, 37, 57, 19,  0,  4,  0,  0, \
+    13,  0,  0, 67,  0, 40,  0, 26,  0,  5, 36, 56,  0,  0,  0, 52, \
+     0, 12,  0, 33, 66,  0,  0,  0, 25,  0,  0, 55, 18, 48,  3,  0, \
+    51, 11,  0,  0, 32, 65,  0, 60, 24, 64, 62,  0, 54, 17, 47,  2, \
+     0, 50, 10,  0, 31,  0,  0, 39,  0, 23,  0, 61, 35, 53, 16,  0 \
+}
+
+#endif /* MAV_MSGS_H */
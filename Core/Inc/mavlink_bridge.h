@@ -9,9 +9,185 @@
 #include "main.h"
 #include "uart_dma.h"
 #include "a7600_mqtt.h"
+#include "profiler.h"
+#include "telem_summary.h"
+#include "topic_ns.h"
 
+#if TOPIC_NS_ENABLE
+#define BRIDGE_TOPIC_TX     TOPIC_NS(MAVLINK_TX)
+#define BRIDGE_TOPIC_RX     TOPIC_NS(MAVLINK_RX)
+#define BRIDGE_TOPIC_REPLAY TOPIC_NS(MAVLINK_REPLAY)
+#define BRIDGE_TOPIC_TX_SIZE    TOPIC_NS_SIZE(MAVLINK_TX)
+#else
 #define BRIDGE_TOPIC_TX "uav4g/mavlink/tx"  /* Data from UART -> MQTT */
 #define BRIDGE_TOPIC_RX "uav4g/mavlink/rx"  /* Data from MQTT -> UART */
+#define BRIDGE_TOPIC_REPLAY "uav4g/mavlink/replay"  /* Frames stored during an outage, oldest first */
+#define BRIDGE_TOPIC_TX_SIZE    sizeof(BRIDGE_TOPIC_TX)
+#endif
+
+#define BRIDGE_RATE_ALWAYS  255             /* Uplink limit: forward every frame */
+#define BRIDGE_BATCH_MAX    960             /* Largest batch budget, raw frame bytes (base64: 1280 characters) */
+#define BRIDGE_LAT_BUCKETS  14              /* Latency histogram: bucket i < 2^(i+1) ms, last open */
+#define BRIDGE_SUMMARY_TYPE 32800           /* TUNNEL payload_type of summaries (private range) */
+#define BRIDGE_SUMMARY_MIN  250             /* Summary interval bounds, ms */
+#define BRIDGE_SUMMARY_MAX  60000
+#define BRIDGE_PRESENCE_TYPE 32801          /* TUNNEL payload_type of presence records */
+#define BRIDGE_STATUS_TYPE  32802           /* TUNNEL payload_type of status records (MavlinkBridge_CarryStatus) */
+#define BRIDGE_STATUS_MAX   128             /* Status record bytes (the TUNNEL payload[]) */
+#define BRIDGE_STATUS_WAIT  2000            /* A status record no batch took this long is handed back, ms */
+
+/**
+ * @brief Payload encoding of the MAVLink topics (both directions)
+ */
+typedef enum {
+    BRIDGE_ENC_HEX = 0,     /**< "FD1C0000..." (+100%) */
+    BRIDGE_ENC_BASE64,      /**< "/RwAAA..." (+33%) */
+    BRIDGE_ENC_RAW,         /**< Frame bytes as is */
+    BRIDGE_ENC_COUNT
+} MavlinkBridge_Encoding_t;
+
+/**
+ * @brief Uplink priority of a MAVLink source (sysid, compid)
+ */
+typedef enum {
+    BRIDGE_PRIO_NORMAL = 0, /**< Lane per message: critical, datagram stream or batch */
+    BRIDGE_PRIO_BULK,       /**< Batched only - never ahead of other sources' traffic */
+    BRIDGE_PRIO_OFF         /**< Not forwarded (nor kept while offline) */
+} MavlinkBridge_Priority_t;
+
+/**
+ * @brief Uplink loss counters since init - FC leg (seq) vs. inside the bridge
+ */
+typedef struct {
+    uint32_t seq_lost;                      /**< Frames missing from a source's seq (UART / CRC loss) */
+    uint32_t timeouts;                      /**< Partial frames overdue at line rate (resynced past) */
+    uint32_t rate_dropped;                  /**< Frames over their uplink limit */
+    uint32_t route_dropped;                 /**< Frames of sources set to BRIDGE_PRIO_OFF */
+    uint32_t deduped;                       /**< Unchanged frames suppressed */
+    uint32_t publish_lost;                  /**< Frames in publishes the modem reported failed */
+    uint32_t outage_kept;                   /**< Frames stored in the outage log while offline */
+    uint32_t outage_dropped;                /**< Frames lost while offline (not kept, or log error) */
+    uint32_t param_answered;                /**< Parameter requests answered from the cache */
+    uint32_t summarized;                    /**< Frames taken into a summary instead (SUMMARY_ENABLE) */
+    uint32_t shaper_thinned;                /**< Frames of limited messages dropped while the uplink
+                                             *   was over its measured capacity */
+    uint32_t batch_grown;                   /**< Batching controller steps up (BRIDGE_ADAPT) */
+    uint32_t batch_cut;                     /**< ... and halvings */
+    uint32_t bp_rises;                      /**< Congestion level rises (BRIDGE_BACKPRESSURE) */
+    uint32_t bp_thinned;                    /**< Frames of limited messages dropped while congested */
+    uint32_t bp_shed;                       /**< Limited and bulk-priority frames dropped, stream
+                                             *   frames thinned, with the FC ring 70 % full */
+    uint32_t bp_dropped;                    /**< Frames dropped, not held, with the ring about to lap */
+    uint32_t fair_dropped;                  /**< Frames of a source past its share of the round while
+                                             *   congested (BRIDGE_FAIR) */
+    uint32_t xfers;                         /**< Log downloads / FTP sessions seen (BRIDGE_XFER) */
+    uint32_t xfer_frames;                   /**< Their LOG_DATA / FILE_TRANSFER_PROTOCOL frames forwarded */
+    uint32_t xfer_thinned;                  /**< Frames of limited messages dropped while one ran */
+    uint32_t mission_stored;                /**< Mission items taken off the downlink into flash */
+    uint32_t mission_served;                /**< ... sent to the FC from there on its request */
+    uint32_t hb_folded;                     /**< HEARTBEATs counted into a presence record instead */
+    uint32_t packed;                        /**< Frames re-encoded as shorter v2 frames (BRIDGE_V2_PACK) */
+    uint32_t pack_saved;                    /**< ... and the trailing payload zeros cut off them */
+    uint32_t latency[BRIDGE_LAT_BUCKETS];   /**< Delivered publishes by USART1 arrival of their
+                                             *   oldest frame to +CMQTTPUB (datagrams not included) */
+} MavlinkBridge_LinkStats_t;
+
+/* Uplink publishes carry one or more complete frames back to back, encoded
+ * as one text (up to BRIDGE_BATCH_BYTES raw, or BRIDGE_BATCH_DEADLINE after
+ * the first frame). Decoders read the decoded payload as a MAVLink stream.
+ * Critical messages (heartbeat, acks, mission handshake, STATUSTEXT) go in
+ * their own QoS1 publish ahead of the open batch, same topic and format.
+ * With raw encoding a batch whose frames lie back to back at the front of
+ * the USART1 ring is published from the ring itself (BRIDGE_ZC_HOLD bytes
+ * at most); anything else in between and it is copied out as before. */
+
+/* v2 packing (BRIDGE_V2_PACK): a frame whose payload ends in zeros goes up
+ * as MAVLink v2 with those zeros cut (one payload byte stays at least) and
+ * the checksum recomputed with its CRC_EXTRA; v1 frames go up as v2 whether
+ * anything was cut or not. Signed frames go as they came. A v2 decoder
+ * fills the cut bytes back with zeros. Packed frames are copied into the
+ * batch, never sent zero-copy. */
+
+/* With compact headers on ("+hc", MavlinkBridge_SetHeaderPack) the batch
+ * payload is 0x02 then a record per frame: its header relative to the frame
+ * before it (same source, next seq, msgid as a varint), the payload and any
+ * signature; no checksum, the decoder computes it with CRC_EXTRA. Under
+ * "+lz" this is what gets compressed. Format and reference decoder:
+ * Core/Doc/mavlink_uplink_hc.md */
+
+/* With compression on ("+lz") the batch payload (before base64/hex) is 0x01 then an
+ * LZ77 stream, self-contained per publish (plain batches start 0xFD/0xFE):
+ *   0x00-0x7F  c + 1 literal bytes follow
+ *   0x80-0xFF  copy (c & 0x7F) + 3 bytes from <next byte> + 1 back (may overlap)
+ * Reference decoder: Core/Doc/mavlink_uplink_lz.md */
+
+/* Status messages (SYS_STATUS, GPS, battery, ...) whose source and payload
+ * repeat the last one forwarded are dropped until BRIDGE_DEDUP_REFRESH has
+ * passed; timestamps are left out of the comparison. Frames keep the
+ * sender's seq, so the dropped ones show as gaps in it - a GCS
+ * must not read those as link loss, and should hold the last value of a
+ * message for up to the refresh interval. */
+
+/* Stream messages (attitude, position, ...) go as datagrams while the driver
+ * has a datagram path: <seq:2, big-endian><raw MAVLink frame>. A gap in seq
+ * is a lost datagram; nothing is retransmitted. */
+
+/* Log download and FTP (LOG_REQUEST_* / LOG_DATA, FILE_TRANSFER_PROTOCOL)
+ * pass both ways. LOG_DATA or FILE_TRANSFER_PROTOCOL from the FC starts a
+ * transfer: batches fill to the largest budget (deadline BRIDGE_XFER_DEADLINE
+ * at least), the batching controller pauses and limited messages are thinned
+ * to their outage log rate until the FC has sent neither for BRIDGE_XFER_IDLE.
+ * The frames go QoS0 like any batch - the GCS asks again for the gaps. */
+
+/* Mission upload (BRIDGE_MISSION_PROXY): a cloud GCS may send MISSION_COUNT
+ * and all its MISSION_ITEM_INT in one downlink message (or a few) instead
+ * of waiting for each request. The bridge forwards MISSION_COUNT, keeps the
+ * items in flash (MISSION_STORE_MAX) and answers the FC's MISSION_REQUEST_INT
+ * from there, as the GCS. Requests for items it does not hold go up as
+ * usual, and the GCS's answer goes through; the FC's MISSION_ACK goes up
+ * and ends the upload. Format and example: Core/Doc/mission_proxy.md */
+
+/* Sources: the bridge learns every (sysid, compid) on the FC bus. Autopilots
+ * publish on BRIDGE_TOPIC_TX, any other source (companion, gimbal, ...) on
+ * BRIDGE_TOPIC_TX "/<sysid>/<compid>" - ".../tx/#" takes them all. A batch
+ * carries one source's frames; datagrams are shared. Downlink frames whose
+ * target_system / target_component was not heard here are dropped
+ * (broadcasts and untargeted messages pass) from their target bytes alone,
+ * before the CRC, and counted in bridge_dl_foreign. */
+
+/* Summaries (SUMMARY_ENABLE, MavlinkBridge_SetSummary): the autopilot's
+ * ATTITUDE and VFR_HUD are not forwarded; once per interval a TUNNEL frame
+ * (payload_type BRIDGE_SUMMARY_TYPE, from the RADIO_STATUS sender) carries
+ * min / max / mean / RMS of their main fields. Record: Core/Doc/telemetry_summary.md */
+
+/* Presence (BRIDGE_PRESENCE): a HEARTBEAT goes up in its own publish only
+ * when its source's state (mode, armed, status, ...) differs from the last
+ * one forwarded, or is the first since the link came up; the rest are
+ * counted. Once per BRIDGE_PRESENCE_MS, if any came, a TUNNEL frame
+ * (payload_type BRIDGE_PRESENCE_TYPE, from the RADIO_STATUS sender) joins
+ * the autopilot batch with every source heard: its HEARTBEAT payload and
+ * how many came. Record: Core/Doc/heartbeat_presence.md */
+
+/* Status records (MavlinkBridge_CarryStatus): while the autopilot's frames
+ * go up, the application's status snapshot rides in their batch as a TUNNEL
+ * frame (payload_type BRIDGE_STATUS_TYPE, from the RADIO_STATUS sender)
+ * instead of a publish of its own. Record: Core/Doc/status_trailer.md */
+
+/* Time stamps (MavlinkBridge_SetStamps): once the driver has network time
+ * (A7600_MQTT_GetUnixTime), each live batch opens with a SYSTEM_TIME frame from
+ * the RADIO_STATUS sender: wall-clock time and HAL tick of the USART1 arrival
+ * of the batch's first frame. Broker receive time minus it is the FC-to-broker
+ * latency of that frame, the oldest of the batch. Stamped batches are copied,
+ * never sent zero-copy; outage-log and parameter batches are not stamped.
+ * Format: Core/Doc/uplink_timestamp.md */
+
+/* Parameters: the autopilot's first HEARTBEAT makes the bridge request its
+ * list once (answers stay off uplink) and every PARAM_VALUE it sends updates
+ * a flash copy. Once that copy is complete, PARAM_REQUEST_LIST / _READ for
+ * the autopilot are answered from it on the tx topic as the autopilot would
+ * (own seq) and never reach the FC; until then, or for an id not held, they
+ * are forwarded as before. PARAM_SET still goes to the FC, whose PARAM_VALUE
+ * updates the copy. */
 
 /**
  * @brief Initialize Bridge
@@ -22,16 +198,351 @@ void MavlinkBridge_Init(UART_DMA_Handle_t *uart, A7600_MQTT_Handle_t *mqtt);
 
 /**
  * @brief Process Bridge (Call in main loop)
- * Checks UART buffer and sends to MQTT
+ * Checks UART buffer and batches frames into MQTT publishes (one in flight).
+ * Also call it while the link is down: frames are then kept in the outage
+ * log (decimated) and replayed on BRIDGE_TOPIC_REPLAY once connected.
  */
 void MavlinkBridge_Process(void);
 
 /**
- * @brief Handle incoming MQTT data
+ * @brief Service only the FC side of the downlink: queued frames and RADIO_STATUS
+ * @note  MavlinkBridge_Process() does this too; this is the cheap part for
+ *        a caller that runs it more often than the uplink
+ * @return true while frames wait for the FC UART
+ */
+bool MavlinkBridge_Downlink(void);
+
+/**
+ * @brief Service the bridge from inside a blocking driver call (MQTT idle hook)
+ * @note  Parses the FC stream and feeds the downlink queue; as the driver
+ *        cannot publish meanwhile, frames go to the outage log (decimated)
+ *        and are replayed later. Does nothing if a pass is already running.
+ */
+void MavlinkBridge_Idle(void);
+
+/**
+ * @brief Handle a chunk of a BRIDGE_TOPIC_RX message (decoded and forwarded as it arrives)
+ * @note  Routed for BRIDGE_TOPIC_RX (A7600_MQTT_Route), the topic is not checked.
+ *        Downlink messages carry one or more frames back to back, as uplink
+ *        batches do. Each is checked (length, ID, CRC) and queued whole
+ *        (BRIDGE_DL_QUEUE bytes) for the FC at line rate; invalid frames, ones
+ *        that do not fit and ones cut off by the end of the message are dropped,
+ *        as are repeats of a frame sent within BRIDGE_DL_DEDUP_WINDOW (a QoS 1
+ *        redelivery; counted in bridge_dl_dups).
+ *        Chunks come as the modem hands over payload bytes, before
+ *        +CMQTTRXEND: a frame starts to the FC once it is whole, and frames
+ *        completed while one is on the wire follow from its DMA completion
  * @param topic Topic string
- * @param payload Data
- * @param len Data length
+ * @param data Chunk bytes
+ * @param len Chunk length
+ * @param offset Position of the chunk in the payload
+ * @param total Payload length
  */
-void MavlinkBridge_OnMessage(const char *topic, const uint8_t *payload, size_t len);
+void MavlinkBridge_OnChunk(const char *topic, const uint8_t *data, size_t len,
+                          size_t offset, size_t total);
+
+/**
+ * @brief Set the uplink limit of a message
+ * @param msgid MAVLink message ID (must be one the bridge forwards)
+ * @param hz Frames per second at most, 0 to drop, BRIDGE_RATE_ALWAYS for no limit
+ * @return true if the message is known
+ */
+bool MavlinkBridge_SetRate(uint32_t msgid, uint8_t hz);
+
+/**
+ * @brief Put every uplink limit back to the message table's
+ */
+void MavlinkBridge_ResetRates(void);
+
+/**
+ * @brief Set the uplink priority of a source (kept in the source table before it is heard)
+ * @param sysid MAVLink system ID (not 0)
+ * @param compid MAVLink component ID
+ * @param prio Priority
+ * @return true if set
+ */
+bool MavlinkBridge_SetSourcePriority(uint8_t sysid, uint8_t compid, MavlinkBridge_Priority_t prio);
+
+/**
+ * @brief Set the share of a source while the uplink is congested (kept in the source table before it is heard)
+ * @note  Deficit round robin under the critical lane: each round a source
+ *        may send its quantum of frame bytes, so sources sending at once
+ *        share the uplink in proportion to their quanta
+ * @param sysid MAVLink system ID (not 0)
+ * @param compid MAVLink component ID
+ * @param quantum Bytes per round, 0 for the default (BRIDGE_FAIR_QUANTUM)
+ * @return true if set (false if BRIDGE_FAIR is not built in)
+ */
+bool MavlinkBridge_SetSourceShare(uint8_t sysid, uint8_t compid, uint16_t quantum);
+
+/**
+ * @brief Get uplink counters since init
+ * @param frames Receives MAVLink frames published (optional)
+ * @param bytes Receives raw MAVLink bytes in those frames (optional)
+ * @param rejected Receives start bytes dropped for a bad CRC or unknown message (optional)
+ */
+void MavlinkBridge_GetStats(uint32_t *frames, uint32_t *bytes, uint32_t *rejected);
+
+/**
+ * @brief Get uplink loss counters
+ * @note  seq_lost follows BRIDGE_SOURCES (sysid, compid) pairs; frames
+ *        the bridge drops itself are counted by cause, so cellular loss is
+ *        what the cloud sees missing beyond these
+ * @return Counters since MavlinkBridge_Init
+ */
+const MavlinkBridge_LinkStats_t* MavlinkBridge_GetLinkStats(void);
+
+/**
+ * @brief Get the uplink capacity the batch shaper paces publishes to
+ * @return Payload bytes per second, measured from delivered publishes (0: shaper not built in)
+ */
+uint32_t MavlinkBridge_GetUplinkRate(void);
+
+/**
+ * @brief Start the shaper and the batching controller from a measured uplink (connect-time probe)
+ * @note  The shaper takes the capacity plus a quarter as its estimate;
+ *        with BRIDGE_ADAPT the batch budget becomes four times what the link
+ *        carries in the fixed cost of a publish (that cost then takes a fifth
+ *        of each at most) and the deadline that cost, both within the
+ *        controller's bounds. Both go on adapting from there.
+ * @param bps Uplink capacity, payload B/s
+ * @param overhead_ms Fixed cost of a publish
+ */
+void MavlinkBridge_SeedUplink(uint32_t bps, uint16_t overhead_ms);
+
+/**
+ * @brief Broker round trip of a probe sent to an idle driver (echo_probe.h)
+ * @note  QoS 0 batches are reported at the modem's acceptance, so their
+ *        latency never shows queueing past the modem: a round trip over the
+ *        least one by more than the shaper's depth takes a quarter off its
+ *        estimate. With BRIDGE_ADAPT the batching controller takes it as a
+ *        publish to an idle modem (a slow one halves budget and deadline).
+ * @param rtt_ms Round trip
+ * @param base_ms Least of the recent round trips
+ */
+void MavlinkBridge_RttSample(uint16_t rtt_ms, uint16_t base_ms);
+
+/**
+ * @brief Writes a status record
+ * @param buf Receives it (the TUNNEL payload[])
+ * @param size Room in buf (BRIDGE_STATUS_MAX)
+ * @param ctx As handed to MavlinkBridge_CarryStatus
+ * @return Record length
+ */
+typedef size_t (*MavlinkBridge_StatusFn_t)(uint8_t *buf, size_t size, void *ctx);
+
+/**
+ * @brief Where a status record is (MavlinkBridge_CarryStatus)
+ */
+typedef enum {
+    BRIDGE_STATUS_IDLE = 0,                 /**< Not taken: publish it yourself */
+    BRIDGE_STATUS_WAITING,                  /**< Held for the next autopilot batch */
+    BRIDGE_STATUS_CARRIED                   /**< Written into one - the status is out */
+} MavlinkBridge_StatusCarry_t;
+
+/**
+ * @brief Hand a due status record to the next autopilot batch
+ * @note  Called each pass while the status is due. The record is taken while
+ *        the link is up and an autopilot batch is open or was within
+ *        BRIDGE_STATUS_WAIT; fn writes it when a batch has room, at most
+ *        BRIDGE_STATUS_WAIT later. A record no batch took is handed back
+ *        (IDLE) - the telemetry went quiet, the caller publishes it.
+ * @param fn Writes the record
+ * @param ctx Passed to fn
+ * @return BRIDGE_STATUS_CARRIED once after fn ran
+ */
+MavlinkBridge_StatusCarry_t MavlinkBridge_CarryStatus(MavlinkBridge_StatusFn_t fn, void *ctx);
+
+/**
+ * @brief Bridge state carried over a warm reset (retain.h)
+ */
+typedef struct {
+    uint32_t frames;                        /**< MavlinkBridge_GetStats */
+    uint32_t bytes;
+    uint32_t rejected;
+    uint32_t uplink_bps;                    /**< Shaper estimate (0: shaper not built in) */
+    uint32_t fc_baud;                       /**< Rate USART1 was locked at (0: not locked) */
+    uint16_t base_ms;                       /**< Shaper's least publish latency */
+    uint16_t batch_bytes;                   /**< Batch budget and deadline the controller reached */
+    uint16_t batch_ms;
+    MavlinkBridge_LinkStats_t link;
+} MavlinkBridge_State_t;
+
+/* Counters the metrics registry (metrics.h) reads in place - written by the bridge only */
+extern MavlinkBridge_LinkStats_t bridge_link;
+extern uint32_t bridge_rejected;
+extern uint32_t bridge_dl_dups;
+extern uint32_t bridge_dl_foreign;
+extern uint32_t bridge_snapshots;
+
+/**
+ * @brief Take the counters and the control loops' operating point
+ * @param state Receives them
+ */
+void MavlinkBridge_SaveState(MavlinkBridge_State_t *state);
+
+/**
+ * @brief Carry on from a saved state (after MavlinkBridge_Init and the stored settings)
+ * @note  The counters go on from their saved values. The shaper and the
+ *        batching controller start at the saved point, checked against
+ *        their bounds. USART1 is set to the saved rate and has to confirm
+ *        it with valid frames, as after a measurement.
+ * @param state State from MavlinkBridge_SaveState
+ */
+void MavlinkBridge_RestoreState(const MavlinkBridge_State_t *state);
+
+/**
+ * @brief Get the congestion level the bridge sheds frames at
+ * @return 0 none, 1 limited messages thinned, 2 limited and bulk-priority frames
+ *         dropped (RTS high), 3 frames the batch cannot take dropped as well
+ */
+uint8_t MavlinkBridge_GetCongestion(void);
+
+/**
+ * @brief Switch the payload encoding and batch compression
+ * @note  Uplink switches once the open publishes are out, downlink at the
+ *        next message; the cloud side follows what the status topic announces
+ * @param encoding New encoding
+ * @param compress LZ-compress batches (only when built with BRIDGE_COMPRESS)
+ * @return false if the mode is not available
+ */
+bool MavlinkBridge_SetEncoding(MavlinkBridge_Encoding_t encoding, bool compress);
+
+/**
+ * @brief Switch the encoding by name: "hex", "base64" or "raw", "+lz" appended to compress
+ * @param name Mode name
+ * @return false if the name is unknown or the mode not available
+ */
+bool MavlinkBridge_SetEncodingName(const char *name);
+
+/**
+ * @brief Get the encoding in use on uplink
+ * @param compress Receives whether batches are compressed (optional)
+ * @return Encoding name ("hex", "base64" or "raw")
+ */
+const char* MavlinkBridge_GetEncodingName(bool *compress);
+
+/**
+ * @brief Set the uplink batching budget
+ * @note  With BRIDGE_ADAPT this is where the controller goes on from: each
+ *        live batch's publish latency moves it within the bounds
+ *        (MavlinkBridge_SetBatchBounds)
+ * @param bytes Raw frame bytes per publish, at most BRIDGE_BATCH_MAX (doubled while compressing)
+ * @param deadline_ms Publish a batch this long after its first frame at the latest
+ * @return false if out of range
+ */
+bool MavlinkBridge_SetBatching(uint16_t bytes, uint16_t deadline_ms);
+
+/**
+ * @brief Set the range the batching controller keeps the budget and deadline in
+ * @note  Equal bounds pin a value. Applies from the next live batch's publish.
+ * @param min_bytes Smallest budget, at least MAVLINK_MAX_FRAME_LEN
+ * @param max_bytes Largest budget, at most BRIDGE_BATCH_MAX
+ * @param min_ms Shortest deadline
+ * @param max_ms Longest deadline, at most BRIDGE_DEADLINE_MAX
+ * @return false if out of range, or the controller is not built in (BRIDGE_ADAPT)
+ */
+bool MavlinkBridge_SetBatchBounds(uint16_t min_bytes, uint16_t max_bytes, uint16_t min_ms, uint16_t max_ms);
+
+/**
+ * @brief Get the batching controller's range (the fixed budget and deadline without BRIDGE_ADAPT)
+ */
+void MavlinkBridge_GetBatchBounds(uint16_t *min_bytes, uint16_t *max_bytes, uint16_t *min_ms, uint16_t *max_ms);
+
+/**
+ * @brief Get the uplink batching budget
+ * @param bytes Receives raw frame bytes per publish (optional)
+ * @param deadline_ms Receives the batch deadline, ms (optional)
+ */
+void MavlinkBridge_GetBatching(uint16_t *bytes, uint16_t *deadline_ms);
+
+#if SUMMARY_ENABLE
+/**
+ * @brief Send ATTITUDE / VFR_HUD as interval summaries instead of samples
+ * @param interval_ms BRIDGE_SUMMARY_MIN..BRIDGE_SUMMARY_MAX, 0 = forward the samples again
+ * @return false if out of range
+ */
+bool MavlinkBridge_SetSummary(uint16_t interval_ms);
+
+/**
+ * @brief Get the summary interval
+ * @return ms, 0 when off
+ */
+uint16_t MavlinkBridge_GetSummary(void);
+#endif
+
+/**
+ * @brief Open live batches with a time stamp (SYSTEM_TIME frame)
+ * @param on true to stamp from the next batch
+ */
+void MavlinkBridge_SetStamps(bool on);
+
+/**
+ * @brief Check whether live batches are time-stamped
+ */
+bool MavlinkBridge_GetStamps(void);
+
+/**
+ * @brief Send batch frames with compact headers (HC_FLAG format)
+ * @note  Switches with the encoding, once the open publishes are out
+ * @param on true for compact headers
+ * @return false if not built in (BRIDGE_HDR_PACK)
+ */
+bool MavlinkBridge_SetHeaderPack(bool on);
+
+/**
+ * @brief Check whether batches carry compact headers
+ */
+bool MavlinkBridge_GetHeaderPack(void);
+
+/**
+ * @brief Send the state snapshot: the last autopilot frame kept of each slow
+ *        state message (BRIDGE_SNAPSHOT_MSGS), all in the next autopilot batch
+ * @note  Called on each connect, so a GCS has the full picture within one
+ *        publish instead of waiting for 0.2-1 Hz messages
+ * @return false if none is kept yet (or BRIDGE_SNAPSHOT off)
+ */
+bool MavlinkBridge_Snapshot(void);
+
+/**
+ * @brief Check whether the autopilot is on the ground
+ * @note  While it is and the modem sleeps (A7600_MQTT_SetSleep), batches are
+ *        held for up to BRIDGE_GROUND_DEADLINE instead of the batch deadline,
+ *        and the modem is woken MQTT_WAKE_MS ahead of each flush
+ * @return true unless its last HEARTBEAT reported it armed, or its system_status
+ *         active, critical or in an emergency (also true before any is heard)
+ */
+bool MavlinkBridge_Grounded(void);
+
+#if PROFILER_ENABLE
+
+#define BRIDGE_CODEC_MAX    (2 * BRIDGE_ENC_COUNT)  /* Codec benchmark entries: each encoding, plain and "+lz" */
+
+/**
+ * @brief Cost of one encoding over the codec benchmark sample
+ */
+typedef struct {
+    const char *name;                       /**< "hex", "base64" or "raw" */
+    bool compress;                          /**< Through the LZ stage ("+lz", uplink only) */
+    bool ok;                                /**< Decoded back to the sample (false when not decoded) */
+    uint16_t bytes;                         /**< Frame bytes in */
+    uint16_t text;                          /**< Encoded characters out */
+    uint32_t enc_cycles;                    /**< Core cycles to encode the sample, best of a few runs */
+    uint32_t dec_cycles;                    /**< Core cycles to decode it back to frames (0: not decoded) */
+} MavlinkBridge_CodecCost_t;
+
+/**
+ * @brief Time every uplink encoder and downlink decoder over a sample of telemetry frames
+ * @note  Profiler build only. The batch buffer and the downlink queue are
+ *        borrowed, so it runs only while both are idle; takes a few ms of CPU
+ *        (main loop, not from a driver idle hook). New encodings in the codec
+ *        table are measured with no change here
+ * @param cost Receives one entry per encoding
+ * @param max Entries cost takes (BRIDGE_CODEC_MAX for all)
+ * @return Entries filled, 0 if the bridge was busy (try again on a later pass)
+ */
+uint8_t MavlinkBridge_CodecBench(MavlinkBridge_CodecCost_t *cost, uint8_t max);
+
+#endif /* PROFILER_ENABLE */
 
 #endif /* MAVLINK_BRIDGE_H */
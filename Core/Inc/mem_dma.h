@@ -0,0 +1,108 @@
+/**
+ * @file    mem_dma.h
+ * @brief   Memory-to-memory copies and fills on DMA1 channel 1, in the background
+ * @version 1.0
+ *
+ * The bridge moves whole batches inside tx_buf (BRIDGE_OVERLAP) while the
+ * next frames wait to be parsed. MemDma_Move starts such a copy on DMA1
+ * channel 1 and returns: the core goes on with other work and calls
+ * MemDma_Wait before it next touches either buffer. Done is polled from the
+ * channel's TCIF flag, no interrupt. Lengths under MEM_DMA_MIN, a channel
+ * already busy and a destination above an overlapping source (the DMA runs
+ * upwards) are copied by the core before the call returns.
+ *
+ * Words go by word transfers when source and destination share their
+ * alignment (the odd bytes in front by the core, the ones behind kept and
+ * written when done), otherwise every byte is a transfer. Each transfer
+ * shares the bus matrix with the core, so a copy running under the core's
+ * own loads and stores takes longer than its length alone says.
+ *
+ * MemDma_Init times the core's memcpy against starting and completing a
+ * transfer (MemDma_Stats_t, in the metrics): "mdma_cross" is the length
+ * from which the DMA costs the core less, what MEM_DMA_MIN is set from.
+ * crc32.c takes the channel for its feeds with MemDma_Claim. The bench host
+ * build and MEM_DMA_ENABLE=0 copy with the core and leave the channel free.
+ */
+
+#ifndef MEM_DMA_H
+#define MEM_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef MEM_DMA_ENABLE
+#define MEM_DMA_ENABLE          1
+#endif
+
+/* Configuration */
+#define MEM_DMA_MIN             64      /**< Copies from this length on go by DMA (see "mdma_cross") */
+#define MEM_DMA_TEST_LEN        128     /**< Bytes copied and timed at init */
+
+/**
+ * @brief Timing at init and use (also read in place by the metrics registry)
+ */
+typedef struct {
+    uint32_t cpu_cycles;                /**< MEM_DMA_TEST_LEN bytes by memcpy, core cycles */
+    uint32_t start_cycles;              /**< ... the core's part of a DMA copy: start and completion */
+    uint32_t dma_cycles;                /**< ... start to done of the DMA copy */
+    uint16_t cross;                     /**< Length from which a DMA copy costs the core less, bytes */
+    uint32_t moves;                     /**< Copies and fills that went by DMA */
+} MemDma_Stats_t;
+
+extern MemDma_Stats_t mem_dma_stats;
+
+#if MEM_DMA_ENABLE && !defined(BENCH_HOST)
+
+/**
+ * @brief Time the copies (after MX_DMA_Init; the channel works without it)
+ */
+void MemDma_Init(void);
+
+/**
+ * @brief Start copying len bytes from src to dst (memmove semantics)
+ * @note  Neither buffer may be touched until MemDma_Wait; short or upward
+ *        overlapping copies are done before the call returns
+ */
+void MemDma_Move(void *dst, const void *src, size_t len);
+
+/**
+ * @brief Start filling len bytes at dst with value (memset semantics, same rules)
+ */
+void MemDma_Fill(void *dst, uint8_t value, size_t len);
+
+/**
+ * @brief Copy or fill still running
+ */
+bool MemDma_Busy(void);
+
+/**
+ * @brief Let the copy or fill in progress finish (returns at once without one)
+ */
+void MemDma_Wait(void);
+
+/**
+ * @brief Take the channel for a transfer of one's own
+ * @return false while a copy runs or another user has it
+ */
+bool MemDma_Claim(void);
+
+/**
+ * @brief Give the channel back after MemDma_Claim
+ */
+void MemDma_Release(void);
+
+#else
+
+#define MemDma_Init()                   ((void)0)
+#define MemDma_Move(dst, src, len)      ((void)memmove((dst), (src), (len)))
+#define MemDma_Fill(dst, value, len)    ((void)memset((dst), (value), (len)))
+#define MemDma_Busy()                   false
+#define MemDma_Wait()                   ((void)0)
+#define MemDma_Claim()                  true
+#define MemDma_Release()                ((void)0)
+
+#endif /* MEM_DMA_ENABLE */
+
+#endif /* MEM_DMA_H */
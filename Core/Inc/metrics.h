@@ -0,0 +1,232 @@
+/**
+ * @file    metrics.h
+ * @brief   Static metrics registry: counters read in place, one serializer for status and RTT
+ * @version 1.1
+ *
+ * METRICS_TABLE lists every exported counter once: id, name, type and the
+ * address of the variable its module already keeps. The table expands into
+ * an enum of ids and a const descriptor array in flash - nothing registers
+ * at run time and nothing is copied: the serializers read the variables
+ * where they live. A debugger can do the same from metrics_table (name,
+ * address, type), with no target code at all.
+ *
+ * Metrics_Text writes pages of "name":value pairs for the status topic,
+ * Metrics_Binary pages of raw values in table order for the RTT capture
+ * channel (METRICS_RTT). Records there, beside the AT capture's:
+ *   <'M'><len LE16><tick LE32><first id><values, LE, by type>
+ * The host takes names and types from this table (MDK-ARM/metrics_decode.py).
+ *
+ * Metrics_Perf writes the whole registry as one performance record, which
+ * the app publishes on APP_TOPIC_PERF every METRICS_PERF_INTERVAL s (QoS 0,
+ * "cfg perf <s>"):
+ *   <'P'><version><schema LE32><tick LE32><0><values, LE, by type>
+ * The schema is an FNV-1a hash of the table's names, types and value counts,
+ * so the decoder picks the metrics.h the image was built from and a fleet
+ * running several releases decodes into one time series per name. Bump
+ * METRICS_PERF_VERSION when the record layout (not the table) changes.
+ *
+ * A counter with one writer is updated with METRIC_INC / METRIC_ADD /
+ * METRIC_MAX: the read-modify-write cannot be torn by itself, and a reader
+ * in any context sees a whole aligned 32-bit value. A counter written from
+ * both an interrupt and the main loop needs METRIC_ADD_SHARED: Cortex-M0 has
+ * no LDREX/STREX, so its update runs with interrupts masked (three
+ * instructions).
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* RTT export - needs DEBUG_ENABLE and DEBUG_RTT, and a -D so debug_log.h sizes
+ * the capture channel for it (RAM bound: 512 B) */
+#ifndef METRICS_RTT
+#define METRICS_RTT         0
+#endif
+#define METRICS_RTT_TYPE    'M'
+#define METRICS_RTT_INTERVAL 1000   /**< Registry written to the channel every, ms */
+
+/* Performance record on the uplink */
+#ifndef METRICS_PERF
+#define METRICS_PERF        1
+#endif
+#define METRICS_PERF_TYPE   'P'
+#define METRICS_PERF_VERSION 1      /**< Record layout */
+#define METRICS_PERF_INTERVAL 60    /**< Default s between records ("cfg perf <s>") */
+#define METRICS_PERF_HDR    10      /**< Type, version, schema, tick */
+
+/* Value types (bytes on the binary wire: 4, 2, 1, 4 per bucket, 2, 1) */
+#define METRIC_U32          0
+#define METRIC_U16          1
+#define METRIC_U8           2
+#define METRIC_HIST         3       /**< BRIDGE_LAT_BUCKETS uint32_t */
+#define METRIC_I16          4
+#define METRIC_I8           5
+
+/* Single writer: plain read-modify-write */
+#define METRIC_INC(c)       ((c)++)
+#define METRIC_ADD(c, n)    ((c) += (n))
+#define METRIC_MAX(c, v)    do { if ((v) > (c)) { (c) = (v); } } while (0)
+
+/* Writers in more than one context: the update runs with interrupts masked */
+#define METRIC_ADD_SHARED(c, n) do {                \
+        uint32_t primask_ = __get_PRIMASK();        \
+        __disable_irq();                            \
+        (c) += (n);                                 \
+        __set_PRIMASK(primask_);                    \
+    } while (0)
+#define METRIC_INC_SHARED(c) METRIC_ADD_SHARED(c, 1U)
+
+/* X(id, name, type, address) - append only, ids are the binary order */
+#define METRICS_TABLE(X) \
+    X(SIM_ORE,          "sim_ore",      METRIC_U32,  &sim_uart.errors.ore) \
+    X(SIM_FE,           "sim_fe",       METRIC_U32,  &sim_uart.errors.fe) \
+    X(SIM_NE,           "sim_ne",       METRIC_U32,  &sim_uart.errors.ne) \
+    X(SIM_PE,           "sim_pe",       METRIC_U32,  &sim_uart.errors.pe) \
+    X(SIM_DMA,          "sim_dma",      METRIC_U32,  &sim_uart.errors.dma) \
+    X(SIM_RESTARTS,     "sim_restart",  METRIC_U32,  &sim_uart.errors.rx_restarts) \
+    X(SIM_OVERRUNS,     "sim_ovr",      METRIC_U32,  &sim_uart.overrun_events) \
+    X(SIM_OVR_BYTES,    "sim_ovr_b",    METRIC_U32,  &sim_uart.overrun_bytes) \
+    X(FC_ORE,           "fc_ore",       METRIC_U32,  &telem_uart.errors.ore) \
+    X(FC_FE,            "fc_fe",        METRIC_U32,  &telem_uart.errors.fe) \
+    X(FC_NE,            "fc_ne",        METRIC_U32,  &telem_uart.errors.ne) \
+    X(FC_PE,            "fc_pe",        METRIC_U32,  &telem_uart.errors.pe) \
+    X(FC_DMA,           "fc_dma",       METRIC_U32,  &telem_uart.errors.dma) \
+    X(FC_RESTARTS,      "fc_restart",   METRIC_U32,  &telem_uart.errors.rx_restarts) \
+    X(FC_OVERRUNS,      "fc_ovr",       METRIC_U32,  &telem_uart.overrun_events) \
+    X(FC_OVR_BYTES,     "fc_ovr_b",     METRIC_U32,  &telem_uart.overrun_bytes) \
+    X(FC_RTS,           "fc_rts",       METRIC_U32,  &telem_uart.rts_raises) \
+    X(MAV_CRC,          "mav_crc",      METRIC_U32,  &bridge_rejected) \
+    X(MAV_DL_DUPS,      "mav_dl_dup",   METRIC_U32,  &bridge_dl_dups) \
+    X(MAV_SEQ_LOST,     "mav_seq_lost", METRIC_U32,  &bridge_link.seq_lost) \
+    X(MAV_TIMEOUTS,     "mav_timeout",  METRIC_U32,  &bridge_link.timeouts) \
+    X(MAV_RATE_DROP,    "mav_rate_drop", METRIC_U32, &bridge_link.rate_dropped) \
+    X(MAV_ROUTE_DROP,   "mav_route_drop", METRIC_U32, &bridge_link.route_dropped) \
+    X(MAV_DEDUP,        "mav_dedup",    METRIC_U32,  &bridge_link.deduped) \
+    X(MAV_PUB_LOST,     "mav_pub_lost", METRIC_U32,  &bridge_link.publish_lost) \
+    X(MAV_OUT_KEPT,     "mav_out_kept", METRIC_U32,  &bridge_link.outage_kept) \
+    X(MAV_OUT_DROP,     "mav_out_drop", METRIC_U32,  &bridge_link.outage_dropped) \
+    X(MAV_THINNED,      "mav_thinned",  METRIC_U32,  &bridge_link.shaper_thinned) \
+    X(MAV_BP_RISES,     "mav_bp_rise",  METRIC_U32,  &bridge_link.bp_rises) \
+    X(MAV_BP_THINNED,   "mav_bp_thin",  METRIC_U32,  &bridge_link.bp_thinned) \
+    X(MAV_BP_SHED,      "mav_bp_shed",  METRIC_U32,  &bridge_link.bp_shed) \
+    X(MAV_BP_DROP,      "mav_bp_drop",  METRIC_U32,  &bridge_link.bp_dropped) \
+    X(MAV_FAIR_DROP,    "mav_fair_drop", METRIC_U32, &bridge_link.fair_dropped) \
+    X(MAV_LATENCY,      "mav_lat_ms",   METRIC_HIST, bridge_link.latency) \
+    X(PUB_DELIVERED,    "pub_ok",       METRIC_U32,  &app.mqtt.pub_stats.delivered) \
+    X(PUB_FAILED,       "pub_fail",     METRIC_U32,  &app.mqtt.pub_stats.failed) \
+    X(PUB_BYTES,        "pub_bytes",    METRIC_U32,  &app.mqtt.pub_stats.bytes) \
+    X(PUB_LAT_MAX,      "pub_lat_max",  METRIC_U32,  &app.mqtt.pub_stats.latency_ms_max) \
+    X(DATAGRAMS,        "dgram",        METRIC_U32,  &app.mqtt.pub_stats.datagrams) \
+    X(DATAGRAM_ERRORS,  "dgram_err",    METRIC_U32,  &app.mqtt.pub_stats.datagram_errors) \
+    X(CONNECTS,         "connects",     METRIC_U32,  &app.connects) \
+    X(RESETS,           "resets",       METRIC_U32,  &app.resets) \
+    X(CSQ,              "csq",          METRIC_U8,   &app.mqtt.link.csq) \
+    X(CPU_LOAD,         "cpu_pm",       METRIC_U16,  &app.sched.load_pm) \
+    X(RTT_LAST,         "rtt_ms",       METRIC_U16,  &echo_stats.last_ms) \
+    X(RTT_P50,          "rtt_p50",      METRIC_U16,  &echo_stats.p50_ms) \
+    X(RTT_P90,          "rtt_p90",      METRIC_U16,  &echo_stats.p90_ms) \
+    X(RTT_LOST,         "rtt_lost",     METRIC_U32,  &echo_stats.lost) \
+    X(STATUS_CARRIED,   "st_carried",   METRIC_U32,  &app.metrics_carried) \
+    X(STATUS_QUIET,     "st_quiet",     METRIC_U32,  &app.details_quiet) \
+    X(PROFILE,          "profile",      METRIC_U8,   &profile_stats.current) \
+    X(PROFILE_SWITCHES, "prof_sw",      METRIC_U32,  &profile_stats.switches) \
+    X(CRC_HW,           "crc_hw",       METRIC_U8,   &crc32_stats.hw) \
+    X(CRC_SW_CYCLES,    "crc_sw_cyc",   METRIC_U32,  &crc32_stats.sw_cycles) \
+    X(CRC_HW_CYCLES,    "crc_hw_cyc",   METRIC_U32,  &crc32_stats.hw_cycles) \
+    X(CRC_DMA_CYCLES,   "crc_dma_cyc",  METRIC_U32,  &crc32_stats.dma_cycles) \
+    X(MDMA_CPU_CYCLES,  "mdma_cpu_cyc", METRIC_U32,  &mem_dma_stats.cpu_cycles) \
+    X(MDMA_SET_CYCLES,  "mdma_set_cyc", METRIC_U32,  &mem_dma_stats.start_cycles) \
+    X(MDMA_CYCLES,      "mdma_cyc",     METRIC_U32,  &mem_dma_stats.dma_cycles) \
+    X(MDMA_CROSS,       "mdma_cross",   METRIC_U16,  &mem_dma_stats.cross) \
+    X(MDMA_MOVES,       "mdma_moves",   METRIC_U32,  &mem_dma_stats.moves) \
+    X(SNAPSHOTS,        "snapshots",    METRIC_U32,  &bridge_snapshots) \
+    X(MAV_DL_FOREIGN,   "mav_dl_fgn",   METRIC_U32,  &bridge_dl_foreign) \
+    X(CONNECT_MS,       "conn_ms",      METRIC_U32,  &app.mqtt.conn_stats.total_ms) \
+    X(CONNECT_TIER,     "conn_tier",    METRIC_U8,   &app.mqtt.conn_stats.tier) \
+    X(RSRP,             "rsrp",         METRIC_I16,  &app.mqtt.link.rsrp) \
+    X(SINR,             "sinr",         METRIC_I8,   &app.mqtt.link.sinr) \
+    X(WIRE_PAYLOAD,     "wire_pay",     METRIC_U32,  &app.mqtt.wire_stats.payload) \
+    X(WIRE_BYTES,       "wire_b",       METRIC_U32,  &app.mqtt.wire_stats.wire) \
+    X(AT_EFFICIENCY,    "at_eff",       METRIC_U16,  &app.metrics.at_eff_pm) \
+    X(LOOP_MAX,         "loop_us",      METRIC_U32,  &app.metrics.loop_max_us)
+
+#define METRIC_ID(id, name, type, addr)     METRIC_##id,
+
+/**
+ * @brief Metric ids, in table order
+ */
+typedef enum {
+    METRICS_TABLE(METRIC_ID)
+    METRICS_COUNT
+} Metric_Id_t;
+
+/**
+ * @brief Descriptor of one metric (flash)
+ */
+typedef struct {
+    const char *name;
+    const volatile void *addr;          /**< The module's own variable */
+    uint8_t type;                       /**< METRIC_x */
+} Metric_Desc_t;
+
+extern const Metric_Desc_t metrics_table[METRICS_COUNT];
+
+/* Bytes of a metric on the binary wire (BRIDGE_LAT_BUCKETS from mavlink_bridge.h where used) */
+#define METRIC_SIZE(type)   (((type) == METRIC_U16 || (type) == METRIC_I16) ? 2U :     \
+                             ((type) == METRIC_U8 || (type) == METRIC_I8) ? 1U :       \
+                             ((type) == METRIC_HIST) ? 4U * BRIDGE_LAT_BUCKETS : 4U)
+#define METRIC_BYTES(id, name, type, addr)  + METRIC_SIZE(type)
+
+/** The whole registry as Metrics_Binary writes it: first id and values */
+#define METRICS_BINARY_SIZE (1U METRICS_TABLE(METRIC_BYTES))
+/** Performance record (Metrics_Perf) */
+#define METRICS_PERF_SIZE   (METRICS_PERF_HDR + METRICS_BINARY_SIZE)
+
+/**
+ * @brief Write "name":value pairs from *next on, as many as fit
+ * @param buf Receives the text (not terminated)
+ * @param size Room in buf
+ * @param next Metric to start at; receives the one to continue at (0 after the last)
+ * @return Bytes written (0: not even one pair fits)
+ */
+size_t Metrics_Text(char *buf, size_t size, uint8_t *next);
+
+/**
+ * @brief Write <first id><values> from *next on, as many as fit
+ * @param buf Receives the page
+ * @param size Room in buf
+ * @param next Metric to start at; receives the one to continue at (0 after the last)
+ * @return Bytes written (0: not even one value fits)
+ */
+size_t Metrics_Binary(uint8_t *buf, size_t size, uint8_t *next);
+
+#if METRICS_PERF
+/**
+ * @brief Schema of the registry: FNV-1a of every name (with its terminator), type and value count
+ */
+uint32_t Metrics_Schema(void);
+
+/**
+ * @brief Write the whole registry as one performance record
+ * @param buf Receives the record
+ * @param size Room in buf (METRICS_PERF_SIZE)
+ * @param now HAL tick, stamped into the record
+ * @return Bytes written (0: buf too small)
+ */
+size_t Metrics_Perf(uint8_t *buf, size_t size, uint32_t now);
+#endif
+
+#if METRICS_RTT
+/**
+ * @brief Write the registry to the RTT capture channel every METRICS_RTT_INTERVAL
+ * @note  Pages the probe has no room for are skipped until the next interval
+ * @param now HAL tick
+ */
+void Metrics_Capture(uint32_t now);
+#endif
+
+#endif /* METRICS_H */
@@ -0,0 +1,65 @@
+/**
+ * @file    mission_store.h
+ * @brief   Flash copy of a mission upload, kept for the bridge's local handshake with the FC
+ * @version 1.0
+ *
+ * MISSION_STORE_PAGES 1 KB pages between the parameter cache and the outage
+ * log are kept out of the linker's IROM range. Item seq is stored at record
+ * seq, a 32-byte record of halfwords: the MISSION_ITEM_INT fields the cloud
+ * chose (param1-4, x, y, z, command, frame, current | autocontinue << 1);
+ * seq, targets and mission_type are the upload's. Items may come in any
+ * order; a page is erased when the first item of an upload enters it (CPU
+ * stalls ~20-40 ms). Which items are held is RAM only: a reset or the next
+ * upload empties the copy.
+ */
+
+#ifndef MISSION_STORE_H
+#define MISSION_STORE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define MISSION_STORE_ADDR      0x0800C400U     /**< First page (outage log from 0x0800E000) */
+#define MISSION_STORE_PAGES     7               /**< Store size in 1 KB pages */
+#define MISSION_STORE_PAGE_SIZE 0x400U
+#define MISSION_STORE_RECORD    32              /**< Bytes per stored item */
+#define MISSION_STORE_MAX       (MISSION_STORE_PAGES * (MISSION_STORE_PAGE_SIZE / MISSION_STORE_RECORD))
+#define MISSION_ITEM_INT_LEN    38              /**< MISSION_ITEM_INT payload, extensions included */
+
+/**
+ * @brief Start a new upload: nothing held
+ */
+void MissionStore_Clear(void);
+
+/**
+ * @brief Store an item of the upload
+ * @note  Blocks for the programming (plus a page erase); an item already
+ *        held is not written again
+ * @param seq Item number, below MISSION_STORE_MAX
+ * @param item MISSION_ITEM_INT payload, MISSION_ITEM_INT_LEN bytes (trimmed zeros restored)
+ * @return true if the item is held
+ */
+bool MissionStore_Put(uint16_t seq, const uint8_t *item);
+
+/**
+ * @brief Check whether an item is held
+ */
+bool MissionStore_Has(uint16_t seq);
+
+/**
+ * @brief Read an item back
+ * @param seq Item number
+ * @param item Receives the MISSION_ITEM_INT payload, MISSION_ITEM_INT_LEN bytes
+ *        (seq, targets and mission_type zero: the caller's)
+ * @return true if the item is held
+ */
+bool MissionStore_Get(uint16_t seq, uint8_t *item);
+
+/**
+ * @brief Get the number of items held
+ */
+uint16_t MissionStore_Count(void);
+
+#endif /* MISSION_STORE_H */
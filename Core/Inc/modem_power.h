@@ -0,0 +1,43 @@
+/**
+ * @file    modem_power.h
+ * @brief   Modem power-on pulse, timed by the scheduler instead of a blocking delay
+ * @version 1.0
+ *
+ * MX_GPIO_Init leaves PB11, PC13 and PA15 (the A7600's power lines, PWRKEY
+ * among them) low, which starts the power key pulse. ModemPower_Start, at
+ * the end of MX_GPIO_Init, notes when; the modem task releases the lines
+ * MODEM_PWRKEY_MS later (ModemPower_Process). The DMA, UART, log and app
+ * init run meanwhile instead of after a HAL_Delay, and the app then waits
+ * for the module's RDY / +CPIN URCs as before. After a watchdog or software
+ * reset the module kept running: the lines go high at once, no pulse.
+ */
+
+#ifndef MODEM_POWER_H
+#define MODEM_POWER_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define MODEM_PWRKEY_MS         500     /**< Power lines held low at a cold boot (A7600 PWRKEY: >= 50 ms) */
+
+/**
+ * @brief Start the power key pulse (lines low since MX_GPIO_Init), or release at once
+ * @param warm Module kept running (Supervisor_WarmBoot): no pulse
+ */
+void ModemPower_Start(bool warm);
+
+/**
+ * @brief Release the power lines once the pulse is long enough (cheap when done)
+ * @note  Modem task; marks BOOT_MARK_POWER
+ */
+void ModemPower_Process(void);
+
+/**
+ * @brief Check whether the power lines were released
+ * @return true once the module is powering up
+ */
+bool ModemPower_Released(void);
+
+#endif /* MODEM_POWER_H */
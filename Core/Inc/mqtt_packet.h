@@ -0,0 +1,119 @@
+/**
+ * @file    mqtt_packet.h
+ * @brief   MQTT 3.1.1 packet encoding and streaming decoding on the MCU
+ * @version 1.0
+ *
+ * Used by the socket transport of the A7600 driver, where the module only
+ * carries a TLS byte stream and MQTT framing is done here. Encoders write
+ * into caller buffers (out NULL: only compute the length). The decoder takes
+ * the stream in arbitrary chunks and hands PUBLISH topic / payload bytes on
+ * as they arrive, so inbound message size is not limited by RAM.
+ */
+
+#ifndef MQTT_PACKET_H
+#define MQTT_PACKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Control packet types (first byte, flags in the low nibble) */
+#define MQTT_PKT_CONNECT        0x10
+#define MQTT_PKT_CONNACK        0x20
+#define MQTT_PKT_PUBLISH        0x30    /**< | qos << 1 | retain */
+#define MQTT_PKT_PUBACK         0x40
+#define MQTT_PKT_SUBSCRIBE      0x82
+#define MQTT_PKT_SUBACK         0x90
+#define MQTT_PKT_UNSUBSCRIBE    0xA2
+#define MQTT_PKT_UNSUBACK       0xB0
+#define MQTT_PKT_PINGREQ        0xC0
+#define MQTT_PKT_PINGRESP       0xD0
+#define MQTT_PKT_DISCONNECT     0xE0
+
+#define MQTT_PKT_HEADER_MAX     5       /**< Type byte + 4-byte remaining length */
+
+/**
+ * @brief Last Will and Testament: published by the broker if the connection ends without a DISCONNECT
+ */
+typedef struct {
+    const char *topic;                      /**< Topic (NULL: no will) */
+    const char *msg;                        /**< Message text */
+    uint8_t qos;                            /**< QoS the broker publishes it with */
+    bool retain;                            /**< Published retained */
+} MQTT_Will_t;
+
+/**
+ * @brief Decoder callbacks (called from inside MQTT_PacketRx_Feed)
+ */
+typedef struct {
+    /** End of a packet. head: CONNACK flags/rc, PUBACK/SUBACK id (+ first SUBACK rc),
+     *  PUBLISH topic length and packet id (head[2..3]) */
+    void (*packet)(void *ctx, uint8_t type, const uint8_t *head);
+    /** PUBLISH topic bytes */
+    void (*topic)(void *ctx, const uint8_t *data, size_t len);
+    /** PUBLISH payload bytes */
+    void (*payload)(void *ctx, const uint8_t *data, size_t len, size_t offset, size_t total);
+} MQTT_PacketOps_t;
+
+/**
+ * @brief Streaming decoder state (one per connection)
+ */
+typedef struct {
+    uint8_t state;                          /**< Parse state */
+    uint8_t type;                           /**< First byte of the current packet */
+    uint8_t shift;                          /**< Remaining length: bits decoded so far */
+    uint8_t pos;                            /**< Bytes collected into head */
+    uint32_t remaining;                     /**< Packet bytes still to come */
+    uint32_t total;                         /**< PUBLISH payload length */
+    uint16_t topic_left;                    /**< PUBLISH topic bytes still to come */
+    uint8_t head[4];                        /**< Start of the variable header */
+} MQTT_PacketRx_t;
+
+/**
+ * @brief Fixed header: type byte and remaining length
+ * @param out Buffer of MQTT_PKT_HEADER_MAX bytes (NULL: length only)
+ * @param type Packet type and flags
+ * @param remaining Bytes after the fixed header
+ * @return Header length
+ */
+size_t MQTT_Packet_Header(uint8_t *out, uint8_t type, size_t remaining);
+
+/**
+ * @brief Length-prefixed string
+ * @param out Buffer of len + 2 bytes
+ * @return Bytes written
+ */
+size_t MQTT_Packet_String(uint8_t *out, const char *str, size_t len);
+
+/**
+ * @brief CONNECT packet
+ * @param out Buffer (NULL: length only)
+ * @param size Buffer size
+ * @param client_id Client identifier
+ * @param username Username ("" or NULL for none)
+ * @param password Password ("" or NULL for none)
+ * @param keepalive Keepalive in seconds
+ * @param clean_session Discard any previous session
+ * @param will Last will (NULL or no topic: none)
+ * @return Packet length, 0 if it does not fit
+ */
+size_t MQTT_Packet_Connect(uint8_t *out, size_t size, const char *client_id, const char *username,
+                           const char *password, uint16_t keepalive, bool clean_session, const MQTT_Will_t *will);
+
+/**
+ * @brief Reset the decoder (new connection)
+ */
+void MQTT_PacketRx_Init(MQTT_PacketRx_t *rx);
+
+/**
+ * @brief Decode a chunk of the inbound stream
+ * @param rx Decoder state
+ * @param data Stream bytes
+ * @param len Number of bytes
+ * @param ops Callbacks
+ * @param ctx Callback context
+ */
+void MQTT_PacketRx_Feed(MQTT_PacketRx_t *rx, const uint8_t *data, size_t len,
+                        const MQTT_PacketOps_t *ops, void *ctx);
+
+#endif /* MQTT_PACKET_H */
@@ -0,0 +1,94 @@
+/**
+ * @file    nv_store.h
+ * @brief   Settings kept across resets in the last flash page
+ * @version 1.3
+ *
+ * The top 1 KB page of flash is kept out of the linker's IROM range and
+ * holds a small record of learned settings. Reads come straight from the
+ * memory-mapped page; a write erases and reprograms it, stalling the CPU
+ * for one page erase (~20-40 ms), so callers only write values that changed.
+ */
+
+#ifndef NV_STORE_H
+#define NV_STORE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define NV_STORE_ADDR           0x0800FC00U     /**< Last page of the 64 KB part */
+#define NV_STORE_MAGIC          0x4E563034U     /**< "NV04" - bump when the layout changes */
+#define NV_KEEPALIVE_SLOTS      4               /**< Networks remembered (oldest dropped) */
+
+/**
+ * @brief Look up the keepalive learned on a network
+ * @param plmn Network as MCC * 1000 + MNC
+ * @param good Longest keepalive that survived, s (0 = none)
+ * @param bad Shortest keepalive lost to an idle timeout, s (0 = none)
+ * @return true if the network has a record
+ */
+bool NV_Store_GetKeepalive(uint32_t plmn, uint16_t *good, uint16_t *bad);
+
+/**
+ * @brief Save the keepalive learned on a network
+ * @note  Rewrites the page (blocking) unless the record is unchanged
+ * @param plmn Network as MCC * 1000 + MNC
+ * @param good Longest keepalive that survived, s (0 = none)
+ * @param bad Shortest keepalive lost to an idle timeout, s (0 = none)
+ * @return HAL status of the erase / program
+ */
+HAL_StatusTypeDef NV_Store_SetKeepalive(uint32_t plmn, uint16_t good, uint16_t bad);
+
+/**
+ * @brief Look up the last resolved address of a host
+ * @param host_hash Hash of the host name the address belongs to
+ * @param ip Receives the IPv4 address, first octet in the top byte
+ * @return true if an address for that host is stored
+ */
+bool NV_Store_GetHostIp(uint32_t host_hash, uint32_t *ip);
+
+/**
+ * @brief Save the resolved address of a host (one host is kept)
+ * @note  Rewrites the page (blocking) unless the record is unchanged
+ * @param host_hash Hash of the host name
+ * @param ip IPv4 address, first octet in the top byte (0 = forget it)
+ * @return HAL status of the erase / program
+ */
+HAL_StatusTypeDef NV_Store_SetHostIp(uint32_t host_hash, uint32_t ip);
+
+/**
+ * @brief Look up the home network found for a SIM
+ * @param iccid_hash Hash of the SIM's ICCID
+ * @param plmn Receives the first six IMSI digits (MCC, MNC and what follows)
+ * @return true if that SIM has a record
+ */
+bool NV_Store_GetCarrier(uint32_t iccid_hash, uint32_t *plmn);
+
+/**
+ * @brief Save the home network found for a SIM (one SIM is kept)
+ * @note  Rewrites the page (blocking) unless the record is unchanged
+ * @param iccid_hash Hash of the SIM's ICCID
+ * @param plmn First six IMSI digits as a number
+ * @return HAL status of the erase / program
+ */
+HAL_StatusTypeDef NV_Store_SetCarrier(uint32_t iccid_hash, uint32_t plmn);
+
+/**
+ * @brief Look up the network and LTE band of the last full connect
+ * @param plmn Receives the network as MCC * 1000 + MNC
+ * @param band Receives the LTE band number
+ * @return true if a record is stored
+ */
+bool NV_Store_GetCell(uint32_t *plmn, uint8_t *band);
+
+/**
+ * @brief Save the network and LTE band a full connect registered on
+ * @note  Rewrites the page (blocking) unless the record is unchanged
+ * @param plmn Network as MCC * 1000 + MNC
+ * @param band LTE band number
+ * @return HAL status of the erase / program
+ */
+HAL_StatusTypeDef NV_Store_SetCell(uint32_t plmn, uint8_t band);
+
+#endif /* NV_STORE_H */
@@ -0,0 +1,139 @@
+/**
+ * @file    ota.h
+ * @brief   Firmware update over MQTT: image into a flash slot, credit-paced, installed from SRAM
+ * @version 1.0
+ *
+ * "ota <size> <crc32>" on the command topic opens a transfer. The image then
+ * comes on OTA_TOPIC in messages of <offset, u32 little-endian><data>, sent
+ * ahead of the acks: {"ota":"rx","next":N,"win":W} on the response topic
+ * lets the sender have bytes [N, N + W) in flight, in messages as large as
+ * it likes. Data is copied from the chunk callback into a RAM FIFO and
+ * programmed by Ota_Process a few halfwords per pass, so the modem UART is
+ * never held by the flash; each burst is read back from the flash into the
+ * CRC-32 (crc32.h, on the CRC unit).
+ * Data that does not start at N or runs past the credit is dropped, and the
+ * ack repeated every OTA_ACK_REPEAT makes the sender go back to N.
+ *
+ * A page erase stalls the CPU ~20-40 ms: more than the modem RX ring holds
+ * at 921600. A page is erased only when everything granted has been
+ * programmed - the sender is waiting for credit and the line is quiet - and
+ * the credit never reaches past the erased pages.
+ *
+ * "ota apply" with the CRC matched copies the slot over the application
+ * (0x08000000, the image's length rounded up to pages) from a routine in
+ * SRAM with interrupts off, then resets. The copy is not power-fail safe:
+ * power lost during it (~1-2 s) leaves no application, SWD recovers it.
+ *
+ * The slot needs flash above the stores at 0x0800B400-0x0800FFFF (parameter
+ * cache, mission store, outage log, config store, nv_store), i.e. a part with
+ * more than the STM32F030x8's 64 KB: OTA_FLASH_SIZE says what the build's
+ * part has.
+ */
+
+#ifndef OTA_H
+#define OTA_H
+
+#include "main.h"
+#include "topic_ns.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Configuration */
+#ifndef OTA_ENABLE
+#define OTA_ENABLE          0
+#endif
+#ifndef OTA_FLASH_SIZE
+#define OTA_FLASH_SIZE      0x10000U        /**< Flash of the part (STM32F030x8: 64 KB) */
+#endif
+#define OTA_APP_ADDR        0x08000000U     /**< Application, overwritten by the install */
+#define OTA_APP_MAX         0xB400U         /**< Application flash (IROM1 of the scatter file, up to the stores) */
+#ifndef OTA_SLOT_ADDR
+#define OTA_SLOT_ADDR       0x08010000U     /**< Slot: first page above the stores */
+#endif
+#define OTA_PAGE_SIZE       0x400U
+#if TOPIC_NS_ENABLE
+#define OTA_TOPIC           TOPIC_NS(OTA)
+#else
+#define OTA_TOPIC           "uav4g/ota"
+#endif
+#define OTA_FIFO_SIZE       512             /**< Received, not yet programmed (power of two); the most credit given */
+#define OTA_BURST           16              /**< Halfwords programmed per Ota_Process (~53 us each) */
+#define OTA_ACK_REPEAT      1000            /**< Ack repeated while the transfer stands still, ms */
+
+#if OTA_ENABLE && (OTA_SLOT_ADDR < OTA_APP_ADDR + 0x10000U || \
+                   OTA_SLOT_ADDR + OTA_APP_MAX > OTA_APP_ADDR + OTA_FLASH_SIZE)
+#error "OTA slot must lie above the stores, within OTA_FLASH_SIZE (a part with more than 64 KB flash)"
+#endif
+
+/**
+ * @brief Transfer state
+ */
+typedef enum {
+    OTA_IDLE = 0,       /**< No transfer */
+    OTA_RX,             /**< Receiving and programming */
+    OTA_READY,          /**< Image in the slot, CRC matched */
+    OTA_FAILED          /**< CRC mismatch or flash error */
+} Ota_State_t;
+
+/**
+ * @brief Progress, for the ack
+ */
+typedef struct {
+    Ota_State_t state;
+    uint32_t size;                      /**< Image length */
+    uint32_t next;                      /**< Bytes received in order */
+    uint32_t win;                       /**< Bytes the sender may send from next */
+    uint32_t dropped;                   /**< Messages dropped (out of order or over the credit) */
+} Ota_Progress_t;
+
+/**
+ * @brief Open a transfer (a running one is abandoned)
+ * @param size Image length, at most OTA_APP_MAX
+ * @param crc CRC-32 (IEEE, as zlib) of the image
+ * @return true if opened
+ */
+bool Ota_Begin(uint32_t size, uint32_t crc);
+
+/**
+ * @brief Route of OTA_TOPIC (A7600_MQTT_Route, streamed)
+ */
+void Ota_OnChunk(const char *topic, const uint8_t *data, size_t len, size_t offset, size_t total);
+
+/**
+ * @brief Program from the FIFO, erase the next page when the sender is waiting
+ * @return true if work is left for the next pass
+ */
+bool Ota_Process(void);
+
+/**
+ * @brief Check whether the ack should be published now
+ * @note  Credit given, the transfer ended, or OTA_ACK_REPEAT without a change
+ * @param now HAL tick
+ */
+bool Ota_AckDue(uint32_t now);
+
+/**
+ * @brief Get the progress for the ack, marking it sent
+ * @param now HAL tick
+ */
+const Ota_Progress_t *Ota_TakeAck(uint32_t now);
+
+/**
+ * @brief Ask for the install (after the reply to "ota apply" is out)
+ * @return true if the image is ready
+ */
+bool Ota_RequestApply(void);
+
+/**
+ * @brief Check whether the install was asked for
+ */
+bool Ota_ApplyPending(void);
+
+/**
+ * @brief Copy the slot over the application and reset
+ * @note  Does not return when the image is ready
+ */
+void Ota_Install(void);
+
+#endif /* OTA_H */
@@ -0,0 +1,126 @@
+/**
+ * @file    outage_log.h
+ * @brief   Flash ring holding telemetry while the cellular link is down
+ * @version 1.4
+ *
+ * OUTAGE_LOG_PAGES 1 KB pages below the config store are kept out of the
+ * linker's IROM range. Frames are programmed a halfword at a time as
+ * <len:16><frame, padded to even> records that never cross a page, and
+ * read back in place. A page is erased when the writer enters it (CPU
+ * stalls ~20-40 ms, DMA keeps receiving); when the ring is full the oldest
+ * page is given up. The ring starts empty at every boot.
+ *
+ * With OUTAGE_LOG_SPI the ring is on an external SPI NOR chip (spi_nor.h)
+ * instead - megabytes rather than 5 KB. Put only queues the record in
+ * OUTAGE_LOG_SPI_FIFO bytes of RAM; OutageLog_Process programs it a slice
+ * at a time, erases the next 4 KB sector when the writer enters it, and
+ * comes back later whenever the chip is still busy, so nothing waits on
+ * the flash. Sectors start with <magic><seq LE32>, records are
+ *   <len LE16><state><frame><len LE16>
+ * (the trailing length walks the ring backwards) and the last two bytes of
+ * a sector, written as the writer leaves it, hold where its records end.
+ * The backlog starts empty at boot, but the chip keeps what it holds: the
+ * writer goes on after the newest sector, so the last flights stay on it as
+ * a black box until the ring comes round. Replay goes oldest first, or
+ * newest first with OUTAGE_LOG_NEWEST_FIRST (recent state matters most
+ * after a long outage); frames are read into RAM, a batch's worth per pass.
+ *
+ * RAM idle while the link is down can be lent to the queue (OutageLog_Lend):
+ * the bridge hands it the free end of its batch buffer on disconnect, so
+ * frames arriving during a slow sector erase are queued rather than
+ * dropped. OutageLog_Reclaim gives it back once the queue fits its own
+ * OUTAGE_LOG_SPI_FIFO bytes again.
+ */
+
+#ifndef OUTAGE_LOG_H
+#define OUTAGE_LOG_H
+
+#include "main.h"
+#include "uart_dma.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define OUTAGE_LOG_ADDR         0x0800E000U     /**< First page (config_store from 0x0800F400) */
+#define OUTAGE_LOG_PAGES        5               /**< Ring size in 1 KB pages */
+#define OUTAGE_LOG_PAGE_SIZE    0x400U
+
+/* External SPI NOR ring (RAM: the queue plus one frame) */
+#ifndef OUTAGE_LOG_SPI
+#define OUTAGE_LOG_SPI          0
+#endif
+#ifndef OUTAGE_LOG_NEWEST_FIRST
+#define OUTAGE_LOG_NEWEST_FIRST 0               /**< Replay the newest frames first */
+#endif
+#define OUTAGE_LOG_SPI_SIZE     0x200000U       /**< Ring on the chip from address 0 (W25Q16: 2 MB) */
+#define OUTAGE_LOG_SPI_FIFO     384             /**< Records queued for programming (a sector erase long) */
+#define OUTAGE_LOG_SPI_SLICE    64              /**< Bytes programmed a call */
+
+/**
+ * @brief Append a frame (given as up to two pieces)
+ * @note  Blocks for the programming, plus a page erase when a page is entered;
+ *        with OUTAGE_LOG_SPI it is only queued (false: the queue is full)
+ * @param part Frame pieces, part[1].len may be 0
+ * @param len Total frame length
+ * @return true if stored
+ */
+bool OutageLog_Put(const UART_DMA_Span_t part[2], size_t len);
+
+/**
+ * @brief Look at the oldest stored frame (the newest with OUTAGE_LOG_NEWEST_FIRST)
+ * @param frame Receives a pointer into flash, valid until the next Put (with
+ *        OUTAGE_LOG_SPI a RAM copy, valid until the next Peek)
+ * @return Frame length, 0 if the ring is empty (or the chip is busy)
+ */
+size_t OutageLog_Peek(const uint8_t **frame);
+
+/**
+ * @brief Drop the frame OutageLog_Peek returned
+ */
+void OutageLog_Pop(void);
+
+/**
+ * @brief Get the pages holding frames not read yet
+ * @return 0 (empty) to OUTAGE_LOG_PAGES (with OUTAGE_LOG_SPI, the fill of
+ *         the chip's ring in as many parts)
+ */
+uint8_t OutageLog_PagesUsed(void);
+
+/**
+ * @brief Get pages given up because the ring was full
+ * @return Count since boot (with OUTAGE_LOG_SPI, sectors)
+ */
+uint32_t OutageLog_GetOverwrites(void);
+
+#if OUTAGE_LOG_SPI
+/**
+ * @brief Find the chip and the newest sector on it
+ * @note  Reads every sector header once (~10 ms for 2 MB); without a chip
+ *        nothing is stored
+ */
+void OutageLog_Init(void);
+
+/**
+ * @brief Program the queue a slice at a time, one chip command per call
+ * @note  Returns at once while the chip is busy
+ */
+void OutageLog_Process(void);
+
+/**
+ * @brief Queue into buf (len bytes) instead of the own RAM, what is queued moved along
+ * @note  buf is the queue's until OutageLog_Reclaim returns true
+ * @return false without a chip, RAM already lent, or len no larger than the own queue
+ */
+bool OutageLog_Lend(uint8_t *buf, size_t len);
+
+/**
+ * @brief Move the queue back into its own RAM and give up the lent buffer
+ * @return false while more is queued than the own RAM holds (true if nothing is lent)
+ */
+bool OutageLog_Reclaim(void);
+#else
+#define OutageLog_Lend(buf, len)        false
+#define OutageLog_Reclaim()             true
+#endif
+
+#endif /* OUTAGE_LOG_H */
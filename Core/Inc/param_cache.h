@@ -0,0 +1,89 @@
+/**
+ * @file    param_cache.h
+ * @brief   Flash copy of the autopilot's parameters, learned from PARAM_VALUE
+ * @version 1.0
+ *
+ * PARAM_CACHE_PAGES 1 KB pages below the mission store are kept out of the
+ * linker's IROM range. Each parameter is an 18-byte record of halfwords:
+ * <index:12 | type:4><value:32><param_id, 16 characters of 6 bits>, and a
+ * changed value is appended as a new record (the last one wins). Pages are
+ * erased as the writer enters them (CPU stalls ~20-40 ms). The copy starts
+ * empty at every boot and is complete once every index of param_count is in.
+ */
+
+#ifndef PARAM_CACHE_H
+#define PARAM_CACHE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define PARAM_CACHE_ADDR        0x0800B400U     /**< First page (mission store from 0x0800C400) */
+#define PARAM_CACHE_PAGES       4               /**< Cache size in 1 KB pages */
+#define PARAM_CACHE_PAGE_SIZE   0x400U
+#define PARAM_CACHE_RECORD      18              /**< Bytes per stored parameter */
+#define PARAM_CACHE_MAX         (PARAM_CACHE_PAGES * (PARAM_CACHE_PAGE_SIZE / PARAM_CACHE_RECORD))
+#define PARAM_ID_LEN            16
+
+/**
+ * @brief One parameter as PARAM_VALUE carries it
+ */
+typedef struct {
+    uint16_t index;                         /**< param_index */
+    uint8_t type;                           /**< MAV_PARAM_TYPE */
+    uint8_t value[4];                       /**< param_value as sent (little-endian float) */
+    char id[PARAM_ID_LEN];                  /**< param_id, NUL padded (not terminated at 16) */
+} ParamCache_Entry_t;
+
+/**
+ * @brief Store a parameter reported by the autopilot
+ * @note  Blocks for the programming (plus a page erase); unchanged values
+ *        are not written again. A new param_count starts the cache over;
+ *        index 0xFFFF (a change report) is matched by id.
+ * @param report Parameter as the frame gives it
+ * @param count param_count of the frame
+ * @return true if the cache holds the value (false: it cannot be complete)
+ */
+bool ParamCache_Put(const ParamCache_Entry_t *report, uint16_t count);
+
+/**
+ * @brief Check whether every parameter of the autopilot is held
+ * @return true if all param_count indices are stored
+ */
+bool ParamCache_Complete(void);
+
+/**
+ * @brief Get the number of records written (changed values add records)
+ * @return Records since the cache was last started over
+ */
+uint16_t ParamCache_Records(void);
+
+/**
+ * @brief Get the autopilot's param_count
+ * @return Parameter count, 0 until one was learned
+ */
+uint16_t ParamCache_Count(void);
+
+/**
+ * @brief Read a record
+ * @param record Record number, below ParamCache_Records()
+ * @param entry Receives the parameter
+ * @return true if the record exists
+ */
+bool ParamCache_Get(uint16_t record, ParamCache_Entry_t *entry);
+
+/**
+ * @brief Find the latest record of a parameter
+ * @param index param_index, or -1 to look up by id
+ * @param id param_id (16 characters, NUL padded), used when index is -1
+ * @return Record number, or -1 if not held
+ */
+int ParamCache_Find(int index, const char *id);
+
+/**
+ * @brief Drop everything (the next PARAM_VALUE starts over)
+ */
+void ParamCache_Clear(void);
+
+#endif /* PARAM_CACHE_H */
@@ -0,0 +1,95 @@
+/**
+ * @file    profiler.h
+ * @brief   Hot-path profiler: cycles per call at fixed code sites
+ * @version 1.0
+ *
+ * Built with PROFILER_ENABLE=1 (a compiler define); otherwise PROF_BEGIN /
+ * PROF_END expand to nothing and the sites cost no code. A site is timed
+ * with Sched_Cycles - SysTick counts core cycles between HAL ticks, which
+ * gives the cycle count the Cortex-M0's missing DWT would, without taking a
+ * timer - and booked as count / min / max / sum, less the cost of an empty
+ * BEGIN / END pair measured at init. The table is readable from the
+ * debugger (Profiler_Get) and published with the task statistics, which
+ * then start a fresh interval.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "main.h"
+#include <stdint.h>
+
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE     0
+#endif
+
+/**
+ * @brief Profiled sites
+ */
+typedef enum {
+    PROF_BRIDGE_PROCESS = 0,    /**< MavlinkBridge_Process: one uplink pass */
+    PROF_BASE64,                /**< to_base64: one encode call */
+    PROF_UART_READ,             /**< UART_DMA_Read: one ring copy */
+    PROF_ANOMALY,               /**< Anomaly model: one run (ANOMALY_ENABLE) */
+    PROF_UART_ISR,              /**< UART_DMA USART / DMA interrupt: one run (UART_DMA_LL) */
+    PROF_MAV_CRC,               /**< Bridge frame_valid: one X.25 check */
+    PROF_SITES
+} Prof_Site_t;
+
+/**
+ * @brief Cycles spent at one site since the last reset
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min;               /**< UINT32_MAX while count is 0 */
+    uint32_t max;
+    uint32_t sum;               /**< Wraps after ~89 s of profiled time at 48 MHz - reset it sooner */
+} Prof_Stats_t;
+
+#if PROFILER_ENABLE
+
+#include "scheduler.h"
+
+/** Start timing site id (declares a local: once per scope) */
+#define PROF_BEGIN(id)      uint32_t prof_start_##id = Sched_Cycles()
+/** Book the time since PROF_BEGIN(id) */
+#define PROF_END(id)        Profiler_Record((id), Sched_Cycles() - prof_start_##id)
+
+/**
+ * @brief Clear the table and measure the BEGIN / END overhead (call once after the clock is set up)
+ */
+void Profiler_Init(void);
+
+/**
+ * @brief Book one timed run of a site
+ * @param site Site
+ * @param cycles Cycles measured, overhead included
+ */
+void Profiler_Record(Prof_Site_t site, uint32_t cycles);
+
+/**
+ * @brief Get the table
+ * @return PROF_SITES entries
+ */
+const Prof_Stats_t *Profiler_Get(void);
+
+/**
+ * @brief Get a site's name
+ * @param site Site
+ * @return Short name, e.g. "b64"
+ */
+const char *Profiler_SiteName(Prof_Site_t site);
+
+/**
+ * @brief Start a new interval
+ */
+void Profiler_Reset(void);
+
+#else
+
+#define PROF_BEGIN(id)
+#define PROF_END(id)
+
+#endif /* PROFILER_ENABLE */
+
+#endif /* PROFILER_H */
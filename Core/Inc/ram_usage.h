@@ -0,0 +1,42 @@
+/**
+ * @file    ram_usage.h
+ * @brief   RAM budget: static data from the linker, main stack high-water mark
+ * @version 1.0
+ *
+ * The main stack is painted with a pattern at boot; the deepest word that
+ * no longer holds it is the high-water mark, found by a scan from the
+ * bottom (a few hundred loads, done with every metrics publish). Static
+ * RAM is the span of the linker's RW_IRAM1 region less the startup file's
+ * stack and heap. MDK-ARM/ram_report.py breaks the same figure down per
+ * module from the linker map.
+ */
+
+#ifndef RAM_USAGE_H
+#define RAM_USAGE_H
+
+#include "main.h"
+#include <stdint.h>
+
+/* Configuration - keep in step with startup_stm32f030x8.s */
+#define RAM_STACK_SIZE      0x400U      /**< Stack_Size */
+#define RAM_HEAP_SIZE       0x100U      /**< Heap_Size (unused: nothing calls malloc) */
+#define RAM_PAINT           0xC5C5C5C5U /**< Pattern of never-used stack words */
+
+/**
+ * @brief Paint the free part of the main stack (call first thing in main)
+ */
+void RamUsage_Paint(void);
+
+/**
+ * @brief Scan for the main stack high-water mark
+ * @return Deepest stack use since boot, bytes
+ */
+uint32_t RamUsage_StackUsed(void);
+
+/**
+ * @brief Static RAM taken by data and bss
+ * @return Bytes, stack and heap excluded
+ */
+uint32_t RamUsage_Static(void);
+
+#endif /* RAM_USAGE_H */
@@ -0,0 +1,49 @@
+/**
+ * @file    ramfunc.h
+ * @brief   Hot code run from SRAM instead of flash
+ * @version 1.0
+ *
+ * At 48 MHz the flash needs one wait state (FLASH_LATENCY_1); the prefetch
+ * buffer hides it on straight-line code, not on the taken branches of short
+ * loops and ISRs. A function marked RAMFUNC_IF(group) goes into the .ramfunc
+ * section, which MDK-ARM/test_a7600.sct places in RW_IRAM1: the C startup
+ * copies it from flash with the RW data, and armlink puts a long-branch
+ * veneer on calls between flash and SRAM (a few cycles per call). Constant
+ * tables, HAL calls and the vector fetch stay in flash.
+ *
+ * Each group costs its code size in SRAM, listed per function by
+ * MDK-ARM/ram_report.py; the profiler sites of the group give the cycles to
+ * weigh it against (README, Benchmarks). A group off, or RAMFUNC_ENABLE
+ * off, leaves its functions in flash as before. The bench host build has no
+ * such section and ignores the marks.
+ */
+
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+#ifndef RAMFUNC_ENABLE
+#define RAMFUNC_ENABLE      1
+#endif
+
+/* Groups (each 0/1) */
+#ifndef RAMFUNC_UART_ISR
+#define RAMFUNC_UART_ISR    1       /**< UART_DMA USART / DMA handlers and what they call (profiler "uart_isr") */
+#endif
+#ifndef RAMFUNC_MAV_PARSE
+#define RAMFUNC_MAV_PARSE   1       /**< Bridge frame scan and X.25 checksums (profiler "crc") */
+#endif
+#ifndef RAMFUNC_BASE64
+#define RAMFUNC_BASE64      1       /**< Bridge Base64 encode loop (profiler "b64") */
+#endif
+
+#if RAMFUNC_ENABLE && !defined(BENCH_HOST)
+#define RAMFUNC_IF_1        __attribute__((section(".ramfunc")))
+#else
+#define RAMFUNC_IF_1
+#endif
+#define RAMFUNC_IF_0
+#define RAMFUNC_IF_(on)     RAMFUNC_IF_##on
+/** Place the function that follows in SRAM when group is 1 (a group macro, expanded first) */
+#define RAMFUNC_IF(group)   RAMFUNC_IF_(group)
+
+#endif /* RAMFUNC_H */
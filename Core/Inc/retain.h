@@ -0,0 +1,60 @@
+/**
+ * @file    retain.h
+ * @brief   State carried over watchdog and software resets in SRAM the C startup leaves alone
+ * @version 1.0
+ *
+ * Every RETAIN_INTERVAL the app copies the bridge's and the driver's
+ * counters and the operating point of the control loops (uplink shaper,
+ * batching controller, FC rate) to RETAIN_ADDR, below the boot profile in
+ * the RAM kept out of the linker's IRAM range. The copy is framed by a
+ * magic, its length and a CRC-32: a power-on leaves random contents, and a
+ * reset in the middle of a save leaves the magic cleared. After a warm
+ * reset (Supervisor_WarmBoot) a valid copy is handed back, so the loops
+ * start where they had converged and the counters stay monotonic; any
+ * other boot starts from zero.
+ */
+
+#ifndef RETAIN_H
+#define RETAIN_H
+
+#include "main.h"
+#include "a7600_mqtt.h"
+#include "mavlink_bridge.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define RETAIN_ADDR         0x20001EA0U     /**< 256 bytes below BOOT_PROFILE_ADDR, not initialized */
+#define RETAIN_SIZE         0x100U
+#define RETAIN_INTERVAL     1000            /**< Save period, ms (what a reset may lose) */
+
+/**
+ * @brief What a warm reset carries over
+ */
+typedef struct {
+    uint32_t resets;                        /**< Warm resets the state came through */
+    uint32_t connects;                      /**< Successful connects */
+    uint32_t traffic[4];                    /**< UART bytes: FC RX, FC TX, modem TX, modem RX */
+    MQTT_PubStats_t pub;                    /**< Driver's publish counters */
+    MavlinkBridge_State_t bridge;
+} Retain_State_t;
+
+/**
+ * @brief Check the copy the last run left
+ * @param warm Watchdog or software reset (a copy is ignored otherwise)
+ * @return The state, valid until Retain_Open; NULL if there is none
+ */
+const Retain_State_t *Retain_Boot(bool warm);
+
+/**
+ * @brief Start a save: the copy is invalid until Retain_Close
+ * @return The state to fill in
+ */
+Retain_State_t *Retain_Open(void);
+
+/**
+ * @brief End a save: seal the copy
+ */
+void Retain_Close(void);
+
+#endif /* RETAIN_H */
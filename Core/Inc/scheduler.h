@@ -0,0 +1,169 @@
+/**
+ * @file    scheduler.h
+ * @brief   Cooperative run-to-completion task scheduler
+ * @version 1.4
+ *
+ * Tasks come from a static table and run in table order, at most once per
+ * pass: when one of their event flags was raised since the last pass, when
+ * their period has elapsed, or when their last run left work behind. A task must return within its cycle
+ * budget - nothing preempts it - and within its deadline including any
+ * blocking waits, which the supervisor enforces. Runtime is measured in core cycles from
+ * SysTick (the Cortex-M0 has no cycle counter), max and moving average
+ * per task.
+ *
+ * Load meter: a window is idle while the core sleeps (Sched_AddIdle) and
+ * for every pass that runs no task; the cheapest such pass is kept as the
+ * empty-loop baseline, the cost of the loop doing nothing. The rest of the
+ * window - tasks, interrupts, the loop itself - is load, and each task's
+ * runs are its share of it (Sched_TakeLoad closes the window).
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Event flags (passed to Sched_Run) */
+#define SCHED_EVT_MODEM     0x01    /**< Modem UART received data */
+#define SCHED_EVT_TELEM     0x02    /**< Telemetry UART received data */
+
+#define SCHED_AVG_SHIFT     3       /**< Moving average weight 1/8 per run */
+#define SCHED_IDLE          0xFF    /**< Sched_t.running between tasks */
+
+/**
+ * @brief Task body
+ * @param ctx Context given to Sched_Init
+ * @return true if work is left that should not wait for the period (runs next pass)
+ */
+typedef bool (*Sched_TaskFn_t)(void *ctx);
+
+/**
+ * @brief Task table entry
+ */
+typedef struct {
+    const char *name;
+    Sched_TaskFn_t fn;
+    uint16_t period_ms;     /**< Run at least this often (0: every pass) */
+    uint8_t events;         /**< SCHED_EVT_x that make it due early */
+    uint16_t budget_us;     /**< Longest run expected; longer ones count as overruns */
+    uint16_t deadline_ms;   /**< Longest run tolerated, blocking included (0: unsupervised) */
+} Sched_Task_t;
+
+/**
+ * @brief Runtime statistics of one task
+ */
+typedef struct {
+    uint32_t runs;
+    uint32_t overruns;      /**< Runs over budget */
+    uint32_t max_cycles;
+    uint32_t avg_cycles;    /**< Moving average (SCHED_AVG_SHIFT) */
+    uint32_t last_tick;     /**< HAL tick of the last run */
+    uint32_t load_cycles;   /**< Run in the current load window */
+    uint16_t load_pm;       /**< Share of the last load window, per mille */
+} Sched_Stats_t;
+
+/**
+ * @brief Scheduler instance
+ */
+typedef struct {
+    const Sched_Task_t *tasks;
+    Sched_Stats_t *stats;   /**< One per task */
+    uint8_t count;
+    void *ctx;
+    uint32_t cycles_per_us;
+    uint32_t busy;              /**< Tasks that left work behind (bit = index) */
+    uint32_t pass_max_cycles;   /**< Longest whole pass - the worst loop latency */
+    volatile uint8_t running;   /**< Task being run (SCHED_IDLE: none) */
+    volatile uint32_t run_start;    /**< HAL tick it started */
+    volatile uint8_t *trace;    /**< Also gets running, if set (e.g. a record kept across resets) */
+    bool ran;                   /**< A task ran in the pass */
+    uint32_t load_start;        /**< Sched_Cycles() at the start of the load window */
+    uint32_t idle_cycles;       /**< Idle in it: asleep, and passes that ran no task */
+    uint32_t empty_cycles;      /**< Cheapest pass that ran no task - the empty-loop baseline */
+    uint16_t load_pm;           /**< Core busy over the last load window, per mille */
+} Sched_t;
+
+/**
+ * @brief Initialize a scheduler
+ * @param sched Scheduler instance
+ * @param tasks Task table (must stay valid)
+ * @param stats Statistics, count entries
+ * @param count Number of tasks
+ * @param ctx Passed to every task
+ */
+void Sched_Init(Sched_t *sched, const Sched_Task_t *tasks, Sched_Stats_t *stats, uint8_t count, void *ctx);
+
+/**
+ * @brief Run every due task once
+ * @param sched Scheduler instance
+ * @param events SCHED_EVT_x raised since the last pass
+ */
+void Sched_Run(Sched_t *sched, uint8_t events);
+
+/**
+ * @brief Run the due tasks of a slice of the table once (one thread's share)
+ * @note  Does not update pass_max_cycles; the caller measures its own latency
+ * @param sched Scheduler instance
+ * @param events SCHED_EVT_x raised since the slice last ran
+ * @param first First task of the slice
+ * @param count Tasks in the slice
+ * @return true if a task of the slice left work behind
+ */
+bool Sched_RunTasks(Sched_t *sched, uint8_t events, uint8_t first, uint8_t count);
+
+/**
+ * @brief Time until the next task is due on its period (for idle sleep)
+ * @param sched Scheduler instance
+ * @return ms, 0 if a task is due now or left work behind
+ */
+uint32_t Sched_NextDue(const Sched_t *sched);
+
+/**
+ * @brief Free-running core cycle count (wraps; differences are valid up to ~89 s at 48 MHz)
+ * @return Cycles
+ */
+uint32_t Sched_Cycles(void);
+
+/**
+ * @brief Convert a cycle count to microseconds
+ * @param sched Scheduler instance
+ * @param cycles Cycle count
+ * @return Microseconds
+ */
+uint32_t Sched_CyclesToUs(const Sched_t *sched, uint32_t cycles);
+
+/**
+ * @brief Book the tick interrupt's entry latency - first thing in SysTick_Handler
+ */
+void Sched_TickIrq(void);
+
+/**
+ * @brief Get the longest tick interrupt entry latency since boot
+ * @return Core cycles from the reload that raised it to the handler
+ */
+uint32_t Sched_TickLate(void);
+
+/**
+ * @brief Book time the core slept in the load window
+ * @param sched Scheduler instance
+ * @param cycles Core cycles asleep
+ */
+void Sched_AddIdle(Sched_t *sched, uint32_t cycles);
+
+/**
+ * @brief Close the load window: the core's load and each task's share, then start a new one
+ * @note  The window must be shorter than Sched_Cycles wraps (~89 s at 48 MHz)
+ * @param sched Scheduler instance
+ * @return Core busy over the window, per mille (also in load_pm)
+ */
+uint16_t Sched_TakeLoad(Sched_t *sched);
+
+/**
+ * @brief Clear the statistics (periods keep running)
+ * @param sched Scheduler instance
+ */
+void Sched_ResetStats(Sched_t *sched);
+
+#endif /* SCHEDULER_H */
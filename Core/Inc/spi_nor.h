@@ -0,0 +1,69 @@
+/**
+ * @file    spi_nor.h
+ * @brief   SPI NOR flash on SPI1 (W25Qxx command set), never waiting on the chip
+ * @version 1.0
+ *
+ * CS on PA4 (software), SCK/MISO/MOSI on PA5/PA6/PA7 (AF0), mode 0 at
+ * PCLK/4 = 12 MHz. On the F030 the SPI1 DMA requests sit on channels 2 and
+ * 3, which the FC UART already holds, so bytes go through the SPI FIFO by
+ * polling - a page (256 B) at most per call, ~0.25 ms.
+ *
+ * Program and erase return once the command is clocked in; the chip then
+ * works on its own (page ~0.7 ms, 4 KB sector ~50 ms) and SpiNor_Busy tells
+ * when it is done. Nothing here waits for that: a caller that finds the
+ * chip busy comes back on a later pass.
+ */
+
+#ifndef SPI_NOR_H
+#define SPI_NOR_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pins */
+#define SPI_NOR_CS_Pin          GPIO_PIN_4
+#define SPI_NOR_CS_GPIO_Port    GPIOA
+#define SPI_NOR_BUS_Pins        (GPIO_PIN_5 | GPIO_PIN_6 | GPIO_PIN_7)
+
+/* Geometry */
+#define SPI_NOR_PAGE            256U        /**< Program unit: a program must not cross one */
+#define SPI_NOR_SECTOR          4096U       /**< Erase unit */
+
+/**
+ * @brief Set up SPI1 and its pins, wake the chip and read its JEDEC id
+ * @return true if a chip answers
+ */
+bool SpiNor_Init(void);
+
+/**
+ * @brief Check whether a program or erase is still running
+ * @note  Reads the status register only while one was started and not seen done
+ * @return true if busy (no command may be sent)
+ */
+bool SpiNor_Busy(void);
+
+/**
+ * @brief Read bytes (chip idle)
+ * @param addr Chip address
+ * @param buf Receives the bytes
+ * @param len Bytes to read
+ */
+void SpiNor_Read(uint32_t addr, uint8_t *buf, size_t len);
+
+/**
+ * @brief Start programming bytes into erased flash (chip idle)
+ * @param addr Chip address
+ * @param data Bytes to program
+ * @param len Bytes, within one SPI_NOR_PAGE
+ */
+void SpiNor_Program(uint32_t addr, const uint8_t *data, size_t len);
+
+/**
+ * @brief Start erasing the SPI_NOR_SECTOR holding addr (chip idle)
+ * @param addr Chip address
+ */
+void SpiNor_EraseSector(uint32_t addr);
+
+#endif /* SPI_NOR_H */
@@ -0,0 +1,87 @@
+/**
+ * @file    supervisor.h
+ * @brief   Task liveness supervisor - the only place the IWDG is refreshed
+ * @version 1.0
+ *
+ * A scheduler task checks in by returning. The watchdog is refreshed (from
+ * the health task, and from driver waits while a call blocks) only while
+ * the running task is within its deadline; once one overstays, the refresh
+ * stops and the IWDG resets the MCU ~5 s later. Which task starved the
+ * watchdog is kept in SUPERVISOR_NOINIT_ADDR, the top of RAM kept out of
+ * the linker's IRAM range, so it survives the reset and is reported with
+ * the reset cause at the next boot.
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "main.h"
+#include "scheduler.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define SUPERVISOR_NOINIT_ADDR  0x20001FE0U     /**< 32 bytes not initialized by the C startup (boot_profile below) */
+
+/**
+ * @brief Cause of the last reset (RCC_CSR)
+ */
+typedef enum {
+    SUPERVISOR_RESET_POWER = 0,     /**< Power-on / brown-out */
+    SUPERVISOR_RESET_PIN,           /**< NRST pin */
+    SUPERVISOR_RESET_IWDG,          /**< Independent watchdog */
+    SUPERVISOR_RESET_WWDG,          /**< Window watchdog */
+    SUPERVISOR_RESET_SOFTWARE,      /**< NVIC_SystemReset */
+    SUPERVISOR_RESET_LOW_POWER,     /**< Illegal Stop / Standby entry */
+    SUPERVISOR_RESET_OPTION_BYTES   /**< Option byte reload */
+} Supervisor_Reset_t;
+
+/**
+ * @brief What the previous run left behind
+ */
+typedef struct {
+    Supervisor_Reset_t cause;
+    uint8_t task;                   /**< Task that starved the watchdog (SCHED_IDLE: none) */
+    bool stuck;                     /**< task overstayed its deadline (false: it was running, no verdict) */
+    uint32_t run_ms;                /**< How long it had been running */
+    uint32_t up_s;                  /**< Uptime at the verdict / last check */
+} Supervisor_Boot_t;
+
+/**
+ * @brief Read and clear the reset cause and the no-init record (call first thing in main)
+ */
+void Supervisor_Boot(void);
+
+/**
+ * @brief Supervise a scheduler's tasks
+ * @param sched Scheduler whose Sched_Task_t deadline_ms are enforced
+ */
+void Supervisor_Init(Sched_t *sched);
+
+/**
+ * @brief Refresh the IWDG if the running task is within its deadline
+ * @note  Called by the health task and from blocking driver waits
+ */
+void Supervisor_Service(void);
+
+/**
+ * @brief Get the reset cause and the task record of the previous run
+ * @return Boot record (valid after Supervisor_Boot)
+ */
+const Supervisor_Boot_t *Supervisor_GetBoot(void);
+
+/**
+ * @brief Check whether the reset left the modem running: a watchdog or software reset
+ * @note  Power-on and brown-out take the modem down with the MCU; an NRST
+ *        press is taken as asking for a clean start
+ */
+bool Supervisor_WarmBoot(void);
+
+/**
+ * @brief Get a reset cause as text
+ * @param cause Reset cause
+ * @return Short name, e.g. "iwdg"
+ */
+const char *Supervisor_ResetName(Supervisor_Reset_t cause);
+
+#endif /* SUPERVISOR_H */
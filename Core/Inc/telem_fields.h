@@ -0,0 +1,75 @@
+/**
+ * @file    telem_fields.h
+ * @brief   A few autopilot fields decoded on board, published as one CBOR map on a topic of their own
+ * @version 1.0
+ *
+ * Dashboards, alerting and fleet maps want position, battery and mode, and
+ * would otherwise each subscribe to the raw MAVLink stream and decode all of
+ * it. Built with FIELDS_ENABLE=1, the bridge hands the autopilot's
+ * GLOBAL_POSITION_INT, BATTERY_STATUS (battery 0) and HEARTBEAT payloads
+ * here, online or not, before any limit decimates them; only the latest
+ * values are kept. Every FIELDS_INTERVAL, if any came in since the last
+ * one, they go out as a CBOR map (RFC 8949, ~100 B) on FIELDS_TOPIC -
+ * QoS 0, retained so a new subscriber has the last state at once, low
+ * priority so it never takes the bridge's last publish slot. The raw
+ * stream is not changed.
+ *
+ * Keys and units: Core/Doc/telem_fields.md. A message not heard since boot
+ * leaves its keys out. RAM: ~180 B (values and the record in flight).
+ */
+
+#ifndef TELEM_FIELDS_H
+#define TELEM_FIELDS_H
+
+#include "a7600_mqtt.h"
+#include "topic_ns.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef FIELDS_ENABLE
+#define FIELDS_ENABLE           0
+#endif
+
+/* Configuration */
+#if TOPIC_NS_ENABLE
+#define FIELDS_TOPIC            TOPIC_NS(FIELDS)
+#else
+#define FIELDS_TOPIC            "uav4g/fields"
+#endif
+#define FIELDS_INTERVAL         5000    /**< Between records, ms */
+#define FIELDS_PAYLOAD_MAX      36      /**< Payload bytes read (BATTERY_STATUS is the longest) */
+#define FIELDS_RECORD_MAX       128     /**< Longest CBOR map */
+
+#if FIELDS_ENABLE
+
+/**
+ * @brief Set up the publisher, forget all values
+ * @param mqtt Driver (records go out on session 0, the bridge's)
+ */
+void TelemFields_Init(A7600_MQTT_Handle_t *mqtt);
+
+/**
+ * @brief Check whether a message carries decoded fields
+ * @param msgid MAVLink message ID
+ * @return true for HEARTBEAT, GLOBAL_POSITION_INT and BATTERY_STATUS
+ */
+bool TelemFields_Wants(uint32_t msgid);
+
+/**
+ * @brief Take the fields of an autopilot frame's payload
+ * @param msgid Message ID (TelemFields_Wants true)
+ * @param sysid Autopilot system ID
+ * @param payload FIELDS_PAYLOAD_MAX bytes, zero-filled past the frame's payload
+ * @param now HAL tick
+ */
+void TelemFields_Feed(uint32_t msgid, uint8_t sysid, const uint8_t *payload, uint32_t now);
+
+/**
+ * @brief Publish the record when due and something new came in
+ */
+void TelemFields_Process(void);
+
+#endif /* FIELDS_ENABLE */
+
+#endif /* TELEM_FIELDS_H */
@@ -0,0 +1,70 @@
+/**
+ * @file    telem_summary.h
+ * @brief   Windowed statistics of the autopilot's ATTITUDE / VFR_HUD fields, sent in place of the samples
+ * @version 1.0
+ *
+ * Built with SUMMARY_ENABLE=1 (a compiler define, CMSIS-DSP sources in the
+ * Keil project); switched on at runtime with MavlinkBridge_SetSummary. The
+ * bridge then hands the autopilot's ATTITUDE and VFR_HUD payloads here
+ * instead of forwarding them. Selected fields are kept as q15 samples, at
+ * most SUMMARY_SAMPLES per interval: when a field's buffer fills, every
+ * other sample is dropped and only every second one is taken from then on.
+ * Each interval the bridge sends one TUNNEL frame carrying min / max / mean /
+ * RMS of every field (arm_min_q15, arm_max_q15, arm_mean_q15, arm_rms_q15).
+ *
+ * Record format and field scales: Core/Doc/telemetry_summary.md.
+ * RAM: SUMMARY_FIELDS * SUMMARY_SAMPLES * 2 B of samples plus a few bytes.
+ */
+
+#ifndef TELEM_SUMMARY_H
+#define TELEM_SUMMARY_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef SUMMARY_ENABLE
+#define SUMMARY_ENABLE      0
+#endif
+
+/* Configuration */
+#define SUMMARY_FIELDS          9       /**< Fields summarized (table in telem_summary.c) */
+#define SUMMARY_SAMPLES         16      /**< Samples kept per field and interval */
+#define SUMMARY_PAYLOAD_MAX     28      /**< Payload bytes read (ATTITUDE is the longer) */
+#define SUMMARY_VERSION         1       /**< Record format version (first byte) */
+#define SUMMARY_FIELD_LEN       9       /**< Per field: samples, min, max, mean, rms */
+#define SUMMARY_RECORD_MAX      (4 + SUMMARY_FIELDS * SUMMARY_FIELD_LEN)
+
+#if SUMMARY_ENABLE
+
+/**
+ * @brief Drop all samples
+ */
+void Summary_Init(void);
+
+/**
+ * @brief Check whether a message is summarized
+ * @param msgid MAVLink message ID
+ * @return true for ATTITUDE and VFR_HUD
+ */
+bool Summary_Wants(uint32_t msgid);
+
+/**
+ * @brief Take an autopilot frame's payload as samples
+ * @param msgid Message ID (Summary_Wants true)
+ * @param payload SUMMARY_PAYLOAD_MAX bytes, zero-filled past the frame's payload
+ */
+void Summary_Feed(uint32_t msgid, const uint8_t *payload);
+
+/**
+ * @brief Close the interval: write its record and start the next one
+ * @param out SUMMARY_RECORD_MAX bytes
+ * @param span_ms Interval length, recorded as is (saturated to 65535)
+ * @return Record length
+ */
+size_t Summary_Take(uint8_t *out, uint32_t span_ms);
+
+#endif /* SUMMARY_ENABLE */
+
+#endif /* TELEM_SUMMARY_H */
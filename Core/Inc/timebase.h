@@ -0,0 +1,72 @@
+/**
+ * @file    timebase.h
+ * @brief   Free-running microsecond clock (TIM3 into TIM15) and wrap-safe timeouts
+ * @version 1.0
+ *
+ * HAL_GetTick counts milliseconds: too coarse for a frame's line time at
+ * USART1 rates, or for a UART draining its last characters. TIM3 counts the
+ * microseconds (prescaled to 1 MHz) and on each overflow clocks TIM15 as
+ * its slave (ITR1, external clock mode 1), so the pair is a 32-bit counter
+ * with no interrupt to take and nothing to wake the core from an idle
+ * sleep. It wraps every ~71.6 minutes.
+ *
+ * Compare times by difference only: Time_Us() - start >= span holds across
+ * the wrap for any span under it. Timeout_t keeps start and span together
+ * for the waits that need it (UART RX stamps, TX drain and blocking waits
+ * in uart_dma.c, the bridge's partial frame timeout). Spans and periods of
+ * seconds stay on the HAL tick; cycle-exact timing (profiler, scheduler
+ * budgets) stays on Sched_Cycles.
+ *
+ * The bench host build counts the HAL tick in microseconds instead (its
+ * virtual clock, 1 ms steps).
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration */
+#define TIME_SPAN_MAX_MS        2000000U    /**< Longest timeout, ms (~33 min: under half the wrap) */
+
+/**
+ * @brief Deadline as a start and a span (wrap-safe)
+ */
+typedef struct {
+    uint32_t start;                     /**< Time_Us() when started */
+    uint32_t span;                      /**< us */
+} Timeout_t;
+
+#ifndef BENCH_HOST
+
+/**
+ * @brief Start TIM3 (1 MHz) and TIM15 counting its overflows
+ * @note  After SystemClock_Config (TIM clock = SystemCoreClock) and before the UARTs
+ */
+void Time_Init(void);
+
+/**
+ * @brief Microseconds since Time_Init (wraps every ~71.6 min)
+ */
+uint32_t Time_Us(void);
+
+#else
+
+#define Time_Init()                 ((void)0)
+#define Time_Us()                   ((uint32_t)(HAL_GetTick() * 1000U))
+
+#endif /* BENCH_HOST */
+
+/** Milliseconds as a Timeout_t span, capped at TIME_SPAN_MAX_MS */
+#define TIME_MS(ms)                 (((ms) < TIME_SPAN_MAX_MS) ? (uint32_t)(ms) * 1000U : TIME_SPAN_MAX_MS * 1000U)
+
+/** Start a timeout of us microseconds */
+#define Timeout_Start(t, us)        ((t)->start = Time_Us(), (t)->span = (us))
+/** Timeout passed: its span has elapsed */
+#define Timeout_Expired(t)          (Time_Us() - (t)->start >= (t)->span)
+/** Stamp a later than stamp b (wrap-safe while under half the wrap apart) */
+#define TIME_AFTER(a, b)            ((int32_t)((uint32_t)(a) - (uint32_t)(b)) > 0)
+
+#endif /* TIMEBASE_H */
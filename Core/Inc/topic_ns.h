@@ -0,0 +1,89 @@
+/**
+ * @file    topic_ns.h
+ * @brief   Per-device topic namespace and client ID, rendered once at boot
+ * @version 1.0
+ *
+ * With the topics and APP_MQTT_CLIENT_ID compiled in, two aircraft flashed
+ * with the same image share every topic and take the broker session from
+ * each other. Built with TOPIC_NS_ENABLE=1, each topic lives under
+ * TOPIC_NS_ROOT "<id>/" instead ("uav4g/3fa29c01/mavlink/tx"), and the
+ * client ID becomes APP_MQTT_CLIENT_ID "-<id>". The id is the one stored
+ * with "cfg dev <id>" (CONFIG_DEVICE_ID, next boot), or else 8 hex digits
+ * of an FNV-1a hash over the 96-bit UID - two ids of a 1000-aircraft fleet
+ * collide with odds of ~1e-4; give those two a stored id.
+ *
+ * TopicNs_Init writes every topic into its slot of topic_ns_pool once,
+ * before anything uses them. TOPIC_NS(id) is the slot's address - a
+ * constant, so the topic macros of the other headers still go into static
+ * tables (subscriptions, publish policy) and topic descriptors as before,
+ * and no publish formats anything. RAM: ~300 B (the pool and the client ID).
+ */
+
+#ifndef TOPIC_NS_H
+#define TOPIC_NS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TOPIC_NS_ENABLE
+#define TOPIC_NS_ENABLE         0
+#endif
+
+/* Configuration */
+#define TOPIC_NS_ROOT           "uav4g/"
+#define TOPIC_NS_ID_MAX         8       /**< Longest device id (the UID hash is 8 hex digits) */
+
+#if TOPIC_NS_ENABLE
+
+/* Topics under TOPIC_NS_ROOT "<id>/": X(id, suffix) */
+#define TOPIC_NS_TABLE(X)                   \
+    X(MAVLINK_TX,       "mavlink/tx")       \
+    X(MAVLINK_RX,       "mavlink/rx")       \
+    X(MAVLINK_REPLAY,   "mavlink/replay")   \
+    X(STATUS,           "status")           \
+    X(SENSOR,           "sensor")           \
+    X(COMMAND,          "command")          \
+    X(RESPONSE,         "response")         \
+    X(DIAG,             "diag")             \
+    X(DIAG_ALL,         "diag/#")           \
+    X(DIAG_PROBE,       "diag/probe")       \
+    X(ECHO,             "echo")             \
+    X(OTA,              "ota")              \
+    X(FIELDS,           "fields")           \
+    X(PERF,             "perf")
+
+#define TOPIC_NS_PREFIX_MAX     (sizeof(TOPIC_NS_ROOT) + TOPIC_NS_ID_MAX)     /* Root, id and '/' */
+
+/* Pool offsets: each slot holds the longest prefix, the suffix and the terminator */
+#define TOPIC_NS_SLOT(id, suffix) \
+    TOPIC_NS_##id, TOPIC_NS_##id##_END = TOPIC_NS_##id + TOPIC_NS_PREFIX_MAX + sizeof(suffix) - 1,
+enum {
+    TOPIC_NS_TABLE(TOPIC_NS_SLOT)
+    TOPIC_NS_POOL
+};
+#undef TOPIC_NS_SLOT
+
+#define TOPIC_NS(id)            ((const char *)&topic_ns_pool[TOPIC_NS_##id])
+#define TOPIC_NS_SIZE(id)       (TOPIC_NS_##id##_END - TOPIC_NS_##id + 1)  /**< Longest topic + terminator */
+
+extern char topic_ns_pool[TOPIC_NS_POOL];
+
+/**
+ * @brief Pick the device id and render every topic and the client ID
+ * @note  Call once after ConfigStore_Init, before any topic is used
+ */
+void TopicNs_Init(void);
+
+/**
+ * @brief Device id the topics were rendered with
+ */
+const char *TopicNs_Id(void);
+
+/**
+ * @brief Client ID: APP_MQTT_CLIENT_ID "-<id>" (a stored CONFIG_CLIENT_ID still wins)
+ */
+const char *TopicNs_ClientId(void);
+
+#endif /* TOPIC_NS_ENABLE */
+
+#endif /* TOPIC_NS_H */
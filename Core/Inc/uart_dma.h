@@ -2,7 +2,7 @@
  * @file    uart_dma.h
  * @brief   UART DMA Library for A7600 SIM Module
  * @author  Auto-generated
- * @version 1.2 - Simplified TX without ring buffer
+ * @version 2.11 - RX event stamps in microseconds (timebase.h)
  */
 
 #ifndef UART_DMA_H
@@ -13,10 +13,155 @@
 #include <stddef.h>
 #include <stdbool.h>
 
-/* Buffer sizes - adjusted for MAVLink */
-/* Buffer sizes - adjusted for MAVLink (and RAM constraints) */
-#define UART_DMA_RX_BUFFER_SIZE     512
-#define UART_DMA_TX_BUFFER_SIZE     512
+/* Per-link buffer sizes - storage is owned by the caller (see main.c).
+ * The telemetry RX ring is larger since the FC keeps streaming while the
+ * modem link blocks in connect/publish. */
+#define SIM_UART_RX_BUFFER_SIZE     512     /**< AT responses and URC bursts */
+#define SIM_UART_TX_BUFFER_SIZE     256     /**< AT commands (payloads go zero-copy) */
+#define TELEM_UART_RX_BUFFER_SIZE   1024    /**< MAVLink from FC */
+#define TELEM_UART_TX_BUFFER_SIZE   16      /**< Nothing is copied: debug lines and downlink frames go zero-copy */
+#define TELEM_UART_RX_TIMEOUT_BITS  100     /**< Burst end after ~10 idle chars (USART1 RTO) */
+
+/* Ring indices wrap with a mask - sizes must be powers of two */
+#define UART_DMA_IS_POW2(x)         ((x) != 0 && ((x) & ((x) - 1)) == 0)
+
+#if !UART_DMA_IS_POW2(SIM_UART_RX_BUFFER_SIZE) || !UART_DMA_IS_POW2(SIM_UART_TX_BUFFER_SIZE)
+#error "SIM_UART buffer sizes must be powers of two"
+#endif
+#if !UART_DMA_IS_POW2(TELEM_UART_RX_BUFFER_SIZE) || !UART_DMA_IS_POW2(TELEM_UART_TX_BUFFER_SIZE)
+#error "TELEM_UART buffer sizes must be powers of two"
+#endif
+
+/* RX event flags (set from ISR, fetched with UART_DMA_GetEvents) */
+#define UART_DMA_EVT_IDLE           0x01    /**< Line went idle after a burst */
+#define UART_DMA_EVT_HT             0x02    /**< DMA reached half of ring */
+#define UART_DMA_EVT_TC             0x04    /**< DMA wrapped ring end */
+#define UART_DMA_EVT_LINE           0x08    /**< Match character received (line ready) */
+#define UART_DMA_EVT_RTO            0x10    /**< Receiver timeout - burst ended */
+
+#define UART_DMA_RX_STAMPS          4       /**< RX events remembered with their tick (and as chunks) */
+
+/* RTS hold reasons (UART_DMA_HoldRts) - RTS is high while any is set */
+#define UART_DMA_RTS_RING           0x01    /**< Unread bytes reached the high-water mark */
+
+/* TX framing (UART_DMA_SetFramer) - on in the CMUX build (a7600_mqtt.h) */
+#ifndef UART_DMA_FRAMING
+#if defined(MQTT_CMUX) && MQTT_CMUX
+#define UART_DMA_FRAMING            1
+#else
+#define UART_DMA_FRAMING            0
+#endif
+#endif
+#define UART_DMA_FRAME_HEAD         5       /**< Most bytes a frame puts before a write */
+#define UART_DMA_FRAME_TAIL         2       /**< Most bytes it puts after it */
+
+/* Register-level interrupt path: the USART and DMA ISRs call UART_DMA_IDLE_IRQHandler /
+ * UART_DMA_DMA_IRQHandler only - no HAL_UART_IRQHandler / HAL_DMA_IRQHandler and their
+ * callbacks. HAL still sets the peripherals up (MSP, HAL_UART_Init); 0 restores the HAL path. */
+#ifndef UART_DMA_LL
+#define UART_DMA_LL                 1
+#endif
+
+/* Traffic tap (UART_DMA_SetTap) - on in the AT capture build (at_engine.h) */
+#ifndef UART_DMA_TAP
+#if defined(AT_CAPTURE) && AT_CAPTURE
+#define UART_DMA_TAP                1
+#else
+#define UART_DMA_TAP                0
+#endif
+#endif
+
+/**
+ * @brief Contiguous region of the RX DMA ring (zero-copy view)
+ */
+typedef struct {
+    const uint8_t *data;                /**< Start of region inside rx_buffer */
+    size_t len;                         /**< Bytes in region */
+} UART_DMA_Span_t;
+
+/**
+ * @brief New RX bytes one RX event delivered (UART_DMA_NextChunk)
+ * @note  Bounds are free-running byte counts: start - rx_read_total is the
+ *        chunk's offset among the unread data. The bytes stay in the ring.
+ */
+typedef struct {
+    size_t start;                       /**< First byte */
+    size_t end;                         /**< One past the last byte */
+    uint32_t us;                        /**< Time_Us() of the event */
+} UART_DMA_Chunk_t;
+
+/**
+ * @brief Bytes a frame puts around a write (UART_DMA_SetFramer)
+ */
+typedef struct {
+    uint8_t head[UART_DMA_FRAME_HEAD];  /**< Sent before the write */
+    uint8_t tail[UART_DMA_FRAME_TAIL];  /**< Sent after it */
+    uint8_t head_len;                   /**< Bytes in head */
+    uint8_t tail_len;                   /**< Bytes in tail */
+} UART_DMA_Frame_t;
+
+/**
+ * @brief TX framing hook (main loop context)
+ * @param ctx User context given to UART_DMA_SetFramer
+ * @param len Bytes the frame carries (a write, or a slice of a zero-copy write)
+ * @param frame Receives the frame bytes
+ * @return false to send the write unframed
+ */
+typedef bool (*UART_DMA_FrameFn_t)(void *ctx, size_t len, UART_DMA_Frame_t *frame);
+
+/**
+ * @brief Zero-copy TX completion callback (runs in ISR context)
+ * @param ctx User context given to UART_DMA_TransmitZC
+ */
+typedef void (*UART_DMA_TxDoneCallback_t)(void *ctx);
+
+/**
+ * @brief RX event hook (runs in ISR context, e.g. to wake a thread)
+ * @param ctx User context given to UART_DMA_SetEventHook
+ * @param events UART_DMA_EVT_x just raised
+ */
+typedef void (*UART_DMA_EventFn_t)(void *ctx, uint8_t events);
+
+/**
+ * @brief Traffic tap (main loop context)
+ * @param ctx User context given to UART_DMA_SetTap
+ * @param tx true: bytes queued for TX, false: bytes read by UART_DMA_Read
+ * @param data Bytes (valid during the call only)
+ * @param len Byte count
+ */
+typedef void (*UART_DMA_TapFn_t)(void *ctx, bool tx, const uint8_t *data, size_t len);
+
+/**
+ * @brief UART error counters (one per HAL error class)
+ */
+typedef struct {
+    uint32_t ore;                       /**< Overrun (byte lost before DMA read it) */
+    uint32_t fe;                        /**< Framing error */
+    uint32_t ne;                        /**< Noise detected */
+    uint32_t pe;                        /**< Parity error */
+    uint32_t dma;                       /**< DMA transfer error */
+    uint32_t rx_restarts;               /**< Circular RX DMA restarted after an abort */
+} UART_DMA_ErrorStats_t;
+
+/**
+ * @brief Interrupt timing of one link, worst since init (UART_DMA_LL)
+ * @note  RX entry latency is read off the DMA: bytes received past the half /
+ *        full-ring point by the time the handler ran, times the character
+ *        time. An entry after both points (both flags pending) missed the
+ *        half-ring deadline the RX accounting relies on.
+ */
+typedef struct {
+    uint32_t rx_late;                   /**< RX DMA half / full-ring handler entered this many bytes late */
+    uint32_t rx_missed;                 /**< RX DMA handler entries past the half-ring deadline */
+    uint32_t usart_cycles;              /**< Longest USART handler run, core cycles */
+    uint32_t dma_cycles;                /**< Longest DMA handler run, core cycles */
+} UART_DMA_IrqStats_t;
+
+/**
+ * @brief Yield hook run while a blocking TX wait polls (main loop context)
+ * @param ctx User context given to the wait call
+ */
+typedef void (*UART_DMA_YieldFn_t)(void *ctx);
 
 /**
  * @brief UART DMA Handle structure (simplified RX)
@@ -25,12 +170,73 @@ typedef struct {
     UART_HandleTypeDef *huart;          /**< UART handle */
     
     /* RX DMA circular buffer - read directly from here */
-    uint8_t rx_buffer[UART_DMA_RX_BUFFER_SIZE];      /**< DMA RX buffer (circular) */
+    uint8_t *rx_buffer;                               /**< DMA RX buffer (circular, caller-owned) */
+    size_t rx_size;                                   /**< RX buffer size (power of two) */
     volatile size_t rx_read_pos;                      /**< Application read position */
+    volatile uint8_t rx_events;                       /**< Pending UART_DMA_EVT_x flags */
+    volatile size_t rx_event_pos;                     /**< DMA position at last event */
+    volatile size_t rx_event_bytes;                   /**< Bytes received since last fetch */
+    volatile size_t rx_write_total;                   /**< Bytes written by DMA up to rx_event_pos */
+    size_t rx_read_total;                             /**< Bytes consumed by application */
+    uint32_t overrun_events;                          /**< Times DMA lapped the reader */
+    uint32_t overrun_bytes;                           /**< Unread bytes dropped by resync */
+    uint32_t tx_total;                                /**< Bytes accepted for TX (ring + zero-copy) */
+    UART_DMA_ErrorStats_t errors;                     /**< Hardware error counters */
+#if UART_DMA_LL
+    UART_DMA_IrqStats_t irq;                          /**< Interrupt timing */
+#endif
+    bool line_match;                                  /**< Character-match interrupt armed */
+    bool rx_timeout;                                  /**< Receiver-timeout interrupt armed */
+    volatile size_t burst_end_total;                  /**< rx_write_total at last receiver timeout */
+    volatile bool abr_request;                        /**< Auto baud rate: measure after the next IDLE */
+    volatile size_t stamp_total[UART_DMA_RX_STAMPS];  /**< rx_write_total at recent RX events (ring) */
+    volatile uint32_t stamp_us[UART_DMA_RX_STAMPS];   /**< Time_Us() of those events */
+    volatile uint8_t stamp_head;                      /**< Next stamp slot */
+    size_t chunk_total;                               /**< End of the last chunk handed over */
+    UART_DMA_EventFn_t event_hook;                    /**< Told of every RX event (optional) */
+    void *event_ctx;                                  /**< Event hook context */
+    GPIO_TypeDef *rts_port;                           /**< RTS output driven by the bridge (NULL = none) */
+    uint16_t rts_pin;                                 /**< Its pin */
+    uint16_t rts_high;                                /**< Unread bytes that raise RTS */
+    uint16_t rts_low;                                 /**< Unread bytes that lower it again */
+    volatile uint8_t rts_hold;                        /**< UART_DMA_RTS_x reasons RTS is high for */
+    uint32_t rts_raises;                              /**< Times RTS went high */
+#if UART_DMA_TAP
+    UART_DMA_TapFn_t tap;                             /**< Sees every byte read / queued (optional) */
+    void *tap_ctx;                                    /**< Tap context */
+#endif
     
-    /* TX buffer - simple DMA */
-    uint8_t tx_buffer[UART_DMA_TX_BUFFER_SIZE];      /**< TX DMA buffer */
+    /* TX ring - SPSC: main loop produces, TX complete ISR consumes */
+    uint8_t *tx_buffer;                               /**< TX ring storage (caller-owned) */
+    size_t tx_size;                                   /**< TX ring size (power of two) */
+    volatile size_t tx_head;                          /**< Write index (free-running, main loop) */
+    volatile size_t tx_tail;                          /**< Read index (free-running, ISR) */
+    volatile size_t tx_dma_len;                       /**< Bytes of the span currently on DMA */
     volatile bool tx_busy;                            /**< TX in progress flag */
+#if UART_DMA_FRAMING
+    UART_DMA_FrameFn_t framer;                        /**< Frames every write (optional) */
+    void *frame_ctx;                                  /**< Framer context */
+    size_t frame_max;                                 /**< Most bytes one frame carries */
+#endif
+    
+    /* Zero-copy TX slot - sent in order after ring bytes queued before it */
+    const uint8_t *zc_buf;                            /**< Caller buffer (NULL if slot free) */
+    size_t zc_len;                                    /**< Caller buffer length */
+    size_t zc_pos;                                    /**< tx_head at submit (ordering point) */
+    UART_DMA_TxDoneCallback_t zc_done;                /**< Completion callback (optional) */
+    void *zc_ctx;                                     /**< Completion callback context */
+    volatile bool zc_active;                          /**< Zero-copy span is on DMA */
+#if UART_DMA_FRAMING
+    size_t zc_slice;                                  /**< Bytes per frame (0 = unframed) */
+    size_t zc_off;                                    /**< Bytes of the buffer sent */
+    uint8_t zc_stage;                                 /**< Piece on DMA: buffer, glue, end */
+    uint8_t zc_glue[UART_DMA_FRAME_TAIL + UART_DMA_FRAME_HEAD];  /**< Tail + head between full slices */
+    uint8_t zc_glue_last[UART_DMA_FRAME_TAIL + UART_DMA_FRAME_HEAD]; /**< ... before the last slice */
+    uint8_t zc_end[UART_DMA_FRAME_TAIL];              /**< Tail of the last slice */
+    uint8_t zc_glue_len;
+    uint8_t zc_glue_last_len;
+    uint8_t zc_end_len;
+#endif
     
 } UART_DMA_Handle_t;
 
@@ -38,18 +244,250 @@ typedef struct {
  * @brief Initialize UART DMA with circular RX
  * @param handle Pointer to UART DMA handle
  * @param huart Pointer to HAL UART handle
- * @return HAL_OK on success
+ * @param rx_buf RX ring storage (must outlive the handle)
+ * @param rx_size RX ring size, power of two, max 65535
+ * @param tx_buf TX ring storage (must outlive the handle)
+ * @param tx_size TX ring size, power of two
+ * @return HAL_OK on success, HAL_ERROR on invalid buffers
+ */
+HAL_StatusTypeDef UART_DMA_Init(UART_DMA_Handle_t *handle, UART_HandleTypeDef *huart,
+                                uint8_t *rx_buf, size_t rx_size,
+                                uint8_t *tx_buf, size_t tx_size);
+
+/**
+ * @brief Change UART baud rate and restart circular RX
+ * @note  Unread RX data is discarded (it was received at the old rate)
+ * @param handle Pointer to UART DMA handle
+ * @param baudrate New baud rate
+ * @return HAL_OK on success, HAL_BUSY if TX has not drained yet
+ */
+HAL_StatusTypeDef UART_DMA_SetBaudRate(UART_DMA_Handle_t *handle, uint32_t baudrate);
+
+/**
+ * @brief Get current UART baud rate
+ * @param handle Pointer to UART DMA handle
+ * @return Baud rate
+ */
+uint32_t UART_DMA_GetBaudRate(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Start (or restart) automatic baud rate detection on the next character after the line goes idle
+ * @note  Only USARTs with auto baud rate support (USART1 on STM32F030). Start
+ *        bit measurement: right for characters with bit 0 set (MAVLink v2 0xFD);
+ *        0xFE (v1) measures two bit times, i.e. half the rate. RX DMA keeps
+ *        running - bytes received at a wrong rate stay in the ring
+ * @param handle Pointer to UART DMA handle
+ */
+void UART_DMA_AutoBaudStart(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Read the rate measured by UART_DMA_AutoBaudStart
+ * @note  The USART already runs at it; UART_DMA_GetBaudRate reports it from now on.
+ *        A failed measurement is requested again on the next IDLE
+ * @param handle Pointer to UART DMA handle
+ * @return Measured baud rate, 0 while none yet
+ */
+uint32_t UART_DMA_AutoBaudResult(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Reprogram the baud rate without restarting RX (unread data is kept)
+ * @note  Detection stays on if started; a character on the wire may be cut
+ * @param handle Pointer to UART DMA handle
+ * @param baudrate New baud rate
+ * @param detect false: end automatic baud rate detection as well
+ * @return HAL_OK on success, HAL_BUSY if TX has not drained yet
+ */
+HAL_StatusTypeDef UART_DMA_RetuneBaudRate(UART_DMA_Handle_t *handle, uint32_t baudrate, bool detect);
+
+/**
+ * @brief Enable or disable RTS/CTS hardware flow control
+ * @note  Pins must be in AF mode (MSP); RX restarts like UART_DMA_SetBaudRate
+ * @param handle Pointer to UART DMA handle
+ * @param enable true for RTS/CTS, false for none
+ * @return HAL_OK on success, HAL_BUSY if TX has not drained yet
+ */
+HAL_StatusTypeDef UART_DMA_SetFlowControl(UART_DMA_Handle_t *handle, bool enable);
+
+/**
+ * @brief Check whether RTS/CTS flow control is active
+ * @param handle Pointer to UART DMA handle
+ * @return true if RTS/CTS enabled
+ */
+bool UART_DMA_IsFlowControlled(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Drive a GPIO as RTS from the unread RX bytes (high = stop sending)
+ * @note  The USART's own RTS never rises here: circular DMA empties RDR at
+ *        once, however full the ring. The fill is checked at every RX event
+ *        (ISR) and as the reader consumes, so RTS also rises while the main
+ *        loop is held up; it falls once the reader is back down to low.
+ * @param handle Pointer to UART DMA handle
+ * @param port RTS output port, pin set up as a push-pull output (NULL: none)
+ * @param pin RTS output pin
+ * @param high Unread bytes that raise RTS (below rx_size, with room for what
+ *        the sender has in flight)
+ * @param low Unread bytes that lower it again
+ */
+void UART_DMA_SetRts(UART_DMA_Handle_t *handle, GPIO_TypeDef *port, uint16_t pin, size_t high, size_t low);
+
+/**
+ * @brief Hold RTS high for a reason of the caller's, or release it
+ * @note  RTS stays high while any reason holds it (the ring's included)
+ * @param handle Pointer to UART DMA handle
+ * @param reason Bit above UART_DMA_RTS_RING
+ * @param hold true to hold, false to release
+ */
+void UART_DMA_HoldRts(UART_DMA_Handle_t *handle, uint8_t reason, bool hold);
+
+/**
+ * @brief Get the times RTS went high since init
+ * @param handle Pointer to UART DMA handle
+ * @return Count (0 without an RTS output)
+ */
+uint32_t UART_DMA_GetRtsRaises(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Arm the USART character-match interrupt (e.g. on '\n')
+ * @note  Each match raises UART_DMA_EVT_LINE; survives UART_DMA_SetBaudRate / UART_DMA_SetFlowControl
+ * @param handle Pointer to UART DMA handle
+ * @param match Character to match (8-bit compare)
+ */
+void UART_DMA_EnableLineMatch(UART_DMA_Handle_t *handle, uint8_t match);
+
+/**
+ * @brief Arm the hardware receiver timeout (RTOR/RTOF) to delimit bursts
+ * @note  Only USARTs with receiver-timeout support (USART1 on STM32F030);
+ *        survives UART_DMA_SetBaudRate / UART_DMA_SetFlowControl
+ * @param handle Pointer to UART DMA handle
+ * @param bits Silence after the last stop bit, in bit times (max 0xFFFFFF)
+ */
+void UART_DMA_EnableRxTimeout(UART_DMA_Handle_t *handle, uint32_t bits);
+
+/**
+ * @brief Check whether the line has been silent since the last received byte
+ * @param handle Pointer to UART DMA handle
+ * @return true if the receiver timed out and nothing arrived after it
+ */
+bool UART_DMA_RxBurstEnded(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Get when an unread byte arrived (Time_Us of the first RX event that covered it)
+ * @note  Resolution is the event: IDLE / receiver timeout ends a burst, HT / TC
+ *        mark half rings. Bytes older than the kept stamps get the oldest one.
+ * @param handle Pointer to UART DMA handle
+ * @param offset Position of the byte among the unread data
+ * @return Time_Us() stamp, or now if no event has covered the byte yet
+ */
+uint32_t UART_DMA_RxArrivalUs(UART_DMA_Handle_t *handle, size_t offset);
+
+/**
+ * @brief UART_DMA_RxArrivalUs on the HAL tick (its age taken off the tick now)
+ */
+uint32_t UART_DMA_RxArrivalTick(UART_DMA_Handle_t *handle, size_t offset);
+
+/**
+ * @brief Take the next chunk of new RX bytes, in arrival order
+ * @note  Every RX event that moved the DMA (HT / TC: half a ring, IDLE / receiver
+ *        timeout: a burst end) closes a chunk, queued in the stamps from the ISR.
+ *        A reader more than UART_DMA_RX_STAMPS events behind gets the older ones
+ *        as one chunk; bytes consumed or flushed meanwhile are left out. Bytes the
+ *        DMA wrote after the last event are in no chunk yet.
+ * @param handle Pointer to UART DMA handle
+ * @param chunk Receives the chunk
+ * @return true if a chunk was taken, false if no event brought new unread bytes
  */
-HAL_StatusTypeDef UART_DMA_Init(UART_DMA_Handle_t *handle, UART_HandleTypeDef *huart);
+bool UART_DMA_NextChunk(UART_DMA_Handle_t *handle, UART_DMA_Chunk_t *chunk);
 
 /**
- * @brief Process UART IDLE interrupt - call from USART IRQ handler
+ * @brief Process UART IDLE, character-match and receiver-timeout interrupts - call from USART IRQ handler
+ * @note  With UART_DMA_LL it is the whole handler: it also counts and clears
+ *        ORE / FE / NE / PE, and circular RX runs on through them
  * @param handle Pointer to UART DMA handle
  */
 void UART_DMA_IDLE_IRQHandler(UART_DMA_Handle_t *handle);
 
+#if UART_DMA_LL
+/**
+ * @brief Process the link's RX and TX DMA channels - call from the DMA IRQ handler
+ * @note  RX half / full ring, TX complete (the next span starts at once, TX
+ *        completes when the USART has the last byte) and transfer errors
+ * @param handle Pointer to UART DMA handle
+ */
+void UART_DMA_DMA_IRQHandler(UART_DMA_Handle_t *handle);
+#endif
+
+/**
+ * @brief Process DMA RX Half Complete callback
+ * @param handle Pointer to UART DMA handle
+ */
+void UART_DMA_RxHalfCplt_Callback(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Process DMA RX Complete (ring wrap) callback
+ * @param handle Pointer to UART DMA handle
+ */
+void UART_DMA_RxCplt_Callback(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Fetch and clear pending RX events
+ * @param handle Pointer to UART DMA handle
+ * @param rx_bytes Optional, receives bytes arrived since last fetch
+ * @return UART_DMA_EVT_x flags (0 if nothing happened)
+ */
+uint8_t UART_DMA_GetEvents(UART_DMA_Handle_t *handle, size_t *rx_bytes);
+
+/**
+ * @brief Check for pending RX events without clearing them (e.g. before WFI)
+ * @param handle Pointer to UART DMA handle
+ * @return true if an event is pending
+ */
+bool UART_DMA_HasEvents(const UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Have RX events reported as they are raised (in addition to the pending flags)
+ * @param handle Pointer to UART DMA handle
+ * @param hook Called from the UART / DMA ISR (NULL to remove)
+ * @param ctx Hook context
+ */
+void UART_DMA_SetEventHook(UART_DMA_Handle_t *handle, UART_DMA_EventFn_t hook, void *ctx);
+
+#if UART_DMA_TAP
+/**
+ * @brief Copy the link's traffic to a tap: bytes read with UART_DMA_Read and
+ *        bytes queued with UART_DMA_Transmit / TransmitV / TransmitZC
+ * @param handle Pointer to UART DMA handle
+ * @param tap Called as the bytes go by (NULL to remove)
+ * @param ctx Tap context
+ */
+void UART_DMA_SetTap(UART_DMA_Handle_t *handle, UART_DMA_TapFn_t tap, void *ctx);
+#endif
+
+#if UART_DMA_FRAMING
+/**
+ * @brief Frame every write from now on (e.g. the channel frames of a multiplexer), or stop
+ * @note  A ring write goes as one frame. A zero-copy write goes in slices of
+ *        max bytes, one frame each; the ISR sends the frame bytes between
+ *        them. Change it with TX idle.
+ * @param handle Pointer to UART DMA handle
+ * @param fn Framer (NULL: writes go as they are)
+ * @param ctx Framer context
+ * @param max Most bytes one frame carries, at least the TX ring size
+ */
+void UART_DMA_SetFramer(UART_DMA_Handle_t *handle, UART_DMA_FrameFn_t fn, void *ctx, size_t max);
+#endif
+
+/**
+ * @brief Sleep (WFI) until an RX event or timeout
+ * @note  Consumes the pending events on return
+ * @param handle Pointer to UART DMA handle
+ * @param timeout_ms Maximum time to wait
+ * @return true if an event woke us, false on timeout
+ */
+bool UART_DMA_WaitEvent(UART_DMA_Handle_t *handle, uint32_t timeout_ms);
+
 /**
  * @brief Process DMA TX Complete callback
+ * @note  Releases the finished span and starts the next queued one from ISR
  * @param handle Pointer to UART DMA handle
  */
 void UART_DMA_TxCplt_Callback(UART_DMA_Handle_t *handle);
@@ -77,6 +515,24 @@ size_t UART_DMA_GetDMAPos(UART_DMA_Handle_t *handle);
  */
 size_t UART_DMA_Read(UART_DMA_Handle_t *handle, uint8_t *data, size_t len);
 
+/**
+ * @brief Expose unread RX data in place (no copy)
+ * @note  span2 is non-empty only when the unread data wraps the ring end.
+ *        Data stays valid until consumed or overwritten by a DMA lap.
+ * @param handle Pointer to UART DMA handle
+ * @param span1 Filled with first region (from read position)
+ * @param span2 Filled with wrapped region (from start of ring), may be empty
+ * @return Total bytes exposed (span1.len + span2.len)
+ */
+size_t UART_DMA_Peek(UART_DMA_Handle_t *handle, UART_DMA_Span_t *span1, UART_DMA_Span_t *span2);
+
+/**
+ * @brief Release bytes previously exposed by UART_DMA_Peek
+ * @param handle Pointer to UART DMA handle
+ * @param len Bytes to consume (clamped to available)
+ */
+void UART_DMA_Consume(UART_DMA_Handle_t *handle, size_t len);
+
 /**
  * @brief Read one byte from RX buffer
  * @param handle Pointer to UART DMA handle
@@ -86,14 +542,42 @@ size_t UART_DMA_Read(UART_DMA_Handle_t *handle, uint8_t *data, size_t len);
 bool UART_DMA_ReadByte(UART_DMA_Handle_t *handle, uint8_t *data);
 
 /**
- * @brief Transmit data via DMA
+ * @brief Queue data for DMA transmit (never blocks)
+ * @note  Data is copied into the TX ring as a whole or not at all
  * @param handle Pointer to UART DMA handle
  * @param data Pointer to data to send
  * @param len Number of bytes to send
- * @return HAL_OK on success, HAL_BUSY if TX in progress
+ * @return HAL_OK on success, HAL_BUSY if the ring lacks space for len bytes
  */
 HAL_StatusTypeDef UART_DMA_Transmit(UART_DMA_Handle_t *handle, const uint8_t *data, size_t len);
 
+/**
+ * @brief Queue several fragments back-to-back for DMA transmit
+ * @note  All fragments are queued as one unit or none at all; DMA is kicked
+ *        once after the last fragment so they leave as a single burst.
+ * @param handle Pointer to UART DMA handle
+ * @param iov Array of fragments (data/len)
+ * @param count Number of fragments
+ * @return HAL_OK on success, HAL_BUSY if the ring lacks space for the total
+ */
+HAL_StatusTypeDef UART_DMA_TransmitV(UART_DMA_Handle_t *handle, const UART_DMA_Span_t *iov, size_t count);
+
+/**
+ * @brief Transmit straight from caller memory (no copy into TX ring)
+ * @note  The buffer must stay untouched until done_cb runs (or TX is idle).
+ *        Sent in one DMA transaction, after ring data queued before it
+ *        (one per frame with a framer).
+ * @param handle Pointer to UART DMA handle
+ * @param buf Caller buffer (RAM or flash)
+ * @param len Number of bytes, max 65535
+ * @param done_cb Called from TX complete ISR when buf can be reused, may be NULL
+ * @param ctx Passed to done_cb
+ * @return HAL_OK on success, HAL_BUSY if a zero-copy TX is already pending (or, framed, the ring
+ *         lacks room for the first head)
+ */
+HAL_StatusTypeDef UART_DMA_TransmitZC(UART_DMA_Handle_t *handle, const uint8_t *buf, size_t len,
+                                      UART_DMA_TxDoneCallback_t done_cb, void *ctx);
+
 /**
  * @brief Transmit string via DMA
  * @param handle Pointer to UART DMA handle
@@ -109,6 +593,79 @@ HAL_StatusTypeDef UART_DMA_TransmitString(UART_DMA_Handle_t *handle, const char
  */
 bool UART_DMA_IsTxBusy(UART_DMA_Handle_t *handle);
 
+/**
+ * @brief Get free space in TX ring
+ * @param handle Pointer to UART DMA handle
+ * @return Number of bytes that can be queued without HAL_BUSY
+ */
+size_t UART_DMA_TxFree(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Wait until the TX ring has room for len bytes
+ * @note  Calls yield (if set) on every poll, otherwise sleeps until the next
+ *        interrupt - TX complete and SysTick both end the sleep
+ * @param handle Pointer to UART DMA handle
+ * @param len Bytes needed (must not exceed tx_size)
+ * @param timeout_ms Maximum wait
+ * @param yield Hook run while waiting (NULL to just sleep)
+ * @param ctx Hook context
+ * @return HAL_OK when space is free, HAL_TIMEOUT otherwise
+ */
+HAL_StatusTypeDef UART_DMA_WaitTxFree(UART_DMA_Handle_t *handle, size_t len, uint32_t timeout_ms,
+                                      UART_DMA_YieldFn_t yield, void *ctx);
+
+/**
+ * @brief Wait until everything queued (ring and zero-copy slot) has been sent
+ * @param handle Pointer to UART DMA handle
+ * @param timeout_ms Maximum wait
+ * @param yield Hook run while waiting (NULL to just sleep)
+ * @param ctx Hook context
+ * @return HAL_OK when TX is idle, HAL_TIMEOUT otherwise
+ */
+HAL_StatusTypeDef UART_DMA_WaitTxIdle(UART_DMA_Handle_t *handle, uint32_t timeout_ms,
+                                      UART_DMA_YieldFn_t yield, void *ctx);
+
+/**
+ * @brief Get RX overrun statistics
+ * @note  On overrun the read position is resynced to the DMA position
+ * @param handle Pointer to UART DMA handle
+ * @param events Optional, receives number of overruns detected
+ * @param bytes Optional, receives total unread bytes dropped
+ */
+void UART_DMA_GetOverrun(UART_DMA_Handle_t *handle, uint32_t *events, uint32_t *bytes);
+
+/**
+ * @brief Process UART error - call from HAL_UART_ErrorCallback (HAL path only)
+ * @note  Counts each error class and restarts circular RX if HAL aborted it;
+ *        unread data stays readable in order
+ * @param handle Pointer to UART DMA handle
+ */
+void UART_DMA_Error_Callback(UART_DMA_Handle_t *handle);
+
+/**
+ * @brief Get hardware error counters
+ * @param handle Pointer to UART DMA handle
+ * @param stats Receives a snapshot of the counters
+ */
+void UART_DMA_GetErrors(UART_DMA_Handle_t *handle, UART_DMA_ErrorStats_t *stats);
+
+#if UART_DMA_LL
+/**
+ * @brief Get the link's interrupt timing
+ * @param handle Pointer to UART DMA handle
+ * @param stats Receives a snapshot (worst since init)
+ */
+void UART_DMA_GetIrqStats(UART_DMA_Handle_t *handle, UART_DMA_IrqStats_t *stats);
+#endif
+
+/**
+ * @brief Get byte counters since init (free-running, wrap at 2^32)
+ * @param handle Pointer to UART DMA handle
+ * @param tx Receives bytes accepted for transmission (optional)
+ * @param rx Receives bytes consumed by the application (optional)
+ */
+void UART_DMA_GetTraffic(UART_DMA_Handle_t *handle, uint32_t *tx, uint32_t *rx);
+
 /**
  * @brief Flush RX buffer
  * @param handle Pointer to UART DMA handle
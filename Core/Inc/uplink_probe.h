@@ -0,0 +1,94 @@
+/**
+ * @file    uplink_probe.h
+ * @brief   Uplink capacity probe after a connect - seeds the bridge's shaper and batching
+ * @version 1.0
+ *
+ * A session starts without knowing whether the cell carries 20 kB/s or
+ * 200 B/s. Right after a connect, PROBE_COUNT QoS1 publishes of growing size
+ * go one at a time to PROBE_TOPIC and each is timed from its start to its
+ * +CMQTTPUB (PUBACK). A least-squares line through (bytes, ms) gives the
+ * capacity (its slope) and the fixed cost of a publish (its intercept: AT
+ * exchange and broker round trip), handed to MavlinkBridge_SeedUplink.
+ *
+ * The bridge goes on publishing: a probe publish starts only with nothing
+ * in flight, so nothing is ahead of it at the modem (what the bridge sends
+ * after it waits behind it). Telemetry that keeps the modem busy the whole
+ * time leaves the probe short of samples - the shaper learns on its own.
+ *
+ * Bounded: PROBE_BYTES in all and PROBE_TIMEOUT from the start - a probe cut
+ * short uses the samples it has (two at least). Skipped when the serving cell
+ * is the one the last result was measured on and that is younger than
+ * PROBE_TTL - the bridge keeps what it learned from it across the reconnect.
+ *
+ * The payload is bytes the caller already has in flash (the app hands in the
+ * broker's CA certificate, public anyway); no RAM beyond the state.
+ */
+
+#ifndef UPLINK_PROBE_H
+#define UPLINK_PROBE_H
+
+#include "a7600_mqtt.h"
+#include "topic_ns.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef PROBE_ENABLE
+#define PROBE_ENABLE            1
+#endif
+
+/* Configuration */
+#if TOPIC_NS_ENABLE
+#define PROBE_TOPIC             TOPIC_NS(DIAG_PROBE)
+#else
+#define PROBE_TOPIC             "uav4g/diag/probe"
+#endif
+#define PROBE_COUNT             4       /**< Publishes per probe (sizes in uplink_probe.c) */
+#define PROBE_BYTES             1088    /**< Payload bytes they add up to */
+#define PROBE_TIMEOUT           6000    /**< Whole probe, ms */
+#define PROBE_TTL               600000  /**< A result stands for its cell this long, ms */
+
+/**
+ * @brief Probe outcome
+ */
+typedef struct {
+    uint32_t bps;               /**< Uplink capacity, payload B/s (0: none measured yet) */
+    uint16_t overhead_ms;       /**< Fixed cost of a publish */
+    uint8_t samples;            /**< Publishes the line went through */
+    uint32_t cell_id;           /**< Serving cell it was measured on (0: unknown) */
+    uint32_t tick;              /**< When */
+    uint32_t probes;            /**< Probes run since boot */
+    uint32_t skipped;           /**< Connects that reused a result instead */
+    uint32_t failed;            /**< Probes ended with fewer than two samples */
+} UplinkProbe_Result_t;
+
+#if PROBE_ENABLE
+
+/**
+ * @brief Set up the probe (no result yet)
+ * @param mqtt Driver the probe publishes through (session 0, the bridge's)
+ * @param fill Payload bytes, kept (flash)
+ * @param fill_len At least the largest probe size; shorter leaves the probe off
+ */
+void UplinkProbe_Init(A7600_MQTT_Handle_t *mqtt, const uint8_t *fill, size_t fill_len);
+
+/**
+ * @brief A connect succeeded: probe, unless the last result is recent and of the same cell
+ */
+void UplinkProbe_Start(void);
+
+/**
+ * @brief Run the probe: next publish, timeout, result
+ * @note  Called before the bridge's pass, so the probe gets an idle driver first
+ * @return true while probing
+ */
+bool UplinkProbe_Process(void);
+
+/**
+ * @brief Get the last result and the counters
+ */
+const UplinkProbe_Result_t *UplinkProbe_GetResult(void);
+
+#endif /* PROBE_ENABLE */
+
+#endif /* UPLINK_PROBE_H */
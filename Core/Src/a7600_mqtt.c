@@ -1,157 +1,3849 @@
 /**
  * @file    a7600_mqtt.c
  * @brief   MQTT Library Implementation for A7600 SIM Module
- * @version 1.0
+ * @version 1.34
  */
 
 #include "a7600_mqtt.h"
 #include "debug_log.h"
+#include "nv_store.h"
+#include "mqtt_packet.h"
+#include "supervisor.h"
+#include "boot_profile.h"
 #include <string.h>
 #include <stdio.h>
 
 /* Private defines */
 #define AT_CMD_MAX_LEN      256
 #define RESPONSE_WAIT_MS    100
+#define LOG_FILE_ID         4
+#define LOG_MODULE          LOG_MOD_MQTT
+
+/* Fragment helpers for vectored AT commands */
+#define IOV_STR(v, s)       do { (v).data = (const uint8_t *)(s); (v).len = sizeof(s) - 1; } while (0)
+#define IOV_BUF(v, p, n)    do { (v).data = (const uint8_t *)(p); (v).len = (n); } while (0)
+#define AT_LIT(s)           (s), (sizeof(s) - 1)    /* Constant command text and its length, for the builders */
+
+/* Connect sequence, one row per step:
+ *   X(step, phase, command, expected, timeout ms, retries, fail, flags, next, next on a socket transport)
+ * Rows with a command run through connect_table_step; NULL rows are coded in
+ * connect_step (builders, branches, waits). phase is the reported step
+ * (error_step - 1) time is charged to; fail is the error_step of a failed
+ * command, 0 if its outcome is ignored. Retries wait CONN_RETRY_DELAY first. */
+#define CONNECT_STEPS(X) \
+    X(CONN_PROBE,       0, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_LINK,        0, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_MUX,         0, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_MUX_WAIT,    0, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_WARM,        0, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CPIN,        1, "AT+CPIN?\r\n", "+CPIN: READY", MQTT_CMD_TIMEOUT, 3, 2, 0, \
+      CONN_SIM_ID, CONN_SIM_ID) \
+    /* Carrier profile when no APN is configured: ICCID against nv_store, AT+CIMI only for a new SIM */ \
+    X(CONN_SIM_ID,      1, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_IMSI,        1, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_RAT,         1, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* Registration URCs (LTE with cell location, for the link monitor); replies seed urc_reg */ \
+    X(CONN_REG_URC,     2, "AT+CREG=1;+CGREG=1;+CEREG=2;+CREG?;+CGREG?;+CEREG?\r\n", "OK", 2000, 0, 0, 0, \
+      CONN_ACQ, CONN_ACQ) \
+    /* Not registered yet: search the LTE band of the last full connect first (MQTT_FAST_ACQ) */ \
+    X(CONN_ACQ,         2, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_REG_WAIT,    3, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_ACQ_OPEN,    3, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_PDP_QUERY,   4, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CGACT_OFF,   4, "AT+CGACT=0,1\r\n", "OK", 5000, 0, 0, 0, CONN_APN, CONN_APN) \
+    X(CONN_APN,         4, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CGACT_ON,    4, "AT+CGACT=1,1\r\n", "OK", 10000, 0, 5, 0, CONN_CSQ, CONN_CSQ) \
+    X(CONN_CSQ,         5, "AT+CSQ;+CPSI?\r\n", "OK", 2000, 0, 0, 0, CONN_CLOCK, CONN_CLOCK) \
+    /* Network time (NITZ) for A7600_MQTT_GetUnixTime; one NTP sync if the network sends none */ \
+    X(CONN_CLOCK,       5, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_NTP,         5, "AT+CNTP=\"" MQTT_NTP_SERVER "\",0;+CNTP\r\n", "+CNTP: 0", 10000, 0, 0, 0, \
+      CONN_CLOCK, CONN_CLOCK) \
+    X(CONN_MQTT_DISC,   6, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_MQTT_REL,    6, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_MQTT_STOP,   6, "AT+CMQTTSTOP\r\n", "+CMQTTSTOP:", 2000, 0, 0, 0, CONN_MQTT_START, CONN_MQTT_START) \
+    /* Service is up only once +CMQTTSTART: 0 follows the OK */ \
+    X(CONN_MQTT_START,  6, "AT+CMQTTSTART\r\n", "+CMQTTSTART: 0", MQTT_CMD_TIMEOUT, 0, 7, 0, \
+      CONN_ACCQ, CONN_ACCQ) \
+    X(CONN_ACCQ,        7, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* Last will of the acquired client (config.will): topic, then message, each behind a prompt */ \
+    X(CONN_WILL_TOPIC,  7, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_WILL_TOPIC_DATA, 7, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_WILL_MSG,    7, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_WILL_MSG_DATA, 7, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_SSL_QUERY,   8, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* CA file for server verification: listed, uploaded only if it is not there */ \
+    X(CONN_CERT_LIST,   8, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CERT_DOWN,   8, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CERT_DATA,   8, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* SSL context 0: TLS 1.2, server verify if there is a CA, SNI (HiveMQ Cloud needs it), no time check */ \
+    X(CONN_SSL_VERSION, 8, "AT+CSSLCFG=\"sslversion\",0,4\r\n", "OK", 2000, 0, 0, CS_SSL_CACHED, \
+      CONN_SSL_AUTH, CONN_SSL_AUTH) \
+    X(CONN_SSL_AUTH,    8, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_SSL_SNI,     8, "AT+CSSLCFG=\"enableSNI\",0,1\r\n", "OK", 2000, 0, 0, CS_SSL_CACHED, \
+      CONN_SSL_TIME, CONN_SSL_TIME) \
+    X(CONN_SSL_TIME,    8, "AT+CSSLCFG=\"ignorelocaltime\",0,1\r\n", "OK", 2000, 0, 0, CS_SSL_CACHED, \
+      CONN_SSL_BIND, CONN_SSL_BIND) \
+    X(CONN_SSL_BIND,    8, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_BROKER,      9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* Broker address lookup ahead of CONN_BROKER / CONN_CCH_OPEN (connect_by_ip) */ \
+    X(CONN_DNS,         9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* Socket transport: SSL socket service, TLS socket, MQTT CONNECT framed here */ \
+    X(CONN_CCH_STOP,    6, "AT+CCHSTOP\r\n", "+CCHSTOP:", 2000, 0, 0, 0, CONN_CCH_START, CONN_CCH_START) \
+    /* Direct receive mode (+CCHRECV: DATA,...), then the service - up once +CCHSTART: 0 follows */ \
+    X(CONN_CCH_START,   6, "AT+CCHSET=0,0;+CCHSTART\r\n", "+CCHSTART: 0", MQTT_CMD_TIMEOUT, 0, 7, 0, \
+      CONN_SSL_QUERY, CONN_SSL_QUERY) \
+    X(CONN_CCH_OPEN,    7, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CCH_SEND,    9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CCH_CONNECT, 9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_CCH_CONNACK, 9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    /* Optional datagram path (AT+NETOPEN / AT+CIPOPEN link 0) */ \
+    X(CONN_UDP_NETQ,    9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_UDP_NET,     9, NULL, NULL, 0, 0, 0, 0, 0, 0) \
+    X(CONN_UDP_OPEN,    9, NULL, NULL, 0, 0, 0, 0, 0, 0)
+
+/* Connect steps (error_step numbering is kept in A7600_MQTT_GetErrorStep) */
+#define CONN_STEP_ID(id, ...)   id,
+enum {
+    CONNECT_STEPS(CONN_STEP_ID)
+    CONN_STEP_COUNT
+};
+#undef CONN_STEP_ID
+
+/* Connect step flags */
+#define CS_SSL_CACHED       0x01    /* Skipped while SSL context 0 is known to hold our settings */
+
+#define CONN_RETRY_DELAY    1000
+#define CERT_TIMEOUT        5000    /* AT+CCERTDOWN / AT+CFTRANRX: file sent to "OK" (file writes add line time) */
+
+/**
+ * @brief One row of CONNECT_STEPS (in flash)
+ */
+typedef struct {
+    const char *cmd;                /* NULL: coded in connect_step */
+    const char *expected;
+    uint16_t timeout_ms;
+    uint8_t phase;
+    uint8_t retries;
+    uint8_t fail;
+    uint8_t flags;
+    uint8_t next;
+    uint8_t sock_next;
+} Conn_Step_t;
+
+#define CONN_STEP_ROW(id, phase, cmd, expected, timeout, retries, fail, flags, next, sock_next) \
+    { cmd, expected, timeout, phase, retries, fail, flags, next, sock_next },
+static const Conn_Step_t conn_steps[CONN_STEP_COUNT] = {
+    CONNECT_STEPS(CONN_STEP_ROW)
+};
+#undef CONN_STEP_ROW
+
+/* Per-client result lines (index = client) */
+static const char *const conn_ok[MQTT_MAX_CLIENTS] = { "+CMQTTCONNECT: 0,0", "+CMQTTCONNECT: 1,0" };
+static const char *const sub_ok[MQTT_MAX_CLIENTS] = { "+CMQTTSUB: 0,0", "+CMQTTSUB: 1,0" };
+static const char *const cch_open_ok[MQTT_MAX_CLIENTS] = { "+CCHOPEN: 0,0", "+CCHOPEN: 1,0" };
+
+/* Reconnect tiers - a failed step escalates to the next one */
+enum {
+    TIER_BROKER = 0,    /* CMQTTCONNECT on the still-acquired client */
+    TIER_CLIENT,        /* Release / re-acquire client, SSL binding, CMQTTCONNECT */
+    TIER_FULL           /* Modem, SIM, registration, PDP and MQTT service as well */
+};
+
+/* First connect step of each tier (AT MQTT stack / socket transport) */
+static const uint8_t tier_start[] = { CONN_BROKER, CONN_MQTT_REL, CONN_PROBE };
+static const uint8_t sock_tier_start[] = { CONN_CCH_OPEN, CONN_CCH_STOP, CONN_PROBE };
+
+#define SOCKET_MODE(h)      ((h)->config.transport == MQTT_TRANSPORT_SOCKET)
+#define PUB_FIRE(h)         ((h)->config.qos0_fire && (h)->op_qos == 0 && !SOCKET_MODE(h))
+#if MQTT_CMUX
+#define MUX_OPEN(h)         (Cmux_GetState(&(h)->mux) != CMUX_OFF)
+#else
+#define MUX_OPEN(h)         false
+#endif
+#define TIER_START(h, t)    (SOCKET_MODE(h) ? sock_tier_start[t] : tier_start[t])
+
+/* Subscribe steps */
+enum {
+    SUB_CMD = 0,
+    SUB_TOPIC,
+    SUB_ACK,
+    SUBM_TOPIC_CMD,     /* Multi-topic: AT+CMQTTSUBTOPIC per topic, then one AT+CMQTTSUB */
+    SUBM_TOPIC,
+    SUBM_EXEC,
+    SOCK_SUB_SEND,      /* Socket transport: AT+CCHSEND, SUBSCRIBE packet, wait for SUBACK */
+    SOCK_SUB_PKT,
+    SOCK_SUB_ACK
+};
+
+/* Inbound message parse states */
+enum {
+    RX_IDLE = 0,
+    RX_HEADER           /* Between +CMQTTRXSTART and +CMQTTRXEND */
+};
+
+/* AT+CGDCONT? line of our context, as set by CONN_APN (followed by the APN and a quote) */
+#define PDP_APN_REPLY       "+CGDCONT: 1,\"IP\",\""
+#define PDP_ADDR_REPLY      "+CGPADDR: 1,"
+#define ICCID_REPLY         "+ICCID: "
+
+/* Module boot progress (modem_flags) */
+#define BOOT_RDY            0x01    /* "RDY" - AT interface up */
+#define BOOT_SIM            0x02    /* "+CPIN: ..." - SIM state known */
+#define BOOT_SMS            0x04    /* "SMS DONE" */
+#define BOOT_PB             0x08    /* "PB DONE" */
+#define BOOT_AT             0x10    /* Probe "AT" answered (boot URCs missed) */
+
+/* Modem sleep (dtr_state) */
+enum {
+    DTR_AWAKE = 0,      /* DTR low, UART listening */
+    DTR_ASLEEP,         /* DTR high - the module may sleep */
+    DTR_WAKING          /* DTR low again, MQTT_WAKE_MS not up yet */
+};
+
+/* Registration <stat>: registered home (1) or roaming (5) */
+#define REG_OK(stat)        ((stat) == 1 || (stat) == 5)
+
+/* Topic of the inbound message being received */
+static char rx_topic[128];
+
+/* rx_route: index into routes, or */
+#define RX_ROUTE_UNKNOWN    0xFF    /* Not looked up yet (topic may still be arriving) */
+#define RX_ROUTE_NONE       0xFE    /* Goes to the callbacks */
+
+#define FNV_OFFSET          2166136261U
+#define FNV_PRIME           16777619U
+
+/* Publish steps */
+enum {
+    PUB_TOPIC_CMD = 0,
+    PUB_TOPIC,
+    PUB_PAYLOAD_CMD,
+    PUB_PAYLOAD,
+    PUB_EXEC,
+    PUB_STAGES
+};
+
+/* File write steps */
+enum {
+    FILE_CMD = 0,       /* AT+CCERTDOWN / AT+CFTRANRX, wait for ">" */
+    FILE_DATA           /* The file, wait for "OK" */
+};
 
 /* Private functions */
 static bool send_at_cmd(A7600_MQTT_Handle_t *handle, const char *cmd);
 static bool wait_response(A7600_MQTT_Handle_t *handle, const char *expected, uint32_t timeout_ms);
 static bool send_and_wait(A7600_MQTT_Handle_t *handle, const char *cmd, const char *expected, uint32_t timeout_ms);
 static void clear_rx_buffer(A7600_MQTT_Handle_t *handle);
-static void clear_rx_buffer(A7600_MQTT_Handle_t *handle);
+static bool send_and_wait_v(A7600_MQTT_Handle_t *handle, const UART_DMA_Span_t *iov, size_t count,
+                            const char *expected, uint32_t timeout_ms);
+static void pub_stage(A7600_MQTT_Handle_t *handle, const void *data, size_t len, AT_SendFn_t send,
+                      const char *expected, uint8_t flags);
+static void acq_note(A7600_MQTT_Handle_t *handle);
 
 /* ==================== Private Functions ==================== */
 
+/**
+ * @brief Keep watchdog and application work alive while a call blocks
+ */
+static void mqtt_yield(void *ctx)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    Supervisor_Service();   /* Refreshes the IWDG while the blocked task is within its deadline */
+    Debug_Flush();
+    
+    if (handle->idle_hook != NULL && !handle->in_hook) {
+        handle->in_hook = true;
+        handle->idle_hook(handle->idle_ctx);
+        handle->in_hook = false;
+    }
+}
+
+/**
+ * @brief Yield while the modem UART has not taken our bytes yet
+ * @note  The modem keeps talking meanwhile: what it sends is read and its
+ *        URCs (incoming messages, link loss) dispatched as in any other pass,
+ *        so a long transmit does not hold the downlink back. No command is
+ *        queued at these points - no final result is taken from a later wait.
+ */
+static void mqtt_tx_yield(void *ctx)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    AT_Engine_Process(&handle->at);
+    mqtt_yield(handle);
+}
+
 static void clear_rx_buffer(A7600_MQTT_Handle_t *handle)
 {
-    handle->rx_len = 0;
-    memset(handle->rx_buffer, 0, sizeof(handle->rx_buffer));
+    /* Dispatched lines only - a half-received URC line survives */
+    AT_Engine_DiscardLines(&handle->at);
+}
+
+/**
+ * @brief Let queued asynchronous commands finish before a direct command
+ */
+static void drain_engine(A7600_MQTT_Handle_t *handle)
+{
+    while (!AT_Engine_IsIdle(&handle->at)) {
+        AT_Engine_Process(&handle->at);
+        mqtt_yield(handle);
+    }
+}
+
+/* Define send_at_cmd logging inside the file or enable it generally */
+static bool send_at_cmd(A7600_MQTT_Handle_t *handle, const char *cmd)
+{
+    drain_engine(handle);
+    clear_rx_buffer(handle);
+    
+    /* Log the command being sent for debug */
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    
+    /* Wait for room in the TX ring, keeping the rest of the system running */
+    if (UART_DMA_WaitTxFree(handle->uart, strlen(cmd), 1000, mqtt_tx_yield, handle) != HAL_OK) {
+        LOG_ERROR_M(LOG_MOD_AT, "TX Failed: Timeout");
+        return false;
+    }
+    
+    HAL_StatusTypeDef status = UART_DMA_TransmitString(handle->uart, cmd);
+    return (status == HAL_OK);
+}
+
+/**
+ * @brief Format unsigned decimal without snprintf
+ * @return Number of digits written (no terminator)
+ * @note  The M0 has no divide instruction: below 2^16 (lengths, ports,
+ *        client indexes) value / 10 is a multiply and a shift, exact up to
+ *        81919; only larger values (baud rates) take the library division.
+ */
+static size_t fmt_uint(char *out, uint32_t value)
+{
+    char tmp[10];
+    size_t n = 0, len = 0;
+    
+    while (value > 0xFFFFU) {
+        tmp[n++] = (char)('0' + (value % 10));
+        value /= 10;
+    }
+    do {
+        uint32_t q = (value * 52429U) >> 19;
+        
+        tmp[n++] = (char)('0' + (value - q * 10));
+        value = q;
+    } while (value != 0);
+    
+    while (n > 0) {
+        out[len++] = tmp[--n];
+    }
+    return len;
+}
+
+/**
+ * @brief Send AT command given as fragments (no assembly buffer)
+ */
+static bool send_at_cmdv(A7600_MQTT_Handle_t *handle, const UART_DMA_Span_t *iov, size_t count)
+{
+    drain_engine(handle);
+    clear_rx_buffer(handle);
+    
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %.*s...", (int)iov[0].len, (const char *)iov[0].data);
+    
+    /* Wait for room in the TX ring */
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += iov[i].len;
+    }
+    if (UART_DMA_WaitTxFree(handle->uart, total, 1000, mqtt_tx_yield, handle) != HAL_OK) {
+        LOG_ERROR_M(LOG_MOD_AT, "TX Failed: Timeout");
+        return false;
+    }
+    return (UART_DMA_TransmitV(handle->uart, iov, count) == HAL_OK);
+}
+
+/**
+ * @brief Queue caller buffer for zero-copy TX (waits for a free slot)
+ */
+static bool send_zc(A7600_MQTT_Handle_t *handle, const uint8_t *data, size_t len)
+{
+    uint32_t start = HAL_GetTick();
+    HAL_StatusTypeDef status;
+    
+    while ((status = UART_DMA_TransmitZC(handle->uart, data, len, NULL, NULL)) == HAL_BUSY) {
+        if (HAL_GetTick() - start > 1000) {
+            return false;
+        }
+        mqtt_tx_yield(handle);
+    }
+    return (status == HAL_OK);
+}
+
+/**
+ * @brief Wait until everything queued on the modem UART has left the MCU
+ */
+static bool wait_tx_idle(A7600_MQTT_Handle_t *handle, uint32_t timeout_ms)
+{
+    if (UART_DMA_WaitTxIdle(handle->uart, timeout_ms, mqtt_tx_yield, handle) != HAL_OK) {
+        LOG_ERROR_M(LOG_MOD_AT, "TX drain timeout");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Wait for a response to what was just sent (keeps buffered text)
+ */
+static bool wait_response(A7600_MQTT_Handle_t *handle, const char *expected, uint32_t timeout_ms)
+{
+    AT_Cmd_t cmd;
+    
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.expected = expected;
+    cmd.timeout_ms = timeout_ms;
+    cmd.flags = AT_FLAG_KEEP_RX;
+    
+    return (AT_Engine_Exec(&handle->at, &cmd, mqtt_yield, handle) == AT_OK);
+}
+
+static bool send_and_wait(A7600_MQTT_Handle_t *handle, const char *cmd, const char *expected, uint32_t timeout_ms)
+{
+    if (!send_at_cmd(handle, cmd)) {
+        return false;
+    }
+    return wait_response(handle, expected, timeout_ms);
+}
+
+static bool send_and_wait_v(A7600_MQTT_Handle_t *handle, const UART_DMA_Span_t *iov, size_t count,
+                            const char *expected, uint32_t timeout_ms)
+{
+    if (!send_at_cmdv(handle, iov, count)) {
+        return false;
+    }
+    return wait_response(handle, expected, timeout_ms);
+}
+
+/**
+ * @brief Check module answers "AT" at the current baud rate
+ */
+static bool probe_at(A7600_MQTT_Handle_t *handle, int tries)
+{
+    while (tries-- > 0) {
+        if (send_and_wait(handle, "AT\r\n", "OK", 500)) {
+            return true;
+        }
+        HAL_Delay(200);
+    }
+    return false;
+}
+
+/* ==================== Line Handling ==================== */
+
+/**
+ * @brief Give up on the publishes of a client (or MQTT_ALL_CLIENTS) still waiting for +CMQTTPUB
+ */
+static void pub_abort(A7600_MQTT_Handle_t *handle, MQTT_Result_t result, uint8_t client)
+{
+    uint8_t i;
+    
+    for (i = 0; i < handle->pub_count; i++) {
+        MQTT_InFlight_t *entry = &handle->pub_window[(handle->pub_head + i) % MQTT_PUB_WINDOW];
+        
+        if (!entry->resolved && (client == MQTT_ALL_CLIENTS || entry->client == client)) {
+            entry->result = (uint8_t)result;
+            entry->resolved = true;
+            handle->pub_stats.failed += entry->fired_before;
+            entry->fired_before = 0;
+        }
+    }
+    for (i = 0; i < handle->clients; i++) {
+        if (client == MQTT_ALL_CLIENTS || i == client) {
+            handle->pub_stats.failed += handle->fired[i];
+            handle->fired[i] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Report resolved publishes in order (main-loop context, outside the tokenizer)
+ */
+static void pub_deliver(A7600_MQTT_Handle_t *handle)
+{
+    /* Fire-and-forget publishes whose +CMQTTPUB never came: lost as far as we know */
+    for (uint8_t c = 0; c < handle->clients; c++) {
+        if (handle->fired[c] > 0 && HAL_GetTick() - handle->fired_tick[c] >= MQTT_PUB_ACK_TIMEOUT) {
+            LOG_WARN("Client %u: %u QoS 0 publishes without +CMQTTPUB", (unsigned)c, (unsigned)handle->fired[c]);
+            handle->pub_stats.failed += handle->fired[c];
+            handle->fired[c] = 0;
+        }
+    }
+    
+    while (handle->pub_count > 0) {
+        MQTT_InFlight_t entry = handle->pub_window[handle->pub_head];
+        
+        if (!entry.resolved) {
+            if (HAL_GetTick() - entry.tick < MQTT_PUB_ACK_TIMEOUT) {
+                return;
+            }
+            LOG_WARN("Publish #%u: no +CMQTTPUB", (unsigned)entry.seq);
+            entry.result = (uint8_t)MQTT_TIMEOUT;
+        }
+        
+        if (entry.result == (uint8_t)MQTT_OK) {
+            uint32_t latency = HAL_GetTick() - entry.tick;
+            
+            handle->pub_stats.delivered++;
+            handle->pub_stats.latency_ms_total += latency;
+            if (latency > handle->pub_stats.latency_ms_max) {
+                handle->pub_stats.latency_ms_max = latency;
+            }
+        } else {
+            handle->pub_stats.failed++;
+        }
+        
+        /* Pop first - the callback may start the next publish */
+        handle->pub_head = (uint8_t)((handle->pub_head + 1) % MQTT_PUB_WINDOW);
+        handle->pub_count--;
+        if (entry.done != NULL) {
+            entry.done(entry.ctx, (MQTT_Result_t)entry.result);
+        }
+    }
+}
+
+/**
+ * @brief Start of a field of a result line (leading spaces skipped), line end if absent
+ */
+static const char *urc_field(const char *line, size_t len, uint8_t index)
+{
+    const char *end = line + len;
+    const char *p = memchr(line, ':', len);
+
+    if (p == NULL) {
+        return end;
+    }
+    for (p++; p < end && index > 0; p++) {
+        if (*p == ',') {
+            index--;
+        }
+    }
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Numeric field of a result line, e.g. index 1 of "+CMQTTRXTOPIC: 0,17" is 17
+ */
+static uint32_t urc_arg(const char *line, size_t len, uint8_t index)
+{
+    const char *end = line + len;
+    const char *p = urc_field(line, len, index);
+    uint32_t value = 0;
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (uint32_t)(*p++ - '0');
+    }
+    return value;
+}
+
+/**
+ * @brief Signed numeric field, e.g. index 11 (RSRP) of a +CPSI line is -852
+ */
+static int32_t urc_sarg(const char *line, size_t len, uint8_t index)
+{
+    const char *end = line + len;
+    const char *p = urc_field(line, len, index);
+    bool neg = (p < end && *p == '-');
+    int32_t value = 0;
+
+    for (p += neg ? 1 : 0; p < end && *p >= '0' && *p <= '9'; p++) {
+        value = value * 10 + (*p - '0');
+    }
+    return neg ? -value : value;
+}
+
+/**
+ * @brief Whether a quoted field of a result line is name, e.g. index 5 of a +CSSLCFG line
+ */
+static bool urc_is_name(const char *line, size_t len, uint8_t index, const char *name)
+{
+    const char *end = line + len;
+    const char *p = urc_field(line, len, index);
+    size_t n = strlen(name);
+    
+    if (p < end && *p == '"') {
+        p++;
+    }
+    return ((size_t)(end - p) > n && memcmp(p, name, n) == 0 && p[n] == '"');
+}
+
+/**
+ * @brief <mcc>-<mnc> field of a +CPSI line as MCC * 1000 + MNC, 0 if absent
+ */
+static uint32_t urc_plmn(const char *line, size_t len)
+{
+    const char *end = line + len;
+    const char *p = urc_field(line, len, 2);
+    uint32_t mcc = 0;
+    uint32_t mnc = 0;
+    
+    while (p < end && *p >= '0' && *p <= '9') {
+        mcc = mcc * 10 + (uint32_t)(*p++ - '0');
+    }
+    if (p >= end || *p != '-') {
+        return 0;
+    }
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+        mnc = mnc * 10 + (uint32_t)(*p - '0');
+    }
+    return mcc * 1000 + mnc;
+}
+
+/**
+ * @brief Band number of an "EUTRAN-BAND3" field (index 6 of an LTE +CPSI line), 0 if absent
+ */
+static uint8_t urc_band(const char *line, size_t len)
+{
+    const char *end = line + len;
+    const char *p = urc_field(line, len, 6);
+    uint32_t band = 0;
+    
+    while (p < end && *p != ',' && (*p < '0' || *p > '9')) {
+        p++;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        band = band * 10 + (uint32_t)(*p++ - '0');
+    }
+    return (band <= 0xFF) ? (uint8_t)band : 0;
+}
+
+/**
+ * @brief Choose the keepalive of the next CONNECT from what was learned
+ * @note  Nothing proven yet: configured value, or half the one that was lost.
+ *        Proven: double it until a loss is seen, then bisect towards the loss
+ *        until the two are MQTT_KA_RESOLUTION apart.
+ */
+static void ka_plan(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t good = handle->ka_good;
+    uint32_t bad = handle->ka_bad;
+    uint32_t next;
+    
+    if (!handle->config.adaptive_keepalive) {
+        next = handle->config.keepalive;
+    } else if (good == 0) {
+        next = (bad != 0) ? bad / 2 : handle->config.keepalive;
+    } else if (bad == 0) {
+        next = good * 2;
+    } else if (bad - good > MQTT_KA_RESOLUTION) {
+        next = (good + bad) / 2;
+    } else {
+        next = good;
+    }
+    
+    if (handle->config.adaptive_keepalive) {
+        next = (next < MQTT_KA_MIN) ? MQTT_KA_MIN : (next > MQTT_KA_MAX) ? MQTT_KA_MAX : next;
+    }
+    handle->ka_next = (uint16_t)next;
+}
+
+/**
+ * @brief Now camped on a different network - take over what was learned there
+ */
+static void ka_load(A7600_MQTT_Handle_t *handle, uint32_t plmn)
+{
+    handle->ka_plmn = plmn;
+    handle->ka_good = 0;
+    handle->ka_bad = 0;
+    NV_Store_GetKeepalive(plmn, &handle->ka_good, &handle->ka_bad);
+    ka_plan(handle);
+    LOG_INFO("Network %lu: keepalive %us (good %u, lost %u)", (unsigned long)plmn,
+             (unsigned)handle->ka_next, (unsigned)handle->ka_good, (unsigned)handle->ka_bad);
+}
+
+/**
+ * @brief Session is lost - an idle timeout in the carrier NAT if it lasted a full keepalive period
+ */
+static void ka_lost(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t up_ms = HAL_GetTick() - handle->up_tick;
+    
+    /* Shorter sessions died of something else (coverage, broker) */
+    if (!handle->config.adaptive_keepalive || handle->ka_proven ||
+        up_ms < (uint32_t)handle->ka_used * 1000) {
+        return;
+    }
+    if (handle->ka_bad == 0 || handle->ka_used < handle->ka_bad) {
+        handle->ka_bad = handle->ka_used;
+    }
+    if (handle->ka_good >= handle->ka_bad) {
+        handle->ka_good = 0;    /* Network no longer keeps what it used to */
+    }
+    ka_plan(handle);
+    handle->ka_dirty = true;
+    LOG_WARN("Keepalive %us lost after %lus - next %us", (unsigned)handle->ka_used,
+             (unsigned long)(up_ms / 1000), (unsigned)handle->ka_next);
+}
+
+/**
+ * @brief Session outlived MQTT_KA_PROVE keepalive periods - its keepalive is good here
+ */
+static void ka_survived(A7600_MQTT_Handle_t *handle)
+{
+    handle->ka_proven = true;
+    if (!handle->config.adaptive_keepalive || handle->ka_used <= handle->ka_good) {
+        return;
+    }
+    handle->ka_good = handle->ka_used;
+    ka_plan(handle);
+    handle->ka_dirty = true;
+    LOG_INFO("Keepalive %us holds - next %us", (unsigned)handle->ka_used, (unsigned)handle->ka_next);
+}
+
+/**
+ * @brief A session went down (broker, network or socket closed)
+ */
+static void session_lost(A7600_MQTT_Handle_t *handle, uint8_t client)
+{
+    LOG_ERROR("MQTT Connection Lost (client %u)", (unsigned)client);
+    if (handle->connected) {
+        ka_lost(handle);
+    }
+    handle->client_up &= (uint8_t)~(1u << client);
+    handle->connected = false;
+    handle->state = MQTT_STATE_IDLE;
+    handle->rx_state = RX_IDLE;
+    pub_abort(handle, MQTT_NOT_CONNECTED, client);
+}
+
+/**
+ * @brief +CMQTTCONNLOST: <client>,<cause>
+ */
+static void urc_connlost(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    (void)type;
+    session_lost((A7600_MQTT_Handle_t *)ctx, (uint8_t)urc_arg(line, len, 0));
+}
+
+/**
+ * @brief Result of a fire-and-forget publish: its caller was told at acceptance, only counted
+ */
+static void fire_result(A7600_MQTT_Handle_t *handle, uint8_t client, uint32_t err)
+{
+    handle->fired_tick[client] = HAL_GetTick();
+    if (err != 0) {
+        LOG_WARN("QoS 0 publish failed after acceptance: err %lu", (unsigned long)err);
+        handle->pub_stats.failed++;
+    } else {
+        handle->pub_stats.delivered++;
+    }
+}
+
+/**
+ * @brief Resolve the client's oldest in-flight publish (+CMQTTPUB, or PUBACK on a socket)
+ */
+static void pub_resolve(A7600_MQTT_Handle_t *handle, uint8_t client, uint32_t err)
+{
+    uint8_t i;
+    
+    if (client >= handle->clients) {
+        return;
+    }
+    
+    /* Each client's publishes are acknowledged in the order they were issued,
+     * fire-and-forget ones included: those ahead of an entry come first */
+    for (i = 0; i < handle->pub_count; i++) {
+        MQTT_InFlight_t *entry = &handle->pub_window[(handle->pub_head + i) % MQTT_PUB_WINDOW];
+        
+        if (!entry->resolved && entry->client == client) {
+            if (entry->fired_before > 0) {
+                entry->fired_before--;
+                fire_result(handle, client, err);
+                return;
+            }
+            if (err != 0) {
+                LOG_ERROR("Publish #%u failed: err %lu", (unsigned)entry->seq, (unsigned long)err);
+            }
+            entry->result = (uint8_t)((err == 0) ? MQTT_OK : MQTT_ERROR);
+            entry->resolved = true;
+            return;
+        }
+    }
+    if (handle->fired[client] > 0) {
+        handle->fired[client]--;
+        fire_result(handle, client, err);
+    }
+}
+
+/**
+ * @brief +CMQTTPUB: <client>,<err> - result of the client's oldest in-flight publish
+ */
+static void urc_pub(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    (void)type;
+    pub_resolve((A7600_MQTT_Handle_t *)ctx, (uint8_t)urc_arg(line, len, 0), urc_arg(line, len, 1));
+}
+
+/**
+ * @brief +CREG / +CGREG / +CEREG, unsolicited "<stat>[,...]" or query reply "<n>,<stat>[,...]"
+ */
+static void urc_reg(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    const char *comma = memchr(line, ',', len);
+    uint8_t stat;
+    
+    (void)type;
+    /* A URC's second field is a quoted LAC, a query reply's is the stat */
+    if (comma != NULL && comma + 1 < line + len && comma[1] >= '0' && comma[1] <= '9') {
+        stat = (uint8_t)urc_arg(line, len, 1);
+    } else {
+        stat = (uint8_t)urc_arg(line, len, 0);
+    }
+    
+    if (line[2] == 'R') {
+        handle->reg_cs = stat;      /* +CREG */
+    } else {
+        handle->reg_ps = stat;      /* +CGREG (2G/3G) or +CEREG (LTE) */
+    }
+    
+    /* +CEREG URC with location (n=2): serving cell may have changed - sample it now */
+    if (line[3] == 'E' && comma != NULL && comma[1] == '"') {
+        handle->link_poll_tick = HAL_GetTick() - MQTT_LINK_POLL_INTERVAL;
+    }
+}
+
+/**
+ * @brief +CSQ: <rssi>,<ber>
+ */
+static void urc_csq(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    (void)type;
+    handle->link.csq = (uint8_t)urc_arg(line, len, 0);
+    handle->link.ber = (uint8_t)urc_arg(line, len, 1);
+}
+
+/**
+ * @brief +CPSI: <mode>,<op mode>,<mcc-mnc>,<tac>,<scell id>,<pcell id>,<band>,<earfcn>,
+ *        <dlbw>,<ulbw>,<rsrq>,<rsrp>,<rssi>,<rssnr> (LTE; other modes carry other fields)
+ */
+static void urc_cpsi(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    MQTT_LinkQuality_t *lq = &handle->link;
+    const char *mode = urc_field(line, len, 0);
+    uint32_t plmn = urc_plmn(line, len);
+    uint32_t cell;
+    
+    (void)type;
+    if (plmn != 0) {
+        lq->plmn = plmn;
+        if (plmn != handle->ka_plmn) {
+            ka_load(handle, plmn);
+        }
+    }
+    if (line + len - mode < 4 || memcmp(mode, "LTE,", 4) != 0) {
+        lq->rsrp = 0;   /* No service, or 2G/3G */
+        lq->rsrq = 0;
+        lq->sinr = 0;
+        lq->band = 0;
+        return;
+    }
+    
+    cell = urc_arg(line, len, 4);
+    if (lq->cell_id != 0 && cell != lq->cell_id) {
+        lq->cell_changes++;
+        LOG_INFO("Serving cell %lu -> %lu", (unsigned long)lq->cell_id, (unsigned long)cell);
+    }
+    lq->cell_id = cell;
+    lq->rsrq = (int16_t)urc_sarg(line, len, 10);
+    lq->rsrp = (int16_t)urc_sarg(line, len, 11);
+    lq->sinr = (int8_t)urc_sarg(line, len, 13);
+    lq->band = urc_band(line, len);
+}
+
+/**
+ * @brief Unix time of a "yy/MM/dd,hh:mm:ss±zz" clock (local time, zone in quarter hours)
+ * @return Seconds since 1970 UTC, 0 if malformed or never set (a year before 2020)
+ */
+static uint32_t cclk_parse(const char *p, const char *end)
+{
+    static const uint16_t month_start[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    uint8_t v[6];
+    int32_t zone = 0;
+    uint32_t year, days;
+    char sign;
+    
+    if (end - p < 19) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < 6; i++, p += 3) {
+        if (p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9') {
+            return 0;
+        }
+        v[i] = (uint8_t)((p[0] - '0') * 10 + (p[1] - '0'));
+    }
+    sign = p[-1];
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        zone = zone * 10 + (*p - '0');
+    }
+    if (v[0] < 20 || v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31 || (sign != '+' && sign != '-')) {
+        return 0;
+    }
+    /* Leap years up to 2099 are every fourth */
+    year = 2000U + v[0];
+    days = (year - 1970U) * 365U + (year - 1969U) / 4U + month_start[v[1] - 1] + v[2] - 1U;
+    if (v[1] > 2 && (year % 4U) == 0) {
+        days++;
+    }
+    return days * 86400U + v[3] * 3600U + v[4] * 60U + v[5] - (uint32_t)((sign == '-') ? -zone : zone) * 900U;
+}
+
+/**
+ * @brief +CCLK: "<yy/MM/dd,hh:mm:ss±zz>" (AT+CCLK? reply, taken when it arrives)
+ */
+static void urc_cclk(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    const char *quote = memchr(line, '"', len);
+    
+    (void)type;
+    handle->clock_read_tick = HAL_GetTick();
+    handle->clock_read = (quote != NULL) ? cclk_parse(quote + 1, line + len) : 0;
+}
+
+/**
+ * @brief +CSSLCFG: <ctx>,<sslversion>,<authmode>,<ignorelocaltime>,<negotiatetime>,
+ *        <cacert>,<clientcert>,<clientkey>,<enableSNI> (AT+CSSLCFG? reply)
+ */
+static void urc_csslcfg(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    (void)type;
+    if (urc_arg(line, len, 0) != 0) {
+        return;  /* Other contexts are not ours */
+    }
+    /* Same values the CONN_SSL_* steps write, our CA file with server verification */
+    handle->ssl_cfg_ok = (urc_arg(line, len, 1) == 4 && urc_arg(line, len, 2) == (handle->config.ca_cert ? 1U : 0U) &&
+                          urc_arg(line, len, 3) == 1 && urc_arg(line, len, 8) == 1 &&
+                          (handle->config.ca_cert == NULL || urc_is_name(line, len, 5, handle->ca_name)));
+}
+
+/**
+ * @brief +CCERTLIST: "<file>" - one line per certificate file on the module (AT+CCERTLIST reply)
+ */
+static void urc_certlist(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    (void)type;
+    if (handle->config.ca_cert != NULL && urc_is_name(line, len, 0, handle->ca_name)) {
+        handle->cert_present = true;
+    }
+}
+
+/**
+ * @brief FNV-1a over more bytes
+ */
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len)
+{
+    while (len-- > 0) {
+        hash = (hash ^ *data++) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Start capturing the topic of the next inbound message
+ */
+static void rx_topic_reset(A7600_MQTT_Handle_t *handle)
+{
+    rx_topic[0] = '\0';
+    handle->rx_topic_len = 0;
+    handle->rx_topic_hash = FNV_OFFSET;
+    handle->rx_route = RX_ROUTE_UNKNOWN;
+}
+
+/**
+ * @brief Route of the captured topic - RX_ROUTE_NONE if it has none
+ */
+static uint8_t rx_route_find(A7600_MQTT_Handle_t *handle)
+{
+    for (uint8_t i = 0; i < handle->route_count; i++) {
+        const MQTT_Route_t *route = &handle->routes[i];
+        
+        if (route->hash == handle->rx_topic_hash && route->len == handle->rx_topic_len &&
+            memcmp(route->topic, rx_topic, route->len) == 0) {
+            return i;
+        }
+    }
+    return RX_ROUTE_NONE;
+}
+
+/**
+ * @brief +CMQTTRXSTART: <client>,<topic_len>,<payload_len>
+ */
+static void urc_rxstart(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+
+    (void)type;
+    LOG_INFO("Found RXSTART");
+    rx_topic_reset(handle);
+    handle->rx_offset = 0;
+    handle->rx_total = urc_arg(line, len, 2);
+    handle->rx_state = RX_HEADER;
+}
+
+/**
+ * @brief Captured topic bytes
+ */
+static void rx_topic_data(void *ctx, const uint8_t *data, size_t len)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    size_t room = sizeof(rx_topic) - 1 - handle->rx_topic_len;
+
+    handle->rx_topic_hash = fnv1a(handle->rx_topic_hash, data, len);
+    if (len > room) {
+        len = room;  /* Truncated - long topics are not ours anyway */
+    }
+    memcpy(&rx_topic[handle->rx_topic_len], data, len);
+    handle->rx_topic_len += len;
+    rx_topic[handle->rx_topic_len] = '\0';
+}
+
+/**
+ * @brief +CMQTTRXTOPIC: <client>,<len> - topic bytes follow
+ */
+static void urc_rxtopic(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+
+    (void)type;
+    if (handle->rx_state == RX_HEADER) {
+        AT_Engine_Capture(&handle->at, urc_arg(line, len, 1), rx_topic_data);
+    }
+}
+
+/**
+ * @brief Captured payload bytes - handed on as they arrive
+ */
+static void rx_payload_data(void *ctx, const uint8_t *data, size_t len)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    size_t total = (handle->rx_total > 0) ? handle->rx_total : len;
+
+    /* Topic is whole once the payload starts */
+    if (handle->rx_route == RX_ROUTE_UNKNOWN) {
+        handle->rx_route = rx_route_find(handle);
+    }
+
+    /* Callbacks run inside the tokenizer - no driver calls from them */
+    handle->in_hook = true;
+    if (handle->rx_route != RX_ROUTE_NONE) {
+        handle->routes[handle->rx_route].handler(rx_topic, data, len, handle->rx_offset, total);
+    } else if (handle->chunk_callback != NULL) {
+        handle->chunk_callback(rx_topic, data, len, handle->rx_offset, total);
+    } else if (handle->msg_callback != NULL) {
+        if (handle->rx_offset == 0 && len == total) {
+            handle->msg_callback(rx_topic, data, len);
+        } else {
+            LOG_WARN("Rx message split (%d B) - needs a chunk callback", (int)total);
+        }
+    }
+    handle->in_hook = false;
+
+    handle->rx_offset += len;
+}
+
+/**
+ * @brief +CMQTTRXPAYLOAD: <client>,<len> - payload bytes follow (may repeat)
+ */
+static void urc_rxpayload(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+
+    (void)type;
+    if (handle->rx_state == RX_HEADER) {
+        AT_Engine_Capture(&handle->at, urc_arg(line, len, 1), rx_payload_data);
+    }
+}
+
+/**
+ * @brief +CMQTTRXEND: <client> - message complete
+ */
+static void urc_rxend(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+
+    (void)line; (void)len; (void)type;
+    if (handle->rx_state == RX_HEADER) {
+        LOG_INFO("Parsed Msg - Topic: %s, PayloadLen: %d", rx_topic, (int)handle->rx_offset);
+    }
+    handle->rx_state = RX_IDLE;
+}
+
+/**
+ * @brief Socket transport: inbound PUBLISH payload bytes
+ */
+static void sock_payload(void *ctx, const uint8_t *data, size_t len, size_t offset, size_t total)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    if (len == 0) {
+        return;
+    }
+    handle->rx_offset = offset;
+    handle->rx_total = total;
+    rx_payload_data(handle, data, len);
+}
+
+/**
+ * @brief Socket transport: end of an inbound packet
+ */
+static void sock_packet(void *ctx, uint8_t type, const uint8_t *head)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint8_t client = handle->sock_rx_client;
+    uint8_t bit = (uint8_t)(1u << client);
+    
+    switch (type & 0xF0) {
+    case MQTT_PKT_CONNACK:
+        /* <flags: session present>,<return code> */
+        if (head[1] != 0) {
+            LOG_ERROR("CONNACK refused (client %u): %u", (unsigned)client, (unsigned)head[1]);
+            break;
+        }
+        if (!(head[0] & 0x01)) {
+            handle->subscribed &= (uint8_t)~bit;  /* Broker has no session for us */
+        }
+        handle->sock_connack |= bit;
+        break;
+    
+    case MQTT_PKT_SUBACK:
+        /* <id>,<return code per topic> - 0x80 is failure */
+        if (head[2] != 0x80) {
+            handle->subscribed |= bit;
+        }
+        handle->sock_suback |= bit;
+        break;
+    
+    case MQTT_PKT_PUBACK:
+        pub_resolve(handle, client, 0);
+        break;
+    
+    case MQTT_PKT_PUBLISH:
+        LOG_INFO("Parsed Msg - Topic: %s, PayloadLen: %d", rx_topic, (int)handle->rx_offset);
+        if (type & 0x06) {
+            /* QoS 1 - acknowledged from A7600_MQTT_Process (no commands from the tokenizer) */
+            handle->sock_ack_id[client] = (uint16_t)((head[2] << 8) | head[3]);
+        }
+        rx_topic_reset(handle);
+        handle->rx_offset = 0;
+        break;
+    
+    default:
+        break;  /* PINGRESP, UNSUBACK */
+    }
+}
+
+static const MQTT_PacketOps_t sock_ops = { sock_packet, rx_topic_data, sock_payload };
+
+/**
+ * @brief Captured socket bytes - into the session's packet decoder
+ */
+static void sock_rx_data(void *ctx, const uint8_t *data, size_t len)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    MQTT_PacketRx_Feed(&handle->sock_rx[handle->sock_rx_client], data, len, &sock_ops, handle);
+}
+
+/**
+ * @brief +CCHRECV: DATA,<session>,<len> - socket bytes follow (direct receive mode)
+ */
+static void urc_cchrecv(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    const char *p = urc_field(line, len, 0);
+    uint8_t client = (uint8_t)urc_arg(line, len, 1);
+    
+    (void)type;
+    if (line + len - p < 5 || memcmp(p, "DATA,", 5) != 0 || client >= MQTT_MAX_CLIENTS) {
+        return;
+    }
+    handle->sock_rx_client = client;
+    AT_Engine_Capture(&handle->at, urc_arg(line, len, 2), sock_rx_data);
+}
+
+/**
+ * @brief +CCH_PEER_CLOSED: <session> / +CCHCLOSE: <session>,<err> - socket gone
+ */
+static void urc_cchclose(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint8_t client = (uint8_t)urc_arg(line, len, 0);
+    
+    (void)type;
+    if (SOCKET_MODE(handle) && client < MQTT_MAX_CLIENTS) {
+        session_lost(handle, client);
+    }
+}
+
+/**
+ * @brief +IPCLOSE: <link>,<reason> / +CIPEVENT: NETWORK CLOSED UNEXPECTEDLY
+ */
+static void urc_ipclose(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    (void)type;
+    if (handle->udp_up && (line[1] == 'C' || urc_arg(line, len, 0) == 0)) {
+        LOG_WARN("Datagram link closed");
+        handle->udp_up = false;
+    }
+}
+
+/**
+ * @brief +CPIN: <code> - reported unsolicited once the SIM is initialised
+ */
+static void urc_cpin(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    (void)type;
+    if (!(handle->modem_flags & BOOT_SIM)) {
+        LOG_INFO_M(LOG_MOD_AT, "Module: %.*s", (int)len, line);
+    }
+    handle->modem_flags |= BOOT_SIM;  /* READY or not - connect step 2 reports the rest */
+}
+
+/**
+ * @brief Plain (non '+') lines outside any response: boot progress banners
+ */
+static void mqtt_line(void *ctx, const char *line, size_t len, AT_LineType_t type)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint8_t flag = 0;
+    
+    (void)type;
+    if (len == 3 && memcmp(line, "RDY", 3) == 0) {
+        flag = BOOT_RDY;
+        handle->rdy_tick = HAL_GetTick();
+        BootProfile_Mark(BOOT_MARK_RDY);
+        handle->udp_up = false;     /* Module restarted */
+        handle->ssl_cfg_ok = false;
+        handle->csclk = false;
+#if MQTT_CMUX
+        Cmux_Stop(&handle->mux);    /* Heard in plain text: it left CMUX */
+#endif
+    } else if (len == 8 && memcmp(line, "SMS DONE", 8) == 0) {
+        flag = BOOT_SMS;
+    } else if (len == 7 && memcmp(line, "PB DONE", 7) == 0) {
+        flag = BOOT_PB;
+    }
+    if (flag != 0) {
+        LOG_INFO_M(LOG_MOD_AT, "Module: %.*s", (int)len, line);
+        handle->modem_flags |= flag;
+    }
+}
+
+/* URCs handled whatever command is in flight */
+static const AT_Urc_t mqtt_urcs[] = {
+    { "+CMQTTCONNLOST:",    urc_connlost },
+    { "+CPIN:",             urc_cpin },
+    { "+CMQTTPUB:",         urc_pub },
+    { "+CREG:",             urc_reg },
+    { "+CGREG:",            urc_reg },
+    { "+CEREG:",            urc_reg },
+    { "+CSQ:",              urc_csq },
+    { "+CPSI:",             urc_cpsi },
+    { "+CCLK:",             urc_cclk },
+    { "+CSSLCFG:",          urc_csslcfg },
+    { "+CCERTLIST:",        urc_certlist },
+    { "+CMQTTRXSTART:",     urc_rxstart },
+    { "+CMQTTRXTOPIC:",     urc_rxtopic },
+    { "+CMQTTRXPAYLOAD:",   urc_rxpayload },
+    { "+CMQTTRXEND:",       urc_rxend },
+    { "+CCHRECV:",          urc_cchrecv },
+    { "+CCH_PEER_CLOSED:",  urc_cchclose },
+    { "+CCHCLOSE:",         urc_cchclose },
+    { "+IPCLOSE:",          urc_ipclose },
+    { "+CIPEVENT:",         urc_ipclose }
+};
+
+/* ==================== Asynchronous Operations ==================== */
+
+/**
+ * @brief Engine completion of a step command
+ */
+static void op_at_done(void *ctx, AT_Result_t result)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    handle->op_res = result;
+    handle->op_pending = false;
+}
+
+/**
+ * @brief Submit the command of the current step once
+ * @return true when its result is in handle->op_res
+ */
+static bool op_cmd(A7600_MQTT_Handle_t *handle, const void *data, size_t len, AT_SendFn_t send,
+                   const char *expected, uint32_t timeout_ms, uint16_t delay_ms, uint8_t flags)
+{
+    AT_Cmd_t cmd;
+    
+    if (handle->op_issued) {
+        return true;
+    }
+    
+    cmd.data = (const uint8_t *)data;
+    cmd.len = len;
+    cmd.send = send;
+    cmd.expected = expected;
+    cmd.timeout_ms = timeout_ms;
+    cmd.delay_ms = delay_ms;
+    cmd.flags = flags;
+    cmd.on_done = op_at_done;
+    cmd.ctx = handle;
+    
+    if (AT_Engine_Submit(&handle->at, &cmd)) {
+        handle->op_issued = true;
+        handle->op_pending = true;
+    }
+    return false;
+}
+
+/**
+ * @brief Submit a constant AT command string for the current step
+ */
+static bool op_at(A7600_MQTT_Handle_t *handle, const char *cmd, const char *expected,
+                  uint32_t timeout_ms, uint16_t delay_ms)
+{
+    if (!handle->op_issued) {
+        LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    }
+    return op_cmd(handle, cmd, strlen(cmd), NULL, expected, timeout_ms, delay_ms, 0);
+}
+
+/**
+ * @brief Charge the time since the last mark to the current connect step
+ */
+static void conn_mark(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t now = HAL_GetTick();
+    
+    if (handle->op == MQTT_OP_CONNECT && handle->op_step < CONN_STEP_COUNT) {
+        handle->conn_stats.step_ms[conn_steps[handle->op_step].phase] += now - handle->conn_tick;
+    }
+    handle->conn_tick = now;
+}
+
+static void op_next(A7600_MQTT_Handle_t *handle, uint8_t step)
+{
+    /* Moving on past the last command of a step ends it (retries go back, tiers skip ahead) */
+    if (handle->op == MQTT_OP_CONNECT && step > handle->op_step && handle->op_step < CONN_STEP_COUNT &&
+        (step >= CONN_STEP_COUNT || conn_steps[step].phase != conn_steps[handle->op_step].phase)) {
+        BootProfile_Mark((BootProfile_Mark_t)(BOOT_MARK_STEP + conn_steps[handle->op_step].phase));
+    }
+    conn_mark(handle);
+    handle->op_step = step;
+    handle->op_retry = 0;
+    handle->op_issued = false;
+}
+
+static void op_again(A7600_MQTT_Handle_t *handle)
+{
+    if (handle->op == MQTT_OP_CONNECT && handle->op_step < CONN_STEP_COUNT) {
+        handle->conn_stats.retries[conn_steps[handle->op_step].phase]++;
+    }
+    handle->op_retry++;
+    handle->op_issued = false;
+}
+
+/**
+ * @brief End the running operation and report it
+ */
+static void op_finish(A7600_MQTT_Handle_t *handle, MQTT_Result_t result)
+{
+    MQTT_DoneCallback_t done = handle->op_done;
+    void *ctx = handle->op_ctx;
+    
+    if (handle->op == MQTT_OP_CONNECT) {
+        if (result == MQTT_OK && handle->op_step < CONN_STEP_COUNT) {
+            BootProfile_Mark((BootProfile_Mark_t)(BOOT_MARK_STEP + conn_steps[handle->op_step].phase));
+        }
+        conn_mark(handle);
+        handle->conn_stats.total_ms = handle->conn_tick - handle->conn_stats.start_tick;
+        handle->conn_stats.tier = handle->op_tier;
+        if (result == MQTT_OK) {
+            handle->pdp_suspect = false;    /* Data gets through after all */
+        }
+        if (result == MQTT_OK && handle->op_tier == TIER_FULL) {
+            acq_note(handle);
+        }
+    }
+    handle->op = MQTT_OP_NONE;
+    handle->op_result = result;
+    handle->op_done = NULL;
+    
+    if (done != NULL) {
+        done(ctx, result);
+    }
+}
+
+/**
+ * @brief FNV-1a of a host name - ties the saved address to the broker it was looked up for
+ */
+static uint32_t host_hash(const char *host)
+{
+    return fnv1a(FNV_OFFSET, (const uint8_t *)host, strlen(host));
+}
+
+/**
+ * @brief CONNECT goes to the cached address rather than the host name
+ */
+static bool broker_by_ip(A7600_MQTT_Handle_t *handle)
+{
+    return (handle->config.connect_by_ip && handle->ep == 0 && handle->dns_ip != 0 && !handle->dns_skip);
+}
+
+/**
+ * @brief Host name of a broker endpoint - NULL if that slot is not configured
+ */
+static const char *ep_host(A7600_MQTT_Handle_t *handle, uint8_t ep)
+{
+    const char *host = (ep == 0) ? handle->config.broker : handle->config.standby[ep - 1].broker;
+    
+    return (host != NULL && host[0] != '\0') ? host : NULL;
+}
+
+/**
+ * @brief Port of the current endpoint - standby entries without one share config.port
+ */
+static uint16_t ep_port(A7600_MQTT_Handle_t *handle)
+{
+    uint16_t port = (handle->ep == 0) ? 0 : handle->config.standby[handle->ep - 1].port;
+    
+    return (port != 0) ? port : handle->config.port;
+}
+
+/**
+ * @brief Endpoint can be picked: configured, and not failing or failed long enough ago to try again
+ */
+static bool ep_usable(A7600_MQTT_Handle_t *handle, uint8_t ep, uint32_t now)
+{
+    const MQTT_EndpointHealth_t *h = &handle->ep_health[ep];
+    
+    return (ep_host(handle, ep) != NULL &&
+            (h->fails < MQTT_EP_FAILS || now - h->fail_tick >= MQTT_EP_RETRY));
+}
+
+/**
+ * @brief Ranking key - CONNACK latency, endpoints never measured after every measured one
+ */
+static uint32_t ep_rank(A7600_MQTT_Handle_t *handle, uint8_t ep)
+{
+    uint16_t ms = handle->ep_health[ep].connack_ms;
+    
+    return (ms != 0) ? ms : 0x10000UL;
+}
+
+/**
+ * @brief Endpoint for the next CONNECT: the fastest usable one, but the current one is kept
+ *        unless another is a quarter faster (ties go by list order)
+ */
+static uint8_t ep_pick(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t best = handle->ep;
+    uint32_t best_rank = ep_usable(handle, best, now) ? ep_rank(handle, best) * 3U / 4U : UINT32_MAX;
+    
+    for (uint8_t i = 0; i < MQTT_MAX_ENDPOINTS; i++) {
+        if (i != handle->ep && ep_usable(handle, i, now) && ep_rank(handle, i) < best_rank) {
+            best = i;
+            best_rank = ep_rank(handle, i);
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief CONNECT to the current endpoint answered - fold its latency into the health record
+ */
+static void ep_connected(A7600_MQTT_Handle_t *handle)
+{
+    MQTT_EndpointHealth_t *h = &handle->ep_health[handle->ep];
+    uint32_t ms = HAL_GetTick() - handle->ep_tick;
+    
+    if (ms == 0) {
+        ms = 1;                         /* 0 means not measured */
+    } else if (ms > UINT16_MAX) {
+        ms = UINT16_MAX;
+    }
+    h->connack_ms = h->connack_ms ? (uint16_t)((3U * h->connack_ms + ms) / 4U) : (uint16_t)ms;
+    h->fails = 0;
+    if (h->connects < UINT16_MAX) {
+        h->connects++;
+    }
+}
+
+/**
+ * @brief CONNECT to the current endpoint failed - after MQTT_EP_FAILS in a row go on with the
+ *        next one, from the session setup (PDP and registration are kept)
+ * @return true if the connect carries on with another endpoint
+ */
+static bool ep_failed(A7600_MQTT_Handle_t *handle)
+{
+    MQTT_EndpointHealth_t *h = &handle->ep_health[handle->ep];
+    uint8_t from = handle->ep;
+    
+    h->fail_tick = HAL_GetTick();
+    if (h->fails < UINT8_MAX) {
+        h->fails++;
+    }
+    /* A session already up on this broker stays with it */
+    if (h->fails < MQTT_EP_FAILS || handle->client_up != 0) {
+        return false;
+    }
+    handle->ep = ep_pick(handle);
+    if (handle->ep == from) {
+        return false;
+    }
+    LOG_WARN("Broker %s failed %u times - failing over to %s", ep_host(handle, from),
+             (unsigned)h->fails, ep_host(handle, handle->ep));
+    handle->conn_stats.failovers++;
+    
+    /* Socket mode: the failed socket may still be open - close them all first */
+    if (SOCKET_MODE(handle) || handle->op_tier > TIER_CLIENT) {
+        handle->op_tier = TIER_CLIENT;
+    }
+    handle->op_client = 0;
+    op_next(handle, TIER_START(handle, handle->op_tier));
+    return true;
+}
+
+/**
+ * @brief Broker host for CMQTTCONNECT / CCHOPEN - the cached address if there is one
+ */
+static const char *broker_host(A7600_MQTT_Handle_t *handle, char *buf, size_t size)
+{
+    uint32_t ip = handle->dns_ip;
+    
+    if (!broker_by_ip(handle)) {
+        return ep_host(handle, handle->ep);
+    }
+    snprintf(buf, size, "%u.%u.%u.%u", (unsigned)(ip >> 24), (unsigned)((ip >> 16) & 0xFF),
+             (unsigned)((ip >> 8) & 0xFF), (unsigned)(ip & 0xFF));
+    return buf;
+}
+
+/**
+ * @brief Take a carrier profile: its APN (and credentials, at CONN_APN) for the PDP context
+ */
+static void carrier_use(A7600_MQTT_Handle_t *handle, const Carrier_Profile_t *carrier, const char *how)
+{
+    handle->carrier = carrier;
+    handle->config.apn = carrier->apn;
+    LOG_INFO("Carrier %s (%s): APN %s", carrier->name, how, carrier->apn);
+}
+
+/**
+ * @brief Whether the band of the last full connect is worth searching first: there is
+ *        one (in the AT+CNBP LTE mask), the module is not registered yet, and the SIM's
+ *        home network, when its profile names one, is the network it was found on
+ */
+static bool acq_hint(A7600_MQTT_Handle_t *handle)
+{
+    const char *home = (handle->carrier != NULL) ? handle->carrier->plmn : "";
+    uint32_t mcc = 0;
+    uint32_t mnc = 0;
+    
+    if (!MQTT_FAST_ACQ || handle->acq_plmn == 0 || handle->acq_band == 0 || handle->acq_band > 64 ||
+        (REG_OK(handle->reg_cs) && REG_OK(handle->reg_ps))) {
+        return false;
+    }
+    if (strlen(home) < 5) {
+        return true;
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        mcc = mcc * 10U + (uint32_t)(home[i] - '0');
+    }
+    for (home += 3; *home != '\0'; home++) {
+        mnc = mnc * 10U + (uint32_t)(*home - '0');
+    }
+    return (mcc * 1000U + mnc == handle->acq_plmn);
+}
+
+/**
+ * @brief A full connect is up - remember where, for the next cold one
+ */
+static void acq_note(A7600_MQTT_Handle_t *handle)
+{
+    if (!MQTT_FAST_ACQ || handle->link.plmn == 0 || handle->link.band == 0 ||
+        (handle->link.plmn == handle->acq_plmn && handle->link.band == handle->acq_band)) {
+        return;
+    }
+    handle->acq_plmn = handle->link.plmn;
+    handle->acq_band = handle->link.band;
+    handle->acq_dirty = true;
+}
+
+/**
+ * @brief First run of at least CARRIER_PLMN_DIGITS digits in a response (the IMSI line)
+ * @return Pointer to it, or NULL
+ */
+static const char *imsi_find(const char *text)
+{
+    while (*text != '\0') {
+        size_t n = strspn(text, "0123456789");
+        
+        if (n >= CARRIER_PLMN_DIGITS) {
+            return text;
+        }
+        text += (text[n] != '\0') ? n + 1 : n;
+    }
+    return NULL;
+}
+
+static void connect_fail(A7600_MQTT_Handle_t *handle, uint8_t step)
+{
+    handle->error_step = step;
+    strncpy(handle->last_response, (char *)handle->at.rx_buf, sizeof(handle->last_response) - 1);
+    handle->last_response[sizeof(handle->last_response) - 1] = '\0';
+    if (step >= 9) {
+        handle->ssl_cfg_ok = false;     /* TLS failed - read context 0 back on the next attempt */
+    }
+    if (broker_by_ip(handle) && step == (SOCKET_MODE(handle) ? 8 : 10)) {
+        /* Address may be stale - back to the name, look it up again once a session is up */
+        LOG_WARN("Cached broker address failed - connecting by name");
+        handle->dns_ip = 0;
+        handle->dns_tick = 0;
+        handle->dns_skip = true;
+        handle->dns_dirty = true;
+    }
+    if (handle->op_tier == TIER_FULL && handle->conn_stats.pdp_kept && step >= (SOCKET_MODE(handle) ? 8 : 9)) {
+        /* Nothing got through over a bearer this connect did not set up - the
+         * next full connect recycles it (a fresh one is not suspected, so
+         * never twice in a row) */
+        handle->pdp_suspect = true;
+    }
+    if ((step == 10 || (SOCKET_MODE(handle) && step == 8)) && ep_failed(handle)) {
+        return;
+    }
+    if (handle->op_tier < TIER_FULL) {
+        handle->op_tier++;
+        LOG_WARN("Reconnect failed at step %u - escalating to tier %u", (unsigned)step, (unsigned)handle->op_tier);
+        handle->op_client = 0;
+        op_next(handle, TIER_START(handle, handle->op_tier));
+        return;
+    }
+    handle->op_client = 0;
+    handle->state = MQTT_STATE_ERROR;
+    op_finish(handle, MQTT_ERROR);
+}
+
+/**
+ * @brief Check whether the session being connected carries the last will
+ */
+static bool will_here(A7600_MQTT_Handle_t *handle)
+{
+    return (handle->config.will.topic != NULL && handle->config.will.msg != NULL &&
+            handle->op_client == handle->config.will_client);
+}
+
+/**
+ * @brief Step after the client is acquired (and its will set)
+ */
+static uint8_t accq_next(A7600_MQTT_Handle_t *handle)
+{
+    if (!handle->config.use_ssl) {
+        return CONN_BROKER;
+    }
+    /* SSL context 0 is shared - only the first client checks / writes it */
+    return handle->op_client ? CONN_SSL_BIND : CONN_SSL_QUERY;
+}
+
+/**
+ * @brief A will step is done - a failure leaves the session without one, the connect goes on
+ */
+static void will_next(A7600_MQTT_Handle_t *handle, uint8_t next)
+{
+    if (handle->op_res != AT_OK) {
+        LOG_WARN("Last will not set (client %u) - connecting without it", (unsigned)handle->op_client);
+        next = accq_next(handle);
+    }
+    op_next(handle, next);
+}
+
+/**
+ * @brief Command builders - run when the command reaches the wire
+ */
+static bool send_accq(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    
+    /* Broker needs distinct IDs - the second session gets a "-1" suffix */
+    int n = handle->op_client ?
+            snprintf(cmd, sizeof(cmd), "AT+CMQTTACCQ=%u,\"%s-%u\",1\r\n", (unsigned)handle->op_client,
+                     handle->config.client_id, (unsigned)handle->op_client) :
+            snprintf(cmd, sizeof(cmd), "AT+CMQTTACCQ=0,\"%s\",1\r\n", handle->config.client_id);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_dnsgip(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    
+    int n = snprintf(cmd, sizeof(cmd), "AT+CDNSGIP=\"%s\"\r\n", handle->config.broker);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_apn(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    
+    const Carrier_Profile_t *carrier = handle->carrier;
+    int n;
+    
+    if (carrier == NULL) {
+        n = snprintf(cmd, sizeof(cmd), "AT+CGDCONT=1,\"IP\",\"%s\"\r\n", handle->config.apn);
+    } else if (carrier->auth != CARRIER_AUTH_NONE) {
+        /* SIMCom order: password before user name */
+        n = snprintf(cmd, sizeof(cmd), "AT+CGDCONT=1,\"IP\",\"%s\";+CGAUTH=1,%u,\"%s\",\"%s\"\r\n",
+                     handle->config.apn, (unsigned)carrier->auth, carrier->pass, carrier->user);
+    } else {
+        /* Clears what another SIM's profile left */
+        n = snprintf(cmd, sizeof(cmd), "AT+CGDCONT=1,\"IP\",\"%s\";+CGAUTH=1,0\r\n", handle->config.apn);
+    }
+    LOG_INFO_M(LOG_MOD_AT, "CMD: AT+CGDCONT=1,\"IP\",\"%s\"", handle->config.apn);   /* Credentials kept out of the log */
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_rat(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[24];
+    
+    int n = snprintf(cmd, sizeof(cmd), "AT+CNMP=%u\r\n", (unsigned)handle->carrier->rat);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+#if MQTT_CMUX
+/**
+ * @brief AT+CMUX <port_speed> code of a baud rate (0: none)
+ */
+static uint8_t cmux_speed(uint32_t baud)
+{
+    static const uint32_t speeds[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+    
+    for (uint8_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        if (speeds[i] == baud) {
+            return (uint8_t)(i + 1);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief AT+CMUX=0,0,<port_speed>,<N1> - basic option, UIH frames, at the current rate
+ */
+static bool send_cmux(void *ctx, UART_DMA_Handle_t *uart)
+{
+    char cmd[32];
+    
+    (void)ctx;
+    int n = snprintf(cmd, sizeof(cmd), "AT+CMUX=0,0,%u,%u\r\n",
+                     (unsigned)cmux_speed(UART_DMA_GetBaudRate(uart)), (unsigned)CMUX_N1);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+#endif
+
+static bool send_acq_lock(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint8_t bit = (uint8_t)(handle->acq_band - 1);
+    char cmd[72];
+    
+    /* 64-bit LTE mask in two halves - bit n - 1 is band n */
+    int n = snprintf(cmd, sizeof(cmd), "AT%s+CNBP=" MQTT_ACQ_BANDS_2G3G ",0x%08lX%08lX\r\n",
+                     MQTT_ACQ_LTE_ONLY ? "+CNMP=38;" : "",
+                     (unsigned long)((bit >= 32) ? (1UL << (bit - 32)) : 0),
+                     (unsigned long)((bit < 32) ? (1UL << bit) : 0));
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_acq_open(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[64];
+    int n = 2;
+    
+    /* Radio access back to the carrier profile's, automatic if it leaves it */
+    memcpy(cmd, "AT", 2);
+    if (MQTT_ACQ_LTE_ONLY) {
+        n = snprintf(cmd, sizeof(cmd), "AT+CNMP=%u;",
+                     (handle->carrier != NULL && handle->carrier->rat != 0) ? (unsigned)handle->carrier->rat : 2U);
+    }
+    n += snprintf(&cmd[n], sizeof(cmd) - (size_t)n, "+CNBP=" MQTT_ACQ_BANDS_2G3G "," MQTT_ACQ_BANDS_LTE "\r\n");
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_ssl_auth(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    int n;
+    
+    if (handle->config.ca_cert != NULL) {
+        n = snprintf(cmd, sizeof(cmd), "AT+CSSLCFG=\"authmode\",0,1;+CSSLCFG=\"cacert\",0,\"%s\"\r\n",
+                     handle->ca_name);
+    } else {
+        n = snprintf(cmd, sizeof(cmd), "AT+CSSLCFG=\"authmode\",0,0\r\n");
+    }
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_certdown(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    int n = snprintf(cmd, sizeof(cmd), "AT+CCERTDOWN=\"%s\",%u\r\n", handle->ca_name,
+                     (unsigned)handle->config.ca_cert_len);
+    
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_filedown(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    int n = snprintf(cmd, sizeof(cmd),
+                     (handle->op_index == MQTT_FILE_CERT) ? "AT+CCERTDOWN=\"%s\",%u\r\n"
+                                                          : "AT+CFTRANRX=\"c:/%s\",%u\r\n",
+                     handle->op_topic, (unsigned)handle->op_len);
+    
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_broker(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    char ip[16];
+    
+    int n = snprintf(cmd, sizeof(cmd),
+                     "AT+CMQTTCONNECT=%u,\"tcp://%s:%d\",%d,%d,\"%s\",\"%s\"\r\n",
+                     (unsigned)handle->op_client,
+                     broker_host(handle, ip, sizeof(ip)),
+                     ep_port(handle),
+                     handle->ka_next,
+                     handle->config.persistent_session ? 0 : 1,  /* clean_session */
+                     handle->config.username,
+                     handle->config.password);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+/**
+ * @brief Send "<prefix><client><suffix>" as fragments
+ * @note  Prefix and suffix come with their lengths (AT_LIT), so nothing is
+ *        measured or formatted: the fragments are copied into the TX ring
+ */
+static bool send_client_cmd(UART_DMA_Handle_t *uart, const char *prefix, size_t prefix_len, uint8_t client,
+                            const char *suffix, size_t suffix_len)
+{
+    UART_DMA_Span_t iov[3];
+    char idx = (char)('0' + client);
+    
+    IOV_BUF(iov[0], prefix, prefix_len);
+    IOV_BUF(iov[1], &idx, 1);
+    IOV_BUF(iov[2], suffix, suffix_len);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s%c%s", prefix, idx, suffix);
+    return (UART_DMA_TransmitV(uart, iov, 3) == HAL_OK);
+}
+
+/**
+ * @brief Send "<prefix><client>,<value><suffix>" as fragments
+ */
+static bool send_num_cmd(UART_DMA_Handle_t *uart, const char *prefix, size_t prefix_len, uint8_t client,
+                         uint32_t value, const char *suffix, size_t suffix_len)
+{
+    UART_DMA_Span_t iov[4];
+    char idx[2] = { (char)('0' + client), ',' };
+    char num[10];
+    
+    IOV_BUF(iov[0], prefix, prefix_len);
+    IOV_BUF(iov[1], idx, 2);
+    IOV_BUF(iov[2], num, fmt_uint(num, value));
+    IOV_BUF(iov[3], suffix, suffix_len);
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s%u,%lu...", prefix, (unsigned)client, (unsigned long)value);
+    return (UART_DMA_TransmitV(uart, iov, 4) == HAL_OK);
+}
+
+static bool send_disc(void *ctx, UART_DMA_Handle_t *uart)
+{
+    uint8_t client = ((A7600_MQTT_Handle_t *)ctx)->op_client;
+    
+    return send_client_cmd(uart, AT_LIT("AT+CMQTTDISC="), client, AT_LIT(",60\r\n"));
+}
+
+static bool send_rel(void *ctx, UART_DMA_Handle_t *uart)
+{
+    uint8_t client = ((A7600_MQTT_Handle_t *)ctx)->op_client;
+    
+    return send_client_cmd(uart, AT_LIT("AT+CMQTTREL="), client, AT_LIT("\r\n"));
+}
+
+static bool send_ssl_bind(void *ctx, UART_DMA_Handle_t *uart)
+{
+    uint8_t client = ((A7600_MQTT_Handle_t *)ctx)->op_client;
+    
+    return send_client_cmd(uart, AT_LIT("AT+CMQTTSSLCFG="), client, AT_LIT(",0\r\n"));
+}
+
+static bool send_sub(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char suffix[4] = { ',', (char)('0' + handle->op_qos), '\r', '\n' };
+    
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTSUB="), handle->op_client, handle->op_topic_len, suffix, sizeof(suffix));
+}
+
+static bool send_subtopic(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char suffix[4] = { ',', (char)('0' + handle->op_qos), '\r', '\n' };
+    
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTSUBTOPIC="), handle->op_client, handle->op_topic_len,
+                        suffix, sizeof(suffix));
+}
+
+static bool send_sub_exec(void *ctx, UART_DMA_Handle_t *uart)
+{
+    uint8_t client = ((A7600_MQTT_Handle_t *)ctx)->op_client;
+    
+    return send_client_cmd(uart, AT_LIT("AT+CMQTTSUB="), client, AT_LIT("\r\n"));
+}
+
+static bool send_topic_len(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    if (handle->op_desc != NULL) {
+        return (UART_DMA_Transmit(uart, (const uint8_t *)handle->op_desc->cmd, handle->op_desc->cmd_len) == HAL_OK);
+    }
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTTOPIC="), handle->op_client, handle->op_topic_len, AT_LIT("\r\n"));
+}
+
+static bool send_payload_len(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTPAYLOAD="), handle->op_client, handle->op_len, AT_LIT("\r\n"));
+}
+
+static bool send_will_topic(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTWILLTOPIC="), handle->op_client,
+                        (uint32_t)strlen(handle->config.will.topic), AT_LIT("\r\n"));
+}
+
+static bool send_will_msg(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char suffix[4] = { ',', (char)('0' + (handle->config.will.qos & 0x03)), '\r', '\n' };
+    
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTWILLMSG="), handle->op_client,
+                        (uint32_t)strlen(handle->config.will.msg), suffix, sizeof(suffix));
+}
+
+static bool send_pub(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    if (handle->op_retain) {
+        return send_num_cmd(uart, AT_LIT("AT+CMQTTPUB="), handle->op_client, handle->op_qos, AT_LIT(",60,1\r\n"));
+    }
+    return send_num_cmd(uart, AT_LIT("AT+CMQTTPUB="), handle->op_client, handle->op_qos, AT_LIT(",60\r\n"));
+}
+
+/**
+ * @brief Socket transport builders: AT+CCH commands and MQTT packets framed here
+ */
+static bool send_cch_ssl(void *ctx, UART_DMA_Handle_t *uart)
+{
+    uint8_t client = ((A7600_MQTT_Handle_t *)ctx)->op_client;
+    
+    return send_client_cmd(uart, AT_LIT("AT+CCHSSLCFG="), client, AT_LIT(",0\r\n"));
+}
+
+static bool send_cch_open(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    char cmd[AT_CMD_MAX_LEN];
+    char ip[16];
+    
+    /* Client type 2: SSL/TLS using the context bound by AT+CCHSSLCFG */
+    int n = snprintf(cmd, sizeof(cmd), "AT+CCHOPEN=%u,\"%s\",%u,2\r\n", (unsigned)handle->op_client,
+                     broker_host(handle, ip, sizeof(ip)), (unsigned)ep_port(handle));
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+static bool send_cchsend(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    return send_num_cmd(uart, AT_LIT("AT+CCHSEND="), handle->op_client, handle->sock_len, AT_LIT("\r\n"));
+}
+
+static bool send_ctrl_cchsend(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    return send_num_cmd(uart, AT_LIT("AT+CCHSEND="), handle->sock_ctrl_client, handle->sock_ctrl_len, AT_LIT("\r\n"));
+}
+
+/**
+ * @brief CONNECT packet of the session being connected (out NULL: length only)
+ */
+static size_t sock_connect_pkt(A7600_MQTT_Handle_t *handle, uint8_t *out, size_t size)
+{
+    char id[MQTT_CLIENT_ID_MAX_LEN + 4];
+    
+    /* Broker needs distinct IDs - the second session gets a "-1" suffix, as with AT+CMQTTACCQ */
+    if (handle->op_client) {
+        snprintf(id, sizeof(id), "%s-%u", handle->config.client_id, (unsigned)handle->op_client);
+    } else {
+        snprintf(id, sizeof(id), "%s", handle->config.client_id);
+    }
+    return MQTT_Packet_Connect(out, size, id, handle->config.username, handle->config.password,
+                               handle->ka_next, !handle->config.persistent_session,
+                               will_here(handle) ? &handle->config.will : NULL);
+}
+
+static bool send_connect_pkt(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint8_t pkt[AT_CMD_MAX_LEN];
+    size_t n = sock_connect_pkt(handle, pkt, sizeof(pkt));
+    
+    if (UART_DMA_Transmit(uart, pkt, n) != HAL_OK) {
+        return false;
+    }
+    handle->sock_tx_tick[handle->op_client] = HAL_GetTick();
+    return true;
+}
+
+/**
+ * @brief Topic / QoS of a subscribe (single-topic calls leave op_topics NULL)
+ */
+static const char *sock_sub_topic(A7600_MQTT_Handle_t *handle, uint8_t i, uint8_t *qos)
+{
+    if (handle->op_topics == NULL) {
+        *qos = handle->op_qos;
+        return handle->op_topic;
+    }
+    *qos = (uint8_t)handle->op_qos_list[i];
+    return handle->op_topics[i];
+}
+
+/**
+ * @brief SUBSCRIBE packet with all topics of the operation (out NULL: length only)
+ */
+static size_t sock_subscribe_pkt(A7600_MQTT_Handle_t *handle, uint8_t *out)
+{
+    uint8_t count = (handle->op_topics != NULL) ? handle->op_count : 1;
+    size_t remaining = 2;
+    size_t n;
+    uint8_t qos;
+    
+    for (uint8_t i = 0; i < count; i++) {
+        remaining += 2 + strlen(sock_sub_topic(handle, i, &qos)) + 1;
+    }
+    if (out == NULL) {
+        return MQTT_Packet_Header(NULL, MQTT_PKT_SUBSCRIBE, remaining) + remaining;
+    }
+    
+    n = MQTT_Packet_Header(out, MQTT_PKT_SUBSCRIBE, remaining);
+    out[n++] = (uint8_t)(handle->sock_pkt_id >> 8);
+    out[n++] = (uint8_t)handle->sock_pkt_id;
+    for (uint8_t i = 0; i < count; i++) {
+        const char *topic = sock_sub_topic(handle, i, &qos);
+        
+        n += MQTT_Packet_String(&out[n], topic, strlen(topic));
+        out[n++] = qos;
+    }
+    return n;
+}
+
+static bool send_subscribe_pkt(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint8_t pkt[AT_CMD_MAX_LEN];
+    size_t n = sock_subscribe_pkt(handle, pkt);
+    
+    if (UART_DMA_Transmit(uart, pkt, n) != HAL_OK) {
+        return false;
+    }
+    handle->sock_tx_tick[handle->op_client] = HAL_GetTick();
+    return true;
+}
+
+/**
+ * @brief Bytes after the fixed header of the PUBLISH being sent
+ */
+static size_t sock_pub_remaining(A7600_MQTT_Handle_t *handle)
+{
+    return 2 + handle->op_topic_len + (handle->op_qos ? 2 : 0) + handle->op_len;
+}
+
+/**
+ * @brief PUBLISH bytes ahead of the payload: fixed header, topic, packet id
+ */
+static size_t sock_pub_head(A7600_MQTT_Handle_t *handle)
+{
+    return MQTT_Packet_Header(NULL, MQTT_PKT_PUBLISH, sock_pub_remaining(handle)) + sock_pub_remaining(handle) -
+           handle->op_len;
+}
+
+/**
+ * @brief Size the next AT+CCHSEND of the PUBLISH being sent
+ * @return false once the whole packet has gone
+ */
+static bool sock_pub_piece(A7600_MQTT_Handle_t *handle)
+{
+    size_t rest = sock_pub_head(handle) + handle->op_len - handle->sock_sent;
+    
+    handle->sock_len = (uint16_t)((rest < MQTT_SOCK_SEND_MAX) ? rest : MQTT_SOCK_SEND_MAX);
+    return (rest > 0);
+}
+
+/**
+ * @brief PUBLISH piece: header, topic and packet id copied (first piece), payload zero-copy behind them
+ * @note  The modem sees one contiguous packet, in MQTT_SOCK_SEND_MAX pieces
+ *        when longer; a retry (payload slot busy) does not queue the header again
+ */
+static bool send_publish_pkt(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    size_t topic_len = handle->op_topic_len;
+    size_t head = sock_pub_head(handle);
+    size_t from = handle->sock_sent;    /* Packet offset of this piece */
+    uint8_t hdr[MQTT_PKT_HEADER_MAX + 2];
+    uint8_t id[2] = { (uint8_t)(handle->sock_pkt_id >> 8), (uint8_t)handle->sock_pkt_id };
+    UART_DMA_Span_t iov[3];
+    size_t n;
+    
+    if (from == 0 && !handle->sock_hdr_sent) {
+        n = MQTT_Packet_Header(hdr, (uint8_t)(MQTT_PKT_PUBLISH | (handle->op_qos << 1) | handle->op_retain),
+                               sock_pub_remaining(handle));
+        hdr[n++] = (uint8_t)(topic_len >> 8);
+        hdr[n++] = (uint8_t)topic_len;
+        IOV_BUF(iov[0], hdr, n);
+        IOV_BUF(iov[1], handle->op_topic, topic_len);
+        IOV_BUF(iov[2], id, 2);
+        if (UART_DMA_TransmitV(uart, iov, handle->op_qos ? 3 : 2) != HAL_OK) {
+            return false;
+        }
+        handle->sock_hdr_sent = true;
+    }
+    if (from < head) {
+        from = head;    /* The header fits the first piece (topic below MQTT_TOPIC_MAX_LEN) */
+    }
+    if (handle->sock_sent + handle->sock_len > from &&
+        UART_DMA_TransmitZC(uart, &handle->op_payload[from - head], handle->sock_sent + handle->sock_len - from,
+                            NULL, NULL) == HAL_BUSY) {
+        return false;
+    }
+    handle->sock_hdr_sent = false;
+    handle->sock_tx_tick[handle->op_client] = HAL_GetTick();
+    return true;
+}
+
+/**
+ * @brief Datagram path builders: UDP link 0, datagrams to the configured endpoint
+ */
+static bool send_udp_open(void *ctx, UART_DMA_Handle_t *uart)
+{
+    char cmd[40];
+    int n = snprintf(cmd, sizeof(cmd), "AT+CIPOPEN=0,\"UDP\",,,%u\r\n", (unsigned)MQTT_UDP_LOCAL_PORT);
+    
+    (void)ctx;
+    LOG_INFO_M(LOG_MOD_AT, "CMD: %s", cmd);
+    return (UART_DMA_Transmit(uart, (uint8_t *)cmd, (size_t)n) == HAL_OK);
+}
+
+/**
+ * @brief AT+CIPSEND=0,<len>,"<host>",<port> - once per datagram, so built from fragments
+ */
+static bool send_cipsend(void *ctx, UART_DMA_Handle_t *uart)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    UART_DMA_Span_t iov[7];
+    char len[5], port[5];
+    
+    IOV_STR(iov[0], "AT+CIPSEND=0,");
+    IOV_BUF(iov[1], len, fmt_uint(len, handle->udp_len));
+    IOV_STR(iov[2], ",\"");
+    IOV_BUF(iov[3], handle->config.udp_host, handle->udp_host_len);
+    IOV_STR(iov[4], "\",");
+    IOV_BUF(iov[5], port, fmt_uint(port, handle->config.udp_port));
+    IOV_STR(iov[6], "\r\n");
+    return (UART_DMA_TransmitV(uart, iov, 7) == HAL_OK);
+}
+
+/**
+ * @brief Next packet identifier (never 0)
+ */
+static uint16_t sock_next_id(A7600_MQTT_Handle_t *handle)
+{
+    if (++handle->sock_pkt_id == 0) {
+        handle->sock_pkt_id = 1;
+    }
+    return handle->sock_pkt_id;
+}
+
+/**
+ * @brief Run a CONNECT_STEPS row that has a command
+ */
+static void connect_table_step(A7600_MQTT_Handle_t *handle, const Conn_Step_t *st)
+{
+    uint8_t next = SOCKET_MODE(handle) ? st->sock_next : st->next;
+    
+    if (!handle->op_issued && (st->flags & CS_SSL_CACHED) && handle->ssl_cfg_ok) {
+        op_next(handle, next);
+        return;
+    }
+    if (!op_at(handle, st->cmd, st->expected, st->timeout_ms, handle->op_retry ? CONN_RETRY_DELAY : 0)) {
+        return;
+    }
+    if (handle->op_res != AT_OK && handle->op_retry < st->retries) {
+        op_again(handle);
+        return;
+    }
+    if (handle->op_res != AT_OK && st->fail != 0) {
+        LOG_ERROR("Connect step %u failed: %s", (unsigned)handle->op_step, st->cmd);
+        connect_fail(handle, st->fail);
+        return;
+    }
+    handle->op_tick = HAL_GetTick();    /* Start of a following timed wait step */
+    op_next(handle, next);
+}
+
+static void connect_done(A7600_MQTT_Handle_t *handle);
+
+/**
+ * @brief Session op_client is connected - go on with the next one, or finish
+ */
+static void connect_session_up(A7600_MQTT_Handle_t *handle, uint8_t next)
+{
+    if (++handle->op_client < handle->clients) {
+        op_next(handle, next);
+        return;
+    }
+    handle->op_client = 0;
+    
+    if (handle->config.udp_host != NULL && handle->config.udp_port != 0 && !handle->udp_up) {
+        handle->udp_host_len = (uint8_t)strlen(handle->config.udp_host);
+        op_next(handle, CONN_UDP_NETQ);
+        return;
+    }
+    connect_done(handle);
+}
+
+/**
+ * @brief Datagram path could not be opened - the sessions are up regardless
+ */
+static void udp_open_failed(A7600_MQTT_Handle_t *handle, const char *what)
+{
+    LOG_WARN("Datagram path unavailable (%s) - streams stay on MQTT", what);
+    connect_done(handle);
+}
+
+/**
+ * @brief +CIPOPEN: 0,<err> reply of CONN_UDP_OPEN
+ * @return true if the link is open (err 4: still open from before the reconnect)
+ */
+static bool udp_opened(A7600_MQTT_Handle_t *handle)
+{
+    const char *reply = strstr((char *)handle->at.rx_buf, "+CIPOPEN: 0,");
+    uint32_t err;
+    
+    if (handle->op_res != AT_OK || reply == NULL) {
+        return false;
+    }
+    err = urc_arg(reply, strlen(reply), 1);
+    return (err == 0 || err == 4);
+}
+
+/**
+ * @brief Broker address is missing or older than MQTT_DNS_TTL - look it up before connecting
+ */
+static bool dns_stale(A7600_MQTT_Handle_t *handle)
+{
+    return (handle->config.connect_by_ip && handle->ep == 0 && !handle->dns_skip && handle->op_client == 0 &&
+            (handle->dns_tick == 0 || HAL_GetTick() - handle->dns_tick >= MQTT_DNS_TTL));
+}
+
+/**
+ * @brief Address of a +CDNSGIP: 1,"<host>","<a.b.c.d>" reply (0 = lookup failed)
+ */
+static uint32_t dns_parse(const char *reply)
+{
+    const char *p;
+    uint32_t ip = 0;
+    uint8_t i;
+    
+    if (reply == NULL || urc_arg(reply, strlen(reply), 0) != 1) {
+        return 0;
+    }
+    p = strstr(reply, "\",\"");
+    if (p == NULL) {
+        return 0;
+    }
+    p += 3;
+    for (i = 0; i < 4; i++) {
+        uint32_t octet = 0;
+        
+        if (*p < '0' || *p > '9') {
+            return 0;
+        }
+        while (*p >= '0' && *p <= '9') {
+            octet = octet * 10 + (uint32_t)(*p++ - '0');
+        }
+        if (octet > 255 || (i < 3 && *p++ != '.')) {
+            return 0;
+        }
+        ip = (ip << 8) | octet;
+    }
+    return ip;
+}
+
+/**
+ * @brief CONN_DNS result - keep the address, or fall back to the old one / the name
+ */
+static void dns_resolved(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t ip = (handle->op_res == AT_OK) ?
+                  dns_parse(strstr((char *)handle->at.rx_buf, "+CDNSGIP:")) : 0;
+    
+    handle->dns_tick = HAL_GetTick();   /* Also after a failure - not retried on every reconnect */
+    if (handle->dns_tick == 0) {
+        handle->dns_tick = 1;
+    }
+    if (ip == 0) {
+        LOG_WARN("Broker lookup failed - %s", handle->dns_ip ? "using the cached address" : "connecting by name");
+        return;
+    }
+    if (ip != handle->dns_ip) {
+        handle->dns_ip = ip;
+        handle->dns_dirty = true;
+    }
+}
+
+/**
+ * @brief Network time step over - on to the MQTT service
+ */
+static void clock_done(A7600_MQTT_Handle_t *handle)
+{
+    handle->clock_ntp = false;
+    op_next(handle, SOCKET_MODE(handle) ? CONN_CCH_STOP : CONN_MQTT_DISC);
+}
+
+/**
+ * @brief Take the second clock_sec as starting at tick
+ */
+static void clock_set(A7600_MQTT_Handle_t *handle, uint32_t sec, uint32_t tick, bool edge)
+{
+    handle->clock_sec = sec;
+    handle->clock_tick = tick;
+    LOG_INFO("Network time %lu (%s)", (unsigned long)sec, edge ? "second edge" : "no edge, +-500 ms");
+    clock_done(handle);
+}
+
+/**
+ * @brief CONN_CLOCK result: AT+CCLK? counts whole seconds, so it is read
+ *        again every MQTT_CLOCK_POLL until the second turns over - the edge
+ *        lies between the two readings. A clock kept from an earlier sync
+ *        that still reads right is not polled again until MQTT_CLOCK_TTL.
+ */
+static void clock_reading(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t read = (handle->op_res == AT_OK) ? handle->clock_read : 0;
+    uint32_t tick = handle->clock_read_tick;
+    
+    if (handle->op_retry == 0) {
+        if (read == 0) {
+            /* Network sent no time - one NTP sync per connect, else none */
+            if (!handle->clock_ntp) {
+                handle->clock_ntp = true;
+                op_next(handle, CONN_NTP);
+                return;
+            }
+            LOG_WARN("No network time%s", handle->clock_sec ? " - keeping the last one" : "");
+            clock_done(handle);
+            return;
+        }
+        if (handle->clock_sec != 0 && tick - handle->clock_tick < MQTT_CLOCK_TTL) {
+            uint32_t kept = handle->clock_sec + (tick - handle->clock_tick) / 1000U;
+            
+            if (read + 1U >= kept && read <= kept + 1U) {
+                clock_done(handle);
+                return;
+            }
+        }
+    } else if (read != 0 && read != handle->clock_last) {
+        clock_set(handle, read, handle->clock_last_tick + (tick - handle->clock_last_tick) / 2U, true);
+        return;
+    } else if (read == 0 || handle->op_retry >= MQTT_CLOCK_POLLS) {
+        clock_set(handle, handle->clock_last, handle->clock_last_tick - 500U, false);
+        return;
+    }
+    
+    /* Polled without op_again: the readings are not connect retries */
+    handle->clock_last = read;
+    handle->clock_last_tick = tick;
+    handle->op_retry++;
+    handle->op_issued = false;
+}
+
+/**
+ * @brief All sessions connected - finish the connect operation
+ */
+static void connect_done(A7600_MQTT_Handle_t *handle)
+{
+    handle->state = MQTT_STATE_CONNECTED;
+    handle->connected = true;
+    handle->ka_used = handle->ka_next;
+    handle->ka_proven = false;
+    handle->up_tick = HAL_GetTick();
+    if (handle->config.use_ssl) {
+        handle->ssl_cfg_ok = true;      /* Context 0 proved itself - reused as is until the module restarts */
+    }
+    handle->dns_skip = false;
+    handle->conn_stats.endpoint = handle->ep;
+    LOG_INFO("MQTT Connected Successfully to %s", ep_host(handle, handle->ep));
+    op_finish(handle, MQTT_OK);
+}
+
+/**
+ * @brief Step after the link setup: the session check of a warm restart, or the SIM
+ */
+static uint8_t link_next(A7600_MQTT_Handle_t *handle)
+{
+    return (handle->op_warm && !SOCKET_MODE(handle)) ? CONN_WARM : CONN_CPIN;
+}
+
+/**
+ * @brief Broker a client's session is connected to, from the AT+CMQTTCONNECT? reply
+ * @note  "+CMQTTCONNECT: <c>,"tcp://<host>:<port>",<keepalive>,<clean>..." for a
+ *        connected client, "+CMQTTCONNECT: <c>" alone for one that is not
+ * @return Endpoint index, or MQTT_MAX_ENDPOINTS if not connected to one of ours
+ */
+static uint8_t warm_session(A7600_MQTT_Handle_t *handle, uint8_t client, uint16_t *keepalive)
+{
+    char prefix[32];
+    const char *line;
+    const char *host;
+    const char *colon;
+    uint32_t port = 0;
+    size_t len;
+    
+    snprintf(prefix, sizeof(prefix), "+CMQTTCONNECT: %u,\"tcp://", (unsigned)client);
+    line = strstr((char *)handle->at.rx_buf, prefix);
+    if (line == NULL) {
+        return MQTT_MAX_ENDPOINTS;
+    }
+    len = strcspn(line, "\r\n");
+    host = line + strlen(prefix);
+    colon = memchr(host, ':', len - (size_t)(host - line));
+    if (colon == NULL) {
+        return MQTT_MAX_ENDPOINTS;
+    }
+    *keepalive = (uint16_t)urc_arg(line, len, 2);
+    for (const char *p = colon + 1; *p >= '0' && *p <= '9'; p++) {
+        port = port * 10U + (uint32_t)(*p - '0');
+    }
+    
+    for (uint8_t ep = 0; ep < MQTT_MAX_ENDPOINTS; ep++) {
+        const char *name = ep_host(handle, ep);
+        uint16_t want = (ep == 0 || handle->config.standby[ep - 1].port == 0) ?
+                        handle->config.port : handle->config.standby[ep - 1].port;
+        
+        if (name != NULL && strlen(name) == (size_t)(colon - host) && memcmp(host, name, strlen(name)) == 0 &&
+            port == want) {
+            return ep;
+        }
+    }
+    return MQTT_MAX_ENDPOINTS;
+}
+
+/**
+ * @brief Take over the sessions the module kept across the MCU reset
+ * @return true if the PDP context is up and every client is connected to the same broker of ours
+ */
+static bool warm_resume(A7600_MQTT_Handle_t *handle)
+{
+    uint16_t keepalive = 0;
+    uint8_t ep = MQTT_MAX_ENDPOINTS;
+    
+    if (handle->op_res != AT_OK || strstr((char *)handle->at.rx_buf, "+CGACT: 1,1") == NULL) {
+        return false;
+    }
+    for (uint8_t c = 0; c < handle->clients; c++) {
+        uint8_t found = warm_session(handle, c, &keepalive);
+        
+        if (found == MQTT_MAX_ENDPOINTS || (c > 0 && found != ep)) {
+            return false;
+        }
+        ep = found;
+    }
+    handle->ep = ep;
+    if (keepalive != 0) {
+        handle->ka_next = keepalive;    /* What the broker holds the session to */
+    }
+    handle->client_up = (uint8_t)((1u << handle->clients) - 1u);
+    handle->conn_stats.resumed = true;
+    return true;
+}
+
+/**
+ * @brief Advance the connect sequence by one step
+ */
+static void connect_step(A7600_MQTT_Handle_t *handle)
+{
+    if (handle->op_step < CONN_STEP_COUNT && conn_steps[handle->op_step].cmd != NULL) {
+        connect_table_step(handle, &conn_steps[handle->op_step]);
+        return;
+    }
+    
+    switch (handle->op_step) {
+    case CONN_PROBE:
+        /* ========== Step 1: Test module communication ========== */
+        if (!op_at(handle, "AT\r\n", "OK", 500, handle->op_retry ? 200 : 0)) {
+            return;
+        }
+        if (handle->op_res == AT_OK) {
+#if MQTT_CMUX
+            handle->mux_cld = false;
+#endif
+            op_next(handle, CONN_LINK);
+        } else if (handle->op_retry < 2) {
+            op_again(handle);
+#if MQTT_CMUX
+        } else if (Cmux_GetState(&handle->mux) == CMUX_OPEN) {
+            /* Channel gone quiet - the module may have left CMUX without a word */
+            Cmux_Stop(&handle->mux);
+            op_next(handle, CONN_PROBE);
+        } else if (!handle->mux_cld) {
+            /* Still multiplexed from before an MCU reset? Close it down blind */
+            handle->mux_cld = true;
+            Cmux_Close(&handle->mux);
+            op_next(handle, CONN_PROBE);
+#endif
+        } else if (!handle->op_alt_baud && handle->config.baudrate != 0) {
+            /* Module keeps AT+IPR across MCU resets - try the other rate */
+            uint32_t other = (UART_DMA_GetBaudRate(handle->uart) == A7600_DEFAULT_BAUD) ?
+                             handle->config.baudrate : A7600_DEFAULT_BAUD;
+            UART_DMA_SetBaudRate(handle->uart, other);
+            handle->op_alt_baud = true;
+            op_next(handle, CONN_PROBE);
+        } else {
+            LOG_ERROR("Module not responding to AT commands");
+            connect_fail(handle, 1);
+        }
+        return;
+    
+    case CONN_LINK:
+        /* One-off link setup, short enough to run blocking */
+        /* Back-pressure first, so neither side overruns the other at high rates */
+        if (handle->config.hw_flow_control && !UART_DMA_IsFlowControlled(handle->uart)) {
+            if (A7600_MQTT_SetFlowControl(handle, true) != MQTT_OK) {
+                LOG_WARN_M(LOG_MOD_UART, "Flow control negotiation failed");
+            }
+        }
+    
+        /* Raise link speed once - cuts serialization time of every AT round trip */
+        if (handle->config.baudrate != 0 && UART_DMA_GetBaudRate(handle->uart) != handle->config.baudrate) {
+            if (A7600_MQTT_SetBaudRate(handle, handle->config.baudrate) != MQTT_OK) {
+                LOG_WARN_M(LOG_MOD_UART, "Baud negotiation failed, staying at %lu",
+                           (unsigned long)UART_DMA_GetBaudRate(handle->uart));
+            }
+        }
+        op_next(handle, MQTT_CMUX ? CONN_MUX : link_next(handle));
+        return;
+    
+#if MQTT_CMUX
+    case CONN_MUX:
+        /* Channels last: AT+IPR / AT+IFC are plain-mode commands */
+        if (Cmux_IsOpen(&handle->mux) || handle->mux_failed) {
+            op_next(handle, link_next(handle));
+            return;
+        }
+        if (cmux_speed(UART_DMA_GetBaudRate(handle->uart)) == 0) {
+            LOG_WARN_M(LOG_MOD_UART, "No AT+CMUX code for %lu baud - plain AT",
+                       (unsigned long)UART_DMA_GetBaudRate(handle->uart));
+            handle->mux_failed = true;
+            op_next(handle, link_next(handle));
+            return;
+        }
+        if (!op_cmd(handle, NULL, 0, send_cmux, "OK", 2000, 0, 0)) {
+            return;
+        }
+        if (handle->op_res == AT_OK) {
+            Cmux_Start(&handle->mux);
+            op_next(handle, CONN_MUX_WAIT);
+        } else {
+            LOG_WARN_M(LOG_MOD_UART, "AT+CMUX refused - plain AT");
+            handle->mux_failed = true;
+            op_next(handle, link_next(handle));
+        }
+        return;
+    
+    case CONN_MUX_WAIT:
+        /* Cmux_Process runs the SABM / UA exchange */
+        if (Cmux_IsOpen(&handle->mux)) {
+            LOG_INFO_M(LOG_MOD_UART, "CMUX open");
+            op_next(handle, link_next(handle));
+        } else if (Cmux_GetState(&handle->mux) != CMUX_OPENING) {
+            /* The module went multiplexed but the channels did not open: leave, probe again */
+            LOG_WARN_M(LOG_MOD_UART, "CMUX channels not opened - plain AT");
+            handle->mux_failed = true;
+            Cmux_Close(&handle->mux);
+            op_next(handle, CONN_PROBE);
+        }
+        return;
+#endif
+    
+    case CONN_WARM:
+        /* MCU reset with the module left running: its sessions may still be up */
+        if (!op_at(handle, "AT+CGACT?;+CMQTTCONNECT?\r\n", "OK", 2000, 0)) {
+            return;
+        }
+        handle->op_warm = false;
+        if (warm_resume(handle)) {
+            LOG_INFO("Warm restart: %u session(s) still up on %s - taken over",
+                     (unsigned)handle->clients, ep_host(handle, handle->ep));
+            handle->op_client = (uint8_t)(handle->clients - 1);
+            connect_session_up(handle, CONN_BROKER);
+            return;
+        }
+        LOG_INFO("Warm restart: no live session - full connect");
+        op_next(handle, CONN_CPIN);
+        return;
+    
+    case CONN_SIM_ID:
+        /* ========== Step 2b: Carrier profile ========== */
+        /* Configured APN, or the SIM already read this boot: nothing to do */
+        if (!handle->carrier_auto || handle->carrier != NULL) {
+            op_next(handle, CONN_REG_URC);
+            return;
+        }
+        if (!op_at(handle, "AT+CICCID\r\n", "OK", 2000, 0)) {
+            return;
+        }
+        const char *iccid = (handle->op_res == AT_OK) ? strstr((char *)handle->at.rx_buf, ICCID_REPLY) : NULL;
+        uint32_t plmn;
+        
+        handle->iccid_hash = 0;
+        if (iccid != NULL) {
+            iccid += sizeof(ICCID_REPLY) - 1;
+            /* Hex digits: a 19-digit ICCID is padded with F */
+            handle->iccid_hash = fnv1a(FNV_OFFSET, (const uint8_t *)iccid, strspn(iccid, "0123456789ABCDEFabcdef"));
+        }
+        if (handle->iccid_hash != 0 && NV_Store_GetCarrier(handle->iccid_hash, &plmn)) {
+            char digits[12];    /* uint32_t in decimal */
+            
+            snprintf(digits, sizeof(digits), "%0*lu", CARRIER_PLMN_DIGITS, (unsigned long)plmn);
+            carrier_use(handle, Carrier_Find(digits), "cached");
+            op_next(handle, CONN_REG_URC);
+        } else {
+            op_next(handle, CONN_IMSI);
+        }
+        return;
+    
+    case CONN_IMSI:
+        /* New SIM (or none recorded): its home network from the IMSI */
+        if (!op_at(handle, "AT+CIMI\r\n", "OK", 2000, 0)) {
+            return;
+        }
+        const char *imsi = (handle->op_res == AT_OK) ? imsi_find((char *)handle->at.rx_buf) : NULL;
+        
+        if (imsi == NULL) {
+            /* Default this time, not recorded - the next full connect asks again */
+            carrier_use(handle, Carrier_Find(""), "no IMSI");
+            handle->carrier = NULL;
+            op_next(handle, CONN_REG_URC);
+            return;
+        }
+        carrier_use(handle, Carrier_Find(imsi), "IMSI");
+        if (handle->iccid_hash != 0) {
+            uint32_t plmn6 = 0;
+            
+            for (uint8_t i = 0; i < CARRIER_PLMN_DIGITS; i++) {
+                plmn6 = plmn6 * 10U + (uint32_t)(imsi[i] - '0');
+            }
+            NV_Store_SetCarrier(handle->iccid_hash, plmn6);     /* Blocks for a page erase, once per SIM */
+        }
+        op_next(handle, (handle->carrier->rat != 0) ? CONN_RAT : CONN_REG_URC);
+        return;
+    
+    case CONN_RAT:
+        /* Set with the profile only - the module keeps AT+CNMP across restarts */
+        if (op_cmd(handle, NULL, 0, send_rat, "OK", 2000, 0, 0)) {
+            op_next(handle, CONN_REG_URC);
+        }
+        return;
+    
+    case CONN_ACQ:
+        /* ========== Step 3b: Fast cell acquisition ========== */
+        /* Cold module: lock to the last band (AT+CNBP and AT+CNMP persist, so a lock an
+         * aborted connect left behind is lifted here too) */
+        if (!handle->op_issued && !acq_hint(handle)) {
+            handle->op_tick = HAL_GetTick();
+            op_next(handle, handle->acq_locked ? CONN_ACQ_OPEN : CONN_REG_WAIT);
+            return;
+        }
+        if (!op_cmd(handle, NULL, 0, send_acq_lock, "OK", 2000, 0, 0)) {
+            return;
+        }
+        handle->acq_locked = true;      /* Even on ERROR - part of the line may have been taken */
+        if (handle->op_res == AT_OK) {
+            LOG_INFO("Searching LTE band %u of %lu first", (unsigned)handle->acq_band,
+                     (unsigned long)handle->acq_plmn);
+            handle->conn_stats.acq = MQTT_ACQ_HINT;
+        }
+        handle->op_tick = HAL_GetTick();
+        op_next(handle, (handle->op_res == AT_OK) ? CONN_REG_WAIT : CONN_ACQ_OPEN);
+        return;
+    
+    case CONN_REG_WAIT:
+        /* No polling - +CREG / +CGREG / +CEREG URCs update the state */
+        if (REG_OK(handle->reg_cs) && REG_OK(handle->reg_ps)) {
+            op_next(handle, handle->acq_locked ? CONN_ACQ_OPEN : CONN_PDP_QUERY);
+        } else if (handle->acq_locked && HAL_GetTick() - handle->op_tick >= MQTT_ACQ_TIMEOUT) {
+            LOG_WARN("Not registered on LTE band %u - full scan", (unsigned)handle->acq_band);
+            handle->conn_stats.acq = MQTT_ACQ_FALLBACK;
+            op_next(handle, CONN_ACQ_OPEN);
+        } else if (HAL_GetTick() - handle->op_tick >= MQTT_REG_TIMEOUT) {
+            if (!REG_OK(handle->reg_cs)) {
+                LOG_ERROR("Network Registration Failed");
+            }
+            connect_fail(handle, REG_OK(handle->reg_cs) ? 4 : 3);
+        }
+        return;
+    
+    case CONN_ACQ_OPEN:
+        /* Lift the lock - registered, or the full scan; the module must reselect freely once up */
+        if (!op_cmd(handle, NULL, 0, send_acq_open, "OK", 2000, 0, 0)) {
+            return;
+        }
+        if (handle->op_res == AT_OK) {
+            handle->acq_locked = false;
+        }
+        handle->op_tick = HAL_GetTick();
+        op_next(handle, (REG_OK(handle->reg_cs) && REG_OK(handle->reg_ps)) ? CONN_PDP_QUERY : CONN_REG_WAIT);
+        return;
+    
+    case CONN_PDP_QUERY:
+        /* ========== Step 5: Activate PDP context ========== */
+        /* Read back first - APN, context and address survive MQTT reconnects in the module */
+        if (!op_at(handle, "AT+CGDCONT?;+CGACT?;+CGPADDR=1\r\n", "OK", 2000, 0)) {
+            return;
+        }
+        const char *apn = (handle->op_res == AT_OK) ? strstr((char *)handle->at.rx_buf, PDP_APN_REPLY) : NULL;
+        const char *addr = (handle->op_res == AT_OK) ? strstr((char *)handle->at.rx_buf, PDP_ADDR_REPLY) : NULL;
+        size_t apn_len = strlen(handle->config.apn);
+        
+        if (apn != NULL) {
+            apn += sizeof(PDP_APN_REPLY) - 1;
+        }
+        if (addr != NULL) {
+            addr += sizeof(PDP_ADDR_REPLY) - 1;
+        }
+        if (apn == NULL || strncmp(apn, handle->config.apn, apn_len) != 0 || apn[apn_len] != '"') {
+            op_next(handle, CONN_CGACT_OFF);
+        } else if (strstr((char *)handle->at.rx_buf, "+CGACT: 1,1") == NULL) {
+            op_next(handle, CONN_CGACT_ON);
+        } else if (addr == NULL || strncmp(addr, "0.0.0.0", 7) == 0) {
+            LOG_WARN("PDP context up without an address - recycling it");
+            op_next(handle, CONN_CGACT_OFF);
+        } else if (handle->pdp_suspect) {
+            LOG_WARN("Data failed over the kept PDP context - recycling it");
+            op_next(handle, CONN_CGACT_OFF);
+        } else {
+            LOG_INFO("PDP context already up - kept");
+            handle->conn_stats.pdp_kept = true;
+            op_next(handle, CONN_CSQ);
+        }
+        handle->pdp_suspect = false;
+        return;
+    
+    case CONN_APN:
+        /* APN from the runtime config - the outcome shows at CGACT */
+        if (op_cmd(handle, NULL, 0, send_apn, "OK", 2000, 0, 0)) {
+            op_next(handle, CONN_CGACT_ON);
+        }
+        return;
+    
+    case CONN_CLOCK:
+        /* ========== Step 6b: Network time ========== */
+        if (!MQTT_CLOCK_SYNC) {
+            clock_done(handle);
+            return;
+        }
+        if (!handle->op_issued) {
+            if (handle->op_retry == 0) {
+                LOG_INFO_M(LOG_MOD_AT, "CMD: AT+CCLK?");
+            }
+            handle->clock_read = 0;
+        }
+        if (!op_cmd(handle, "AT+CCLK?\r\n", 10, NULL, "OK", 1000, handle->op_retry ? MQTT_CLOCK_POLL : 0, 0)) {
+            return;
+        }
+        clock_reading(handle);
+        return;
+    
+    case CONN_MQTT_DISC:
+        /* ========== Step 7: Start MQTT service ========== */
+        /* First stop any existing MQTT session (each client in turn) */
+        if (op_cmd(handle, NULL, 0, send_disc, "+CMQTTDISC:", 2000, 0, 0)) {
+            op_next(handle, CONN_MQTT_REL);
+        }
+        return;
+    
+    case CONN_MQTT_REL:
+        if (!op_cmd(handle, NULL, 0, send_rel, "OK", 2000, 0, 0)) {
+            return;
+        }
+        handle->client_up &= (uint8_t)~(1u << handle->op_client);
+        if (++handle->op_client < handle->clients) {
+            op_next(handle, (handle->op_tier == TIER_CLIENT) ? CONN_MQTT_REL : CONN_MQTT_DISC);
+            return;
+        }
+        handle->op_client = 0;
+        /* Client tier keeps the MQTT service running (ACCQ fails and escalates if it is not) */
+        op_next(handle, (handle->op_tier == TIER_CLIENT) ? CONN_ACCQ : CONN_MQTT_STOP);
+        return;
+    
+    case CONN_ACCQ:
+        /* ========== Step 8: Acquire MQTT client ========== */
+        handle->state = MQTT_STATE_ACQUIRING;
+        if (!op_cmd(handle, NULL, 0, send_accq, "OK", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            connect_fail(handle, 8);
+            return;
+        }
+        op_next(handle, will_here(handle) ? CONN_WILL_TOPIC : accq_next(handle));
+        return;
+    
+    case CONN_WILL_TOPIC:
+        /* Kept by the client until it is released, so a broker-tier reconnect keeps it too */
+        if (op_cmd(handle, NULL, 0, send_will_topic, ">", MQTT_CMD_TIMEOUT, 0, 0)) {
+            will_next(handle, CONN_WILL_TOPIC_DATA);
+        }
+        return;
+    
+    case CONN_WILL_TOPIC_DATA:
+        if (op_cmd(handle, handle->config.will.topic, strlen(handle->config.will.topic), NULL, "OK",
+                   MQTT_CMD_TIMEOUT, 0, 0)) {
+            will_next(handle, CONN_WILL_MSG);
+        }
+        return;
+    
+    case CONN_WILL_MSG:
+        if (op_cmd(handle, NULL, 0, send_will_msg, ">", MQTT_CMD_TIMEOUT, 0, 0)) {
+            will_next(handle, CONN_WILL_MSG_DATA);
+        }
+        return;
+    
+    case CONN_WILL_MSG_DATA:
+        if (op_cmd(handle, handle->config.will.msg, strlen(handle->config.will.msg), NULL, "OK",
+                   MQTT_CMD_TIMEOUT, 0, 0)) {
+            will_next(handle, accq_next(handle));
+        }
+        return;
+    
+    case CONN_SSL_QUERY:
+        /* ========== Step 9: Configure SSL ========== */
+        handle->state = MQTT_STATE_SSL_CONFIG;
+        /* Context 0 keeps its settings in the module - urc_csslcfg checks them. Once a
+         * connect went through with it, it is not read or written again until the module
+         * restarts - a rewrite would discard whatever the module keeps with the context. */
+        if (!handle->op_issued && handle->ssl_cfg_ok) {
+            LOG_INFO("SSL context unchanged since last connect");
+            op_next(handle, CONN_SSL_BIND);
+            return;
+        }
+        if (!handle->op_issued) {
+            handle->ssl_cfg_ok = false;
+        }
+        if (!op_at(handle, "AT+CSSLCFG?\r\n", "OK", 2000, 0)) {
+            return;
+        }
+        if (handle->ssl_cfg_ok) {
+            LOG_INFO("SSL context already configured");
+            op_next(handle, CONN_SSL_BIND);  /* Binding belongs to the acquired client */
+        } else {
+            op_next(handle, handle->config.ca_cert != NULL ? CONN_CERT_LIST : CONN_SSL_VERSION);
+        }
+        return;
+    
+    case CONN_CERT_LIST:
+        /* The file name carries the hash of the PEM: if it is listed, it is ours */
+        if (!handle->op_issued) {
+            handle->cert_present = false;
+        }
+        if (!op_at(handle, "AT+CCERTLIST\r\n", "OK", 2000, 0)) {
+            return;
+        }
+        op_next(handle, handle->cert_present ? CONN_SSL_VERSION : CONN_CERT_DOWN);
+        return;
+    
+    case CONN_CERT_DOWN:
+        /* New module or new CA: upload once, the module keeps it across restarts */
+        if (!op_cmd(handle, NULL, 0, send_certdown, ">", 2000, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            connect_fail(handle, 9);
+            return;
+        }
+        op_next(handle, CONN_CERT_DATA);
+        return;
+    
+    case CONN_CERT_DATA:
+        /* Straight from flash in one DMA transaction */
+        if (!op_cmd(handle, handle->config.ca_cert, handle->config.ca_cert_len, NULL, "OK", CERT_TIMEOUT, 0,
+                    AT_FLAG_ZC)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("CA upload failed");
+            connect_fail(handle, 9);
+            return;
+        }
+        LOG_INFO("CA uploaded as %s", handle->ca_name);
+        op_next(handle, CONN_SSL_VERSION);
+        return;
+    
+    case CONN_SSL_AUTH:
+        /* Server verification against the CA file, if there is one (outcome shows at the TLS handshake) */
+        if (op_cmd(handle, NULL, 0, send_ssl_auth, "OK", 2000, 0, 0)) {
+            op_next(handle, CONN_SSL_SNI);
+        }
+        return;
+    
+    case CONN_SSL_BIND:
+        /* Bind SSL Context 0 to this MQTT session (or socket) */
+        if (!op_cmd(handle, NULL, 0, SOCKET_MODE(handle) ? send_cch_ssl : send_ssl_bind, "OK",
+                    MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            connect_fail(handle, 9);
+            return;
+        }
+        op_next(handle, SOCKET_MODE(handle) ? CONN_CCH_OPEN : CONN_BROKER);
+        return;
+    
+    case CONN_BROKER:
+        /* ========== Step 10: Connect to MQTT broker ========== */
+        if (!(handle->client_up & (1u << handle->op_client))) {
+            if (!handle->op_issued && dns_stale(handle)) {
+                op_next(handle, CONN_DNS);
+                return;
+            }
+            if (!handle->op_issued) {
+                LOG_INFO("Step 10: Connecting to Broker (client %u)...", (unsigned)handle->op_client);
+                handle->state = MQTT_STATE_CONNECTING;
+                handle->ep_tick = HAL_GetTick();
+            }
+            if (!op_cmd(handle, NULL, 0, send_broker, conn_ok[handle->op_client],
+                        MQTT_RESPONSE_TIMEOUT, 0, 0)) {
+                return;
+            }
+            if (handle->op_res != AT_OK) {
+                LOG_ERROR("MQTT Connect Failed. Response: %s", (char *)handle->at.rx_buf);
+                connect_fail(handle, 10);
+                return;
+            }
+            ep_connected(handle);
+            handle->client_up |= (uint8_t)(1u << handle->op_client);
+        }
+        
+        /* Next session: broker tier only reconnects, the others acquire it first */
+        connect_session_up(handle, (handle->op_tier == TIER_BROKER) ? CONN_BROKER : CONN_ACCQ);
+        return;
+    
+    case CONN_DNS:
+        /* ========== Step 9: Broker address (connect_by_ip) ========== */
+        if (!handle->op_issued) {
+            LOG_INFO("Step 9: Resolving %s...", handle->config.broker);
+        }
+        if (!op_cmd(handle, NULL, 0, send_dnsgip, "+CDNSGIP:", MQTT_RESPONSE_TIMEOUT, 0, 0)) {
+            return;
+        }
+        dns_resolved(handle);
+        op_next(handle, SOCKET_MODE(handle) ? CONN_CCH_OPEN : CONN_BROKER);
+        return;
+    
+    case CONN_CCH_OPEN:
+        /* ========== Step 8 (socket): TLS connection to the broker ========== */
+        if (handle->client_up & (1u << handle->op_client)) {
+            connect_session_up(handle, CONN_CCH_OPEN);  /* Still up (broker tier) */
+            return;
+        }
+        if (!handle->op_issued && dns_stale(handle)) {
+            op_next(handle, CONN_DNS);
+            return;
+        }
+        if (!handle->op_issued) {
+            LOG_INFO("Step 8: Opening TLS socket %u...", (unsigned)handle->op_client);
+            handle->state = MQTT_STATE_CONNECTING;
+            MQTT_PacketRx_Init(&handle->sock_rx[handle->op_client]);
+            handle->sock_ack_id[handle->op_client] = 0;
+            handle->ep_tick = HAL_GetTick();
+        }
+        if (!op_cmd(handle, NULL, 0, send_cch_open, cch_open_ok[handle->op_client],
+                    MQTT_RESPONSE_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Socket open failed. Response: %s", (char *)handle->at.rx_buf);
+            connect_fail(handle, 8);
+            return;
+        }
+        op_next(handle, CONN_CCH_SEND);
+        return;
+    
+    case CONN_CCH_SEND:
+        /* ========== Step 10 (socket): MQTT CONNECT through the socket ========== */
+        if (!handle->op_issued) {
+            handle->sock_len = (uint16_t)sock_connect_pkt(handle, NULL, 0);
+            handle->sock_connack &= (uint8_t)~(1u << handle->op_client);
+        }
+        if (!op_cmd(handle, NULL, 0, send_cchsend, ">", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            connect_fail(handle, 10);
+            return;
+        }
+        op_next(handle, CONN_CCH_CONNECT);
+        return;
+    
+    case CONN_CCH_CONNECT:
+        if (!op_cmd(handle, NULL, 0, send_connect_pkt, "OK", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            connect_fail(handle, 10);
+            return;
+        }
+        handle->op_tick = HAL_GetTick();
+        op_next(handle, CONN_CCH_CONNACK);
+        return;
+    
+    case CONN_CCH_CONNACK:
+        /* No polling - sock_packet sets the bit when the CONNACK arrives */
+        if (handle->sock_connack & (1u << handle->op_client)) {
+            ep_connected(handle);
+            handle->client_up |= (uint8_t)(1u << handle->op_client);
+            connect_session_up(handle, (handle->op_tier == TIER_BROKER) ? CONN_CCH_OPEN : CONN_SSL_BIND);
+        } else if (HAL_GetTick() - handle->op_tick > MQTT_RESPONSE_TIMEOUT) {
+            LOG_ERROR("No CONNACK (client %u)", (unsigned)handle->op_client);
+            connect_fail(handle, 10);
+        }
+        return;
+    
+    case CONN_UDP_NETQ:
+        /* ========== Optional: datagram path for loss-tolerant streams ========== */
+        /* Socket service may already be up from an earlier connect */
+        if (!op_at(handle, "AT+NETOPEN?\r\n", "+NETOPEN: 1", 2000, 0)) {
+            return;
+        }
+        op_next(handle, (handle->op_res == AT_OK) ? CONN_UDP_OPEN : CONN_UDP_NET);
+        return;
+    
+    case CONN_UDP_NET:
+        /* Inbound datagrams stay in the module (manual receive) - nothing is read back */
+        if (!op_at(handle, "AT+CIPRXGET=1;+NETOPEN\r\n", "+NETOPEN: 0", MQTT_RESPONSE_TIMEOUT, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            udp_open_failed(handle, "NETOPEN");
+            return;
+        }
+        op_next(handle, CONN_UDP_OPEN);
+        return;
+    
+    case CONN_UDP_OPEN:
+        if (!op_cmd(handle, NULL, 0, send_udp_open, "+CIPOPEN: 0,", MQTT_RESPONSE_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (!udp_opened(handle)) {
+            udp_open_failed(handle, "CIPOPEN");
+            return;
+        }
+        LOG_INFO("Datagram path up: %s:%u", handle->config.udp_host, (unsigned)handle->config.udp_port);
+        handle->udp_up = true;
+        connect_done(handle);
+        return;
+    
+    default:
+        connect_fail(handle, 1);
+        return;
+    }
+}
+
+/**
+ * @brief Advance a subscribe by one step
+ */
+static void subscribe_step(A7600_MQTT_Handle_t *handle)
+{
+    const char *rx = (const char *)handle->at.rx_buf;
+    
+    switch (handle->op_step) {
+    case SUB_CMD:
+        /* Step 1: AT+CMQTTSUB=<client_index>,<req_len>,<qos> */
+        if (!op_cmd(handle, NULL, 0, send_sub, ">", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe Step 1 Failed! Resp: %s", rx);
+            break;
+        }
+        op_next(handle, SUB_TOPIC);
+        return;
+    
+    case SUB_TOPIC:
+        /* Step 2: Send Topic String */
+        if (!op_cmd(handle, handle->op_topic, handle->op_topic_len, NULL, "OK", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe Step 2 Failed! Resp: %s", rx);
+            break;
+        }
+        /* Usually OK comes first, then +CMQTTSUB: <client>,0 - wait for the URC */
+        if (strstr(rx, sub_ok[handle->op_client]) == NULL) {
+            LOG_INFO("Waiting for SUB URC...");
+            op_next(handle, SUB_ACK);
+            return;
+        }
+        LOG_INFO("Subscribed OK");
+        handle->subscribed |= (uint8_t)(1u << handle->op_client);
+        handle->state = MQTT_STATE_CONNECTED;
+        op_finish(handle, MQTT_OK);
+        return;
+    
+    case SUBM_TOPIC_CMD:
+        /* AT+CMQTTSUBTOPIC=<client_index>,<req_len>,<qos> - one per topic */
+        if (!handle->op_issued) {
+            handle->op_topic = handle->op_topics[handle->op_index];
+            handle->op_topic_len = (uint16_t)strlen(handle->op_topic);
+            handle->op_qos = (uint8_t)handle->op_qos_list[handle->op_index];
+        }
+        if (!op_cmd(handle, NULL, 0, send_subtopic, ">", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe topic %u failed! Resp: %s", (unsigned)handle->op_index, rx);
+            break;
+        }
+        op_next(handle, SUBM_TOPIC);
+        return;
+    
+    case SUBM_TOPIC:
+        if (!op_cmd(handle, handle->op_topic, handle->op_topic_len, NULL, "OK", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe topic %u failed! Resp: %s", (unsigned)handle->op_index, rx);
+            break;
+        }
+        handle->op_index++;
+        op_next(handle, (handle->op_index < handle->op_count) ? SUBM_TOPIC_CMD : SUBM_EXEC);
+        return;
+    
+    case SUBM_EXEC:
+        /* AT+CMQTTSUB=<client_index> - one SUBSCRIBE packet, one SUBACK for all topics */
+        if (!op_cmd(handle, NULL, 0, send_sub_exec, "OK", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe failed! Resp: %s", rx);
+            break;
+        }
+        if (strstr(rx, sub_ok[handle->op_client]) == NULL) {
+            op_next(handle, SUB_ACK);
+            return;
+        }
+        LOG_INFO("Subscribed OK (%u topics)", (unsigned)handle->op_count);
+        handle->subscribed |= (uint8_t)(1u << handle->op_client);
+        handle->state = MQTT_STATE_CONNECTED;
+        op_finish(handle, MQTT_OK);
+        return;
+    
+    case SOCK_SUB_SEND:
+        /* Socket transport: one SUBSCRIBE packet for all topics */
+        if (!handle->op_issued) {
+            sock_next_id(handle);
+            handle->sock_len = (uint16_t)sock_subscribe_pkt(handle, NULL);
+            handle->sock_suback &= (uint8_t)~(1u << handle->op_client);
+            if (handle->sock_len > AT_CMD_MAX_LEN) {
+                LOG_ERROR("Subscribe packet too long (%u B)", (unsigned)handle->sock_len);
+                break;
+            }
+        }
+        if (!op_cmd(handle, NULL, 0, send_cchsend, ">", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe failed! Resp: %s", rx);
+            break;
+        }
+        op_next(handle, SOCK_SUB_PKT);
+        return;
+    
+    case SOCK_SUB_PKT:
+        if (!op_cmd(handle, NULL, 0, send_subscribe_pkt, "OK", MQTT_CMD_TIMEOUT, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("Subscribe failed! Resp: %s", rx);
+            break;
+        }
+        handle->op_tick = HAL_GetTick();
+        op_next(handle, SOCK_SUB_ACK);
+        return;
+    
+    case SOCK_SUB_ACK:
+        /* sock_packet sets the bit when the SUBACK arrives */
+        if (handle->sock_suback & (1u << handle->op_client)) {
+            bool ok = (handle->subscribed & (1u << handle->op_client)) != 0;
+            
+            LOG_INFO("Subscribe %s", ok ? "OK" : "rejected");
+            handle->state = MQTT_STATE_CONNECTED;
+            op_finish(handle, ok ? MQTT_OK : MQTT_ERROR);
+        } else if (HAL_GetTick() - handle->op_tick > 5000) {
+            LOG_WARN("No SUBACK");
+            handle->state = MQTT_STATE_CONNECTED;
+            op_finish(handle, MQTT_TIMEOUT);
+        }
+        return;
+    
+    case SUB_ACK:
+    default:
+        /* Step 3: Wait for confirmation +CMQTTSUB: <client>,0 */
+        if (!op_cmd(handle, NULL, 0, NULL, sub_ok[handle->op_client], 5000, 0, AT_FLAG_KEEP_RX)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_WARN("Subscribe URC timeout (but command might have worked)");
+        } else {
+            handle->subscribed |= (uint8_t)(1u << handle->op_client);
+        }
+        LOG_INFO("Subscribed OK");
+        handle->state = MQTT_STATE_CONNECTED;
+        op_finish(handle, MQTT_OK);
+        return;
+    }
+    
+    handle->state = MQTT_STATE_CONNECTED;
+    op_finish(handle, MQTT_ERROR);
+}
+
+/**
+ * @brief Count the wire bytes of a publish the modem accepted
+ */
+static void pub_wire(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t wire = AT_Engine_WireTotal(&handle->at) - handle->pub_wire;
+    
+    handle->wire_stats.payload += (uint32_t)handle->op_len;
+    handle->wire_stats.wire += wire;
+    handle->wire_stats.last_pm = (uint16_t)(wire ? (uint32_t)handle->op_len * 1000U / wire : 0);
+}
+
+/**
+ * @brief Publish stage finished - the engine already moves on to the next one
+ */
+static void pub_stage_done(void *ctx, AT_Result_t result)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    handle->op_res = result;
+    if (result == AT_OK && handle->op_step < PUB_EXEC) {
+        handle->op_step++;
+        return;
+    }
+    if (result == AT_OK && SOCKET_MODE(handle)) {
+        /* The modem took this piece of the PUBLISH: the next one, if any */
+        handle->sock_sent += handle->sock_len;
+        if (sock_pub_piece(handle)) {
+            handle->op_step = PUB_PAYLOAD;
+            pub_stage(handle, NULL, 0, send_cchsend, ">", 0);
+            pub_stage(handle, NULL, 0, send_publish_pkt, "OK",
+                      AT_FLAG_CHAIN | AT_FLAG_KEEP_RX | AT_FLAG_ZC | AT_FLAG_DATA);
+            return;
+        }
+    }
+    if (result == AT_OK && PUB_FIRE(handle)) {
+        /* Fire and forget: op_finish reports it done; its +CMQTTPUB is only counted */
+        handle->fired[handle->op_client]++;
+        handle->fired_tick[handle->op_client] = HAL_GetTick();
+        handle->pub_seq++;
+        handle->pub_stats.bytes += (uint32_t)handle->op_len;
+        handle->pub_stats.fired++;
+        pub_wire(handle);
+    } else if (result == AT_OK) {
+        /* Accepted - track it before its +CMQTTPUB can arrive in this same pass */
+        MQTT_InFlight_t *entry = &handle->pub_window[(handle->pub_head + handle->pub_count) % MQTT_PUB_WINDOW];
+        
+        entry->done = handle->op_done;
+        entry->ctx = handle->op_ctx;
+        entry->tick = handle->op_tick;
+        entry->seq = handle->pub_seq++;
+        entry->client = handle->op_client;
+        handle->pub_stats.bytes += (uint32_t)handle->op_len;
+        pub_wire(handle);
+        entry->result = (uint8_t)MQTT_OK;
+        /* A QoS 0 PUBLISH on a socket gets no acknowledgement - done once the modem took it */
+        entry->resolved = (SOCKET_MODE(handle) && handle->op_qos == 0);
+        entry->fired_before = handle->fired[handle->op_client];
+        handle->fired[handle->op_client] = 0;
+        handle->pub_count++;
+        handle->op_done = NULL;  /* The window reports delivery */
+    }
+    handle->op_pending = false;  /* Last stage done, or chain cut short */
+}
+
+/**
+ * @brief Queue one publish stage
+ */
+static void pub_stage(A7600_MQTT_Handle_t *handle, const void *data, size_t len, AT_SendFn_t send,
+                      const char *expected, uint8_t flags)
+{
+    AT_Cmd_t cmd;
+    
+    cmd.data = (const uint8_t *)data;
+    cmd.len = len;
+    cmd.send = send;
+    cmd.expected = expected;
+    cmd.timeout_ms = MQTT_CMD_TIMEOUT;
+    cmd.delay_ms = 0;
+    cmd.flags = flags;
+    cmd.on_done = pub_stage_done;
+    cmd.ctx = handle;
+    AT_Engine_Submit(&handle->at, &cmd);
+}
+
+/**
+ * @brief Advance a file write by one step
+ */
+static void file_step(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t baud;
+    
+    switch (handle->op_step) {
+    case FILE_CMD:
+        if (!op_cmd(handle, NULL, 0, send_filedown, ">", 2000, 0, 0)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("File %s: no prompt", handle->op_topic);
+            break;
+        }
+        op_next(handle, FILE_DATA);
+        return;
+    
+    case FILE_DATA:
+        /* Straight from caller memory in one DMA transaction; the timeout runs from its start, so add
+         * its line time (10 bits a byte) */
+        baud = UART_DMA_GetBaudRate(handle->uart);
+        if (!op_cmd(handle, handle->op_payload, handle->op_len, NULL, "OK",
+                    CERT_TIMEOUT + ((baud == 0) ? 0 : (uint32_t)(handle->op_len * 10000UL / baud)), 0, AT_FLAG_ZC)) {
+            return;
+        }
+        if (handle->op_res != AT_OK) {
+            LOG_ERROR("File %s: write failed", handle->op_topic);
+            break;
+        }
+        LOG_INFO("File %s written (%u bytes)", handle->op_topic, (unsigned)handle->op_len);
+        op_finish(handle, MQTT_OK);
+        return;
+    
+    default:
+        break;
+    }
+    op_finish(handle, (handle->op_res == AT_TIMEOUT) ? MQTT_TIMEOUT : MQTT_ERROR);
+}
+
+/**
+ * @brief Run a publish: all stages are queued at once and chained in the engine
+ */
+static void publish_step(A7600_MQTT_Handle_t *handle)
+{
+    if (!handle->op_issued && SOCKET_MODE(handle)) {
+        if (AT_Engine_Free(&handle->at) < 2) {
+            return;
+        }
+        
+        /* Socket transport: AT+CCHSEND, then the PUBLISH packet - in one go up
+         * to MQTT_SOCK_SEND_MAX, further pieces queued as each is taken.
+         * Counted as the last two stages (payload length, execute). */
+        if (handle->op_qos > 1) {
+            handle->op_qos = 1;     /* No PUBREC / PUBREL flow here */
+        }
+        if (handle->op_qos) {
+            sock_next_id(handle);
+        }
+        handle->sock_sent = 0;
+        sock_pub_piece(handle);
+        handle->sock_hdr_sent = false;
+        handle->op_step = PUB_PAYLOAD;
+        handle->pub_wire = AT_Engine_WireTotal(&handle->at);
+        pub_stage(handle, NULL, 0, send_cchsend, ">", 0);
+        pub_stage(handle, NULL, 0, send_publish_pkt, "OK",
+                  AT_FLAG_CHAIN | AT_FLAG_KEEP_RX | AT_FLAG_ZC | AT_FLAG_DATA);
+        
+        handle->op_issued = true;
+        handle->op_pending = true;
+        return;
+    }
+    if (!handle->op_issued) {
+        if (AT_Engine_Free(&handle->at) < PUB_STAGES) {
+            return;
+        }
+        
+        /* Step 1: Set topic */
+        handle->pub_wire = AT_Engine_WireTotal(&handle->at);
+        pub_stage(handle, NULL, 0, send_topic_len, ">", 0);
+        pub_stage(handle, handle->op_topic, handle->op_topic_len, NULL, "OK",
+                  AT_FLAG_CHAIN | AT_FLAG_KEEP_RX);
+        /* Step 2: Set payload - sent straight from caller memory (no copy, no ring size cap) */
+        pub_stage(handle, NULL, 0, send_payload_len, ">", AT_FLAG_CHAIN | AT_FLAG_KEEP_RX);
+        pub_stage(handle, handle->op_payload, handle->op_len, NULL, "OK",
+                  AT_FLAG_CHAIN | AT_FLAG_KEEP_RX | AT_FLAG_ZC | AT_FLAG_DATA);
+        /* Step 3: AT+CMQTTPUB=<client_index>,<qos>,<pub_timeout>[,<retained>] - OK now, +CMQTTPUB later */
+        pub_stage(handle, NULL, 0, send_pub, "OK", AT_FLAG_CHAIN | AT_FLAG_KEEP_RX);
+        
+        handle->op_issued = true;
+        handle->op_pending = true;
+        return;
+    }
+    
+    handle->state = MQTT_STATE_CONNECTED;
+    if (handle->op_res != AT_OK) {
+        static const char *const stage[PUB_STAGES] = {
+            "Set Topic Length", "Send Topic", "Set Payload Length", "Send Payload", "Execute Pub"
+        };
+        (void)stage;
+        LOG_ERROR("Publish Failed: %s. Resp: %s", stage[handle->op_step], (char *)handle->at.rx_buf);
+        op_finish(handle, MQTT_ERROR);
+        return;
+    }
+    op_finish(handle, MQTT_OK);
+}
+
+/**
+ * @brief Service the AT engine and advance the running operation
+ * @return Bytes received from the modem during this pass
+ */
+static size_t mqtt_service(A7600_MQTT_Handle_t *handle)
+{
+    size_t len = AT_Engine_Process(&handle->at);
+    
+#if MQTT_CMUX
+    Cmux_Process(&handle->mux);
+#endif
+    pub_deliver(handle);
+    if (handle->op_pending) {
+        return len;
+    }
+    
+    switch (handle->op) {
+    case MQTT_OP_CONNECT:
+        connect_step(handle);
+        break;
+    case MQTT_OP_SUBSCRIBE:
+        subscribe_step(handle);
+        break;
+    case MQTT_OP_PUBLISH:
+        publish_step(handle);
+        break;
+    case MQTT_OP_FILE:
+        file_step(handle);
+        break;
+    default:
+        break;
+    }
+    return len;
+}
+
+/**
+ * @brief Set up a new operation
+ */
+static void op_begin(A7600_MQTT_Handle_t *handle, MQTT_Op_t op, MQTT_DoneCallback_t done, void *ctx)
+{
+    handle->op = op;
+    handle->op_pending = false;
+    handle->op_done = done;
+    handle->op_ctx = ctx;
+    op_next(handle, 0);
+}
+
+/**
+ * @brief Blocking wait for the running operation (used by the blocking API)
+ */
+static MQTT_Result_t op_wait(A7600_MQTT_Handle_t *handle)
+{
+    while (handle->op != MQTT_OP_NONE) {
+        mqtt_service(handle);
+        if (handle->op != MQTT_OP_NONE) {
+            mqtt_yield(handle);
+            /* Sleep until the modem UART signals a line / new data (max 10 ms) */
+            UART_DMA_WaitEvent(handle->uart, 10);
+        }
+    }
+    return handle->op_result;
+}
+
+/**
+ * @brief Delivery result of a blocking publish
+ */
+typedef struct {
+    volatile bool done;
+    MQTT_Result_t result;
+} MQTT_PubWait_t;
+
+static void pub_wait_done(void *ctx, MQTT_Result_t result)
+{
+    MQTT_PubWait_t *wait = (MQTT_PubWait_t *)ctx;
+    
+    wait->result = result;
+    wait->done = true;
+}
+
+/**
+ * @brief Socket transport: queue a PUBACK or PINGREQ if one is due (engine idle)
+ * @return true if something was queued
+ */
+static bool sock_service(A7600_MQTT_Handle_t *handle)
+{
+    uint32_t now = HAL_GetTick();
+    AT_Cmd_t cmd;
+    
+    for (uint8_t c = 0; c < handle->clients; c++) {
+        uint16_t id = handle->sock_ack_id[c];
+        
+        if (!(handle->client_up & (1u << c))) {
+            continue;
+        }
+        if (id != 0) {
+            handle->sock_ctrl[0] = MQTT_PKT_PUBACK;
+            handle->sock_ctrl[1] = 2;
+            handle->sock_ctrl[2] = (uint8_t)(id >> 8);
+            handle->sock_ctrl[3] = (uint8_t)id;
+            handle->sock_ctrl_len = 4;
+            handle->sock_ack_id[c] = 0;
+        } else if (handle->ka_used != 0 && now - handle->sock_tx_tick[c] >= (uint32_t)handle->ka_used * 750) {
+            /* Nothing sent for 3/4 of the keepalive - the broker drops us at 1.5x */
+            handle->sock_ctrl[0] = MQTT_PKT_PINGREQ;
+            handle->sock_ctrl[1] = 0;
+            handle->sock_ctrl_len = 2;
+        } else {
+            continue;
+        }
+        
+        handle->sock_ctrl_client = c;
+        handle->sock_tx_tick[c] = now;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.send = send_ctrl_cchsend;
+        cmd.expected = ">";
+        cmd.timeout_ms = MQTT_CMD_TIMEOUT;
+        cmd.ctx = handle;
+        AT_Engine_Submit(&handle->at, &cmd);
+        cmd.send = NULL;
+        cmd.data = handle->sock_ctrl;
+        cmd.len = handle->sock_ctrl_len;
+        cmd.expected = "OK";
+        cmd.flags = AT_FLAG_CHAIN | AT_FLAG_KEEP_RX;
+        AT_Engine_Submit(&handle->at, &cmd);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Link sample finished - fields were filled in by urc_csq / urc_cpsi
+ */
+static void link_done(void *ctx, AT_Result_t result)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    if (result == AT_OK) {
+        handle->link.tick = HAL_GetTick();
+    }
+}
+
+/**
+ * @brief Queue a link-quality sample (engine idle, no operation running)
+ */
+static void link_poll(A7600_MQTT_Handle_t *handle)
+{
+    AT_Cmd_t cmd;
+    
+    cmd.data = (const uint8_t *)"AT+CSQ;+CPSI?\r\n";
+    cmd.len = 15;
+    cmd.send = NULL;
+    cmd.expected = "OK";
+    cmd.timeout_ms = 2000;
+    cmd.delay_ms = 0;
+    cmd.flags = 0;
+    cmd.on_done = link_done;
+    cmd.ctx = handle;
+    if (AT_Engine_Submit(&handle->at, &cmd)) {
+        handle->link_poll_tick = HAL_GetTick();
+    }
+}
+
+#if MQTT_CMUX
+/* Lines of the monitoring channel: the link sample's answers */
+static const AT_Urc_t mon_urcs[] = {
+    { "+CSQ:",              urc_csq },
+    { "+CPSI:",             urc_cpsi }
+};
+
+/**
+ * @brief Monitoring channel line
+ */
+static void mon_line(A7600_MQTT_Handle_t *handle, const char *line, size_t len)
+{
+    if (len == 2 && memcmp(line, "OK", 2) == 0) {
+        handle->mon_busy = false;
+        link_done(handle, AT_OK);
+        return;
+    }
+    if ((len >= 5 && memcmp(line, "ERROR", 5) == 0) || (len >= 10 && memcmp(line, "+CME ERROR", 10) == 0)) {
+        handle->mon_busy = false;
+        return;
+    }
+    for (uint8_t i = 0; i < sizeof(mon_urcs) / sizeof(mon_urcs[0]); i++) {
+        size_t n = strlen(mon_urcs[i].prefix);
+        
+        if (len >= n && memcmp(line, mon_urcs[i].prefix, n) == 0) {
+            mon_urcs[i].handler(handle, line, len, AT_LINE_URC);
+            return;
+        }
+    }
 }
 
-/* Define send_at_cmd logging inside the file or enable it generally */
-static bool send_at_cmd(A7600_MQTT_Handle_t *handle, const char *cmd)
+/**
+ * @brief Multiplexer sink: split the monitoring channel into lines
+ */
+static void mon_rx(void *ctx, uint8_t dlc, const uint8_t *data, size_t len)
 {
-    clear_rx_buffer(handle);
-    
-    /* Log the command being sent for debug */
-    LOG_INFO("CMD: %s", cmd);
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
     
-    /* Wait for TX to be free */
-    uint32_t start = HAL_GetTick();
-    while (UART_DMA_IsTxBusy(handle->uart)) {
-        if (HAL_GetTick() - start > 1000) {
-            LOG_ERROR("TX Failed: Timeout");
-            return false;
+    if (dlc != CMUX_DLC_MON) {
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\r' || data[i] == '\n') {
+            if (handle->mon_len > 0) {
+                mon_line(handle, handle->mon_line, handle->mon_len);
+            }
+            handle->mon_len = 0;
+        } else if (handle->mon_len < sizeof(handle->mon_line)) {
+            handle->mon_line[handle->mon_len++] = (char)data[i];    /* A longer line is cut */
         }
     }
-    
-    HAL_StatusTypeDef status = UART_DMA_TransmitString(handle->uart, cmd);
-    return (status == HAL_OK);
 }
 
-/* Old Subscribe removed - see implementation above */
+/**
+ * @brief AT engine read source: its channel out of the multiplexed stream
+ */
+static size_t mux_read(void *ctx, uint8_t *buf, size_t len)
+{
+    return Cmux_Read((Cmux_t *)ctx, buf, len);
+}
 
-MQTT_Result_t A7600_MQTT_Subscribe(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_QoS_t qos)
+/**
+ * @brief Link-quality sample on the monitoring channel, whatever the AT channel is doing
+ */
+static void mon_poll(A7600_MQTT_Handle_t *handle)
 {
-    char cmd[AT_CMD_MAX_LEN];
-    size_t topic_len;
-    
-    if (handle == NULL || topic == NULL) {
-        return MQTT_ERROR;
-    }
-    
-    if (!handle->connected) {
-        return MQTT_NOT_CONNECTED;
-    }
-    
-    handle->state = MQTT_STATE_SUBSCRIBING;
-    topic_len = strlen(topic);
-    
-    LOG_INFO("Subscribing (2-step): len=%d topic=%s", topic_len, topic);
+    static const char query[] = "AT+CSQ;+CPSI?\r\n";
+    uint32_t now = HAL_GetTick();
     
-    /* Step 1: Send Command with Length */
-    /* AT+CMQTTSUB=<client_index>,<req_len>,<qos> */
-    snprintf(cmd, sizeof(cmd), "AT+CMQTTSUB=0,%d,%d\r\n", topic_len, qos);
-    if (!send_and_wait(handle, cmd, ">", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Subscribe Step 1 Failed! Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
-        return MQTT_ERROR;
+    if (handle->mon_busy) {
+        if (now - handle->mon_tick >= MQTT_MON_TIMEOUT) {
+            handle->mon_busy = false;       /* No answer - the next interval asks again */
+        }
+        return;
     }
-    
-    /* Step 2: Send Topic String */
-    if (!send_and_wait(handle, topic, "OK", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Subscribe Step 2 Failed! Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
-        return MQTT_ERROR;
+    if (!handle->connected || handle->dtr_state != DTR_AWAKE ||
+        now - handle->link_poll_tick < MQTT_LINK_POLL_INTERVAL) {
+        return;
     }
-    
-    /* Step 3: Wait for confirmation +CMQTTSUB: 0,0 */
-    /* Sometimes it comes with OK, sometimes later. wait_response above caught OK. */
-    /* Now check for implicit +CMQTTSUB: 0,0 if needed, or assume OK is enough if logs show it. */
-    /* Usually SIM7600 returns OK first, then +CMQTTSUB: 0,0. 
-       We should ideally wait for the URC. */
-       
-    if (strstr((char*)handle->rx_buffer, "+CMQTTSUB: 0,0") == NULL) {
-         LOG_INFO("Waiting for SUB URC...");
-         if (!wait_response(handle, "+CMQTTSUB: 0,0", 5000)) {
-             LOG_WARN("Subscribe URC timeout (but command might have worked)");
-         }
+    if (Cmux_Write(&handle->mux, CMUX_DLC_MON, (const uint8_t *)query, sizeof(query) - 1)) {
+        handle->mon_busy = true;
+        handle->mon_tick = now;
+        handle->mon_len = 0;
+        handle->link_poll_tick = now;
     }
-    
-    LOG_INFO("Subscribed OK");
-    handle->state = MQTT_STATE_CONNECTED;
-    return MQTT_OK;
 }
+#endif
 
+/**
+ * @brief Pull DTR low - the module listens again after MQTT_WAKE_MS
+ */
+static void modem_dtr_low(A7600_MQTT_Handle_t *handle, uint32_t now)
+{
+    handle->config.dtr(false);
+    handle->sleep_stats.asleep_ms += now - handle->dtr_tick;
+    handle->dtr_tick = now;
+    handle->dtr_state = DTR_WAKING;
+}
 
-
-static bool wait_response(A7600_MQTT_Handle_t *handle, const char *expected, uint32_t timeout_ms)
+/**
+ * @brief Wake-up gate of the AT engine: hold commands while the module sleeps
+ */
+static bool modem_wake(void *ctx)
 {
-    /* Get IWDG handle for refresh during long waits */
-    extern IWDG_HandleTypeDef hiwdg;
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    uint32_t now = HAL_GetTick();
     
-    uint32_t start = HAL_GetTick();
-    
-    while (HAL_GetTick() - start < timeout_ms) {
-        /* Refresh IWDG to prevent reset during long waits */
-        HAL_IWDG_Refresh(&hiwdg);
-        
-        /* Read any available data */
-        size_t available = UART_DMA_Available(handle->uart);
-        if (available > 0) {
-            size_t space = sizeof(handle->rx_buffer) - handle->rx_len - 1;
-            if (available > space) available = space;
-            
-            size_t len = UART_DMA_Read(handle->uart, 
-                                       &handle->rx_buffer[handle->rx_len], 
-                                       available);
-            handle->rx_len += len;
-            handle->rx_buffer[handle->rx_len] = '\0';
-        }
-        
-        /* Check for expected response */
-        if (strstr((char *)handle->rx_buffer, expected) != NULL) {
-            return true;
+    if (handle->dtr_state == DTR_ASLEEP) {
+        modem_dtr_low(handle, now);
+    }
+    if (handle->dtr_state == DTR_WAKING) {
+        if (!handle->wake_held) {
+            handle->wake_held = true;
+            handle->wake_tick = now;
         }
-        
-        /* Check for error */
-        if (strstr((char *)handle->rx_buffer, "ERROR") != NULL) {
+        if (now - handle->dtr_tick < MQTT_WAKE_MS) {
             return false;
         }
+        handle->dtr_state = DTR_AWAKE;
+    }
+    
+    /* What the wake-up cost the command */
+    if (handle->wake_held) {
+        uint32_t ms = now - handle->wake_tick;
         
-        HAL_Delay(10);
+        handle->wake_held = false;
+        handle->sleep_stats.wakes++;
+        handle->sleep_stats.wake_ms_total += ms;
+        if (ms > handle->sleep_stats.wake_ms_max) {
+            handle->sleep_stats.wake_ms_max = ms;
+        }
     }
+    handle->quiet_tick = now;
+    return true;
+}
+
+static void csclk_done(void *ctx, AT_Result_t result)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
     
-    return false;
+    handle->csclk_sent = false;
+    handle->csclk = (result == AT_OK);
+    if (!handle->csclk) {
+        LOG_WARN("AT+CSCLK refused - no modem sleep");
+        handle->sleep_allowed = false;
+    }
 }
 
-static bool send_and_wait(A7600_MQTT_Handle_t *handle, const char *cmd, const char *expected, uint32_t timeout_ms)
+/**
+ * @brief Modem sleep, run while the engine is idle: enable it once, then
+ *        raise DTR when the AT channel has been quiet for MQTT_SLEEP_IDLE
+ */
+static void modem_sleep(A7600_MQTT_Handle_t *handle)
 {
-    if (!send_at_cmd(handle, cmd)) {
-        return false;
+    uint32_t now = HAL_GetTick();
+    AT_Cmd_t cmd;
+    
+    if (handle->dtr_state == DTR_WAKING && now - handle->dtr_tick >= MQTT_WAKE_MS) {
+        handle->dtr_state = DTR_AWAKE;      /* Woken ahead of a command that did not come */
+        handle->quiet_tick = now;
+    }
+    if (!handle->sleep_allowed || !handle->connected || handle->dtr_state != DTR_AWAKE) {
+        return;
+    }
+#if MQTT_CMUX
+    if (handle->mon_busy) {
+        return;             /* Its answer is on the way */
+    }
+#endif
+    if (!handle->csclk) {
+        if (handle->csclk_sent) {
+            return;
+        }
+        cmd.data = (const uint8_t *)"AT+CSCLK=1\r\n";
+        cmd.len = 12;
+        cmd.send = NULL;
+        cmd.expected = "OK";
+        cmd.timeout_ms = 2000;
+        cmd.delay_ms = 0;
+        cmd.flags = 0;
+        cmd.on_done = csclk_done;
+        cmd.ctx = handle;
+        handle->csclk_sent = AT_Engine_Submit(&handle->at, &cmd);
+        return;
+    }
+    if (now - handle->quiet_tick >= MQTT_SLEEP_IDLE && now - handle->at.done_tick >= MQTT_SLEEP_IDLE) {
+        handle->config.dtr(true);
+        handle->dtr_tick = now;
+        handle->dtr_state = DTR_ASLEEP;
+        handle->sleep_stats.sleeps++;
+    }
+}
+
+/**
+ * @brief Datagram prompt refused - the data entry is dropped with it
+ */
+static void udp_prompt_done(void *ctx, AT_Result_t result)
+{
+    if (result != AT_OK) {
+        ((A7600_MQTT_Handle_t *)ctx)->pub_stats.datagram_errors++;
+    }
+}
+
+static void udp_sent_done(void *ctx, AT_Result_t result)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    if (result == AT_OK) {
+        handle->pub_stats.datagrams++;
+    } else {
+        handle->pub_stats.datagram_errors++;
     }
-    HAL_Delay(50);  /* Small delay after sending */
-    return wait_response(handle, expected, timeout_ms);
 }
 
 /* ==================== Public Functions ==================== */
@@ -164,19 +3856,117 @@ MQTT_Result_t A7600_MQTT_Init(A7600_MQTT_Handle_t *handle, UART_DMA_Handle_t *ua
     
     /* Store handles */
     handle->uart = uart;
-    memcpy(&handle->config, config, sizeof(MQTT_Config_t));
+    handle->config = *config;
+    handle->carrier_auto = (handle->config.apn == NULL || handle->config.apn[0] == '\0');
+    handle->carrier = NULL;
+    if (handle->carrier_auto) {
+        handle->config.apn = A7600_APN;     /* Until the SIM is read */
+    }
+    handle->ca_name[0] = '\0';
+    if (handle->config.ca_cert != NULL) {
+        snprintf(handle->ca_name, sizeof(handle->ca_name), "ca_%08lx.pem",
+                 (unsigned long)fnv1a(FNV_OFFSET, (const uint8_t *)handle->config.ca_cert, handle->config.ca_cert_len));
+    }
+    handle->cert_present = false;
+    handle->ep = 0;
+    memset(handle->ep_health, 0, sizeof(handle->ep_health));
+    handle->clock_sec = 0;
+    handle->clock_ntp = false;
+    handle->sleep_allowed = false;
+    handle->csclk = false;
+    handle->csclk_sent = false;
+    handle->dtr_state = DTR_AWAKE;
+    handle->wake_held = false;
+    memset(&handle->sleep_stats, 0, sizeof(handle->sleep_stats));
     
     /* Initialize state */
     handle->state = MQTT_STATE_IDLE;
     handle->msg_callback = NULL;
-    handle->rx_len = 0;
+    handle->chunk_callback = NULL;
+    handle->route_count = 0;
+    handle->policy = NULL;
+    handle->policy_count = 0;
+    rx_topic_reset(handle);
+    handle->idle_hook = NULL;
+    handle->idle_ctx = NULL;
+    handle->in_hook = false;
+    handle->op = MQTT_OP_NONE;
+    handle->op_pending = false;
+    handle->op_desc = NULL;
+    handle->op_done = NULL;
+    handle->op_result = MQTT_OK;
     handle->response_ready = false;
     handle->cmd_ok = false;
     handle->connected = false;
     
-    handle->connected = false;
+    handle->rx_state = RX_IDLE;
+    handle->pub_head = 0;
+    handle->pub_count = 0;
+    handle->pub_seq = 0;
+    memset(handle->fired, 0, sizeof(handle->fired));
+    memset(&handle->pub_stats, 0, sizeof(handle->pub_stats));
+    memset(&handle->wire_stats, 0, sizeof(handle->wire_stats));
+    handle->clients = (config->clients >= 2) ? 2 : 1;
+    handle->client_up = 0;
+    handle->subscribed = 0;
+    handle->op_client = 0;
+    handle->modem_flags = 0;
+    handle->rdy_tick = 0;
+    handle->reg_cs = 0;
+    handle->reg_ps = 0;
+    handle->ssl_cfg_ok = false;
+    memset(&handle->link, 0, sizeof(handle->link));
+    handle->link.csq = 99;
+    handle->link_poll_tick = HAL_GetTick();
+    handle->ka_plmn = 0;
+    handle->ka_good = 0;
+    handle->ka_bad = 0;
+    handle->ka_proven = false;
+    handle->ka_dirty = false;
+    handle->up_tick = 0;
+    handle->dns_hash = host_hash(config->broker);
+    if (!config->connect_by_ip || !NV_Store_GetHostIp(handle->dns_hash, &handle->dns_ip)) {
+        handle->dns_ip = 0;
+    }
+    handle->dns_tick = 0;               /* Flash copy is used, but refreshed on the first connect */
+    handle->dns_skip = false;
+    handle->dns_dirty = false;
+    if (!NV_Store_GetCell(&handle->acq_plmn, &handle->acq_band)) {
+        handle->acq_plmn = 0;
+        handle->acq_band = 0;
+    }
+    handle->acq_locked = false;
+    handle->acq_dirty = false;
+    ka_plan(handle);
+    handle->ka_used = handle->ka_next;
+    for (uint8_t c = 0; c < MQTT_MAX_CLIENTS; c++) {
+        MQTT_PacketRx_Init(&handle->sock_rx[c]);
+        handle->sock_tx_tick[c] = 0;
+        handle->sock_ack_id[c] = 0;
+    }
+    handle->sock_pkt_id = 0;
+    handle->sock_connack = 0;
+    handle->sock_suback = 0;
+    handle->sock_rx_client = 0;
+    handle->sock_hdr_sent = false;
+    handle->udp_up = false;
+    handle->udp_len = 0;
     
-    clear_rx_buffer(handle);
+    AT_Engine_Init(&handle->at, uart);
+    if (handle->config.dtr != NULL) {
+        AT_Engine_SetWake(&handle->at, modem_wake, handle);
+        handle->config.dtr(false);
+    }
+    AT_Engine_SetLineHandler(&handle->at, mqtt_urcs, (uint8_t)(sizeof(mqtt_urcs) / sizeof(mqtt_urcs[0])),
+                             mqtt_line, handle);
+#if MQTT_CMUX
+    Cmux_Init(&handle->mux, uart, mon_rx, handle);
+    AT_Engine_SetSource(&handle->at, mux_read, &handle->mux);
+    handle->mux_failed = false;
+    handle->mux_cld = false;
+    handle->mon_busy = false;
+    handle->mon_len = 0;
+#endif
     
     LOG_INFO("A7600 MQTT Initialized");
     return MQTT_OK;
@@ -189,267 +3979,372 @@ void A7600_MQTT_SetMessageCallback(A7600_MQTT_Handle_t *handle, MQTT_MessageCall
     }
 }
 
-MQTT_Result_t A7600_MQTT_Connect(A7600_MQTT_Handle_t *handle)
+void A7600_MQTT_SetChunkCallback(A7600_MQTT_Handle_t *handle, MQTT_ChunkCallback_t callback)
 {
-    char cmd[AT_CMD_MAX_LEN];
-    int retry;
+    if (handle != NULL) {
+        handle->chunk_callback = callback;
+    }
+}
+
+MQTT_Result_t A7600_MQTT_Route(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_ChunkCallback_t handler)
+{
+    size_t len;
     
-    if (handle == NULL) {
+    if (handle == NULL || topic == NULL || handler == NULL) {
+        return MQTT_ERROR;
+    }
+    len = strlen(topic);
+    if (handle->route_count >= MQTT_MAX_ROUTES || len >= sizeof(rx_topic)) {
         return MQTT_ERROR;
     }
     
-    /* Clear error info */
-    handle->error_step = 0;
-    memset(handle->last_response, 0, sizeof(handle->last_response));
+    MQTT_Route_t *route = &handle->routes[handle->route_count++];
+    route->topic = topic;
+    route->hash = fnv1a(FNV_OFFSET, (const uint8_t *)topic, len);
+    route->len = (uint8_t)len;
+    route->handler = handler;
+    return MQTT_OK;
+}
+
+void A7600_MQTT_SetPolicy(A7600_MQTT_Handle_t *handle, const MQTT_TopicPolicy_t *policy, uint8_t count)
+{
+    if (handle != NULL) {
+        handle->policy = policy;
+        handle->policy_count = (policy != NULL) ? count : 0;
+    }
+}
+
+void A7600_MQTT_SetIdleHook(A7600_MQTT_Handle_t *handle, MQTT_IdleHook_t hook, void *ctx)
+{
+    if (handle != NULL) {
+        handle->idle_hook = hook;
+        handle->idle_ctx = ctx;
+    }
+}
+
+MQTT_Result_t A7600_MQTT_SetBaudRate(A7600_MQTT_Handle_t *handle, uint32_t baudrate)
+{
+    UART_DMA_Span_t iov[3];
+    char num[10];
     
-    /* ========== Step 1: Test module communication ========== */
-    LOG_INFO("Step 1: Testing module communication...");
-    handle->state = MQTT_STATE_STARTING;
-    retry = 3;
-    while (retry-- > 0) {
-        if (send_and_wait(handle, "AT\r\n", "OK", 500)) {
-            break;
-        }
-        HAL_Delay(200);
+    if (handle == NULL || baudrate == 0 || MUX_OPEN(handle)) {
+        return MQTT_ERROR;      /* AT+IPR under CMUX would leave the frames at the old rate */
     }
-    if (retry < 0) {
-        LOG_ERROR("Module not responding to AT commands");
-        handle->error_step = 1;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
-        return MQTT_ERROR;  /* Module not responding */
-    }
-    HAL_Delay(100);
-    
-    /* ========== Step 2: Check SIM card ========== */
-    LOG_INFO("Step 2: Checking SIM card...");
-    if (!send_and_wait(handle, "AT+CPIN?\r\n", "+CPIN: READY", MQTT_CMD_TIMEOUT)) {
-        handle->error_step = 2;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
-        LOG_ERROR("SIM Card Error or PIN Required");
-        return MQTT_ERROR;  /* SIM not inserted or PIN required */
-    }
-    HAL_Delay(100);
-    
-    /* ========== Step 3: Check network registration ========== */
-    LOG_INFO("Step 3: Checking Network Registration...");
-    retry = 30;  /* Wait up to 30 seconds for network */
-    while (retry-- > 0) {
-        if (send_and_wait(handle, "AT+CREG?\r\n", "+CREG: 0,1", 500) ||
-            send_and_wait(handle, "AT+CREG?\r\n", "+CREG: 0,5", 500)) {
-            break;  /* Registered home (1) or roaming (5) */
-        }
-        HAL_Delay(500);
-    }
-    if (retry < 0) {
-        handle->error_step = 3;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
-        LOG_ERROR("Network Registration Failed");
-        return MQTT_ERROR;  /* Not registered to network */
-    }
-    HAL_Delay(100);
-    
-    /* ========== Step 4: Check GPRS/LTE registration ========== */
-    retry = 30;
-    while (retry-- > 0) {
-        if (send_and_wait(handle, "AT+CGREG?\r\n", "+CGREG: 0,1", 500) ||
-            send_and_wait(handle, "AT+CGREG?\r\n", "+CGREG: 0,5", 500)) {
-            break;  /* GPRS registered */
-        }
-        HAL_Delay(500);
-    }
-    if (retry < 0) {
-        handle->error_step = 4;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
-        return MQTT_ERROR;  /* GPRS not registered */
-    }
-    HAL_Delay(100);
-    
-    /* ========== Step 5: Activate PDP context ========== */
-    /* ========== Step 5: Activate PDP context ========== */
-    /* First deactivate any existing context */
-    send_and_wait(handle, "AT+CGACT=0,1\r\n", "OK", 5000);
-    HAL_Delay(100);
-    
-    /* Set APN (default, may need to change for specific carrier) */
-    send_and_wait(handle, "AT+CGDCONT=1,\"IP\",\"internet\"\r\n", "OK", 2000);
-    HAL_Delay(50);
-    
-    /* Activate PDP context */
-    if (!send_and_wait(handle, "AT+CGACT=1,1\r\n", "OK", 10000)) {
-        handle->error_step = 5;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
-        return MQTT_ERROR;  /* Failed to activate data */
-    }
-    HAL_Delay(100);
-    
-    /* ========== Step 6: Check signal quality ========== */
-    send_and_wait(handle, "AT+CSQ\r\n", "OK", 2000);
-    HAL_Delay(50);
-    
-    /* ========== Step 7: Start MQTT service ========== */
-    /* ========== Step 7: Start MQTT service ========== */
-    /* First stop any existing MQTT session */
-    send_and_wait(handle, "AT+CMQTTDISC=0,60\r\n", "OK", 2000);
-    HAL_Delay(50);
-    send_and_wait(handle, "AT+CMQTTREL=0\r\n", "OK", 2000);
-    HAL_Delay(50);
-    send_and_wait(handle, "AT+CMQTTSTOP\r\n", "OK", 2000);
-    HAL_Delay(100);
-    
-    /* Start MQTT service */
-    if (!send_and_wait(handle, "AT+CMQTTSTART\r\n", "OK", MQTT_CMD_TIMEOUT)) {
-        /* May already be started, check with +CMQTTSTART: 0 */
-        if (strstr((char *)handle->rx_buffer, "+CMQTTSTART: 0") == NULL) {
-            handle->error_step = 7;
-            strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-            handle->state = MQTT_STATE_ERROR;
-            return MQTT_ERROR;
-        }
+    if (handle->in_hook) {
+        return MQTT_BUSY;
     }
-    HAL_Delay(100);
     
-    /* ========== Step 8: Acquire MQTT client ========== */
-    handle->state = MQTT_STATE_ACQUIRING;
-    snprintf(cmd, sizeof(cmd), "AT+CMQTTACCQ=0,\"%s\",1\r\n", handle->config.client_id);
-    if (!send_and_wait(handle, cmd, "OK", MQTT_CMD_TIMEOUT)) {
-        handle->error_step = 8;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
+    uint32_t old_baud = UART_DMA_GetBaudRate(handle->uart);
+    if (baudrate == old_baud) {
+        return MQTT_OK;
+    }
+    
+    LOG_INFO_M(LOG_MOD_UART, "Switching modem UART %lu -> %lu", (unsigned long)old_baud, (unsigned long)baudrate);
+    
+    /* Module answers OK at the old rate, then switches */
+    IOV_STR(iov[0], "AT+IPR=");
+    IOV_BUF(iov[1], num, fmt_uint(num, baudrate));
+    IOV_STR(iov[2], "\r\n");
+    if (!send_and_wait_v(handle, iov, 3, "OK", 1000)) {
         return MQTT_ERROR;
     }
-    HAL_Delay(100);
     
-    /* ========== Step 9: Configure SSL ========== */
-    if (handle->config.use_ssl) {
-        handle->state = MQTT_STATE_SSL_CONFIG;
-        
-        /* Configure SSL Context 0 */
-        /* TLS 1.2 */
-        send_and_wait(handle, "AT+CSSLCFG=\"sslversion\",0,4\r\n", "OK", 2000);
-        HAL_Delay(50);
-        
-        /* Configure Server CA Certificate - REMOVED */
-        /* send_and_wait(handle, "AT+CSSLCFG=\"cacert\",0,\"customer_root_ca.pem\"\r\n", "OK", 2000); */
-        /* HAL_Delay(100); */
+    wait_tx_idle(handle, 100);
+    if (UART_DMA_SetBaudRate(handle->uart, baudrate) != HAL_OK) {
+        return MQTT_ERROR;
+    }
+    
+    if (probe_at(handle, 3)) {
+        return MQTT_OK;
+    }
+    
+    /* Module did not follow - fall back to the previous rate */
+    LOG_WARN_M(LOG_MOD_UART, "No answer at %lu, falling back", (unsigned long)baudrate);
+    UART_DMA_SetBaudRate(handle->uart, old_baud);
+    probe_at(handle, 1);
+    return MQTT_ERROR;
+}
 
-        /* Set Authentication Mode: 0 (No Verify) */
-        send_and_wait(handle, "AT+CSSLCFG=\"authmode\",0,0\r\n", "OK", 2000);
-        HAL_Delay(50);
-        
-        /* Enable SNI (Required for HiveMQ Cloud) */
-        send_and_wait(handle, "AT+CSSLCFG=\"enableSNI\",0,1\r\n", "OK", 2000);
-        HAL_Delay(50);
-        
-        /* Ignore time check */
-        send_and_wait(handle, "AT+CSSLCFG=\"ignorelocaltime\",0,1\r\n", "OK", 2000);
-        HAL_Delay(50);
-
-        /* Bind SSL Context 0 to MQTT Session 0 */
-        if (!send_and_wait(handle, "AT+CMQTTSSLCFG=0,0\r\n", "OK", MQTT_CMD_TIMEOUT)) {
-            handle->error_step = 9;
-            strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-            handle->state = MQTT_STATE_ERROR;
-            return MQTT_ERROR;
-        }
-        HAL_Delay(200);
+MQTT_Result_t A7600_MQTT_SetFlowControl(A7600_MQTT_Handle_t *handle, bool enable)
+{
+    if (handle == NULL || MUX_OPEN(handle)) {
+        return MQTT_ERROR;
+    }
+    if (handle->in_hook) {
+        return MQTT_BUSY;
+    }
+    
+    if (UART_DMA_IsFlowControlled(handle->uart) == enable) {
+        return MQTT_OK;
     }
     
-    /* ========== Step 10: Connect to MQTT broker ========== */
-    LOG_INFO("Step 10: Connecting to Broker...");
-    handle->state = MQTT_STATE_CONNECTING;
-    snprintf(cmd, sizeof(cmd), 
-             "AT+CMQTTCONNECT=0,\"tcp://%s:%d\",%d,1,\"%s\",\"%s\"\r\n",
-             handle->config.broker,
-             handle->config.port,
-             handle->config.keepalive,
-             handle->config.username,
-             handle->config.password);
-    
-    if (!send_and_wait(handle, cmd, "+CMQTTCONNECT: 0,0", MQTT_RESPONSE_TIMEOUT)) {
-        handle->error_step = 10;
-        strncpy(handle->last_response, (char *)handle->rx_buffer, sizeof(handle->last_response) - 1);
-        handle->state = MQTT_STATE_ERROR;
-        LOG_ERROR("MQTT Connect Failed. Response: %s", handle->rx_buffer);
+    /* Modem side first (answers before applying), then ours */
+    if (!send_and_wait(handle, enable ? "AT+IFC=2,2\r\n" : "AT+IFC=0,0\r\n", "OK", 1000)) {
         return MQTT_ERROR;
     }
     
-    handle->state = MQTT_STATE_CONNECTED;
-    handle->connected = true;
+    wait_tx_idle(handle, 100);
+    if (UART_DMA_SetFlowControl(handle->uart, enable) != HAL_OK) {
+        return MQTT_ERROR;
+    }
+    
+    if (probe_at(handle, 3)) {
+        LOG_INFO_M(LOG_MOD_UART, "Modem flow control %s", enable ? "RTS/CTS" : "off");
+        return MQTT_OK;
+    }
+    
+    /* Lines not wired or module ignored it - back to no flow control */
+    LOG_WARN_M(LOG_MOD_UART, "No answer with RTS/CTS, disabling");
+    UART_DMA_SetFlowControl(handle->uart, false);
+    send_and_wait(handle, "AT+IFC=0,0\r\n", "OK", 1000);
+    return MQTT_ERROR;
+}
+
+/**
+ * @brief Start the connect sequence at the first step of a tier
+ */
+static MQTT_Result_t connect_begin(A7600_MQTT_Handle_t *handle, uint8_t tier,
+                                   MQTT_DoneCallback_t done, void *ctx)
+{
+    if (handle == NULL) {
+        return MQTT_ERROR;
+    }
+    if (handle->in_hook || handle->op != MQTT_OP_NONE) {
+        return MQTT_BUSY;
+    }
+    
+    /* Clear error info */
+    handle->error_step = 0;
+    handle->last_response[0] = '\0';
     
-    LOG_INFO("MQTT Connected Successfully to %s", handle->config.broker);
+    handle->state = MQTT_STATE_STARTING;
+    handle->connected = false;
+    handle->op_alt_baud = false;
+    handle->op_warm = false;
+    handle->op_tier = tier;
+    handle->op_client = 0;
+    pub_abort(handle, MQTT_NOT_CONNECTED, MQTT_ALL_CLIENTS);  /* Left over from the last session */
+    op_begin(handle, MQTT_OP_CONNECT, done, ctx);
+    
+    memset(&handle->conn_stats, 0, sizeof(handle->conn_stats));
+    handle->conn_stats.start_tick = HAL_GetTick();
+    handle->ep = ep_pick(handle);
+    handle->conn_tick = handle->conn_stats.start_tick;
+    op_next(handle, TIER_START(handle, tier));
     return MQTT_OK;
 }
+    
+MQTT_Result_t A7600_MQTT_ConnectAsync(A7600_MQTT_Handle_t *handle, MQTT_DoneCallback_t done, void *ctx)
+{
+    LOG_INFO("Step 1: Testing module communication...");
+    return connect_begin(handle, TIER_FULL, done, ctx);
+}
+    
+MQTT_Result_t A7600_MQTT_ReconnectAsync(A7600_MQTT_Handle_t *handle, MQTT_DoneCallback_t done, void *ctx)
+{
+    LOG_INFO("Reconnect: trying broker only...");
+    return connect_begin(handle, TIER_BROKER, done, ctx);
+}
+
+MQTT_Result_t A7600_MQTT_ResumeAsync(A7600_MQTT_Handle_t *handle, MQTT_DoneCallback_t done, void *ctx)
+{
+    MQTT_Result_t result;
+    
+    LOG_INFO("Warm restart: looking for the module's sessions...");
+    result = connect_begin(handle, TIER_FULL, done, ctx);
+    if (result == MQTT_OK) {
+        handle->op_warm = true;
+    }
+    return result;
+}
+
+MQTT_Result_t A7600_MQTT_Connect(A7600_MQTT_Handle_t *handle)
+{
+    MQTT_Result_t result = A7600_MQTT_ConnectAsync(handle, NULL, NULL);
+    
+    if (result != MQTT_OK) {
+        return result;
+    }
+    return op_wait(handle);
+}
 
 MQTT_Result_t A7600_MQTT_Disconnect(A7600_MQTT_Handle_t *handle)
 {
     if (handle == NULL) {
         return MQTT_ERROR;
     }
+    if (handle->in_hook) {
+        return MQTT_BUSY;
+    }
+    
+    /* Abandon a running operation - its queued command still completes first */
+    if (handle->op != MQTT_OP_NONE) {
+        op_finish(handle, MQTT_ERROR);
+    }
     
     handle->state = MQTT_STATE_DISCONNECTING;
     
-    /* Disconnect */
-    send_and_wait(handle, "AT+CMQTTDISC=0,60\r\n", "OK", MQTT_CMD_TIMEOUT);
-    HAL_Delay(500);
+    for (uint8_t c = 0; c < handle->clients && SOCKET_MODE(handle); c++) {
+        static const uint8_t disconnect_pkt[2] = { MQTT_PKT_DISCONNECT, 0 };
+        char cmd[24];
+        
+        /* DISCONNECT packet, then close the socket */
+        snprintf(cmd, sizeof(cmd), "AT+CCHSEND=%u,2\r\n", (unsigned)c);
+        if ((handle->client_up & (1u << c)) && send_and_wait(handle, cmd, ">", MQTT_CMD_TIMEOUT) &&
+            send_zc(handle, disconnect_pkt, sizeof(disconnect_pkt))) {
+            wait_response(handle, "OK", MQTT_CMD_TIMEOUT);
+        }
+        snprintf(cmd, sizeof(cmd), "AT+CCHCLOSE=%u\r\n", (unsigned)c);
+        send_and_wait(handle, cmd, "+CCHCLOSE:", MQTT_CMD_TIMEOUT);
+    }
+    if (SOCKET_MODE(handle)) {
+        send_and_wait(handle, "AT+CCHSTOP\r\n", "+CCHSTOP:", MQTT_CMD_TIMEOUT);
+    }
+    
+    for (uint8_t c = 0; c < handle->clients && !SOCKET_MODE(handle); c++) {
+        char cmd[24];
+        
+        /* Disconnect - done once the +CMQTTDISC result follows the OK */
+        snprintf(cmd, sizeof(cmd), "AT+CMQTTDISC=%u,60\r\n", (unsigned)c);
+        send_and_wait(handle, cmd, "+CMQTTDISC:", MQTT_CMD_TIMEOUT);
+        
+        /* Release client */
+        snprintf(cmd, sizeof(cmd), "AT+CMQTTREL=%u\r\n", (unsigned)c);
+        send_and_wait(handle, cmd, "OK", MQTT_CMD_TIMEOUT);
+    }
     
-    /* Release client */
-    send_and_wait(handle, "AT+CMQTTREL=0\r\n", "OK", MQTT_CMD_TIMEOUT);
-    HAL_Delay(500);
+    /* Datagram link and the socket service behind it */
+    if (handle->udp_up) {
+        send_and_wait(handle, "AT+CIPCLOSE=0\r\n", "+CIPCLOSE:", MQTT_CMD_TIMEOUT);
+        send_and_wait(handle, "AT+NETCLOSE\r\n", "+NETCLOSE:", MQTT_CMD_TIMEOUT);
+        handle->udp_up = false;
+    }
     
     /* Stop MQTT service */
-    send_and_wait(handle, "AT+CMQTTSTOP\r\n", "OK", MQTT_CMD_TIMEOUT);
+    if (!SOCKET_MODE(handle)) {
+        send_and_wait(handle, "AT+CMQTTSTOP\r\n", "+CMQTTSTOP:", MQTT_CMD_TIMEOUT);
+    }
     
     handle->state = MQTT_STATE_IDLE;
     handle->connected = false;
+    handle->client_up = 0;
+    pub_abort(handle, MQTT_NOT_CONNECTED, MQTT_ALL_CLIENTS);
+    pub_deliver(handle);
+    
+    return MQTT_OK;
+}
+
+MQTT_Result_t A7600_MQTT_WriteFileAsync(A7600_MQTT_Handle_t *handle, MQTT_File_t kind, const char *name,
+                                        const void *data, size_t len, MQTT_DoneCallback_t done, void *ctx)
+{
+    if (handle == NULL || name == NULL || data == NULL || len == 0 || len > MQTT_FILE_MAX_LEN) {
+        return MQTT_ERROR;
+    }
+    if (handle->in_hook || handle->op != MQTT_OP_NONE) {
+        return MQTT_BUSY;
+    }
+    
+    handle->op_topic = name;
+    handle->op_payload = (const uint8_t *)data;
+    handle->op_len = len;
+    handle->op_index = (uint8_t)kind;
+    
+    LOG_INFO("Writing file %s (%u bytes)", name, (unsigned)len);
+    op_begin(handle, MQTT_OP_FILE, done, ctx);
+    return MQTT_OK;
+}
+
+bool A7600_UploadCert(A7600_MQTT_Handle_t *handle, const char *filename, const char *data, size_t len)
+{
+    if (A7600_MQTT_WriteFileAsync(handle, MQTT_FILE_CERT, filename, data, len, NULL, NULL) != MQTT_OK) {
+        return false;
+    }
+    return (op_wait(handle) == MQTT_OK);
+}
+
+MQTT_Result_t A7600_MQTT_SubscribeAsync(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_QoS_t qos,
+                                        MQTT_DoneCallback_t done, void *ctx)
+{
+    return A7600_MQTT_SubscribeClientAsync(handle, 0, topic, qos, done, ctx);
+}
+
+MQTT_Result_t A7600_MQTT_SubscribeClientAsync(A7600_MQTT_Handle_t *handle, uint8_t client, const char *topic,
+                                              MQTT_QoS_t qos, MQTT_DoneCallback_t done, void *ctx)
+{
+    if (handle == NULL || topic == NULL || client >= handle->clients) {
+        return MQTT_ERROR;
+    }
+    if (handle->in_hook || handle->op != MQTT_OP_NONE) {
+        return MQTT_BUSY;
+    }
+    
+    if (!handle->connected) {
+        return MQTT_NOT_CONNECTED;
+    }
     
+    handle->state = MQTT_STATE_SUBSCRIBING;
+    handle->op_client = client;
+    handle->op_topic = topic;
+    handle->op_topic_len = (uint16_t)strlen(topic);
+    handle->op_topics = NULL;
+    handle->op_qos = (uint8_t)qos;
+    
+    LOG_INFO("Subscribing (2-step): len=%d topic=%s", (int)handle->op_topic_len, topic);
+    op_begin(handle, MQTT_OP_SUBSCRIBE, done, ctx);
+    if (SOCKET_MODE(handle)) {
+        op_next(handle, SOCK_SUB_SEND);
+    }
     return MQTT_OK;
 }
 
-bool A7600_UploadCert(A7600_MQTT_Handle_t *handle, const char *filename, const char *data, size_t len)
+MQTT_Result_t A7600_MQTT_Subscribe(A7600_MQTT_Handle_t *handle, const char *topic, MQTT_QoS_t qos)
+{
+    MQTT_Result_t result = A7600_MQTT_SubscribeAsync(handle, topic, qos, NULL, NULL);
+    
+    if (result != MQTT_OK) {
+        return result;
+    }
+    return op_wait(handle);
+}
+
+MQTT_Result_t A7600_MQTT_SubscribeManyClientAsync(A7600_MQTT_Handle_t *handle, uint8_t client,
+                                                  const char *const topics[], const MQTT_QoS_t qos[],
+                                                  uint8_t n, MQTT_DoneCallback_t done, void *ctx)
 {
-    char cmd[AT_CMD_MAX_LEN];
-    const size_t CHUNK_SIZE = 512;
-    size_t sent = 0;
-    
-    if (handle == NULL || filename == NULL || data == NULL) return false;
-    
-    LOG_INFO("Uploading Certificate: %s (%d bytes)", filename, len);
-    
-    /* Step 1: Send AT+CCERTDOWN command */
-    snprintf(cmd, sizeof(cmd), "AT+CCERTDOWN=\"%s\",%d\r\n", filename, len);
-    if (!send_and_wait(handle, cmd, ">", 2000)) {
-        LOG_ERROR("Failed to start cert upload");
-        return false;
+    if (handle == NULL || topics == NULL || qos == NULL || n == 0 || client >= handle->clients) {
+        return MQTT_ERROR;
     }
-    
-    /* Step 2: Send data in chunks */
-    while (sent < len) {
-        size_t chunk = len - sent;
-        if (chunk > CHUNK_SIZE) chunk = CHUNK_SIZE;
-        
-        UART_DMA_Transmit(handle->uart, (uint8_t*)&data[sent], chunk);
-        sent += chunk;
-        
-        /* Small delay to prevent UART buffer overflow if any */
-        HAL_Delay(50);
+    if (handle->in_hook || handle->op != MQTT_OP_NONE) {
+        return MQTT_BUSY;
     }
     
-    /* Step 3: Wait for OK */
-    if (!wait_response(handle, "OK", 5000)) {
-        LOG_ERROR("Cert upload failed to receive OK");
-        return false;
+    if (!handle->connected) {
+        return MQTT_NOT_CONNECTED;
     }
     
-    LOG_INFO("Certificate Uploaded Successfully");
-    return true;
+    handle->state = MQTT_STATE_SUBSCRIBING;
+    handle->op_client = client;
+    handle->op_topics = topics;
+    handle->op_qos_list = qos;
+    handle->op_count = n;
+    handle->op_index = 0;
+    
+    LOG_INFO("Subscribing to %u topics", (unsigned)n);
+    op_begin(handle, MQTT_OP_SUBSCRIBE, done, ctx);
+    op_next(handle, SOCKET_MODE(handle) ? SOCK_SUB_SEND : SUBM_TOPIC_CMD);
+    return MQTT_OK;
 }
 
-/* Old Subscribe removed - see implementation above */
+MQTT_Result_t A7600_MQTT_SubscribeMany(A7600_MQTT_Handle_t *handle, const char *const topics[],
+                                       const MQTT_QoS_t qos[], uint8_t n)
+{
+    MQTT_Result_t result = A7600_MQTT_SubscribeManyClientAsync(handle, 0, topics, qos, n, NULL, NULL);
+    
+    if (result != MQTT_OK) {
+        return result;
+    }
+    return op_wait(handle);
+}
 
 MQTT_Result_t A7600_MQTT_Unsubscribe(A7600_MQTT_Handle_t *handle, const char *topic)
 {
@@ -458,11 +4353,37 @@ MQTT_Result_t A7600_MQTT_Unsubscribe(A7600_MQTT_Handle_t *handle, const char *to
     if (handle == NULL || topic == NULL) {
         return MQTT_ERROR;
     }
+    if (handle->in_hook || handle->op != MQTT_OP_NONE) {
+        return MQTT_BUSY;
+    }
     
     if (!handle->connected) {
         return MQTT_NOT_CONNECTED;
     }
     
+    if (SOCKET_MODE(handle)) {
+        /* UNSUBSCRIBE packet (fixed header, id, topic) sent from cmd; UNSUBACK is not awaited */
+        size_t topic_len = strlen(topic);
+        size_t n;
+        char send[24];
+        
+        if (topic_len + 4 + MQTT_PKT_HEADER_MAX > sizeof(cmd)) {
+            return MQTT_ERROR;
+        }
+        n = MQTT_Packet_Header((uint8_t *)cmd, MQTT_PKT_UNSUBSCRIBE, 2 + 2 + topic_len);
+        cmd[n++] = (char)(sock_next_id(handle) >> 8);
+        cmd[n++] = (char)handle->sock_pkt_id;
+        n += MQTT_Packet_String((uint8_t *)&cmd[n], topic, topic_len);
+        
+        snprintf(send, sizeof(send), "AT+CCHSEND=0,%u\r\n", (unsigned)n);
+        if (!send_and_wait(handle, send, ">", MQTT_CMD_TIMEOUT) || !send_zc(handle, (uint8_t *)cmd, n)) {
+            return MQTT_ERROR;
+        }
+        bool ok = wait_response(handle, "OK", MQTT_CMD_TIMEOUT);
+        wait_tx_idle(handle, 1000);     /* cmd is on the stack */
+        return ok ? MQTT_OK : MQTT_ERROR;
+    }
+    
     snprintf(cmd, sizeof(cmd), "AT+CMQTTUNSUB=0,\"%s\"\r\n", topic);
     if (!send_and_wait(handle, cmd, "OK", MQTT_CMD_TIMEOUT)) {
         return MQTT_ERROR;
@@ -471,181 +4392,325 @@ MQTT_Result_t A7600_MQTT_Unsubscribe(A7600_MQTT_Handle_t *handle, const char *to
     return MQTT_OK;
 }
 
-MQTT_Result_t A7600_MQTT_Publish(A7600_MQTT_Handle_t *handle, const char *topic,
-                                  const uint8_t *payload, size_t len,
-                                  MQTT_QoS_t qos, bool retain)
+MQTT_Result_t A7600_MQTT_PublishAsync(A7600_MQTT_Handle_t *handle, const char *topic,
+                                       const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                       MQTT_DoneCallback_t done, void *ctx)
 {
-    char cmd[AT_CMD_MAX_LEN];
+    return A7600_MQTT_PublishClientAsync(handle, 0, topic, payload, len, qos, done, ctx);
+}
+
+/**
+ * @brief Policy entry of a topic: first exact match, or "prefix/#" covering it
+ * @return NULL if none
+ */
+static const MQTT_TopicPolicy_t *policy_find(A7600_MQTT_Handle_t *handle, const char *topic, size_t len)
+{
+    for (uint8_t i = 0; i < handle->policy_count; i++) {
+        const char *t = handle->policy[i].topic;
+        size_t n = strlen(t);
+        
+        if (n >= 2 && t[n - 1] == '#' && t[n - 2] == '/') {
+            /* "a/b/#" covers "a/b" and everything below it */
+            if ((len >= n - 1 && memcmp(topic, t, n - 1) == 0) || (len == n - 2 && memcmp(topic, t, len) == 0)) {
+                return &handle->policy[i];
+            }
+        } else if (n == len && memcmp(topic, t, len) == 0) {
+            return &handle->policy[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Checks and setup shared by the publish entry points (topic not set yet)
+ * @note  The topic's policy sets QoS, retain and the window slots it may take
+ */
+static MQTT_Result_t pub_begin(A7600_MQTT_Handle_t *handle, uint8_t client, const char *topic, size_t topic_len,
+                               const uint8_t *payload, size_t len, MQTT_QoS_t qos, bool retain)
+{
+    const MQTT_TopicPolicy_t *policy;
+    uint8_t window = MQTT_PUB_WINDOW;
+    bool fire;
     
-    if (handle == NULL || topic == NULL || payload == NULL) {
+    if (payload == NULL || client >= handle->clients || len > MQTT_PAYLOAD_MAX_LEN) {
         return MQTT_ERROR;
     }
+    policy = policy_find(handle, topic, topic_len);
+    if (policy != NULL) {
+        qos = (MQTT_QoS_t)policy->qos;
+        retain = retain || policy->retain;
+        if (policy->prio == MQTT_PRIO_LOW) {
+            window--;
+        }
+    }
+    fire = (handle->config.qos0_fire && qos == MQTT_QOS_0 && !SOCKET_MODE(handle));
+    if (handle->in_hook || handle->op != MQTT_OP_NONE ||
+        (fire ? handle->fired[client] >= MQTT_FIRE_MAX : handle->pub_count >= window)) {
+        return MQTT_BUSY;
+    }
     
     if (!handle->connected) {
         return MQTT_NOT_CONNECTED;
     }
     
     handle->state = MQTT_STATE_PUBLISHING;
+    handle->op_client = client;
+    handle->op_payload = payload;
+    handle->op_len = len;
+    handle->op_qos = (uint8_t)qos;
+    handle->op_retain = retain;
+    handle->op_tick = HAL_GetTick();
+    return MQTT_OK;
+}
+
+/**
+ * @brief Start a publish on a topic given as a string
+ */
+static MQTT_Result_t publish_start(A7600_MQTT_Handle_t *handle, uint8_t client, const char *topic,
+                                   const uint8_t *payload, size_t len, MQTT_QoS_t qos, bool retain,
+                                   MQTT_DoneCallback_t done, void *ctx)
+{
+    MQTT_Result_t result;
+    size_t topic_len;
     
-    /* Step 1: Set topic */
-    size_t topic_len = strlen(topic);
-    snprintf(cmd, sizeof(cmd), "AT+CMQTTTOPIC=0,%d\r\n", topic_len);
-    if (!send_and_wait(handle, cmd, ">", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Publish Failed: Set Topic Length. Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
+    if (handle == NULL || topic == NULL) {
         return MQTT_ERROR;
     }
-    
-    /* Send topic */
-    if (!send_and_wait(handle, topic, "OK", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Publish Failed: Send Topic. Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
-        return MQTT_ERROR;
+    topic_len = strlen(topic);      /* Once - every stage and builder reuses it */
+    result = pub_begin(handle, client, topic, topic_len, payload, len, qos, retain);
+    if (result != MQTT_OK) {
+        return result;
     }
-    //HAL_Delay(100);
+    handle->op_topic = topic;
+    handle->op_topic_len = (uint16_t)topic_len;
+    handle->op_desc = NULL;
     
-    /* Step 2: Set payload */
-    snprintf(cmd, sizeof(cmd), "AT+CMQTTPAYLOAD=0,%d\r\n", len);
-    if (!send_and_wait(handle, cmd, ">", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Publish Failed: Set Payload Length. Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
+    op_begin(handle, MQTT_OP_PUBLISH, done, ctx);
+    return MQTT_OK;
+}
+
+MQTT_Result_t A7600_MQTT_PublishClientAsync(A7600_MQTT_Handle_t *handle, uint8_t client, const char *topic,
+                                             const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                             MQTT_DoneCallback_t done, void *ctx)
+{
+    return publish_start(handle, client, topic, payload, len, qos, false, done, ctx);
+}
+
+MQTT_Result_t A7600_MQTT_TopicDescInit(MQTT_TopicDesc_t *desc, uint8_t client, const char *topic)
+{
+    size_t len, n;
+    
+    if (desc == NULL || topic == NULL || client >= MQTT_MAX_CLIENTS) {
         return MQTT_ERROR;
     }
-    
-    /* Send payload */
-    clear_rx_buffer(handle);
-    UART_DMA_Transmit(handle->uart, payload, len);
-    if (!wait_response(handle, "OK", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Publish Failed: Send Payload. Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
+    len = strlen(topic);
+    if (len == 0 || len > MQTT_TOPIC_MAX_LEN) {
         return MQTT_ERROR;
     }
-    //HAL_Delay(100);
     
-    /* Step 3: Publish */
-    /* AT+CMQTTPUB=<client_index>,<qos>,<pub_timeout> */
-    /* Note: retain is often not supported directly or requires different cmd structure. 
-       Standard SIM7600 uses client,qos,timeout */
-    snprintf(cmd, sizeof(cmd), "AT+CMQTTPUB=0,%d,60\r\n", qos);
-    if (!send_and_wait(handle, cmd, "+CMQTTPUB: 0,0", MQTT_CMD_TIMEOUT)) {
-        LOG_ERROR("Publish Failed: Execute Pub. Resp: %s", handle->rx_buffer);
-        handle->state = MQTT_STATE_CONNECTED;
+    desc->topic = topic;
+    desc->len = (uint16_t)len;
+    desc->client = client;
+    
+    /* AT+CMQTTTOPIC=<client>,<len>\r\n - as send_topic_len would build it */
+    n = sizeof("AT+CMQTTTOPIC=") - 1;
+    memcpy(desc->cmd, "AT+CMQTTTOPIC=", n);
+    desc->cmd[n++] = (char)('0' + client);
+    desc->cmd[n++] = ',';
+    n += fmt_uint(&desc->cmd[n], (uint32_t)len);
+    desc->cmd[n++] = '\r';
+    desc->cmd[n++] = '\n';
+    desc->cmd_len = (uint8_t)n;
+    return MQTT_OK;
+}
+
+MQTT_Result_t A7600_MQTT_PublishDescAsync(A7600_MQTT_Handle_t *handle, const MQTT_TopicDesc_t *desc,
+                                           const uint8_t *payload, size_t len, MQTT_QoS_t qos,
+                                           MQTT_DoneCallback_t done, void *ctx)
+{
+    MQTT_Result_t result;
+    
+    if (handle == NULL || desc == NULL) {
         return MQTT_ERROR;
     }
+    result = pub_begin(handle, desc->client, desc->topic, desc->len, payload, len, qos, false);
+    if (result != MQTT_OK) {
+        return result;
+    }
+    handle->op_topic = desc->topic;
+    handle->op_topic_len = desc->len;
+    handle->op_desc = desc;
     
-    handle->state = MQTT_STATE_CONNECTED;
+    op_begin(handle, MQTT_OP_PUBLISH, done, ctx);
     return MQTT_OK;
 }
 
+MQTT_Result_t A7600_MQTT_Publish(A7600_MQTT_Handle_t *handle, const char *topic,
+                                  const uint8_t *payload, size_t len,
+                                  MQTT_QoS_t qos, bool retain)
+{
+    MQTT_PubWait_t wait = { false, MQTT_OK };
+    MQTT_Result_t result = publish_start(handle, 0, topic, payload, len, qos, retain, pub_wait_done, &wait);
+    
+    if (result != MQTT_OK) {
+        return result;
+    }
+    /* Wait for delivery, not just acceptance (but a fire-and-forget QoS 0 publish is done at acceptance) */
+    while (!wait.done) {
+        mqtt_service(handle);
+        if (!wait.done) {
+            mqtt_yield(handle);
+            UART_DMA_WaitEvent(handle->uart, 10);
+        }
+    }
+    return wait.result;
+}
+
 MQTT_Result_t A7600_MQTT_PublishString(A7600_MQTT_Handle_t *handle, const char *topic,
                                         const char *message, MQTT_QoS_t qos)
 {
-    return A7600_MQTT_Publish(handle, topic, (const uint8_t *)message, 
+    return A7600_MQTT_Publish(handle, topic, (const uint8_t *)message,
                                strlen(message), qos, false);
 }
 
+MQTT_Result_t A7600_MQTT_SendDatagram(A7600_MQTT_Handle_t *handle, const uint8_t *data, size_t len)
+{
+    AT_Cmd_t cmd;
+    
+    if (handle == NULL || data == NULL || len == 0 || len > MQTT_UDP_MAX_LEN) {
+        return MQTT_ERROR;
+    }
+    if (!handle->connected || !handle->udp_up) {
+        return MQTT_NOT_CONNECTED;
+    }
+    if (handle->in_hook || handle->op != MQTT_OP_NONE || AT_Engine_Free(&handle->at) < 2) {
+        return MQTT_BUSY;
+    }
+    
+    /* AT+CIPSEND=0,<len>,"<host>",<port>, then the datagram zero-copy behind the prompt */
+    handle->udp_len = (uint16_t)len;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.send = send_cipsend;
+    cmd.expected = ">";
+    cmd.timeout_ms = MQTT_CMD_TIMEOUT;
+    cmd.on_done = udp_prompt_done;
+    cmd.ctx = handle;
+    AT_Engine_Submit(&handle->at, &cmd);
+    cmd.send = NULL;
+    cmd.data = data;
+    cmd.len = len;
+    cmd.expected = "OK";
+    cmd.flags = AT_FLAG_CHAIN | AT_FLAG_KEEP_RX | AT_FLAG_ZC | AT_FLAG_DATA;
+    cmd.on_done = udp_sent_done;
+    AT_Engine_Submit(&handle->at, &cmd);
+    return MQTT_OK;
+}
+
+bool A7600_MQTT_DatagramReady(A7600_MQTT_Handle_t *handle)
+{
+    return (handle != NULL && handle->connected && handle->udp_up);
+}
+
+bool A7600_MQTT_IsBusy(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return false;
+    }
+    return (handle->op != MQTT_OP_NONE || !AT_Engine_IsIdle(&handle->at));
+}
+
+uint8_t A7600_MQTT_PublishInFlight(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return 0;
+    }
+    return handle->pub_count;
+}
+
 void A7600_MQTT_Process(A7600_MQTT_Handle_t *handle)
 {
-    if (handle == NULL || !handle->connected) {
+    if (handle == NULL) {
         return;
     }
+    if (handle->in_hook) {
+        return;  /* URCs are picked up by the outer wait */
+    }
     
-    /* Read any available data */
-    size_t available = UART_DMA_Available(handle->uart);
-    if (available > 0) {
-        size_t space = sizeof(handle->rx_buffer) - handle->rx_len - 1;
-        if (available > space) available = space;
-        
-        size_t len = UART_DMA_Read(handle->uart, 
-                                   &handle->rx_buffer[handle->rx_len], 
-                                   available);
-        handle->rx_len += len;
-        handle->rx_buffer[handle->rx_len] = '\0';
-        
+    /* Read modem data, advance queued commands and the running operation.
+     * Incoming messages and link loss are handled by the URC table. */
+    size_t len = mqtt_service(handle);
+    
+#if MQTT_CMUX
+    if (Cmux_IsOpen(&handle->mux)) {
+        mon_poll(handle);
+    }
+#endif
+    if (handle->op != MQTT_OP_NONE || !AT_Engine_IsIdle(&handle->at)) {
+        return;
+    }
+    
+    if (len > 0) {
         /* Debug log received data */
-        LOG_INFO("MQTT Rx (%d): %s", len, (char*)&handle->rx_buffer[handle->rx_len - len]);
-
-        /* Check for incoming message */
-        char *msg_start = strstr((char *)handle->rx_buffer, "+CMQTTRXSTART:");
-        char *msg_end = strstr((char *)handle->rx_buffer, "+CMQTTRXEND:");
-        
-        if (msg_start != NULL) {
-             LOG_INFO("Found RXSTART");
-        }
-
-        if (msg_start != NULL && msg_end != NULL) {
-            /* We have a complete message! */
-            LOG_INFO("Found Complete Message");
-            
-            /* Find payload marker */
-            char *payload_marker = strstr((char *)handle->rx_buffer, "+CMQTTRXPAYLOAD:");
-            
-            if (payload_marker != NULL && handle->msg_callback != NULL) {
-                /* Simple parsing: 
-                   +CMQTTRXPAYLOAD: <len>
-                   <payload_data>
-                   +CMQTTRXEND: 0
-                */
-                char *payload_line_end = strstr(payload_marker, "\r\n");
-                if (payload_line_end != NULL) {
-                    char *payload_data = payload_line_end + 2; /* Skip \r\n after PAYLOAD line */
-                    
-                    /* Calculate payload length (everything until +CMQTTRXEND) */
-                    char *payload_end = strstr(payload_data, "+CMQTTRXEND");
-                    if (payload_end != NULL) {
-                        /* Remove trailing \r\n before +CMQTTRXEND if present */
-                        if (payload_end > payload_data && *(payload_end - 1) == '\n') payload_end--;
-                        if (payload_end > payload_data && *(payload_end - 1) == '\r') payload_end--;
-                        
-                        size_t payload_len = payload_end - payload_data;
-                        
-                        /* Correct Topic Parsing: Find +CMQTTRXTOPIC: header */
-                        char *topic_header = strstr(msg_start, "+CMQTTRXTOPIC:");
-                        if (topic_header != NULL && topic_header < payload_marker) {
-                            char *topic_len_end = strstr(topic_header, "\r\n");
-                            
-                            if (topic_len_end != NULL && topic_len_end < payload_marker) {
-                                char *topic_start = topic_len_end + 2; /* Topic content is on the next line */
-                                char *topic_end = strstr(topic_start, "\r\n");
-                                
-                                if (topic_end != NULL && topic_end < payload_marker) {
-                                    static char topic_buf[128];
-                                    size_t topic_len = topic_end - topic_start;
-                                    if (topic_len >= sizeof(topic_buf)) topic_len = sizeof(topic_buf) - 1;
-                                    memcpy(topic_buf, topic_start, topic_len);
-                                    topic_buf[topic_len] = '\0';
-                                    
-                                    LOG_INFO("Parsed Msg - Topic: %s, PayloadLen: %d", topic_buf, payload_len);
-
-                                    /* Call callback with parsed topic and payload */
-                                    handle->msg_callback(topic_buf, (uint8_t*)payload_data, payload_len);
-                                }
-                            }
-                        }
-                    }
-                }
-            } else {
-                LOG_ERROR("Parse Error: Marker=%p Callback=%p", payload_marker, handle->msg_callback);
-            }
-            
-            /* Clear buffer */
-            clear_rx_buffer(handle);
+        LOG_INFO("MQTT Rx (%d): %s", (int)len, (char*)&handle->at.rx_buf[handle->at.rx_len - len]);
+    }
+    
+    /* Finished lines are no longer needed */
+    AT_Engine_DiscardLines(&handle->at);
+    
+    /* A session that outlives a few keepalive periods proves the keepalive */
+    if (handle->connected && !handle->ka_proven &&
+        HAL_GetTick() - handle->up_tick >= (uint32_t)handle->ka_used * 1000 * MQTT_KA_PROVE) {
+        ka_survived(handle);
+    }
+    if (handle->ka_dirty) {
+        handle->ka_dirty = false;
+        if (handle->ka_plmn != 0 &&
+            NV_Store_SetKeepalive(handle->ka_plmn, handle->ka_good, handle->ka_bad) != HAL_OK) {
+            LOG_WARN("Keepalive not saved");
         }
-        
-        /* Check for disconnect */
-        if (strstr((char *)handle->rx_buffer, "+CMQTTCONNLOST:") != NULL) {
-            LOG_ERROR("MQTT Connection Lost");
-            handle->connected = false;
-            handle->state = MQTT_STATE_IDLE;
-            clear_rx_buffer(handle);
+    }
+    if (handle->dns_dirty) {
+        handle->dns_dirty = false;
+        if (NV_Store_SetHostIp(handle->dns_hash, handle->dns_ip) != HAL_OK) {
+            LOG_WARN("Broker address not saved");
         }
-        
-        /* Prevent buffer overflow - clear if too full */
-        if (handle->rx_len > sizeof(handle->rx_buffer) - 100) {
-            LOG_WARN("Rx Buffer Full - Clearing");
-            clear_rx_buffer(handle);
+    }
+    if (handle->acq_dirty) {
+        handle->acq_dirty = false;
+        if (NV_Store_SetCell(handle->acq_plmn, handle->acq_band) != HAL_OK) {
+            LOG_WARN("Cell not saved");
         }
     }
+    
+    /* Socket transport: acknowledgements and keepalive pings are ours to send */
+    if (SOCKET_MODE(handle) && handle->connected && sock_service(handle)) {
+        return;
+    }
+    
+    /* Background link-quality sample while nothing else uses the AT channel
+     * (not worth a wake-up: it waits for the next command) */
+    if (handle->connected && handle->dtr_state == DTR_AWAKE && !MUX_OPEN(handle) &&
+        HAL_GetTick() - handle->link_poll_tick >= MQTT_LINK_POLL_INTERVAL) {
+        link_poll(handle);
+    }
+    if (handle->config.dtr != NULL) {
+        modem_sleep(handle);
+    }
+}
+
+size_t A7600_MQTT_FreezeTranscript(A7600_MQTT_Handle_t *handle, const uint8_t **data)
+{
+    if (handle == NULL || data == NULL) {
+        return 0;
+    }
+    return AT_Engine_TraceFreeze(&handle->at, data);
+}
+
+void A7600_MQTT_ResumeTranscript(A7600_MQTT_Handle_t *handle)
+{
+    if (handle != NULL) {
+        AT_Engine_TraceResume(&handle->at);
+    }
 }
 
 bool A7600_MQTT_IsConnected(A7600_MQTT_Handle_t *handle)
@@ -679,3 +4744,179 @@ const char* A7600_MQTT_GetLastResponse(A7600_MQTT_Handle_t *handle)
     }
     return handle->last_response;
 }
+
+/**
+ * @brief Probe answered - the module was up before we started listening
+ */
+static void probe_done(void *ctx, AT_Result_t result)
+{
+    A7600_MQTT_Handle_t *handle = (A7600_MQTT_Handle_t *)ctx;
+    
+    if (result == AT_OK) {
+        handle->modem_flags |= BOOT_AT;
+    }
+}
+
+bool A7600_MQTT_ModuleReady(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return false;
+    }
+    return (handle->modem_flags & (BOOT_SIM | BOOT_AT)) != 0;
+}
+
+void A7600_MQTT_ProbeModule(A7600_MQTT_Handle_t *handle)
+{
+    AT_Cmd_t cmd;
+    
+    if (handle == NULL || handle->in_hook || handle->op != MQTT_OP_NONE || !AT_Engine_IsIdle(&handle->at)) {
+        return;
+    }
+    /* Booting: +CPIN follows RDY within seconds, unless there is no SIM at all */
+    if ((handle->modem_flags & BOOT_RDY) && HAL_GetTick() - handle->rdy_tick < MQTT_BOOT_TIMEOUT) {
+        return;
+    }
+    
+    cmd.data = (const uint8_t *)"AT\r\n";
+    cmd.len = 4;
+    cmd.send = NULL;
+    cmd.expected = "OK";
+    cmd.timeout_ms = 500;
+    cmd.delay_ms = 0;
+    cmd.flags = 0;
+    cmd.on_done = probe_done;
+    cmd.ctx = handle;
+    AT_Engine_Submit(&handle->at, &cmd);
+}
+
+bool A7600_MQTT_SessionPresent(A7600_MQTT_Handle_t *handle, uint8_t client)
+{
+    if (handle == NULL || !handle->config.persistent_session || client >= MQTT_MAX_CLIENTS) {
+        return false;
+    }
+    return (handle->subscribed & (1u << client)) != 0;
+}
+
+const MQTT_ConnectStats_t* A7600_MQTT_GetConnectStats(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+    return &handle->conn_stats;
+}
+
+void A7600_MQTT_SetSleep(A7600_MQTT_Handle_t *handle, bool allow)
+{
+    if (handle == NULL || handle->config.dtr == NULL || allow == handle->sleep_allowed) {
+        return;
+    }
+    handle->sleep_allowed = allow;
+    if (!allow && handle->dtr_state == DTR_ASLEEP) {
+        modem_dtr_low(handle, HAL_GetTick());
+    }
+    LOG_INFO("Modem sleep %s", allow ? "on" : "off");
+}
+
+void A7600_MQTT_Wake(A7600_MQTT_Handle_t *handle)
+{
+    if (handle != NULL && handle->dtr_state == DTR_ASLEEP) {
+        modem_dtr_low(handle, HAL_GetTick());
+        handle->sleep_stats.prewakes++;
+    }
+}
+
+bool A7600_MQTT_Asleep(A7600_MQTT_Handle_t *handle)
+{
+    return (handle != NULL && handle->dtr_state != DTR_AWAKE);
+}
+
+#if MQTT_CMUX
+const Cmux_t* A7600_MQTT_GetMux(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+    return &handle->mux;
+}
+#endif
+
+const MQTT_SleepStats_t* A7600_MQTT_GetSleepStats(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+    return &handle->sleep_stats;
+}
+
+const MQTT_EndpointHealth_t* A7600_MQTT_GetEndpoint(A7600_MQTT_Handle_t *handle, uint8_t index)
+{
+    if (handle == NULL || index >= MQTT_MAX_ENDPOINTS || ep_host(handle, index) == NULL) {
+        return NULL;
+    }
+    return &handle->ep_health[index];
+}
+
+const MQTT_PubStats_t* A7600_MQTT_GetPublishStats(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+    return &handle->pub_stats;
+}
+
+const MQTT_WireStats_t* A7600_MQTT_GetWireStats(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+    return &handle->wire_stats;
+}
+
+uint16_t A7600_MQTT_GetKeepalive(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return 0;
+    }
+    return handle->ka_used;
+}
+
+MQTT_Result_t A7600_MQTT_SetKeepalive(A7600_MQTT_Handle_t *handle, uint16_t seconds, bool adaptive)
+{
+    if (handle == NULL || seconds == 0) {
+        return MQTT_ERROR;
+    }
+    handle->config.keepalive = seconds;
+    handle->config.adaptive_keepalive = adaptive;
+    ka_plan(handle);
+    LOG_INFO("Keepalive %us%s from the next connect", (unsigned)handle->ka_next, adaptive ? " (adaptive)" : "");
+    return MQTT_OK;
+}
+
+const MQTT_LinkQuality_t* A7600_MQTT_GetLinkQuality(A7600_MQTT_Handle_t *handle)
+{
+    if (handle == NULL) {
+        return NULL;
+    }
+    return &handle->link;
+}
+
+bool A7600_MQTT_GetUnixTime(A7600_MQTT_Handle_t *handle, uint32_t tick, uint32_t *sec, uint16_t *ms)
+{
+    int32_t delta;
+    int32_t whole;
+    
+    if (handle == NULL || handle->clock_sec == 0) {
+        return false;
+    }
+    /* Ticks shortly before the sync (a frame queued while connecting) count back */
+    delta = (int32_t)(tick - handle->clock_tick);
+    whole = delta / 1000;
+    delta %= 1000;
+    if (delta < 0) {
+        delta += 1000;
+        whole--;
+    }
+    *sec = handle->clock_sec + (uint32_t)whole;
+    *ms = (uint16_t)delta;
+    return true;
+}
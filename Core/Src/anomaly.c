@@ -0,0 +1,264 @@
+/**
+ * @file    anomaly.c
+ * @brief   Edge anomaly score of the autopilot state - raises the uplink rate of its streams on events
+ * @version 1.0
+ */
+
+#include "anomaly.h"
+
+#if ANOMALY_ENABLE
+
+#include "arm_nnfunctions.h"
+#include "mav_field.h"
+#include "profiler.h"
+#include "debug_log.h"
+#include <string.h>
+
+#define LOG_FILE_ID     9
+#define LOG_MODULE      LOG_MOD_BRIDGE
+
+/* Messages read (common.xml) */
+#define SYS_STATUS_ID   1
+#define ATTITUDE_ID     30
+#define VIBRATION_ID    241
+
+/* Model shape: the step's levels and the window mean in, one score out */
+#define AN_INPUTS       (2 * ANOMALY_FEATURES)
+#define AN_HIDDEN       ANOMALY_FEATURES
+#define AN_L1_SHIFT     6       /* Weights in 1/64: 64 passes a level as is */
+#define AN_L2_SHIFT     6
+#define AN_VOLT_AVG     4       /* Battery voltage average: 1/16 of each new reading */
+
+/* Levels per step, 0..127, each the highest seen in the step */
+enum {
+    F_VIB = 0,          /* Highest vibration axis, 0.5 m/s^2 */
+    F_CLIP,             /* Accelerometer clipping events, 8 per event */
+    F_RATE,             /* Highest body rate, 1/32 rad/s */
+    F_ATT,              /* Roll or pitch off level, 1/128 rad */
+    F_JITTER,           /* Roll + pitch rate change between frames, 1/32 rad/s */
+    F_SAG,              /* Battery voltage under its average, 25 mV */
+    F_LOAD,             /* Autopilot CPU load, 0.8 % */
+    F_HEALTH            /* Sensors enabled but unhealthy, 32 per sensor */
+};
+
+/* Hand-set from what the fields mean: hidden unit i fires when level i rises
+ * past its bias over the window mean (weighted 0 where the level is already a
+ * change). Same shapes and shifts take a trained model's q7 export */
+#define AN_ROW(f, base) [(f) * AN_INPUTS + (f)] = 64, [(f) * AN_INPUTS + ANOMALY_FEATURES + (f)] = -(base)
+static const q7_t l1_weights[AN_HIDDEN * AN_INPUTS] = {
+    AN_ROW(F_VIB, 32), AN_ROW(F_CLIP, 0), AN_ROW(F_RATE, 48), AN_ROW(F_ATT, 32),
+    AN_ROW(F_JITTER, 48), AN_ROW(F_SAG, 0), AN_ROW(F_LOAD, 48), AN_ROW(F_HEALTH, 64)
+};
+static const q7_t l1_bias[AN_HIDDEN] = { -30, -8, -20, -40, -16, -12, -16, 0 };
+static const q7_t l2_weights[AN_HIDDEN] = { 64, 96, 64, 64, 64, 64, 48, 96 };
+static const q7_t l2_bias[1] = { 0 };
+
+static struct {
+    q7_t level[ANOMALY_FEATURES];                   /* Open step */
+    q7_t hist[ANOMALY_WINDOW][ANOMALY_FEATURES];    /* Closed steps, a ring */
+    uint8_t head;
+    uint8_t count;
+    bool started;
+    uint32_t step_tick;
+    uint8_t seq[3];             /* Last frame taken per message (SYS_STATUS, ATTITUDE, VIBRATION) */
+    uint8_t seq_seen;           /* Bit per message */
+    bool rates_seen;
+    int32_t rate_prev[2];       /* Roll and pitch rate of the last ATTITUDE */
+    bool clip_seen;
+    uint32_t clip_prev;         /* Clipping counters of the last VIBRATION, summed */
+    uint32_t volt_avg;          /* mV << AN_VOLT_AVG, 0 until the first reading */
+    bool boosting;
+    uint32_t boost_tick;
+    Anomaly_Stats_t stats;
+} an;
+
+/* ==================== Private Functions ==================== */
+
+static int32_t abs32(int32_t v)
+{
+    return (v < 0) ? -v : v;
+}
+
+/**
+ * @brief Raise a level of the open step to v (clamped to 0..127)
+ */
+static void level_max(uint8_t f, int32_t v)
+{
+    if (v > 127) {
+        v = 127;
+    }
+    if (v > an.level[f]) {
+        an.level[f] = (q7_t)v;
+    }
+}
+
+static void take_vibration(const uint8_t *p)
+{
+    uint32_t clip = MavField_U32(&p[20]) + MavField_U32(&p[24]) + MavField_U32(&p[28]);
+    
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        level_max(F_VIB, MavField_Fixed(&p[8 + 4 * axis], 1));
+    }
+    /* Counters since boot - the events between two frames add up over the step */
+    if (an.clip_seen && clip != an.clip_prev) {
+        uint32_t events = clip - an.clip_prev;
+        int32_t v = an.level[F_CLIP] + (int32_t)((events > 16) ? 128 : events * 8);
+        
+        an.level[F_CLIP] = (q7_t)((v > 127) ? 127 : v);
+    }
+    an.clip_prev = clip;
+    an.clip_seen = true;
+}
+
+static void take_attitude(const uint8_t *p)
+{
+    int32_t rate[3];
+    
+    level_max(F_ATT, abs32(MavField_Fixed(&p[4], 7)));      /* roll */
+    level_max(F_ATT, abs32(MavField_Fixed(&p[8], 7)));      /* pitch */
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        rate[axis] = MavField_Fixed(&p[16 + 4 * axis], 5);
+        level_max(F_RATE, abs32(rate[axis]));
+    }
+    if (an.rates_seen) {
+        level_max(F_JITTER, abs32(rate[0] - an.rate_prev[0]) + abs32(rate[1] - an.rate_prev[1]));
+    }
+    an.rate_prev[0] = rate[0];
+    an.rate_prev[1] = rate[1];
+    an.rates_seen = true;
+}
+
+static void take_sys_status(const uint8_t *p)
+{
+    uint32_t unhealthy = MavField_U32(&p[0]) & MavField_U32(&p[4]) & ~MavField_U32(&p[8]);
+    uint16_t mv = MavField_U16(&p[14]);
+    uint8_t sensors = 0;
+    
+    for (; unhealthy != 0; unhealthy &= unhealthy - 1) {
+        sensors++;
+    }
+    level_max(F_HEALTH, (int32_t)sensors * 32);
+    level_max(F_LOAD, MavField_U16(&p[12]) / 8);
+    
+    /* UINT16_MAX: no battery monitor */
+    if (mv != 0 && mv != UINT16_MAX) {
+        if (an.volt_avg == 0) {
+            an.volt_avg = (uint32_t)mv << AN_VOLT_AVG;
+        }
+        level_max(F_SAG, ((int32_t)(an.volt_avg >> AN_VOLT_AVG) - mv) / 25);
+        an.volt_avg = an.volt_avg - (an.volt_avg >> AN_VOLT_AVG) + mv;
+    }
+}
+
+/**
+ * @brief Close the open step: score it against the window, then add it to the window
+ */
+static void step_close(uint32_t now)
+{
+    q7_t in[AN_INPUTS];
+    q7_t hidden[AN_HIDDEN];
+    q15_t vec_buffer[AN_INPUTS];        /* Used by the DSP build of the layer only */
+    q7_t score;
+    
+    if (an.count == ANOMALY_WINDOW) {
+        PROF_BEGIN(PROF_ANOMALY);
+        for (uint8_t f = 0; f < ANOMALY_FEATURES; f++) {
+            int16_t sum = 0;
+            
+            for (uint8_t s = 0; s < ANOMALY_WINDOW; s++) {
+                sum += an.hist[s][f];
+            }
+            in[f] = an.level[f];
+            in[ANOMALY_FEATURES + f] = (q7_t)(sum / ANOMALY_WINDOW);
+        }
+        arm_fully_connected_q7(in, l1_weights, AN_INPUTS, AN_HIDDEN, AN_L1_SHIFT, AN_L1_SHIFT, l1_bias,
+                               hidden, vec_buffer);
+        arm_relu_q7(hidden, AN_HIDDEN);
+        arm_fully_connected_q7(hidden, l2_weights, AN_HIDDEN, 1, 0, AN_L2_SHIFT, l2_bias, &score, vec_buffer);
+        PROF_END(PROF_ANOMALY);
+        
+        score = (score < 0) ? 0 : score;
+        an.stats.score = (uint8_t)score;
+        an.stats.runs++;
+        if (score > an.stats.peak) {
+            an.stats.peak = (uint8_t)score;
+        }
+        if (score >= ANOMALY_THRESHOLD) {
+            if (!an.boosting) {
+                an.stats.boosts++;
+                LOG_INFO("Anomaly score %d: uplink x%u for %u ms", (int)score, (unsigned)ANOMALY_RATE_BOOST,
+                         (unsigned)ANOMALY_BOOST_MS);
+            }
+            an.boosting = true;
+            an.boost_tick = now;
+        }
+    }
+    
+    memcpy(an.hist[an.head], an.level, sizeof(an.level));
+    an.head = (uint8_t)((an.head + 1) % ANOMALY_WINDOW);
+    if (an.count < ANOMALY_WINDOW) {
+        an.count++;
+    }
+    memset(an.level, 0, sizeof(an.level));
+}
+
+/* ==================== Public Functions ==================== */
+
+void Anomaly_Init(void)
+{
+    memset(&an, 0, sizeof(an));
+}
+
+bool Anomaly_Wants(uint32_t msgid)
+{
+    return (msgid == SYS_STATUS_ID || msgid == ATTITUDE_ID || msgid == VIBRATION_ID);
+}
+
+void Anomaly_Feed(uint32_t msgid, uint8_t seq, const uint8_t *payload, uint32_t now)
+{
+    uint8_t kind = (msgid == SYS_STATUS_ID) ? 0 : (msgid == ATTITUDE_ID) ? 1 : 2;
+    
+    /* Held by the bridge and parsed again */
+    if ((an.seq_seen & (1U << kind)) && an.seq[kind] == seq) {
+        return;
+    }
+    an.seq[kind] = seq;
+    an.seq_seen |= (uint8_t)(1U << kind);
+    
+    /* Steps end at the first frame past them; after a long silence the window starts over */
+    if (!an.started || now - an.step_tick >= (uint32_t)ANOMALY_STEP_MS * ANOMALY_WINDOW) {
+        an.count = 0;
+        an.head = 0;
+        an.rates_seen = false;
+        memset(an.level, 0, sizeof(an.level));
+        an.started = true;
+        an.step_tick = now;
+    } else if (now - an.step_tick >= ANOMALY_STEP_MS) {
+        step_close(now);
+        an.step_tick = now;
+    }
+    if (an.boosting && now - an.boost_tick >= ANOMALY_BOOST_MS) {
+        an.boosting = false;
+        LOG_INFO("Anomaly boost over (peak %u)", (unsigned)an.stats.peak);
+    }
+    
+    if (msgid == VIBRATION_ID) {
+        take_vibration(payload);
+    } else if (msgid == ATTITUDE_ID) {
+        take_attitude(payload);
+    } else {
+        take_sys_status(payload);
+    }
+}
+
+uint8_t Anomaly_RateBoost(uint32_t msgid)
+{
+    return (an.boosting && Anomaly_Wants(msgid)) ? ANOMALY_RATE_BOOST : 1;
+}
+
+const Anomaly_Stats_t *Anomaly_GetStats(void)
+{
+    return &an.stats;
+}
+
+#endif /* ANOMALY_ENABLE */
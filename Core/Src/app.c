@@ -1,36 +1,1872 @@
 /**
  * @file    app.c
  * @brief   Application Layer Implementation
- * @version 1.0
+ * @version 1.36
  */
 
 #include "app.h"
 #include "mavlink_bridge.h"
+#include "outage_log.h"
+#include "low_power.h"
+#include "supervisor.h"
+#include "boot_profile.h"
+#include "modem_power.h"
+#include "config_store.h"
+#include "profiler.h"
+#include "ram_usage.h"
 #include "certificates.h"
 #include "debug_log.h"
+#include "bench_gen.h"
+#include "uplink_probe.h"
+#include "echo_probe.h"
+#include "telem_fields.h"
+#include "link_profile.h"
+#include "ota.h"
+#include "retain.h"
+#include "metrics.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define LOG_FILE_ID         2
+#define LOG_MODULE          LOG_MOD_APP
+
 /* Private variables */
 /* static char publish_buffer[128]; */
+/* Status JSON or performance record - sent zero-copy, must outlive the publish */
+#define APP_STATUS_BUF      288
+static char status_buf[(METRICS_PERF && METRICS_PERF_SIZE > APP_STATUS_BUF) ? METRICS_PERF_SIZE : APP_STATUS_BUF];
+static uint32_t jitter_seed;    /* xorshift32 state for the reconnect jitter */
+static MQTT_TopicDesc_t status_topic;   /* APP_TOPIC_STATUS on the control session, prepared once */
+
+/* Publish policy, applied by the driver whatever QoS a call site passes.
+ * Status and sensor values are retained: a dashboard that subscribes gets
+ * the last state at once. The bridge's topics are not listed - its lanes
+ * pick QoS per publish (QoS0 batches, QoS1 critical frames) */
+static const MQTT_TopicPolicy_t topic_policy[] = {
+    { APP_TOPIC_STATUS,     MQTT_QOS_1, true,  MQTT_PRIO_NORMAL },
+    { APP_TOPIC_SENSOR,     MQTT_QOS_0, true,  MQTT_PRIO_LOW },
+    { APP_TOPIC_RESPONSE,   MQTT_QOS_1, false, MQTT_PRIO_NORMAL },
+    { APP_TOPIC_DIAG_ALL,   MQTT_QOS_1, false, MQTT_PRIO_LOW },     /* Transcripts, uplink probe */
+#if FIELDS_ENABLE
+    { FIELDS_TOPIC,         MQTT_QOS_0, true,  MQTT_PRIO_LOW },     /* Decoded fields: the last state for a new map */
+#endif
+};
+
+/* Detailed status reports taken in turn (the profiler build adds the hot-path sites,
+ * the bench build the generator run, the register-level UART path its interrupt timing) */
+#define APP_STATUS_TURNS    (6 + PROFILER_ENABLE + BENCH_BRIDGE + UART_DMA_LL)
+
+/* Reconnect backoff per failure (A7600_MQTT_GetErrorStep): each retry waits
+ * half to all of the base, which doubles per failure up to the cap. Broker
+ * side failures and drops retry from 1 s with the driver's tiered
+ * reconnect; network failures (carrier outage, no coverage) start slower
+ * and back off further, so they do not hammer the modem */
+#define BACKOFF_BROKER      0
+#define BACKOFF_NETWORK     1
+#define BACKOFF_MODULE      2
+
+static const struct {
+    uint32_t first_ms;
+    uint32_t cap_ms;
+} backoff_tiers[] = {
+    { 1000,   60000 },  /* 0 (drop), 7-10: MQTT start, client, SSL, connect */
+    { 5000,  300000 },  /* 3-6: registration, GPRS, PDP, signal */
+    { 2000,   60000 },  /* 1-2: module, SIM */
+};
+
+/* Private function prototypes */
+static void mqtt_chunk_callback(const char *topic, const uint8_t *data, size_t len,
+                                size_t offset, size_t total);
+static bool publish_link_stats(App_Handle_t *app);
+static bool publish_connect_stats(App_Handle_t *app);
+static bool publish_perf_stats(App_Handle_t *app);
+static bool publish_wire_stats(App_Handle_t *app);
+static bool publish_registry(App_Handle_t *app);
+static bool publish_latency_stats(App_Handle_t *app);
+static bool publish_sched_stats(App_Handle_t *app);
+static bool publish_reset(App_Handle_t *app);
+static bool publish_boot_profile(App_Handle_t *app);
+#if PROFILER_ENABLE
+static bool publish_prof_stats(App_Handle_t *app);
+static bool publish_codec_bench(App_Handle_t *app);
+#endif
+#if OTA_ENABLE
+static bool publish_ota(App_Handle_t *app);
+#endif
+#if PROFILE_ENABLE
+static bool publish_profile(App_Handle_t *app);
+#endif
+#if BENCH_BRIDGE
+static bool publish_bench_stats(App_Handle_t *app);
+#endif
+#if UART_DMA_LL
+static bool publish_irq_stats(App_Handle_t *app);
+#endif
+static bool publish_metrics(App_Handle_t *app);
+static bool publish_reply(App_Handle_t *app);
+static void app_connect_done(void *ctx, MQTT_Result_t result);
+static void app_idle(void *ctx);
+static void app_subscribe_done(void *ctx, MQTT_Result_t result);
+static void app_announce_online(App_Handle_t *app);
+static void app_diag_done(void *ctx, MQTT_Result_t result);
+static void app_backoff(App_Handle_t *app, uint8_t step);
+
+/* Subscribed in one SUBSCRIBE after every connect */
+static const char *const sub_topics[] = {
+    BRIDGE_TOPIC_RX, APP_TOPIC_COMMAND,
+#if OTA_ENABLE
+    OTA_TOPIC,
+#endif
+#if ECHO_ENABLE
+    ECHO_TOPIC,
+#endif
+};
+static const MQTT_QoS_t sub_qos[] = {
+    MQTT_QOS_0, MQTT_QOS_1,
+#if OTA_ENABLE
+    MQTT_QOS_0,         /* Lost OTA data is sent again */
+#endif
+#if ECHO_ENABLE
+    MQTT_QOS_0,
+#endif
+};
+
+/* Set from the chunk callback (no app handle there), picked up by the status task */
+static volatile bool diag_requested;
+#if PROFILER_ENABLE
+/* Codec micro-benchmark asked for over APP_CMD_CODECS */
+static volatile bool codecs_requested;
+#endif
+/* The driver's configuration: its strings point into the config store, fetched again after every set */
+static MQTT_Config_t *live_config;
+/* Keepalive asked for over APP_CMD_KA (0: none), applied by the link task */
+static volatile uint16_t ka_requested;
+#define APP_KA_ADAPTIVE     0xFFFF
+/* Modem sleep on the ground (APP_CMD_SLEEP), applied by the link task */
+static volatile bool sleep_enabled;
+
+/* Reply to the last command, published on APP_TOPIC_RESPONSE by the status task */
+static struct {
+    char cmd[8];
+    bool ok;
+    volatile bool pending;
+} reply;
+
+/* Settings of APP_CMD_CFG ("cfg rate <msgid> <hz>" stores uplink limits) */
+static const struct {
+    const char *name;
+    uint16_t key;
+    uint8_t max;        /* Longest text; 0: number */
+} config_keys[] = {
+    { "broker", CONFIG_BROKER,    MQTT_BROKER_MAX_LEN - 1 },
+    { "port",   CONFIG_PORT,      0 },
+    { "user",   CONFIG_USERNAME,  MQTT_USERNAME_MAX_LEN - 1 },
+    { "pass",   CONFIG_PASSWORD,  MQTT_PASSWORD_MAX_LEN - 1 },
+    { "id",     CONFIG_CLIENT_ID, MQTT_CLIENT_ID_MAX_LEN - 1 },
+    { "apn",    CONFIG_APN,       MQTT_APN_MAX_LEN - 1 },
+    { "ka",     CONFIG_KEEPALIVE, 0 },
+    { "standby", CONFIG_STANDBY,  MQTT_BROKER_MAX_LEN - 1 },
+    { "bmin",   CONFIG_BATCH_MIN,    0 },
+    { "bmax",   CONFIG_BATCH_MAX,    0 },
+    { "dmin",   CONFIG_DEADLINE_MIN, 0 },
+    { "dmax",   CONFIG_DEADLINE_MAX, 0 },
+#if TOPIC_NS_ENABLE
+    { "dev",    CONFIG_DEVICE_ID,    TOPIC_NS_ID_MAX },
+#endif
+#if PROFILE_ENABLE
+    { "pfull",  CONFIG_PROFILE_FULL,    CONFIG_VALUE_MAX - 1 },
+    { "pred",   CONFIG_PROFILE_REDUCED, CONFIG_VALUE_MAX - 1 },
+    { "pmin",   CONFIG_PROFILE_MINIMAL, CONFIG_VALUE_MAX - 1 },
+    { "pgnd",   CONFIG_PROFILE_GROUND,  CONFIG_VALUE_MAX - 1 },
+#endif
+#if METRICS_PERF
+    { "perf",   CONFIG_PERF_INTERVAL,   0 },
+#endif
+};
+
+#if METRICS_PERF
+/* Performance record: interval (cfg perf, s, kept in ms) and the last one */
+static uint32_t perf_interval = METRICS_PERF_INTERVAL * 1000U;
+static uint32_t perf_tick;
+#endif
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Stored text, or the built-in default
+ */
+static const char *app_config_text(uint16_t key, const char *fallback)
+{
+    const char *text = ConfigStore_GetText(key);
+    
+    return (text != NULL) ? text : fallback;
+}
+
+#if MODEM_SLEEP_DTR
+/**
+ * @brief Modem DTR line (high: the module may sleep)
+ */
+static void app_modem_dtr(bool high)
+{
+    HAL_GPIO_WritePin(MODEM_DTR_GPIO_Port, MODEM_DTR_Pin, high ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+#endif
+
+/**
+ * @brief Point the MQTT settings at the stored values, the built-in ones where none are stored
+ */
+static void app_load_config(MQTT_Config_t *config)
+{
+    uint32_t value;
+    
+    config->broker = app_config_text(CONFIG_BROKER, APP_MQTT_BROKER);
+    config->username = app_config_text(CONFIG_USERNAME, APP_MQTT_USERNAME);
+    config->password = app_config_text(CONFIG_PASSWORD, APP_MQTT_PASSWORD);
+#if TOPIC_NS_ENABLE
+    config->client_id = app_config_text(CONFIG_CLIENT_ID, TopicNs_ClientId());
+#else
+    config->client_id = app_config_text(CONFIG_CLIENT_ID, APP_MQTT_CLIENT_ID);
+#endif
+    config->apn = app_config_text(CONFIG_APN, "");     /* None stored: the SIM's carrier profile */
+    config->standby[0].broker = app_config_text(CONFIG_STANDBY, APP_MQTT_STANDBY);
+    if (ConfigStore_GetU32(CONFIG_PORT, &value) && value != 0 && value <= 0xFFFF) {
+        config->port = (uint16_t)value;
+    }
+    if (ConfigStore_GetU32(CONFIG_KEEPALIVE, &value) && value != 0 && value <= 0xFFFF) {
+        config->keepalive = (uint16_t)value;
+    }
+}
+
+/**
+ * @brief Give the batching controller the stored bounds, the bridge's own where none are stored
+ * @note  With PROFILE_ENABLE the telemetry profile's bounds go over them, and its
+ *        stored spec is read again
+ */
+static void app_load_batch_bounds(void)
+{
+    static const uint16_t keys[4] = { CONFIG_BATCH_MIN, CONFIG_BATCH_MAX, CONFIG_DEADLINE_MIN, CONFIG_DEADLINE_MAX };
+    uint16_t bounds[4];
+    uint32_t value;
+    bool stored = false;
+    
+#if PROFILE_ENABLE
+    LinkProfile_GetBase(bounds);        /* Not the profile's own */
+#else
+    MavlinkBridge_GetBatchBounds(&bounds[0], &bounds[1], &bounds[2], &bounds[3]);
+#endif
+    for (uint8_t i = 0; i < 4; i++) {
+        if (ConfigStore_GetU32(keys[i], &value) && value != 0 && value <= 0xFFFF) {
+            bounds[i] = (uint16_t)value;
+            stored = true;
+        }
+    }
+#if PROFILE_ENABLE
+    if (!LinkProfile_Reload(bounds) && stored) {
+#else
+    if (stored && !MavlinkBridge_SetBatchBounds(bounds[0], bounds[1], bounds[2], bounds[3])) {
+#endif
+        LOG_WARN("Config: bad batch bounds %u-%u B, %u-%u ms", (unsigned)bounds[0], (unsigned)bounds[1],
+                 (unsigned)bounds[2], (unsigned)bounds[3]);
+    }
+}
+
+#if METRICS_PERF
+/**
+ * @brief Performance record interval: the stored one, or METRICS_PERF_INTERVAL
+ */
+static void app_load_perf_interval(void)
+{
+    uint32_t value;
+    
+    perf_interval = METRICS_PERF_INTERVAL * 1000U;
+    if (ConfigStore_GetU32(CONFIG_PERF_INTERVAL, &value) && value != 0 && value <= 0xFFFF) {
+        perf_interval = value * 1000U;
+    }
+}
+#endif
+
+/**
+ * @brief Carry on from the state the last run saved, after a warm reset: counters, control loops
+ */
+static void app_restore(App_Handle_t *app)
+{
+    const Retain_State_t *st = Retain_Boot(app->warm_boot);
+    
+    app->resets = 0;
+    memset(app->traffic_base, 0, sizeof(app->traffic_base));
+    app->retain_tick = HAL_GetTick();
+    if (st == NULL) {
+        return;
+    }
+    app->resets = st->resets + 1U;
+    app->connects = st->connects;
+    memcpy(app->traffic_base, st->traffic, sizeof(app->traffic_base));
+    app->mqtt.pub_stats = st->pub;
+    app->metrics_delivered = st->pub.delivered;
+    MavlinkBridge_RestoreState(&st->bridge);
+    LOG_INFO("Retained state: reset %lu, %lu connects, %lu publishes", (unsigned long)app->resets,
+             (unsigned long)app->connects, (unsigned long)st->pub.delivered);
+}
+
+/**
+ * @brief Save the state a warm reset carries over
+ */
+static void app_retain(App_Handle_t *app)
+{
+    extern UART_DMA_Handle_t telem_uart;
+    Retain_State_t *st = Retain_Open();
+    uint32_t traffic[4];
+    
+    UART_DMA_GetTraffic(&telem_uart, &traffic[1], &traffic[0]);
+    UART_DMA_GetTraffic(app->uart, &traffic[2], &traffic[3]);
+    for (uint8_t i = 0; i < 4; i++) {
+        st->traffic[i] = app->traffic_base[i] + traffic[i];
+    }
+    st->resets = app->resets;
+    st->connects = app->connects;
+    st->pub = app->mqtt.pub_stats;
+    MavlinkBridge_SaveState(&st->bridge);
+    Retain_Close();
+}
+
+/**
+ * @brief Apply a stored uplink limit (ConfigStore_ForEach visitor)
+ */
+static void app_load_rate(uint16_t key, const uint8_t *value, uint8_t len, void *ctx)
+{
+    (void)ctx;
+    if (len != 1 || !MavlinkBridge_SetRate(key & ~CONFIG_RATE, value[0])) {
+        LOG_WARN("Config: bad rate record %u", (unsigned)(key & ~CONFIG_RATE));
+    }
+}
+
+/**
+ * @brief "cfg <name> [value]": store a setting (MQTT ones apply at the next connect, rates and
+ *        batch bounds at once)
+ * @param args "<name> [value]", modified
+ * @return true if stored
+ */
+static bool app_config_command(char *args)
+{
+    char *value = strchr(args, ' ');
+    char *end;
+    uint8_t raw[4];
+    HAL_StatusTypeDef status = HAL_ERROR;
+    
+    if (value != NULL) {
+        *value++ = '\0';
+    }
+    
+    if (strcmp(args, "rate") == 0 && value != NULL) {
+        unsigned long msgid = strtoul(value, &end, 10);
+        
+        if (end != value && msgid < CONFIG_RATE) {
+            if (*end == '\0') {
+                status = ConfigStore_Set((uint16_t)(CONFIG_RATE | msgid), NULL, 0);  /* Default from next boot */
+            } else {
+                unsigned long hz = strtoul(end, &end, 10);
+                
+                raw[0] = (uint8_t)hz;
+                if (*end == '\0' && hz <= BRIDGE_RATE_ALWAYS && MavlinkBridge_SetRate(msgid, raw[0])) {
+                    status = ConfigStore_Set((uint16_t)(CONFIG_RATE | msgid), raw, 1);
+                }
+            }
+        }
+    }
+    for (uint8_t i = 0; i < sizeof(config_keys) / sizeof(config_keys[0]) && status != HAL_OK; i++) {
+        if (strcmp(args, config_keys[i].name) != 0) {
+            continue;
+        }
+        if (value == NULL) {
+            status = ConfigStore_Set(config_keys[i].key, NULL, 0);
+        } else if (config_keys[i].max == 0) {
+            unsigned long num = strtoul(value, &end, 10);
+            
+            raw[0] = (uint8_t)num;
+            raw[1] = (uint8_t)(num >> 8);
+            raw[2] = 0;
+            raw[3] = 0;
+            if (end != value && *end == '\0' && num != 0 && num <= 0xFFFF) {
+                status = ConfigStore_Set(config_keys[i].key, raw, sizeof(raw));
+            }
+        } else if (strlen(value) <= config_keys[i].max) {
+            status = ConfigStore_Set(config_keys[i].key, value, (uint8_t)(strlen(value) + 1));  /* Read in place */
+        }
+        break;
+    }
+    
+    if (status != HAL_OK) {
+        return false;
+    }
+    LOG_INFO("Config: %s stored", args);
+    
+    /* The set may have moved every value to the other page: fetch the strings again
+     * (a session keeps its settings, the next connect uses the new ones) */
+    if (live_config != NULL) {
+        app_load_config(live_config);
+    }
+    app_load_batch_bounds();
+#if METRICS_PERF
+    app_load_perf_interval();
+#endif
+    return true;
+}
+
+/**
+ * @brief Queue the reply to a command for APP_TOPIC_RESPONSE (the status task publishes it)
+ * @param cmd Command text (its first word names it in the reply)
+ */
+static void app_reply(const char *cmd, bool ok)
+{
+    size_t n = strcspn(cmd, " ");
+    
+    if (n > sizeof(reply.cmd) - 1) {
+        n = sizeof(reply.cmd) - 1;
+    }
+    memcpy(reply.cmd, cmd, n);
+    reply.cmd[n] = '\0';
+    reply.ok = ok;
+    reply.pending = true;
+    if (!ok) {
+        LOG_WARN("Bad command: %s", cmd);
+    }
+}
+
+/**
+ * @brief Command on APP_TOPIC_COMMAND (whole message in one chunk)
+ */
+static void app_command(const uint8_t *data, size_t len)
+{
+    char text[sizeof(APP_CMD_CFG) + 8 + CONFIG_VALUE_MAX];
+    char *end;
+    bool ok = false;
+    
+    if (len >= sizeof(text)) {
+        LOG_WARN("Command too long (%d B)", (int)len);
+        app_reply("?", false);
+        return;
+    }
+    memcpy(text, data, len);
+    text[len] = '\0';
+    
+    if (strcmp(text, APP_CMD_DIAG) == 0) {
+        diag_requested = true;
+        ok = true;
+    } else if (strcmp(text, APP_CMD_GET) == 0) {
+        ok = true;      /* The reply carries the current settings */
+    } else if (strncmp(text, APP_CMD_RATE, sizeof(APP_CMD_RATE) - 1) == 0) {
+        unsigned long msgid = strtoul(&text[sizeof(APP_CMD_RATE) - 1], &end, 10);
+        unsigned long hz = strtoul(end, &end, 10);
+        
+        ok = (*end == '\0' && hz <= BRIDGE_RATE_ALWAYS && MavlinkBridge_SetRate(msgid, (uint8_t)hz));
+    } else if (strncmp(text, APP_CMD_ENC, sizeof(APP_CMD_ENC) - 1) == 0) {
+        ok = MavlinkBridge_SetEncodingName(&text[sizeof(APP_CMD_ENC) - 1]);
+    } else if (strncmp(text, APP_CMD_ROUTE, sizeof(APP_CMD_ROUTE) - 1) == 0) {
+        unsigned long sysid = strtoul(&text[sizeof(APP_CMD_ROUTE) - 1], &end, 10);
+        unsigned long compid = strtoul(end, &end, 10);
+        unsigned long prio = strtoul(end, &end, 10);
+        
+        ok = (*end == '\0' && sysid <= 255 && compid <= 255 &&
+              MavlinkBridge_SetSourcePriority((uint8_t)sysid, (uint8_t)compid, (MavlinkBridge_Priority_t)prio));
+    } else if (strncmp(text, APP_CMD_SHARE, sizeof(APP_CMD_SHARE) - 1) == 0) {
+        unsigned long sysid = strtoul(&text[sizeof(APP_CMD_SHARE) - 1], &end, 10);
+        unsigned long compid = strtoul(end, &end, 10);
+        unsigned long bytes = strtoul(end, &end, 10);
+        
+        ok = (*end == '\0' && sysid <= 255 && compid <= 255 && bytes <= 0xFFFF &&
+              MavlinkBridge_SetSourceShare((uint8_t)sysid, (uint8_t)compid, (uint16_t)bytes));
+    } else if (strncmp(text, APP_CMD_BATCH, sizeof(APP_CMD_BATCH) - 1) == 0) {
+        unsigned long bytes = strtoul(&text[sizeof(APP_CMD_BATCH) - 1], &end, 10);
+        unsigned long ms = strtoul(end, &end, 10);
+        
+        ok = (*end == '\0' && bytes <= 0xFFFF && ms <= 0xFFFF &&
+              MavlinkBridge_SetBatching((uint16_t)bytes, (uint16_t)ms));
+    } else if (strncmp(text, APP_CMD_STAMP, sizeof(APP_CMD_STAMP) - 1) == 0) {
+        const char *arg = &text[sizeof(APP_CMD_STAMP) - 1];
+        
+        ok = ((arg[0] == '0' || arg[0] == '1') && arg[1] == '\0');
+        if (ok) {
+            MavlinkBridge_SetStamps(arg[0] == '1');
+        }
+    } else if (strncmp(text, APP_CMD_HDR, sizeof(APP_CMD_HDR) - 1) == 0) {
+        const char *arg = &text[sizeof(APP_CMD_HDR) - 1];
+        
+        ok = ((arg[0] == '0' || arg[0] == '1') && arg[1] == '\0' && MavlinkBridge_SetHeaderPack(arg[0] == '1'));
+    } else if (strncmp(text, APP_CMD_SLEEP, sizeof(APP_CMD_SLEEP) - 1) == 0) {
+        const char *arg = &text[sizeof(APP_CMD_SLEEP) - 1];
+        
+        ok = (MODEM_SLEEP_DTR && (arg[0] == '0' || arg[0] == '1') && arg[1] == '\0');
+        if (ok) {
+            sleep_enabled = (arg[0] == '1');
+        }
+    } else if (strncmp(text, APP_CMD_KA, sizeof(APP_CMD_KA) - 1) == 0) {
+        const char *arg = &text[sizeof(APP_CMD_KA) - 1];
+        unsigned long s = strtoul(arg, &end, 10);
+        
+        /* Applied by the link task (the driver handle is not reachable from here) */
+        if (strcmp(arg, "auto") == 0) {
+            ka_requested = APP_KA_ADAPTIVE;
+            ok = true;
+        } else if (end != arg && *end == '\0' && s >= MQTT_KA_MIN && s <= MQTT_KA_MAX) {
+            ka_requested = (uint16_t)s;
+            ok = true;
+        }
+    } else if (strncmp(text, APP_CMD_CFG, sizeof(APP_CMD_CFG) - 1) == 0) {
+        ok = app_config_command(&text[sizeof(APP_CMD_CFG) - 1]);
+    } else if (strncmp(text, APP_CMD_LOG, sizeof(APP_CMD_LOG) - 1) == 0) {
+        ok = Debug_SetLevelName(&text[sizeof(APP_CMD_LOG) - 1]);   /* false without DEBUG_ENABLE */
+#if BENCH_BRIDGE
+    } else if (strncmp(text, APP_CMD_BENCH, sizeof(APP_CMD_BENCH) - 1) == 0) {
+        unsigned long percent = strtoul(&text[sizeof(APP_CMD_BENCH) - 1], &end, 10);
+        
+        ok = (*end == '\0' && percent <= BENCH_RATE_MAX && BenchGen_SetRate((uint16_t)percent));
+#endif
+#if SUMMARY_ENABLE
+    } else if (strncmp(text, APP_CMD_SUM, sizeof(APP_CMD_SUM) - 1) == 0) {
+        unsigned long ms = strtoul(&text[sizeof(APP_CMD_SUM) - 1], &end, 10);
+        
+        ok = (*end == '\0' && ms <= 0xFFFF && MavlinkBridge_SetSummary((uint16_t)ms));
+#endif
+#if OTA_ENABLE
+    } else if (strcmp(text, APP_CMD_OTA "apply") == 0) {
+        ok = Ota_RequestApply();        /* Installed once this reply is out */
+    } else if (strncmp(text, APP_CMD_OTA, sizeof(APP_CMD_OTA) - 1) == 0) {
+        unsigned long size = strtoul(&text[sizeof(APP_CMD_OTA) - 1], &end, 10);
+        unsigned long crc = strtoul(end, &end, 16);
+        
+        ok = (*end == '\0' && Ota_Begin((uint32_t)size, (uint32_t)crc));
+#endif
+    } else if (strcmp(text, APP_CMD_SNAP) == 0) {
+        ok = MavlinkBridge_Snapshot();
+#if PROFILER_ENABLE
+    } else if (strcmp(text, APP_CMD_CODECS) == 0) {
+        codecs_requested = true;
+        ok = true;
+#endif
+#if PROFILE_ENABLE
+    } else if (strncmp(text, APP_CMD_PROF, sizeof(APP_CMD_PROF) - 1) == 0) {
+        int profile = LinkProfile_Find(&text[sizeof(APP_CMD_PROF) - 1]);
+        
+        ok = (profile >= 0 && LinkProfile_Set((LinkProfile_t)profile));
+#endif
+    }
+    app_reply(text, ok);
+}
+
+/**
+ * @brief Driver idle hook - blocking calls keep the FC stream serviced
+ */
+static void app_idle(void *ctx)
+{
+    (void)ctx;
+    MavlinkBridge_Idle();
+}
+
+/**
+ * @brief Route of APP_TOPIC_COMMAND - commands are short, split ones are ignored
+ */
+static void command_chunk(const char *topic, const uint8_t *data, size_t len,
+                          size_t offset, size_t total)
+{
+    (void)topic;
+    if (offset == 0 && len == total) {
+        app_command(data, len);
+    }
+}
+
+/**
+ * @brief Messages on topics without a route
+ */
+static void mqtt_chunk_callback(const char *topic, const uint8_t *data, size_t len,
+                                size_t offset, size_t total)
+{
+    (void)data; (void)len; (void)total;
+    if (offset == 0) {
+        LOG_WARN("Ignored topic: %s", topic);
+    }
+}
+
+/**
+ * @brief Schedule the next reconnect after a failure
+ * @param step Failed connect step (A7600_MQTT_GetErrorStep), 0 for a dropped session
+ */
+static void app_backoff(App_Handle_t *app, uint8_t step)
+{
+    uint8_t tier = (step >= 1 && step <= 2) ? BACKOFF_MODULE :
+                   (step >= 3 && step <= 6) ? BACKOFF_NETWORK : BACKOFF_BROKER;
+    
+    if (tier != app->backoff_tier) {
+        app->backoff_tier = tier;
+        app->backoff_ms = 0;
+    }
+    if (app->backoff_ms == 0) {
+        app->backoff_ms = backoff_tiers[tier].first_ms;
+    }
+    
+    /* Equal jitter: base/2 plus up to base/2, so a fleet does not retry in step */
+    jitter_seed ^= jitter_seed << 13;
+    jitter_seed ^= jitter_seed >> 17;
+    jitter_seed ^= jitter_seed << 5;
+    app->retry_delay = app->backoff_ms / 2U + jitter_seed % (app->backoff_ms / 2U + 1U);
+    app->last_reconnect_tick = HAL_GetTick();
+    app->settling = false;
+    LOG_INFO("Reconnect in %lu ms (step %u, base %lu)", (unsigned long)app->retry_delay,
+             (unsigned)step, (unsigned long)app->backoff_ms);
+    
+    app->backoff_ms *= 2U;
+    if (app->backoff_ms > backoff_tiers[tier].cap_ms) {
+        app->backoff_ms = backoff_tiers[tier].cap_ms;
+    }
+}
+
+/**
+ * @brief Connect finished - subscribe to the bridge topic next
+ */
+static void app_connect_done(void *ctx, MQTT_Result_t result)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    
+    LOG_INFO("App_Connect: Result = %d", result);
+    if (result != MQTT_OK) {
+        /* Keep the failed sequence - it is published once a connect gets through */
+        if (!app->diag_pending) {
+            const uint8_t *data;
+            
+            A7600_MQTT_FreezeTranscript(&app->mqtt, &data);
+            app->diag_pending = true;
+        }
+        app->state = APP_STATE_ERROR;
+        app->error_count++;
+        app_backoff(app, A7600_MQTT_GetErrorStep(&app->mqtt));
+        return;
+    }
+    
+    app->state = APP_STATE_CONNECTED;
+    app->error_count = 0;
+    app->connects++;
+    app->connected_tick = HAL_GetTick();
+    app->stats_pending = true;
+    MavlinkBridge_Snapshot();   /* The slow state messages at once, not as they come round */
+#if PROBE_ENABLE
+    UplinkProbe_Start();
+#endif
+    
+    /* Broker kept our subscriptions (and buffered QoS1 commands) - no SUBSCRIBE round trip */
+    if (A7600_MQTT_SessionPresent(&app->mqtt, APP_CLIENT_CONTROL)) {
+        LOG_INFO("App_Connect: Session present, skipping resubscribe");
+        app_announce_online(app);
+        return;
+    }
+    
+    /* Subscribe to Bridge Rx */
+    LOG_INFO("App_Connect: Subscribing...");
+    A7600_MQTT_SubscribeManyClientAsync(&app->mqtt, APP_CLIENT_CONTROL, sub_topics, sub_qos,
+                                        (uint8_t)(sizeof(sub_topics) / sizeof(sub_topics[0])),
+                                        app_subscribe_done, app);
+}
+
+/**
+ * @brief Subscribe finished - announce we are online
+ */
+static void app_subscribe_done(void *ctx, MQTT_Result_t result)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    
+    if (result != MQTT_OK) {
+        LOG_ERROR("Subscribe to RX Topic Failed!");
+    } else {
+        LOG_INFO("Subscribed to RX Topic: %s", BRIDGE_TOPIC_RX);
+        BootProfile_Mark(BOOT_MARK_SUBACK);
+    }
+    
+    app_announce_online(app);
+}
+
+/**
+ * @brief Publish online status
+ */
+static void app_announce_online(App_Handle_t *app)
+{
+    static const char online[] = "online";
+    
+    /* Publish online status */
+    A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                (const uint8_t *)online, sizeof(online) - 1, MQTT_QOS_1, NULL, NULL);
+}
+
+/**
+ * @brief Publish the frozen AT transcript
+ * @return true if the publish was started (transcript resumes when it is done)
+ */
+static bool publish_diag(App_Handle_t *app)
+{
+    const uint8_t *data;
+    size_t len;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    len = A7600_MQTT_FreezeTranscript(&app->mqtt, &data);
+    if (len == 0) {
+        A7600_MQTT_ResumeTranscript(&app->mqtt);
+        return true;    /* Nothing recorded (AT_TRACE_SIZE 0) */
+    }
+    return (A7600_MQTT_PublishClientAsync(&app->mqtt, APP_CLIENT_CONTROL, APP_TOPIC_DIAG, data, len,
+                                          MQTT_QOS_1, app_diag_done, app) == MQTT_OK);
+}
+
+#if METRICS_PERF
+/**
+ * @brief Publish the registry as one performance record (metrics.h) on APP_TOPIC_PERF
+ * @return true if the publish was started
+ */
+static bool publish_perf(App_Handle_t *app)
+{
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    n = Metrics_Perf((uint8_t *)status_buf, sizeof(status_buf), HAL_GetTick());
+    return (n > 0 && A7600_MQTT_PublishClientAsync(&app->mqtt, APP_CLIENT_CONTROL, APP_TOPIC_PERF,
+                                                   (const uint8_t *)status_buf, n, MQTT_QOS_0,
+                                                   NULL, NULL) == MQTT_OK);
+}
+#endif
+
+/**
+ * @brief Transcript publish finished - record again
+ */
+static void app_diag_done(void *ctx, MQTT_Result_t result)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    
+    (void)result;
+    A7600_MQTT_ResumeTranscript(&app->mqtt);
+}
+
+/**
+ * @brief Publish UART error counters of both links (wiring / EMI diagnostics) and link quality
+ * @return true if the publish was started
+ */
+static bool publish_link_stats(App_Handle_t *app)
+{
+    extern UART_DMA_Handle_t telem_uart;
+    const MQTT_LinkQuality_t *lq = A7600_MQTT_GetLinkQuality(&app->mqtt);
+    UART_DMA_ErrorStats_t fc, modem;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    UART_DMA_GetErrors(&telem_uart, &fc);
+    UART_DMA_GetErrors(app->uart, &modem);
+    
+    /* lq: [csq, rsrp 0.1 dBm, rsrq 0.1 dB, sinr dB, cell changes] */
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"up\":%lu,\"fc\":[%lu,%lu,%lu,%lu,%lu],\"fc_baud\":%lu,\"fc_rts\":%lu,"
+             "\"modem\":[%lu,%lu,%lu,%lu,%lu],\"lq\":[%u,%d,%d,%d,%u]}",
+             (unsigned long)(HAL_GetTick() / 1000),
+             (unsigned long)fc.ore, (unsigned long)fc.fe, (unsigned long)fc.ne,
+             (unsigned long)fc.pe, (unsigned long)fc.rx_restarts, (unsigned long)UART_DMA_GetBaudRate(&telem_uart),
+             (unsigned long)UART_DMA_GetRtsRaises(&telem_uart),
+             (unsigned long)modem.ore, (unsigned long)modem.fe, (unsigned long)modem.ne,
+             (unsigned long)modem.pe, (unsigned long)modem.rx_restarts,
+             (unsigned)lq->csq, (int)lq->rsrp, (int)lq->rsrq, (int)lq->sinr, (unsigned)lq->cell_changes);
+#if PROBE_ENABLE
+    /* probe: [uplink B/s, ms a publish, probes, connects that reused one, failed] */
+    const UplinkProbe_Result_t *probe = UplinkProbe_GetResult();
+    size_t n = strlen(status_buf) - 1;
+    
+    snprintf(&status_buf[n], sizeof(status_buf) - n, ",\"probe\":[%lu,%u,%lu,%lu,%lu]}",
+             (unsigned long)probe->bps, (unsigned)probe->overhead_ms, (unsigned long)probe->probes,
+             (unsigned long)probe->skipped, (unsigned long)probe->failed);
+#endif
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Publish throughput counters: publishes, uplink bytes vs. modem AT bytes, delivery latency
+ * @return true if the publish was started
+ */
+static bool publish_perf_stats(App_Handle_t *app)
+{
+    const MQTT_PubStats_t *pub = A7600_MQTT_GetPublishStats(&app->mqtt);
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    uint32_t frames, mav_bytes, mav_rejected, at_tx, at_rx;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    MavlinkBridge_GetStats(&frames, &mav_bytes, &mav_rejected);
+    UART_DMA_GetTraffic(app->uart, &at_tx, &at_rx);
+    
+    /* pub: [delivered, failed, bytes, avg ms, max ms], dg: [sent, errors],
+     * mav: [frames, bytes, rejected], loss: [seq, timeout, rate, dedup, publish], at: [tx, rx],
+     * shp: [uplink capacity B/s, frames thinned over it], bp: [congestion level, rises, thinned, shed, dropped,
+     * over a source's share] */
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"up\":%lu,\"pub\":[%lu,%lu,%lu,%lu,%lu],\"dg\":[%lu,%lu],"
+             "\"mav\":[%lu,%lu,%lu],\"loss\":[%lu,%lu,%lu,%lu,%lu],\"at\":[%lu,%lu],"
+             "\"shp\":[%lu,%lu],\"bp\":[%u,%lu,%lu,%lu,%lu,%lu]}",
+             (unsigned long)(HAL_GetTick() / 1000),
+             (unsigned long)pub->delivered, (unsigned long)pub->failed, (unsigned long)pub->bytes,
+             (unsigned long)(pub->delivered ? pub->latency_ms_total / pub->delivered : 0),
+             (unsigned long)pub->latency_ms_max,
+             (unsigned long)pub->datagrams, (unsigned long)pub->datagram_errors,
+             (unsigned long)frames, (unsigned long)mav_bytes, (unsigned long)mav_rejected,
+             (unsigned long)link->seq_lost, (unsigned long)link->timeouts, (unsigned long)link->rate_dropped,
+             (unsigned long)link->deduped, (unsigned long)link->publish_lost,
+             (unsigned long)at_tx, (unsigned long)at_rx,
+             (unsigned long)MavlinkBridge_GetUplinkRate(), (unsigned long)link->shaper_thinned,
+             (unsigned)MavlinkBridge_GetCongestion(), (unsigned long)link->bp_rises, (unsigned long)link->bp_thinned,
+             (unsigned long)link->bp_shed, (unsigned long)link->bp_dropped, (unsigned long)link->fair_dropped);
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Publish the modem UART bytes by class and what share of them was payload
+ * @return true if the publish was started
+ */
+static bool publish_wire_stats(App_Handle_t *app)
+{
+    const MQTT_WireStats_t *eff = A7600_MQTT_GetWireStats(&app->mqtt);
+    uint32_t wire[AT_WIRE_CLASSES];
+    uint32_t per_mille = eff->wire / 1000U;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* wire: tx: [command, data], rx: [response, prompt, URC, data] bytes since boot,
+     * eff: payload per mille of the wire bytes of publishes [last one, since boot] */
+    AT_Engine_GetWire(&app->mqtt.at, wire);
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"up\":%lu,\"wire\":{\"tx\":[%lu,%lu],\"rx\":[%lu,%lu,%lu,%lu]},\"eff\":[%u,%lu]}",
+             (unsigned long)(HAL_GetTick() / 1000),
+             (unsigned long)wire[AT_WIRE_CMD], (unsigned long)wire[AT_WIRE_TX_DATA],
+             (unsigned long)wire[AT_WIRE_RESPONSE], (unsigned long)wire[AT_WIRE_PROMPT],
+             (unsigned long)wire[AT_WIRE_URC], (unsigned long)wire[AT_WIRE_RX_DATA],
+             (unsigned)eff->last_pm, (unsigned long)(per_mille ? eff->payload / per_mille : 0));
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Publish the next page of the metrics registry
+ * @note  A page is what fits the status buffer; the pages follow round after
+ *        round, each metric's name in it
+ * @return true if the publish was started
+ */
+static bool publish_registry(App_Handle_t *app)
+{
+    static uint8_t next;
+    uint8_t from = next;
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* m: "name":value of metrics from registry id pg on (metrics.h) */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"up\":%lu,\"pg\":%u,\"m\":{",
+                         (unsigned long)(HAL_GetTick() / 1000), (unsigned)from);
+    n += Metrics_Text(&status_buf[n], sizeof(status_buf) - n - 3, &next);
+    memcpy(&status_buf[n], "}}", 3);
+    
+    if (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic, (const uint8_t *)status_buf, n + 2,
+                                    MQTT_QOS_0, NULL, NULL) != MQTT_OK) {
+        next = from;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Publish the uplink latency histogram (USART1 arrival to broker acceptance)
+ * @return true if the publish was started
+ */
+static bool publish_latency_stats(App_Handle_t *app)
+{
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    const MQTT_SleepStats_t *sleep = A7600_MQTT_GetSleepStats(&app->mqtt);
+#if MQTT_CMUX
+    const Cmux_Stats_t *mux = Cmux_GetStats(A7600_MQTT_GetMux(&app->mqtt));
+#endif
+    bool compress;
+    const char *encoding = MavlinkBridge_GetEncodingName(&compress);
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* enc: MAVLink payload encoding, lat_ms: publishes per bucket, bucket i < 2^(i+1) ms,
+     * the last one open-ended, outage: [kept, dropped, pages overwritten],
+     * sleep: [sleeps, asleep s, wakes, prewakes, avg wake ms, max wake ms],
+     * mux (MQTT_CMUX): [opens, frames, bad frames, bytes outside frames] */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"up\":%lu,\"enc\":\"%s%s%s\",\"lat_ms\":[",
+                         (unsigned long)(HAL_GetTick() / 1000), encoding, MavlinkBridge_GetHeaderPack() ? "+hc" : "",
+                         compress ? "+lz" : "");
+    for (uint8_t i = 0; i < BRIDGE_LAT_BUCKETS && n < sizeof(status_buf); i++) {
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s%lu",
+                              i ? "," : "", (unsigned long)link->latency[i]);
+    }
+    if (n < sizeof(status_buf)) {
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n,
+                              "],\"outage\":[%lu,%lu,%lu],\"sleep\":[%lu,%lu,%lu,%lu,%lu,%lu]",
+                              (unsigned long)link->outage_kept, (unsigned long)link->outage_dropped,
+                              (unsigned long)OutageLog_GetOverwrites(), (unsigned long)sleep->sleeps,
+                              (unsigned long)(sleep->asleep_ms / 1000), (unsigned long)sleep->wakes,
+                              (unsigned long)sleep->prewakes,
+                              (unsigned long)(sleep->wakes ? sleep->wake_ms_total / sleep->wakes : 0),
+                              (unsigned long)sleep->wake_ms_max);
+    }
+#if MQTT_CMUX
+    if (n < sizeof(status_buf)) {
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, ",\"mux\":[%lu,%lu,%lu,%lu]",
+                              (unsigned long)mux->opens, (unsigned long)mux->frames,
+                              (unsigned long)mux->bad, (unsigned long)mux->plain);
+    }
+#endif
+    if (n < sizeof(status_buf)) {
+        snprintf(&status_buf[n], sizeof(status_buf) - n, "}");
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Publish where the last connect spent its time (once per connect)
+ * @return true if the publish was started
+ */
+static bool publish_connect_stats(App_Handle_t *app)
+{
+    const MQTT_ConnectStats_t *st = A7600_MQTT_GetConnectStats(&app->mqtt);
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* {"connect_ms":T,"tier":N,"warm":W,"ka":S,"ep":E,"failovers":F,"acq":A,"ms":[..10..],"retry":[..10..]} */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf),
+                         "{\"connect_ms\":%lu,\"tier\":%u,\"warm\":%u,\"ka\":%u,\"ep\":%u,\"failovers\":%u,"
+                         "\"acq\":%u,\"ms\":[",
+                         (unsigned long)st->total_ms, (unsigned)st->tier, (unsigned)st->resumed,
+                         (unsigned)A7600_MQTT_GetKeepalive(&app->mqtt), (unsigned)st->endpoint,
+                         (unsigned)st->failovers, (unsigned)st->acq);
+    for (uint8_t i = 0; i < MQTT_CONNECT_STEPS && n < sizeof(status_buf); i++) {
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s%lu",
+                              i ? "," : "", (unsigned long)st->step_ms[i]);
+    }
+    for (uint8_t i = 0; i < MQTT_CONNECT_STEPS && n < sizeof(status_buf); i++) {
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s%u",
+                              i ? "," : "],\"retry\":[", (unsigned)st->retries[i]);
+    }
+    if (n < sizeof(status_buf)) {
+        snprintf(&status_buf[n], sizeof(status_buf) - n, "]}");
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_1, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Append a string
+ * @return New length; size if it did not fit (terminated at size - 1)
+ */
+static size_t put_str(char *buf, size_t n, size_t size, const char *s)
+{
+    while (n < size && *s != '\0') {
+        buf[n++] = *s++;
+    }
+    if (n >= size) {
+        buf[size - 1] = '\0';
+        return size;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+/**
+ * @brief Append "key":value, with a comma unless it is the first field
+ * @return New length; size if it did not fit
+ */
+static size_t put_u32(char *buf, size_t n, size_t size, const char *key, uint32_t value)
+{
+    char digits[11];
+    uint8_t len = 0;
+    
+    if (n > 0 && buf[n - 1] != '{') {
+        n = put_str(buf, n, size, ",");
+    }
+    n = put_str(buf, n, size, "\"");
+    n = put_str(buf, n, size, key);
+    n = put_str(buf, n, size, "\":");
+    
+    do {
+        digits[len++] = (char)('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0);
+    while (len > 0 && n < size - 1) {
+        buf[n++] = digits[--len];
+    }
+    if (len > 0) {
+        return size;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+/**
+ * @brief Take the metrics snapshot into app->metrics (rates over the time since the last one)
+ */
+static void take_metrics(App_Handle_t *app)
+{
+    extern UART_DMA_Handle_t telem_uart;
+    const MQTT_PubStats_t *pub = A7600_MQTT_GetPublishStats(&app->mqtt);
+    const MQTT_WireStats_t *wire = A7600_MQTT_GetWireStats(&app->mqtt);
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    App_Metrics_t *m = &app->metrics;
+    uint32_t now = HAL_GetTick();
+    
+    m->uptime_s = now / 1000U;
+    UART_DMA_GetTraffic(&telem_uart, &m->fc_tx, &m->fc_rx);
+    UART_DMA_GetTraffic(app->uart, &m->modem_tx, &m->modem_rx);
+    m->fc_rx += app->traffic_base[0];
+    m->fc_tx += app->traffic_base[1];
+    m->modem_tx += app->traffic_base[2];
+    m->modem_rx += app->traffic_base[3];
+    m->pub_rate = (now != app->metrics_tick) ?
+                  (pub->delivered - app->metrics_delivered) * 1000U / (now - app->metrics_tick) : 0;
+    m->drops = link->publish_lost + link->outage_dropped;
+    m->reconnects = (app->connects > 0) ? app->connects - 1U : 0;
+    m->loop_max_us = Sched_CyclesToUs(&app->sched, app->sched.pass_max_cycles);
+    m->ram_static = RamUsage_Static();
+    m->stack_used = RamUsage_StackUsed();
+    m->csq = A7600_MQTT_GetLinkQuality(&app->mqtt)->csq;
+    MavlinkBridge_GetBatching(&m->batch_bytes, &m->batch_ms);
+    m->batch_cuts = link->batch_cut;
+    m->resets = app->resets;
+    m->cpu_pm = Sched_TakeLoad(&app->sched);
+    m->at_eff_pm = (wire->wire != app->metrics_wire) ?
+                   (uint16_t)((wire->payload - app->metrics_bytes) * 1000U / (wire->wire - app->metrics_wire)) : 0;
+    app->metrics_tick = now;
+    app->metrics_delivered = pub->delivered;
+    app->metrics_bytes = wire->payload;
+    app->metrics_wire = wire->wire;
+}
+
+/**
+ * @brief Take the metrics snapshot and publish it, formatted without snprintf
+ * @return true if the publish was started
+ */
+static bool publish_metrics(App_Handle_t *app)
+{
+    const App_Metrics_t *m = &app->metrics;
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    take_metrics(app);
+    
+    /* {"v":6,"up":S,"fc_rx":B,"fc_tx":B,"mdm_tx":B,"mdm_rx":B,"pps":N,"drop":N,"recon":N,"loop_us":U,
+     *  "ram":B,"stk":B,"stk_max":B,"csq":Q,"bat_b":B,"bat_ms":MS,"bat_cut":N,"rst":N,"cpu":PM,"at_eff":PM} */
+    n = put_str(status_buf, 0, sizeof(status_buf), "{");
+    n = put_u32(status_buf, n, sizeof(status_buf), "v", APP_METRICS_VERSION);
+    n = put_u32(status_buf, n, sizeof(status_buf), "up", m->uptime_s);
+    n = put_u32(status_buf, n, sizeof(status_buf), "fc_rx", m->fc_rx);
+    n = put_u32(status_buf, n, sizeof(status_buf), "fc_tx", m->fc_tx);
+    n = put_u32(status_buf, n, sizeof(status_buf), "mdm_tx", m->modem_tx);
+    n = put_u32(status_buf, n, sizeof(status_buf), "mdm_rx", m->modem_rx);
+    n = put_u32(status_buf, n, sizeof(status_buf), "pps", m->pub_rate);
+    n = put_u32(status_buf, n, sizeof(status_buf), "drop", m->drops);
+    n = put_u32(status_buf, n, sizeof(status_buf), "recon", m->reconnects);
+    n = put_u32(status_buf, n, sizeof(status_buf), "loop_us", m->loop_max_us);
+    n = put_u32(status_buf, n, sizeof(status_buf), "ram", m->ram_static);
+    n = put_u32(status_buf, n, sizeof(status_buf), "stk", m->stack_used);
+    n = put_u32(status_buf, n, sizeof(status_buf), "stk_max", RAM_STACK_SIZE);
+    n = put_u32(status_buf, n, sizeof(status_buf), "csq", m->csq);
+    n = put_u32(status_buf, n, sizeof(status_buf), "bat_b", m->batch_bytes);
+    n = put_u32(status_buf, n, sizeof(status_buf), "bat_ms", m->batch_ms);
+    n = put_u32(status_buf, n, sizeof(status_buf), "bat_cut", m->batch_cuts);
+    n = put_u32(status_buf, n, sizeof(status_buf), "rst", m->resets);
+    n = put_u32(status_buf, n, sizeof(status_buf), "cpu", m->cpu_pm);
+    n = put_u32(status_buf, n, sizeof(status_buf), "at_eff", m->at_eff_pm);
+    n = put_str(status_buf, n, sizeof(status_buf), "}");
+    if (n >= sizeof(status_buf)) {
+        return false;
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, n,
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Append a little-endian value of width bytes
+ * @return Offset past it
+ */
+static size_t rec_put(uint8_t *buf, size_t n, uint32_t value, uint8_t width)
+{
+    for (uint8_t b = 0; b < width; b++) {
+        buf[n++] = (uint8_t)(value >> (8U * b));
+    }
+    return n;
+}
+
+/**
+ * @brief Take the metrics snapshot as the record an autopilot batch carries (MavlinkBridge_StatusFn_t)
+ * @note  The fields of the metrics publish, in its order (Core/Doc/status_trailer.md)
+ */
+static size_t status_record(uint8_t *buf, size_t size, void *ctx)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    const App_Metrics_t *m = &app->metrics;
+    size_t n = 0;
+    
+    if (size < APP_STATUS_RECORD) {
+        return 0;
+    }
+    take_metrics(app);
+    n = rec_put(buf, n, APP_METRICS_VERSION, 1);
+    n = rec_put(buf, n, m->uptime_s, 4);
+    n = rec_put(buf, n, m->fc_rx, 4);
+    n = rec_put(buf, n, m->fc_tx, 4);
+    n = rec_put(buf, n, m->modem_tx, 4);
+    n = rec_put(buf, n, m->modem_rx, 4);
+    n = rec_put(buf, n, m->pub_rate, 4);
+    n = rec_put(buf, n, m->drops, 4);
+    n = rec_put(buf, n, m->reconnects, 4);
+    n = rec_put(buf, n, m->loop_max_us, 4);
+    n = rec_put(buf, n, m->ram_static, 4);
+    n = rec_put(buf, n, m->stack_used, 4);
+    n = rec_put(buf, n, RAM_STACK_SIZE, 2);
+    n = rec_put(buf, n, m->csq, 1);
+    n = rec_put(buf, n, m->batch_bytes, 2);
+    n = rec_put(buf, n, m->batch_ms, 2);
+    n = rec_put(buf, n, m->batch_cuts, 4);
+    n = rec_put(buf, n, m->resets, 4);
+    n = rec_put(buf, n, m->cpu_pm, 2);
+    n = rec_put(buf, n, m->at_eff_pm, 2);
+    return n;
+}
+
+/**
+ * @brief Check whether the detailed report follows the snapshot just taken
+ * @note  While the snapshot rides in autopilot batches and publishes are
+ *        delivered, the telemetry itself shows the link is alive: the report
+ *        (a publish of its own) goes every APP_STATUS_QUIET intervals only,
+ *        or at once when a loss, reconnect, batch cut or cell change shows
+ *        up - all counters, so their sum moves when any of them does
+ * @param carried The snapshot went up in a batch
+ */
+static bool app_detail_due(App_Handle_t *app, bool carried)
+{
+    const App_Metrics_t *m = &app->metrics;
+    uint32_t sig = m->drops + m->reconnects + m->batch_cuts + A7600_MQTT_GetLinkQuality(&app->mqtt)->cell_changes;
+    
+    if (carried && m->pub_rate > 0 && sig == app->detail_sig && ++app->detail_skip < APP_STATUS_QUIET) {
+        app->details_quiet++;
+        return false;
+    }
+    app->detail_sig = sig;
+    app->detail_skip = 0;
+    return true;
+}
+
+/**
+ * @brief Publish the reply to the last command with the settings it may have changed
+ * @return true if the publish was started
+ */
+static bool publish_reply(App_Handle_t *app)
+{
+    bool compress;
+    const char *encoding = MavlinkBridge_GetEncodingName(&compress);
+    uint16_t batch_bytes, batch_ms;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    MavlinkBridge_GetBatching(&batch_bytes, &batch_ms);
+    
+    /* {"cmd":"batch","ok":1,"enc":"base64+hc+lz","ka":[used, next connect, adaptive],"batch":[B,ms]} */
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"cmd\":\"%s\",\"ok\":%u,\"enc\":\"%s%s%s\",\"ka\":[%u,%u,%u],\"batch\":[%u,%u]}",
+             reply.cmd, (unsigned)reply.ok, encoding, MavlinkBridge_GetHeaderPack() ? "+hc" : "", compress ? "+lz" : "",
+             (unsigned)A7600_MQTT_GetKeepalive(&app->mqtt), (unsigned)app->mqtt.ka_next,
+             (unsigned)app->mqtt.config.adaptive_keepalive, (unsigned)batch_bytes, (unsigned)batch_ms);
+    
+    return (A7600_MQTT_PublishClientAsync(&app->mqtt, APP_CLIENT_CONTROL, APP_TOPIC_RESPONSE,
+                                          (const uint8_t *)status_buf, strlen(status_buf),
+                                          MQTT_QOS_1, NULL, NULL) == MQTT_OK);
+}
+
+#if PROFILE_ENABLE
+/**
+ * @brief Announce the last telemetry profile switch on the status topic
+ * @return true if the publish was started
+ */
+static bool publish_profile(App_Handle_t *app)
+{
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    n = LinkProfile_Report(status_buf, sizeof(status_buf));
+    
+    return (n > 0 && A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic, (const uint8_t *)status_buf, n,
+                                                 MQTT_QOS_1, NULL, NULL) == MQTT_OK);
+}
+#endif
+
+/**
+ * @brief Publish why the MCU last reset and, after a watchdog reset, the task that starved it
+ * @return true if the publish was started
+ */
+static bool publish_reset(App_Handle_t *app)
+{
+    const Supervisor_Boot_t *boot = Supervisor_GetBoot();
+    const Sched_t *sched = &app->sched;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* {"reset":"iwdg","task":"link","stuck":1,"run_ms":T,"up_s":S} */
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"reset\":\"%s\",\"task\":\"%s\",\"stuck\":%u,\"run_ms\":%lu,\"up_s\":%lu}",
+             Supervisor_ResetName(boot->cause), boot->task < sched->count ? sched->tasks[boot->task].name : "",
+             (unsigned)boot->stuck, (unsigned long)boot->run_ms, (unsigned long)boot->up_s);
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_1, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Publish when this boot reached each milestone and, if the last one reset
+ *        before its first frame, how far that one got
+ * @return true if the publish was started
+ */
+static bool publish_boot_profile(App_Handle_t *app)
+{
+    const uint32_t *ms = BootProfile_Get();
+    BootProfile_Mark_t prev_mark;
+    uint32_t prev_ms;
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* boot_ms: ms since reset at [HAL_Init, PWRKEY, RDY, end of connect step 1..10, SUBACK,
+     * first frame], null if not reached (steps a connect tier skipped); prev: [milestone, ms] */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"boot_ms\":[");
+    for (uint8_t i = 0; i < BOOT_MARKS && n < sizeof(status_buf); i++) {
+        if (ms[i] == BOOT_PROFILE_UNSET) {
+            n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%snull", i ? "," : "");
+        } else {
+            n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s%lu",
+                                  i ? "," : "", (unsigned long)ms[i]);
+        }
+    }
+    if (n < sizeof(status_buf)) {
+        if (BootProfile_GetPrevious(&prev_mark, &prev_ms)) {
+            snprintf(&status_buf[n], sizeof(status_buf) - n, "],\"prev\":[%u,%lu]}",
+                     (unsigned)prev_mark, (unsigned long)prev_ms);
+        } else {
+            snprintf(&status_buf[n], sizeof(status_buf) - n, "]}");
+        }
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_1, NULL, NULL) == MQTT_OK);
+}
+
+#if PROFILER_ENABLE
+/**
+ * @brief Publish the hot-path sites since the last report, then start a new interval
+ * @return true if the publish was started
+ */
+static bool publish_prof_stats(App_Handle_t *app)
+{
+    const Prof_Stats_t *prof = Profiler_Get();
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* prof: site: [calls, min, max, avg] in core cycles */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"up\":%lu,\"prof\":{",
+                         (unsigned long)(HAL_GetTick() / 1000));
+    for (uint8_t i = 0; i < PROF_SITES && n < sizeof(status_buf); i++) {
+        const Prof_Stats_t *st = &prof[i];
+        
+        /* Full figures on the debug channel too (RTT costs the uplink nothing) */
+        LOG_INFO("Prof %s: %lu calls, min %lu max %lu sum %lu", Profiler_SiteName((Prof_Site_t)i),
+                 (unsigned long)st->count, (unsigned long)(st->count ? st->min : 0),
+                 (unsigned long)st->max, (unsigned long)st->sum);
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s\"%s\":[%lu,%lu,%lu,%lu]",
+                              i ? "," : "", Profiler_SiteName((Prof_Site_t)i), (unsigned long)st->count,
+                              (unsigned long)(st->count ? st->min : 0), (unsigned long)st->max,
+                              (unsigned long)(st->count ? st->sum / st->count : 0));
+    }
+    if (n < sizeof(status_buf)) {
+        snprintf(&status_buf[n], sizeof(status_buf) - n, "}}");
+    }
+    Profiler_Reset();
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/**
+ * @brief Run the codec micro-benchmark and publish cycles and size per encoding
+ * @return true if the publish was started (false: modem or bridge busy, try on a later pass)
+ */
+static bool publish_codec_bench(App_Handle_t *app)
+{
+    MavlinkBridge_CodecCost_t cost[BRIDGE_CODEC_MAX];
+    uint8_t count;
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    count = MavlinkBridge_CodecBench(cost, BRIDGE_CODEC_MAX);
+    if (count == 0) {
+        return false;
+    }
+    
+    /* codecs: name: [frame bytes, text bytes, encode cycles, decode cycles, round trip ok] */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"up\":%lu,\"codecs\":{",
+                         (unsigned long)(HAL_GetTick() / 1000));
+    for (uint8_t i = 0; i < count && n < sizeof(status_buf); i++) {
+        const MavlinkBridge_CodecCost_t *c = &cost[i];
+        
+        /* Per byte in tenths of a cycle, expansion in percent of the frame bytes */
+        LOG_INFO("Codec %s%s: enc %lu.%lu dec %lu.%lu cyc/B, %u%% size%s", c->name, c->compress ? "+lz" : "",
+                 (unsigned long)(c->enc_cycles * 10 / c->bytes / 10), (unsigned long)(c->enc_cycles * 10 / c->bytes % 10),
+                 (unsigned long)(c->dec_cycles * 10 / c->bytes / 10), (unsigned long)(c->dec_cycles * 10 / c->bytes % 10),
+                 (unsigned)((uint32_t)c->text * 100 / c->bytes), (c->ok || c->compress) ? "" : " MISMATCH");
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s\"%s%s\":[%u,%u,%lu,%lu,%u]",
+                              i ? "," : "", c->name, c->compress ? "+lz" : "", (unsigned)c->bytes,
+                              (unsigned)c->text, (unsigned long)c->enc_cycles, (unsigned long)c->dec_cycles,
+                              (unsigned)c->ok);
+    }
+    if (n < sizeof(status_buf)) {
+        snprintf(&status_buf[n], sizeof(status_buf) - n, "}}");
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+#endif
 
-/* Private function prototypes */
-static void mqtt_message_callback(const char *topic, const uint8_t *payload, size_t len);
+#if OTA_ENABLE
+/**
+ * @brief Publish the OTA ack: where the sender resumes and how far it may run ahead
+ * @return true if the publish was started
+ */
+static bool publish_ota(App_Handle_t *app)
+{
+    static const char *const names[] = { "idle", "rx", "ok", "err" };
+    const Ota_Progress_t *p;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    p = Ota_TakeAck(HAL_GetTick());
+    
+    /* {"ota":"rx","size":S,"next":N,"win":W,"drop":D} */
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"ota\":\"%s\",\"size\":%lu,\"next\":%lu,\"win\":%lu,\"drop\":%lu}",
+             names[p->state], (unsigned long)p->size, (unsigned long)p->next,
+             (unsigned long)p->win, (unsigned long)p->dropped);
+    
+    return (A7600_MQTT_PublishClientAsync(&app->mqtt, APP_CLIENT_CONTROL, APP_TOPIC_RESPONSE,
+                                          (const uint8_t *)status_buf, strlen(status_buf),
+                                          MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+#endif
 
-/* ==================== Private Functions ==================== */
+#if BENCH_BRIDGE
+/**
+ * @brief Publish the generator run: offered vs. forwarded load, losses by stage, latency
+ * @return true if the publish was started
+ */
+static bool publish_bench_stats(App_Handle_t *app)
+{
+    BenchGen_Report_t r;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* gen: [frames, bytes, skipped], fwd: [frames, bytes], lost: [rx overrun bytes,
+     * rejected, seq, rate limited, deduped, publish failed], lat_ms: p50/p90/p99 upper bounds,
+     * cpu: core busy per mille over the last metrics interval */
+    BenchGen_GetReport(&r);
+    snprintf(status_buf, sizeof(status_buf),
+             "{\"up\":%lu,\"bench\":{\"ms\":%lu,\"rate\":%u,\"gen\":[%lu,%lu,%lu],\"fwd\":[%lu,%lu],"
+             "\"lost\":[%lu,%lu,%lu,%lu,%lu,%lu],\"lat_ms\":[%lu,%lu,%lu],\"cpu\":%u}}",
+             (unsigned long)(HAL_GetTick() / 1000), (unsigned long)r.ms, (unsigned)r.rate,
+             (unsigned long)r.gen_frames, (unsigned long)r.gen_bytes, (unsigned long)r.gen_skipped,
+             (unsigned long)r.fwd_frames, (unsigned long)r.fwd_bytes,
+             (unsigned long)r.rx_overrun, (unsigned long)r.rejected, (unsigned long)r.seq_lost,
+             (unsigned long)r.rate_dropped, (unsigned long)r.deduped, (unsigned long)r.publish_lost,
+             (unsigned long)r.lat_ms[0], (unsigned long)r.lat_ms[1], (unsigned long)r.lat_ms[2],
+             (unsigned)app->sched.load_pm);
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+#endif
+
+#if UART_DMA_LL
+/**
+ * @brief Publish both links' interrupt timing and the tick's entry latency (worst since boot)
+ * @return true if the publish was started
+ */
+static bool publish_irq_stats(App_Handle_t *app)
+{
+    extern UART_DMA_Handle_t telem_uart;
+    UART_DMA_Handle_t *link[2] = { app->uart, &telem_uart };
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* irq: link: [RX DMA entry latency us, half-ring deadlines missed, USART / DMA handler cycles],
+     * tick: SysTick entry latency us (see Core/Doc/irq_latency.md) */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"up\":%lu,\"irq\":{",
+                         (unsigned long)(HAL_GetTick() / 1000));
+    for (uint8_t i = 0; i < 2 && n < sizeof(status_buf); i++) {
+        UART_DMA_IrqStats_t irq;
+        uint32_t kbaud = UART_DMA_GetBaudRate(link[i]) / 1000;
+        
+        UART_DMA_GetIrqStats(link[i], &irq);
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "\"%s\":[%lu,%lu,%lu,%lu],",
+                              i ? "fc" : "modem",
+                              (unsigned long)(kbaud ? irq.rx_late * 10000U / kbaud : 0),     /* 8N1: 10 bits */
+                              (unsigned long)irq.rx_missed, (unsigned long)irq.usart_cycles,
+                              (unsigned long)irq.dma_cycles);
+    }
+    if (n < sizeof(status_buf)) {
+        snprintf(&status_buf[n], sizeof(status_buf) - n, "\"tick\":%lu}}",
+                 (unsigned long)Sched_CyclesToUs(&app->sched, Sched_TickLate()));
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+#endif
+
+/**
+ * @brief Publish the scheduler's per-task runtime and the longest pass
+ * @return true if the publish was started
+ */
+static bool publish_sched_stats(App_Handle_t *app)
+{
+    const Sched_t *sched = &app->sched;
+    size_t n;
+    
+    if (A7600_MQTT_IsBusy(&app->mqtt)) {
+        return false;
+    }
+    
+    /* pass: longest scheduler pass in us (threaded build: wake, per thread [longest UART event
+     * to slice start us, stack never used B]), task: [max us, avg us, overruns, share of the core
+     * per mille over the last metrics interval] each */
+#if APP_RTOS
+    n = (size_t)snprintf(status_buf, sizeof(status_buf), "{\"up\":%lu", (unsigned long)(HAL_GetTick() / 1000));
+    for (uint8_t i = 0; i < APP_THREADS && n < sizeof(status_buf); i++) {
+        uint32_t stack_free, wake_us;
+        
+        App_RtosGetThreadStats(i, &stack_free, &wake_us);
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s%lu,%lu]",
+                              i ? ",[" : ",\"wake\":[[", (unsigned long)wake_us, (unsigned long)stack_free);
+    }
+    if (n < sizeof(status_buf)) {
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "],\"task\":{");
+    }
+#else
+    const LowPower_Stats_t *lp = LowPower_GetStats();
+    
+    /* sleep: [s asleep, sleeps, tickless] - the share of time asleep stands in for current draw;
+     * empty: cheapest pass that ran no task, us (the load meter's baseline) */
+    n = (size_t)snprintf(status_buf, sizeof(status_buf),
+                         "{\"up\":%lu,\"pass\":%lu,\"empty\":%lu,\"sleep\":[%lu,%lu,%lu],\"task\":{",
+                         (unsigned long)(HAL_GetTick() / 1000),
+                         (unsigned long)Sched_CyclesToUs(sched, sched->pass_max_cycles),
+                         (unsigned long)Sched_CyclesToUs(sched, sched->empty_cycles),
+                         (unsigned long)(lp->slept_ms / 1000), (unsigned long)lp->sleeps,
+                         (unsigned long)lp->tickless);
+#endif
+    for (uint8_t i = 0; i < sched->count && n < sizeof(status_buf); i++) {
+        const Sched_Stats_t *st = &sched->stats[i];
+        
+        n += (size_t)snprintf(&status_buf[n], sizeof(status_buf) - n, "%s\"%s\":[%lu,%lu,%lu,%u]",
+                              i ? "," : "", sched->tasks[i].name,
+                              (unsigned long)Sched_CyclesToUs(sched, st->max_cycles),
+                              (unsigned long)Sched_CyclesToUs(sched, st->avg_cycles),
+                              (unsigned long)st->overruns, (unsigned)st->load_pm);
+    }
+    if (n < sizeof(status_buf)) {
+        snprintf(&status_buf[n], sizeof(status_buf) - n, "}}");
+    }
+    
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status_buf, strlen(status_buf),
+                                        MQTT_QOS_0, NULL, NULL) == MQTT_OK);
+}
+
+/* ==================== Tasks ==================== */
+
+/**
+ * @brief Modem RX and AT engine: reads modem data, advances queued commands and the running operation
+ */
+static bool task_modem(void *ctx)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    
+    ModemPower_Process();                   /* Power key pulse at a cold boot */
+    if (app->state != APP_STATE_INIT && app->state != APP_STATE_ERROR) {
+        A7600_MQTT_Process(&app->mqtt);
+    }
+    return false;
+}
+
+/**
+ * @brief FC stream to the broker (offline: into the outage log)
+ */
+static bool task_uplink(void *ctx)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    
+    if (app->state != APP_STATE_INIT) {
+#if BENCH_BRIDGE
+        BenchGen_Process();
+#endif
+#if PROBE_ENABLE
+        /* Uplink probe after a connect - first to an idle driver */
+        UplinkProbe_Process();
+#endif
+#if ECHO_ENABLE
+        EchoProbe_Process();
+#endif
+#if FIELDS_ENABLE
+        TelemFields_Process();
+#endif
+        MavlinkBridge_Process();
+    }
+    return false;
+}
+
+/**
+ * @brief Queued downlink frames and RADIO_STATUS to the FC
+ */
+static bool task_downlink(void *ctx)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    
+    /* Frames queued: pumped again as soon as the UART is free */
+    return (app->state != APP_STATE_INIT) && MavlinkBridge_Downlink();
+}
+
+/**
+ * @brief Connection supervision: module boot, connect, reconnect
+ */
+static bool task_link(void *ctx)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    uint32_t current_tick = HAL_GetTick();
+    
+    if (ka_requested != 0) {
+        uint16_t ka = ka_requested;
+        
+        ka_requested = 0;
+        if (ka == APP_KA_ADAPTIVE) {
+            A7600_MQTT_SetKeepalive(&app->mqtt, app->mqtt.config.keepalive, true);
+        } else {
+            A7600_MQTT_SetKeepalive(&app->mqtt, ka, false);
+        }
+    }
+    A7600_MQTT_SetSleep(&app->mqtt, sleep_enabled && MavlinkBridge_Grounded());
+#if PROFILE_ENABLE
+    LinkProfile_Process();
+#endif
+    
+    switch (app->state) {
+        case APP_STATE_INIT:
+            LOG_INFO("App State: INIT");
+            /* Wait for initialization */
+            break;
+            
+        case APP_STATE_WAIT_MODULE:
+            if (app->warm_boot) {
+                /* MCU reset alone: no boot URCs will come, and the module's sessions may still be live */
+                app->warm_boot = false;
+                if (A7600_MQTT_ResumeAsync(&app->mqtt, app_connect_done, app) == MQTT_OK) {
+                    LOG_INFO("App State: WAIT_MODULE -> Resume");
+                    app->state = APP_STATE_CONNECTING;
+                }
+            } else if (A7600_MQTT_ModuleReady(&app->mqtt)) {
+                /* Boot URCs tell us the moment the module is ready */
+                LOG_INFO("App State: WAIT_MODULE -> Try Connect");
+                app->last_reconnect_tick = current_tick;
+                App_Connect(app);
+            } else if (ModemPower_Released() &&
+                       current_tick - app->last_reconnect_tick >= APP_MODULE_PROBE_INTERVAL) {
+                /* Module may have booted before us (MCU reset) - its URCs are gone */
+                app->last_reconnect_tick = current_tick;
+                A7600_MQTT_ProbeModule(&app->mqtt);
+            }
+            break;
+            
+        case APP_STATE_CONNECTING:
+            /* Connect sequence runs in the modem task; app_connect_done() moves on */
+            break;
+            
+        case APP_STATE_CONNECTED:
+            /* Stable again: the next failure starts from the fast first retry */
+            if (app->backoff_ms != 0 && current_tick - app->connected_tick >= APP_BACKOFF_STABLE) {
+                app->backoff_ms = 0;
+            }
+            
+            /* Check connection */
+            if (!A7600_MQTT_IsConnected(&app->mqtt)) {
+                /* Mostly broker / TCP drops - the modem and PDP are usually still up */
+                MQTT_Result_t result = A7600_MQTT_ReconnectAsync(&app->mqtt, app_connect_done, app);
+                
+                if (result == MQTT_OK) {
+                    LOG_ERROR("Disconnected! Fast reconnect");
+                    app->state = APP_STATE_CONNECTING;
+                } else if (result != MQTT_BUSY) {
+                    LOG_ERROR("Disconnected! Switching to ERROR state");
+                    app->state = APP_STATE_ERROR;
+                    app_backoff(app, 0);
+                }
+                /* Busy: a publish is still unwinding - retry next run */
+            }
+            break;
+            
+        case APP_STATE_ERROR:
+            /* Settle time after the disconnect - the FC stream keeps going meanwhile */
+            if (app->settling) {
+                if (current_tick - app->last_reconnect_tick >= APP_SETTLE_TIME) {
+                    app->settling = false;
+                    app->state = APP_STATE_WAIT_MODULE;
+                }
+                break;
+            }
+            
+            /* Try to reconnect once the backoff is up */
+            if (current_tick - app->last_reconnect_tick >= app->retry_delay) {
+                LOG_INFO("App State: ERROR -> Retrying...");
+                
+                /* Broker side: the driver's tiered reconnect, no teardown (escalates by itself) */
+                if (app->backoff_tier == BACKOFF_BROKER &&
+                    A7600_MQTT_ReconnectAsync(&app->mqtt, app_connect_done, app) == MQTT_OK) {
+                    app->state = APP_STATE_CONNECTING;
+                    break;
+                }
+                
+                /* Disconnect and reconnect */
+                A7600_MQTT_Disconnect(&app->mqtt);
+                app->last_reconnect_tick = HAL_GetTick();
+                app->settling = true;
+            }
+            break;
+            
+        default:
+            app->state = APP_STATE_INIT;
+            break;
+    }
+    return false;
+}
 
-static void mqtt_message_callback(const char *topic, const uint8_t *payload, size_t len)
+/**
+ * @brief Status publishes: connect timing, AT transcript, periodic health
+ */
+static bool task_status(void *ctx)
 {
-    /* Handle incoming MQTT messages */
-    /* User can implement command handling here */
+    App_Handle_t *app = (App_Handle_t *)ctx;
+    uint32_t current_tick = HAL_GetTick();
+    bool more = false;
+    
+    if (app->state != APP_STATE_CONNECTED || !A7600_MQTT_IsConnected(&app->mqtt)) {
+        return false;
+    }
+    
+    /* Command reply first - an operator is waiting for it */
+    if (reply.pending && publish_reply(app)) {
+        reply.pending = false;
+    }
+    
+#if OTA_ENABLE
+    /* Firmware update: program what came in, keep the sender's credit flowing */
+    more = Ota_Process();
+    if (!reply.pending && Ota_AckDue(current_tick)) {
+        publish_ota(app);
+    }
+    if (Ota_ApplyPending() && !reply.pending && !A7600_MQTT_IsBusy(&app->mqtt)) {
+        Ota_Install();
+    }
+#endif
+    
+    /* Connect timing, once the subscribe / "online" publish are through */
+    if (app->stats_pending && publish_connect_stats(app)) {
+        app->stats_pending = false;
+    }
+    
+#if PROFILE_ENABLE
+    /* Telemetry profile switch */
+    if (!reply.pending && publish_profile(app)) {
+        LinkProfile_Reported();
+    }
+#endif
+    
+    /* Reset cause, once per boot */
+    if (app->reset_pending && !app->stats_pending && publish_reset(app)) {
+        app->reset_pending = false;
+    }
+    
+    /* Boot profile, once per boot - complete with the first frame delivered */
+    if (app->boot_pending && !app->reset_pending && BootProfile_Get()[BOOT_MARK_FRAME] != BOOT_PROFILE_UNSET &&
+        publish_boot_profile(app)) {
+        app->boot_pending = false;
+    }
+    
+    /* AT transcript: after a failed connect, or when asked for */
+    if (diag_requested) {
+        diag_requested = false;
+        app->diag_pending = true;
+    }
+    if (app->diag_pending && !app->stats_pending && !app->reset_pending && publish_diag(app)) {
+        app->diag_pending = false;
+    }
     
-    /* Example: Parse command and respond */
-    /* if (strstr(topic, "command") != NULL) { ... } */
+#if PROFILER_ENABLE
+    /* Codec micro-benchmark, when asked for */
+    if (codecs_requested && !app->diag_pending && publish_codec_bench(app)) {
+        codecs_requested = false;
+    }
+#endif
+    
+#if METRICS_RTT
+    Metrics_Capture(current_tick);
+#endif
+    
+    /* Periodic status publish: the metrics snapshot, then one detailed report.
+     * While telemetry goes up the snapshot rides in its batch; published by
+     * itself when the bridge hands it back */
+    if (current_tick - app->last_publish_tick >= APP_PUBLISH_INTERVAL) {
+        MavlinkBridge_StatusCarry_t carry = MavlinkBridge_CarryStatus(status_record, app);
+        
+        if (carry == BRIDGE_STATUS_CARRIED) {
+            app->metrics_carried++;
+        }
+        if (carry == BRIDGE_STATUS_CARRIED || (carry == BRIDGE_STATUS_IDLE && publish_metrics(app))) {
+            app->last_publish_tick = current_tick;
+            if (app_detail_due(app, carry == BRIDGE_STATUS_CARRIED)) {
+                app->detail_pending = true;
+            }
+        }
+    }
+    if (app->detail_pending) {
+        /* Link health: [ORE, FE, NE, PE, RX restarts] per UART, in turn with throughput, latency and tasks */
+        bool sent = (app->status_turn == 0) ? publish_link_stats(app) :
+                    (app->status_turn == 1) ? publish_perf_stats(app) :
+                    (app->status_turn == 2) ? publish_latency_stats(app) :
+#if PROFILER_ENABLE
+                    (app->status_turn == 4) ? publish_prof_stats(app) :
+#endif
+#if BENCH_BRIDGE
+                    (app->status_turn == 4 + PROFILER_ENABLE) ? publish_bench_stats(app) :
+#endif
+#if UART_DMA_LL
+                    (app->status_turn == 4 + PROFILER_ENABLE + BENCH_BRIDGE) ? publish_irq_stats(app) :
+#endif
+                    (app->status_turn == 4 + PROFILER_ENABLE + BENCH_BRIDGE + UART_DMA_LL) ?
+                    publish_wire_stats(app) :
+                    (app->status_turn == 5 + PROFILER_ENABLE + BENCH_BRIDGE + UART_DMA_LL) ?
+                    publish_registry(app) :
+                    publish_sched_stats(app);
+        if (sent) {
+            app->status_turn = (uint8_t)((app->status_turn + 1) % APP_STATUS_TURNS);
+            app->detail_pending = false;
+        }
+    }
+
+#if METRICS_PERF
+    /* Performance record for the fleet dashboards, behind the status reports */
+    if (current_tick - perf_tick >= perf_interval && !app->detail_pending && publish_perf(app)) {
+        perf_tick = current_tick;
+    }
+#endif
+    return more;
+}
+
+/**
+ * @brief Watchdog (through the supervisor) and debug output
+ */
+static bool task_health(void *ctx)
+{
+    App_Handle_t *app = (App_Handle_t *)ctx;
     
-    /* Forward to MAVLink Bridge */
-    MavlinkBridge_OnMessage(topic, payload, len);
+    Supervisor_Service();
+    if (HAL_GetTick() - app->retain_tick >= RETAIN_INTERVAL) {
+        app->retain_tick = HAL_GetTick();
+        app_retain(app);
+    }
+    Debug_Flush();
+    return false;
 }
 
+/* Run in table order: the modem first, so a publish it completes frees the
+ * uplink lane in the same pass. Received data wakes a task through its
+ * events, so periods only bound timeouts and deadlines - and set how often
+ * an idle bridge wakes from its sleep. Budgets in us at 48 MHz; the uplink
+ * overruns by a flash erase (~20-40 ms) when the outage log enters a page.
+ * Deadlines (ms) bound a run including blocking driver waits: the link
+ * task's Disconnect waits up to 5 s per step. The threaded build runs the
+ * APP_SLICE_x slices on their own threads */
+static const Sched_Task_t app_tasks[APP_TASKS] = {
+    /* name        task            ms   events                              budget  deadline */
+    { "modem",     task_modem,     10,  SCHED_EVT_MODEM,                    500,    12000 },
+    { "link",      task_link,     100,  0,                                  200,    40000 },
+    { "status",    task_status,   100,  0,                                  300,     2000 },
+    { "uplink",    task_uplink,    10,  SCHED_EVT_TELEM | SCHED_EVT_MODEM,  500,     1000 },
+    { "downlink",  task_downlink,  10,  SCHED_EVT_MODEM,                    100,     1000 },
+    { "health",    task_health,   100,  0,                                  200,     1000 },
+};
 
 /* ==================== Public Functions ==================== */
 
@@ -45,26 +1881,105 @@ bool App_Init(App_Handle_t *app, UART_DMA_Handle_t *uart)
     app->state = APP_STATE_INIT;
     app->last_publish_tick = 0;
     app->last_reconnect_tick = 0;
+    app->backoff_tier = BACKOFF_BROKER;
+    app->backoff_ms = 0;
+    app->retry_delay = backoff_tiers[BACKOFF_BROKER].first_ms;
+    app->connected_tick = 0;
+    jitter_seed = HAL_GetUIDw0() ^ HAL_GetUIDw1() ^ HAL_GetUIDw2() ^ HAL_GetTick();
+    if (jitter_seed == 0) {
+        jitter_seed = 1;
+    }
     app->error_count = 0;
+    app->stats_pending = false;
+    app->reset_pending = true;
+    app->boot_pending = true;
+    app->warm_boot = Supervisor_WarmBoot();
+    app->detail_pending = false;
+    app->connects = 0;
+    app->metrics_tick = HAL_GetTick();
+    app->metrics_delivered = 0;
+    app->metrics_bytes = 0;
+    app->metrics_wire = 0;
+    memset(&app->metrics, 0, sizeof(app->metrics));
+    app->metrics_carried = 0;
+    app->details_quiet = 0;
+    app->detail_sig = 0;
+    app->detail_skip = 0;
+    app->status_turn = 0;
+    app->diag_pending = false;
+    app->settling = false;
+    diag_requested = false;
+#if PROFILER_ENABLE
+    codecs_requested = false;
+#endif
+    live_config = NULL;
+    ka_requested = 0;
+    sleep_enabled = (APP_MODEM_SLEEP != 0);
+    reply.pending = false;
+    ConfigStore_Init();
+#if TOPIC_NS_ENABLE
+    TopicNs_Init();                     /* Before anything takes a topic */
+    LOG_INFO("Topics: " TOPIC_NS_ROOT "%s/", TopicNs_Id());
+#endif
+#if PROFILER_ENABLE
+    Profiler_Init();
+#endif
+    Sched_Init(&app->sched, app_tasks, app->task_stats, APP_TASKS, app);
+    Supervisor_Init(&app->sched);
 
-    /* Initialize Bridge with Global Telem Handle (defined in main.c) */
+    /* Initialize Bridge with Global Telem Handle (defined and started in main.c) */
     extern UART_DMA_Handle_t telem_uart;
-    extern UART_HandleTypeDef huart1;
-    UART_DMA_Init(&telem_uart, &huart1);
     MavlinkBridge_Init(&telem_uart, &app->mqtt);
+    ConfigStore_ForEach(CONFIG_RATE, CONFIG_RATE | 0x7FFF, app_load_rate, NULL);
+#if PROFILE_ENABLE
+    LinkProfile_Init(&app->mqtt);       /* Takes the bridge's own batch bounds first */
+#endif
+    app_load_batch_bounds();
+#if METRICS_PERF
+    app_load_perf_interval();
+#endif
+#if BENCH_BRIDGE
+    BenchGen_Init(&telem_uart);
+#endif
+#if PROBE_ENABLE
+    /* Probe payload: the CA certificate - in flash already, and public */
+    UplinkProbe_Init(&app->mqtt, (const uint8_t *)isrg_root_x1, sizeof(isrg_root_x1) - 1);
+#endif
+#if ECHO_ENABLE
+    EchoProbe_Init(&app->mqtt);
+#endif
+#if FIELDS_ENABLE
+    TelemFields_Init(&app->mqtt);
+#endif
     
     /* Configure MQTT */
     MQTT_Config_t mqtt_config = {
         .port = APP_MQTT_PORT,
         .use_ssl = true,
-        .keepalive = APP_MQTT_KEEPALIVE
+        .keepalive = APP_MQTT_KEEPALIVE,
+        .adaptive_keepalive = (APP_MQTT_ADAPTIVE_KA != 0),
+        .baudrate = APP_MODEM_BAUD,
+        .hw_flow_control = (MODEM_HW_FLOW_CONTROL != 0),
+        .clients = APP_MQTT_CLIENTS,
+        .persistent_session = (APP_MQTT_PERSISTENT != 0),
+        .transport = APP_MQTT_TRANSPORT,
+        .udp_host = APP_UDP_HOST,
+        .udp_port = APP_UDP_PORT,
+        .connect_by_ip = (APP_MQTT_CONNECT_BY_IP != 0),
+        .will = { APP_TOPIC_STATUS, "offline", MQTT_QOS_1, true },
+        .will_client = APP_CLIENT_CONTROL,
+        .qos0_fire = (APP_MQTT_QOS0_FIRE != 0),
+#if MODEM_SLEEP_DTR
+        .dtr = app_modem_dtr,
+#endif
+#if APP_MQTT_VERIFY_TLS
+        .ca_cert = isrg_root_x1,
+        .ca_cert_len = sizeof(isrg_root_x1) - 1
+#endif
     };
     
-    /* Copy string configurations */
-    strncpy(mqtt_config.broker, APP_MQTT_BROKER, MQTT_BROKER_MAX_LEN - 1);
-    strncpy(mqtt_config.username, APP_MQTT_USERNAME, MQTT_USERNAME_MAX_LEN - 1);
-    strncpy(mqtt_config.password, APP_MQTT_PASSWORD, MQTT_PASSWORD_MAX_LEN - 1);
-    strncpy(mqtt_config.client_id, APP_MQTT_CLIENT_ID, MQTT_CLIENT_ID_MAX_LEN - 1);
+    /* Strings by reference: stored settings in flash, or the literals */
+    app_load_config(&mqtt_config);
     
     /* Initialize MQTT */
     if (A7600_MQTT_Init(&app->mqtt, uart, &mqtt_config) != MQTT_OK) {
@@ -72,13 +1987,26 @@ bool App_Init(App_Handle_t *app, UART_DMA_Handle_t *uart)
         app->state = APP_STATE_ERROR;
         return false;
     }
+    live_config = &app->mqtt.config;
+    
+    /* Inbound topics: exact routes, the callback gets the rest */
+    A7600_MQTT_Route(&app->mqtt, BRIDGE_TOPIC_RX, MavlinkBridge_OnChunk);  /* Streamed - any payload size */
+    A7600_MQTT_Route(&app->mqtt, APP_TOPIC_COMMAND, command_chunk);
+#if OTA_ENABLE
+    A7600_MQTT_Route(&app->mqtt, OTA_TOPIC, Ota_OnChunk);
+#endif
+#if ECHO_ENABLE
+    A7600_MQTT_Route(&app->mqtt, ECHO_TOPIC, EchoProbe_OnChunk);
+#endif
+    A7600_MQTT_SetChunkCallback(&app->mqtt, mqtt_chunk_callback);
+    A7600_MQTT_SetPolicy(&app->mqtt, topic_policy, (uint8_t)(sizeof(topic_policy) / sizeof(topic_policy[0])));
     
-    /* Upload CA Certificate - REMOVED per user request */
-    /* A7600_UploadCert(&app->mqtt, "customer_root_ca.pem", isrg_root_x1, strlen(isrg_root_x1)); */
-    /* HAL_Delay(500); */
+    /* USART1 laps in ~90 ms at 115200 - no driver wait may starve it */
+    A7600_MQTT_SetIdleHook(&app->mqtt, app_idle, app);
+    A7600_MQTT_TopicDescInit(&status_topic, APP_CLIENT_CONTROL, APP_TOPIC_STATUS);
     
-    /* Set message callback */
-    A7600_MQTT_SetMessageCallback(&app->mqtt, mqtt_message_callback);
+    /* After a watchdog or software reset: counters and control loops go on from the last save */
+    app_restore(app);
     
     app->state = APP_STATE_WAIT_MODULE;
     return true;
@@ -90,42 +2018,14 @@ bool App_Connect(App_Handle_t *app)
         return false;
     }
     
-    app->state = APP_STATE_CONNECTING;
-    
-    /* Connect to MQTT broker */
-    LOG_INFO("App_Connect: Calling A7600_MQTT_Connect...");
-    MQTT_Result_t result = A7600_MQTT_Connect(&app->mqtt);
-    LOG_INFO("App_Connect: Result = %d", result);
-    
-    if (result == MQTT_OK) {
-        LOG_INFO("App_Connect: Success Block Entered");
-        app->state = APP_STATE_CONNECTED;
-        app->error_count = 0;
-        
-        /* Subscribe to command topic */
-        //A7600_MQTT_Subscribe(&app->mqtt, APP_TOPIC_COMMAND, MQTT_QOS_0);
-        
-        /* Subscribe to Bridge Rx */
-        LOG_INFO("App_Connect: Subscribing...");
-        //HAL_Delay(5000); /* Wait longer (5s) for session to stabilize */
-        
-        if (A7600_MQTT_Subscribe(&app->mqtt, BRIDGE_TOPIC_RX, MQTT_QOS_0) != MQTT_OK) {
-             LOG_ERROR("Subscribe to RX Topic Failed!");
-             // Optional: Return false to trigger retry? Or just continue?
-             // return false; 
-        } else {
-             LOG_INFO("Subscribed to RX Topic: %s", BRIDGE_TOPIC_RX);
-        }
-        
-        /* Publish online status */
-        App_PublishStatus(app, "online");
-        
-        return true;
-    } else {
-        app->state = APP_STATE_ERROR;
-        app->error_count++;
+    /* Connect to MQTT broker - advanced by A7600_MQTT_Process() */
+    LOG_INFO("App_Connect: Starting A7600_MQTT_ConnectAsync...");
+    if (A7600_MQTT_ConnectAsync(&app->mqtt, app_connect_done, app) != MQTT_OK) {
         return false;
     }
+    
+    app->state = APP_STATE_CONNECTING;
+    return true;
 }
 
 void App_Disconnect(App_Handle_t *app)
@@ -134,12 +2034,8 @@ void App_Disconnect(App_Handle_t *app)
         return;
     }
     
-    /* Publish offline status before disconnect */
-    if (app->state == APP_STATE_CONNECTED) {
-        App_PublishStatus(app, "offline");
-        HAL_Delay(500);
-    }
-    
+    /* No offline publish first: a lost session gets it from the broker (last will). A clean
+     * DISCONNECT discards the will, so the retained status keeps its last value until the next connect */
     A7600_MQTT_Disconnect(&app->mqtt);
     app->state = APP_STATE_WAIT_MODULE;
 }
@@ -167,83 +2063,48 @@ bool App_PublishStatus(App_Handle_t *app, const char *status)
         return false;
     }
     
-    return (A7600_MQTT_PublishString(&app->mqtt, APP_TOPIC_STATUS, status, MQTT_QOS_1) == MQTT_OK);
+    /* QoS1 delivery is tracked by the driver's in-flight window - no RTT wait here */
+    return (A7600_MQTT_PublishDescAsync(&app->mqtt, &status_topic,
+                                        (const uint8_t *)status, strlen(status),
+                                        MQTT_QOS_1, NULL, NULL) == MQTT_OK);
 }
 
 void App_Run(App_Handle_t *app)
 {
+    extern UART_DMA_Handle_t telem_uart;
+    uint8_t events = 0;
+    
     if (app == NULL) {
         return;
     }
     
-    uint32_t current_tick = HAL_GetTick();
+    /* Fetched once per pass - a task that is not due on them still runs at its period */
+    if (UART_DMA_GetEvents(app->uart, NULL) != 0) {
+        events |= SCHED_EVT_MODEM;
+    }
+    if (UART_DMA_GetEvents(&telem_uart, NULL) != 0) {
+        events |= SCHED_EVT_TELEM;
+    }
+    Sched_Run(&app->sched, events);
+}
+
+void App_Sleep(App_Handle_t *app)
+{
+    extern UART_DMA_Handle_t telem_uart;
     
-    switch (app->state) {
-        case APP_STATE_INIT:
-            LOG_INFO("App State: INIT");
-            /* Wait for initialization */
-            break;
-            
-        case APP_STATE_WAIT_MODULE:
-            /* Try to connect */
-            if (current_tick - app->last_reconnect_tick >= 5000) {
-                LOG_INFO("App State: WAIT_MODULE -> Try Connect");
-                app->last_reconnect_tick = current_tick;
-                App_Connect(app);
-            }
-            break;
-            
-        case APP_STATE_CONNECTING:
-            /* Handled by App_Connect() */
-             LOG_INFO("App State: CONNECTING...");
-            break;
-            
-        case APP_STATE_CONNECTED:
-            /* Process MQTT */
-            A7600_MQTT_Process(&app->mqtt);
-            
-            /* Process MAVLink Bridge */
-            MavlinkBridge_Process();
-            
-            /* Check connection */
-            if (!A7600_MQTT_IsConnected(&app->mqtt)) {
-                LOG_ERROR("Disconnected! Switching to ERROR state");
-                app->state = APP_STATE_ERROR;
-                break;
-            }
-            
-            /* Periodic status publish */
-            if (current_tick - app->last_publish_tick >= APP_PUBLISH_INTERVAL) {
-                app->last_publish_tick = current_tick;
-                
-                /* Publish heartbeat */
-                // snprintf(publish_buffer, sizeof(publish_buffer), 
-                //          "{\"uptime\":%lu,\"errors\":%lu}", 
-                //          current_tick / 1000, app->error_count);
-                //LOG_INFO("Publishing Sensor Data: %s", publish_buffer);
-                //App_PublishSensor(app, publish_buffer);
-            }
-            break;
-            
-        case APP_STATE_ERROR:
-            // LOG_INFO("App State: ERROR");
-            /* Try to reconnect */
-            if (current_tick - app->last_reconnect_tick >= APP_RECONNECT_INTERVAL) {
-                LOG_INFO("App State: ERROR -> Retrying...");
-                app->last_reconnect_tick = current_tick;
-                
-                /* Disconnect and reconnect */
-                A7600_MQTT_Disconnect(&app->mqtt);
-                HAL_Delay(1000);
-                
-                app->state = APP_STATE_WAIT_MODULE;
-            }
-            break;
-            
-        default:
-            app->state = APP_STATE_INIT;
-            break;
+    if (app == NULL) {
+        return;
+    }
+    
+    /* IRQs masked so an event landing between check and WFI still wakes us */
+    __disable_irq();
+    if (!UART_DMA_HasEvents(app->uart) && !UART_DMA_HasEvents(&telem_uart)) {
+        uint32_t slept = LowPower_GetStats()->slept_cycles;
+        
+        LowPower_Sleep(Sched_NextDue(&app->sched));
+        Sched_AddIdle(&app->sched, LowPower_GetStats()->slept_cycles - slept);
     }
+    __enable_irq();
 }
 
 bool App_IsConnected(App_Handle_t *app)
@@ -261,3 +2122,19 @@ App_State_t App_GetState(App_Handle_t *app)
     }
     return app->state;
 }
+
+const Sched_t *App_GetScheduler(App_Handle_t *app)
+{
+    if (app == NULL) {
+        return NULL;
+    }
+    return &app->sched;
+}
+
+const App_Metrics_t *App_GetMetrics(App_Handle_t *app)
+{
+    if (app == NULL) {
+        return NULL;
+    }
+    return &app->metrics;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file    app_rtos.c
+ * @brief   Threaded build: the scheduler slices on CMSIS-RTOS2 threads
+ * @version 1.1
+ *
+ * Built by the test_a7600_rtos Keil target (APP_RTOS=1, Keil RTX5 from the
+ * CMSIS pack); empty in the superloop build. The modem, bridge and health
+ * slices of the task table each get a thread that sleeps until its UART
+ * event flags are raised from the IDLE / DMA ISRs or its shortest period
+ * is up. The drivers are not reentrant, so a slice runs with the app lock
+ * held: threads take turns at task boundaries in priority order instead
+ * of table order. Thread and mutex memory is static; the wake latency
+ * (ISR to slice start) and the stack left per thread are published with
+ * the task statistics. The idle thread books the time it sleeps to the
+ * scheduler's load meter.
+ */
+
+#include "app.h"
+
+#if APP_RTOS
+
+#include "debug_log.h"
+#include "cmsis_os2.h"
+#include "rtx_os.h"
+
+#define LOG_FILE_ID             3
+#define LOG_MODULE              LOG_MOD_APP
+
+/* Thread stacks (bytes, multiple of 8) */
+#define RTOS_STACK_MODEM        1024    /* status snprintf and the driver's connect steps */
+#define RTOS_STACK_BRIDGE       512
+#define RTOS_STACK_HEALTH       256
+
+/**
+ * @brief A thread and the slice of the task table it runs
+ */
+typedef struct {
+    const char *name;
+    uint8_t first;              /* APP_SLICE_x */
+    uint8_t count;
+    uint8_t events;             /* SCHED_EVT_x that wake it */
+    uint16_t wait_ms;           /* Wakes at least this often (shortest period in the slice) */
+    osPriority_t priority;
+    void *stack;
+    uint32_t stack_size;
+} Rtos_Thread_t;
+
+static uint64_t stack_modem[RTOS_STACK_MODEM / 8];
+static uint64_t stack_bridge[RTOS_STACK_BRIDGE / 8];
+static uint64_t stack_health[RTOS_STACK_HEALTH / 8];
+
+/* The bridge above the modem: the FC ring laps in ~90 ms, the modem side has slack */
+static const Rtos_Thread_t threads[APP_THREADS] = {
+    { "modem",  APP_SLICE_MODEM,  APP_SLICE_BRIDGE - APP_SLICE_MODEM, SCHED_EVT_MODEM,
+      10, osPriorityNormal, stack_modem, sizeof(stack_modem) },
+    { "bridge", APP_SLICE_BRIDGE, APP_SLICE_HEALTH - APP_SLICE_BRIDGE, SCHED_EVT_TELEM | SCHED_EVT_MODEM,
+      10, osPriorityAboveNormal, stack_bridge, sizeof(stack_bridge) },
+    { "health", APP_SLICE_HEALTH, APP_TASKS - APP_SLICE_HEALTH, 0,
+      100, osPriorityBelowNormal, stack_health, sizeof(stack_health) },
+};
+
+static struct {
+    App_Handle_t *app;
+    osThreadId_t id[APP_THREADS];
+    osMutexId_t lock;                       /* One slice at a time */
+    volatile uint32_t signalled[APP_THREADS];   /* Sched_Cycles() at the first unserved flag (0: none) */
+    uint32_t wake_max[APP_THREADS];         /* Longest ISR-to-slice latency, cycles */
+} rtos;
+
+static osRtxThread_t thread_cb[APP_THREADS];
+static osRtxMutex_t lock_cb;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief UART RX event hook (ISR): wake the threads that wait on this UART
+ * @param ctx SCHED_EVT_x of the UART
+ */
+static void uart_event(void *ctx, uint8_t events)
+{
+    uint8_t flag = (uint8_t)(uintptr_t)ctx;
+    
+    (void)events;
+    if (osKernelGetState() != osKernelRunning) {
+        return;
+    }
+    for (uint8_t i = 0; i < APP_THREADS; i++) {
+        if ((threads[i].events & flag) == 0) {
+            continue;
+        }
+        if (rtos.signalled[i] == 0) {
+            rtos.signalled[i] = Sched_Cycles() | 1U;
+        }
+        osThreadFlagsSet(rtos.id[i], flag);
+    }
+}
+
+/**
+ * @brief Thread body: wait for events or the period, then run the slice under the lock
+ * @param arg Index into threads[]
+ */
+static void thread_run(void *arg)
+{
+    uint8_t i = (uint8_t)(uintptr_t)arg;
+    const Rtos_Thread_t *th = &threads[i];
+    
+    bool busy = false;
+    
+    for (;;) {
+        uint32_t wait = busy ? 1U : th->wait_ms;   /* Work left: back on the next tick */
+        uint32_t flags = 0;
+        
+        if (th->events != 0) {
+            flags = osThreadFlagsWait(th->events, osFlagsWaitAny, wait);
+            if (flags & osFlagsError) {
+                flags = 0;  /* Timed out - periods only */
+            }
+        } else {
+            osDelay(wait);
+        }
+        
+        osMutexAcquire(rtos.lock, osWaitForever);
+        uint32_t stamp = rtos.signalled[i];
+        if (stamp != 0) {
+            uint32_t wake = Sched_Cycles() - stamp;
+            
+            rtos.signalled[i] = 0;
+            if (wake > rtos.wake_max[i]) {
+                rtos.wake_max[i] = wake;
+            }
+        }
+        busy = Sched_RunTasks(&rtos.app->sched, (uint8_t)flags, th->first, th->count);
+        osMutexRelease(rtos.lock);
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+void App_RtosStart(App_Handle_t *app)
+{
+    extern UART_DMA_Handle_t telem_uart;
+    const osMutexAttr_t lock_attr = {
+        .name = "app",
+        .attr_bits = osMutexPrioInherit,
+        .cb_mem = &lock_cb,
+        .cb_size = sizeof(lock_cb)
+    };
+    
+    osKernelInitialize();
+    rtos.app = app;
+    rtos.lock = osMutexNew(&lock_attr);
+    if (rtos.lock == NULL) {
+        LOG_ERROR("RTOS: no app lock");
+    }
+    
+    for (uint8_t i = 0; i < APP_THREADS; i++) {
+        const osThreadAttr_t attr = {
+            .name = threads[i].name,
+            .cb_mem = &thread_cb[i],
+            .cb_size = sizeof(thread_cb[i]),
+            .stack_mem = threads[i].stack,
+            .stack_size = threads[i].stack_size,
+            .priority = threads[i].priority
+        };
+        
+        rtos.id[i] = osThreadNew(thread_run, (void *)(uintptr_t)i, &attr);
+        if (rtos.id[i] == NULL) {
+            LOG_ERROR("RTOS: no thread %s", threads[i].name);
+        }
+    }
+    UART_DMA_SetEventHook(app->uart, uart_event, (void *)(uintptr_t)SCHED_EVT_MODEM);
+    UART_DMA_SetEventHook(&telem_uart, uart_event, (void *)(uintptr_t)SCHED_EVT_TELEM);
+    
+    LOG_INFO("RTOS: %d threads", APP_THREADS);
+    osKernelStart();
+}
+
+void App_RtosGetThreadStats(uint8_t thread, uint32_t *stack_free, uint32_t *wake_max_us)
+{
+    if (thread >= APP_THREADS || rtos.app == NULL) {
+        *stack_free = 0;
+        *wake_max_us = 0;
+        return;
+    }
+    *stack_free = osThreadGetStackSpace(rtos.id[thread]);
+    *wake_max_us = Sched_CyclesToUs(&rtos.app->sched, rtos.wake_max[thread]);
+}
+
+/**
+ * @brief RTX5 idle thread (overrides RTX_Config.c): WFI, the time asleep is idle for the load meter
+ * @note  Interrupts masked around it, so the wake-up ISR runs after the count is taken
+ */
+__NO_RETURN void osRtxIdleThread(void *argument)
+{
+    (void)argument;
+    
+    for (;;) {
+        __disable_irq();
+        uint32_t load = SysTick->LOAD + 1U;
+        uint32_t before = SysTick->VAL;
+        
+        __WFI();
+        Sched_AddIdle(&rtos.app->sched, (before + load - SysTick->VAL) % load);
+        __enable_irq();
+    }
+}
+
+/**
+ * @brief HAL time base: RTX5 owns SysTick, so HAL does not set it up
+ */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
+{
+    (void)TickPriority;
+    return HAL_OK;
+}
+
+/**
+ * @brief HAL tick from the kernel; before the kernel runs each call waits
+ *        about 1 ms and counts it (ISRs get the count without waiting)
+ */
+uint32_t HAL_GetTick(void)
+{
+    static uint32_t ticks;
+    
+    if (osKernelGetState() == osKernelRunning) {
+        return osKernelGetTickCount();
+    }
+    if (__get_IPSR() == 0) {
+        for (uint32_t i = SystemCoreClock >> 14; i > 0; i--) {
+            __NOP(); __NOP(); __NOP(); __NOP(); __NOP(); __NOP();
+            __NOP(); __NOP(); __NOP(); __NOP(); __NOP(); __NOP();
+        }
+        ticks++;
+    }
+    return ticks;
+}
+
+#endif /* APP_RTOS */
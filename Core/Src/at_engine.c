@@ -0,0 +1,604 @@
+/**
+ * @file    at_engine.c
+ * @brief   Non-blocking AT command engine implementation
+ * @version 1.9
+ */
+
+#include "at_engine.h"
+#include "debug_log.h"
+#include <string.h>
+
+#if AT_CAPTURE && !(defined(DEBUG_ENABLE) && DEBUG_RTT && DEBUG_RTT_CAPTURE > 0 && UART_DMA_TAP)
+#error "AT_CAPTURE needs DEBUG_ENABLE, DEBUG_RTT and the RTT capture channel"
+#endif
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Move the partial line to the front (drops dispatched lines)
+ */
+static void at_shift(AT_Engine_t *eng)
+{
+    size_t keep = eng->rx_len - eng->line;
+    
+    memmove(eng->rx_buf, &eng->rx_buf[eng->line], keep);
+    eng->rx_len = keep;
+    eng->scan -= eng->line;
+    eng->line = 0;
+    eng->rx_buf[keep] = '\0';
+}
+
+/**
+ * @brief Pull whatever the modem sent into the response buffer
+ */
+static size_t at_read(AT_Engine_t *eng)
+{
+    size_t available = UART_DMA_Available(eng->uart);
+    
+    if (available == 0) {
+        return 0;
+    }
+    
+    /* Full - make room by dropping finished lines, or everything if one line fills it */
+    if (eng->rx_len + 1 >= sizeof(eng->rx_buf)) {
+        if (eng->line > 0) {
+            at_shift(eng);
+        } else {
+            AT_Engine_ClearRx(eng);
+        }
+    }
+    
+    size_t space = sizeof(eng->rx_buf) - eng->rx_len - 1;
+    if (available > space) {
+        available = space;
+    }
+    
+    size_t len = (eng->read_fn != NULL) ?
+                 eng->read_fn(eng->read_ctx, &eng->rx_buf[eng->rx_len], available) :
+                 UART_DMA_Read(eng->uart, &eng->rx_buf[eng->rx_len], available);
+    eng->rx_len += len;
+    eng->rx_buf[eng->rx_len] = '\0';
+    eng->rx_total += (uint32_t)len;
+    return len;
+}
+
+#if AT_CAPTURE
+/**
+ * @brief Modem UART tap: one capture record per read / queued span
+ * @note  Spans longer than half the channel are split, so each can fit
+ */
+static void at_capture(void *ctx, bool tx, const uint8_t *data, size_t len)
+{
+    static uint32_t lost;
+    uint32_t tick = HAL_GetTick();
+    uint8_t hdr[AT_CAPTURE_HDR];
+    
+    (void)ctx;
+    hdr[3] = (uint8_t)tick;
+    hdr[4] = (uint8_t)(tick >> 8);
+    hdr[5] = (uint8_t)(tick >> 16);
+    hdr[6] = (uint8_t)(tick >> 24);
+    
+    if (lost != 0) {
+        uint8_t n[4] = { (uint8_t)lost, (uint8_t)(lost >> 8), (uint8_t)(lost >> 16), (uint8_t)(lost >> 24) };
+        
+        hdr[0] = AT_CAPTURE_DROP;
+        hdr[1] = sizeof(n);
+        hdr[2] = 0;
+        if (Debug_CaptureWrite(hdr, sizeof(hdr), n, sizeof(n))) {
+            lost = 0;
+        }
+    }
+    while (len > 0) {
+        size_t n = (len < DEBUG_RTT_CAPTURE / 2 - sizeof(hdr)) ? len : DEBUG_RTT_CAPTURE / 2 - sizeof(hdr);
+        
+        hdr[0] = tx ? AT_CAPTURE_TX : AT_CAPTURE_RX;
+        hdr[1] = (uint8_t)n;
+        hdr[2] = (uint8_t)(n >> 8);
+        if (lost != 0 || !Debug_CaptureWrite(hdr, sizeof(hdr), data, n)) {
+            lost += (uint32_t)n;
+        }
+        data += n;
+        len -= n;
+    }
+}
+#endif
+
+#if AT_TRACE_SIZE > 0
+static void trace_put(AT_Engine_t *eng, uint8_t byte)
+{
+    eng->trace[eng->trace_head] = byte;
+    eng->trace_head = (uint16_t)((eng->trace_head + 1) % AT_TRACE_SIZE);
+    eng->trace_used++;
+}
+
+/**
+ * @brief Reverse trace[from .. to - 1] in place
+ */
+static void trace_reverse(AT_Engine_t *eng, size_t from, size_t to)
+{
+    while (from + 1 < to) {
+        uint8_t b = eng->trace[from];
+        eng->trace[from++] = eng->trace[--to];
+        eng->trace[to] = b;
+    }
+}
+#endif
+
+/**
+ * @brief Append a transcript record, dropping the oldest ones to make room
+ */
+static void at_trace(AT_Engine_t *eng, uint8_t type, const void *text, size_t len)
+{
+#if AT_TRACE_SIZE > 0
+    const uint8_t *p = (const uint8_t *)text;
+    uint16_t tick = (uint16_t)HAL_GetTick();
+    
+    if (eng->trace_paused) {
+        return;
+    }
+    if (len > AT_TRACE_TEXT_MAX) {
+        len = AT_TRACE_TEXT_MAX;
+    }
+    while ((size_t)(AT_TRACE_SIZE - eng->trace_used) < 3 + len) {
+        size_t tail = (eng->trace_head + AT_TRACE_SIZE - eng->trace_used) % AT_TRACE_SIZE;
+        eng->trace_used = (uint16_t)(eng->trace_used - 3 - (eng->trace[tail] & AT_TRACE_LEN_MASK));
+    }
+    trace_put(eng, (uint8_t)(type | len));
+    trace_put(eng, (uint8_t)tick);
+    trace_put(eng, (uint8_t)(tick >> 8));
+    for (size_t i = 0; i < len; i++) {
+        trace_put(eng, p[i]);
+    }
+#else
+    (void)eng; (void)type; (void)text; (void)len;
+#endif
+}
+
+/**
+ * @brief Record what the current command put on the wire
+ */
+static void at_trace_cmd(AT_Engine_t *eng, const AT_Cmd_t *cmd)
+{
+    size_t len = cmd->len;
+    
+    if (cmd->send == NULL && cmd->data != NULL && !(cmd->flags & AT_FLAG_ZC)) {
+        while (len > 0 && (cmd->data[len - 1] == '\r' || cmd->data[len - 1] == '\n')) {
+            len--;
+        }
+        at_trace(eng, AT_TRACE_TX, cmd->data, len);
+    } else {
+        at_trace(eng, AT_TRACE_CMD, cmd->expected, strlen(cmd->expected));
+    }
+}
+
+/**
+ * @brief Guard time before the next command, AT_GUARD_CHARS rounded up to ticks
+ */
+static uint32_t at_guard_ms(AT_Engine_t *eng)
+{
+#if AT_GUARD_CHARS > 0
+    uint32_t baud = UART_DMA_GetBaudRate(eng->uart);
+    
+    /* 10 bit times per character (8N1) */
+    return (baud == 0) ? 0 : (AT_GUARD_CHARS * 10UL * 1000UL + baud - 1) / baud;
+#else
+    (void)eng;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Retire the current command and report its outcome
+ */
+static void at_complete(AT_Engine_t *eng, AT_Result_t result)
+{
+    AT_Cmd_t cmd = eng->queue[eng->head];
+    uint8_t code = (uint8_t)result;
+    
+    at_trace(eng, AT_TRACE_END, &code, 1);
+    
+    /* A failed zero-copy send may still be on DMA - caller reuses the buffer */
+    if ((cmd.flags & AT_FLAG_ZC) && result != AT_OK) {
+        UART_DMA_WaitTxIdle(eng->uart, 1000, NULL, NULL);
+    }
+    
+    eng->head = (uint8_t)((eng->head + 1) % AT_QUEUE_LEN);
+    eng->count--;
+    
+    /* Rest of a failed sequence must not go out (e.g. payload text as a command) */
+    while (result != AT_OK && eng->count > 0 && (eng->queue[eng->head].flags & AT_FLAG_CHAIN)) {
+        eng->head = (uint8_t)((eng->head + 1) % AT_QUEUE_LEN);
+        eng->count--;
+    }
+    
+    eng->sending = false;
+    eng->active = false;
+    eng->done_tick = HAL_GetTick();
+    
+    /* Engine is consistent again - callback may submit the next command */
+    if (cmd.on_done != NULL) {
+        cmd.on_done(cmd.ctx, result);
+    }
+}
+
+/**
+ * @brief Try to put the current command on the wire
+ */
+static void at_start(AT_Engine_t *eng)
+{
+    AT_Cmd_t *cmd = &eng->queue[eng->head];
+    uint32_t now = HAL_GetTick();
+    uint32_t tx_before, tx_after;
+    bool sent;
+    
+    /* Next command goes out as soon as the previous one's final result is in */
+    uint32_t gap = (cmd->delay_ms != 0) ? cmd->delay_ms : at_guard_ms(eng);
+    if (now - eng->done_tick < gap) {
+        return;
+    }
+    
+    if (!eng->sending) {
+        eng->sending = true;
+        eng->start_tick = now;
+    }
+    
+    /* Modem asleep: the command waits for it, its timeout already running */
+    if ((cmd->send != NULL || cmd->data != NULL) && eng->wake_fn != NULL && !eng->wake_fn(eng->wake_ctx)) {
+        if (now - eng->start_tick > cmd->timeout_ms) {
+            at_complete(eng, AT_TIMEOUT);
+        }
+        return;
+    }
+    
+    /* Only text already dispatched goes - a half-received URC line stays */
+    if (!(cmd->flags & AT_FLAG_KEEP_RX)) {
+        AT_Engine_DiscardLines(eng);
+    }
+    
+    UART_DMA_GetTraffic(eng->uart, &tx_before, NULL);
+    if (cmd->send != NULL) {
+        sent = cmd->send(cmd->ctx, eng->uart);
+    } else if (cmd->data == NULL) {
+        sent = true;    /* Wait-only entry */
+    } else if (cmd->flags & AT_FLAG_ZC) {
+        sent = (UART_DMA_TransmitZC(eng->uart, cmd->data, cmd->len, NULL, NULL) == HAL_OK);
+    } else {
+        sent = (UART_DMA_Transmit(eng->uart, cmd->data, cmd->len) == HAL_OK);
+    }
+    
+    if (cmd->flags & AT_FLAG_DATA) {
+        UART_DMA_GetTraffic(eng->uart, &tx_after, NULL);
+        eng->wire[AT_WIRE_TX_DATA] += tx_after - tx_before;
+    }
+    if (sent) {
+        eng->active = true;
+        eng->start_tick = now;
+        at_trace_cmd(eng, cmd);
+    } else if (now - eng->start_tick > cmd->timeout_ms) {
+        at_complete(eng, AT_TIMEOUT);
+    }
+}
+
+/**
+ * @brief Classify a complete line
+ */
+static AT_LineType_t at_classify(const char *line, size_t len)
+{
+    if (len == 2 && line[0] == 'O' && line[1] == 'K') {
+        return AT_LINE_OK;
+    }
+    if ((len == 5 && memcmp(line, "ERROR", 5) == 0) ||
+        (len >= 10 && (memcmp(line, "+CME ERROR", 10) == 0 || memcmp(line, "+CMS ERROR", 10) == 0))) {
+        return AT_LINE_ERROR;
+    }
+    if (line[0] == '+') {
+        return AT_LINE_URC;
+    }
+    return AT_LINE_DATA;
+}
+
+/**
+ * @brief Match a line against the current command, then pass it on
+ */
+static void at_dispatch(AT_Engine_t *eng, const char *line, size_t len, AT_LineType_t type)
+{
+    AT_LineFn_t fn = eng->line_fn;
+    
+    at_trace(eng, AT_TRACE_RX, line, len);
+    if (type == AT_LINE_URC) {
+        for (uint8_t i = 0; i < eng->urc_count; i++) {
+            size_t n = strlen(eng->urcs[i].prefix);
+            if (len >= n && memcmp(line, eng->urcs[i].prefix, n) == 0) {
+                fn = eng->urcs[i].handler;
+                break;
+            }
+        }
+    }
+    if (fn != NULL) {
+        fn(eng->line_ctx, line, len, type);
+    }
+    
+    if (!eng->active) {
+        return;
+    }
+    
+    const char *expected = eng->queue[eng->head].expected;
+    size_t n = strlen(expected);
+    
+    if ((type == AT_LINE_PROMPT) ? (expected[0] == '>') :
+        (len >= n && memcmp(line, expected, n) == 0)) {
+        at_complete(eng, AT_OK);
+    } else if (type == AT_LINE_ERROR) {
+        at_complete(eng, AT_ERROR);
+    }
+}
+
+/**
+ * @brief Split newly received bytes into lines (each byte is looked at once)
+ */
+static void at_tokenize(AT_Engine_t *eng)
+{
+    const char *buf = (const char *)eng->rx_buf;
+    
+    while (eng->scan < eng->rx_len) {
+        /* Captured bytes go out as they arrive, never split into lines */
+        if (eng->raw_left > 0) {
+            size_t n = eng->rx_len - eng->scan;
+            if (n > eng->raw_left) {
+                n = eng->raw_left;
+            }
+            eng->raw_left -= n;
+            eng->wire[AT_WIRE_RX_DATA] += (uint32_t)n;
+            eng->raw_fn(eng->line_ctx, &eng->rx_buf[eng->scan], n);
+            eng->scan += n;
+            eng->line = eng->scan;
+            continue;
+        }
+        
+        if (buf[eng->scan++] != '\n') {
+            continue;
+        }
+    
+        const char *line = &buf[eng->line];
+        size_t len = eng->scan - 1 - eng->line;
+        size_t wire = eng->scan - eng->line;
+        eng->line = eng->scan;
+    
+        /* Strip CR and trailing blanks; skip empty lines */
+        while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ')) {
+            len--;
+        }
+        if (len > 0) {
+            AT_LineType_t type = at_classify(line, len);
+            
+            if (type == AT_LINE_URC) {
+                eng->wire[AT_WIRE_URC] += (uint32_t)wire;
+            }
+            at_dispatch(eng, line, len, type);
+        }
+    }
+    
+    /* Data prompt "> " never gets a line end */
+    if (eng->raw_left == 0 && eng->rx_len > eng->line && eng->rx_len - eng->line <= 2 && buf[eng->line] == '>') {
+        const char *line = &buf[eng->line];
+        eng->wire[AT_WIRE_PROMPT] += (uint32_t)(eng->rx_len - eng->line);
+        eng->line = eng->rx_len;
+        at_dispatch(eng, line, 1, AT_LINE_PROMPT);
+    }
+}
+
+/**
+ * @brief Exec completion - records outcome for the blocking caller
+ */
+typedef struct {
+    volatile bool done;
+    AT_Result_t result;
+} AT_ExecState_t;
+
+static void at_exec_done(void *ctx, AT_Result_t result)
+{
+    AT_ExecState_t *st = (AT_ExecState_t *)ctx;
+    st->result = result;
+    st->done = true;
+}
+
+/* ==================== Public Functions ==================== */
+
+void AT_Engine_Init(AT_Engine_t *eng, UART_DMA_Handle_t *uart)
+{
+    eng->uart = uart;
+    eng->head = 0;
+    eng->count = 0;
+    eng->sending = false;
+    eng->active = false;
+    eng->start_tick = 0;
+    eng->done_tick = 0;
+    eng->urcs = NULL;
+    eng->urc_count = 0;
+    eng->line_fn = NULL;
+    eng->line_ctx = NULL;
+    eng->raw_fn = NULL;
+    eng->raw_left = 0;
+    eng->wake_fn = NULL;
+    eng->wake_ctx = NULL;
+    eng->read_fn = NULL;
+    eng->read_ctx = NULL;
+    memset(eng->wire, 0, sizeof(eng->wire));
+    UART_DMA_GetTraffic(uart, &eng->tx_base, NULL);
+    eng->rx_total = 0;
+#if AT_TRACE_SIZE > 0
+    eng->trace_head = 0;
+    eng->trace_used = 0;
+    eng->trace_paused = false;
+#endif
+#if AT_CAPTURE
+    UART_DMA_SetTap(uart, at_capture, NULL);
+#endif
+    AT_Engine_ClearRx(eng);
+}
+
+void AT_Engine_SetLineHandler(AT_Engine_t *eng, const AT_Urc_t *urcs, uint8_t count,
+                              AT_LineFn_t fn, void *ctx)
+{
+    eng->urcs = urcs;
+    eng->urc_count = (urcs != NULL) ? count : 0;
+    eng->line_fn = fn;
+    eng->line_ctx = ctx;
+}
+
+void AT_Engine_SetWake(AT_Engine_t *eng, AT_WakeFn_t fn, void *ctx)
+{
+    eng->wake_fn = fn;
+    eng->wake_ctx = ctx;
+}
+
+void AT_Engine_SetSource(AT_Engine_t *eng, AT_ReadFn_t fn, void *ctx)
+{
+    eng->read_fn = fn;
+    eng->read_ctx = ctx;
+}
+
+void AT_Engine_Capture(AT_Engine_t *eng, size_t count, AT_RawFn_t fn)
+{
+    eng->raw_fn = fn;
+    eng->raw_left = (fn != NULL) ? count : 0;
+}
+
+bool AT_Engine_Submit(AT_Engine_t *eng, const AT_Cmd_t *cmd)
+{
+    if (eng->count >= AT_QUEUE_LEN) {
+        return false;
+    }
+    
+    eng->queue[(eng->head + eng->count) % AT_QUEUE_LEN] = *cmd;
+    eng->count++;
+    return true;
+}
+
+size_t AT_Engine_Process(AT_Engine_t *eng)
+{
+    /* Start before reading, so a fresh command's clear never eats its reply */
+    if (!eng->active && eng->count > 0) {
+        at_start(eng);
+    }
+    
+    size_t len = at_read(eng);
+    
+    if (len > 0) {
+        at_tokenize(eng);
+    }
+    
+    if (eng->active && HAL_GetTick() - eng->start_tick > eng->queue[eng->head].timeout_ms) {
+        at_complete(eng, AT_TIMEOUT);
+    }
+    
+    /* Next queued command goes out in the same pass its predecessor finished */
+    if (!eng->active && eng->count > 0) {
+        at_start(eng);
+    }
+    return len;
+}
+
+AT_Result_t AT_Engine_Exec(AT_Engine_t *eng, const AT_Cmd_t *cmd,
+                           UART_DMA_YieldFn_t yield, void *ctx)
+{
+    AT_ExecState_t st;
+    AT_Cmd_t c = *cmd;
+    
+    st.done = false;
+    st.result = AT_TIMEOUT;
+    c.send = NULL;
+    c.on_done = at_exec_done;
+    c.ctx = &st;
+    
+    while (!AT_Engine_Submit(eng, &c)) {
+        AT_Engine_Process(eng);
+        if (yield != NULL) {
+            yield(ctx);
+        }
+    }
+    
+    while (!st.done) {
+        AT_Engine_Process(eng);
+        if (yield != NULL) {
+            yield(ctx);
+        }
+        /* Sleep until the modem UART signals a line / new data (max 10 ms) */
+        UART_DMA_WaitEvent(eng->uart, 10);
+    }
+    return st.result;
+}
+
+uint8_t AT_Engine_Free(AT_Engine_t *eng)
+{
+    return (uint8_t)(AT_QUEUE_LEN - eng->count);
+}
+
+bool AT_Engine_IsIdle(AT_Engine_t *eng)
+{
+    return (eng->count == 0);
+}
+
+void AT_Engine_ClearRx(AT_Engine_t *eng)
+{
+    eng->rx_len = 0;
+    eng->line = 0;
+    eng->scan = 0;
+    eng->raw_left = 0;
+    eng->rx_buf[0] = '\0';     /* Readers stop at rx_len - nothing past it is looked at */
+}
+
+void AT_Engine_DiscardLines(AT_Engine_t *eng)
+{
+    if (eng->line == 0) {
+        return;
+    }
+    at_shift(eng);
+}
+
+void AT_Engine_GetWire(AT_Engine_t *eng, uint32_t wire[AT_WIRE_CLASSES])
+{
+    uint32_t tx;
+    
+    UART_DMA_GetTraffic(eng->uart, &tx, NULL);
+    memcpy(wire, eng->wire, sizeof(eng->wire));
+    wire[AT_WIRE_CMD] = tx - eng->tx_base - wire[AT_WIRE_TX_DATA];
+    wire[AT_WIRE_RESPONSE] = eng->rx_total - wire[AT_WIRE_PROMPT] - wire[AT_WIRE_URC] - wire[AT_WIRE_RX_DATA];
+}
+
+uint32_t AT_Engine_WireTotal(AT_Engine_t *eng)
+{
+    uint32_t tx;
+    
+    UART_DMA_GetTraffic(eng->uart, &tx, NULL);
+    return (tx - eng->tx_base) + eng->rx_total;
+}
+
+size_t AT_Engine_TraceFreeze(AT_Engine_t *eng, const uint8_t **data)
+{
+#if AT_TRACE_SIZE > 0
+    size_t tail = (eng->trace_head + AT_TRACE_SIZE - eng->trace_used) % AT_TRACE_SIZE;
+    
+    /* Rotate the oldest record to the front - three reversals, no scratch buffer */
+    eng->trace_paused = true;
+    trace_reverse(eng, 0, tail);
+    trace_reverse(eng, tail, AT_TRACE_SIZE);
+    trace_reverse(eng, 0, AT_TRACE_SIZE);
+    eng->trace_head = (uint16_t)(eng->trace_used % AT_TRACE_SIZE);
+    *data = eng->trace;
+    return eng->trace_used;
+#else
+    *data = NULL;
+    return 0;
+#endif
+}
+
+void AT_Engine_TraceResume(AT_Engine_t *eng)
+{
+#if AT_TRACE_SIZE > 0
+    eng->trace_paused = false;
+#else
+    (void)eng;
+#endif
+}
@@ -0,0 +1,259 @@
+/**
+ * @file    bench_gen.c
+ * @brief   Synthetic MAVLink v2 source for on-target throughput runs
+ * @version 1.0
+ */
+
+#include "bench_gen.h"
+#include <string.h>
+
+#if BENCH_BRIDGE
+
+/* Config */
+#define BENCH_SYSID         1
+#define BENCH_COMPID        1
+#define BENCH_TX_SIZE       256     /* Frames per USART1 transfer, bytes */
+#define BENCH_DUE_MAX       8       /* Frames of one message that may wait for the wire */
+#define BENCH_HEADER_LEN    10
+
+/* Message mix at 100 %: an ArduPilot SRx stream set (~700 B/s). The
+ * bridge forwards these IDs, so CRC_EXTRA must match its table */
+static const struct {
+    uint32_t msgid;
+    uint8_t len;            /* Payload bytes */
+    uint8_t crc_extra;
+    uint8_t hz;
+} bench_mix[] = {
+    {  30, 28,  39, 10 },   /* ATTITUDE */
+    {  33, 28, 104,  5 },   /* GLOBAL_POSITION_INT */
+    {  74, 20,  20,  5 },   /* VFR_HUD */
+    {   1, 31, 124,  2 },   /* SYS_STATUS */
+    {  24, 30,  24,  2 },   /* GPS_RAW_INT */
+    {   0,  9,  50,  1 },   /* HEARTBEAT */
+};
+#define BENCH_MIX           (sizeof(bench_mix) / sizeof(bench_mix[0]))
+
+static struct {
+    UART_DMA_Handle_t *uart;
+    uint16_t rate;                  /* Percent of the mix */
+    uint32_t acc[BENCH_MIX];        /* Rate accumulators, 100000 per frame due */
+    uint8_t due[BENCH_MIX];         /* Frames waiting for the wire */
+    uint32_t tick;                  /* Last accumulation */
+    uint8_t seq;
+    uint32_t count;                 /* Frames built - varies payloads past dedup */
+    volatile bool busy;             /* tx_buf is on the wire */
+    uint8_t tx_buf[BENCH_TX_SIZE];
+    /* Run */
+    uint32_t start;
+    uint32_t gen_frames, gen_bytes, gen_skipped;
+    /* Counters at the run start */
+    uint32_t base_frames, base_bytes, base_rejected, base_overrun;
+    MavlinkBridge_LinkStats_t base_link;
+} gen;
+
+/**
+ * @brief X.25 CRC of MAVLink, one byte
+ */
+static uint16_t crc_byte(uint16_t crc, uint8_t byte)
+{
+    uint8_t t = byte ^ (uint8_t)crc;
+
+    t ^= (uint8_t)(t << 4);
+    return (uint16_t)((crc >> 8) ^ ((uint16_t)t << 8) ^ ((uint16_t)t << 3) ^ (t >> 4));
+}
+
+/**
+ * @brief Build one frame of mix entry i
+ * @return Frame length
+ */
+static size_t build_frame(uint8_t *f, size_t i)
+{
+    size_t len = bench_mix[i].len;
+    uint32_t msgid = bench_mix[i].msgid;
+    uint16_t crc = 0xFFFF;
+
+    f[0] = 0xFD;
+    f[1] = (uint8_t)len;
+    f[2] = 0;
+    f[3] = 0;
+    f[4] = gen.seq++;
+    f[5] = BENCH_SYSID;
+    f[6] = BENCH_COMPID;
+    f[7] = (uint8_t)msgid;
+    f[8] = (uint8_t)(msgid >> 8);
+    f[9] = (uint8_t)(msgid >> 16);
+
+    /* Frame count first (no two payloads alike), then a fill that ends nonzero */
+    for (size_t j = 0; j < len; j++) {
+        f[BENCH_HEADER_LEN + j] = (j < 4) ? (uint8_t)(gen.count >> (8 * j)) : (uint8_t)(j | 0x80);
+    }
+    gen.count++;
+
+    for (size_t j = 1; j < BENCH_HEADER_LEN + len; j++) {
+        crc = crc_byte(crc, f[j]);
+    }
+    crc = crc_byte(crc, bench_mix[i].crc_extra);
+    f[BENCH_HEADER_LEN + len] = (uint8_t)crc;
+    f[BENCH_HEADER_LEN + len + 1] = (uint8_t)(crc >> 8);
+    return BENCH_HEADER_LEN + len + 2;
+}
+
+/**
+ * @brief USART1 finished tx_buf (ISR)
+ */
+static void bench_sent(void *ctx)
+{
+    (void)ctx;
+    gen.busy = false;
+}
+
+/**
+ * @brief Add the frames that fell due since the last call
+ */
+static void bench_accumulate(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t ms = now - gen.tick;
+
+    gen.tick = now;
+    for (size_t i = 0; i < BENCH_MIX; i++) {
+        /* hz * rate / 100 frames per second = hz * rate per 100000 ms */
+        gen.acc[i] += (uint32_t)bench_mix[i].hz * gen.rate * ms;
+        while (gen.acc[i] >= 100000U) {
+            gen.acc[i] -= 100000U;
+            if (gen.due[i] < BENCH_DUE_MAX) {
+                gen.due[i]++;
+            } else {
+                gen.gen_skipped++;
+            }
+        }
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+void BenchGen_Init(UART_DMA_Handle_t *uart)
+{
+    gen.uart = uart;
+    gen.busy = false;
+    gen.seq = 0;
+    gen.count = 0;
+
+#if !BENCH_LOOPBACK_EXTERNAL
+    /* Half duplex: the receiver hears the transmitter inside the USART
+     * (HDSEL may only change with the USART off; the RX DMA just pauses) */
+    __HAL_UART_DISABLE(uart->huart);
+    SET_BIT(uart->huart->Instance->CR3, USART_CR3_HDSEL);
+    __HAL_UART_ENABLE(uart->huart);
+#endif
+
+    BenchGen_SetRate(BENCH_RATE_BOOT);
+}
+
+bool BenchGen_SetRate(uint16_t percent)
+{
+    if (percent > BENCH_RATE_MAX) {
+        return false;
+    }
+
+    gen.rate = percent;
+    gen.tick = HAL_GetTick();
+    memset(gen.acc, 0, sizeof(gen.acc));
+    memset(gen.due, 0, sizeof(gen.due));
+
+    gen.start = gen.tick;
+    gen.gen_frames = 0;
+    gen.gen_bytes = 0;
+    gen.gen_skipped = 0;
+    MavlinkBridge_GetStats(&gen.base_frames, &gen.base_bytes, &gen.base_rejected);
+    UART_DMA_GetOverrun(gen.uart, NULL, &gen.base_overrun);
+    gen.base_link = *MavlinkBridge_GetLinkStats();
+    return true;
+}
+
+void BenchGen_Process(void)
+{
+    size_t len = 0;
+    uint32_t frames = 0;
+    bool more = true;
+
+    if (gen.uart == NULL) {
+        return;
+    }
+    bench_accumulate();
+    if (gen.busy) {
+        return;
+    }
+
+    /* Due frames round-robin over the mix, as many as fit one transfer */
+    while (more) {
+        more = false;
+        for (size_t i = 0; i < BENCH_MIX; i++) {
+            if (gen.due[i] == 0) {
+                continue;
+            }
+            if (len + BENCH_HEADER_LEN + bench_mix[i].len + 2 > sizeof(gen.tx_buf)) {
+                more = false;
+                break;
+            }
+            len += build_frame(&gen.tx_buf[len], i);
+            gen.due[i]--;
+            frames++;
+            more = true;
+        }
+    }
+    if (len == 0) {
+        return;
+    }
+
+    gen.busy = true;
+    if (UART_DMA_TransmitZC(gen.uart, gen.tx_buf, len, bench_sent, NULL) == HAL_OK) {
+        gen.gen_frames += frames;
+        gen.gen_bytes += len;
+    } else {
+        /* Downlink or debug output holds the zero-copy slot - these frames are lost */
+        gen.busy = false;
+        gen.gen_skipped += frames;
+    }
+}
+
+void BenchGen_GetReport(BenchGen_Report_t *report)
+{
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    uint32_t frames, bytes, rejected, overrun;
+    uint32_t total = 0;
+    uint32_t seen = 0;
+    static const uint8_t pct[3] = { 50, 90, 99 };
+    uint8_t p = 0;
+
+    MavlinkBridge_GetStats(&frames, &bytes, &rejected);
+    UART_DMA_GetOverrun(gen.uart, NULL, &overrun);
+
+    report->ms = HAL_GetTick() - gen.start;
+    report->rate = gen.rate;
+    report->gen_frames = gen.gen_frames;
+    report->gen_bytes = gen.gen_bytes;
+    report->gen_skipped = gen.gen_skipped;
+    report->fwd_frames = frames - gen.base_frames;
+    report->fwd_bytes = bytes - gen.base_bytes;
+    report->rx_overrun = overrun - gen.base_overrun;
+    report->rejected = rejected - gen.base_rejected;
+    report->seq_lost = link->seq_lost - gen.base_link.seq_lost;
+    report->rate_dropped = link->rate_dropped - gen.base_link.rate_dropped;
+    report->deduped = link->deduped - gen.base_link.deduped;
+    report->publish_lost = link->publish_lost - gen.base_link.publish_lost;
+
+    /* Percentiles from the run's share of the histogram: bucket i < 2^(i+1) ms */
+    for (uint8_t i = 0; i < BRIDGE_LAT_BUCKETS; i++) {
+        total += link->latency[i] - gen.base_link.latency[i];
+    }
+    memset(report->lat_ms, 0, sizeof(report->lat_ms));
+    for (uint8_t i = 0; i < BRIDGE_LAT_BUCKETS && total > 0; i++) {
+        seen += link->latency[i] - gen.base_link.latency[i];
+        while (p < 3 && (uint64_t)seen * 100U >= (uint64_t)total * pct[p]) {
+            report->lat_ms[p++] = 2UL << i;
+        }
+    }
+}
+
+#endif /* BENCH_BRIDGE */
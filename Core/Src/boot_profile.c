@@ -0,0 +1,76 @@
+/**
+ * @file    boot_profile.c
+ * @brief   Boot-time profile: reset to the first MAVLink frame delivered
+ * @version 1.0
+ */
+
+#include "boot_profile.h"
+
+#define BOOT_MAGIC      0x424F4F54U     /* "BOOT" */
+
+/**
+ * @brief Record kept across resets (not cleared by the C startup)
+ */
+typedef struct {
+    uint32_t magic;
+    volatile uint32_t ms[BOOT_MARKS];
+} Boot_Record_t;
+
+#define BOOT_RECORD     ((Boot_Record_t *)BOOT_PROFILE_ADDR)
+
+static struct {
+    bool valid;
+    uint8_t mark;
+    uint32_t ms;
+} prev;
+
+/* ==================== Public Functions ==================== */
+
+void BootProfile_Start(void)
+{
+    Boot_Record_t *rec = BOOT_RECORD;
+    
+    /* A power-on leaves random contents: the magic tells a record from noise. The
+     * last milestone reached is the highest one set - they come in order */
+    prev.valid = false;
+    if (rec->magic == BOOT_MAGIC && rec->ms[BOOT_MARK_FRAME] == BOOT_PROFILE_UNSET) {
+        for (uint8_t i = BOOT_MARKS; i-- > 0;) {
+            if (rec->ms[i] != BOOT_PROFILE_UNSET) {
+                prev.valid = true;
+                prev.mark = i;
+                prev.ms = rec->ms[i];
+                break;
+            }
+        }
+    }
+    
+    rec->magic = BOOT_MAGIC;
+    for (uint8_t i = 0; i < BOOT_MARKS; i++) {
+        rec->ms[i] = BOOT_PROFILE_UNSET;
+    }
+    rec->ms[BOOT_MARK_HAL] = HAL_GetTick();
+}
+
+void BootProfile_Mark(BootProfile_Mark_t mark)
+{
+    Boot_Record_t *rec = BOOT_RECORD;
+    
+    if (mark < BOOT_MARKS && rec->ms[mark] == BOOT_PROFILE_UNSET) {
+        rec->ms[mark] = HAL_GetTick();
+    }
+}
+
+const uint32_t *BootProfile_Get(void)
+{
+    return (const uint32_t *)BOOT_RECORD->ms;
+}
+
+bool BootProfile_GetPrevious(BootProfile_Mark_t *mark, uint32_t *ms)
+{
+    if (!prev.valid) {
+        return false;
+    }
+    *mark = (BootProfile_Mark_t)prev.mark;
+    *ms = prev.ms;
+    return true;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file    carrier.c
+ * @brief   Carrier profiles: APN, PDP authentication and radio access per home network
+ * @version 1.0
+ */
+
+#include "carrier.h"
+#include "a7600_mqtt.h"
+#include <string.h>
+
+/* Known networks - the longest matching prefix wins, so a 3-digit MNC can sit next to its 2-digit MCC peers */
+static const Carrier_Profile_t carriers[] = {
+    { "45201", "MobiFone",     "m-wap",      "mms", "mms", CARRIER_AUTH_PAP,  0 },
+    { "45202", "VinaPhone",    "m3-world",   "mms", "mms", CARRIER_AUTH_PAP,  0 },
+    { "45204", "Viettel",      "v-internet", NULL,  NULL,  CARRIER_AUTH_NONE, 0 },
+    { "45205", "Vietnamobile", "internet",   NULL,  NULL,  CARRIER_AUTH_NONE, 0 },
+};
+
+static const Carrier_Profile_t carrier_default = { "", "default", A7600_APN, NULL, NULL, CARRIER_AUTH_NONE, 0 };
+
+const Carrier_Profile_t *Carrier_Find(const char *imsi)
+{
+    const Carrier_Profile_t *best = &carrier_default;
+    size_t best_len = 0;
+    
+    for (size_t i = 0; i < sizeof(carriers) / sizeof(carriers[0]); i++) {
+        size_t n = strlen(carriers[i].plmn);
+        
+        if (n > best_len && strncmp(imsi, carriers[i].plmn, n) == 0) {
+            best = &carriers[i];
+            best_len = n;
+        }
+    }
+    return best;
+}
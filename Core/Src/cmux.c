@@ -0,0 +1,452 @@
+/**
+ * @file    cmux.c
+ * @brief   GSM 07.10 (3GPP TS 27.010) basic-option multiplexer on the modem UART
+ * @version 1.0
+ */
+
+#include "cmux.h"
+#include <string.h>
+
+#if UART_DMA_FRAMING
+
+/* Frame fields (27.010 5.2) */
+#define CMUX_FLAG       0xF9
+#define CMUX_EA         0x01    /* Last byte of a field */
+#define CMUX_CR         0x02    /* Command from us (the initiator), response from the module */
+#define CMUX_PF         0x10    /* Poll / final */
+#define CMUX_SABM       0x2F
+#define CMUX_UA         0x63
+#define CMUX_DM         0x0F
+#define CMUX_DISC       0x43
+#define CMUX_UIH        0xEF
+#define CMUX_UI         0x03
+#define CMUX_FCS_GOOD   0xCF    /* FCS run over the checked bytes and the FCS itself */
+#define CMUX_RAW        0xFF    /* tx_dlc: the write is a whole frame already */
+
+/* Control channel messages (27.010 5.4.6.3): type byte without C/R */
+#define MSG_CLD         0xC1    /* Close down the multiplexer */
+#define MSG_MSC         0xE1    /* Modem status (V.24 signals of a DLC) */
+#define MSC_SIGNALS     0x8D    /* RTC, RTR, DV, EA: ready, data valid */
+
+/* Deframer states */
+enum {
+    RX_HUNT = 0,        /* Outside a frame */
+    RX_ADDR,            /* Opening flag seen */
+    RX_CTRL,
+    RX_LEN,
+    RX_LEN2,
+    RX_DATA,
+    RX_FCS,
+    RX_END              /* Closing flag expected */
+};
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Add a byte to the FCS (CRC-8, x^8 + x^2 + x + 1 reflected, from 0xFF)
+ */
+static uint8_t fcs_add(uint8_t fcs, uint8_t byte)
+{
+    fcs ^= byte;
+    for (uint8_t i = 0; i < 8; i++) {
+        fcs = (fcs & 1) ? (uint8_t)((fcs >> 1) ^ 0xE0) : (uint8_t)(fcs >> 1);
+    }
+    return fcs;
+}
+
+/**
+ * @brief Address, control and length of a frame, and the FCS over them
+ * @return Header bytes written to head (from the address on)
+ */
+static uint8_t frame_header(uint8_t dlc, uint8_t ctrl, size_t len, uint8_t *head, uint8_t *fcs)
+{
+    uint8_t n = 0;
+    
+    head[n++] = (uint8_t)((dlc << 2) | CMUX_CR | CMUX_EA);
+    head[n++] = ctrl;
+    if (len <= 0x7F) {
+        head[n++] = (uint8_t)((len << 1) | CMUX_EA);
+    } else {
+        head[n++] = (uint8_t)(len << 1);
+        head[n++] = (uint8_t)(len >> 7);
+    }
+    *fcs = 0xFF;
+    for (uint8_t i = 0; i < n; i++) {
+        *fcs = fcs_add(*fcs, head[i]);
+    }
+    *fcs = (uint8_t)(0xFF - *fcs);
+    return n;
+}
+
+/**
+ * @brief UART framer: every write on the current channel goes in a UIH frame
+ */
+static bool cmux_frame(void *ctx, size_t len, UART_DMA_Frame_t *frame)
+{
+    Cmux_t *mux = (Cmux_t *)ctx;
+    uint8_t fcs;
+    
+    if (mux->tx_dlc == CMUX_RAW) {
+        return false;
+    }
+    frame->head[0] = CMUX_FLAG;
+    frame->head_len = (uint8_t)(1 + frame_header(mux->tx_dlc, CMUX_UIH, len, &frame->head[1], &fcs));
+    frame->tail[0] = fcs;
+    frame->tail[1] = CMUX_FLAG;
+    frame->tail_len = 2;
+    return true;
+}
+
+/**
+ * @brief Queue a whole frame of ours (SABM, control messages)
+ */
+static bool send_frame(Cmux_t *mux, uint8_t dlc, uint8_t ctrl, const uint8_t *data, uint8_t len)
+{
+    uint8_t frame[1 + 4 + CMUX_CTL_MAX + 2];
+    uint8_t fcs;
+    uint8_t n = 1;
+    bool sent;
+    
+    frame[0] = CMUX_FLAG;
+    n += frame_header(dlc, ctrl, len, &frame[1], &fcs);
+    memcpy(&frame[n], data, len);
+    n += len;
+    frame[n++] = fcs;
+    frame[n++] = CMUX_FLAG;
+    mux->tx_dlc = CMUX_RAW;
+    sent = (UART_DMA_Transmit(mux->uart, frame, n) == HAL_OK);
+    mux->tx_dlc = CMUX_DLC_AT;
+    return sent;
+}
+
+/**
+ * @brief Control channel message on DLC 0
+ * @param type Message type with C/R: set for a command, clear for a response
+ */
+static void send_msg(Cmux_t *mux, uint8_t type, const uint8_t *value, uint8_t len)
+{
+    uint8_t msg[2 + 2];
+    
+    msg[0] = type;
+    msg[1] = (uint8_t)((len << 1) | CMUX_EA);
+    memcpy(&msg[2], value, len);
+    send_frame(mux, 0, CMUX_UIH, msg, (uint8_t)(2 + len));
+}
+
+/**
+ * @brief Our V.24 signals for a channel: ready, data valid
+ */
+static void send_msc(Cmux_t *mux, uint8_t dlc, bool command)
+{
+    uint8_t value[2] = { (uint8_t)((dlc << 2) | CMUX_CR | CMUX_EA), MSC_SIGNALS };
+    
+    send_msg(mux, (uint8_t)(MSG_MSC | (command ? CMUX_CR : 0)), value, sizeof(value));
+}
+
+static void sabm(Cmux_t *mux, uint8_t dlc)
+{
+    mux->opening = dlc;
+    mux->tries++;
+    mux->tick = HAL_GetTick();
+    send_frame(mux, dlc, CMUX_SABM | CMUX_PF, NULL, 0);
+}
+
+/**
+ * @brief A whole frame with a good FCS
+ */
+static void frame_done(Cmux_t *mux)
+{
+    uint8_t dlc = (uint8_t)(mux->rx_addr >> 2);
+    uint8_t ctrl = (uint8_t)(mux->rx_ctrl & ~CMUX_PF);
+    
+    if (ctrl == CMUX_UA && mux->state == CMUX_OPENING && dlc == mux->opening) {
+        mux->open |= (uint8_t)(1u << dlc);
+        mux->tries = 0;
+        if (dlc > 0) {
+            send_msc(mux, dlc, true);
+        }
+        if (dlc + 1 < CMUX_DLCS) {
+            sabm(mux, (uint8_t)(dlc + 1));
+        } else {
+            mux->state = CMUX_OPEN;
+            mux->stats.opens++;
+        }
+    } else if (ctrl == CMUX_DM && mux->state == CMUX_OPENING && dlc == mux->opening) {
+        Cmux_Stop(mux);
+        mux->state = CMUX_FAILED;
+    } else if (ctrl == CMUX_DISC) {
+        /* The module closes a channel (DLC 0: the multiplexer) */
+        mux->open &= (uint8_t)~(1u << dlc);
+        send_frame(mux, dlc, CMUX_UA | CMUX_PF, NULL, 0);
+        if (dlc == 0 || mux->state == CMUX_OPEN) {
+            Cmux_Stop(mux);
+        }
+    } else if (ctrl == CMUX_UIH && dlc == 0 && mux->rx_len >= 2) {
+        uint8_t type = mux->ctl[0];
+        
+        /* Its modem status commands are answered with the same value; the rest ignored */
+        if ((type & ~CMUX_CR) == MSG_MSC && (type & CMUX_CR) && mux->rx_len >= 4) {
+            send_msg(mux, MSG_MSC, &mux->ctl[2], 2);
+        } else if ((type & ~CMUX_CR) == MSG_CLD && (type & CMUX_CR)) {
+            send_msg(mux, MSG_CLD, NULL, 0);
+            Cmux_Stop(mux);
+        }
+    }
+}
+
+/**
+ * @brief Header byte - false if it cannot start / continue a frame
+ */
+static bool rx_header(Cmux_t *mux, uint8_t b)
+{
+    switch (mux->rx_state) {
+    case RX_ADDR:
+        if (!(b & CMUX_EA) || (b >> 2) >= CMUX_DLCS) {
+            return false;
+        }
+        mux->rx_addr = b;
+        mux->rx_fcs = fcs_add(0xFF, b);
+        mux->rx_state = RX_CTRL;
+        return true;
+    
+    case RX_CTRL:
+        switch (b & ~CMUX_PF) {
+        case CMUX_SABM: case CMUX_UA: case CMUX_DM: case CMUX_DISC: case CMUX_UIH: case CMUX_UI:
+            break;
+        default:
+            return false;
+        }
+        mux->rx_ctrl = b;
+        mux->rx_fcs = fcs_add(mux->rx_fcs, b);
+        mux->rx_state = RX_LEN;
+        return true;
+    
+    case RX_LEN:
+        mux->rx_len = (uint16_t)(b >> 1);
+        mux->rx_fcs = fcs_add(mux->rx_fcs, b);
+        if (!(b & CMUX_EA)) {
+            mux->rx_state = RX_LEN2;
+            return true;
+        }
+        break;
+    
+    default:    /* RX_LEN2 */
+        mux->rx_len |= (uint16_t)(b << 7);
+        mux->rx_fcs = fcs_add(mux->rx_fcs, b);
+        if (mux->rx_len > CMUX_N1) {
+            return false;
+        }
+        break;
+    }
+    mux->rx_left = mux->rx_len;
+    mux->rx_state = (mux->rx_len > 0) ? RX_DATA : RX_FCS;
+    return true;
+}
+
+/**
+ * @brief Information bytes of the frame: AT channel to out, the rest to the sink / ctl
+ * @return Bytes taken (fewer than len once out is full)
+ */
+static size_t rx_data(Cmux_t *mux, const uint8_t *data, size_t len, uint8_t *out, size_t room)
+{
+    uint8_t dlc = (uint8_t)(mux->rx_addr >> 2);
+    
+    if (len > mux->rx_left) {
+        len = mux->rx_left;
+    }
+    if (dlc == CMUX_DLC_AT) {
+        if (len > room) {
+            len = room;
+        }
+        memcpy(out, data, len);
+    } else if (dlc == 0) {
+        for (size_t i = 0; i < len; i++) {
+            size_t at = (size_t)(mux->rx_len - mux->rx_left) + i;
+            
+            if (at < CMUX_CTL_MAX) {
+                mux->ctl[at] = data[i];
+            }
+        }
+    } else if (mux->sink != NULL && len > 0) {
+        mux->sink(mux->sink_ctx, dlc, data, len);
+    }
+    if ((mux->rx_ctrl & ~CMUX_PF) == CMUX_UI) {
+        /* UI frames check their information too */
+        for (size_t i = 0; i < len; i++) {
+            mux->rx_fcs = fcs_add(mux->rx_fcs, data[i]);
+        }
+    }
+    mux->rx_left = (uint16_t)(mux->rx_left - len);
+    if (mux->rx_left == 0) {
+        mux->rx_state = RX_FCS;
+    }
+    return len;
+}
+
+/**
+ * @brief Run the deframer over a span of the ring
+ * @return Bytes of the span used (fewer once out is full)
+ */
+static size_t rx_span(Cmux_t *mux, const uint8_t *data, size_t len, uint8_t *out, size_t room, size_t *taken)
+{
+    size_t i = 0;
+    
+    while (i < len) {
+        uint8_t b = data[i];
+        
+        if (mux->rx_state == RX_DATA) {
+            size_t n = rx_data(mux, &data[i], len - i, &out[*taken], room - *taken);
+            
+            if ((mux->rx_addr >> 2) == CMUX_DLC_AT) {
+                *taken += n;
+            }
+            if (n == 0) {
+                break;          /* out is full */
+            }
+            i += n;
+            continue;
+        }
+        
+        switch (mux->rx_state) {
+        case RX_HUNT:
+            if (b == CMUX_FLAG) {
+                mux->rx_state = RX_ADDR;
+            } else if (*taken < room) {
+                out[(*taken)++] = b;    /* Plain text: the module is not multiplexing */
+                mux->stats.plain++;
+            } else {
+                return i;
+            }
+            break;
+        
+        case RX_FCS:
+            mux->rx_fcs = fcs_add(mux->rx_fcs, b);
+            mux->rx_state = RX_END;
+            break;
+        
+        case RX_END:
+            if (b == CMUX_FLAG && mux->rx_fcs == CMUX_FCS_GOOD) {
+                mux->stats.frames++;
+                frame_done(mux);
+                mux->rx_state = RX_ADDR;    /* The closing flag may open the next frame */
+            } else {
+                mux->stats.bad++;
+                mux->rx_state = (b == CMUX_FLAG) ? RX_ADDR : RX_HUNT;
+            }
+            break;
+        
+        default:
+            if (b == CMUX_FLAG && mux->rx_state == RX_ADDR) {
+                break;                      /* Flags between frames */
+            }
+            if (!rx_header(mux, b)) {
+                mux->rx_state = (b == CMUX_FLAG) ? RX_ADDR : RX_HUNT;
+            }
+            break;
+        }
+        i++;
+    }
+    return i;
+}
+
+/* ==================== Public Functions ==================== */
+
+void Cmux_Init(Cmux_t *mux, UART_DMA_Handle_t *uart, Cmux_SinkFn_t sink, void *ctx)
+{
+    memset(mux, 0, sizeof(*mux));
+    mux->uart = uart;
+    mux->sink = sink;
+    mux->sink_ctx = ctx;
+    mux->tx_dlc = CMUX_DLC_AT;
+}
+
+void Cmux_Start(Cmux_t *mux)
+{
+    mux->state = CMUX_OPENING;
+    mux->open = 0;
+    mux->tries = 0;
+    mux->rx_state = RX_HUNT;
+    UART_DMA_SetFramer(mux->uart, cmux_frame, mux, CMUX_N1);
+    sabm(mux, 0);
+}
+
+void Cmux_Process(Cmux_t *mux)
+{
+    if (mux->state != CMUX_OPENING || HAL_GetTick() - mux->tick < CMUX_T1) {
+        return;
+    }
+    if (mux->tries < CMUX_N2) {
+        sabm(mux, mux->opening);
+    } else {
+        Cmux_Stop(mux);
+        mux->state = CMUX_FAILED;
+    }
+}
+
+void Cmux_Stop(Cmux_t *mux)
+{
+    UART_DMA_SetFramer(mux->uart, NULL, NULL, 0);
+    mux->state = CMUX_OFF;
+    mux->open = 0;
+    mux->rx_state = RX_HUNT;
+}
+
+void Cmux_Close(Cmux_t *mux)
+{
+    send_msg(mux, MSG_CLD | CMUX_CR, NULL, 0);
+    Cmux_Stop(mux);
+}
+
+bool Cmux_IsOpen(const Cmux_t *mux)
+{
+    return (mux->state == CMUX_OPEN);
+}
+
+Cmux_State_t Cmux_GetState(const Cmux_t *mux)
+{
+    return mux->state;
+}
+
+bool Cmux_Write(Cmux_t *mux, uint8_t dlc, const uint8_t *data, size_t len)
+{
+    bool sent;
+    
+    if (!(mux->open & (1u << dlc))) {
+        return false;
+    }
+    mux->tx_dlc = dlc;
+    sent = (UART_DMA_Transmit(mux->uart, data, len) == HAL_OK);
+    mux->tx_dlc = CMUX_DLC_AT;
+    return sent;
+}
+
+size_t Cmux_Read(Cmux_t *mux, uint8_t *buf, size_t len)
+{
+    UART_DMA_Span_t span[2];
+    size_t taken = 0;
+    size_t used = 0;
+    
+    if (mux->state == CMUX_OFF || mux->state == CMUX_FAILED) {
+        return UART_DMA_Read(mux->uart, buf, len);
+    }
+    if (UART_DMA_Peek(mux->uart, &span[0], &span[1]) == 0) {
+        return 0;
+    }
+    for (uint8_t s = 0; s < 2; s++) {
+        size_t n = rx_span(mux, span[s].data, span[s].len, buf, len, &taken);
+        
+        used += n;
+        if (n < span[s].len) {
+            break;
+        }
+    }
+    UART_DMA_Consume(mux->uart, used);
+    return taken;
+}
+
+const Cmux_Stats_t *Cmux_GetStats(const Cmux_t *mux)
+{
+    return &mux->stats;
+}
+
+#endif /* UART_DMA_FRAMING */
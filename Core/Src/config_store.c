@@ -0,0 +1,285 @@
+/**
+ * @file    config_store.c
+ * @brief   Runtime configuration: key/value records in two flash pages
+ * @version 1.1
+ */
+
+#include "config_store.h"
+#include "nv_store.h"
+#include <string.h>
+
+#if CONFIG_STORE_ADDR + 2U * CONFIG_STORE_PAGE_SIZE > NV_STORE_ADDR
+#error "Config store overlaps nv_store"
+#endif
+
+#define CS_PAGE(p)      (CONFIG_STORE_ADDR + (uint32_t)(p) * CONFIG_STORE_PAGE_SIZE)
+#define CS_PTR(a)       ((const uint8_t *)(uintptr_t)(a))
+#define CS_HALF(a)      (*(const uint16_t *)(uintptr_t)(a))
+#define CS_WORD(a)      (*(const uint32_t *)(uintptr_t)(a))
+#define CS_HEADER       8U          /* magic, sequence */
+#define CS_FREE         0xFFFFU
+#define CS_SIZE(len)    (4U + (((uint32_t)(len) + 1U) & ~1U))
+
+static struct {
+    uint8_t page;       /* Active page */
+    bool valid;         /* It has a header */
+    bool clean;         /* Records end in erased flash - appends go at end */
+    uint16_t end;       /* Offset past the last record */
+} store;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief CRC-8 (poly 0x07) of a record's key, length and value
+ */
+static uint8_t cs_crc(uint16_t key, const uint8_t *value, uint8_t len)
+{
+    uint8_t head[3] = { (uint8_t)key, (uint8_t)(key >> 8), len };
+    uint8_t crc = 0;
+    
+    for (uint16_t i = 0; i < 3U + len; i++) {
+        crc ^= (i < 3) ? head[i] : value[i - 3];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Step over one record of a page (header only - see cs_ok)
+ * @param off In: offset of the record, out: offset of the next one
+ * @return false past the last record
+ */
+static bool cs_next(uint32_t base, uint16_t *off, uint16_t *key, uint8_t *len)
+{
+    if (*off + 4U > CONFIG_STORE_PAGE_SIZE || CS_HALF(base + *off) == CS_FREE) {
+        return false;
+    }
+    uint16_t meta = CS_HALF(base + *off + 2U);
+    
+    *key = CS_HALF(base + *off);
+    *len = (uint8_t)meta;
+    if (meta == CS_FREE || *off + CS_SIZE(*len) > CONFIG_STORE_PAGE_SIZE) {
+        return false;   /* Torn header - the caller sees the page as not clean */
+    }
+    *off = (uint16_t)(*off + CS_SIZE(*len));
+    return true;
+}
+
+/**
+ * @brief Check the CRC of a record (a torn write fails it)
+ */
+static bool cs_ok(uint32_t base, uint16_t off)
+{
+    uint16_t meta = CS_HALF(base + off + 2U);
+    
+    return (cs_crc(CS_HALF(base + off), CS_PTR(base + off + 4U), (uint8_t)meta) == (uint8_t)(meta >> 8));
+}
+
+/**
+ * @brief Offset of the current record of a key in a page (0: none)
+ * @param from Offset to search from (CS_HEADER: the whole page)
+ */
+static uint16_t cs_find(uint32_t base, uint16_t key, uint16_t from)
+{
+    uint16_t off = from, at = 0;
+    uint16_t k;
+    uint8_t len;
+    
+    for (uint16_t rec = off; cs_next(base, &off, &k, &len); rec = off) {
+        if (k == key && cs_ok(base, rec)) {
+            at = rec;
+        }
+    }
+    return at;
+}
+
+/**
+ * @brief Program a record at an offset of a page (flash unlocked)
+ */
+static HAL_StatusTypeDef cs_program(uint32_t base, uint16_t off, uint16_t key, const uint8_t *value, uint8_t len)
+{
+    uint32_t addr = base + off;
+    HAL_StatusTypeDef status;
+    
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr, key);
+    if (status == HAL_OK) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + 2U,
+                                   (uint16_t)(len | (cs_crc(key, value, len) << 8)));
+    }
+    for (uint8_t i = 0; status == HAL_OK && i < len; i += 2) {
+        uint16_t half = (uint16_t)(value[i] | ((i + 1 < len ? value[i + 1] : 0xFF) << 8));
+        
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + 4U + i, half);
+    }
+    return status;
+}
+
+/**
+ * @brief Copy the live records to the other page, leaving out one key (flash unlocked)
+ */
+static HAL_StatusTypeDef cs_compact(uint16_t skip)
+{
+    uint8_t to = store.valid ? (uint8_t)(store.page ^ 1U) : 0;
+    uint32_t from_base = CS_PAGE(store.page);
+    uint32_t base = CS_PAGE(to);
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error;
+    HAL_StatusTypeDef status;
+    uint16_t off = CS_HEADER, end = CS_HEADER;
+    uint16_t key;
+    uint8_t len;
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = base;
+    erase.NbPages = 1;
+    status = HAL_FLASHEx_Erase(&erase, &error);
+    if (status == HAL_OK) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, base + 4U,
+                                   store.valid ? CS_WORD(from_base + 4U) + 1U : 0);
+    }
+    
+    /* Current values only; deleted keys end here */
+    for (uint16_t rec = off; store.valid && status == HAL_OK && cs_next(from_base, &off, &key, &len); rec = off) {
+        if (len == 0 || key == skip || cs_find(from_base, key, rec) != rec) {
+            continue;
+        }
+        status = cs_program(base, end, key, CS_PTR(from_base + rec + 4U), len);
+        end = (uint16_t)(end + CS_SIZE(len));
+    }
+    
+    /* Valid only once complete; a reset before the erase below leaves both, the newer one wins */
+    if (status == HAL_OK) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, base, CONFIG_STORE_MAGIC);
+    }
+    if (status != HAL_OK) {
+        return status;
+    }
+    if (store.valid) {
+        erase.PageAddress = from_base;
+        HAL_FLASHEx_Erase(&erase, &error);
+    }
+    store.page = to;
+    store.valid = true;
+    store.clean = true;
+    store.end = end;
+    return HAL_OK;
+}
+
+/* ==================== Public Functions ==================== */
+
+void ConfigStore_Init(void)
+{
+    bool valid0 = (CS_WORD(CS_PAGE(0)) == CONFIG_STORE_MAGIC);
+    bool valid1 = (CS_WORD(CS_PAGE(1)) == CONFIG_STORE_MAGIC);
+    uint16_t off = CS_HEADER;
+    uint16_t key;
+    uint8_t len;
+    
+    store.valid = valid0 || valid1;
+    store.page = (valid1 && (!valid0 || (int32_t)(CS_WORD(CS_PAGE(1) + 4U) - CS_WORD(CS_PAGE(0) + 4U)) > 0)) ? 1 : 0;
+    store.clean = false;
+    store.end = CS_HEADER;
+    if (!store.valid) {
+        return;
+    }
+    
+    while (cs_next(CS_PAGE(store.page), &off, &key, &len)) {
+    }
+    store.end = off;
+    store.clean = (off + 2U > CONFIG_STORE_PAGE_SIZE || CS_HALF(CS_PAGE(store.page) + off) == CS_FREE);
+}
+
+const uint8_t *ConfigStore_Get(uint16_t key, uint8_t *len)
+{
+    uint32_t base = CS_PAGE(store.page);
+    uint16_t at;
+    
+    if (!store.valid || (at = cs_find(base, key, CS_HEADER)) == 0) {
+        return NULL;
+    }
+    *len = (uint8_t)CS_HALF(base + at + 2U);
+    return (*len != 0) ? CS_PTR(base + at + 4U) : NULL;
+}
+
+bool ConfigStore_GetString(uint16_t key, char *buf, size_t size)
+{
+    uint8_t len;
+    const uint8_t *value = ConfigStore_Get(key, &len);
+    
+    if (value == NULL || len >= size) {
+        return false;
+    }
+    memcpy(buf, value, len);
+    buf[len] = '\0';
+    return true;
+}
+
+const char *ConfigStore_GetText(uint16_t key)
+{
+    uint8_t len;
+    const uint8_t *value = ConfigStore_Get(key, &len);
+    
+    if (value == NULL || len == 0 || value[len - 1] != '\0') {
+        return NULL;
+    }
+    return (const char *)value;
+}
+
+bool ConfigStore_GetU32(uint16_t key, uint32_t *value)
+{
+    uint8_t len;
+    const uint8_t *v = ConfigStore_Get(key, &len);
+    
+    if (v == NULL || len != 4) {
+        return false;
+    }
+    *value = (uint32_t)v[0] | ((uint32_t)v[1] << 8) | ((uint32_t)v[2] << 16) | ((uint32_t)v[3] << 24);
+    return true;
+}
+
+void ConfigStore_ForEach(uint16_t first, uint16_t last, ConfigStore_VisitFn_t fn, void *ctx)
+{
+    uint32_t base = CS_PAGE(store.page);
+    uint16_t off = CS_HEADER;
+    uint16_t key;
+    uint8_t len;
+    
+    /* Later records of a key replace earlier ones: a record counts if none follows */
+    for (uint16_t rec = off; store.valid && cs_next(base, &off, &key, &len); rec = off) {
+        if (len != 0 && key >= first && key <= last && cs_find(base, key, rec) == rec) {
+            fn(key, CS_PTR(base + rec + 4U), len, ctx);
+        }
+    }
+}
+
+HAL_StatusTypeDef ConfigStore_Set(uint16_t key, const void *value, uint8_t len)
+{
+    const uint8_t *current;
+    uint8_t current_len = 0;
+    HAL_StatusTypeDef status = HAL_OK;
+    
+    if (key == 0 || key == CS_FREE || len > CONFIG_VALUE_MAX) {
+        return HAL_ERROR;
+    }
+    current = ConfigStore_Get(key, &current_len);
+    if ((current == NULL && len == 0) ||
+        (current != NULL && current_len == len && memcmp(current, value, len) == 0)) {
+        return HAL_OK;  /* Unchanged - spare the page */
+    }
+    
+    HAL_FLASH_Unlock();
+    if (!store.valid || !store.clean || store.end + CS_SIZE(len) > CONFIG_STORE_PAGE_SIZE) {
+        status = cs_compact(key);   /* The new value goes in after the copies */
+    }
+    if (status == HAL_OK && store.end + CS_SIZE(len) > CONFIG_STORE_PAGE_SIZE) {
+        status = HAL_ERROR;         /* Full of live values */
+    }
+    if (status == HAL_OK) {
+        status = cs_program(CS_PAGE(store.page), store.end, key, (const uint8_t *)value, len);
+        store.end = (uint16_t)(store.end + CS_SIZE(len));
+    }
+    HAL_FLASH_Lock();
+    return status;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file    crc32.c
+ * @brief   CRC-32 (IEEE, as zlib) on the STM32F0 CRC unit, DMA-fed for large blocks
+ * @version 1.0
+ */
+
+#include "crc32.h"
+#include "mem_dma.h"
+#include "scheduler.h"
+
+#define CRC_DR8             (*(__IO uint8_t *)&CRC->DR)     /* Byte write: one byte into the unit */
+#define CRC_BY_BYTE         (CRC_CR_REV_IN_0 | CRC_CR_REV_OUT)
+#define CRC_BY_WORD         (CRC_CR_REV_IN | CRC_CR_REV_OUT)   /* A word's bytes in memory order */
+#define CRC_DMA_WORDS       0xFFFFU     /* CNDTR is 16 bits */
+
+Crc32_Stats_t crc32_stats;
+
+/* CRC-32 (IEEE, reflected), a nibble at a time */
+static const uint32_t crc_nibble[16] = {
+    0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU, 0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+    0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU, 0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+};
+
+#if CRC32_HW
+static volatile bool unit_busy;
+#endif
+
+/* ==================== Private Functions ==================== */
+
+static uint32_t crc_soft(uint32_t crc, const uint8_t *p, size_t len)
+{
+    crc = ~crc;
+    while (len-- > 0) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+#if CRC32_HW
+
+/**
+ * @brief Bit 0 to bit 31 and so on (the M0 has no RBIT)
+ */
+static uint32_t bit_reverse(uint32_t v)
+{
+    v = ((v >> 1) & 0x55555555U) | ((v & 0x55555555U) << 1);
+    v = ((v >> 2) & 0x33333333U) | ((v & 0x33333333U) << 2);
+    v = ((v >> 4) & 0x0F0F0F0FU) | ((v & 0x0F0F0F0FU) << 4);
+    return __REV(v);
+}
+
+/**
+ * @brief Words into the unit by DMA1 channel 1, memory to "peripheral" CRC->DR; the core polls
+ */
+static void dma_feed(const uint32_t *w, size_t words)
+{
+    while (words > 0) {
+        uint32_t n = (words > CRC_DMA_WORDS) ? CRC_DMA_WORDS : (uint32_t)words;
+        
+        DMA1_Channel1->CCR = 0;
+        DMA1_Channel1->CPAR = (uintptr_t)&CRC->DR;
+        DMA1_Channel1->CMAR = (uintptr_t)w;
+        DMA1_Channel1->CNDTR = n;
+        DMA1->IFCR = DMA_IFCR_CGIF1;
+        DMA1_Channel1->CCR = DMA_CCR_MEM2MEM | DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 |
+                             DMA_CCR_EN;
+        while (!(DMA1->ISR & (DMA_ISR_TCIF1 | DMA_ISR_TEIF1))) {
+        }
+        DMA1_Channel1->CCR = 0;
+        DMA1->IFCR = DMA_IFCR_CGIF1;
+        w += n;
+        words -= n;
+    }
+}
+
+/**
+ * @brief The unit from a running value: odd bytes by the core, whole words by the core or DMA
+ * @note  The DMA only if the channel is free (a MemDma_Move may have it)
+ */
+static uint32_t crc_unit(uint32_t crc, const uint8_t *p, size_t len, bool dma)
+{
+    CRC->INIT = bit_reverse(~crc);      /* The unit's register runs unreflected */
+    CRC->CR = CRC_BY_BYTE | CRC_CR_RESET;
+    while (len > 0 && ((uintptr_t)p & 3U) != 0) {
+        CRC_DR8 = *p++;
+        len--;
+    }
+    if (len >= 4) {
+        const uint32_t *w = (const uint32_t *)p;
+        size_t words = len / 4;
+        
+        CRC->CR = CRC_BY_WORD;
+        if (dma && MemDma_Claim()) {
+            dma_feed(w, words);
+            MemDma_Release();
+        } else {
+            for (size_t i = 0; i < words; i++) {
+                CRC->DR = w[i];
+            }
+        }
+        CRC->CR = CRC_BY_BYTE;
+        p += words * 4;
+        len -= words * 4;
+    }
+    while (len-- > 0) {
+        CRC_DR8 = *p++;
+    }
+    return ~CRC->DR;
+}
+
+#endif /* CRC32_HW */
+
+/* ==================== Public Functions ==================== */
+
+void Crc32_Init(void)
+{
+#if CRC32_HW
+    const uint8_t *block = (const uint8_t *)FLASH_BASE;
+    uint32_t start, want, cpu, dma;
+    
+    __HAL_RCC_CRC_CLK_ENABLE();
+    
+    start = Sched_Cycles();
+    want = crc_soft(0, block, CRC32_TEST_LEN);
+    crc32_stats.sw_cycles = Sched_Cycles() - start;
+    
+    start = Sched_Cycles();
+    cpu = crc_unit(0, block, CRC32_TEST_LEN, false);
+    crc32_stats.hw_cycles = Sched_Cycles() - start;
+    
+    start = Sched_Cycles();
+    dma = crc_unit(0, block, CRC32_TEST_LEN, true);
+    crc32_stats.dma_cycles = Sched_Cycles() - start;
+    
+    crc32_stats.hw = (cpu == want && dma == want);
+#endif
+}
+
+uint32_t Crc32_Update(uint32_t crc, const void *data, size_t len)
+{
+#if CRC32_HW
+    uint32_t primask = __get_PRIMASK();
+    bool mine;
+    
+    /* One user at a time: a call in between (interrupt, other thread) takes the table */
+    __disable_irq();
+    mine = crc32_stats.hw && !unit_busy;
+    unit_busy = unit_busy || mine;
+    __set_PRIMASK(primask);
+    
+    if (mine) {
+        crc = crc_unit(crc, (const uint8_t *)data, len, len >= CRC32_DMA_MIN);
+        unit_busy = false;
+        return crc;
+    }
+#endif
+    return crc_soft(crc, (const uint8_t *)data, len);
+}
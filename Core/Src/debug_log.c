@@ -4,52 +4,444 @@
  */
 
 #include "debug_log.h"
+#include "uart_dma.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 
 #ifdef DEBUG_ENABLE
 
-/* External handles from main.c */
-extern UART_HandleTypeDef huart1;
+/* Telemetry handle from main.c - UART debug output shares USART1 */
+extern UART_DMA_Handle_t telem_uart;
 
 /* Config */
-#define DEBUG_UART      &huart1
-#define LOG_BUFFER_SIZE 512
+#define DEBUG_UART          (&telem_uart)
+#define LOG_RING_SIZE       256     /* Power of two */
+#define LOG_DOWN_SIZE       16      /* RTT down channel: one level line */
+#define LOG_LINE_MAX        128     /* Longer records are truncated */
+#define LOG_RING_MASK       (LOG_RING_SIZE - 1)
+#define LOG_FILE_ID         8
+#define LOG_MODULE          LOG_MOD_APP
 
-static char log_buffer[LOG_BUFFER_SIZE];
-static volatile bool tx_busy = false;
+/* Record layout (debug_log.h) */
+#define LOG_HDR_SIZE        6       /* sync, token, len, nargs, strmask */
+#define LOG_RAM_BASE        SRAM_BASE
+#define LOG_RAM_SIZE        0x2000U
 
-/* Prototype for internal TX complete callback wrapper if needed */
-void Debug_TxCpltCallback(UART_HandleTypeDef *huart)
+#if !UART_DMA_IS_POW2(LOG_RING_SIZE)
+#error "LOG_RING_SIZE must be a power of two"
+#endif
+#if DEBUG_RTT && DEBUG_RTT_CAPTURE > 0 && !UART_DMA_IS_POW2(DEBUG_RTT_CAPTURE)
+#error "DEBUG_RTT_CAPTURE must be a power of two"
+#endif
+
+#if DEBUG_RTT
+
+/* SEGGER RTT layout - the probe locates the block by its id and reads/writes
+ * the offsets while the core runs. Target writes WrOff of up buffers and
+ * RdOff of down buffers, the probe the other two */
+typedef struct {
+    const char *sName;
+    char *pBuffer;
+    unsigned SizeOfBuffer;
+    volatile unsigned WrOff;
+    volatile unsigned RdOff;
+    unsigned Flags;                 /* 0: no block, skip what does not fit */
+} RTT_Buffer_t;
+
+typedef struct {
+    char acID[16];                  /* "SEGGER RTT" once set up */
+    int MaxNumUpBuffers;
+    int MaxNumDownBuffers;
+    RTT_Buffer_t aUp[1 + (DEBUG_RTT_CAPTURE > 0)];
+    RTT_Buffer_t aDown[1];
+} RTT_Control_t;
+
+RTT_Control_t _SEGGER_RTT;
+
+/* Up channel 0 storage - debug_log_ring[RdOff..WrOff) */
+char debug_log_ring[LOG_RING_SIZE];
+static char log_down[LOG_DOWN_SIZE];
+#if DEBUG_RTT_CAPTURE > 0
+static char log_capture[DEBUG_RTT_CAPTURE];
+#endif
+
+#else
+
+/* Line ring - oldest whole lines (records) are overwritten when full. Kept
+ * non-static so a debugger can dump it: data is debug_log_ring[tail..head) masked. */
+char debug_log_ring[LOG_RING_SIZE];
+static size_t log_head;             /* Write index (free-running) */
+static size_t log_tail;             /* Oldest unsent byte (free-running) */
+static volatile size_t log_sending; /* Bytes from log_tail the DMA reads in place (0: none) */
+
+#endif /* DEBUG_RTT */
+
+static char log_line[LOG_LINE_MAX];
+
+uint8_t debug_log_level[LOG_MOD_COUNT] = {
+    LOG_LEVEL_DEFAULT, LOG_LEVEL_DEFAULT, LOG_LEVEL_DEFAULT, LOG_LEVEL_DEFAULT, LOG_LEVEL_DEFAULT
+};
+
+/* Names for Debug_SetLevelName, by Log_Module_t and by level */
+static const char *const log_module_names[LOG_MOD_COUNT] = { "uart", "at", "mqtt", "bridge", "app" };
+static const char *const log_level_names[] = { "off", "error", "warn", "info" };
+
+#if DEBUG_RTT
+
+/**
+ * @brief Append one line / record to up channel 0, or drop it if it does not fit
+ */
+static void log_push(const char *data, size_t len)
 {
-    if (huart->Instance == USART1) {
-        tx_busy = false;
+    RTT_Buffer_t *up = &_SEGGER_RTT.aUp[0];
+    unsigned wr = up->WrOff;
+    unsigned rd = up->RdOff;
+    unsigned room = (rd > wr) ? rd - wr - 1 : LOG_RING_SIZE - 1 - (wr - rd);
+    
+    if (len > room) {
+        return;
+    }
+    size_t first = LOG_RING_SIZE - wr;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&debug_log_ring[wr], data, first);
+    memcpy(debug_log_ring, &data[first], len - first);
+    __DMB();    /* Data before the offset the probe polls */
+    up->WrOff = (wr + len) & LOG_RING_MASK;
+}
+
+/**
+ * @brief Set up the control block - the id goes last, so a probe scanning
+ *        RAM never finds a half-built block (and no copy of it sits in flash)
+ */
+static void log_rtt_init(void)
+{
+    static const char id[] = "SEGGER RTT";
+    RTT_Control_t *cb = &_SEGGER_RTT;
+    
+    memset(cb, 0, sizeof(*cb));
+    cb->MaxNumUpBuffers = sizeof(cb->aUp) / sizeof(cb->aUp[0]);
+    cb->MaxNumDownBuffers = 1;
+    cb->aUp[0].sName = "Log";
+    cb->aUp[0].pBuffer = debug_log_ring;
+    cb->aUp[0].SizeOfBuffer = LOG_RING_SIZE;
+#if DEBUG_RTT_CAPTURE > 0
+    cb->aUp[1].sName = "Capture";
+    cb->aUp[1].pBuffer = log_capture;
+    cb->aUp[1].SizeOfBuffer = DEBUG_RTT_CAPTURE;
+#endif
+    cb->aDown[0].sName = "Level";
+    cb->aDown[0].pBuffer = log_down;
+    cb->aDown[0].SizeOfBuffer = LOG_DOWN_SIZE;
+    __DMB();
+    for (size_t i = sizeof(id) - 1; i-- > 0; ) {
+        cb->acID[i] = id[i];
     }
 }
 
+#else
+
+/**
+ * @brief Drop oldest data (up to a line start) until len bytes fit
+ * @return false if the bytes that would go are still being sent
+ */
+static bool log_make_room(size_t len)
+{
+    if (LOG_RING_SIZE - (log_head - log_tail) >= len) {
+        return true;
+    }
+    if (log_sending != 0) {
+        return false;
+    }
+    while (LOG_RING_SIZE - (log_head - log_tail) < len) {
+#if DEBUG_TOKENS
+        /* Evict up to the next sync byte; a record cut short there (one half
+         * sent, or a sync value in its arguments) fails the host's checksum */
+        do {
+            log_tail++;
+        } while (log_tail != log_head && (uint8_t)debug_log_ring[log_tail & LOG_RING_MASK] != LOG_SYNC);
+#else
+        /* Evict one whole line so the reader never starts mid-line */
+        while (log_tail != log_head) {
+            char c = debug_log_ring[log_tail & LOG_RING_MASK];
+            log_tail++;
+            if (c == '\n') {
+                break;
+            }
+        }
+#endif
+    }
+    return true;
+}
+
+/**
+ * @brief Append one line / record to the ring (at most two pieces) - no UART
+ *        access here. One that would overwrite bytes the DMA is still reading is dropped
+ */
+static void log_push(const char *data, size_t len)
+{
+    if (!log_make_room(len)) {
+        return;
+    }
+    size_t offset = log_head & LOG_RING_MASK;
+    size_t first = LOG_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&debug_log_ring[offset], data, first);
+    memcpy(debug_log_ring, &data[first], len - first);
+    log_head += len;
+}
+
+/**
+ * @brief Zero-copy send of a ring span finished (ISR) - its bytes may be reused
+ */
+static void log_sent(void *ctx)
+{
+    (void)ctx;
+    log_tail += log_sending;
+    log_sending = 0;
+}
+
+#endif /* DEBUG_RTT */
+
 void Debug_Init(void)
 {
-    /* UART1 is already initialized in main.c, just ensuring state */
-    tx_busy = false;
+#if DEBUG_RTT
+    log_rtt_init();
+#else
+    /* UART1 is initialized in main.c; output starts once telem_uart is up */
+    log_head = 0;
+    log_tail = 0;
+    log_sending = 0;
+#endif
     LOG_INFO("Debug Logging Initialized");
 }
 
+#if DEBUG_TOKENS
+
+void Debug_LogT(uint16_t token, uint8_t nargs, ...)
+{
+    uint8_t *rec = (uint8_t *)log_line;
+    size_t len = LOG_HDR_SIZE;
+    uint8_t mask = 0;
+    uint8_t sum = 0;
+    va_list args;
+    
+    if (nargs > LOG_ARGS_MAX) {
+        nargs = LOG_ARGS_MAX;
+    }
+    
+    /* Raw words - every argument promotes to 32 bits on the M0 */
+    va_start(args, nargs);
+    for (uint8_t i = 0; i < nargs; i++) {
+        uint32_t value = va_arg(args, uint32_t);
+        
+        memcpy(&rec[len], &value, sizeof(value));  /* Little endian, as on the wire */
+        len += sizeof(value);
+        if (value - LOG_RAM_BASE < LOG_RAM_SIZE) {
+            mask |= (uint8_t)(1U << i);
+        }
+    }
+    va_end(args);
+    
+    /* Strings in RAM go along (a RAM-range number copies a few bytes for nothing) */
+    for (uint8_t i = 0; i < nargs; i++) {
+        uint32_t addr;
+        size_t n = 0;
+        
+        if ((mask & (1U << i)) == 0) {
+            continue;
+        }
+        if (len + 2 > LOG_LINE_MAX) {
+            mask &= (uint8_t)((1U << i) - 1U);  /* No room for its length and the sum: sent as numbers */
+            break;
+        }
+        memcpy(&addr, &rec[LOG_HDR_SIZE + 4U * i], sizeof(addr));
+        const char *s = (const char *)(uintptr_t)addr;
+        while (n < LOG_STR_MAX && len + 2 + n < LOG_LINE_MAX && addr + n - LOG_RAM_BASE < LOG_RAM_SIZE &&
+               s[n] != '\0') {
+            n++;
+        }
+        rec[len] = (uint8_t)n;
+        memcpy(&rec[len + 1], s, n);
+        len += 1 + n;
+    }
+    
+    rec[0] = LOG_SYNC;
+    rec[1] = (uint8_t)token;
+    rec[2] = (uint8_t)(token >> 8);
+    rec[3] = (uint8_t)(len - 4);
+    rec[4] = nargs;
+    rec[5] = mask;
+    for (size_t i = 1; i < len; i++) {
+        sum += rec[i];
+    }
+    rec[len++] = sum;
+    
+    log_push(log_line, len);
+}
+
+#else
+
 void Debug_Log(const char *fmt, ...)
 {
     va_list args;
     int len;
     
     va_start(args, fmt);
-    len = vsnprintf(log_buffer, LOG_BUFFER_SIZE, fmt, args);
+    len = vsnprintf(log_line, LOG_LINE_MAX, fmt, args);
     va_end(args);
 
-    if (len > 0) {
-        if (len > LOG_BUFFER_SIZE) len = LOG_BUFFER_SIZE;
+    if (len <= 0) {
+        return;
+    }
+    if (len >= LOG_LINE_MAX) {
+        len = LOG_LINE_MAX - 1;
+    }
+    log_push(log_line, (size_t)len);
+}
+
+#endif /* DEBUG_TOKENS */
+
+bool Debug_SetLevelName(const char *args)
+{
+    size_t n = strcspn(args, " ");
+    const char *level = &args[n];
+    int mod;
+    uint8_t lvl;
+    
+    if (*level != ' ') {
+        return false;
+    }
+    level++;
+    
+    for (lvl = 0; lvl < sizeof(log_level_names) / sizeof(log_level_names[0]); lvl++) {
+        if (strcmp(level, log_level_names[lvl]) == 0) {
+            break;
+        }
+    }
+    if (lvl == sizeof(log_level_names) / sizeof(log_level_names[0])) {
+        return false;
+    }
+    if (lvl > LOG_LEVEL_MAX) {
+        lvl = LOG_LEVEL_MAX;    /* Those calls are not compiled in */
+    }
+    
+    if (n == 3 && strncmp(args, "all", 3) == 0) {
+        memset(debug_log_level, lvl, sizeof(debug_log_level));
+        return true;
+    }
+    for (mod = 0; mod < LOG_MOD_COUNT; mod++) {
+        if (strlen(log_module_names[mod]) == n && strncmp(args, log_module_names[mod], n) == 0) {
+            debug_log_level[mod] = lvl;
+            return true;
+        }
+    }
+    return false;
+}
+
+#if DEBUG_RTT
+
+void Debug_Flush(void)
+{
+    RTT_Buffer_t *down = &_SEGGER_RTT.aDown[0];
+    char cmd[LOG_DOWN_SIZE];
+    unsigned rd = down->RdOff;
+    unsigned wr = down->WrOff;
+    size_t n = 0;
+    
+    /* Output needs nothing - the probe reads it. A level line is applied once
+     * its newline is in; one longer than the buffer can never complete */
+    while (rd != wr) {
+        char c = log_down[rd];
         
-        /* Use blocking transmit to avoid DMA conflicts with MAVLink/UART_DMA wrapper */
-        HAL_UART_Transmit(DEBUG_UART, (uint8_t*)log_buffer, len, 1000);
+        rd = (rd + 1 == LOG_DOWN_SIZE) ? 0 : rd + 1;
+        if (c == '\n' || c == '\r') {
+            cmd[n] = '\0';
+            down->RdOff = rd;
+            if (n != 0 && !Debug_SetLevelName(cmd)) {
+                LOG_WARN("RTT: bad level line");
+            }
+            return;
+        }
+        if (n == sizeof(cmd) - 1) {
+            down->RdOff = rd;   /* Too long - drop it */
+            return;
+        }
+        cmd[n++] = c;
     }
 }
 
+#if DEBUG_RTT_CAPTURE > 0
+
+/**
+ * @brief Copy into up channel 1 at wr, wrapping at its end
+ * @return Offset past the copy
+ */
+static unsigned capture_copy(unsigned wr, const void *src, size_t len)
+{
+    size_t first = DEBUG_RTT_CAPTURE - wr;
+    
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&log_capture[wr], src, first);
+    memcpy(log_capture, (const char *)src + first, len - first);
+    return (unsigned)((wr + len) & (DEBUG_RTT_CAPTURE - 1));
+}
+
+bool Debug_CaptureWrite(const void *head, size_t head_len, const void *data, size_t len)
+{
+    RTT_Buffer_t *up = &_SEGGER_RTT.aUp[1];
+    unsigned wr = up->WrOff;
+    unsigned rd = up->RdOff;
+    unsigned room = (rd > wr) ? rd - wr - 1 : DEBUG_RTT_CAPTURE - 1 - (wr - rd);
+    
+    if (up->pBuffer == NULL || head_len + len > room) {
+        return false;
+    }
+    wr = capture_copy(wr, head, head_len);
+    if (len > 0) {
+        wr = capture_copy(wr, data, len);
+    }
+    __DMB();    /* Data before the offset the probe polls */
+    up->WrOff = wr;
+    return true;
+}
+
+#endif /* DEBUG_RTT_CAPTURE */
+
+#else
+
+void Debug_Flush(void)
+{
+    /* Not started yet, a span still going out, or MAVLink traffic is queued - it has priority */
+    if (DEBUG_UART->tx_buffer == NULL || log_sending != 0 || UART_DMA_IsTxBusy(DEBUG_UART)) {
+        return;
+    }
+    
+    size_t pending = log_head - log_tail;
+    if (pending == 0) {
+        return;
+    }
+    
+    /* One contiguous span per call, sent from the ring itself (the USART1 TX
+     * ring copies nothing); the wrapped rest goes on the next pass */
+    size_t offset = log_tail & LOG_RING_MASK;
+    size_t span = LOG_RING_SIZE - offset;
+    if (span > pending) {
+        span = pending;
+    }
+    
+    log_sending = span;
+    if (UART_DMA_TransmitZC(DEBUG_UART, (const uint8_t *)&debug_log_ring[offset], span, log_sent, NULL) != HAL_OK) {
+        log_sending = 0;    /* Downlink frame took the zero-copy slot */
+    }
+}
+
+#endif /* DEBUG_RTT */
+
 #endif /* DEBUG_ENABLE */
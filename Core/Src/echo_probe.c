@@ -0,0 +1,133 @@
+/**
+ * @file    echo_probe.c
+ * @brief   Broker round trip from a timestamped publish to a topic we subscribe to
+ * @version 1.0
+ */
+
+#include "echo_probe.h"
+#include "mavlink_bridge.h"
+#include "debug_log.h"
+
+#define LOG_FILE_ID     11
+#define LOG_MODULE      LOG_MOD_APP
+
+/* Read in place by the metrics registry, built or not */
+EchoProbe_Stats_t echo_stats;
+
+#if ECHO_ENABLE
+
+static struct {
+    A7600_MQTT_Handle_t *mqtt;
+    bool out;               /* A probe is on its way */
+    bool queued;            /* ... sent with the driver busy */
+    uint16_t seq;
+    uint32_t sent;          /* When it went (or the last probe was due to) */
+    uint8_t count;          /* Samples in the ring */
+    uint8_t head;           /* Next slot */
+    uint16_t ring[ECHO_SAMPLES];
+    uint8_t payload[ECHO_PAYLOAD];  /* Read by the modem until accepted */
+} echo;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Percentiles and least of the ring, from a sorted copy
+ */
+static void echo_percentiles(void)
+{
+    uint16_t sorted[ECHO_SAMPLES];
+    
+    for (uint8_t i = 0; i < echo.count; i++) {
+        uint16_t v = echo.ring[i];
+        uint8_t j = i;
+        
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    echo_stats.min_ms = sorted[0];
+    echo_stats.p50_ms = sorted[(echo.count - 1) * 50U / 100U];
+    echo_stats.p90_ms = sorted[(echo.count - 1) * 90U / 100U];
+}
+
+/* ==================== Public Functions ==================== */
+
+void EchoProbe_Init(A7600_MQTT_Handle_t *mqtt)
+{
+    echo.mqtt = mqtt;
+    echo.out = false;
+    echo.count = 0;
+    echo.head = 0;
+    echo.sent = HAL_GetTick();
+}
+
+void EchoProbe_Process(void)
+{
+    uint32_t now = HAL_GetTick();
+    bool idle;
+    
+    if (echo.out) {
+        if (now - echo.sent >= ECHO_TIMEOUT) {
+            echo.out = false;
+            echo_stats.lost++;
+        }
+        return;
+    }
+    if (now - echo.sent < ECHO_INTERVAL || !A7600_MQTT_IsConnected(echo.mqtt)) {
+        return;
+    }
+    
+    /* Nothing of the bridge's in front - or it has waited an interval for that */
+    idle = !A7600_MQTT_IsBusy(echo.mqtt) && A7600_MQTT_PublishInFlight(echo.mqtt) == 0;
+    if (!idle && now - echo.sent < 2U * ECHO_INTERVAL) {
+        return;
+    }
+    echo.seq++;
+    echo.payload[0] = (uint8_t)echo.seq;
+    echo.payload[1] = (uint8_t)(echo.seq >> 8);
+    echo.payload[2] = (uint8_t)now;
+    echo.payload[3] = (uint8_t)(now >> 8);
+    echo.payload[4] = (uint8_t)(now >> 16);
+    echo.payload[5] = (uint8_t)(now >> 24);
+    if (A7600_MQTT_PublishAsync(echo.mqtt, ECHO_TOPIC, echo.payload, ECHO_PAYLOAD, MQTT_QOS_0,
+                                NULL, NULL) == MQTT_OK) {
+        echo.out = true;
+        echo.queued = !idle;
+        echo.sent = now;
+        echo_stats.sent++;
+    }
+}
+
+void EchoProbe_OnChunk(const char *topic, const uint8_t *data, size_t len, size_t offset, size_t total)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t rtt;
+    
+    (void)topic;
+    if (!echo.out || offset != 0 || len != ECHO_PAYLOAD || total != ECHO_PAYLOAD ||
+        ((uint16_t)data[0] | ((uint16_t)data[1] << 8)) != echo.seq) {
+        return;             /* Late, cut, or not ours */
+    }
+    rtt = now - echo.sent;
+    if (rtt > UINT16_MAX) {
+        rtt = UINT16_MAX;
+    }
+    echo.out = false;
+    echo_stats.received++;
+    echo_stats.last_ms = (uint16_t)rtt;
+    echo.ring[echo.head] = (uint16_t)rtt;
+    echo.head = (uint8_t)((echo.head + 1U) % ECHO_SAMPLES);
+    if (echo.count < ECHO_SAMPLES) {
+        echo.count++;
+    }
+    echo_percentiles();
+    if (!echo.queued) {
+        MavlinkBridge_RttSample((uint16_t)rtt, echo_stats.min_ms);
+    }
+    LOG_INFO("Echo: %lu ms (p50 %u, p90 %u)", (unsigned long)rtt, (unsigned)echo_stats.p50_ms,
+             (unsigned)echo_stats.p90_ms);
+}
+
+#endif /* ECHO_ENABLE */
@@ -0,0 +1,447 @@
+/**
+ * @file    link_profile.c
+ * @brief   Telemetry profiles (full / reduced / minimal / ground) switched from the link quality
+ *          and the autopilot's armed state
+ * @version 1.1
+ */
+
+#include "link_profile.h"
+#include "mavlink_bridge.h"
+#include "config_store.h"
+#include "debug_log.h"
+
+#define LOG_FILE_ID     12
+#define LOG_MODULE      LOG_MOD_APP
+
+/* Read in place by the metrics registry, built or not */
+LinkProfile_Stats_t profile_stats;
+
+#if PROFILE_ENABLE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROFILE_ENC_MAX 16          /* Longest encoding name, "+lz" in */
+
+/* Readings, in grading order (the first of two equal grades names the switch) */
+enum {
+    IN_RSRP = 0,
+    IN_SINR,
+    IN_BPS,
+    IN_LAT,
+    IN_COUNT
+};
+#define BY_CMD          IN_COUNT    /* Switched by "prof" */
+#define BY_NONE         (IN_COUNT + 1)
+#define BY_GROUND       (IN_COUNT + 2)  /* Autopilot on the ground */
+#define BY_FLIGHT       (IN_COUNT + 3)  /* ... armed or active again */
+
+static const char *const profile_names[PROFILE_COUNT] = { "full", "reduced", "minimal", "ground" };
+static const char *const profile_specs[PROFILE_COUNT] = {
+    PROFILE_SPEC_FULL, PROFILE_SPEC_REDUCED, PROFILE_SPEC_MINIMAL, PROFILE_SPEC_GROUND
+};
+static const char *const in_names[IN_COUNT + 4] = { "rsrp", "sinr", "bps", "lat", "cmd", "none", "ground", "flight" };
+
+/* Limits as "higher is better" - latency is graded negated */
+static const struct {
+    int32_t reduced;
+    int32_t minimal;
+    int32_t band;
+} limits[IN_COUNT] = {
+    { PROFILE_RSRP_REDUCED, PROFILE_RSRP_MINIMAL, PROFILE_RSRP_BAND },
+    { PROFILE_SINR_REDUCED, PROFILE_SINR_MINIMAL, PROFILE_SINR_BAND },
+    { PROFILE_BPS_REDUCED, PROFILE_BPS_MINIMAL, PROFILE_BPS_BAND },
+    { -PROFILE_LAT_REDUCED, -PROFILE_LAT_MINIMAL, PROFILE_LAT_BAND },
+};
+
+static struct {
+    A7600_MQTT_Handle_t *mqtt;
+    uint32_t tick;          /* Last reading */
+    int32_t value[IN_COUNT];    /* ... its values */
+    uint8_t have;           /* ... which of them there were (bit per IN_x) */
+    uint8_t down;           /* Readings in a row asking for less */
+    uint8_t up;             /* ... allowing more */
+    uint8_t was;            /* Profile before the last switch */
+    uint8_t by;             /* ... and what made it (IN_x, BY_x) */
+    uint8_t flight;         /* Flight profile to go back to off the ground */
+    bool pending;           /* Switch not announced yet */
+    bool enc_set;           /* The current spec set the encoding */
+    uint16_t base[4];       /* Configured batch bounds */
+    uint16_t lat_seen[BRIDGE_LAT_BUCKETS];  /* Latency histogram at the last reading (low 16 bits) */
+    char base_enc[PROFILE_ENC_MAX];         /* Encoding at boot */
+} prof;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Apply a stored uplink limit (ConfigStore_ForEach visitor)
+ */
+static void profile_stored_rate(uint16_t key, const uint8_t *value, uint8_t len, void *ctx)
+{
+    (void)ctx;
+    if (len == 1) {
+        MavlinkBridge_SetRate(key & ~CONFIG_RATE, value[0]);
+    }
+}
+
+/**
+ * @brief Read "<lo>-<hi>" ending at stop
+ */
+static bool profile_range(const char *p, const char *stop, uint16_t out[2])
+{
+    char *end;
+    unsigned long lo = strtoul(p, &end, 10);
+    unsigned long hi;
+    
+    if (end == p || *end != '-') {
+        return false;
+    }
+    p = end + 1;
+    hi = strtoul(p, &end, 10);
+    if (end == p || end != stop || lo > 0xFFFF || hi > 0xFFFF) {
+        return false;
+    }
+    out[0] = (uint16_t)lo;
+    out[1] = (uint16_t)hi;
+    return true;
+}
+
+/**
+ * @brief Take one spec token: a limit goes to the bridge, bounds and encoding into the caller's
+ * @return false if malformed or refused
+ */
+static bool profile_token(const char *tok, size_t len, uint16_t bounds[4], char *enc)
+{
+    const char *stop = &tok[len];
+    const char *p;
+    char *end;
+    unsigned long msgid, hz;
+    
+    if (len > 4 && memcmp(tok, "enc=", 4) == 0) {
+        if (len - 4 >= PROFILE_ENC_MAX) {
+            return false;
+        }
+        memcpy(enc, &tok[4], len - 4);
+        enc[len - 4] = '\0';
+        return true;
+    }
+    if (len > 6 && memcmp(tok, "batch=", 6) == 0) {
+        return profile_range(&tok[6], stop, &bounds[0]);
+    }
+    if (len > 5 && memcmp(tok, "wait=", 5) == 0) {
+        return profile_range(&tok[5], stop, &bounds[2]);
+    }
+    
+    msgid = strtoul(tok, &end, 10);
+    if (end == tok || *end != ':') {
+        return false;
+    }
+    p = end + 1;
+    hz = strtoul(p, &end, 10);
+    return (end != p && end == stop && hz <= BRIDGE_RATE_ALWAYS && MavlinkBridge_SetRate(msgid, (uint8_t)hz));
+}
+
+/**
+ * @brief Put the current profile in force over the stored settings
+ * @return false if neither its batch bounds nor the base ones were taken
+ */
+static bool profile_apply(void)
+{
+    const char *spec = ConfigStore_GetText((uint16_t)(CONFIG_PROFILE_FULL + profile_stats.current));
+    uint16_t bounds[4];
+    char enc[PROFILE_ENC_MAX];
+    bool ok = true;
+    
+    if (spec == NULL) {
+        spec = profile_specs[profile_stats.current];
+    }
+    memcpy(bounds, prof.base, sizeof(bounds));
+    enc[0] = '\0';
+    
+    /* Limits from the table and the stored ones, then the spec's */
+    MavlinkBridge_ResetRates();
+    ConfigStore_ForEach(CONFIG_RATE, CONFIG_RATE | 0x7FFF, profile_stored_rate, NULL);
+    while (*spec != '\0') {
+        size_t len;
+        
+        spec += strspn(spec, " ");
+        len = strcspn(spec, " ");
+        if (len > 0 && !profile_token(spec, len, bounds, enc)) {
+            LOG_WARN("Profile %s: bad \"%.*s\"", profile_names[profile_stats.current], (int)len, spec);
+        }
+        spec += len;
+    }
+    
+    if (!MavlinkBridge_SetBatchBounds(bounds[0], bounds[1], bounds[2], bounds[3])) {
+        if (memcmp(bounds, prof.base, sizeof(bounds)) != 0) {
+            LOG_WARN("Profile %s: bad batch bounds", profile_names[profile_stats.current]);
+        }
+        ok = MavlinkBridge_SetBatchBounds(prof.base[0], prof.base[1], prof.base[2], prof.base[3]);
+    }
+    
+    /* A spec without an encoding goes back to the boot one, if the last spec had one */
+    if (enc[0] != '\0') {
+        if (!MavlinkBridge_SetEncodingName(enc)) {
+            LOG_WARN("Profile %s: bad encoding %s", profile_names[profile_stats.current], enc);
+        }
+    } else if (prof.enc_set) {
+        MavlinkBridge_SetEncodingName(prof.base_enc);
+    }
+    prof.enc_set = (enc[0] != '\0');
+    return ok;
+}
+
+/**
+ * @brief Switch profiles and queue the announcement
+ */
+static void profile_switch(uint8_t to, uint8_t by)
+{
+    if (to == PROFILE_GROUND && profile_stats.current != PROFILE_GROUND) {
+        prof.flight = profile_stats.current;
+    }
+    prof.was = profile_stats.current;
+    prof.by = by;
+    prof.down = 0;
+    prof.up = 0;
+    prof.pending = true;
+    profile_stats.current = to;
+    profile_stats.switches++;
+    LOG_INFO("Profile %s -> %s (%s)", profile_names[prof.was], profile_names[to], in_names[by]);
+    profile_apply();
+}
+
+/**
+ * @brief 90th percentile publish latency since the last reading, negated
+ * @return false if too few publishes were delivered to tell
+ */
+static bool profile_latency(int32_t *value)
+{
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    uint16_t count[BRIDGE_LAT_BUCKETS];
+    uint32_t total = 0;
+    uint32_t seen = 0;
+    uint8_t i;
+    
+    for (i = 0; i < BRIDGE_LAT_BUCKETS; i++) {
+        count[i] = (uint16_t)((uint16_t)link->latency[i] - prof.lat_seen[i]);
+        prof.lat_seen[i] = (uint16_t)link->latency[i];
+        total += count[i];
+    }
+    if (total < PROFILE_LAT_MIN) {
+        return false;
+    }
+    for (i = 0; i < BRIDGE_LAT_BUCKETS - 1; i++) {
+        seen += count[i];
+        if (seen * 10U >= total * 9U) {
+            break;
+        }
+    }
+    *value = -(int32_t)(2UL << i);      /* Bucket i: under 2^(i+1) ms */
+    return true;
+}
+
+/**
+ * @brief Take the readings there are
+ * @return Bit per IN_x read
+ */
+static uint8_t profile_read(int32_t value[IN_COUNT])
+{
+    const MQTT_LinkQuality_t *lq = A7600_MQTT_GetLinkQuality(prof.mqtt);
+    uint32_t bps = MavlinkBridge_GetUplinkRate();
+    uint8_t have = 0;
+    
+    if (lq->tick != 0 && lq->rsrp != 0) {
+        value[IN_RSRP] = lq->rsrp;      /* LTE only */
+        value[IN_SINR] = lq->sinr;
+        have |= (1U << IN_RSRP) | (1U << IN_SINR);
+    }
+    if (bps != 0) {
+        value[IN_BPS] = (int32_t)bps;
+        have |= (1U << IN_BPS);
+    }
+    if (profile_latency(&value[IN_LAT])) {
+        have |= (1U << IN_LAT);
+    }
+    return have;
+}
+
+/**
+ * @brief Profile one reading asks for, given the one in use
+ * @note  Stepping up past a limit takes clearing it by the band
+ */
+static uint8_t profile_grade(int32_t value, uint8_t in, uint8_t current)
+{
+    int32_t reduced = limits[in].reduced + ((current >= PROFILE_REDUCED) ? limits[in].band : 0);
+    int32_t minimal = limits[in].minimal + ((current >= PROFILE_MINIMAL) ? limits[in].band : 0);
+    
+    if (value < minimal) {
+        return PROFILE_MINIMAL;
+    }
+    return (value < reduced) ? PROFILE_REDUCED : PROFILE_FULL;
+}
+
+/* ==================== Public Functions ==================== */
+
+void LinkProfile_Init(A7600_MQTT_Handle_t *mqtt)
+{
+    const MavlinkBridge_LinkStats_t *link = MavlinkBridge_GetLinkStats();
+    bool compress;
+    const char *enc = MavlinkBridge_GetEncodingName(&compress);
+    
+    memset(&prof, 0, sizeof(prof));
+    prof.mqtt = mqtt;
+    prof.tick = HAL_GetTick();
+    prof.was = PROFILE_FULL;
+    prof.by = BY_NONE;
+    prof.flight = PROFILE_FULL;
+    for (uint8_t i = 0; i < BRIDGE_LAT_BUCKETS; i++) {
+        prof.lat_seen[i] = (uint16_t)link->latency[i];
+    }
+    MavlinkBridge_GetBatchBounds(&prof.base[0], &prof.base[1], &prof.base[2], &prof.base[3]);
+    snprintf(prof.base_enc, sizeof(prof.base_enc), "%s%s", enc, compress ? "+lz" : "");
+    profile_stats.current = PROFILE_FULL;
+    profile_stats.pinned = 0;
+    profile_stats.switches = 0;
+}
+
+void LinkProfile_GetBase(uint16_t base[4])
+{
+    memcpy(base, prof.base, sizeof(prof.base));
+}
+
+bool LinkProfile_Reload(const uint16_t base[4])
+{
+    uint16_t old[4];
+    
+    memcpy(old, prof.base, sizeof(old));
+    memcpy(prof.base, base, sizeof(prof.base));
+    if (profile_apply()) {
+        return true;
+    }
+    memcpy(prof.base, old, sizeof(prof.base));
+    profile_apply();
+    return false;
+}
+
+void LinkProfile_Process(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t current = profile_stats.current;
+    uint8_t want = PROFILE_FULL;
+    uint8_t by = BY_NONE;
+    
+#if PROFILE_GROUND_AUTO
+    /* On and off the ground at once, each pass - not on the readings' interval */
+    if (!profile_stats.pinned && MavlinkBridge_Grounded() != (current == PROFILE_GROUND)) {
+        if (current == PROFILE_GROUND) {
+            profile_switch(prof.flight, BY_FLIGHT);
+        } else {
+            profile_switch(PROFILE_GROUND, BY_GROUND);
+        }
+        current = profile_stats.current;
+    }
+#endif
+    if (now - prof.tick < PROFILE_INTERVAL) {
+        return;
+    }
+    prof.tick = now;
+    prof.have = profile_read(prof.value);   /* Pinned too: the latency is taken per interval */
+    if (profile_stats.pinned || prof.have == 0 || current == PROFILE_GROUND) {
+        return;
+    }
+    
+    /* The worst reading decides */
+    for (uint8_t i = 0; i < IN_COUNT; i++) {
+        uint8_t grade;
+        
+        if (!(prof.have & (1U << i))) {
+            continue;
+        }
+        grade = profile_grade(prof.value[i], i, current);
+        if (grade > want) {
+            want = grade;
+            by = i;
+        }
+    }
+    
+    /* Down at once to what is asked for, up one step at a time */
+    if (want > current) {
+        prof.up = 0;
+        if (++prof.down >= PROFILE_DOWN_HOLD) {
+            profile_switch(want, by);
+        }
+    } else if (want < current) {
+        prof.down = 0;
+        if (++prof.up >= PROFILE_UP_HOLD) {
+            profile_switch((uint8_t)(current - 1), by);
+        }
+    } else {
+        prof.down = 0;
+        prof.up = 0;
+    }
+}
+
+bool LinkProfile_Set(LinkProfile_t profile)
+{
+    if ((unsigned)profile > PROFILE_AUTO) {
+        return false;
+    }
+    prof.down = 0;
+    prof.up = 0;
+    if (profile == PROFILE_AUTO) {
+        profile_stats.pinned = 0;
+        return true;
+    }
+    profile_stats.pinned = 1;
+    if (profile != profile_stats.current) {
+        profile_switch((uint8_t)profile, BY_CMD);
+    }
+    return true;
+}
+
+int LinkProfile_Find(const char *name)
+{
+    if (strcmp(name, "auto") == 0) {
+        return PROFILE_AUTO;
+    }
+    for (uint8_t i = 0; i < PROFILE_COUNT; i++) {
+        if (strcmp(name, profile_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+size_t LinkProfile_Report(char *buf, size_t size)
+{
+    size_t n;
+    
+    if (!prof.pending) {
+        return 0;
+    }
+    
+    /* {"profile":"reduced","was":"full","by":"rsrp","pinned":0,"rsrp":-1163,"sinr":-2,"bps":2100,"lat":2048} */
+    n = (size_t)snprintf(buf, size, "{\"profile\":\"%s\",\"was\":\"%s\",\"by\":\"%s\",\"pinned\":%u",
+                         profile_names[profile_stats.current], profile_names[prof.was], in_names[prof.by],
+                         (unsigned)profile_stats.pinned);
+    for (uint8_t i = 0; i < IN_COUNT && n < size; i++) {
+        if (prof.have & (1U << i)) {
+            n += (size_t)snprintf(&buf[n], size - n, ",\"%s\":%ld", in_names[i],
+                                  (long)((i == IN_LAT) ? -prof.value[i] : prof.value[i]));
+        }
+    }
+    if (n + 1 >= size) {
+        return 0;
+    }
+    buf[n++] = '}';
+    buf[n] = '\0';
+    return n;
+}
+
+void LinkProfile_Reported(void)
+{
+    prof.pending = false;
+}
+
+#endif /* PROFILE_ENABLE */
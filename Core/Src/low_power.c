@@ -0,0 +1,108 @@
+/**
+ * @file    low_power.c
+ * @brief   Idle sleep between events: WFI, tickless when nothing is due soon
+ * @version 1.1
+ */
+
+#include "low_power.h"
+
+#define LP_TIM_HZ       10000U      /* TIM14 count rate - 0.1 ms, 6.5 s range */
+#define LP_TIM_PER_MS   (LP_TIM_HZ / 1000U)
+
+static LowPower_Stats_t stats;
+static uint32_t sleep_cycles;      /* Sub-millisecond rest of plain WFI sleeps */
+static uint32_t sleep_counts;      /* Sub-millisecond rest of tickless sleeps, TIM14 counts */
+
+/* ==================== Public Functions ==================== */
+
+void LowPower_Init(void)
+{
+    __HAL_RCC_TIM14_CLK_ENABLE();
+    TIM14->CR1 = TIM_CR1_URS;                   /* Update event (wake) on overflow only */
+    TIM14->PSC = SystemCoreClock / LP_TIM_HZ - 1U;
+    TIM14->ARR = 0xFFFF;
+    TIM14->EGR = TIM_EGR_UG;                    /* Load the prescaler */
+    TIM14->SR = 0;
+    TIM14->DIER = TIM_DIER_UIE;
+    HAL_NVIC_SetPriority(TIM14_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(TIM14_IRQn);             /* Enabled so it ends a WFI; cleared before it is taken */
+}
+
+void LowPower_Sleep(uint32_t max_ms)
+{
+    stats.sleeps++;
+    
+    /* Next tick is soon anyway: the SysTick ends the sleep */
+    if (LOW_POWER_TICKLESS == 0 || max_ms < 2) {
+        uint32_t load = SysTick->LOAD + 1U;
+        uint32_t before = SysTick->VAL;
+        
+        __WFI();
+        uint32_t slept = (before + load - SysTick->VAL) % load;
+        stats.slept_cycles += slept;
+        sleep_cycles += slept;
+        stats.slept_ms += sleep_cycles / load;
+        sleep_cycles %= load;
+        return;
+    }
+    
+    if (max_ms > LOW_POWER_MAX_SLEEP) {
+        max_ms = LOW_POWER_MAX_SLEEP;
+    }
+    
+    /* Tick interrupt masked - the counter keeps its phase; TIM14 wakes us at the deadline */
+    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+    TIM14->CNT = 0;
+    TIM14->ARR = max_ms * LP_TIM_PER_MS - 1U;
+    TIM14->SR = 0;
+    TIM14->CR1 |= TIM_CR1_CEN;
+    
+    __WFI();
+    
+    TIM14->CR1 &= ~TIM_CR1_CEN;
+    uint32_t counts = TIM14->CNT;
+    if (TIM14->SR & TIM_SR_UIF) {
+        counts += max_ms * LP_TIM_PER_MS;       /* Overflowed, kept counting until stopped */
+    }
+    TIM14->SR = 0;
+    NVIC_ClearPendingIRQ(TIM14_IRQn);
+    
+    /* Advance the HAL tick by the time slept (the rest carries over) */
+    stats.slept_cycles += counts * (SystemCoreClock / LP_TIM_HZ);
+    sleep_counts += counts;
+    uwTick += sleep_counts / LP_TIM_PER_MS;
+    stats.slept_ms += sleep_counts / LP_TIM_PER_MS;
+    sleep_counts %= LP_TIM_PER_MS;
+    stats.tickless++;
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+}
+
+void LowPower_TimerIRQHandler(void)
+{
+    TIM14->SR = 0;
+}
+
+const LowPower_Stats_t *LowPower_GetStats(void)
+{
+    return &stats;
+}
+
+#if !APP_RTOS
+/**
+ * @brief HAL_Delay sleeping between ticks instead of spinning (superloop build)
+ */
+void HAL_Delay(uint32_t Delay)
+{
+    uint32_t tickstart = HAL_GetTick();
+    uint32_t wait = Delay;
+    
+    /* Add a freq to guarantee minimum wait */
+    if (wait < HAL_MAX_DELAY) {
+        wait += (uint32_t)uwTickFreq;
+    }
+    
+    while ((HAL_GetTick() - tickstart) < wait) {
+        __WFI();
+    }
+}
+#endif
@@ -25,6 +25,14 @@
 #include "debug_log.h"
 #include "uart_dma.h"
 #include "app.h"
+#include "low_power.h"
+#include "supervisor.h"
+#include "boot_profile.h"
+#include "ram_usage.h"
+#include "modem_power.h"
+#include "crc32.h"
+#include "mem_dma.h"
+#include "timebase.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -34,6 +42,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define LOG_FILE_ID 1
+#define LOG_MODULE LOG_MOD_APP
 
 /* USER CODE END PD */
 
@@ -55,14 +65,15 @@ DMA_HandleTypeDef hdma_usart2_tx;
 /* USER CODE BEGIN PV */
 /* UART DMA handle for A7600 SIM module */
 UART_DMA_Handle_t sim_uart;
+static uint8_t sim_rx_buf[SIM_UART_RX_BUFFER_SIZE];
+static uint8_t sim_tx_buf[SIM_UART_TX_BUFFER_SIZE];
 /* UART DMA handle for Telemetry (MAVLink) */
 UART_DMA_Handle_t telem_uart;
+static uint8_t telem_rx_buf[TELEM_UART_RX_BUFFER_SIZE];
+static uint8_t telem_tx_buf[TELEM_UART_TX_BUFFER_SIZE];
 
 /* Application handle */
 App_Handle_t app;
-
-/*IWDG Counter*/
-uint32_t iwdg_tick = 0;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -90,6 +101,7 @@ static void MX_USART1_UART_Init(void);
 int main(void)
 {
   /* USER CODE BEGIN 1 */
+  RamUsage_Paint();     /* Stack high-water mark - before anything goes deep */
 
   /* USER CODE END 1 */
 
@@ -99,6 +111,8 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
+  Supervisor_Boot();    /* Reset cause and the last run's task record, before anything else */
+  BootProfile_Start();
 
   /* USER CODE END Init */
 
@@ -119,32 +133,43 @@ int main(void)
 	
   /* Log init (will be empty if disabled) */
   Debug_Init();
-  LOG_INFO("System Booting - Wait 5s...");
-
-	GPIOB->ODR &= ~(0x01 << 11);
-  GPIOC->ODR &= ~(0x01 << 13);
-	GPIOA->ODR &= ~(0x01 << 15);
-	
-	HAL_Delay(500);
-	
-  HAL_IWDG_Refresh(&hiwdg);
-  /* Set GPIO pins high - Power on A7600 module */
-  GPIOB->ODR |= (0x01 << 11);
-  GPIOC->ODR |= (0x01 << 13);
-	GPIOA->ODR |= (0x01 << 15);
+  LOG_INFO("System Booting");
   
-  /* Wait for module to boot */
-  //HAL_Delay(5000);
+  /* The modem's power key pulse started in MX_GPIO_Init and ends in the modem
+   * task (ModemPower_Process) - no delay here, App_Run starts connecting on
+   * the module's RDY / +CPIN URCs */
   
   LOG_INFO("Initializing Modules...");
 
+  /* Microsecond clock (TIM3 into TIM15) - the UARTs stamp RX events with it */
+  Time_Init();
+  
   /* Initialize UART DMA with circular RX for A7600 SIM module */
-  UART_DMA_Init(&sim_uart, &huart2);
+  UART_DMA_Init(&sim_uart, &huart2, sim_rx_buf, sizeof(sim_rx_buf), sim_tx_buf, sizeof(sim_tx_buf));
+  UART_DMA_EnableLineMatch(&sim_uart, '\n');   /* wake AT parser per response line */
+  
+  /* Initialize UART DMA for Telemetry (MAVLink from FC) */
+  UART_DMA_Init(&telem_uart, &huart1, telem_rx_buf, sizeof(telem_rx_buf), telem_tx_buf, sizeof(telem_tx_buf));
+  UART_DMA_EnableRxTimeout(&telem_uart, TELEM_UART_RX_TIMEOUT_BITS);   /* hardware frame delimiting */
+#if FC_FLOW_RTS
+  UART_DMA_SetRts(&telem_uart, FC_RTS_GPIO_Port, FC_RTS_Pin, FC_RTS_HIGH, FC_RTS_LOW);
+#endif
+  
+  /* TIM14 ends idle sleeps while the SysTick is masked */
+  LowPower_Init();
+  
+  /* CRC unit checked and timed against the table - before the retained state is checked */
+  Crc32_Init();
+  
+  /* Memory-to-memory DMA timed against memcpy (the bridge's batch moves) */
+  MemDma_Init();
   
   /* Initialize Application layer with MQTT */
   App_Init(&app, &sim_uart);
-	
-	iwdg_tick = HAL_GetTick();
+#if APP_RTOS
+  /* Threaded build: the modem, bridge and health threads take over (does not return) */
+  App_RtosStart(&app);
+#endif
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -152,13 +177,12 @@ int main(void)
   
   while (1)
   { 
-    /* Run application - handles MQTT connection, publishing, etc */
+    /* One scheduler pass - modem, bridge, link, status and health tasks (watchdog included) */
     App_Run(&app);
-		if(HAL_GetTick() - iwdg_tick >= 1000)
-		{
-			HAL_IWDG_Refresh(&hiwdg);
-			iwdg_tick = HAL_GetTick();
-		}
+
+    /* Sleep until the next task is due unless a link received data during
+     * the pass (left pending for the next one) - tickless when that is far */
+    App_Sleep(&app);
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
@@ -271,6 +295,14 @@ static void MX_USART1_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART1_Init 2 */
+#if FC_FLOW_CTS
+  /* CTS only - RTS is a GPIO the bridge drives (circular DMA never lets the USART raise it) */
+  huart1.Init.HwFlowCtl = UART_HWCONTROL_CTS;
+  if (HAL_UART_Init(&huart1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
 
   /* USER CODE END USART1_Init 2 */
 
@@ -306,7 +338,7 @@ static void MX_USART2_UART_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN USART2_Init 2 */
-
+  /* RTS/CTS (MODEM_HW_FLOW_CONTROL) is switched on at connect, after AT+IFC */
   /* USER CODE END USART2_Init 2 */
 
 }
@@ -322,10 +354,10 @@ static void MX_DMA_Init(void)
 
   /* DMA interrupt init */
   /* DMA1_Channel2_3_IRQn interrupt configuration */
-  HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
+  HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 1, 0);
   HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
   /* DMA1_Channel4_5_IRQn interrupt configuration */
-  HAL_NVIC_SetPriority(DMA1_Channel4_5_IRQn, 1, 0);
+  HAL_NVIC_SetPriority(DMA1_Channel4_5_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Channel4_5_IRQn);
 
 }
@@ -378,6 +410,28 @@ static void MX_GPIO_Init(void)
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
 /* USER CODE BEGIN MX_GPIO_Init_2 */
+  /* PB11 / PC13 / PA15 low above: the modem's power key pulse runs from here, through
+   * the rest of init. Watchdog / software reset: the module kept running (and maybe its
+   * MQTT sessions) - released at once, App_Run takes the sessions over */
+  ModemPower_Start(Supervisor_WarmBoot());
+#if MODEM_SLEEP_DTR
+  /* Modem DTR low: awake until the driver lets it sleep */
+  HAL_GPIO_WritePin(MODEM_DTR_GPIO_Port, MODEM_DTR_Pin, GPIO_PIN_RESET);
+  GPIO_InitStruct.Pin = MODEM_DTR_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(MODEM_DTR_GPIO_Port, &GPIO_InitStruct);
+#endif
+#if FC_FLOW_RTS
+  /* FC RTS low: the FC may send (driven by the bridge, not the USART - the RX DMA never stalls it) */
+  HAL_GPIO_WritePin(FC_RTS_GPIO_Port, FC_RTS_Pin, GPIO_PIN_RESET);
+  GPIO_InitStruct.Pin = FC_RTS_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(FC_RTS_GPIO_Port, &GPIO_InitStruct);
+#endif
 /* USER CODE END MX_GPIO_Init_2 */
 }
 
@@ -397,6 +451,45 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
     /* #ifdef DEBUG_ENABLE ... Removed for Telem */
 }
 
+/**
+ * @brief RX Half Complete callback - DMA reached middle of circular buffer
+ */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        UART_DMA_RxHalfCplt_Callback(&sim_uart);
+    }
+    if (huart->Instance == USART1) {
+        UART_DMA_RxHalfCplt_Callback(&telem_uart);
+    }
+}
+
+/**
+ * @brief RX Complete callback - DMA wrapped circular buffer
+ */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        UART_DMA_RxCplt_Callback(&sim_uart);
+    }
+    if (huart->Instance == USART1) {
+        UART_DMA_RxCplt_Callback(&telem_uart);
+    }
+}
+
+/**
+ * @brief UART error callback - count errors and restart aborted RX DMA
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        UART_DMA_Error_Callback(&sim_uart);
+    }
+    if (huart->Instance == USART1) {
+        UART_DMA_Error_Callback(&telem_uart);
+    }
+}
+
 /* USER CODE END 4 */
 
 /**
@@ -0,0 +1,39 @@
+/**
+ * @file    mav_field.c
+ * @brief   MAVLink payload field readers for the on-board consumers (anomaly model, summaries)
+ * @version 1.0
+ */
+
+#include "mav_field.h"
+
+/* ==================== Public Functions ==================== */
+
+uint16_t MavField_U16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t MavField_U32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int32_t MavField_Fixed(const uint8_t *p, uint8_t frac)
+{
+    uint32_t bits = MavField_U32(p);
+    int32_t shift = (int32_t)((bits >> 23) & 0xFF) - 127 - 23 + frac;
+    uint32_t mag = (bits & 0x7FFFFFU) | 0x800000U;
+    
+    if ((bits & 0x7F800000U) == 0) {
+        return 0;                               /* Zero or denormal */
+    }
+    if (shift >= 0) {
+        mag = (shift > 8) ? 32767 : mag << shift;
+    } else {
+        mag = (shift <= -24) ? 0 : mag >> -shift;
+    }
+    if (mag > 32767) {
+        mag = 32767;
+    }
+    return (bits & 0x80000000U) ? -(int32_t)mag : (int32_t)mag;
+}
@@ -1,53 +1,713 @@
 /**
  * @file    mavlink_bridge.c
- * @brief   MAVLink Bridge with Configurable Encoding (HEX or Base64)
+ * @brief   MAVLink Bridge with Configurable Encoding (HEX, Base64 or raw)
  */
 
 #include "mavlink_bridge.h"
+#include "outage_log.h"
+#include "param_cache.h"
+#include "mission_store.h"
 #include "debug_log.h"
+#include "boot_profile.h"
+#include "profiler.h"
+#include "ramfunc.h"
+#include "anomaly.h"
+#include "telem_summary.h"
+#include "telem_fields.h"
+#include "mav_msgs.h"
+#include "mem_dma.h"
+#include "timebase.h"
+#include <stdio.h>
 #include <string.h>
 
+#define LOG_FILE_ID 5
+#define LOG_MODULE LOG_MOD_BRIDGE
+
 /* ==================== ENCODING OPTIONS ==================== */
-/* Change this to select encoding mode:
- *   ENCODE_HEX    - Output: "FD1C0000..." (100% size increase)
- *   ENCODE_BASE64 - Output: "/RwAAA..."  (33% size increase)
+/* Encoding at boot (MavlinkBridge_SetEncoding switches at runtime):
+ *   BRIDGE_ENC_HEX    - Output: "FD1C0000..." (100% size increase)
+ *   BRIDGE_ENC_BASE64 - Output: "/RwAAA..."  (33% size increase)
+ *   BRIDGE_ENC_RAW    - Output: frame bytes as is (binary payload, both directions)
  */
-#define ENCODE_HEX      0
-#define ENCODE_BASE64   1
-
-#define BRIDGE_ENCODING ENCODE_BASE64  /* <-- CHANGE THIS TO SELECT */
+#define BRIDGE_ENCODING BRIDGE_ENC_BASE64  /* <-- CHANGE THIS TO SELECT */
 
-/* ==================== MAVLink 2 Constants ==================== */
+/* ==================== MAVLink Constants ==================== */
 #define MAVLINK_V2_MAGIC        0xFD
+#define MAVLINK_V1_MAGIC        0xFE
 #define MAVLINK_HEADER_LEN      10
+#define MAVLINK_V1_HEADER_LEN   6
 #define MAVLINK_CHECKSUM_LEN    2
 #define MAVLINK_SIG_LEN         13
 #define MAVLINK_IFLAG_SIGNED    0x01
+#define MAVLINK_MAX_FRAME_LEN   (MAVLINK_HEADER_LEN + 255 + MAVLINK_CHECKSUM_LEN + MAVLINK_SIG_LEN)
+#define MAVLINK_CRC_INIT        0xFFFF
 
 /* Config */
-#define FRAME_TIMEOUT_MS        50
+#define FRAME_SLACK_US          3000 /* A partial frame is given its line time plus this */
+#define UART_BITS_PER_BYTE      10  /* 8N1 */
+#define BRIDGE_STREAM_UDP       1   /* Stream message IDs over the datagram path when it is up */
+#define BRIDGE_MAVLINK_V1       1   /* Forward v1 frames as well (start search is then bytewise) */
+#define BRIDGE_V2_PACK          1   /* Uplink frames re-encoded as v2 with trailing payload zeros cut */
+#define BRIDGE_BATCH_BYTES      BRIDGE_BATCH_MAX    /* Raw frame bytes per publish at boot */
+#define BRIDGE_BATCH_DEADLINE   100 /* Publish a batch this long after its first frame, ms (at boot) */
+#define BRIDGE_DEADLINE_MAX     5000
+#define BRIDGE_GROUND_DEADLINE  1000    /* Batch deadline while the modem sleeps, autopilot disarmed, ms */
+#define BRIDGE_COMPRESS         0   /* LZ stage built in (format in Core/Doc), LZ_WINDOW B of RAM */
+#define BRIDGE_COMPRESS_BOOT    0   /* LZ-compress batches from boot (needs BRIDGE_COMPRESS) */
+#define BRIDGE_STAMPS_BOOT      0   /* Time-stamp live batches from boot (format in Core/Doc) */
+#define BRIDGE_HDR_PACK         1   /* Compact frame headers in batches built in (format in Core/Doc) */
+#define BRIDGE_HDR_PACK_BOOT    0   /* ... used from boot */
+#define BRIDGE_ZERO_COPY        1   /* Raw encoding: publish a batch straight from the USART1 ring */
+#define BRIDGE_ZC_HOLD          256 /* Ring bytes such a batch may keep from the FC at most */
+#define BRIDGE_OVERLAP          1   /* The next batch is parsed and encoded behind the one the modem takes */
+#define BRIDGE_SWAR             1   /* Hex and Base64 encoded four characters per word (SWAR), not per table load */
+#define BRIDGE_DEDUP_REFRESH    5000 /* Unchanged messages forwarded this often at most, ms (0 = off) */
+#define BRIDGE_DL_QUEUE         512 /* Downlink frames waiting for USART1, bytes */
+#define BRIDGE_DL_CHAIN         1   /* Frames committed during a downlink DMA go out from its completion */
+#define BRIDGE_DL_DEDUP         8   /* Downlink frames remembered to drop QoS 1 redeliveries of (0 = off) */
+#define BRIDGE_DL_DEDUP_WINDOW  60000 /* ... for this long at most, ms */
+#define BRIDGE_SOURCES          4   /* (sysid, compid) pairs tracked: seq, topic, priority */
+#define BRIDGE_RADIO_INTERVAL   1000 /* RADIO_STATUS to FC and cloud this often, ms (0 = off) */
+#define BRIDGE_RADIO_SYSID      51  /* Sender of RADIO_STATUS (ArduPilot honours any, SiK uses 51) */
+#define BRIDGE_RADIO_COMPID     68  /* MAV_COMP_ID_TELEMETRY_RADIO */
+#define BRIDGE_PARAM_CACHE      1   /* Answer PARAM_REQUEST_LIST / _READ from the flash copy */
+#define BRIDGE_PARAM_PRIME      30000 /* Ask the FC for its list once heard; its answer stays off
+                                     * uplink this long at most, ms (0 = learn from GCS requests) */
+#define BRIDGE_AUTOBAUD         1   /* Learn the FC's USART1 rate (auto baud rate detection, CRC-confirmed) */
+#define BRIDGE_AUTOBAUD_CONFIRM 3   /* Valid frames that lock a rate in */
+#define BRIDGE_AUTOBAUD_REJECTS 4   /* Frames failing the CRC that condemn it first */
+#define BRIDGE_AUTOBAUD_WINDOW  1000 /* A rate gets this long to show valid frames while bytes come, ms */
+#define BRIDGE_AUTOBAUD_LOST    3000 /* Locked: bytes but no valid frame this long, learn again, ms */
+#define AUTOBAUD_BYTES          64  /* Bytes that count as traffic within a window */
+#define BRIDGE_SHAPE            1   /* Ask the FC for limited messages at their limit (SET_MESSAGE_INTERVAL) */
+#define BRIDGE_SHAPE_REBOOT     3000 /* Autopilot HEARTBEAT gap taken for a reboot: intervals asked again, ms */
+#define BRIDGE_SHAPE_OFFLINE    5000 /* Link down this long: outage log rates asked for instead, ms */
+#define BRIDGE_SHAPE_ACK_MS     1000 /* COMMAND_ACK wait */
+#define BRIDGE_SHAPE_PAUSE      10000 /* After SHAPE_TRIES commands in a row went unanswered, ms */
+#define BRIDGE_SHAPER           1   /* Token bucket on batches at the measured publish throughput */
+#define BRIDGE_SHAPER_DELAY     300 /* Bucket depth: queueing a burst may add at the modem, ms of capacity */
+#define BRIDGE_SHAPER_MIN       500  /* Floor of the estimate, B/s */
+#define BRIDGE_SHAPER_MAX       65535
+#define BRIDGE_SHAPER_START     BRIDGE_SHAPER_MAX   /* Capacity assumed until queueing measured it, B/s */
+#define BRIDGE_SHAPER_BASE      10000 /* Publish latency without queueing: the least seen in this long, ms */
+#define BRIDGE_ADAPT            1   /* Batch budget and deadline follow the publish latency (AIMD) */
+#define BRIDGE_ADAPT_LATENCY    500 /* A publish to an idle modem slower than this halves both, ms */
+#define BRIDGE_ADAPT_BYTES      32  /* Added per publish sent behind another */
+#define BRIDGE_ADAPT_MS         10  /* ... to the deadline, which gives it back per publish to an idle modem */
+#define BRIDGE_ADAPT_MIN_MS     BRIDGE_BATCH_DEADLINE   /* Deadline bounds until set from the config store */
+#define BRIDGE_ADAPT_MAX_MS     1000
+#define BRIDGE_BACKPRESSURE     1   /* Shed low-priority frames first as publishes back up and the FC ring fills */
+#define BRIDGE_BP_THIN          50  /* FC RX ring fill (%) from which limited messages are thinned */
+#define BRIDGE_BP_SHED          70  /* ... they and bulk-priority sources are dropped, streams thinned,
+                                     * the FC told to slow */
+#define BRIDGE_BP_DROP          80  /* ... frames the open batch cannot take are dropped, not held */
+#define BRIDGE_BP_LATENCY       1000 /* Own publish in flight this long: thinned as well, ms */
+#define BRIDGE_BP_RADIO_GAP     200 /* A rise sends RADIO_STATUS at once, this long after the last one at least, ms */
+#define BRIDGE_RTS_OUTAGE       6   /* Outage log pages in use that raise RTS (FC_FLOW_RTS; 0 = never) */
+#define BRIDGE_RTS_OUTAGE_LOW   3   /* ... and that lower it again as the log is replayed */
+#define BRIDGE_XFER             1   /* Log download / FTP from the FC: full batches, limited messages yield to it */
+#define BRIDGE_XFER_IDLE        2000 /* No LOG_DATA / FILE_TRANSFER_PROTOCOL from the FC this long: over, ms */
+#define BRIDGE_XFER_DEADLINE    500 /* Batch deadline while it runs (the tail of a request waits this long), ms */
+#define BRIDGE_MISSION_PROXY    1   /* Run the FC side of a mission upload sent whole (flash copy, local handshake) */
+#define BRIDGE_MISSION_IDLE     10000 /* Upload without a request or an item this long: proxy off, ms */
+#define BRIDGE_PRESENCE         1   /* HEARTBEATs repeating their source's state go up in a presence record */
+#define BRIDGE_PRESENCE_MS      1000 /* ... one per this long, in the autopilot batch, ms */
+#define BRIDGE_STATUS_CARRY     1   /* The application's status snapshot rides in an autopilot batch */
+#define BRIDGE_SNAPSHOT         1   /* Last autopilot frame of slow state messages kept, sent together on connect */
+#define BRIDGE_SNAPSHOT_MSGS    { 1, 42, 242, 245 } /* ... which: SYS_STATUS, MISSION_CURRENT, HOME_POSITION,
+                                                     * EXTENDED_SYS_STATE (bridged ones, mav_msgs.h) */
+#define BRIDGE_SNAPSHOT_POOL    256 /* ... their frames' RAM: each takes its longest signed v2 frame, bytes */
+#define BRIDGE_FAIR             1   /* Congested: sources share the uplink by deficit round robin */
+#define BRIDGE_FAIR_QUANTUM     256 /* Bytes a source is given per round unless set, B */
+#define BRIDGE_FAIR_QUANTUM_FC  1024 /* ... an autopilot (its parameter and log bursts), B */
+#define BRIDGE_FAIR_IDLE        500 /* A source quiet this long has no claim on the round, ms */
+#define BRIDGE_FAIR_QUANTUM_MAX 8192
+#define SHAPE_TRIES             3
+#define SHAPE_DEFAULT           RATE_ALWAYS /* Interval of the FC's own choosing (interval 0) */
+#define CRIT_TEXT_MAX           159 /* Encoded characters per critical publish (signed STATUSTEXT: 108) */
+#define DATAGRAM_SEQ_LEN        2
+#define PACK_PARTS              4   /* Re-encoded frame: header, payload (two ring pieces), checksum */
+#define CODEC_RUNS              4   /* Codec benchmark: best of this many runs per encoding */
+#define CODEC_SAMPLE_MAX        320 /* Its sample frames, bytes (kept at the end of tx_buf) */
+#define RADIO_STATUS_ID         109
+#define RADIO_STATUS_LEN        9
+#define RADIO_FRAME_LEN         (MAVLINK_HEADER_LEN + RADIO_STATUS_LEN + MAVLINK_CHECKSUM_LEN)
+#define SYSTEM_TIME_ID          2
+#define SYSTEM_TIME_LEN         12  /* time_unix_usec, time_boot_ms */
+#define STAMP_FRAME_LEN         (MAVLINK_HEADER_LEN + SYSTEM_TIME_LEN + MAVLINK_CHECKSUM_LEN)
+#define TUNNEL_ID               385
+#define FILE_TRANSFER_PROTOCOL_ID   110
+#define LOG_DATA_ID             120
+#define TUNNEL_LEN              133 /* payload_type, target_system, target_component, payload_length, payload[128] */
+#define TUNNEL_DATA             5   /* payload[] in the TUNNEL payload */
+#define SUMMARY_FRAME_LEN       (MAVLINK_HEADER_LEN + TUNNEL_LEN + MAVLINK_CHECKSUM_LEN)
+#define PRESENCE_FRAME_LEN      SUMMARY_FRAME_LEN
+#define PRESENCE_VERSION        1
+#define STATUS_FRAME_LEN        SUMMARY_FRAME_LEN
+#define PRESENCE_HEAD           4   /* version, entries, interval (in the TUNNEL payload[]) */
+#define PRESENCE_ENTRY          (3 + HEARTBEAT_LEN) /* sysid, compid, HEARTBEATs heard, the last one's payload */
+#define HEARTBEAT_ID            0
+#define HEARTBEAT_LEN           9   /* custom_mode, type, autopilot, base_mode, system_status, mavlink_version */
+#define PARAM_REQUEST_READ_ID   20
+#define PARAM_REQUEST_LIST_ID   21
+#define PARAM_VALUE_ID          22
+#define PARAM_VALUE_LEN         25
+#define PARAM_READ_LEN          20
+#define PARAM_NONE              0xFFFF
+#define MISSION_REQUEST_ID      40
+#define MISSION_COUNT_ID        44
+#define MISSION_ACK_ID          47
+#define MISSION_REQUEST_INT_ID  51
+#define MISSION_ITEM_INT_ID     73
+#define MISSION_SEQ             28  /* seq in the MISSION_ITEM_INT payload */
+#define MISSION_TARGET          32  /* ... target_system, target_component */
+#define MISSION_TYPE            37  /* ... mission_type */
+#define MAV_MISSION_TYPE_MISSION    0
+#define MISSION_NONE            0xFFFF
+#define COMMAND_LONG_ID         76
+#define COMMAND_LONG_LEN        33  /* param1-7, command, target_system, target_component, confirmation */
+#define COMMAND_ACK_ID          77
+#define COMMAND_ACK_LEN         10  /* command, result, progress, result_param2, target_system, target_component */
+#define MAV_CMD_SET_MESSAGE_INTERVAL    511
+#define MAV_RESULT_ACCEPTED     0
+#define MAV_RESULT_TEMPORARILY_REJECTED 1
+#define MAV_RESULT_UNSUPPORTED  3
+#define MAV_COMP_ID_AUTOPILOT1  1
+#define HEARTBEAT_BASE_MODE     6   /* Payload offset, system_status after it */
+#define MAV_MODE_FLAG_SAFETY_ARMED  0x80
+#define MAV_STATE_STANDBY       3   /* system_status up to this: on the ground unless armed */
+#define MAV_STATE_POWEROFF      7   /* ... and this one */
+#define ROUTE_BASE              0   /* Route key of autopilot frames: the plain tx topic */
+#define ROUTE_TOPIC_MAX         (BRIDGE_TOPIC_TX_SIZE + 8)      /* ".../tx/255/255" */
+
+/* Batch compression: byte-oriented LZ77 over the batch so far (each batch
+ * decodes on its own - QoS0 publishes may be lost) */
+#define LZ_FLAG         0x01    /* First payload byte of a compressed batch */
+#define LZ_WINDOW       256     /* History, power of two (distance fits one byte) */
+#define LZ_MIN_MATCH    3
+#define LZ_MAX_MATCH    (0x7F + LZ_MIN_MATCH)
+#define LZ_MAX_LITERALS 128
+#define LZ_OUT_MAX(n)   ((size_t)(n) + (size_t)(n) / LZ_MAX_LITERALS + 2)
+
+/* Compact frame headers: a record per frame instead of its header and
+ * checksum, relative to the record before it in the batch (under any LZ stage) */
+#define HC_FLAG         0x02    /* First payload byte of such a batch */
+#define HC_SAME_SRC     0x01    /* Record control: sysid, compid as the last record (left out) */
+#define HC_SEQ_NEXT     0x02    /* ... seq one past the last record's (left out) */
+#define HC_V1           0x04    /* ... the frame was v1 */
+#define HC_FLAGS        0x08    /* ... incompat and compat flags follow (v2, nonzero) */
+#define HC_RECORD_MAX   11      /* Control, seq, sysid, compid, flags, msgid (4 varint bytes), len */
+
+/* RTS hold reasons of the bridge (FC_FLOW_RTS; the ring's own is UART_DMA_RTS_RING) */
+#define RTS_SHED        0x02    /* Congestion at BP_SHED */
+#define RTS_OUTAGE      0x04    /* Outage log nearly full - its oldest pages would be given up */
+
+/* Congestion levels (BRIDGE_BACKPRESSURE) */
+enum {
+    BP_NONE = 0,
+    BP_THIN,        /* Limited messages at their outage log rate */
+    BP_SHED,        /* Limited messages and bulk-priority sources off, streams thinned, RTS high */
+    BP_DROP         /* Frames that cannot join the batch dropped before the ring laps */
+};
+
+/* Own publishes in flight */
+#define PUB_LIVE        0x01    /* Autopilot batch (bulk lane, not from the store) */
+#define PUB_QUEUED      0x02    /* Another one was in flight when it went */
+
+/* Uplink lanes */
+enum {
+    LANE_BULK = 0,      /* Batched, QoS0 */
+    LANE_CRITICAL,      /* Own QoS1 publish ahead of the open batch */
+    LANE_STREAM         /* Loss-tolerant, high-rate: datagram path when it is up, else bulk */
+};
+
+#if BRIDGE_AUTOBAUD
+/* FC link rate */
+enum {
+    AB_MEASURE = 0,     /* Waiting for the USART's measurement */
+    AB_CONFIRM,         /* Rate set, waiting for valid frames */
+    AB_LOCKED
+};
+
+/* Rates a measurement snaps to */
+static const uint32_t fc_rates[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800, 500000, 921600, 1500000 };
+#endif
+
+/* Messages bridged - others are dropped either way. Policy per message:
+ * MSG_POLICY_<NAME> rate, lane, dedup, keep. rate is the default uplink
+ * limit in Hz (0 = drop); dedup is the leading payload bytes (timestamp)
+ * left out of the unchanged check; keep is the rate stored in the outage
+ * log while offline, Hz (0 = not kept). ID, CRC_EXTRA, payload lengths and
+ * the target offset come from the message XML through mav_msgs.h: run
+ * MDK-ARM/mav_gen.py after adding or removing a line here */
+#define RATE_ALWAYS     BRIDGE_RATE_ALWAYS
+#define DEDUP_OFF       0xFF    /* Every frame counts (commands, handshakes, parameters) */
+#define MSG_POLICY_HEARTBEAT                        RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 1
+#define MSG_POLICY_SYS_STATUS                       RATE_ALWAYS, LANE_BULK, 0, 1
+#define MSG_POLICY_SYSTEM_TIME                      RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_PING                             RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_SET_MODE                         RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_PARAM_REQUEST_READ               RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_PARAM_REQUEST_LIST               RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_PARAM_VALUE                      RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_PARAM_SET                        RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_GPS_RAW_INT                      RATE_ALWAYS, LANE_STREAM, 8, 1
+#define MSG_POLICY_GPS_STATUS                       RATE_ALWAYS, LANE_BULK, 0, 0
+#define MSG_POLICY_SCALED_IMU                       5, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_RAW_IMU                          5, LANE_STREAM, DEDUP_OFF, 0
+#define MSG_POLICY_SCALED_PRESSURE                  RATE_ALWAYS, LANE_BULK, 4, 0
+#define MSG_POLICY_ATTITUDE                         10, LANE_STREAM, DEDUP_OFF, 1
+#define MSG_POLICY_ATTITUDE_QUATERNION              5, LANE_STREAM, DEDUP_OFF, 0
+#define MSG_POLICY_LOCAL_POSITION_NED               RATE_ALWAYS, LANE_STREAM, DEDUP_OFF, 0
+#define MSG_POLICY_GLOBAL_POSITION_INT              RATE_ALWAYS, LANE_STREAM, 4, 2
+#define MSG_POLICY_RC_CHANNELS_RAW                  2, LANE_BULK, 4, 0
+#define MSG_POLICY_SERVO_OUTPUT_RAW                 2, LANE_BULK, 4, 0
+#define MSG_POLICY_MISSION_REQUEST_PARTIAL_LIST     0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_MISSION_WRITE_PARTIAL_LIST       0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_MISSION_ITEM                     RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_REQUEST                  RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_SET_CURRENT              RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_CURRENT                  RATE_ALWAYS, LANE_BULK, 0, 1
+#define MSG_POLICY_MISSION_REQUEST_LIST             RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_COUNT                    RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_CLEAR_ALL                RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_ITEM_REACHED             RATE_ALWAYS, LANE_BULK, DEDUP_OFF, RATE_ALWAYS
+#define MSG_POLICY_MISSION_ACK                      RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 0
+#define MSG_POLICY_SET_GPS_GLOBAL_ORIGIN            0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_GPS_GLOBAL_ORIGIN                RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_MISSION_REQUEST_INT              RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 0
+#define MSG_POLICY_NAV_CONTROLLER_OUTPUT            RATE_ALWAYS, LANE_BULK, 0, 0
+#define MSG_POLICY_RC_CHANNELS                      2, LANE_BULK, 4, 0
+#define MSG_POLICY_REQUEST_DATA_STREAM              RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_MANUAL_CONTROL                   RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_RC_CHANNELS_OVERRIDE             0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_MISSION_ITEM_INT                 RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, 0
+#define MSG_POLICY_VFR_HUD                          RATE_ALWAYS, LANE_STREAM, 0, 1
+#define MSG_POLICY_COMMAND_INT                      RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_COMMAND_LONG                     RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_COMMAND_ACK                      RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, RATE_ALWAYS
+#define MSG_POLICY_SET_ATTITUDE_TARGET              0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_SET_POSITION_TARGET_LOCAL_NED    0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_SET_POSITION_TARGET_GLOBAL_INT   0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_POSITION_TARGET_GLOBAL_INT       RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_HIGHRES_IMU                      5, LANE_STREAM, DEDUP_OFF, 0
+#define MSG_POLICY_RADIO_STATUS                     RATE_ALWAYS, LANE_BULK, 0, 0
+#define MSG_POLICY_FILE_TRANSFER_PROTOCOL           RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_TIMESYNC                         RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_SCALED_IMU2                      5, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_LOG_REQUEST_LIST                 RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_LOG_ENTRY                        RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_LOG_REQUEST_DATA                 RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_LOG_DATA                         RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_LOG_ERASE                        RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_LOG_REQUEST_END                  RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+#define MSG_POLICY_POWER_STATUS                     RATE_ALWAYS, LANE_BULK, 0, 0
+#define MSG_POLICY_BATTERY_STATUS                   RATE_ALWAYS, LANE_BULK, 0, 1
+#define MSG_POLICY_AUTOPILOT_VERSION                RATE_ALWAYS, LANE_BULK, 0, 0
+#define MSG_POLICY_ESTIMATOR_STATUS                 RATE_ALWAYS, LANE_BULK, 8, 0
+#define MSG_POLICY_GPS_RTCM_DATA                    0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_VIBRATION                        1, LANE_BULK, 8, 0
+#define MSG_POLICY_HOME_POSITION                    RATE_ALWAYS, LANE_BULK, 0, 0
+#define MSG_POLICY_SET_HOME_POSITION                0, LANE_BULK, DEDUP_OFF, 0              /* Downlink only */
+#define MSG_POLICY_EXTENDED_SYS_STATE               RATE_ALWAYS, LANE_BULK, 0, 1
+#define MSG_POLICY_STATUSTEXT                       RATE_ALWAYS, LANE_CRITICAL, DEDUP_OFF, RATE_ALWAYS
+#define MSG_POLICY_TUNNEL                           RATE_ALWAYS, LANE_BULK, DEDUP_OFF, 0
+
+/* Sorted by ID, as generated; indexes rate and last_sent as well */
+static const struct {
+    uint16_t msgid;
+    uint8_t extra;
+    uint8_t min_len;        /* Payload of the base fields - a v1 frame's */
+    uint8_t max_len;        /* ... with the extensions - the longest v2 payload */
+    uint8_t target;         /* Payload offset of target_system, target_component after it */
+    uint8_t rate;
+    uint8_t lane;
+    uint8_t dedup;
+    uint8_t keep;
+} msg_table[] = {
+#define MSG_ROW(name, msgid, extra, min_len, max_len, target) \
+    { msgid, extra, min_len, max_len, target, MSG_POLICY_##name },
+    MAV_MSGS_TABLE(MSG_ROW)
+#undef MSG_ROW
+};
+
+/* ID -> index + 1 through MAV_MSGS_HASH (msg_index) */
+static const uint8_t msg_slot[1U << MAV_MSGS_HASH_BITS] = MAV_MSGS_SLOTS;
+
+#define MSG_COUNT       (sizeof(msg_table) / sizeof(msg_table[0]))
+
+#if BRIDGE_SNAPSHOT
+/* State snapshot messages, a pool slot each */
+static const uint16_t snap_ids[] = BRIDGE_SNAPSHOT_MSGS;
+
+#define SNAP_COUNT      (sizeof(snap_ids) / sizeof(snap_ids[0]))
+#define SNAP_NONE       0xFFFF  /* Slot of a message not bridged, or not fitting the pool */
+#endif
+
+/* X.25 (CRC-16/MCRF4XX) lookup, reflected polynomial 0x8408 */
+static const uint16_t crc_table[256] = {
+    0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+    0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+    0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+    0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+    0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+    0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+    0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+    0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+    0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+    0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+    0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+    0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+    0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+    0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+    0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+    0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+    0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+    0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+    0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+    0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+    0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+    0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+    0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+    0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+    0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+    0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+    0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+    0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+    0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+    0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+    0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+    0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
+};
 
 /* Encoding tables */
 static const char hex_table[] = "0123456789ABCDEF";
 static const char b64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/* Decoding tables: digit value, or a flag (every flag has bit 6 or 7 set) */
+#define DEC_PAD     0x40    /* '=' */
+#define DEC_SKIP    0x80    /* Whitespace */
+#define DEC_BAD     0xC0    /* Not part of the encoding */
+#define PD          DEC_PAD
+#define SK          DEC_SKIP
+#define XX          DEC_BAD
+static const uint8_t b64_dec_table[128] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, SK, SK, XX, XX, SK, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    SK, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, XX, XX, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, PD, XX, XX,
+    XX,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, XX,
+    XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX
+};
+static const uint8_t hex_dec_table[128] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, SK, SK, XX, XX, SK, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    SK, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, XX, XX, XX, XX, XX, XX,
+    XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX
+};
+#undef PD
+#undef SK
+#undef XX
+
+/**
+ * @brief Uplink publish under construction - frames are encoded into buf as they are added
+ */
+typedef struct {
+    char *buf;
+    uint16_t text_max;  /* Encoded characters buf takes (plus terminator) */
+    uint16_t raw_max;   /* Frame bytes per publish */
+    MQTT_QoS_t qos;
+    uint32_t tick;      /* First frame added */
+    uint32_t arrival;   /* UART arrival of that frame */
+    uint32_t inflight_arrival;
+    uint16_t raw;       /* Frame bytes in the publish */
+    uint16_t out;       /* Payload bytes handed to the encoder */
+    uint16_t len;       /* Encoded characters in buf */
+    uint8_t frames;
+    uint8_t inflight;   /* Frames in the publish the modem is working on */
+    bool compress;      /* Frames go through the LZ stage */
+    bool hdr;           /* Frames go as compact header records */
+    bool closed;        /* Encoding finished (publish not started yet) */
+    bool stored;        /* Frames come from the outage log or the parameter cache */
+    bool replay;        /* ... the outage log (replay topic) */
+    bool inflight_stored;
+    bool zc;            /* Frames are the bridge.zc_hold ring bytes at zc_data, not in buf */
+    bool inflight_zc;
+    const uint8_t *zc_data;
+    uint16_t route;     /* Source of the frames (sysid << 8 | compid), ROUTE_BASE for the autopilot */
+    char topic[ROUTE_TOPIC_MAX];    /* Held by the publish in flight */
+    uint32_t enc_acc;   /* Base64 bytes of the partial group */
+    uint8_t enc_n;
+} Lane_t;
+
+/**
+ * @brief Payload encoding - uplink encoder and downlink decoder
+ */
+typedef struct {
+    const char *name;
+    size_t (*encoded_len)(size_t n);    /* Characters for n payload bytes (partial groups included) */
+    size_t (*put)(Lane_t *lane, const uint8_t *data, size_t len, char *out);
+    size_t (*finish)(Lane_t *lane, char *out);  /* Ends the text (NULL: nothing pending) */
+    void (*decode)(const uint8_t *src, size_t len);
+} Codec_t;
+
+/* Link counters, CRC rejects (start bytes that led to no valid frame: bad CRC,
+ * unknown message), downlink duplicates, downlink frames for other vehicles and
+ * state snapshots sent - outside the state below, the metrics registry reads
+ * them in place */
+MavlinkBridge_LinkStats_t bridge_link;
+uint32_t bridge_rejected;
+uint32_t bridge_dl_dups;
+uint32_t bridge_dl_foreign;
+uint32_t bridge_snapshots;
+
 /* Internal State */
 static struct {
     UART_DMA_Handle_t *uart;
     A7600_MQTT_Handle_t *mqtt;
-    uint8_t rx_buf[512];
-    size_t rx_len;
-    uint32_t last_rx_tick;
-    char tx_buf[1100];  /* Max: 512 * 2 + 1 for hex, or 512 * 4/3 + 4 for base64 */
+    size_t rx_len;      /* Unread bytes seen in the DMA ring on last pass */
+    bool rx_new;        /* RX chunks came (or frames were held back) since the last parse */
+    uint32_t partial_due;   /* Time_Us by which the partial frame left over should have completed */
+    uint16_t partial_len;   /* Length the partial frame declares (smallest frame while unknown) */
+    uint32_t frames;    /* Frames handed to MQTT */
+    uint32_t bytes;     /* MAVLink bytes in those frames */
+    struct {
+        uint8_t sysid;
+        uint8_t compid;
+        uint8_t next;   /* Expected seq */
+        uint8_t prio;   /* MavlinkBridge_Priority_t */
+        bool used;
+        bool heard;     /* A frame came (set up by MavlinkBridge_SetSourcePriority otherwise) */
+#if BRIDGE_PRESENCE
+        bool hb_held;   /* hb is the last HEARTBEAT forwarded (cleared offline: the next one goes up) */
+        uint8_t hb[HEARTBEAT_LEN];
+        uint8_t hb_count;   /* HEARTBEATs in the presence interval, forwarded or not (saturates) */
+#endif
+#if BRIDGE_FAIR
+        uint16_t quantum;   /* Bytes per round, 0: BRIDGE_FAIR_QUANTUM (set by MavlinkBridge_SetSourceShare) */
+        int16_t deficit;    /* Bytes left in this round */
+        bool spent;         /* A frame found too few left: done with the round */
+        uint32_t seen;      /* Tick of its last frame bound for the uplink */
+#endif
+    } src[BRIDGE_SOURCES];
+    uint8_t src_evict;  /* Slot taken over by the next new source */
+    uint8_t rate[MSG_COUNT];        /* Uplink limit per msg_table entry, Hz (set at runtime) */
+    uint16_t last_sent[MSG_COUNT];  /* Tick of the last frame sent (16 bits: an ID idle for
+                                     * over 65 s may lose one frame) */
+#if BRIDGE_DEDUP_REFRESH
+    uint16_t last_hash[MSG_COUNT];  /* Source and payload of that frame */
+#endif
+    bool replay_turn;   /* Next publish drains the outage log */
+    uint16_t udp_seq;   /* Sequence number of the next datagram */
+    MQTT_TopicDesc_t topic_tx;      /* BRIDGE_TOPIC_TX and BRIDGE_TOPIC_REPLAY, prepared at init */
+    MQTT_TopicDesc_t topic_replay;
+    uint8_t fc_sysid;   /* Autopilot, from its first HEARTBEAT (0 until heard) */
+    uint8_t fc_compid;
+    bool fc_armed;      /* From the autopilot's last HEARTBEAT */
+    uint8_t fc_state;   /* ... its system_status (MAV_STATE) */
+    uint8_t param_seq;  /* Of the frames we send for the autopilot */
+    bool param_priming; /* Our PARAM_REQUEST_LIST is out - its answer stays off uplink */
+    uint32_t param_prime_tick;
+    uint16_t param_next;    /* Next cache record of a list answer (PARAM_NONE: none) */
+    uint16_t param_read;    /* Cache record answering a PARAM_REQUEST_READ (PARAM_NONE: none) */
+#if BRIDGE_SHAPE
+    uint8_t shaped[MSG_COUNT];                  /* Rate the FC acknowledged per entry, Hz (SHAPE_DEFAULT: its own) */
+    uint8_t shape_seen[(MSG_COUNT + 7) / 8];    /* Sent by the autopilot */
+    uint8_t shape_refused[(MSG_COUNT + 7) / 8]; /* Interval denied - left as it is */
+    int16_t shape_idx;      /* Entry of the command out (-1: none) */
+    uint8_t shape_hz;       /* Rate it asks for */
+    uint8_t shape_tries;    /* Commands in a row without an answer */
+    bool shape_off;         /* The FC does not support the command */
+    bool shape_paused;      /* Waiting BRIDGE_SHAPE_PAUSE after SHAPE_TRIES unanswered */
+    bool shape_dirty;       /* Something changed: entries are compared again */
+    bool shape_offline;     /* Link down for BRIDGE_SHAPE_OFFLINE: outage log rates */
+    bool hb_heard;
+    uint32_t shape_tick;    /* Command sent, or pause start */
+    uint32_t shape_up_tick; /* Link last seen up */
+    uint32_t hb_tick;       /* Last autopilot HEARTBEAT */
+#endif
+#if BRIDGE_AUTOBAUD
+    struct {
+        uint8_t state;      /* AB_x */
+        uint8_t valid;      /* CRC-valid frames since the rate was set (saturates) */
+        uint8_t bad;        /* Frames failing the CRC since then (saturates) */
+        bool doubled;       /* Trying twice the measured rate (v1 start byte) */
+        uint32_t rx;        /* USART1 bytes consumed then */
+        uint32_t tick;
+    } ab;
+#endif
+#if BRIDGE_SHAPER
+    struct {
+        int32_t tokens;     /* Bucket, byte-ms per s (1000 a byte); below 0 batches wait */
+        uint32_t rate;      /* Uplink capacity estimate, B/s */
+        uint32_t tick;      /* Last refill */
+        uint16_t base_ms;   /* Least latency over the last one or two BRIDGE_SHAPER_BASE */
+        uint16_t base_next; /* ... over the current one */
+        uint32_t base_tick;
+        bool held;          /* The last batch offered waited for the bucket */
+    } shaper;
+#endif
+#if BRIDGE_ADAPT
+    uint16_t adapt_min_bytes;   /* Batch budget and deadline bounds (MavlinkBridge_SetBatchBounds) */
+    uint16_t adapt_max_bytes;
+    uint16_t adapt_min_ms;
+    uint16_t adapt_max_ms;
+#endif
+    struct {
+        uint32_t tick[MQTT_PUB_WINDOW];     /* Own publishes in flight, oldest first (the driver */
+        uint16_t len[MQTT_PUB_WINDOW];      /* reports them in order): start, length, PUB_x */
+        uint8_t flags[MQTT_PUB_WINDOW];
+        uint8_t head;
+        uint8_t count;
+        uint32_t done_tick;                 /* Last one reported */
+    } pub;
+#if BRIDGE_BACKPRESSURE
+    uint8_t bp_level;       /* BP_x, from the last pass */
+#endif
+#if BRIDGE_MISSION_PROXY
+    struct {
+        bool active;        /* An upload to the autopilot runs */
+        bool serve;         /* The item the FC asked for is held - the bridge sends it */
+        uint8_t gcs_sysid;  /* Sender of its MISSION_COUNT: items go to the FC as its */
+        uint8_t gcs_compid;
+        uint8_t target[2];  /* target_system, target_component of the MISSION_COUNT */
+        uint8_t seq;
+        uint16_t count;
+        uint16_t want;      /* Item the FC asked for last (MISSION_NONE: it has it) */
+        uint32_t tick;      /* Last request or item */
+    } mp;
+#endif
+#if BRIDGE_PRESENCE
+    uint32_t presence_tick; /* Start of the interval */
+    uint8_t presence_src;   /* Source of the HEARTBEAT being forwarded (BRIDGE_SOURCES: none) */
+    uint8_t presence_hb[HEARTBEAT_LEN];     /* ... its payload, taken as the source's once it is sent */
+#endif
+#if BRIDGE_XFER
+    bool xfer;              /* A log download or FTP session runs */
+    uint32_t xfer_tick;     /* Its last frame from the FC */
+    uint16_t xfer_bytes;    /* Batching it took over, given back when it ends */
+    uint16_t xfer_ms;
+#endif
+    uint32_t radio_tick;    /* Last RADIO_STATUS */
+    uint8_t radio_seq;
+    bool radio_pending;     /* Cloud copy waits for the uplink */
+    bool stamps;            /* Live batches open with a SYSTEM_TIME frame (MavlinkBridge_SetStamps) */
+#if SUMMARY_ENABLE
+    uint16_t summary_ms;    /* Summary interval (0: ATTITUDE / VFR_HUD forwarded as they come) */
+    uint32_t summary_tick;  /* Start of the interval */
+#endif
+#if BRIDGE_STATUS_CARRY
+    MavlinkBridge_StatusFn_t status_fn;     /* Status record waiting for an autopilot batch (NULL: none) */
+    void *status_ctx;
+    uint32_t status_tick;   /* ... handed over */
+    bool status_carried;    /* ... written into one, the caller not told yet */
+#endif
+    const Codec_t *codec;       /* Uplink, and downlink from the next message */
+    const Codec_t *dec_codec;   /* Downlink message being decoded */
+    const Codec_t *codec_next;  /* Switch waiting for the lanes to drain */
+    bool compress_next;
+    bool hdr_next;
+    uint16_t batch_bytes;       /* Batch budget (MavlinkBridge_SetBatching) */
+    uint16_t batch_ms;
+    char tx_buf[BRIDGE_BATCH_MAX / 3 * 4 + 1];  /* Encoded batch plus terminator, or one datagram */
+#if BRIDGE_OVERLAP
+    uint16_t tx_inflight;   /* tx_buf bytes the driver may still read - the open batch is behind them */
+#endif
+#if OUTAGE_LOG_SPI
+    bool ol_lent;       /* tx_buf behind the open batch is the outage queue's (OutageLog_Lend) */
+#endif
+    bool in_pass;       /* A pass is running (an idle hook may come from inside it) */
+    uint16_t zc_hold;   /* Ring bytes in front that a zero-copy batch (open or in flight) owns */
+    bool zc_release;    /* Its publish is done - the bytes may go */
+    char crit_buf[CRIT_TEXT_MAX + 1];
+    Lane_t bulk;        /* Batch in tx_buf */
+    Lane_t crit;        /* Critical frames in crit_buf */
+#if BRIDGE_COMPRESS
+    
+    /* Batch compressor - the window holds the last raw bytes of the batch */
+    uint8_t lz_win[LZ_WINDOW];
+    uint16_t lz_total;      /* Raw bytes through the compressor in this batch */
+    uint16_t lz_lit_start;  /* Pending literal run (still in lz_win) */
+    uint8_t lz_lit_len;
+#endif
+#if BRIDGE_HDR_PACK
+    uint8_t hc_seq;         /* Last record of the batch: seq, source */
+    uint8_t hc_sysid;
+    uint8_t hc_compid;
+#endif
+    
+    /* Downlink stream decoder */
+    uint32_t dec_acc;   /* Bits of the partial group */
+    uint8_t dec_n;      /* Characters in the partial group */
+    uint16_t dec_bad;   /* Invalid characters in the message so far */
+    
+    /* Downlink frame queue: [0, dl_commit) whole frames, then the frame being
+     * decoded. The front goes to the FC zero-copy and is compacted away. */
+    uint8_t dl_q[BRIDGE_DL_QUEUE];
+    uint16_t dl_head;       /* Bytes in dl_q */
+    volatile uint16_t dl_commit;    /* End of the last whole frame (read by the DMA completion) */
+    uint16_t dl_sent;       /* Front bytes handed to DMA */
+    volatile bool dl_busy;  /* Zero-copy TX of the front running */
+    uint16_t dl_cur;        /* Bytes of the current frame seen (kept or not) */
+    uint16_t dl_need;       /* Its length, 0 until the header says */
+    bool dl_v1;
+    bool dl_drop;           /* Current frame did not fit - discarded whole */
+    uint16_t dl_dropped;    /* Frames discarded in the message so far */
+    uint16_t dl_rejected;   /* Frames failing the CRC (or of unknown ID) in it */
+    uint16_t dl_unrouted;   /* Frames for a system or component not heard on this link */
+#if BRIDGE_SNAPSHOT
+    uint8_t snap_pool[BRIDGE_SNAPSHOT_POOL];    /* Last frame of each snapshot message, as it came */
+    uint16_t snap_at[SNAP_COUNT];   /* Its slot in the pool, or SNAP_NONE */
+    uint16_t snap_len[SNAP_COUNT];  /* Its length, 0 until one came */
+    bool snap_pending;      /* Sent with the next autopilot batch that takes all of it */
+#endif
+#if BRIDGE_DL_DEDUP
+    /* Fingerprints of the last frames sent to the FC, oldest overwritten */
+    struct {
+        uint32_t fp[BRIDGE_DL_DEDUP];
+        uint32_t tick[BRIDGE_DL_DEDUP];
+        uint8_t count;      /* Entries filled */
+        uint8_t next;       /* Entry the next frame takes */
+    } dl_seen;
+#endif
 } bridge;
 
+#define BATCH_TEXT_MAX  (sizeof(bridge.tx_buf) - 1)
+#define ENCODED_LEN(n)  (bridge.codec->encoded_len((size_t)(n)))
+
 /* ==================== Encoding Functions ==================== */
 
+/**
+ * @brief Encoded lengths
+ */
+static size_t hex_len(size_t n)
+{
+    return n * 2;
+}
+
+static size_t base64_len(size_t n)
+{
+    return (n + 2) / 3 * 4;
+}
+
+static size_t raw_len(size_t n)
+{
+    return n;
+}
+
+#if !BRIDGE_SWAR || defined(BENCH_HOST)
 /**
  * @brief Convert binary to hex string
  */
-static size_t to_hex(const uint8_t *data, size_t len, char *out)
+static size_t to_hex(Lane_t *lane, const uint8_t *data, size_t len, char *out)
 {
+    (void)lane;
     size_t j = 0;
     for (size_t i = 0; i < len; i++) {
         out[j++] = hex_table[(data[i] >> 4) & 0x0F];
@@ -58,241 +718,4154 @@ static size_t to_hex(const uint8_t *data, size_t len, char *out)
 }
 
 /**
- * @brief Convert binary to Base64 string
+ * @brief Append binary to a Base64 string (a partial group waits for the next call)
  */
-static size_t to_base64(const uint8_t *data, size_t len, char *out)
+RAMFUNC_IF(RAMFUNC_BASE64)
+static size_t to_base64(Lane_t *lane, const uint8_t *data, size_t len, char *out)
 {
-    size_t i, j;
-    uint32_t octet_a, octet_b, octet_c, triple;
+    PROF_BEGIN(PROF_BASE64);
+    size_t j = 0;
     
-    for (i = 0, j = 0; i < len; ) {
-        octet_a = i < len ? data[i++] : 0;
-        octet_b = i < len ? data[i++] : 0;
-        octet_c = i < len ? data[i++] : 0;
-        
-        triple = (octet_a << 16) | (octet_b << 8) | octet_c;
-        
-        out[j++] = b64_table[(triple >> 18) & 0x3F];
-        out[j++] = b64_table[(triple >> 12) & 0x3F];
-        out[j++] = b64_table[(triple >> 6) & 0x3F];
-        out[j++] = b64_table[triple & 0x3F];
+    for (size_t i = 0; i < len; i++) {
+        lane->enc_acc = (lane->enc_acc << 8) | data[i];
+        if (++lane->enc_n == 3) {
+            out[j++] = b64_table[(lane->enc_acc >> 18) & 0x3F];
+            out[j++] = b64_table[(lane->enc_acc >> 12) & 0x3F];
+            out[j++] = b64_table[(lane->enc_acc >> 6) & 0x3F];
+            out[j++] = b64_table[lane->enc_acc & 0x3F];
+            lane->enc_n = 0;
+            lane->enc_acc = 0;
+        }
     }
+    out[j] = '\0';
+    PROF_END(PROF_BASE64);
+    return j;
+}
+#endif
+
+/**
+ * @brief Encode the partial group with padding - ends the Base64 string
+ */
+static size_t base64_finish(Lane_t *lane, char *out)
+{
+    size_t j = 0;
     
-    /* Add padding */
-    size_t mod = len % 3;
-    if (mod == 1) {
-        out[j - 1] = '=';
-        out[j - 2] = '=';
-    } else if (mod == 2) {
-        out[j - 1] = '=';
+    if (lane->enc_n == 1) {
+        out[j++] = b64_table[(lane->enc_acc >> 2) & 0x3F];
+        out[j++] = b64_table[(lane->enc_acc << 4) & 0x3F];
+        out[j++] = '=';
+        out[j++] = '=';
+    } else if (lane->enc_n == 2) {
+        out[j++] = b64_table[(lane->enc_acc >> 10) & 0x3F];
+        out[j++] = b64_table[(lane->enc_acc >> 4) & 0x3F];
+        out[j++] = b64_table[(lane->enc_acc << 2) & 0x3F];
+        out[j++] = '=';
+    }
+    lane->enc_n = 0;
+    lane->enc_acc = 0;
+    out[j] = '\0';
+    return j;
+}
+
+#if BRIDGE_SWAR
+/* SWAR encoders: the characters of a word are worked on at once, each in its
+ * own byte, by adds and masks that never carry into the next byte. The
+ * output is the same as the table versions', which the bench checks */
+
+/**
+ * @brief Four characters to out, the first in the low byte - one store when out is aligned
+ */
+static void put_word(char *out, uint32_t w)
+{
+    if (((uintptr_t)out & 3U) == 0) {
+        *(uint32_t *)out = w;   /* Little endian */
+    } else {
+        out[0] = (char)w;
+        out[1] = (char)(w >> 8);
+        out[2] = (char)(w >> 16);
+        out[3] = (char)(w >> 24);
     }
+}
+
+/**
+ * @brief Hex digits of two bytes: nibbles spread one per byte, '0' added, 7 more over 9
+ */
+static uint32_t hex_word(uint8_t a, uint8_t b)
+{
+    uint32_t y = a | ((uint32_t)b << 16);
+    uint32_t x = ((y >> 4) & 0x000F000FU) | ((y & 0x000F000FU) << 8);
+    uint32_t letter = ((x + 0x06060606U) >> 4) & 0x01010101U;   /* 1 where a nibble is over 9 */
+    
+    return x + 0x30303030U + letter * 7U;
+}
+
+/**
+ * @brief Base64 characters of a 24-bit group: the four indexes one per byte, then the
+ *        offset of their range (A-Z, a-z, 0-9, '+', '/') from per-byte compares
+ */
+static uint32_t b64_word(uint32_t v)
+{
+    uint32_t x = (v >> 18) | ((v >> 4) & 0x3F00U) | ((v << 10) & 0x3F0000U) | ((v & 0x3FU) << 24);
+    /* Bit 7 of a byte with 0x80 - k added: index >= k (indexes are under 64, nothing carries) */
+    uint32_t ge26 = ((x + 0x66666666U) >> 7) & 0x01010101U;
+    uint32_t ge52 = ((x + 0x4C4C4C4CU) >> 7) & 0x01010101U;
+    uint32_t ge62 = ((x + 0x42424242U) >> 7) & 0x01010101U;
+    uint32_t ge63 = ((x + 0x41414141U) >> 7) & 0x01010101U;
+    
+    /* 'A', 'a' - 26, '0' - 52, '+' - 62, '/' - 63: each byte ends in range, so borrows cancel out */
+    return x + 0x41414141U + ge26 * 6U - ge52 * 75U - ge62 * 15U + ge63 * 3U;
+}
+
+/**
+ * @brief Convert binary to hex string, two bytes per word
+ */
+static size_t to_hex_swar(Lane_t *lane, const uint8_t *data, size_t len, char *out)
+{
+    (void)lane;
+    size_t i = 0;
+    size_t j = 0;
     
+    for (; i + 2 <= len; i += 2, j += 4) {
+        put_word(&out[j], hex_word(data[i], data[i + 1]));
+    }
+    if (i < len) {
+        out[j++] = hex_table[data[i] >> 4];
+        out[j++] = hex_table[data[i] & 0x0F];
+    }
     out[j] = '\0';
     return j;
 }
 
 /**
- * @brief Convert Hex string to binary
+ * @brief Append binary to a Base64 string, a group per word (a partial group waits for the next call)
  */
-static size_t from_hex(const char *src, size_t len, uint8_t *out)
+RAMFUNC_IF(RAMFUNC_BASE64)
+static size_t to_base64_swar(Lane_t *lane, const uint8_t *data, size_t len, char *out)
 {
+    PROF_BEGIN(PROF_BASE64);
+    size_t i = 0;
     size_t j = 0;
-    for (size_t i = 0; i < len; i += 2) {
-        if (i + 1 >= len) break;
-        
-        char c1 = src[i];
-        char c2 = src[i+1];
-        
-        uint8_t v1 = (c1 >= '0' && c1 <= '9') ? c1 - '0' : 
-                     (c1 >= 'A' && c1 <= 'F') ? c1 - 'A' + 10 : 
-                     (c1 >= 'a' && c1 <= 'f') ? c1 - 'a' + 10 : 0;
-                     
-        uint8_t v2 = (c2 >= '0' && c2 <= '9') ? c2 - '0' : 
-                     (c2 >= 'A' && c2 <= 'F') ? c2 - 'A' + 10 : 
-                     (c2 >= 'a' && c2 <= 'f') ? c2 - 'a' + 10 : 0;
-                     
-        out[j++] = (v1 << 4) | v2;
+    
+    /* The group the last call left open first */
+    while (lane->enc_n != 0 && i < len) {
+        lane->enc_acc = (lane->enc_acc << 8) | data[i++];
+        if (++lane->enc_n == 3) {
+            put_word(&out[j], b64_word(lane->enc_acc));
+            j += 4;
+            lane->enc_n = 0;
+            lane->enc_acc = 0;
+        }
+    }
+    for (; i + 3 <= len; i += 3, j += 4) {
+        put_word(&out[j], b64_word(((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2]));
+    }
+    for (; i < len; i++) {
+        lane->enc_acc = (lane->enc_acc << 8) | data[i];
+        lane->enc_n++;
     }
+    out[j] = '\0';
+    PROF_END(PROF_BASE64);
     return j;
 }
 
+#define CODEC_TO_HEX            to_hex_swar
+#define CODEC_TO_BASE64         to_base64_swar
+#else
+#define CODEC_TO_HEX            to_hex
+#define CODEC_TO_BASE64         to_base64
+#endif
+
+/**
+ * @brief Copy binary as is (the payload is length-prefixed, no terminator needed)
+ */
+static size_t to_raw(Lane_t *lane, const uint8_t *data, size_t len, char *out)
+{
+    (void)lane;
+    memcpy(out, data, len);
+    return len;
+}
+
+/**
+ * @brief Byte at logical offset in the two-span RX view
+ */
+static uint8_t span_byte(const UART_DMA_Span_t *s1, const UART_DMA_Span_t *s2, size_t pos)
+{
+    return (pos < s1->len) ? s1->data[pos] : s2->data[pos - s1->len];
+}
+
 /**
- * @brief Convert Base64 string to binary
+ * @brief First start byte in a block
+ * @return Pointer to it, or NULL
  */
-static int b64_val(char c) {
-    if (c >= 'A' && c <= 'Z') return c - 'A';
-    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
-    if (c >= '0' && c <= '9') return c - '0' + 52;
-    if (c == '+') return 62;
-    if (c == '/') return 63;
-    return -1;
+RAMFUNC_IF(RAMFUNC_MAV_PARSE)
+static const uint8_t *find_start(const uint8_t *data, size_t len)
+{
+#if BRIDGE_MAVLINK_V1 || RAMFUNC_MAV_PARSE
+    /* Own loop in SRAM - the library's memchr runs from flash */
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == MAVLINK_V2_MAGIC || (BRIDGE_MAVLINK_V1 && data[i] == MAVLINK_V1_MAGIC)) {
+            return &data[i];
+        }
+    }
+    return NULL;
+#else
+    return memchr(data, MAVLINK_V2_MAGIC, len);
+#endif
 }
 
-static size_t from_base64(const char *src, size_t len, uint8_t *out)
+/**
+ * @brief Check for a start byte at an offset of the two-span view
+ */
+static bool span_is_start(const UART_DMA_Span_t *s1, const UART_DMA_Span_t *s2, size_t pos)
 {
-    size_t i = 0, j = 0;
-    int v1, v2, v3, v4;
+    uint8_t c = span_byte(s1, s2, pos);
     
-    while (i < len) {
-        /* Skip non-base64 chars (newlines, etc) */
-        while (i < len && b64_val(src[i]) == -1 && src[i] != '=') i++;
-        if (i >= len) break;
-        
-        v1 = b64_val(src[i++]);
-        
-        while (i < len && b64_val(src[i]) == -1 && src[i] != '=') i++;
-        if (i >= len) break;
-        v2 = b64_val(src[i++]);
-        
-        while (i < len && b64_val(src[i]) == -1 && src[i] != '=') i++;
-        if (i >= len) break;
-        char c3 = src[i++];
-        v3 = (c3 == '=') ? 0 : b64_val(c3);
-        
-        while (i < len && b64_val(src[i]) == -1 && src[i] != '=') i++;
-        if (i >= len) break;
-        char c4 = src[i++];
-        v4 = (c4 == '=') ? 0 : b64_val(c4);
-        
-        if (v1 >= 0 && v2 >= 0) {
-            out[j++] = (v1 << 2) | ((v2 >> 4) & 0x03);
-            if (c3 != '=') {
-                out[j++] = ((v2 << 4) & 0xF0) | ((v3 >> 2) & 0x0F);
-                if (c4 != '=') {
-                    out[j++] = ((v3 << 6) & 0xC0) | (v4 & 0x3F);
-                }
-            }
+    return (c == MAVLINK_V2_MAGIC || (BRIDGE_MAVLINK_V1 && c == MAVLINK_V1_MAGIC));
+}
+
+/**
+ * @brief Offset of the next start byte at or after pos in the two-span RX view
+ * @return Offset, or the view length if there is none
+ */
+RAMFUNC_IF(RAMFUNC_MAV_PARSE)
+static size_t span_sync(const UART_DMA_Span_t *s1, const UART_DMA_Span_t *s2, size_t pos)
+{
+    const uint8_t *hit;
+    
+    if (pos < s1->len) {
+        hit = find_start(&s1->data[pos], s1->len - pos);
+        if (hit != NULL) {
+            return (size_t)(hit - s1->data);
         }
+        pos = s1->len;
     }
-    return j;
+    if (pos - s1->len >= s2->len) {
+        return s1->len + s2->len;
+    }
+    hit = find_start(&s2->data[pos - s1->len], s2->len - (pos - s1->len));
+    return (hit != NULL) ? s1->len + (size_t)(hit - s2->data) : s1->len + s2->len;
 }
 
 /**
- * @brief Send MAVLink frame with selected encoding
+ * @brief Locate a frame in the RX view as up to two pieces of DMA memory
+ * @note  part[1] is empty unless the frame wraps the ring end - nothing is copied
  */
-static void send_frame(const uint8_t *frame, size_t len)
+static void span_frame(const UART_DMA_Span_t *s1, const UART_DMA_Span_t *s2,
+                       size_t pos, size_t len, UART_DMA_Span_t part[2])
 {
-    if (bridge.mqtt && A7600_MQTT_IsConnected(bridge.mqtt)) {
-        size_t encoded_len;
-        
-        #if BRIDGE_ENCODING == ENCODE_BASE64
-            encoded_len = to_base64(frame, len, bridge.tx_buf);
-        #else
-            encoded_len = to_hex(frame, len, bridge.tx_buf);
-        #endif
-        
-        A7600_MQTT_PublishString(bridge.mqtt, BRIDGE_TOPIC_TX, bridge.tx_buf, MQTT_QOS_0);
+    if (pos >= s1->len) {
+        part[0].data = &s2->data[pos - s1->len];
+        part[0].len = len;
+    } else {
+        part[0].data = &s1->data[pos];
+        part[0].len = (pos + len <= s1->len) ? len : s1->len - pos;
     }
+    part[1].data = s2->data;
+    part[1].len = len - part[0].len;
 }
 
-/* ==================== Public Functions ==================== */
+/**
+ * @brief Entry of a message in msg_table - indexes rate and last_sent as well
+ * @return Index, or -1 if the message is not forwarded
+ */
+static int msg_index(uint32_t msgid)
+{
+    uint8_t slot = msg_slot[MAV_MSGS_HASH(msgid)];
+    
+    /* Collision-free over the table's IDs: any other ID fails the compare */
+    if (slot == 0 || msg_table[slot - 1].msgid != msgid) {
+        return -1;
+    }
+    return slot - 1;
+}
 
-void MavlinkBridge_Init(UART_DMA_Handle_t *uart, A7600_MQTT_Handle_t *mqtt)
+/**
+ * @brief Check a payload length against the message's definition
+ * @note  A v1 frame carries exactly the base fields; a v2 payload may be cut
+ *        short (trailing zeros), never longer than with all extensions
+ */
+static bool msg_len_valid(int idx, bool v1, uint8_t len)
 {
-    bridge.uart = uart;
-    bridge.mqtt = mqtt;
-    bridge.rx_len = 0;
-    bridge.last_rx_tick = 0;
-    memset(bridge.rx_buf, 0, sizeof(bridge.rx_buf));
+    return v1 ? (len == msg_table[idx].min_len) : (len <= msg_table[idx].max_len);
 }
 
-void MavlinkBridge_Process(void)
+/**
+ * @brief Check the X.25 checksum of a complete frame
+ * @param end Header plus payload length - the checksum follows
+ */
+RAMFUNC_IF(RAMFUNC_MAV_PARSE)
+static bool frame_valid(const UART_DMA_Span_t part[2], size_t end, uint8_t extra)
 {
-    if (bridge.uart == NULL || bridge.mqtt == NULL) return;
-    if (!A7600_MQTT_IsConnected(bridge.mqtt)) return;
+    PROF_BEGIN(PROF_MAV_CRC);
+    size_t first = (part[0].len < end) ? part[0].len : end;
+    uint16_t crc = MAVLINK_CRC_INIT;
+    size_t i;
+    bool ok;
+    
+    /* Covers the header after the start byte, the payload, then CRC_EXTRA */
+    for (i = 1; i < first; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ part[0].data[i]) & 0xFF];
+    }
+    for (; i < end; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ part[1].data[i - part[0].len]) & 0xFF];
+    }
+    crc = (crc >> 8) ^ crc_table[(crc ^ extra) & 0xFF];
+    ok = (span_byte(&part[0], &part[1], end) == (uint8_t)crc &&
+          span_byte(&part[0], &part[1], end + 1) == (uint8_t)(crc >> 8));
+    PROF_END(PROF_MAV_CRC);
+    return ok;
+}
 
-    uint32_t now = HAL_GetTick();
+/**
+ * @brief Complete a v2 frame around the payload at f[MAVLINK_HEADER_LEN] (trailing zeros dropped)
+ * @return Frame length
+ */
+static size_t frame_seal(uint8_t *f, size_t len, uint8_t seq, uint8_t sysid, uint8_t compid, uint32_t msgid)
+{
+    uint16_t crc = MAVLINK_CRC_INIT;
+    size_t end;
+    
+    while (len > 1 && f[MAVLINK_HEADER_LEN + len - 1] == 0) {
+        len--;
+    }
+    f[0] = MAVLINK_V2_MAGIC;
+    f[1] = (uint8_t)len;
+    f[2] = 0;
+    f[3] = 0;
+    f[4] = seq;
+    f[5] = sysid;
+    f[6] = compid;
+    f[7] = (uint8_t)msgid;
+    f[8] = (uint8_t)(msgid >> 8);
+    f[9] = (uint8_t)(msgid >> 16);
+    
+    end = MAVLINK_HEADER_LEN + len;
+    for (size_t i = 1; i < end; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ f[i]) & 0xFF];
+    }
+    crc = (crc >> 8) ^ crc_table[(crc ^ msg_table[msg_index(msgid)].extra) & 0xFF];
+    f[end] = (uint8_t)crc;
+    f[end + 1] = (uint8_t)(crc >> 8);
+    return end + MAVLINK_CHECKSUM_LEN;
+}
 
-    /* 1. Read available data */
-    size_t available = UART_DMA_Available(bridge.uart);
-    if (available > 0) {
-        size_t space = sizeof(bridge.rx_buf) - bridge.rx_len;
-        if (available > space) available = space;
+/* Frame re-encoded for the uplink: its own header and checksum around the payload in DMA memory */
+typedef struct {
+    uint8_t head[MAVLINK_HEADER_LEN];
+    uint8_t crc[MAVLINK_CHECKSUM_LEN];
+    UART_DMA_Span_t part[PACK_PARTS];   /* Header, payload (up to two pieces), checksum */
+    size_t len;                         /* Frame length */
+    uint8_t cut;                        /* Trailing payload zeros left out */
+} Pack_t;
 
-        if (available > 0) {
-            size_t read = UART_DMA_Read(bridge.uart, &bridge.rx_buf[bridge.rx_len], available);
-            bridge.rx_len += read;
-            bridge.last_rx_tick = now;
+#if BRIDGE_V2_PACK
+/**
+ * @brief Re-encode a valid frame as v2 with the payload's trailing zeros cut
+ * @note  A v1 frame gets a v2 header, a v2 frame keeps its own with the new
+ *        length; signed frames stay as they are (the signature covers the
+ *        bytes). The payload is not copied
+ * @return true if re-encoded, false if the frame goes as it is
+ */
+static bool frame_pack(const UART_DMA_Span_t part[2], bool v1, uint8_t extra, Pack_t *pk)
+{
+    size_t header_len = v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+    uint8_t len = span_byte(&part[0], &part[1], 1);
+    uint8_t keep = len;
+    uint16_t crc = MAVLINK_CRC_INIT;
+    
+    if (!v1 && (span_byte(&part[0], &part[1], 2) & MAVLINK_IFLAG_SIGNED)) {
+        return false;
+    }
+    while (keep > 1 && span_byte(&part[0], &part[1], header_len + keep - 1) == 0) {
+        keep--;
+    }
+    if (!v1 && keep == len) {
+        return false;
+    }
+    
+    if (v1) {
+        /* seq, sysid, compid, then the 8-bit ID widened */
+        pk->head[0] = MAVLINK_V2_MAGIC;
+        pk->head[2] = 0;
+        pk->head[3] = 0;
+        for (size_t i = 2; i < MAVLINK_V1_HEADER_LEN; i++) {
+            pk->head[i + 2] = span_byte(&part[0], &part[1], i);
+        }
+        pk->head[8] = 0;
+        pk->head[9] = 0;
+    } else {
+        for (size_t i = 0; i < MAVLINK_HEADER_LEN; i++) {
+            pk->head[i] = span_byte(&part[0], &part[1], i);
         }
     }
-
-    /* 2. Check for timeout (incomplete frame) - discard silently */
-    if (bridge.rx_len > 0 && (now - bridge.last_rx_tick > FRAME_TIMEOUT_MS)) {
-        bridge.rx_len = 0;
-        return;
+    pk->head[1] = keep;
+    
+    for (size_t i = 1; i < MAVLINK_HEADER_LEN; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ pk->head[i]) & 0xFF];
+    }
+    for (size_t i = 0; i < keep; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ span_byte(&part[0], &part[1], header_len + i)) & 0xFF];
     }
+    crc = (crc >> 8) ^ crc_table[(crc ^ extra) & 0xFF];
+    pk->crc[0] = (uint8_t)crc;
+    pk->crc[1] = (uint8_t)(crc >> 8);
+    
+    pk->part[0].data = pk->head;
+    pk->part[0].len = MAVLINK_HEADER_LEN;
+    span_frame(&part[0], &part[1], header_len, keep, &pk->part[1]);
+    pk->part[3].data = pk->crc;
+    pk->part[3].len = MAVLINK_CHECKSUM_LEN;
+    pk->len = MAVLINK_HEADER_LEN + keep + MAVLINK_CHECKSUM_LEN;
+    pk->cut = (uint8_t)(len - keep);
+    return true;
+}
+#endif
 
-    /* 3. Parse MAVLink frames */
-    while (bridge.rx_len > 0) {
-        /* Sync: Find magic byte */
-        if (bridge.rx_buf[0] != MAVLINK_V2_MAGIC) {
-            memmove(bridge.rx_buf, &bridge.rx_buf[1], bridge.rx_len - 1);
-            bridge.rx_len--;
-            continue;
-        }
+/**
+ * @brief Check whether a source was configured (priority or share) - kept in the table
+ */
+static bool source_kept(uint8_t slot)
+{
+#if BRIDGE_FAIR
+    if (bridge.src[slot].quantum != 0) {
+        return true;
+    }
+#endif
+    return (bridge.src[slot].prio != BRIDGE_PRIO_NORMAL);
+}
 
-        /* Need at least 3 bytes */
-        if (bridge.rx_len < 3) {
-            break;
+/**
+ * @brief Table slot of a source - a new one takes a free slot, or the oldest learned one
+ * @note  Sources given a priority are kept while learned ones can make room
+ */
+static uint8_t source_slot(uint8_t sysid, uint8_t compid)
+{
+    uint8_t i;
+    
+    for (i = 0; i < BRIDGE_SOURCES; i++) {
+        if (bridge.src[i].used && bridge.src[i].sysid == sysid && bridge.src[i].compid == compid) {
+            return i;
         }
-
-        uint8_t payload_len = bridge.rx_buf[1];
-        uint8_t incompat_flags = bridge.rx_buf[2];
+    }
+    for (i = 0; i < BRIDGE_SOURCES && bridge.src[i].used; i++) {
+    }
+    for (uint8_t n = 0; i == BRIDGE_SOURCES && n < BRIDGE_SOURCES; n++) {
+        uint8_t k = bridge.src_evict;
         
-        uint16_t packet_len = MAVLINK_HEADER_LEN + payload_len + MAVLINK_CHECKSUM_LEN;
-        if (incompat_flags & MAVLINK_IFLAG_SIGNED) {
-            packet_len += MAVLINK_SIG_LEN;
+        bridge.src_evict = (uint8_t)((k + 1) % BRIDGE_SOURCES);
+        if (!source_kept(k) || n == BRIDGE_SOURCES - 1) {
+            i = k;
         }
+    }
+    memset(&bridge.src[i], 0, sizeof(bridge.src[i]));
+    bridge.src[i].sysid = sysid;
+    bridge.src[i].compid = compid;
+    bridge.src[i].used = true;
+    return i;
+}
 
-        /* Sanity check */
-        if (packet_len > 300) {
-            memmove(bridge.rx_buf, &bridge.rx_buf[1], bridge.rx_len - 1);
-            bridge.rx_len--;
-            continue;
-        }
+/**
+ * @brief Follow the seq of the frame's source - skipped numbers are frames lost before the bridge
+ * @return Table slot of the source
+ */
+static uint8_t source_track(const UART_DMA_Span_t *s1, const UART_DMA_Span_t *s2, size_t pos, bool v1)
+{
+    uint8_t seq = span_byte(s1, s2, pos + (v1 ? 2 : 4));
+    uint8_t i = source_slot(span_byte(s1, s2, pos + (v1 ? 3 : 5)), span_byte(s1, s2, pos + (v1 ? 4 : 6)));
+    uint8_t gap = (uint8_t)(seq - bridge.src[i].next);
+    
+    /* A new source starts without a gap; 255 is the last frame again - one held for the next pass */
+    if (!bridge.src[i].heard) {
+        bridge.src[i].heard = true;
+    } else if (gap == 255) {
+        return i;
+    } else {
+        bridge_link.seq_lost += gap;
+    }
+    bridge.src[i].next = (uint8_t)(seq + 1);
+    return i;
+}
 
-        /* Check if complete frame available */
-        if (bridge.rx_len >= packet_len) {
-            /* Complete frame! Send with selected encoding */
-            send_frame(bridge.rx_buf, packet_len);
-            
-            /* Remove from buffer */
-            if (bridge.rx_len > packet_len) {
-                memmove(bridge.rx_buf, &bridge.rx_buf[packet_len], bridge.rx_len - packet_len);
-            }
-            bridge.rx_len -= packet_len;
-        } else {
-            break;
-        }
+/**
+ * @brief Route key of a source - autopilots keep the plain tx topic
+ */
+static uint16_t source_route(uint8_t slot)
+{
+    if (bridge.src[slot].compid == MAV_COMP_ID_AUTOPILOT1) {
+        return ROUTE_BASE;
     }
+    return (uint16_t)((bridge.src[slot].sysid << 8) | bridge.src[slot].compid);
 }
 
-void MavlinkBridge_OnMessage(const char *topic, const uint8_t *payload, size_t len)
+#if BRIDGE_FAIR
+static uint16_t fair_quantum(uint8_t slot)
 {
-    if (bridge.uart == NULL) return;
+    if (bridge.src[slot].quantum != 0) {
+        return bridge.src[slot].quantum;
+    }
+    return (bridge.src[slot].compid == MAV_COMP_ID_AUTOPILOT1) ? BRIDGE_FAIR_QUANTUM_FC : BRIDGE_FAIR_QUANTUM;
+}
+
+/**
+ * @brief Deficit round robin: check whether a source has the bytes of a frame
+ *        left in this round. One that has not is done with the round, which
+ *        ends once every source sending lately is: each of those is given its
+ *        quantum again, a quiet one starts its turn with its first frame
+ * @note  There are no per-source queues (the frames wait in the USART1 ring,
+ *        in order), so a frame over its source's share is dropped, not held
+ * @return true if the frame may go up
+ */
+static bool fair_due(uint8_t src, size_t len, uint32_t now)
+{
+    /* Back from quiet: its turn comes at once */
+    if (now - bridge.src[src].seen >= BRIDGE_FAIR_IDLE) {
+        bridge.src[src].deficit = (int16_t)fair_quantum(src);
+        bridge.src[src].spent = false;
+    }
+    bridge.src[src].seen = now;
+    if (bridge.src[src].deficit >= (int16_t)len) {
+        return true;
+    }
+    bridge.src[src].spent = true;
+    for (uint8_t i = 0; i < BRIDGE_SOURCES; i++) {
+        if (bridge.src[i].used && !bridge.src[i].spent && now - bridge.src[i].seen < BRIDGE_FAIR_IDLE) {
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < BRIDGE_SOURCES; i++) {
+        int16_t quantum = (int16_t)fair_quantum(i);
+        
+        bridge.src[i].spent = false;
+        if (!bridge.src[i].used || now - bridge.src[i].seen >= BRIDGE_FAIR_IDLE) {
+            bridge.src[i].deficit = 0;
+        } else if (bridge.src[i].deficit < INT16_MAX - quantum) {
+            bridge.src[i].deficit += quantum;
+        }
+    }
+    return (bridge.src[src].deficit >= (int16_t)len);
+}
 
-    LOG_INFO("Bridge Rx Msg: Topic=%s Len=%d", topic, len);
+/**
+ * @brief Check whether the uplink is congested - the rounds are run then only
+ */
+static bool fair_congested(void)
+{
+#if BRIDGE_BACKPRESSURE
+    if (bridge.bp_level >= BP_THIN) {
+        return true;
+    }
+#endif
+#if BRIDGE_SHAPER
+    if (bridge.shaper.tokens < 0) {
+        return true;
+    }
+#endif
+    return false;
+}
 
-    /* Check if topic matches RX topic (flexible match) */
-    if (strstr(topic, "mavlink/rx") != NULL) {
-        static uint8_t decode_buf[512];
-        size_t decoded_len = 0;
+/**
+ * @brief Take a frame handed on out of its source's round (nothing left: 0)
+ */
+static void fair_charge(uint8_t src, size_t len)
+{
+    bridge.src[src].deficit = (bridge.src[src].deficit > (int16_t)len) ?
+                              (int16_t)(bridge.src[src].deficit - (int16_t)len) : 0;
+}
+#endif
 
-        #if BRIDGE_ENCODING == ENCODE_BASE64
-            decoded_len = from_base64((const char*)payload, len, decode_buf);
-            LOG_INFO("Decoded Base64: %d bytes", decoded_len);
-        #else
-            decoded_len = from_hex((const char*)payload, len, decode_buf);
-            LOG_INFO("Decoded Hex: %d bytes", decoded_len);
-        #endif
+/**
+ * @brief Copy payload bytes from offset on, zero-filled past the end (v2 trims trailing zeros)
+ */
+static void frame_payload(const UART_DMA_Span_t part[2], size_t header_len, size_t offset, uint8_t *out,
+                          size_t max)
+{
+    uint8_t len = span_byte(&part[0], &part[1], 1);
+    
+    for (size_t i = 0; i < max; i++) {
+        out[i] = (offset + i < len) ? span_byte(&part[0], &part[1], header_len + offset + i) : 0;
+    }
+}
 
-        if (decoded_len > 0) {
-            /* Forward to UART */
-            UART_DMA_Transmit(bridge.uart, decode_buf, decoded_len);
-        } else {
-            LOG_ERROR("Decode Failed or Empty");
+/**
+ * @brief Time_Us by which a partial frame must be complete: its declared length
+ *        at the USART1 baud rate from its first byte, plus FRAME_SLACK_US
+ * @param pos Start byte of the partial frame among the unread data
+ * @param len Receives the declared length
+ */
+static uint32_t partial_due(const UART_DMA_Span_t *s1, const UART_DMA_Span_t *s2, size_t pos, size_t available,
+                            uint16_t *len)
+{
+    uint32_t baud = UART_DMA_GetBaudRate(bridge.uart);
+    size_t need = MAVLINK_V1_HEADER_LEN + MAVLINK_CHECKSUM_LEN;     /* Length not in yet: smallest frame */
+    
+    if (available - pos >= 2) {
+        bool v1 = (span_byte(s1, s2, pos) == MAVLINK_V1_MAGIC);
+        
+        need = (size_t)(v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN) + span_byte(s1, s2, pos + 1) +
+               MAVLINK_CHECKSUM_LEN;
+        if (!v1 && available - pos >= 3 && (span_byte(s1, s2, pos + 2) & MAVLINK_IFLAG_SIGNED)) {
+            need += MAVLINK_SIG_LEN;
+        }
+    }
+    *len = (uint16_t)need;
+    return UART_DMA_RxArrivalUs(bridge.uart, pos) +
+           (uint32_t)((need * UART_BITS_PER_BYTE * 1000000U + baud - 1) / baud) + FRAME_SLACK_US;
+}
+
+#if BRIDGE_SHAPE
+/**
+ * @brief Entry whose interval at the FC the bridge sets: sent by the autopilot,
+ *        not refused, and not needed at full rate by an on-board consumer
+ */
+static bool shape_managed(size_t idx)
+{
+    uint8_t bit = (uint8_t)(1U << (idx % 8));
+    
+    if (!(bridge.shape_seen[idx / 8] & bit) || (bridge.shape_refused[idx / 8] & bit)) {
+        return false;
+    }
+#if ANOMALY_ENABLE
+    if (Anomaly_Wants(msg_table[idx].msgid)) {
+        return false;
+    }
+#endif
+#if SUMMARY_ENABLE
+    if (Summary_Wants(msg_table[idx].msgid)) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Rate to ask the FC for: the uplink limit, or the outage log rate while
+ *        the link has been down a while (limited messages only - others keep
+ *        the FC's own rate)
+ * @return Hz, 0 for off, SHAPE_DEFAULT for the FC's own rate
+ */
+static uint8_t shape_want(size_t idx)
+{
+    uint8_t hz = bridge.rate[idx];
+    
+    if (hz != RATE_ALWAYS && bridge.shape_offline && msg_table[idx].keep < hz) {
+        hz = msg_table[idx].keep;
+    }
+    return hz;
+}
+
+/**
+ * @brief The FC already sends a message at the rate the bridge would decimate
+ *        it to - a second cut here would halve it (a pass takes frames in bunches)
+ */
+static bool shape_holds(size_t idx)
+{
+    uint8_t hz;
+    
+    if (bridge.shape_off || !shape_managed(idx)) {
+        return false;
+    }
+    hz = shape_want(idx);
+    return (hz != SHAPE_DEFAULT && hz != 0 && bridge.shaped[idx] == hz);
+}
+#endif
+
+/**
+ * @brief Check whether a message is due under its uplink limit
+ */
+static bool rate_due(int idx, uint16_t now)
+{
+    uint8_t hz = bridge.rate[idx];
+    
+    if (hz == BRIDGE_RATE_ALWAYS) {
+        return true;
+    }
+#if BRIDGE_SHAPE
+    if (!bridge.shape_offline && shape_holds((size_t)idx)) {
+        return true;
+    }
+#endif
+    uint16_t per_s = hz;
+#if ANOMALY_ENABLE
+    /* An event on the autopilot: its state streams go up faster for a while */
+    per_s *= Anomaly_RateBoost(msg_table[idx].msgid);
+#endif
+    return (hz != 0 && (uint16_t)(now - bridge.last_sent[idx]) >= 1000 / per_s);
+}
+
+/**
+ * @brief Check whether a message is due in the outage log (shares last_sent with the uplink limit)
+ */
+static bool keep_due(int idx, uint16_t now)
+{
+    uint8_t hz = msg_table[idx].keep;
+    
+    if (hz == RATE_ALWAYS) {
+        return true;
+    }
+#if BRIDGE_SHAPE
+    if (bridge.shape_offline && shape_holds((size_t)idx)) {
+        return true;
+    }
+#endif
+    return (hz != 0 && (uint16_t)(now - bridge.last_sent[idx]) >= 1000 / hz);
+}
+
+/**
+ * @brief Hash of a frame's source (sysid, compid) and payload past the dedup bytes
+ */
+RAMFUNC_IF(RAMFUNC_MAV_PARSE)
+static uint16_t frame_hash(const UART_DMA_Span_t part[2], bool v1, size_t header_len, size_t end, uint8_t dedup)
+{
+    uint16_t crc = MAVLINK_CRC_INIT;
+    size_t src = v1 ? 3 : 5;
+    
+    crc = (crc >> 8) ^ crc_table[(crc ^ span_byte(&part[0], &part[1], src)) & 0xFF];
+    crc = (crc >> 8) ^ crc_table[(crc ^ span_byte(&part[0], &part[1], src + 1)) & 0xFF];
+    for (size_t i = header_len + dedup; i < end; i++) {
+        crc = (crc >> 8) ^ crc_table[(crc ^ span_byte(&part[0], &part[1], i)) & 0xFF];
+    }
+    return crc;
+}
+
+/**
+ * @brief Check whether a frame repeats the last one sent for its message inside the refresh interval
+ */
+static bool frame_unchanged(int idx, uint16_t hash, uint16_t now)
+{
+#if BRIDGE_DEDUP_REFRESH
+    return (msg_table[idx].dedup != DEDUP_OFF && hash == bridge.last_hash[idx] &&
+            (uint16_t)(now - bridge.last_sent[idx]) < BRIDGE_DEDUP_REFRESH);
+#else
+    (void)idx; (void)hash; (void)now;
+    return false;
+#endif
+}
+
+/**
+ * @brief Record a frame handed on - rate limit and dedup both start from it
+ * @param pk The frame as it went up, NULL if as it came
+ */
+static void frame_sent(int idx, uint16_t hash, const Pack_t *pk, uint16_t now)
+{
+    bridge.last_sent[idx] = now;
+    if (pk != NULL) {
+        bridge_link.packed++;
+        bridge_link.pack_saved += pk->cut;
+    }
+#if BRIDGE_DEDUP_REFRESH
+    bridge.last_hash[idx] = hash;
+#else
+    (void)hash;
+#endif
+#if BRIDGE_XFER
+    if (msg_table[idx].msgid == LOG_DATA_ID || msg_table[idx].msgid == FILE_TRANSFER_PROTOCOL_ID) {
+        bridge_link.xfer_frames++;
+    }
+#endif
+#if BRIDGE_PRESENCE
+    if (msg_table[idx].msgid == HEARTBEAT_ID && bridge.presence_src < BRIDGE_SOURCES) {
+        uint8_t s = bridge.presence_src;
+        
+        memcpy(bridge.src[s].hb, bridge.presence_hb, HEARTBEAT_LEN);
+        bridge.src[s].hb_held = true;
+        if (bridge.src[s].hb_count < UINT8_MAX) {
+            bridge.src[s].hb_count++;
+        }
+        bridge.presence_src = BRIDGE_SOURCES;
+    }
+#endif
+}
+
+/**
+ * @brief Check whether a frame still fits the open publish of a lane
+ */
+static bool lane_fits(const Lane_t *lane, size_t len)
+{
+    size_t in = len + (lane->hdr && lane->frames == 0);    /* A record is shorter than its frame */
+    size_t raw = lane->raw + len;
+    size_t out = lane->out + in;
+    
+#if BRIDGE_COMPRESS
+    if (lane->compress) {
+        /* Worst case: flag byte, pending literals and the whole frame as literals */
+        out = lane->out + (lane->frames == 0) + LZ_OUT_MAX(bridge.lz_lit_len + in);
+    }
+#endif
+    return (!lane->closed && raw <= lane->raw_max && ENCODED_LEN(out) <= lane->text_max);
+}
+
+/**
+ * @brief Check whether a lane can take a frame of a route (a publish has one topic)
+ */
+static bool lane_takes(const Lane_t *lane, uint16_t route)
+{
+    return (lane->frames == 0 || lane->route == route);
+}
+
+#if BRIDGE_OVERLAP
+/**
+ * @brief Open the next batch behind the tx_buf bytes a publish or datagram was started from
+ * @note  The bulk lane is empty here - it was just flushed, or a datagram needed it so
+ */
+static void overlap_hold(size_t used)
+{
+    if (used > BATCH_TEXT_MAX) {
+        used = BATCH_TEXT_MAX;  /* A full batch and its terminator: nothing fits behind */
+    }
+    bridge.tx_inflight = (uint16_t)used;
+    bridge.bulk.buf = &bridge.tx_buf[used];
+    bridge.bulk.text_max = (uint16_t)(BATCH_TEXT_MAX - used);
+}
+
+/**
+ * @brief The driver is done with tx_buf: the open batch moves to its front and gets all of it
+ * @note  The text is position-independent (encoder and LZ state live in the lane and the window).
+ *        A long move runs on the DMA while the next frames are parsed; whatever writes or sends
+ *        the bulk lane's text waits for it (MemDma_Wait)
+ */
+static void overlap_release(void)
+{
+    if (bridge.tx_inflight == 0) {
+        return;
+    }
+    bridge.tx_inflight = 0;
+    MemDma_Move(bridge.tx_buf, bridge.bulk.buf, bridge.bulk.len);
+    bridge.bulk.buf = bridge.tx_buf;
+    bridge.bulk.text_max = BATCH_TEXT_MAX;
+}
+#endif
+
+/**
+ * @brief Turn an open zero-copy batch into a copied one (ring bytes behind it have to go)
+ */
+static void zc_copy_out(Lane_t *lane)
+{
+    if (!lane->zc) {
+        return;
+    }
+    MemDma_Wait();
+    memcpy(lane->buf, lane->zc_data, bridge.zc_hold);
+    lane->zc = false;
+    bridge.zc_hold = 0;
+}
+
+/**
+ * @brief Consume parsed ring bytes - a zero-copy run in front stays unless bytes behind it go
+ * @return Bytes consumed
+ */
+static size_t rx_release(size_t pos)
+{
+    if (pos <= bridge.zc_hold) {
+        return 0;
+    }
+    zc_copy_out(&bridge.bulk);
+    UART_DMA_Consume(bridge.uart, pos);
+    return pos;
+}
+
+/**
+ * @brief Encode payload bytes onto a lane with selected encoding
+ */
+static void lane_put(Lane_t *lane, const uint8_t *data, size_t len)
+{
+    MemDma_Wait();
+    lane->len += (uint16_t)bridge.codec->put(lane, data, len, &lane->buf[lane->len]);
+    
+    lane->out += (uint16_t)len;
+}
+
+#if BRIDGE_COMPRESS
+/**
+ * @brief Emit the pending literal run: <len - 1> then the bytes (read back from the window)
+ */
+static void lz_literals(Lane_t *lane)
+{
+    size_t start = bridge.lz_lit_start & (LZ_WINDOW - 1);
+    size_t first = LZ_WINDOW - start;
+    uint8_t ctrl;
+    
+    if (bridge.lz_lit_len == 0) {
+        return;
+    }
+    ctrl = (uint8_t)(bridge.lz_lit_len - 1);
+    lane_put(lane, &ctrl, 1);
+    if (first > bridge.lz_lit_len) {
+        first = bridge.lz_lit_len;
+    }
+    lane_put(lane, &bridge.lz_win[start], first);
+    if (bridge.lz_lit_len > first) {
+        lane_put(lane, bridge.lz_win, bridge.lz_lit_len - first);
+    }
+    bridge.lz_lit_len = 0;
+}
+
+static void lz_push(uint8_t byte)
+{
+    bridge.lz_win[bridge.lz_total++ & (LZ_WINDOW - 1)] = byte;
+}
+
+/**
+ * @brief Longest match for frame offset j in the window (may run on into the frame itself)
+ * @return Match length, 0 if shorter than LZ_MIN_MATCH
+ */
+static size_t lz_match(const UART_DMA_Span_t part[2], size_t j, size_t len, size_t *dist)
+{
+    size_t p = bridge.lz_total;
+    size_t max_dist = (p < LZ_WINDOW) ? p : LZ_WINDOW;
+    size_t max_len = (len - j < LZ_MAX_MATCH) ? len - j : LZ_MAX_MATCH;
+    uint8_t first = span_byte(&part[0], &part[1], j);
+    size_t best = 0;
+    
+    if (max_len < LZ_MIN_MATCH) {
+        return 0;
+    }
+    for (size_t d = 1; d <= max_dist && best < max_len; d++) {
+        size_t q = p - d;
+        size_t n = 1;
+        
+        if (bridge.lz_win[q & (LZ_WINDOW - 1)] != first) {
+            continue;
+        }
+        while (n < max_len) {
+            uint8_t h = (q + n < p) ? bridge.lz_win[(q + n) & (LZ_WINDOW - 1)] :
+                        span_byte(&part[0], &part[1], j + (q + n - p));
+            if (h != span_byte(&part[0], &part[1], j + n)) {
+                break;
+            }
+            n++;
+        }
+        if (n > best) {
+            best = n;
+            *dist = d;
+        }
+    }
+    return (best >= LZ_MIN_MATCH) ? best : 0;
+}
+
+/**
+ * @brief Compress a frame onto a lane: matches are <0x80 | len - 3><distance - 1>
+ */
+static void lz_add(Lane_t *lane, const UART_DMA_Span_t part[2], size_t len)
+{
+    size_t j = 0;
+    
+    while (j < len) {
+        size_t dist = 0;
+        size_t n = lz_match(part, j, len, &dist);
+        
+        if (n > 0) {
+            uint8_t token[2] = { (uint8_t)(0x80 | (n - LZ_MIN_MATCH)), (uint8_t)(dist - 1) };
+            
+            lz_literals(lane);
+            lane_put(lane, token, sizeof(token));
+            for (size_t k = 0; k < n; k++) {
+                lz_push(span_byte(&part[0], &part[1], j + k));
+            }
+            j += n;
+            continue;
+        }
+        if (bridge.lz_lit_len == 0) {
+            bridge.lz_lit_start = bridge.lz_total;
+        }
+        lz_push(span_byte(&part[0], &part[1], j++));
+        if (++bridge.lz_lit_len == LZ_MAX_LITERALS) {
+            lz_literals(lane);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Byte at an offset of a frame in pieces
+ */
+static uint8_t parts_byte(const UART_DMA_Span_t *part, uint8_t parts, size_t pos)
+{
+    uint8_t k = 0;
+    
+    while (k + 1 < parts && pos >= part[k].len) {
+        pos -= part[k].len;
+        k++;
+    }
+    return part[k].data[pos];
+}
+
+/**
+ * @brief Hand bytes to a lane's encoder, through the LZ stage if it compresses
+ */
+static void lane_feed(Lane_t *lane, const uint8_t *data, size_t len)
+{
+#if BRIDGE_COMPRESS
+    if (lane->compress) {
+        UART_DMA_Span_t piece[2] = { { data, len }, { NULL, 0 } };
+        
+        lz_add(lane, piece, len);
+        return;
+    }
+#endif
+    lane_put(lane, data, len);
+}
+
+/**
+ * @brief Hand bytes [from, to) of a frame in pieces to a lane's encoder
+ * @note  From DMA memory piece by piece - the encoder carries partial groups over
+ */
+static void lane_emit(Lane_t *lane, const UART_DMA_Span_t *part, uint8_t parts, size_t from, size_t to)
+{
+    for (uint8_t k = 0; k < parts && from < to; k++) {
+        size_t n = part[k].len;
+        
+        if (from < n) {
+            lane_feed(lane, &part[k].data[from], ((to < n) ? to : n) - from);
+            from = n;
+        }
+        from -= n;
+        to = (to > n) ? to - n : 0;
+    }
+}
+
+#if BRIDGE_HDR_PACK
+/**
+ * @brief Add a frame as a compact header record:
+ *        <control> [seq] [sysid compid] [incompat compat] <msgid varint> <len> <payload> [signature]
+ * @note  The checksum is left out - the decoder computes it again with CRC_EXTRA
+ */
+static void hdr_add(Lane_t *lane, const UART_DMA_Span_t *part, uint8_t parts)
+{
+    bool v1 = (parts_byte(part, parts, 0) == MAVLINK_V1_MAGIC);
+    size_t header_len = v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+    uint8_t len = parts_byte(part, parts, 1);
+    uint8_t iflags = v1 ? 0 : parts_byte(part, parts, 2);
+    uint8_t cflags = v1 ? 0 : parts_byte(part, parts, 3);
+    uint8_t seq = parts_byte(part, parts, v1 ? 2 : 4);
+    uint8_t sysid = parts_byte(part, parts, v1 ? 3 : 5);
+    uint8_t compid = parts_byte(part, parts, v1 ? 4 : 6);
+    uint32_t msgid = parts_byte(part, parts, v1 ? 5 : 7);
+    uint8_t rec[HC_RECORD_MAX];
+    uint8_t n = 1;
+    size_t end;
+    
+    if (!v1) {
+        msgid |= ((uint32_t)parts_byte(part, parts, 8) << 8) | ((uint32_t)parts_byte(part, parts, 9) << 16);
+    }
+    rec[0] = v1 ? HC_V1 : 0;
+    if (lane->frames > 1 && seq == (uint8_t)(bridge.hc_seq + 1)) {
+        rec[0] |= HC_SEQ_NEXT;
+    } else {
+        rec[n++] = seq;
+    }
+    if (lane->frames > 1 && sysid == bridge.hc_sysid && compid == bridge.hc_compid) {
+        rec[0] |= HC_SAME_SRC;
+    } else {
+        rec[n++] = sysid;
+        rec[n++] = compid;
+    }
+    if (iflags != 0 || cflags != 0) {
+        rec[0] |= HC_FLAGS;
+        rec[n++] = iflags;
+        rec[n++] = cflags;
+    }
+    do {
+        rec[n++] = (uint8_t)((msgid & 0x7F) | ((msgid > 0x7F) ? 0x80 : 0));
+        msgid >>= 7;
+    } while (msgid > 0);
+    rec[n++] = len;
+    bridge.hc_seq = seq;
+    bridge.hc_sysid = sysid;
+    bridge.hc_compid = compid;
+    
+    lane_feed(lane, rec, n);
+    end = header_len + len;
+    lane_emit(lane, part, parts, header_len, end);
+    if (iflags & MAVLINK_IFLAG_SIGNED) {
+        lane_emit(lane, part, parts, end + MAVLINK_CHECKSUM_LEN, end + MAVLINK_CHECKSUM_LEN + MAVLINK_SIG_LEN);
+    }
+}
+#endif
+
+/**
+ * @brief Encode a MAVLink frame in pieces onto a lane with selected encoding
+ */
+static void lane_add_parts(Lane_t *lane, const UART_DMA_Span_t *part, uint8_t parts, size_t len, uint32_t arrival)
+{
+    zc_copy_out(lane);
+    if (lane->frames == 0) {
+        lane->tick = HAL_GetTick();
+        lane->arrival = arrival;
+    }
+    lane->raw += (uint16_t)len;
+    lane->frames++;
+    
+#if BRIDGE_COMPRESS
+    if (lane->compress && lane->frames == 1) {
+        uint8_t flag = LZ_FLAG;
+        
+        lane_put(lane, &flag, 1);
+        bridge.lz_total = 0;
+        bridge.lz_lit_len = 0;
+    }
+#endif
+#if BRIDGE_HDR_PACK
+    if (lane->hdr) {
+        if (lane->frames == 1) {
+            uint8_t flag = HC_FLAG;
+            
+            lane_feed(lane, &flag, 1);
+        }
+        hdr_add(lane, part, parts);
+        return;
+    }
+#endif
+    lane_emit(lane, part, parts, 0, len);
+}
+
+/**
+ * @brief Encode a MAVLink frame onto a lane with selected encoding
+ */
+static void lane_add(Lane_t *lane, const UART_DMA_Span_t part[2], size_t len, uint32_t arrival)
+{
+    lane_add_parts(lane, part, 2, len, arrival);
+}
+
+/**
+ * @brief Add a frame without copying it - only a raw batch that is the ring's front run
+ * @note  The frame must follow the run (pos == bridge.zc_hold) inside the first span
+ * @return false if the frame has to be added with lane_add
+ */
+static bool lane_add_zc(Lane_t *lane, const UART_DMA_Span_t *s1, size_t pos, size_t len, uint32_t arrival)
+{
+    if (!BRIDGE_ZERO_COPY || bridge.codec->put != to_raw || lane->compress || lane->hdr ||
+        pos != bridge.zc_hold || pos + len > s1->len || pos + len > BRIDGE_ZC_HOLD ||
+        (lane->frames > 0 && !lane->zc)) {
+        return false;
+    }
+    if (lane->frames == 0) {
+        lane->tick = HAL_GetTick();
+        lane->arrival = arrival;
+        lane->zc = true;
+        lane->zc_data = s1->data;
+    }
+    lane->raw += (uint16_t)len;
+    lane->out += (uint16_t)len;
+    lane->len += (uint16_t)len;
+    lane->frames++;
+    bridge.zc_hold += (uint16_t)len;
+    return true;
+}
+
+/**
+ * @brief Bucket not empty - batches may go, traffic is not thinned
+ */
+static bool shaper_open(void)
+{
+#if BRIDGE_SHAPER
+    return (bridge.shaper.tokens >= 0);
+#else
+    return true;
+#endif
+}
+
+#if BRIDGE_SHAPER
+/**
+ * @brief Refill the bucket (capped at BRIDGE_SHAPER_DELAY of capacity)
+ */
+static void shaper_refill(uint32_t now)
+{
+    uint32_t dt = now - bridge.shaper.tick;
+    int32_t depth = (int32_t)(bridge.shaper.rate * BRIDGE_SHAPER_DELAY);
+    
+    bridge.shaper.tick = now;
+    if (dt > BRIDGE_SHAPER_DELAY) {
+        dt = BRIDGE_SHAPER_DELAY;
+    }
+    bridge.shaper.tokens += (int32_t)(bridge.shaper.rate * dt);
+    if (bridge.shaper.tokens > depth) {
+        bridge.shaper.tokens = depth;
+    }
+}
+
+/**
+ * @brief Capacity sample from a publish delivered: its bytes over the time
+ *        since it started or the one before it was reported, whichever is
+ *        later. It reads low when the modem was idle between publishes (its
+ *        fixed cost per publish counts), so it lowers the estimate only when
+ *        the latency shows the modem queueing - over the least latency seen
+ *        by more than the bucket's depth. It reads high for a publish reported
+ *        right behind a late report, so one sample lifts the estimate a quarter
+ *        of the way to twice it at most
+ */
+static void shaper_sample(uint16_t len, uint32_t latency, uint32_t interval, uint32_t now)
+{
+    uint32_t sample;
+    
+    if (latency > UINT16_MAX) {
+        latency = UINT16_MAX;
+    }
+    if (latency < bridge.shaper.base_next) {
+        bridge.shaper.base_next = (uint16_t)latency;
+    }
+    if (latency < bridge.shaper.base_ms) {
+        bridge.shaper.base_ms = (uint16_t)latency;
+    }
+    if (now - bridge.shaper.base_tick >= BRIDGE_SHAPER_BASE) {
+        bridge.shaper.base_ms = bridge.shaper.base_next;
+        bridge.shaper.base_next = UINT16_MAX;
+        bridge.shaper.base_tick = now;
+    }
+    
+    sample = len * 1000U / (interval ? interval : 1);
+    if (sample > BRIDGE_SHAPER_MAX) {
+        sample = BRIDGE_SHAPER_MAX;
+    }
+    if (sample > 2U * bridge.shaper.rate) {
+        sample = 2U * bridge.shaper.rate;
+    }
+    if (sample > bridge.shaper.rate) {
+        bridge.shaper.rate += (sample - bridge.shaper.rate) / 4U;
+    } else if (latency > (uint32_t)bridge.shaper.base_ms + BRIDGE_SHAPER_DELAY) {
+        bridge.shaper.rate = (3U * bridge.shaper.rate + sample) / 4U;
+        if (bridge.shaper.rate < BRIDGE_SHAPER_MIN) {
+            bridge.shaper.rate = BRIDGE_SHAPER_MIN;
+        }
+    }
+}
+
+/**
+ * @brief Take a publish the driver accepted out of the bucket - it may run
+ *        into debt once it is not empty, so a batch larger than the depth
+ *        still goes
+ */
+static void shaper_take(size_t len)
+{
+    bridge.shaper.tokens -= (int32_t)(len * 1000U);
+}
+#endif
+
+/**
+ * @brief A log download or FTP session runs
+ */
+static bool xfer_on(void)
+{
+#if BRIDGE_XFER
+    return bridge.xfer;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Take a batch budget and deadline (an open batch over the budget closes at its next frame)
+ */
+static void batch_apply(uint16_t bytes, uint16_t deadline_ms)
+{
+#if BRIDGE_XFER
+    /* Held at full batches by a transfer - taken when it ends */
+    if (bridge.xfer) {
+        bridge.xfer_bytes = bytes;
+        bridge.xfer_ms = deadline_ms;
+        return;
+    }
+#endif
+    bridge.batch_bytes = bytes;
+    bridge.batch_ms = deadline_ms;
+    bridge.bulk.raw_max = bridge.bulk.compress ? 2 * bytes : bytes;
+}
+
+#if BRIDGE_XFER
+/**
+ * @brief A LOG_DATA or FILE_TRANSFER_PROTOCOL frame from the FC: the first
+ *        starts a transfer - batches at the largest budget and a deadline
+ *        they fill by, the batching controller paused. Frames go QoS0: the
+ *        GCS asks again for what it misses (LOG_REQUEST_DATA, FTP's own
+ *        seq), which acks the transfer end to end
+ */
+static void xfer_frame(uint32_t now)
+{
+    bridge.xfer_tick = now;
+    if (bridge.xfer) {
+        return;
+    }
+    uint16_t bytes = BRIDGE_BATCH_MAX;
+#if BRIDGE_ADAPT
+    bytes = bridge.adapt_max_bytes;
+#endif
+    uint16_t ms = bridge.batch_ms;
+    
+    bridge.xfer_bytes = bridge.batch_bytes;
+    bridge.xfer_ms = bridge.batch_ms;
+    batch_apply(bytes, (ms > BRIDGE_XFER_DEADLINE) ? ms : BRIDGE_XFER_DEADLINE);
+    bridge.xfer = true;
+    bridge_link.xfers++;
+    LOG_INFO("Bridge transfer: %u B, %u ms batches", (unsigned)bridge.batch_bytes, (unsigned)bridge.batch_ms);
+}
+
+/**
+ * @brief End a transfer the FC has been quiet on for BRIDGE_XFER_IDLE: the batching it took over back
+ */
+static void xfer_step(uint32_t now)
+{
+    if (!bridge.xfer || now - bridge.xfer_tick < BRIDGE_XFER_IDLE) {
+        return;
+    }
+    bridge.xfer = false;
+    batch_apply(bridge.xfer_bytes, bridge.xfer_ms);
+    LOG_INFO("Bridge transfer over: %lu frames so far", (unsigned long)bridge_link.xfer_frames);
+}
+#endif
+
+#if BRIDGE_ADAPT
+/**
+ * @brief Batching from a delivered live batch's latency. Slow on an idle
+ *        modem: the link is poor, budget and deadline are halved so a publish
+ *        waits on less. Sent behind another publish: per-publish cost is what
+ *        limits (slow or not), both grow a step. Quick on an idle modem:
+ *        nothing to amortize, the deadline gives a step back. Failed publishes
+ *        say nothing of the batch size (the session went) and are not counted
+ */
+static void adapt_step(uint32_t latency, uint8_t flags)
+{
+    uint32_t bytes = bridge.batch_bytes;
+    uint32_t ms = bridge.batch_ms;
+    
+    if (!(flags & PUB_QUEUED) && latency > BRIDGE_ADAPT_LATENCY) {
+        bytes /= 2U;
+        ms /= 2U;
+        bridge_link.batch_cut++;
+    } else if (flags & PUB_QUEUED) {
+        bytes += BRIDGE_ADAPT_BYTES;
+        ms += BRIDGE_ADAPT_MS;
+        bridge_link.batch_grown++;
+    } else {
+        ms = (ms > BRIDGE_ADAPT_MS) ? ms - BRIDGE_ADAPT_MS : 0;
+    }
+    bytes = (bytes < bridge.adapt_min_bytes) ? bridge.adapt_min_bytes :
+            (bytes > bridge.adapt_max_bytes) ? bridge.adapt_max_bytes : bytes;
+    ms = (ms < bridge.adapt_min_ms) ? bridge.adapt_min_ms : (ms > bridge.adapt_max_ms) ? bridge.adapt_max_ms : ms;
+    batch_apply((uint16_t)bytes, (uint16_t)ms);
+}
+#endif
+
+/**
+ * @brief One of our publishes went to the driver
+ */
+static void pub_sent(const Lane_t *lane)
+{
+    uint8_t k;
+    
+    if (bridge.pub.count == MQTT_PUB_WINDOW) {
+        return;     /* Cannot happen: the driver refuses a publish past its window */
+    }
+    k = (uint8_t)((bridge.pub.head + bridge.pub.count) % MQTT_PUB_WINDOW);
+    bridge.pub.tick[k] = HAL_GetTick();
+    bridge.pub.len[k] = lane->len;
+    bridge.pub.flags[k] = (uint8_t)(((lane == &bridge.bulk && !lane->stored) ? PUB_LIVE : 0) |
+                                    ((A7600_MQTT_PublishInFlight(bridge.mqtt) > 0) ? PUB_QUEUED : 0));
+    bridge.pub.count++;
+}
+
+/**
+ * @brief The oldest of our publishes was reported: latency to the shaper and the batching controller
+ */
+static void pub_done(MQTT_Result_t result)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t k = bridge.pub.head;
+    uint32_t from;
+    
+    if (bridge.pub.count == 0) {
+        return;
+    }
+    bridge.pub.head = (uint8_t)((k + 1) % MQTT_PUB_WINDOW);
+    bridge.pub.count--;
+    from = bridge.pub.tick[k];
+    if ((int32_t)(bridge.pub.done_tick - from) > 0) {
+        from = bridge.pub.done_tick;
+    }
+    bridge.pub.done_tick = now;
+#if BRIDGE_SHAPER
+    if (result == MQTT_OK) {
+        shaper_sample(bridge.pub.len[k], now - bridge.pub.tick[k], now - from, now);
+    }
+#endif
+#if BRIDGE_ADAPT
+    if (result == MQTT_OK && (bridge.pub.flags[k] & PUB_LIVE) && !xfer_on()) {
+        adapt_step(now - bridge.pub.tick[k], bridge.pub.flags[k]);
+    }
+#endif
+    (void)from;
+}
+
+/**
+ * @brief Delivery of a lane's publish - failed ones count their frames as lost
+ */
+static void lane_done(void *ctx, MQTT_Result_t result)
+{
+    Lane_t *lane = (Lane_t *)ctx;
+    
+    if (result != MQTT_OK) {
+        bridge_link.publish_lost += lane->inflight;
+    } else if (!lane->inflight_stored) {
+        /* Oldest frame of the publish: USART1 arrival to +CMQTTPUB */
+        uint32_t ms = HAL_GetTick() - lane->inflight_arrival;
+        uint8_t i = 0;
+        
+        while (i < BRIDGE_LAT_BUCKETS - 1 && ms >= (2UL << i)) {
+            i++;
+        }
+        bridge_link.latency[i]++;
+        BootProfile_Mark(BOOT_MARK_FRAME);
+    }
+    pub_done(result);
+    lane->inflight = 0;
+    if (lane->inflight_zc) {
+        lane->inflight_zc = false;
+        bridge.zc_release = true;
+    }
+}
+
+/**
+ * @brief End a lane's text: pending literals, then the partial encoding group
+ */
+static void lane_close(Lane_t *lane)
+{
+    if (lane->closed) {
+        return;
+    }
+#if BRIDGE_COMPRESS
+    if (lane->compress) {
+        lz_literals(lane);
+    }
+#endif
+    if (bridge.codec->finish != NULL) {
+        MemDma_Wait();
+        lane->len += (uint16_t)bridge.codec->finish(lane, &lane->buf[lane->len]);
+    }
+    lane->closed = true;
+}
+
+/**
+ * @brief Decimal of a byte, no terminator (no snprintf on the publish path)
+ * @return Digits written
+ */
+static size_t put_u8(char *out, uint8_t v)
+{
+    uint8_t h = (uint8_t)((v * 41u) >> 12);         /* v / 100 for 0..255 */
+    uint8_t t = (uint8_t)(((v - h * 100u) * 205u) >> 11);   /* Tens: (v % 100) / 10 */
+    size_t n = 0;
+    
+    if (h > 0) {
+        out[n++] = (char)('0' + h);
+    }
+    if (h > 0 || t > 0) {
+        out[n++] = (char)('0' + t);
+    }
+    out[n++] = (char)('0' + (v - h * 100u - t * 10u));
+    return n;
+}
+
+/**
+ * @brief Publish a lane (its buffer is busy until the publish finishes)
+ * @note  If the publish cannot start, or the shaper holds a batch back, the
+ *        frames are kept and retried on the next pass. Critical publishes are
+ *        not held, only charged; a publish is charged once the driver takes it
+ */
+static void lane_flush(Lane_t *lane)
+{
+    const uint8_t *payload = lane->zc ? lane->zc_data : (const uint8_t *)lane->buf;
+    MQTT_Result_t result;
+    
+    MemDma_Wait();
+#if BRIDGE_SHAPER
+    if (lane != &bridge.crit) {
+        bridge.shaper.held = !shaper_open();
+        if (bridge.shaper.held) {
+            return;     /* Still open - frames may join it */
+        }
+    }
+#endif
+    lane_close(lane);
+    lane->inflight_zc = lane->zc;           /* Set first - delivery may be reported at once */
+    if (lane->replay || lane->route == ROUTE_BASE) {
+        /* Fixed topics: prepared descriptors, nothing measured or formatted */
+        result = A7600_MQTT_PublishDescAsync(bridge.mqtt, lane->replay ? &bridge.topic_replay : &bridge.topic_tx,
+                                             payload, lane->len, lane->qos, lane_done, lane);
+    } else {
+        size_t n = bridge.topic_tx.len;
+        
+        /* BRIDGE_TOPIC_TX "/<sysid>/<compid>" */
+        memcpy(lane->topic, BRIDGE_TOPIC_TX, n);
+        lane->topic[n++] = '/';
+        n += put_u8(&lane->topic[n], (uint8_t)(lane->route >> 8));
+        lane->topic[n++] = '/';
+        n += put_u8(&lane->topic[n], (uint8_t)lane->route);
+        lane->topic[n] = '\0';
+        result = A7600_MQTT_PublishAsync(bridge.mqtt, lane->topic, payload, lane->len, lane->qos, lane_done, lane);
+    }
+    if (result != MQTT_OK) {
+        lane->inflight_zc = false;
+        return;     /* Not charged - the next try is */
+    }
+#if BRIDGE_SHAPER
+    shaper_take(lane->len);
+#endif
+    lane->inflight = lane->frames;
+#if BRIDGE_OVERLAP
+    if (lane == &bridge.bulk && !lane->inflight_zc) {
+        overlap_hold(lane->len + 1U);
+    }
+#endif
+    pub_sent(lane);
+    lane->inflight_arrival = lane->arrival;
+    lane->inflight_stored = lane->stored;
+    lane->zc = false;
+    bridge.replay_turn = !lane->stored;     /* Live and stored publishes take turns */
+    bridge.frames += lane->frames;
+    bridge.bytes += lane->raw;
+    lane->raw = 0;
+    lane->out = 0;
+    lane->len = 0;
+    lane->frames = 0;
+    lane->closed = false;
+    lane->stored = false;
+    lane->replay = false;
+}
+
+/**
+ * @brief Set up an empty lane
+ */
+static void lane_init(Lane_t *lane, char *buf, size_t text_max, size_t raw_max, MQTT_QoS_t qos,
+                      bool compress)
+{
+    memset(lane, 0, sizeof(*lane));
+    lane->buf = buf;
+    lane->text_max = (uint16_t)text_max;
+    lane->raw_max = (uint16_t)raw_max;
+    lane->qos = qos;
+    lane->compress = compress;
+}
+
+/**
+ * @brief Add a frame kept as it came (outage log, snapshot) to the batch
+ */
+static void stored_add(const uint8_t *stored, size_t len)
+{
+    UART_DMA_Span_t part[2] = { { stored, len }, { NULL, 0 } };
+#if BRIDGE_V2_PACK
+    /* Re-encoded on the way out like live frames */
+    bool v1 = (stored[0] == MAVLINK_V1_MAGIC);
+    int idx = msg_index(v1 ? stored[5] : stored[7] | ((uint32_t)stored[8] << 8) | ((uint32_t)stored[9] << 16));
+    Pack_t pack;
+    
+    if (idx >= 0 && frame_pack(part, v1, msg_table[idx].extra, &pack)) {
+        lane_add_parts(&bridge.bulk, pack.part, PACK_PARTS, pack.len, HAL_GetTick());
+        bridge_link.packed++;
+        bridge_link.pack_saved += pack.cut;
+        return;
+    }
+#endif
+    lane_add(&bridge.bulk, part, len, HAL_GetTick());
+}
+
+/**
+ * @brief Fill the empty batch from the outage log, oldest frames first (newest
+ *        first with OUTAGE_LOG_NEWEST_FIRST)
+ * @return true if frames were taken
+ */
+static bool replay_fill(void)
+{
+    const uint8_t *stored;
+    size_t len;
+    
+    while ((len = OutageLog_Peek(&stored)) > 0 && lane_fits(&bridge.bulk, len)) {
+        stored_add(stored, len);
+        OutageLog_Pop();
+    }
+    bridge.bulk.stored = bridge.bulk.replay = (bridge.bulk.frames > 0);
+    return bridge.bulk.stored;
+}
+
+/**
+ * @brief Fill the empty batch with PARAM_VALUE answers from the cache, sent as the autopilot
+ * @note  A read answer goes first; a list walks every index in order
+ * @return true if frames were taken
+ */
+static bool param_fill(void)
+{
+    uint8_t f[MAVLINK_HEADER_LEN + PARAM_VALUE_LEN + MAVLINK_CHECKSUM_LEN];
+    uint8_t *p = &f[MAVLINK_HEADER_LEN];
+    ParamCache_Entry_t entry;
+    
+    while (bridge.param_read != PARAM_NONE || bridge.param_next != PARAM_NONE) {
+        uint16_t count = ParamCache_Count();
+        int record = (bridge.param_read != PARAM_NONE) ? bridge.param_read :
+                     ParamCache_Find(bridge.param_next, NULL);
+        size_t len;
+        
+        if (!ParamCache_Complete() || record < 0 || !ParamCache_Get((uint16_t)record, &entry)) {
+            bridge.param_read = bridge.param_next = PARAM_NONE;   /* Started over meanwhile */
+            break;
+        }
+        memcpy(p, entry.value, sizeof(entry.value));
+        p[4] = (uint8_t)count;
+        p[5] = (uint8_t)(count >> 8);
+        p[6] = (uint8_t)entry.index;
+        p[7] = (uint8_t)(entry.index >> 8);
+        memcpy(&p[8], entry.id, PARAM_ID_LEN);
+        p[24] = entry.type;
+        len = frame_seal(f, PARAM_VALUE_LEN, bridge.param_seq, bridge.fc_sysid, bridge.fc_compid, PARAM_VALUE_ID);
+        if (!lane_fits(&bridge.bulk, len)) {
+            break;
+        }
+        UART_DMA_Span_t part[2] = { { f, len }, { NULL, 0 } };
+        
+        bridge.bulk.route = ROUTE_BASE;
+        lane_add(&bridge.bulk, part, len, HAL_GetTick());
+        bridge.param_seq++;
+        if (bridge.param_read != PARAM_NONE) {
+            bridge.param_read = PARAM_NONE;
+        } else if (++bridge.param_next >= count) {
+            bridge.param_next = PARAM_NONE;
+        }
+    }
+    bridge.bulk.stored = (bridge.bulk.frames > 0);
+    return bridge.bulk.stored;
+}
+
+/**
+ * @brief Send MAVLink frame as a sequenced datagram (binary, no encoding)
+ * @return true if the datagram was queued (tx_buf is busy until it is sent)
+ */
+static bool send_datagram(const UART_DMA_Span_t *part, uint8_t parts, size_t len)
+{
+    uint8_t *out = (uint8_t *)bridge.tx_buf;
+    size_t n = DATAGRAM_SEQ_LEN;
+    
+    MemDma_Wait();
+    out[0] = (uint8_t)(bridge.udp_seq >> 8);
+    out[1] = (uint8_t)bridge.udp_seq;
+    for (uint8_t k = 0; k < parts; k++) {
+        if (part[k].len > 0) {
+            memcpy(&out[n], part[k].data, part[k].len);
+            n += part[k].len;
+        }
+    }
+    if (A7600_MQTT_SendDatagram(bridge.mqtt, out, DATAGRAM_SEQ_LEN + len) != MQTT_OK) {
+        return false;
+    }
+#if BRIDGE_OVERLAP
+    overlap_hold(DATAGRAM_SEQ_LEN + len);
+#endif
+#if BRIDGE_SHAPER
+    shaper_take(DATAGRAM_SEQ_LEN + len);
+#endif
+    bridge.udp_seq++;
+    return true;
+}
+
+/**
+ * @brief Value of one encoded character - DEC_* for anything that is not a digit
+ */
+static uint8_t dec_val(const uint8_t *table, uint8_t c)
+{
+    return (c < 128) ? table[c] : DEC_BAD;
+}
+
+/**
+ * @brief Downlink DMA done (ISR) - the sent front may be reused
+ * @note  With BRIDGE_DL_CHAIN the frames that completed meanwhile go out
+ *        right away rather than at the next main-loop pass, as long as a
+ *        quarter of the queue is free at its end: compacting the front away
+ *        needs the DMA idle, so the chain breaks to let the main loop do it
+ */
+static void dl_done(void *ctx)
+{
+#if BRIDGE_DL_CHAIN
+    uint16_t commit = bridge.dl_commit;
+    
+    if (commit > bridge.dl_sent && sizeof(bridge.dl_q) - bridge.dl_head >= BRIDGE_DL_QUEUE / 4U &&
+        UART_DMA_TransmitZC(bridge.uart, &bridge.dl_q[bridge.dl_sent], commit - bridge.dl_sent,
+                            dl_done, ctx) == HAL_OK) {
+        bridge.dl_sent = commit;
+        return;
+    }
+#endif
+    (void)ctx;
+    bridge.dl_busy = false;
+}
+
+/**
+ * @brief Hand the queued whole frames to the FC UART
+ * @note  One DMA transfer at a time, so the queue drains at line rate and a
+ *        frame is never interleaved with debug output
+ */
+static void dl_pump(void)
+{
+    if (bridge.dl_busy) {
+        return;
+    }
+    if (bridge.dl_sent > 0) {
+        memmove(bridge.dl_q, &bridge.dl_q[bridge.dl_sent], bridge.dl_head - bridge.dl_sent);
+        bridge.dl_head -= bridge.dl_sent;
+        bridge.dl_commit -= bridge.dl_sent;
+        bridge.dl_sent = 0;
+    }
+    if (bridge.dl_commit == 0) {
+        return;
+    }
+    bridge.dl_busy = true;
+    if (UART_DMA_TransmitZC(bridge.uart, bridge.dl_q, bridge.dl_commit, dl_done, NULL) == HAL_OK) {
+        bridge.dl_sent = bridge.dl_commit;
+    } else {
+        bridge.dl_busy = false;
+    }
+}
+
+/**
+ * @brief Queue a frame of our own for the FC (between downlink frames only)
+ */
+static bool dl_inject(const uint8_t *frame, size_t len)
+{
+    if (bridge.dl_cur != 0 || sizeof(bridge.dl_q) - bridge.dl_head < len) {
+        return false;
+    }
+    memcpy(&bridge.dl_q[bridge.dl_head], frame, len);
+    bridge.dl_head += (uint16_t)len;
+    bridge.dl_commit = bridge.dl_head;
+    return true;
+}
+
+/**
+ * @brief Drop the frame being decoded (message ended inside it)
+ */
+static void dl_reset(void)
+{
+    bridge.dl_head = bridge.dl_commit;
+    bridge.dl_cur = 0;
+}
+
+/**
+ * @brief Message ID of the frame at the end of the downlink queue
+ */
+static uint32_t dl_msgid(void)
+{
+    const uint8_t *f = &bridge.dl_q[bridge.dl_commit];
+    
+    return bridge.dl_v1 ? f[5] : f[7] | ((uint32_t)f[8] << 8) | ((uint32_t)f[9] << 16);
+}
+
+/**
+ * @brief Check the frame at the end of the downlink queue (already complete)
+ * @note  Same table as uplink: an ID the bridge does not know is refused
+ */
+static bool dl_frame_valid(void)
+{
+    const uint8_t *f = &bridge.dl_q[bridge.dl_commit];
+    UART_DMA_Span_t part[2] = { { f, bridge.dl_need }, { NULL, 0 } };
+    int idx = msg_index(dl_msgid());
+    
+    if (idx < 0 || !msg_len_valid(idx, bridge.dl_v1, f[1])) {
+        return false;
+    }
+    return frame_valid(part, (size_t)(bridge.dl_v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN) + f[1],
+                       msg_table[idx].extra);
+}
+
+/**
+ * @brief Check that the frame at the end of the downlink queue is for a source heard here
+ * @note  Untargeted messages and broadcasts (target_system 0) always pass, unknown IDs are
+ *        left to dl_frame_valid. Runs before it: only the two target bytes are read, so
+ *        traffic for other vehicles on a fleet topic costs no CRC and no USART1 time.
+ */
+static bool dl_routed(void)
+{
+    int idx = msg_index(dl_msgid());
+    UART_DMA_Span_t part[2] = { { &bridge.dl_q[bridge.dl_commit], bridge.dl_need }, { NULL, 0 } };
+    uint8_t target;
+    uint8_t t[2];
+    
+    if (idx < 0 || msg_table[idx].target == MAV_TGT_NONE) {
+        return true;
+    }
+    target = msg_table[idx].target;
+    frame_payload(part, bridge.dl_v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN,
+                  target & (uint8_t)~MAV_TGT_SYS_ONLY, t, sizeof(t));
+    if (target & MAV_TGT_SYS_ONLY) {
+        t[1] = 0;
+    }
+    if (t[0] == 0) {
+        return true;
+    }
+    for (uint8_t i = 0; i < BRIDGE_SOURCES; i++) {
+        if (bridge.src[i].heard && bridge.src[i].sysid == t[0] && (t[1] == 0 || bridge.src[i].compid == t[1])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if BRIDGE_DL_DEDUP
+/**
+ * @brief Check the routed frame at the end of the downlink queue against the recent ones
+ * @return true if the same frame went to the FC within BRIDGE_DL_DEDUP_WINDOW
+ * @note  A QoS 1 message the broker delivers again (no PUBACK seen before a
+ *        reconnect) carries frames already forwarded; the FC would act on a
+ *        command twice. The checksum covers header and payload, so with
+ *        sequence and system ID it tells a repeat from a new frame - a
+ *        resend by the GCS itself takes the next sequence number and passes.
+ *        Frames that pass are remembered
+ */
+static bool dl_repeated(void)
+{
+    const uint8_t *f = &bridge.dl_q[bridge.dl_commit];
+    size_t ck = (size_t)(bridge.dl_v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN) + f[1];
+    uint8_t seq = bridge.dl_v1 ? f[2] : f[4];
+    uint8_t sysid = bridge.dl_v1 ? f[3] : f[5];
+    uint32_t fp = f[ck] | ((uint32_t)f[ck + 1] << 8) | ((uint32_t)seq << 16) | ((uint32_t)sysid << 24);
+    uint32_t now = HAL_GetTick();
+    
+    for (uint8_t i = 0; i < bridge.dl_seen.count; i++) {
+        if (bridge.dl_seen.fp[i] == fp && now - bridge.dl_seen.tick[i] < BRIDGE_DL_DEDUP_WINDOW) {
+            return true;
+        }
+    }
+    bridge.dl_seen.fp[bridge.dl_seen.next] = fp;
+    bridge.dl_seen.tick[bridge.dl_seen.next] = now;
+    bridge.dl_seen.next = (uint8_t)((bridge.dl_seen.next + 1) % BRIDGE_DL_DEDUP);
+    if (bridge.dl_seen.count < BRIDGE_DL_DEDUP) {
+        bridge.dl_seen.count++;
+    }
+    return false;
+}
+#endif
+
+#if BRIDGE_AUTOBAUD
+/**
+ * @brief Standard rate within 4% of a measured one
+ * @return The rate, 0 if none is near
+ */
+static uint32_t baud_snap(uint32_t baud)
+{
+    for (size_t i = 0; i < sizeof(fc_rates) / sizeof(fc_rates[0]); i++) {
+        uint32_t off = (baud > fc_rates[i]) ? baud - fc_rates[i] : fc_rates[i] - baud;
+        
+        if (off * 25 <= fc_rates[i]) {
+            return fc_rates[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Start a window for the rate USART1 runs at now
+ */
+static void autobaud_window(uint8_t state, uint32_t now)
+{
+    bridge.ab.state = state;
+    bridge.ab.valid = 0;
+    bridge.ab.bad = 0;
+    UART_DMA_GetTraffic(bridge.uart, NULL, &bridge.ab.rx);
+    bridge.ab.tick = now;
+}
+
+/**
+ * @brief Learn the FC's USART1 rate: measured on a start byte, kept once CRC-valid frames come at it
+ * @note  Any rate that shows BRIDGE_AUTOBAUD_CONFIRM valid frames locks, also
+ *        the boot rate before a measurement. A measurement that shows only bad
+ *        frames is tried at twice the rate once (0xFE measures two bit times),
+ *        then measured again on the next burst
+ */
+static void autobaud_step(uint32_t now)
+{
+    uint32_t baud = UART_DMA_GetBaudRate(bridge.uart);
+    uint32_t rx;
+    
+    UART_DMA_GetTraffic(bridge.uart, NULL, &rx);
+    bool lapsed = (now - bridge.ab.tick >= (bridge.ab.state == AB_LOCKED ? BRIDGE_AUTOBAUD_LOST :
+                                                                         BRIDGE_AUTOBAUD_WINDOW));
+    bool traffic = (rx - bridge.ab.rx >= AUTOBAUD_BYTES);
+    
+    if (bridge.ab.state == AB_LOCKED) {
+        if (bridge.ab.valid > 0) {
+            autobaud_window(AB_LOCKED, now);
+        } else if (lapsed && traffic) {
+            /* FC restarted at another rate */
+            LOG_WARN("FC link: no valid frame at %lu baud, measuring again", (unsigned long)baud);
+            UART_DMA_AutoBaudStart(bridge.uart);
+            autobaud_window(AB_MEASURE, now);
+        }
+        return;
+    }
+    
+    if (bridge.ab.valid >= BRIDGE_AUTOBAUD_CONFIRM && bridge.ab.bad < BRIDGE_AUTOBAUD_REJECTS) {
+        if (UART_DMA_RetuneBaudRate(bridge.uart, baud, false) == HAL_OK) {
+            LOG_INFO("FC link locked at %lu baud", (unsigned long)baud);
+            autobaud_window(AB_LOCKED, now);
+        }
+        return;
+    }
+    
+    if (bridge.ab.state == AB_MEASURE) {
+        uint32_t measured = UART_DMA_AutoBaudResult(bridge.uart);
+        
+        if (measured == 0) {
+            return;
+        }
+        baud = baud_snap(measured);
+        if (baud == 0 || UART_DMA_RetuneBaudRate(bridge.uart, baud, true) != HAL_OK) {
+            UART_DMA_AutoBaudStart(bridge.uart);
+            return;
+        }
+        bridge.ab.doubled = false;
+        autobaud_window(AB_CONFIRM, now);
+        return;
+    }
+    
+    /* AB_CONFIRM: condemned by bad frames, or a window of bytes without enough valid ones */
+    if (bridge.ab.bad >= BRIDGE_AUTOBAUD_REJECTS || (lapsed && traffic)) {
+        uint32_t twice = baud_snap(2 * baud);
+        
+        if (!bridge.ab.doubled && twice != 0 && UART_DMA_RetuneBaudRate(bridge.uart, twice, true) == HAL_OK) {
+            bridge.ab.doubled = true;
+            autobaud_window(AB_CONFIRM, now);
+        } else {
+            UART_DMA_AutoBaudStart(bridge.uart);
+            autobaud_window(AB_MEASURE, now);
+        }
+    } else if (lapsed) {
+        autobaud_window(AB_CONFIRM, now);  /* Quiet line: nothing to judge yet */
+    }
+}
+#endif
+
+/**
+ * @brief Armed state and system status from a HEARTBEAT - of the autopilot, once it is known
+ */
+static void armed_snoop(const UART_DMA_Span_t part[2], bool v1)
+{
+    uint8_t compid = span_byte(&part[0], &part[1], v1 ? 4 : 6);
+    uint8_t sysid = span_byte(&part[0], &part[1], v1 ? 3 : 5);
+    uint8_t mode[2];    /* base_mode, system_status */
+    
+    if (compid != MAV_COMP_ID_AUTOPILOT1 || (bridge.fc_sysid != 0 && sysid != bridge.fc_sysid)) {
+        return;
+    }
+    frame_payload(part, v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN, HEARTBEAT_BASE_MODE, mode, sizeof(mode));
+    bridge.fc_armed = (mode[0] & MAV_MODE_FLAG_SAFETY_ARMED) != 0;
+    bridge.fc_state = mode[1];
+}
+
+/**
+ * @brief Learn the autopilot and its parameters from its frames
+ * @note  The first HEARTBEAT of an autopilot component asks it for the full
+ *        list once; those answers fill the cache without going uplink
+ * @return true if the frame is kept off uplink (answer to our own request)
+ */
+static bool param_snoop(const UART_DMA_Span_t part[2], bool v1, uint32_t msgid, uint32_t now)
+{
+    uint8_t header_len = v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+    uint8_t sysid = span_byte(&part[0], &part[1], v1 ? 3 : 5);
+    uint8_t compid = span_byte(&part[0], &part[1], v1 ? 4 : 6);
+    uint8_t p[PARAM_VALUE_LEN];
+    ParamCache_Entry_t entry;
+    
+    if (!BRIDGE_PARAM_CACHE) {
+        return false;
+    }
+    if (bridge.param_priming && (ParamCache_Complete() || now - bridge.param_prime_tick > BRIDGE_PARAM_PRIME)) {
+        bridge.param_priming = false;
+    }
+    if (msgid == HEARTBEAT_ID && bridge.fc_sysid == 0 && compid == MAV_COMP_ID_AUTOPILOT1) {
+        uint8_t f[MAVLINK_HEADER_LEN + 2 + MAVLINK_CHECKSUM_LEN];
+        
+        bridge.fc_sysid = sysid;
+        bridge.fc_compid = compid;
+        f[MAVLINK_HEADER_LEN] = sysid;
+        f[MAVLINK_HEADER_LEN + 1] = compid;
+        if (BRIDGE_PARAM_PRIME > 0 &&
+            dl_inject(f, frame_seal(f, 2, ++bridge.radio_seq, BRIDGE_RADIO_SYSID, BRIDGE_RADIO_COMPID,
+                                    PARAM_REQUEST_LIST_ID))) {
+            bridge.param_priming = true;
+            bridge.param_prime_tick = now;
+        }
+        return false;
+    }
+    if (msgid != PARAM_VALUE_ID || sysid != bridge.fc_sysid || compid != bridge.fc_compid) {
+        return false;
+    }
+    
+    /* param_value, param_count, param_index, param_id, param_type */
+    frame_payload(part, header_len, 0, p, sizeof(p));
+    memcpy(entry.value, p, sizeof(entry.value));
+    entry.index = (uint16_t)(p[6] | (p[7] << 8));
+    memcpy(entry.id, &p[8], PARAM_ID_LEN);
+    entry.type = p[24];
+    ParamCache_Put(&entry, (uint16_t)(p[4] | (p[5] << 8)));
+    return bridge.param_priming;
+}
+
+#if BRIDGE_SHAPE
+/**
+ * @brief Send SET_MESSAGE_INTERVAL (COMMAND_LONG) for an entry to the autopilot
+ * @param hz Rate, 0 for off, SHAPE_DEFAULT for the FC's own rate
+ */
+static bool shape_send(size_t idx, uint8_t hz)
+{
+    uint8_t f[MAVLINK_HEADER_LEN + COMMAND_LONG_LEN + MAVLINK_CHECKSUM_LEN];
+    float param[2];
+    
+    /* param1: message ID, param2: interval in us (-1: off, 0: default) */
+    param[0] = (float)msg_table[idx].msgid;
+    param[1] = (hz == SHAPE_DEFAULT) ? 0.0f : (hz == 0) ? -1.0f : (float)(1000000UL / hz);
+    memset(&f[MAVLINK_HEADER_LEN], 0, COMMAND_LONG_LEN);
+    memcpy(&f[MAVLINK_HEADER_LEN], param, sizeof(param));     /* Little endian, as on the wire */
+    f[MAVLINK_HEADER_LEN + 28] = (uint8_t)MAV_CMD_SET_MESSAGE_INTERVAL;
+    f[MAVLINK_HEADER_LEN + 29] = (uint8_t)(MAV_CMD_SET_MESSAGE_INTERVAL >> 8);
+    f[MAVLINK_HEADER_LEN + 30] = bridge.fc_sysid;
+    f[MAVLINK_HEADER_LEN + 31] = bridge.fc_compid;
+    return dl_inject(f, frame_seal(f, COMMAND_LONG_LEN, ++bridge.radio_seq, BRIDGE_RADIO_SYSID,
+                                   BRIDGE_RADIO_COMPID, COMMAND_LONG_ID));
+}
+
+/**
+ * @brief Follow the autopilot for stream shaping: messages it sends, reboots
+ *        (a HEARTBEAT gap), answers to our SET_MESSAGE_INTERVAL
+ * @return true if the frame is kept off uplink (COMMAND_ACK addressed to us)
+ */
+static bool shape_snoop(const UART_DMA_Span_t part[2], bool v1, int idx, uint32_t now)
+{
+    uint8_t sysid = span_byte(&part[0], &part[1], v1 ? 3 : 5);
+    uint8_t compid = span_byte(&part[0], &part[1], v1 ? 4 : 6);
+    uint8_t bit = (uint8_t)(1U << (idx % 8));
+    uint8_t p[COMMAND_ACK_LEN];
+    
+    if (bridge.fc_sysid == 0 || sysid != bridge.fc_sysid || compid != bridge.fc_compid) {
+        return false;
+    }
+    if (!(bridge.shape_seen[idx / 8] & bit)) {
+        bridge.shape_seen[idx / 8] |= bit;
+        bridge.shape_dirty = true;
+    }
+    
+    if (msg_table[idx].msgid == HEARTBEAT_ID) {
+        /* Intervals do not survive a reboot */
+        if (bridge.hb_heard && now - bridge.hb_tick >= BRIDGE_SHAPE_REBOOT) {
+            LOG_INFO("Autopilot back after %lu ms: stream intervals asked again",
+                     (unsigned long)(now - bridge.hb_tick));
+            memset(bridge.shaped, SHAPE_DEFAULT, sizeof(bridge.shaped));
+            memset(bridge.shape_refused, 0, sizeof(bridge.shape_refused));
+            bridge.shape_off = false;
+            bridge.shape_paused = false;
+            bridge.shape_idx = -1;
+            bridge.shape_tries = 0;
+            bridge.shape_dirty = true;
+        }
+        bridge.hb_heard = true;
+        bridge.hb_tick = now;
+        return false;
+    }
+    if (msg_table[idx].msgid != COMMAND_ACK_ID) {
+        return false;
+    }
+    
+    /* An autopilot that leaves the target out answers us all the same while a command is out */
+    frame_payload(part, v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN, 0, p, sizeof(p));
+    bool ours = (p[8] == BRIDGE_RADIO_SYSID && p[9] == BRIDGE_RADIO_COMPID);
+    
+    if ((p[0] | (p[1] << 8)) != MAV_CMD_SET_MESSAGE_INTERVAL || (!ours && p[8] != 0) || bridge.shape_idx < 0) {
+        return ours;
+    }
+    if (p[2] == MAV_RESULT_TEMPORARILY_REJECTED) {
+        return ours;        /* Asked again after BRIDGE_SHAPE_ACK_MS */
+    }
+    
+    size_t i = (size_t)bridge.shape_idx;
+    
+    if (p[2] == MAV_RESULT_ACCEPTED) {
+        bridge.shaped[i] = bridge.shape_hz;
+        LOG_INFO("FC interval: msg %lu -> %u Hz (0 off, 255 its own)", (unsigned long)msg_table[i].msgid,
+                 (unsigned)bridge.shape_hz);
+    } else if (p[2] == MAV_RESULT_UNSUPPORTED) {
+        bridge.shape_off = true;
+        LOG_WARN("FC has no SET_MESSAGE_INTERVAL: limits applied in the bridge only");
+    } else {
+        bridge.shape_refused[i / 8] |= (uint8_t)(1U << (i % 8));
+        LOG_WARN("FC refused an interval for msg %lu", (unsigned long)msg_table[i].msgid);
+    }
+    bridge.shape_idx = -1;
+    bridge.shape_tries = 0;
+    bridge.shape_dirty = true;
+    return ours;
+}
+
+/**
+ * @brief Ask the autopilot for the next entry whose rate differs from what it acknowledged (one command out at a time)
+ */
+static void shape_step(uint32_t now)
+{
+    bool offline;
+    
+    if (A7600_MQTT_IsConnected(bridge.mqtt)) {
+        bridge.shape_up_tick = now;
+    }
+    offline = (now - bridge.shape_up_tick >= BRIDGE_SHAPE_OFFLINE);
+    if (offline != bridge.shape_offline) {
+        bridge.shape_offline = offline;
+        bridge.shape_dirty = true;
+    }
+    if (bridge.shape_off || bridge.fc_sysid == 0) {
+        return;
+    }
+    
+    if (bridge.shape_idx >= 0) {
+        if (now - bridge.shape_tick < BRIDGE_SHAPE_ACK_MS) {
+            return;
+        }
+        bridge.shape_idx = -1;      /* Lost on the way, or never answered */
+        bridge.shape_dirty = true;
+        if (++bridge.shape_tries >= SHAPE_TRIES) {
+            bridge.shape_tries = 0;
+            bridge.shape_paused = true;
+        }
+    }
+    if (bridge.shape_paused) {
+        if (now - bridge.shape_tick < BRIDGE_SHAPE_PAUSE) {
+            return;
+        }
+        bridge.shape_paused = false;
+    }
+    if (!bridge.shape_dirty) {
+        return;
+    }
+    
+    for (size_t i = 0; i < MSG_COUNT; i++) {
+        uint8_t hz;
+        
+        if (!shape_managed(i) || bridge.shaped[i] == (hz = shape_want(i))) {
+            continue;
+        }
+        if (shape_send(i, hz)) {
+            bridge.shape_idx = (int16_t)i;
+            bridge.shape_hz = hz;
+            bridge.shape_tick = now;
+        }
+        return;                     /* Queue full: again next pass */
+    }
+    bridge.shape_dirty = false;
+}
+#endif
+
+/**
+ * @brief Take a parameter request for the autopilot off the downlink if the cache can answer it
+ * @note  The frame is the complete, valid one at the end of the queue
+ * @return true if the bridge answers (the frame is dropped)
+ */
+static bool param_answer(void)
+{
+    const uint8_t *f = &bridge.dl_q[bridge.dl_commit];
+    size_t header_len = bridge.dl_v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+    uint32_t msgid = dl_msgid();
+    UART_DMA_Span_t part[2] = { { f, bridge.dl_need }, { NULL, 0 } };
+    uint8_t p[PARAM_READ_LEN];
+    uint8_t target = (msgid == PARAM_REQUEST_LIST_ID) ? 0 : 2;
+    int record;
+    
+    if (!BRIDGE_PARAM_CACHE || (msgid != PARAM_REQUEST_LIST_ID && msgid != PARAM_REQUEST_READ_ID)) {
+        return false;
+    }
+    frame_payload(part, header_len, 0, p, sizeof(p));
+    if (bridge.fc_sysid == 0 || p[target] != bridge.fc_sysid ||
+        (p[target + 1] != bridge.fc_compid && p[target + 1] != 0)) {
+        return false;
+    }
+    bridge.param_priming = false;   /* The FC's answers are the GCS's from here */
+    if (!ParamCache_Complete()) {
+        return false;
+    }
+    
+    if (msgid == PARAM_REQUEST_LIST_ID) {
+        bridge.param_next = 0;
+    } else {
+        /* param_index, target_system, target_component, param_id (index -1: by id) */
+        int16_t index = (int16_t)(p[0] | (p[1] << 8));
+        
+        record = ParamCache_Find(index, (const char *)&p[4]);
+        if (record < 0) {
+            return false;   /* Unknown to us - the FC says so itself */
+        }
+        bridge.param_read = (uint16_t)record;
+    }
+    bridge_link.param_answered++;
+    return true;
+}
+
+#if BRIDGE_MISSION_PROXY
+/**
+ * @brief Follow a mission upload on the downlink. A MISSION_COUNT for the
+ *        autopilot (mission_type MISSION) starts one - it goes on to the FC.
+ *        The GCS's MISSION_ITEM_INT of it are stored and taken off the
+ *        downlink, to be sent when the FC asks (mission_snoop); one the FC
+ *        asked for before it came goes through as it is
+ * @note  The frame is the complete, valid one at the end of the queue
+ * @return true if the bridge keeps the frame (it is dropped here)
+ */
+static bool mission_take(void)
+{
+    const uint8_t *f = &bridge.dl_q[bridge.dl_commit];
+    size_t header_len = bridge.dl_v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+    UART_DMA_Span_t part[2] = { { f, bridge.dl_need }, { NULL, 0 } };
+    uint32_t msgid = dl_msgid();
+    uint8_t sysid = f[bridge.dl_v1 ? 3 : 5];
+    uint8_t compid = f[bridge.dl_v1 ? 4 : 6];
+    uint8_t p[MISSION_ITEM_INT_LEN];
+    uint16_t seq;
+    
+    if (msgid == MISSION_COUNT_ID) {
+        /* count, target_system, target_component, mission_type */
+        frame_payload(part, header_len, 0, p, 5);
+        bridge.mp.active = (bridge.fc_sysid != 0 && p[2] == bridge.fc_sysid && p[4] == MAV_MISSION_TYPE_MISSION);
+        if (bridge.mp.active) {
+            bridge.mp.serve = false;
+            bridge.mp.gcs_sysid = sysid;
+            bridge.mp.gcs_compid = compid;
+            bridge.mp.target[0] = p[2];
+            bridge.mp.target[1] = p[3];
+            bridge.mp.count = (uint16_t)(p[0] | (p[1] << 8));
+            bridge.mp.want = MISSION_NONE;
+            bridge.mp.tick = HAL_GetTick();
+            MissionStore_Clear();
+        }
+        return false;
+    }
+    if (!bridge.mp.active || sysid != bridge.mp.gcs_sysid || compid != bridge.mp.gcs_compid) {
+        return false;
+    }
+    if (msgid == MISSION_ACK_ID) {
+        bridge.mp.active = false;   /* The GCS gave up */
+        return false;
+    }
+    if (msgid != MISSION_ITEM_INT_ID) {
+        return false;
+    }
+    frame_payload(part, header_len, 0, p, sizeof(p));
+    seq = (uint16_t)(p[MISSION_SEQ] | (p[MISSION_SEQ + 1] << 8));
+    if (p[MISSION_TYPE] != MAV_MISSION_TYPE_MISSION || seq >= bridge.mp.count) {
+        return false;
+    }
+    bridge.mp.tick = HAL_GetTick();
+    if (!MissionStore_Has(seq) && MissionStore_Put(seq, p)) {
+        bridge_link.mission_stored++;
+    }
+    if (seq == bridge.mp.want && !bridge.mp.serve) {
+        bridge.mp.want = MISSION_NONE;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Take the FC's request for an item of the upload off the uplink if
+ *        the bridge holds the item (others go up to the GCS as before); its
+ *        MISSION_ACK ends the upload and goes up
+ * @return true if the bridge answers (the frame is not forwarded)
+ */
+static bool mission_snoop(const UART_DMA_Span_t part[2], bool v1, uint32_t msgid, uint32_t now)
+{
+    uint8_t sysid = span_byte(&part[0], &part[1], v1 ? 3 : 5);
+    uint8_t p[5];
+    uint16_t seq;
+    
+    if (!bridge.mp.active || sysid != bridge.mp.target[0]) {
+        return false;
+    }
+    if (now - bridge.mp.tick > BRIDGE_MISSION_IDLE) {
+        bridge.mp.active = false;
+        return false;
+    }
+    frame_payload(part, v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN, 0, p, sizeof(p));
+    if (msgid == MISSION_ACK_ID) {
+        /* target_system, target_component, type, mission_type */
+        if (p[0] == bridge.mp.gcs_sysid && p[3] == MAV_MISSION_TYPE_MISSION) {
+            bridge.mp.active = false;
+        }
+        return false;
+    }
+    
+    /* seq, target_system, target_component, mission_type (MISSION_REQUEST too: the
+     * FC takes a MISSION_ITEM_INT for it) */
+    seq = (uint16_t)(p[0] | (p[1] << 8));
+    if ((msgid != MISSION_REQUEST_INT_ID && msgid != MISSION_REQUEST_ID) || p[2] != bridge.mp.gcs_sysid ||
+        p[4] != MAV_MISSION_TYPE_MISSION || seq >= bridge.mp.count) {
+        return false;
+    }
+    bridge.mp.tick = now;
+    bridge.mp.want = seq;
+    bridge.mp.serve = MissionStore_Has(seq);
+    return bridge.mp.serve;
+}
+
+/**
+ * @brief Send the FC the item it asked for, from the store, once the downlink queue takes it
+ */
+static void mission_serve(void)
+{
+    uint8_t f[MAVLINK_HEADER_LEN + MISSION_ITEM_INT_LEN + MAVLINK_CHECKSUM_LEN];
+    uint8_t *p = &f[MAVLINK_HEADER_LEN];
+    
+    if (!bridge.mp.serve) {
+        return;
+    }
+    if (!MissionStore_Get(bridge.mp.want, p)) {
+        bridge.mp.serve = false;
+        return;
+    }
+    p[MISSION_SEQ] = (uint8_t)bridge.mp.want;
+    p[MISSION_SEQ + 1] = (uint8_t)(bridge.mp.want >> 8);
+    p[MISSION_TARGET] = bridge.mp.target[0];
+    p[MISSION_TARGET + 1] = bridge.mp.target[1];
+    if (dl_inject(f, frame_seal(f, MISSION_ITEM_INT_LEN, bridge.mp.seq, bridge.mp.gcs_sysid, bridge.mp.gcs_compid,
+                                MISSION_ITEM_INT_ID))) {
+        bridge.mp.seq++;
+        bridge.mp.serve = false;
+        bridge.mp.want = MISSION_NONE;
+        bridge_link.mission_served++;
+    }
+}
+#endif
+
+/**
+ * @brief Queue one decoded byte - frames are committed whole and valid, or not at all
+ */
+static void dec_put(uint8_t byte)
+{
+    if (bridge.dl_cur == 0) {
+        if (byte != MAVLINK_V2_MAGIC && byte != MAVLINK_V1_MAGIC) {
+            return;     /* Between frames - the FC would skip it too */
+        }
+        bridge.dl_v1 = (byte == MAVLINK_V1_MAGIC);
+        bridge.dl_need = 0;
+        bridge.dl_drop = false;
+    }
+    if (!bridge.dl_drop) {
+        if (bridge.dl_head < sizeof(bridge.dl_q)) {
+            bridge.dl_q[bridge.dl_head++] = byte;
+        } else {
+            bridge.dl_drop = true;
+            bridge.dl_head = bridge.dl_commit;
+        }
+    }
+    
+    bridge.dl_cur++;
+    if (bridge.dl_cur == 2) {
+        bridge.dl_need = byte + (bridge.dl_v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN) + MAVLINK_CHECKSUM_LEN;
+    } else if (bridge.dl_cur == 3 && !bridge.dl_v1 && (byte & MAVLINK_IFLAG_SIGNED)) {
+        bridge.dl_need += MAVLINK_SIG_LEN;
+    }
+    if (bridge.dl_cur == bridge.dl_need) {
+        if (bridge.dl_drop) {
+            bridge.dl_dropped++;
+        } else if (!dl_routed()) {
+            bridge.dl_unrouted++;
+            bridge_dl_foreign++;
+            bridge.dl_head = bridge.dl_commit;
+        } else if (!dl_frame_valid()) {
+            bridge.dl_rejected++;
+            bridge.dl_head = bridge.dl_commit;
+#if BRIDGE_DL_DEDUP
+        } else if (dl_repeated()) {
+            bridge_dl_dups++;
+            bridge.dl_head = bridge.dl_commit;
+#endif
+        } else if (param_answer()) {
+            bridge.dl_head = bridge.dl_commit;
+#if BRIDGE_MISSION_PROXY
+        } else if (mission_take()) {
+            bridge.dl_head = bridge.dl_commit;
+#endif
+        } else {
+            bridge.dl_commit = bridge.dl_head;
+        }
+        bridge.dl_cur = 0;
+    }
+}
+
+/**
+ * @brief Count a character no group can take - true if the caller is done with it
+ */
+static bool decode_skip(uint8_t v)
+{
+    if (v == DEC_SKIP) {
+        return true;    /* Newlines etc. */
+    }
+    if (v == DEC_BAD) {
+        bridge.dec_bad++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Decode one Base64 character that is not part of a whole group
+ */
+static void base64_char(uint8_t v)
+{
+    if (decode_skip(v)) {
+        return;
+    }
+    if (v == DEC_PAD) {
+        /* Padding: flush what the partial group holds */
+        if (bridge.dec_n == 2) {
+            dec_put((uint8_t)(bridge.dec_acc >> 4));
+        } else if (bridge.dec_n == 3) {
+            dec_put((uint8_t)(bridge.dec_acc >> 10));
+            dec_put((uint8_t)(bridge.dec_acc >> 2));
+        }
+        bridge.dec_n = 0;
+        bridge.dec_acc = 0;
+        return;
+    }
+    bridge.dec_acc = (bridge.dec_acc << 6) | v;
+    if (++bridge.dec_n == 4) {
+        dec_put((uint8_t)(bridge.dec_acc >> 16));
+        dec_put((uint8_t)(bridge.dec_acc >> 8));
+        dec_put((uint8_t)bridge.dec_acc);
+        bridge.dec_n = 0;
+        bridge.dec_acc = 0;
+    }
+}
+
+/**
+ * @brief Decode a chunk of Base64 text (groups may span chunks)
+ * @note  Whole groups take one table lookup per character and a combined
+ *        flag test; anything else goes through base64_char
+ */
+static void from_base64(const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+    
+    while (i < len) {
+        if (bridge.dec_n == 0 && len - i >= 4) {
+            uint8_t a = dec_val(b64_dec_table, src[i]), b = dec_val(b64_dec_table, src[i + 1]);
+            uint8_t c = dec_val(b64_dec_table, src[i + 2]), d = dec_val(b64_dec_table, src[i + 3]);
+            
+            if ((a | b | c | d) < 64) {
+                uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+                
+                dec_put((uint8_t)(v >> 16));
+                dec_put((uint8_t)(v >> 8));
+                dec_put((uint8_t)v);
+                i += 4;
+                continue;
+            }
+        }
+        base64_char(dec_val(b64_dec_table, src[i++]));
+    }
+}
+
+/**
+ * @brief Decode one hex character that is not part of a whole pair
+ */
+static void hex_char(uint8_t v)
+{
+    if (decode_skip(v)) {
+        return;
+    }
+    if (v == DEC_PAD) {
+        bridge.dec_bad++;
+        return;
+    }
+    bridge.dec_acc = (bridge.dec_acc << 4) | v;
+    if (++bridge.dec_n == 2) {
+        dec_put((uint8_t)bridge.dec_acc);
+        bridge.dec_n = 0;
+        bridge.dec_acc = 0;
+    }
+}
+
+/**
+ * @brief Decode a chunk of hex text (pairs may span chunks)
+ */
+static void from_hex(const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+    
+    while (i < len) {
+        if (bridge.dec_n == 0 && len - i >= 2) {
+            uint8_t a = dec_val(hex_dec_table, src[i]), b = dec_val(hex_dec_table, src[i + 1]);
+            
+            if ((a | b) < 16) {
+                dec_put((uint8_t)((a << 4) | b));
+                i += 2;
+                continue;
+            }
+        }
+        hex_char(dec_val(hex_dec_table, src[i++]));
+    }
+}
+
+/**
+ * @brief Frame bytes as they arrive (chunk sizes follow +CMQTTRXPAYLOAD)
+ */
+static void from_raw(const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dec_put(src[i]);
+    }
+}
+
+/* Indexed by MavlinkBridge_Encoding_t */
+static const Codec_t codecs[BRIDGE_ENC_COUNT] = {
+    { "hex",    hex_len,    CODEC_TO_HEX,       NULL,           from_hex },
+    { "base64", base64_len, CODEC_TO_BASE64,    base64_finish,  from_base64 },
+    { "raw",    raw_len,    to_raw,             NULL,           from_raw }
+};
+
+/**
+ * @brief Apply a pending encoding switch once nothing is half encoded
+ * @note  Caller has checked that no publish is in flight (tx_buf is free)
+ */
+static void codec_apply(void)
+{
+    if (bridge.codec_next == NULL || bridge.bulk.frames > 0 || bridge.crit.frames > 0) {
+        return;
+    }
+    bridge.codec = bridge.codec_next;
+    bridge.codec_next = NULL;
+    /* Compressed batches are bounded by their output - the raw budget doubles */
+    bridge.bulk.compress = bridge.compress_next;
+    bridge.bulk.hdr = bridge.hdr_next;
+    bridge.bulk.raw_max = bridge.compress_next ? 2 * bridge.batch_bytes : bridge.batch_bytes;
+    LOG_INFO("Bridge encoding: %s%s%s", bridge.codec->name, bridge.bulk.hdr ? "+hc" : "",
+             bridge.bulk.compress ? "+lz" : "");
+}
+
+/**
+ * @brief Build a RADIO_STATUS frame describing the cellular path
+ * @note  rssi is CSQ * 8; txbuf is the free share (%) of the worse of the
+ *        FC RX ring and the open batch, capped by the congestion level -
+ *        autopilots slow their streams as it drops; rxerrors counts frames
+ *        in failed publishes
+ * @return Frame length
+ */
+static size_t radio_status_frame(uint8_t *f)
+{
+    const MQTT_LinkQuality_t *lq = A7600_MQTT_GetLinkQuality(bridge.mqtt);
+    uint32_t lost = (bridge_link.publish_lost > 0xFFFF) ? 0xFFFF : bridge_link.publish_lost;
+    size_t fill = bridge.rx_len * 100 / bridge.uart->rx_size;
+    size_t batch = (size_t)bridge.bulk.len * 100 / BATCH_TEXT_MAX;
+#if BRIDGE_BACKPRESSURE
+    /* Fill reported at least per level: ArduPilot slows its streams below 50% free, fast below 20% */
+    static const uint8_t bp_fill[] = { 0, 60, 85, 100 };
+    
+    if (bp_fill[bridge.bp_level] > batch) {
+        batch = bp_fill[bridge.bp_level];
+    }
+#endif
+    
+    if (batch > fill) {
+        fill = batch;
+    }
+    f[10] = (uint8_t)lost;                  /* rxerrors */
+    f[11] = (uint8_t)(lost >> 8);
+    f[12] = 0;                              /* fixed */
+    f[13] = 0;
+    f[14] = (lq->csq <= 31) ? (uint8_t)(lq->csq * 8) : 255;   /* rssi */
+    f[15] = 255;                            /* remrssi: unknown */
+    f[16] = (uint8_t)(100 - (fill > 100 ? 100 : fill));        /* txbuf */
+    f[17] = 255;                            /* noise */
+    f[18] = 255;                            /* remnoise */
+    
+    /* FC and cloud copies share the seq */
+    return frame_seal(f, RADIO_STATUS_LEN, bridge.radio_seq, BRIDGE_RADIO_SYSID, BRIDGE_RADIO_COMPID,
+                      RADIO_STATUS_ID);
+}
+
+#if BRIDGE_BACKPRESSURE
+/**
+ * @brief Congestion level from the FC RX ring fill, the driver's publish
+ *        window, the age of our oldest publish in flight and a batch the
+ *        shaper holds (over the uplink's budget: shed like a ring filling,
+ *        not parked in it). A rise has the FC hear RADIO_STATUS now rather
+ *        than at its interval; from BP_SHED RTS goes high (FC_FLOW_RTS)
+ *        until the congestion is over
+ */
+static void backpressure_step(uint32_t now)
+{
+    size_t fill = UART_DMA_Available(bridge.uart) * 100U / bridge.uart->rx_size;
+    uint8_t level = BP_NONE;
+    bool over_budget = false;
+    
+#if BRIDGE_SHAPER
+    over_budget = bridge.shaper.held && !shaper_open();
+#endif
+    if (fill >= BRIDGE_BP_DROP) {
+        level = BP_DROP;
+    } else if (fill >= BRIDGE_BP_SHED || over_budget) {
+        level = BP_SHED;
+    } else if (fill >= BRIDGE_BP_THIN || A7600_MQTT_PublishInFlight(bridge.mqtt) >= MQTT_PUB_WINDOW ||
+               (bridge.pub.count > 0 && now - bridge.pub.tick[bridge.pub.head] >= BRIDGE_BP_LATENCY)) {
+        level = BP_THIN;
+    }
+    if (level > bridge.bp_level) {
+        bridge_link.bp_rises++;
+        if (now - bridge.radio_tick >= BRIDGE_BP_RADIO_GAP) {
+            bridge.radio_tick = now - BRIDGE_RADIO_INTERVAL;
+        }
+    }
+    bridge.bp_level = level;
+#if FC_FLOW_RTS
+    if (level >= BP_SHED) {
+        UART_DMA_HoldRts(bridge.uart, RTS_SHED, true);
+    } else if (level == BP_NONE) {
+        UART_DMA_HoldRts(bridge.uart, RTS_SHED, false);
+    }
+#endif
+}
+#endif
+
+/**
+ * @brief Ring about to lap (BP_DROP): a frame that cannot go now is dropped, never held
+ */
+static bool bp_dropping(void)
+{
+#if BRIDGE_BACKPRESSURE
+    return (bridge.bp_level == BP_DROP);
+#else
+    return false;
+#endif
+}
+
+#if FC_FLOW_RTS && BRIDGE_RTS_OUTAGE
+/**
+ * @brief RTS high while the outage log is nearly full, so the FC holds its
+ *        stream rather than the log giving up its oldest page; low again
+ *        once the replay has drained it
+ */
+static void rts_outage_step(void)
+{
+    uint8_t pages = OutageLog_PagesUsed();
+    
+    if (pages >= BRIDGE_RTS_OUTAGE) {
+        UART_DMA_HoldRts(bridge.uart, RTS_OUTAGE, true);
+    } else if (pages <= BRIDGE_RTS_OUTAGE_LOW) {
+        UART_DMA_HoldRts(bridge.uart, RTS_OUTAGE, false);
+    }
+}
+#endif
+
+/**
+ * @brief Report the cellular path to the FC every BRIDGE_RADIO_INTERVAL (cloud copy queued)
+ */
+static void radio_status(uint32_t now)
+{
+    uint8_t frame[RADIO_FRAME_LEN];
+    
+    if (BRIDGE_RADIO_INTERVAL == 0 || now - bridge.radio_tick < BRIDGE_RADIO_INTERVAL) {
+        return;
+    }
+    bridge.radio_tick = now;
+    bridge.radio_seq++;
+    dl_inject(frame, radio_status_frame(frame));
+    bridge.radio_pending = true;
+}
+
+/**
+ * @brief Open an empty live batch with its time stamp: a SYSTEM_TIME frame
+ *        (sender and seq of RADIO_STATUS) with the wall-clock time and the
+ *        HAL tick of the first frame's arrival
+ * @note  Nothing until the driver has network time, or if the first frame
+ *        (len bytes) would no longer fit after it
+ */
+static void lane_stamp(Lane_t *lane, size_t len, uint32_t arrival)
+{
+    uint8_t f[STAMP_FRAME_LEN];
+    uint8_t *p = &f[MAVLINK_HEADER_LEN];
+    UART_DMA_Span_t part[2] = { { f, 0 }, { NULL, 0 } };
+    uint64_t usec;
+    uint32_t sec;
+    uint16_t ms;
+    
+    if (!bridge.stamps || lane->frames > 0 || !lane_fits(lane, STAMP_FRAME_LEN + len) ||
+        !A7600_MQTT_GetUnixTime(bridge.mqtt, arrival, &sec, &ms)) {
+        return;
+    }
+    usec = (uint64_t)sec * 1000000U + (uint32_t)ms * 1000U;
+    for (uint8_t i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(usec >> (8 * i));          /* time_unix_usec */
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+        p[8 + i] = (uint8_t)(arrival >> (8 * i));   /* time_boot_ms */
+    }
+    part[0].len = frame_seal(f, SYSTEM_TIME_LEN, ++bridge.radio_seq, BRIDGE_RADIO_SYSID, BRIDGE_RADIO_COMPID,
+                             SYSTEM_TIME_ID);
+    lane_add(lane, part, part[0].len, arrival);
+}
+
+#if BRIDGE_SNAPSHOT
+/**
+ * @brief Give each snapshot message a pool slot for its longest frame
+ */
+static void snap_init(void)
+{
+    size_t at = 0;
+    
+    for (size_t i = 0; i < SNAP_COUNT; i++) {
+        int idx = msg_index(snap_ids[i]);
+        size_t cap = (idx < 0) ? 0 : MAVLINK_HEADER_LEN + msg_table[idx].max_len + MAVLINK_CHECKSUM_LEN +
+                                     MAVLINK_SIG_LEN;
+        
+        bridge.snap_len[i] = 0;
+        bridge.snap_at[i] = (cap == 0 || at + cap > sizeof(bridge.snap_pool)) ? SNAP_NONE : (uint16_t)at;
+        if (bridge.snap_at[i] != SNAP_NONE) {
+            at += cap;
+        }
+    }
+    bridge.snap_pending = false;
+}
+
+/**
+ * @brief Keep an autopilot frame if its message is one of the snapshot's
+ */
+static void snap_keep(const UART_DMA_Span_t frame[2], size_t len, uint32_t msgid)
+{
+    for (size_t i = 0; i < SNAP_COUNT; i++) {
+        if (snap_ids[i] == msgid) {
+            if (bridge.snap_at[i] != SNAP_NONE) {
+                uint8_t *slot = &bridge.snap_pool[bridge.snap_at[i]];
+                
+                memcpy(slot, frame[0].data, frame[0].len);
+                memcpy(&slot[frame[0].len], frame[1].data, len - frame[0].len);
+                bridge.snap_len[i] = (uint16_t)len;
+            }
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Add the kept frames to the autopilot batch - all of them, or none while it is too full
+ * @return true if the snapshot went into it
+ */
+static bool snap_fill(uint32_t now)
+{
+    size_t total = 0;
+    
+    for (size_t i = 0; i < SNAP_COUNT; i++) {
+        total += bridge.snap_len[i];
+    }
+    if (total == 0) {
+        return true;
+    }
+    if (!lane_fits(&bridge.bulk, total) && bridge.bulk.frames > 0) {
+        return false;   /* The next batch, empty, takes it */
+    }
+    lane_stamp(&bridge.bulk, total, now);
+    bridge.bulk.route = ROUTE_BASE;
+    for (size_t i = 0; i < SNAP_COUNT; i++) {
+        /* A batch budget under the snapshot: what fits */
+        if (bridge.snap_len[i] > 0 && lane_fits(&bridge.bulk, bridge.snap_len[i])) {
+            stored_add(&bridge.snap_pool[bridge.snap_at[i]], bridge.snap_len[i]);
+        }
+    }
+    bridge_snapshots++;
+    return true;
+}
+#endif
+
+#if SUMMARY_ENABLE
+/**
+ * @brief Close the summary interval into a TUNNEL frame (sender and seq of RADIO_STATUS)
+ * @param f SUMMARY_FRAME_LEN bytes
+ * @return Frame length
+ */
+static size_t summary_frame(uint8_t *f, uint32_t now)
+{
+    uint8_t *p = &f[MAVLINK_HEADER_LEN];
+    
+    memset(p, 0, TUNNEL_LEN);
+    p[0] = (uint8_t)BRIDGE_SUMMARY_TYPE;    /* payload_type */
+    p[1] = (uint8_t)(BRIDGE_SUMMARY_TYPE >> 8);
+    p[4] = (uint8_t)Summary_Take(&p[TUNNEL_DATA], now - bridge.summary_tick);   /* targets 0: broadcast */
+    bridge.summary_tick = now;
+    return frame_seal(f, TUNNEL_LEN, ++bridge.radio_seq, BRIDGE_RADIO_SYSID, BRIDGE_RADIO_COMPID, TUNNEL_ID);
+}
+#endif
+
+#if BRIDGE_PRESENCE
+/**
+ * @brief Fold a HEARTBEAT into the presence record unless its source's state changed
+ * @note  The first one of a source, and the first after the link was down, go up
+ * @return true if it is folded (counted, not forwarded)
+ */
+static bool presence_fold(const UART_DMA_Span_t part[2], uint8_t header_len, uint8_t src, bool online)
+{
+    bridge.presence_src = BRIDGE_SOURCES;
+    if (!online) {
+        bridge.src[src].hb_held = false;
+        return false;
+    }
+    frame_payload(part, header_len, 0, bridge.presence_hb, HEARTBEAT_LEN);
+    if (bridge.src[src].hb_held && memcmp(bridge.presence_hb, bridge.src[src].hb, HEARTBEAT_LEN) == 0) {
+        if (bridge.src[src].hb_count < UINT8_MAX) {
+            bridge.src[src].hb_count++;
+        }
+        return true;
+    }
+    bridge.presence_src = src;     /* Taken as its state by frame_sent */
+    return false;
+}
+
+/**
+ * @brief Check whether a source's HEARTBEAT came in the interval
+ */
+static bool presence_heard(void)
+{
+    for (uint8_t i = 0; i < BRIDGE_SOURCES; i++) {
+        if (bridge.src[i].used && bridge.src[i].hb_count > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Close the presence interval into a TUNNEL frame (sender and seq of RADIO_STATUS)
+ * @param f PRESENCE_FRAME_LEN bytes
+ * @return Frame length
+ */
+static size_t presence_frame(uint8_t *f, uint32_t now)
+{
+    uint8_t *p = &f[MAVLINK_HEADER_LEN];
+    uint8_t *e = &p[TUNNEL_DATA + PRESENCE_HEAD];
+    uint32_t span = now - bridge.presence_tick;
+    uint8_t n = 0;
+    
+    memset(p, 0, TUNNEL_LEN);
+    p[0] = (uint8_t)BRIDGE_PRESENCE_TYPE;   /* payload_type, targets 0: broadcast */
+    p[1] = (uint8_t)(BRIDGE_PRESENCE_TYPE >> 8);
+    for (uint8_t i = 0; i < BRIDGE_SOURCES; i++) {
+        if (!bridge.src[i].used || bridge.src[i].hb_count == 0) {
+            continue;
+        }
+        e[0] = bridge.src[i].sysid;
+        e[1] = bridge.src[i].compid;
+        e[2] = bridge.src[i].hb_count;
+        memcpy(&e[3], bridge.src[i].hb, HEARTBEAT_LEN);
+        bridge.src[i].hb_count = 0;
+        e += PRESENCE_ENTRY;
+        n++;
+    }
+    if (span > UINT16_MAX) {
+        span = UINT16_MAX;
+    }
+    p[TUNNEL_DATA] = PRESENCE_VERSION;
+    p[TUNNEL_DATA + 1] = n;
+    p[TUNNEL_DATA + 2] = (uint8_t)span;
+    p[TUNNEL_DATA + 3] = (uint8_t)(span >> 8);
+    p[4] = (uint8_t)(PRESENCE_HEAD + n * PRESENCE_ENTRY);   /* payload_length */
+    bridge.presence_tick = now;
+    return frame_seal(f, TUNNEL_LEN, ++bridge.radio_seq, BRIDGE_RADIO_SYSID, BRIDGE_RADIO_COMPID, TUNNEL_ID);
+}
+#endif
+
+#if BRIDGE_STATUS_CARRY
+/**
+ * @brief Write the waiting status record into a TUNNEL frame (sender and seq of RADIO_STATUS)
+ * @param f STATUS_FRAME_LEN bytes
+ * @return Frame length
+ */
+static size_t status_frame(uint8_t *f)
+{
+    uint8_t *p = &f[MAVLINK_HEADER_LEN];
+    size_t len;
+    
+    memset(p, 0, TUNNEL_LEN);
+    p[0] = (uint8_t)BRIDGE_STATUS_TYPE;     /* payload_type */
+    p[1] = (uint8_t)(BRIDGE_STATUS_TYPE >> 8);
+    len = bridge.status_fn(&p[TUNNEL_DATA], BRIDGE_STATUS_MAX, bridge.status_ctx);
+    p[4] = (uint8_t)((len < BRIDGE_STATUS_MAX) ? len : BRIDGE_STATUS_MAX);  /* targets 0: broadcast */
+    bridge.status_fn = NULL;
+    bridge.status_carried = true;
+    return frame_seal(f, TUNNEL_LEN, ++bridge.radio_seq, BRIDGE_RADIO_SYSID, BRIDGE_RADIO_COMPID, TUNNEL_ID);
+}
+#endif
+
+/* ==================== Public Functions ==================== */
+
+void MavlinkBridge_Init(UART_DMA_Handle_t *uart, A7600_MQTT_Handle_t *mqtt)
+{
+    bridge.uart = uart;
+    bridge.mqtt = mqtt;
+    bridge.rx_len = 0;
+    bridge.rx_new = false;
+    bridge.partial_due = 0;
+    bridge.partial_len = 0;
+    bridge.zc_hold = 0;
+    bridge.zc_release = false;
+    bridge.in_pass = false;
+    bridge.frames = 0;
+    bridge.bytes = 0;
+    bridge_rejected = 0;
+    bridge_dl_dups = 0;
+    bridge_dl_foreign = 0;
+    bridge_snapshots = 0;
+    memset(&bridge_link, 0, sizeof(bridge_link));
+    memset(bridge.src, 0, sizeof(bridge.src));
+#if BRIDGE_SNAPSHOT
+    snap_init();
+#endif
+    bridge.src_evict = 0;
+    for (size_t i = 0; i < MSG_COUNT; i++) {
+        bridge.rate[i] = msg_table[i].rate;
+        bridge.last_sent[i] = (uint16_t)(HAL_GetTick() - 0x8000);  /* Long ago for rate and dedup */
+    }
+    bridge.udp_seq = 0;
+    bridge.radio_tick = HAL_GetTick();
+    bridge.radio_pending = false;
+#if BRIDGE_BACKPRESSURE
+    bridge.bp_level = BP_NONE;
+#endif
+    bridge.stamps = BRIDGE_STAMPS_BOOT;
+    A7600_MQTT_TopicDescInit(&bridge.topic_tx, 0, BRIDGE_TOPIC_TX);
+    A7600_MQTT_TopicDescInit(&bridge.topic_replay, 0, BRIDGE_TOPIC_REPLAY);
+    bridge.fc_sysid = 0;
+    bridge.fc_armed = false;
+    bridge.fc_state = 0;
+    bridge.fc_compid = 0;
+    bridge.param_seq = 0;
+    bridge.param_priming = false;
+    bridge.param_next = PARAM_NONE;
+    bridge.param_read = PARAM_NONE;
+    ParamCache_Clear();
+#if OUTAGE_LOG_SPI
+    OutageLog_Init();
+    bridge.ol_lent = false;
+#endif
+#if BRIDGE_SHAPE
+    memset(bridge.shaped, SHAPE_DEFAULT, sizeof(bridge.shaped));
+    memset(bridge.shape_seen, 0, sizeof(bridge.shape_seen));
+    memset(bridge.shape_refused, 0, sizeof(bridge.shape_refused));
+    bridge.shape_idx = -1;
+    bridge.shape_tries = 0;
+    bridge.shape_off = false;
+    bridge.shape_paused = false;
+    bridge.shape_dirty = false;
+    bridge.shape_offline = false;
+    bridge.hb_heard = false;
+    bridge.shape_up_tick = HAL_GetTick();
+#endif
+#if BRIDGE_SHAPER
+    bridge.shaper.rate = BRIDGE_SHAPER_START;
+    bridge.shaper.tokens = (int32_t)(BRIDGE_SHAPER_START * BRIDGE_SHAPER_DELAY);
+    bridge.shaper.tick = HAL_GetTick();
+    bridge.shaper.base_ms = UINT16_MAX;
+    bridge.shaper.base_next = UINT16_MAX;
+    bridge.shaper.base_tick = bridge.shaper.tick;
+#endif
+#if BRIDGE_AUTOBAUD
+    UART_DMA_AutoBaudStart(uart);
+    autobaud_window(AB_MEASURE, HAL_GetTick());
+#endif
+#if ANOMALY_ENABLE
+    Anomaly_Init();
+#endif
+#if SUMMARY_ENABLE
+    Summary_Init();
+    bridge.summary_ms = 0;
+    bridge.summary_tick = HAL_GetTick();
+#endif
+#if BRIDGE_PRESENCE
+    bridge.presence_tick = HAL_GetTick();
+    bridge.presence_src = BRIDGE_SOURCES;
+#endif
+#if BRIDGE_STATUS_CARRY
+    bridge.status_fn = NULL;
+    bridge.status_carried = false;
+#endif
+    bridge.batch_bytes = BRIDGE_BATCH_BYTES;
+    bridge.batch_ms = BRIDGE_BATCH_DEADLINE;
+    bridge.pub.head = 0;
+    bridge.pub.count = 0;
+    bridge.pub.done_tick = HAL_GetTick();
+#if BRIDGE_XFER
+    bridge.xfer = false;
+#endif
+#if BRIDGE_MISSION_PROXY
+    bridge.mp.active = false;
+    bridge.mp.serve = false;
+#endif
+#if BRIDGE_ADAPT
+    bridge.adapt_min_bytes = MAVLINK_MAX_FRAME_LEN;
+    bridge.adapt_max_bytes = BRIDGE_BATCH_MAX;
+    bridge.adapt_min_ms = BRIDGE_ADAPT_MIN_MS;
+    bridge.adapt_max_ms = BRIDGE_ADAPT_MAX_MS;
+#endif
+    lane_init(&bridge.bulk, bridge.tx_buf, BATCH_TEXT_MAX, BRIDGE_BATCH_BYTES, MQTT_QOS_0, false);
+#if BRIDGE_OVERLAP
+    bridge.tx_inflight = 0;
+#endif
+    lane_init(&bridge.crit, bridge.crit_buf, CRIT_TEXT_MAX, MAVLINK_MAX_FRAME_LEN, MQTT_QOS_1, false);
+    bridge.codec_next = &codecs[BRIDGE_ENCODING];
+    bridge.compress_next = (BRIDGE_COMPRESS && BRIDGE_COMPRESS_BOOT);
+    bridge.hdr_next = (BRIDGE_HDR_PACK && BRIDGE_HDR_PACK_BOOT);
+    codec_apply();
+    bridge.dec_codec = bridge.codec;
+}
+
+bool MavlinkBridge_SetRate(uint32_t msgid, uint8_t hz)
+{
+    int idx = msg_index(msgid);
+    
+    if (idx < 0) {
+        return false;
+    }
+    bridge.rate[idx] = hz;
+#if BRIDGE_SHAPE
+    bridge.shape_dirty = true;
+#endif
+    LOG_INFO("Bridge rate: msg %lu -> %u Hz", (unsigned long)msgid, (unsigned)hz);
+    return true;
+}
+
+void MavlinkBridge_ResetRates(void)
+{
+    for (size_t i = 0; i < MSG_COUNT; i++) {
+        bridge.rate[i] = msg_table[i].rate;
+    }
+#if BRIDGE_SHAPE
+    bridge.shape_dirty = true;
+#endif
+}
+
+bool MavlinkBridge_SetSourcePriority(uint8_t sysid, uint8_t compid, MavlinkBridge_Priority_t prio)
+{
+    if (sysid == 0 || prio > BRIDGE_PRIO_OFF) {
+        return false;
+    }
+    bridge.src[source_slot(sysid, compid)].prio = (uint8_t)prio;
+    LOG_INFO("Bridge source %u/%u -> priority %u", (unsigned)sysid, (unsigned)compid, (unsigned)prio);
+    return true;
+}
+
+bool MavlinkBridge_SetSourceShare(uint8_t sysid, uint8_t compid, uint16_t quantum)
+{
+#if BRIDGE_FAIR
+    if (sysid == 0 || quantum > BRIDGE_FAIR_QUANTUM_MAX) {
+        return false;
+    }
+    uint8_t slot = source_slot(sysid, compid);
+    
+    bridge.src[slot].quantum = quantum;
+    LOG_INFO("Bridge source %u/%u -> %u B a round", (unsigned)sysid, (unsigned)compid,
+             (unsigned)fair_quantum(slot));
+    return true;
+#else
+    (void)sysid;
+    (void)compid;
+    (void)quantum;
+    return false;
+#endif
+}
+
+void MavlinkBridge_GetStats(uint32_t *frames, uint32_t *bytes, uint32_t *rejected)
+{
+    if (frames != NULL) {
+        *frames = bridge.frames;
+    }
+    if (bytes != NULL) {
+        *bytes = bridge.bytes;
+    }
+    if (rejected != NULL) {
+        *rejected = bridge_rejected;
+    }
+}
+
+uint32_t MavlinkBridge_GetUplinkRate(void)
+{
+#if BRIDGE_SHAPER
+    return bridge.shaper.rate;
+#else
+    return 0;
+#endif
+}
+
+void MavlinkBridge_SeedUplink(uint32_t bps, uint16_t overhead_ms)
+{
+    /* A quarter over the probe: a short probe reads low, and the estimate comes down on queueing anyway */
+    uint32_t rate = (bps > BRIDGE_SHAPER_MAX) ? BRIDGE_SHAPER_MAX : bps + bps / 4U;
+    
+    if (rate < BRIDGE_SHAPER_MIN) {
+        rate = BRIDGE_SHAPER_MIN;
+    } else if (rate > BRIDGE_SHAPER_MAX) {
+        rate = BRIDGE_SHAPER_MAX;
+    }
+
+#if BRIDGE_SHAPER
+    bridge.shaper.rate = rate;
+#endif
+#if BRIDGE_ADAPT
+    uint64_t bytes = (uint64_t)4U * overhead_ms * rate / 1000U;
+    uint16_t ms = overhead_ms;
+    
+    bytes = (bytes < bridge.adapt_min_bytes) ? bridge.adapt_min_bytes :
+            (bytes > bridge.adapt_max_bytes) ? bridge.adapt_max_bytes : bytes;
+    ms = (ms < bridge.adapt_min_ms) ? bridge.adapt_min_ms : (ms > bridge.adapt_max_ms) ? bridge.adapt_max_ms : ms;
+    batch_apply((uint16_t)bytes, ms);
+#endif
+    LOG_INFO("Bridge uplink seeded: %lu B/s, %u B, %u ms", (unsigned long)rate, (unsigned)bridge.batch_bytes,
+             (unsigned)bridge.batch_ms);
+    (void)overhead_ms;
+}
+
+void MavlinkBridge_RttSample(uint16_t rtt_ms, uint16_t base_ms)
+{
+#if BRIDGE_SHAPER
+    if (rtt_ms > (uint32_t)base_ms + BRIDGE_SHAPER_DELAY) {
+        bridge.shaper.rate -= bridge.shaper.rate / 4U;
+        if (bridge.shaper.rate < BRIDGE_SHAPER_MIN) {
+            bridge.shaper.rate = BRIDGE_SHAPER_MIN;
+        }
+    }
+#endif
+#if BRIDGE_ADAPT
+    adapt_step(rtt_ms, 0);
+#endif
+    (void)rtt_ms;
+    (void)base_ms;
+}
+
+MavlinkBridge_StatusCarry_t MavlinkBridge_CarryStatus(MavlinkBridge_StatusFn_t fn, void *ctx)
+{
+#if BRIDGE_STATUS_CARRY
+    uint32_t now = HAL_GetTick();
+    
+    if (bridge.status_carried) {
+        bridge.status_carried = false;
+        return BRIDGE_STATUS_CARRIED;
+    }
+    if (bridge.status_fn != NULL) {
+        if (now - bridge.status_tick < BRIDGE_STATUS_WAIT) {
+            return BRIDGE_STATUS_WAITING;
+        }
+        bridge.status_fn = NULL;            /* No batch came - handed back */
+        return BRIDGE_STATUS_IDLE;
+    }
+    
+    /* Taken while autopilot frames go up: a batch is open or was lately */
+    if (fn == NULL || !A7600_MQTT_IsConnected(bridge.mqtt) ||
+        (bridge.bulk.frames == 0 && now - bridge.bulk.tick >= BRIDGE_STATUS_WAIT)) {
+        return BRIDGE_STATUS_IDLE;
+    }
+    bridge.status_ctx = ctx;
+    bridge.status_tick = now;
+    bridge.status_fn = fn;
+    return BRIDGE_STATUS_WAITING;
+#else
+    (void)fn;
+    (void)ctx;
+    return BRIDGE_STATUS_IDLE;
+#endif
+}
+
+void MavlinkBridge_SaveState(MavlinkBridge_State_t *state)
+{
+    state->frames = bridge.frames;
+    state->bytes = bridge.bytes;
+    state->rejected = bridge_rejected;
+    state->link = bridge_link;
+#if BRIDGE_SHAPER
+    state->uplink_bps = bridge.shaper.rate;
+    state->base_ms = bridge.shaper.base_ms;
+#else
+    state->uplink_bps = 0;
+    state->base_ms = UINT16_MAX;
+#endif
+    state->batch_bytes = bridge.batch_bytes;
+    state->batch_ms = bridge.batch_ms;
+#if BRIDGE_XFER
+    if (bridge.xfer) {
+        state->batch_bytes = bridge.xfer_bytes;     /* The controller's, not the transfer's */
+        state->batch_ms = bridge.xfer_ms;
+    }
+#endif
+#if BRIDGE_AUTOBAUD
+    state->fc_baud = (bridge.ab.state == AB_LOCKED) ? UART_DMA_GetBaudRate(bridge.uart) : 0;
+#else
+    state->fc_baud = 0;
+#endif
+}
+
+void MavlinkBridge_RestoreState(const MavlinkBridge_State_t *state)
+{
+    bridge.frames = state->frames;
+    bridge.bytes = state->bytes;
+    bridge_rejected = state->rejected;
+    bridge_link = state->link;
+#if BRIDGE_SHAPER
+    if (state->uplink_bps >= BRIDGE_SHAPER_MIN && state->uplink_bps <= BRIDGE_SHAPER_MAX) {
+        bridge.shaper.rate = state->uplink_bps;
+        bridge.shaper.tokens = (int32_t)(state->uplink_bps * BRIDGE_SHAPER_DELAY);
+        bridge.shaper.base_ms = state->base_ms;
+    }
+#endif
+#if BRIDGE_ADAPT
+    if (state->batch_bytes >= bridge.adapt_min_bytes && state->batch_bytes <= bridge.adapt_max_bytes &&
+        state->batch_ms >= bridge.adapt_min_ms && state->batch_ms <= bridge.adapt_max_ms) {
+        batch_apply(state->batch_bytes, state->batch_ms);
+    }
+#endif
+#if BRIDGE_AUTOBAUD
+    /* The FC kept its rate: confirm it instead of waiting for a measurement */
+    if (state->fc_baud != 0 && baud_snap(state->fc_baud) == state->fc_baud &&
+        UART_DMA_RetuneBaudRate(bridge.uart, state->fc_baud, true) == HAL_OK) {
+        autobaud_window(AB_CONFIRM, HAL_GetTick());
+    }
+#endif
+    LOG_INFO("Bridge state restored: %lu frames, %lu B/s, %u B, %u ms, FC %lu baud",
+             (unsigned long)bridge.frames, (unsigned long)MavlinkBridge_GetUplinkRate(),
+             (unsigned)bridge.batch_bytes, (unsigned)bridge.batch_ms, (unsigned long)state->fc_baud);
+}
+
+uint8_t MavlinkBridge_GetCongestion(void)
+{
+#if BRIDGE_BACKPRESSURE
+    return bridge.bp_level;
+#else
+    return 0;
+#endif
+}
+
+const MavlinkBridge_LinkStats_t* MavlinkBridge_GetLinkStats(void)
+{
+    return &bridge_link;
+}
+
+bool MavlinkBridge_SetEncoding(MavlinkBridge_Encoding_t encoding, bool compress)
+{
+    if ((unsigned)encoding >= BRIDGE_ENC_COUNT || (compress && !BRIDGE_COMPRESS)) {
+        return false;
+    }
+    bridge.codec_next = &codecs[encoding];
+    bridge.compress_next = compress;
+    return true;
+}
+
+bool MavlinkBridge_SetEncodingName(const char *name)
+{
+    size_t len = strcspn(name, "+");
+    bool compress = (strcmp(&name[len], "+lz") == 0);
+    
+    if (name[len] != '\0' && !compress) {
+        return false;
+    }
+    for (uint8_t i = 0; i < BRIDGE_ENC_COUNT; i++) {
+        if (strlen(codecs[i].name) == len && strncmp(name, codecs[i].name, len) == 0) {
+            return MavlinkBridge_SetEncoding((MavlinkBridge_Encoding_t)i, compress);
+        }
+    }
+    return false;
+}
+
+const char* MavlinkBridge_GetEncodingName(bool *compress)
+{
+    if (compress != NULL) {
+        *compress = bridge.bulk.compress;
+    }
+    return bridge.codec->name;
+}
+
+bool MavlinkBridge_SetBatching(uint16_t bytes, uint16_t deadline_ms)
+{
+    /* A frame of any size must fit an empty batch */
+    if (bytes < MAVLINK_MAX_FRAME_LEN || bytes > BRIDGE_BATCH_MAX || deadline_ms > BRIDGE_DEADLINE_MAX) {
+        return false;
+    }
+    batch_apply(bytes, deadline_ms);
+    LOG_INFO("Bridge batching: %u B, %u ms", (unsigned)bytes, (unsigned)deadline_ms);
+    return true;
+}
+
+bool MavlinkBridge_SetBatchBounds(uint16_t min_bytes, uint16_t max_bytes, uint16_t min_ms, uint16_t max_ms)
+{
+#if BRIDGE_ADAPT
+    if (min_bytes < MAVLINK_MAX_FRAME_LEN || min_bytes > max_bytes || max_bytes > BRIDGE_BATCH_MAX ||
+        min_ms > max_ms || max_ms > BRIDGE_DEADLINE_MAX) {
+        return false;
+    }
+    bridge.adapt_min_bytes = min_bytes;
+    bridge.adapt_max_bytes = max_bytes;
+    bridge.adapt_min_ms = min_ms;
+    bridge.adapt_max_ms = max_ms;
+    LOG_INFO("Bridge batching bounds: %u-%u B, %u-%u ms", (unsigned)min_bytes, (unsigned)max_bytes,
+             (unsigned)min_ms, (unsigned)max_ms);
+    return true;
+#else
+    (void)min_bytes;
+    (void)max_bytes;
+    (void)min_ms;
+    (void)max_ms;
+    return false;
+#endif
+}
+
+void MavlinkBridge_GetBatchBounds(uint16_t *min_bytes, uint16_t *max_bytes, uint16_t *min_ms, uint16_t *max_ms)
+{
+#if BRIDGE_ADAPT
+    *min_bytes = bridge.adapt_min_bytes;
+    *max_bytes = bridge.adapt_max_bytes;
+    *min_ms = bridge.adapt_min_ms;
+    *max_ms = bridge.adapt_max_ms;
+#else
+    *min_bytes = *max_bytes = bridge.batch_bytes;
+    *min_ms = *max_ms = bridge.batch_ms;
+#endif
+}
+
+void MavlinkBridge_GetBatching(uint16_t *bytes, uint16_t *deadline_ms)
+{
+    if (bytes != NULL) {
+        *bytes = bridge.batch_bytes;
+    }
+    if (deadline_ms != NULL) {
+        *deadline_ms = bridge.batch_ms;
+    }
+}
+
+#if SUMMARY_ENABLE
+bool MavlinkBridge_SetSummary(uint16_t interval_ms)
+{
+    if (interval_ms != 0 && (interval_ms < BRIDGE_SUMMARY_MIN || interval_ms > BRIDGE_SUMMARY_MAX)) {
+        return false;
+    }
+    /* A new interval, from no samples */
+    Summary_Init();
+    bridge.summary_ms = interval_ms;
+    bridge.summary_tick = HAL_GetTick();
+    LOG_INFO("Bridge summary: %u ms", (unsigned)interval_ms);
+    return true;
+}
+
+uint16_t MavlinkBridge_GetSummary(void)
+{
+    return bridge.summary_ms;
+}
+#endif
+
+void MavlinkBridge_SetStamps(bool on)
+{
+    bridge.stamps = on;
+    LOG_INFO("Bridge stamps: %s", on ? "on" : "off");
+}
+
+bool MavlinkBridge_GetStamps(void)
+{
+    return bridge.stamps;
+}
+
+bool MavlinkBridge_SetHeaderPack(bool on)
+{
+    if (on && !BRIDGE_HDR_PACK) {
+        return false;
+    }
+    /* Switched with the encoding, between batches */
+    bridge.hdr_next = on;
+    if (bridge.codec_next == NULL) {
+        bridge.codec_next = bridge.codec;
+    }
+    return true;
+}
+
+bool MavlinkBridge_GetHeaderPack(void)
+{
+    return bridge.bulk.hdr;
+}
+
+bool MavlinkBridge_Snapshot(void)
+{
+#if BRIDGE_SNAPSHOT
+    for (size_t i = 0; i < SNAP_COUNT; i++) {
+        if (bridge.snap_len[i] > 0) {
+            bridge.snap_pending = true;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+bool MavlinkBridge_Grounded(void)
+{
+    /* Disarmed but active, critical or in an emergency: still in the air, or about to be */
+    return !bridge.fc_armed && (bridge.fc_state <= MAV_STATE_STANDBY || bridge.fc_state == MAV_STATE_POWEROFF);
+}
+
+#if PROFILER_ENABLE
+/**
+ * @brief Build the codec benchmark sample: a slice of an autopilot stream
+ * @note  Half the payload words are full range (floats, coordinates), half
+ *        small integers with zero high bytes, as in real telemetry
+ * @return Sample length
+ */
+static size_t codec_sample(uint8_t *f)
+{
+    static const struct {
+        uint8_t msgid;
+        uint8_t len;
+    } mix[] = {
+        { 30, 28 }, { 33, 28 }, { 30, 28 }, { 74, 20 }, { 1, 31 }, { 24, 30 }, { 0, 9 }
+    };
+    uint32_t x = 0x2545F491U;
+    size_t n = 0;
+    
+    for (uint8_t i = 0; i < sizeof(mix) / sizeof(mix[0]); i++) {
+        uint8_t *p = &f[n + MAVLINK_HEADER_LEN];
+        
+        for (uint8_t j = 0; j < mix[i].len; j++) {
+            uint8_t byte = j & 3;
+            
+            if (byte == 0) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+            }
+            if ((j >> 2) & 1) {
+                p[j] = (byte == 0) ? (uint8_t)x : 0;        /* Small integer */
+            } else {
+                p[j] = (uint8_t)(x >> (8 * byte));          /* Full range */
+            }
+        }
+        n += frame_seal(&f[n], mix[i].len, i, 1, MAV_COMP_ID_AUTOPILOT1, mix[i].msgid);
+    }
+    return n;
+}
+
+uint8_t MavlinkBridge_CodecBench(MavlinkBridge_CodecCost_t *cost, uint8_t max)
+{
+    /* The sample sits behind the text in tx_buf, the decoder fills the downlink queue */
+    uint8_t *sample = (uint8_t *)&bridge.tx_buf[sizeof(bridge.tx_buf) - CODEC_SAMPLE_MAX];
+    const Codec_t *codec = bridge.codec;
+    uint32_t dec_acc = bridge.dec_acc;
+    uint8_t dec_n = bridge.dec_n;
+    uint16_t dec_bad = bridge.dec_bad;
+    uint16_t dl_rejected = bridge.dl_rejected, dl_unrouted = bridge.dl_unrouted, dl_dropped = bridge.dl_dropped;
+    uint8_t count = 0;
+    size_t bytes;
+    Lane_t lane;
+    
+    if (bridge.in_pass || bridge.bulk.frames > 0 || bridge.bulk.inflight > 0 || bridge.bulk.zc ||
+        bridge.crit.frames > 0 || A7600_MQTT_IsBusy(bridge.mqtt) || bridge.dl_head > 0 || bridge.dl_cur > 0 || bridge.dl_busy) {
+        return 0;
+    }
+#if OUTAGE_LOG_SPI
+    if (bridge.ol_lent) {
+        return 0;       /* The sample's place is the outage queue's */
+    }
+#endif
+    bytes = codec_sample(sample);
+    
+    for (uint8_t k = 0; k < 2 * BRIDGE_ENC_COUNT && count < max; k++) {
+        MavlinkBridge_CodecCost_t *c = &cost[count];
+        bool compress = (k >= BRIDGE_ENC_COUNT);
+        
+        if (compress && !BRIDGE_COMPRESS) {
+            break;
+        }
+        bridge.codec = &codecs[k % BRIDGE_ENC_COUNT];
+        c->name = bridge.codec->name;
+        c->compress = compress;
+        c->bytes = (uint16_t)bytes;
+        c->enc_cycles = UINT32_MAX;
+        c->dec_cycles = 0;
+        
+        /* Encode as the uplink does: frame by frame into a batch, then the finish */
+        for (uint8_t run = 0; run < CODEC_RUNS; run++) {
+            uint32_t start = Sched_Cycles();
+            uint32_t cycles;
+            
+            lane_init(&lane, bridge.tx_buf, sizeof(bridge.tx_buf) - CODEC_SAMPLE_MAX - 1, CODEC_SAMPLE_MAX,
+                      MQTT_QOS_0, compress);
+            for (size_t pos = 0; pos < bytes; ) {
+                UART_DMA_Span_t part[2] = { { &sample[pos], MAVLINK_HEADER_LEN + sample[pos + 1] +
+                                              MAVLINK_CHECKSUM_LEN }, { NULL, 0 } };
+                
+                lane_add(&lane, part, part[0].len, 0);
+                pos += part[0].len;
+            }
+            lane_close(&lane);
+            cycles = Sched_Cycles() - start;
+            if (cycles < c->enc_cycles) {
+                c->enc_cycles = cycles;
+            }
+        }
+        c->text = lane.len;
+        
+        /* Decode as the downlink does (the LZ stage is uplink only), checked against the sample */
+        c->ok = false;
+        if (!compress) {
+            for (uint8_t run = 0; run < CODEC_RUNS; run++) {
+                uint32_t start = Sched_Cycles();
+                uint32_t cycles;
+                
+                bridge.dec_acc = 0;
+                bridge.dec_n = 0;
+                bridge.dl_head = 0;
+                bridge.dl_commit = 0;
+                bridge.dl_cur = 0;
+#if BRIDGE_DL_DEDUP
+                bridge.dl_seen.count = 0;   /* Every run decodes the same frames */
+#endif
+                bridge.codec->decode((const uint8_t *)lane.buf, lane.len);
+                cycles = Sched_Cycles() - start;
+                if (c->dec_cycles == 0 || cycles < c->dec_cycles) {
+                    c->dec_cycles = cycles;
+                }
+            }
+            c->ok = (bridge.dl_commit == bytes && memcmp(bridge.dl_q, sample, bytes) == 0);
+        }
+        count++;
+    }
+    
+    /* Nothing of it reaches the FC or the next batch */
+    bridge.codec = codec;
+    bridge.dec_acc = dec_acc;
+    bridge.dec_n = dec_n;
+    bridge.dec_bad = dec_bad;
+    bridge.dl_head = 0;
+    bridge.dl_commit = 0;
+    bridge.dl_cur = 0;
+    bridge.dl_rejected = dl_rejected;
+    bridge.dl_unrouted = dl_unrouted;
+    bridge.dl_dropped = dl_dropped;
+#if BRIDGE_DL_DEDUP
+    bridge.dl_seen.count = 0;   /* Forgets real frames too - the FC link is idle here */
+#endif
+    return count;
+}
+#endif /* PROFILER_ENABLE */
+
+/**
+ * @brief One pass over the FC stream and the lanes
+ * @param publish false inside a blocking driver call: nothing is published,
+ *        frames go to the outage log as when offline
+ */
+static void bridge_pass(bool publish)
+{
+    uint32_t now = HAL_GetTick();
+#if BRIDGE_BACKPRESSURE
+    backpressure_step(now);
+#endif
+#if OUTAGE_LOG_SPI
+    OutageLog_Process();
+#endif
+#if FC_FLOW_RTS && BRIDGE_RTS_OUTAGE
+    rts_outage_step();
+#endif
+#if BRIDGE_XFER
+    xfer_step(now);
+#endif
+    radio_status(now);
+#if BRIDGE_MISSION_PROXY
+    mission_serve();
+#endif
+    dl_pump();
+#if BRIDGE_AUTOBAUD
+    autobaud_step(now);
+#endif
+#if BRIDGE_SHAPE
+    shape_step(now);
+#endif
+#if BRIDGE_SHAPER
+    shaper_refill(now);
+#endif
+    /* A zero-copy batch leaves the ring once its publish is done; until then
+     * nothing behind it may be consumed */
+    if (bridge.zc_release) {
+        UART_DMA_Consume(bridge.uart, bridge.zc_hold);
+        bridge.rx_len = (bridge.rx_len > bridge.zc_hold) ? bridge.rx_len - bridge.zc_hold : 0;
+        bridge.zc_hold = 0;
+        bridge.zc_release = false;
+    }
+    if (bridge.zc_hold > 0 && !bridge.bulk.zc) return;
+    /* Offline (reconnecting): frames are still parsed, selected ones go to the outage log */
+    bool online = publish && A7600_MQTT_IsConnected(bridge.mqtt);
+#if OUTAGE_LOG_SPI
+    /* Offline, tx_buf behind the open batch only waits: the outage queue takes
+     * it to ride out slow sector erases. Back online the batch needs it - still
+     * offline until the queue fits its own RAM again */
+    if (bridge.ol_lent) {
+        if (online && OutageLog_Reclaim()) {
+            bridge.ol_lent = false;
+        }
+        online = online && !bridge.ol_lent;
+    } else if (!online && !bridge.bulk.zc) {
+        size_t used = (size_t)(bridge.bulk.buf - bridge.tx_buf) + bridge.bulk.len + 1U;
+        
+        bridge.ol_lent = OutageLog_Lend((uint8_t *)&bridge.tx_buf[used], sizeof(bridge.tx_buf) - used);
+    }
+#endif
+    /* One publish in flight at a time - tx_buf is sent zero-copy. Meanwhile
+     * the next batch is parsed and encoded behind it; nothing is published */
+    bool busy = A7600_MQTT_IsBusy(bridge.mqtt);
+#if BRIDGE_OVERLAP
+    if (!busy) {
+        overlap_release();
+    }
+    if (online && busy && bridge.bulk.stored && !bp_dropping()) return;
+#else
+    if (online && busy) return;
+#endif
+    busy = busy && online;
+    if (!busy) {
+        codec_apply();
+    }
+
+    UART_DMA_Span_t s1, s2;
+    UART_DMA_Chunk_t chunk;
+    
+    /* New bytes come as chunks closed by the RX events (half ring, ring end,
+     * idle line, burst end) - taken here, parsed in place below */
+    while (UART_DMA_NextChunk(bridge.uart, &chunk)) {
+        bridge.rx_new = true;
+    }
+    
+    /* Our RADIO_STATUS joins an autopilot batch (rebuilt - the batch fill is current now) */
+    if (online && bridge.radio_pending && lane_fits(&bridge.bulk, RADIO_FRAME_LEN) &&
+        lane_takes(&bridge.bulk, ROUTE_BASE)) {
+        uint8_t radio[RADIO_FRAME_LEN];
+        UART_DMA_Span_t part[2] = { { radio, 0 }, { NULL, 0 } };
+        
+        part[0].len = radio_status_frame(radio);    /* First - it keeps the seq of the FC copy */
+        lane_stamp(&bridge.bulk, RADIO_FRAME_LEN, now);
+        bridge.bulk.route = ROUTE_BASE;
+        lane_add(&bridge.bulk, part, part[0].len, now);
+        bridge.radio_pending = false;
+    }
+    
+#if SUMMARY_ENABLE
+    /* The interval's summary joins an autopilot batch the same way */
+    if (online && bridge.summary_ms > 0 && now - bridge.summary_tick >= bridge.summary_ms &&
+        lane_fits(&bridge.bulk, SUMMARY_FRAME_LEN) && lane_takes(&bridge.bulk, ROUTE_BASE)) {
+        uint8_t summary[SUMMARY_FRAME_LEN];
+        UART_DMA_Span_t part[2] = { { summary, 0 }, { NULL, 0 } };
+        
+        lane_stamp(&bridge.bulk, SUMMARY_FRAME_LEN, now);
+        part[0].len = summary_frame(summary, now);
+        bridge.bulk.route = ROUTE_BASE;
+        lane_add(&bridge.bulk, part, part[0].len, now);
+    }
+#endif
+    
+#if BRIDGE_SNAPSHOT
+    /* ... and the state snapshot, asked for by a connect or a command - whole, in one batch */
+    if (online && bridge.snap_pending && !bridge.bulk.stored && lane_takes(&bridge.bulk, ROUTE_BASE) &&
+        snap_fill(now)) {
+        bridge.snap_pending = false;
+    }
+#endif
+
+#if BRIDGE_PRESENCE
+    /* ... and the presence record, if a HEARTBEAT came */
+    if (online && now - bridge.presence_tick >= BRIDGE_PRESENCE_MS && presence_heard() &&
+        lane_fits(&bridge.bulk, PRESENCE_FRAME_LEN) && lane_takes(&bridge.bulk, ROUTE_BASE)) {
+        uint8_t presence[PRESENCE_FRAME_LEN];
+        UART_DMA_Span_t part[2] = { { presence, 0 }, { NULL, 0 } };
+        
+        lane_stamp(&bridge.bulk, PRESENCE_FRAME_LEN, now);
+        part[0].len = presence_frame(presence, now);
+        bridge.bulk.route = ROUTE_BASE;
+        lane_add(&bridge.bulk, part, part[0].len, now);
+    }
+#endif
+
+#if BRIDGE_STATUS_CARRY
+    /* ... and a waiting status record - into a live batch only, never one of its own */
+    if (online && bridge.status_fn != NULL && bridge.bulk.frames > 0 && !bridge.bulk.stored &&
+        lane_fits(&bridge.bulk, STATUS_FRAME_LEN) && lane_takes(&bridge.bulk, ROUTE_BASE)) {
+        uint8_t status[STATUS_FRAME_LEN];
+        UART_DMA_Span_t part[2] = { { status, 0 }, { NULL, 0 } };
+        
+        part[0].len = status_frame(status);
+        lane_add(&bridge.bulk, part, part[0].len, now);
+    }
+#endif
+    
+    /* Critical frames preempt the open batch - the stream is parsed on if
+     * the driver's publish window is full */
+    if (online && !busy && bridge.crit.frames > 0) {
+        lane_flush(&bridge.crit);
+        if (bridge.crit.frames == 0) {
+            return;
+        }
+    }
+    
+    /* Stored frames (parameter answers first, then the outage log) go out
+     * between live batches, and whenever the FC is quiet */
+    if (online && !busy && (bridge.bulk.stored ||
+                   (bridge.bulk.frames == 0 && (bridge.replay_turn || (bridge.rx_len == 0 && !bridge.rx_new)) &&
+                    shaper_open() && (param_fill() || replay_fill())))) {
+        lane_flush(&bridge.bulk);
+        if (!bridge.bulk.stored || !bp_dropping()) {
+            return;
+        }
+        /* Held, and the ring about to lap: live frames are parsed (and dropped) behind it */
+    }
+    
+    /* Batch deadline - latency is bounded even when the stream is thin. On the
+     * ground a sleeping modem is left to sleep longer, and woken MQTT_WAKE_MS
+     * ahead of the deadline (or once the batch is half full: a burst) so the
+     * publish does not wait for it */
+    if (online && bridge.bulk.frames > 0) {
+        uint32_t deadline = bridge.batch_ms;
+        
+        if (MavlinkBridge_Grounded() && deadline < BRIDGE_GROUND_DEADLINE && A7600_MQTT_Asleep(bridge.mqtt)) {
+            deadline = BRIDGE_GROUND_DEADLINE;
+        }
+        if (!busy && now - bridge.bulk.tick >= deadline) {
+            lane_flush(&bridge.bulk);
+            if (bridge.bulk.frames == 0) {
+                return;
+            }
+            /* Held by the shaper - the batch stays open to frames */
+        }
+        if (now - bridge.bulk.tick + MQTT_WAKE_MS >= deadline || 2U * bridge.bulk.raw >= bridge.batch_bytes) {
+            A7600_MQTT_Wake(bridge.mqtt);
+        }
+    }
+
+    /* 1. A partial frame left over that is overdue cannot complete any more -
+     *    a corrupt start byte or length, or a cut frame. Only its start byte
+     *    goes: whatever followed it is parsed again. Passes skipped while a
+     *    publish was in flight do not count: if its bytes are in now, it is parsed */
+    if (bridge.rx_len > bridge.zc_hold && TIME_AFTER(Time_Us(), bridge.partial_due) &&
+        UART_DMA_Available(bridge.uart) < (size_t)bridge.zc_hold + bridge.partial_len) {
+        rx_release(bridge.zc_hold + 1);
+        bridge.rx_len = 0;
+        bridge.rx_new = true;
+        bridge_link.timeouts++;
+    }
+
+    /* 2. Look at unread data in place (frames are parsed from DMA memory) -
+     *    only once a chunk came: what the last pass left is a partial frame */
+    if (!bridge.rx_new) {
+        return;
+    }
+    bridge.rx_new = false;
+    size_t available = UART_DMA_Peek(bridge.uart, &s1, &s2);
+
+    /* 3. Parse MAVLink frames - garbage was consumed on the last pass, so a
+     *    pending partial frame starts at 0 (behind a zero-copy run) and costs no rescan */
+    size_t pos = bridge.zc_hold;
+    bool held = false;  /* Stopped at a complete frame */
+    while ((pos = span_sync(&s1, &s2, pos)) < available) {
+        /* Need at least 3 bytes */
+        if (available - pos < 3) {
+            break;
+        }
+
+        /* v1: no flags, 8-bit message ID in a 6-byte header */
+        bool v1 = (span_byte(&s1, &s2, pos) == MAVLINK_V1_MAGIC);
+        uint8_t header_len = v1 ? MAVLINK_V1_HEADER_LEN : MAVLINK_HEADER_LEN;
+        uint8_t payload_len = span_byte(&s1, &s2, pos + 1);
+        uint8_t incompat_flags = v1 ? 0 : span_byte(&s1, &s2, pos + 2);
+        
+        uint16_t packet_len = header_len + payload_len + MAVLINK_CHECKSUM_LEN;
+        if (incompat_flags & MAVLINK_IFLAG_SIGNED) {
+            packet_len += MAVLINK_SIG_LEN;
+        }
+
+        /* Sanity check */
+        if (packet_len > 300) {
+            pos++;
+            continue;
+        }
+        
+        /* Unknown message: a false sync (or nothing we forward) - skip it
+         * without waiting for the bytes it claims */
+        if (available - pos < header_len) {
+            break;
+        }
+        int idx = msg_index(v1 ? span_byte(&s1, &s2, pos + 5) :
+                            span_byte(&s1, &s2, pos + 7) | ((uint32_t)span_byte(&s1, &s2, pos + 8) << 8) |
+                            ((uint32_t)span_byte(&s1, &s2, pos + 9) << 16));
+        if (idx < 0) {
+            /* Whole and followed by a start byte: a real frame we do not
+             * forward - skipped whole, its seq still counts */
+            bridge_rejected++;
+            if (available - pos > packet_len && span_is_start(&s1, &s2, pos + packet_len)) {
+                source_track(&s1, &s2, pos, v1);
+                pos += packet_len;
+            } else {
+                pos++;
+            }
+            continue;
+        }
+        
+        /* A length its message cannot have: a false sync - skipped without waiting either */
+        if (!msg_len_valid(idx, v1, payload_len)) {
+            bridge_rejected++;
+            pos++;
+            continue;
+        }
+
+        /* Check if complete frame available */
+        if (available - pos < packet_len) {
+            break;
+        }
+
+        /* Complete frame - only a valid one is sent, the rest is resynced past */
+        UART_DMA_Span_t frame[2];
+        span_frame(&s1, &s2, pos, packet_len, frame);
+        if (!frame_valid(frame, (size_t)header_len + payload_len, msg_table[idx].extra)) {
+            bridge_rejected++;
+#if BRIDGE_AUTOBAUD
+            if (bridge.ab.bad < UINT8_MAX) {
+                bridge.ab.bad++;
+            }
+#endif
+            pos++;
+            continue;
+        }
+#if BRIDGE_AUTOBAUD
+        if (bridge.ab.valid < UINT8_MAX) {
+            bridge.ab.valid++;
+        }
+#endif
+        uint8_t src = source_track(&s1, &s2, pos, v1);
+        
+        /* Autopilot armed or on the ground: the modem sleeps between batches only on the ground */
+        if (msg_table[idx].msgid == HEARTBEAT_ID) {
+            armed_snoop(frame, v1);
+        }
+        
+        /* Our own parameter list request being answered - cached, not sent */
+        if (param_snoop(frame, v1, msg_table[idx].msgid, now)) {
+            pos += packet_len;
+            continue;
+        }
+        
+#if BRIDGE_MISSION_PROXY
+        /* The FC asking for a mission item the bridge holds - answered here */
+        if (mission_snoop(frame, v1, msg_table[idx].msgid, now)) {
+            pos += packet_len;
+            continue;
+        }
+#endif
+
+#if BRIDGE_SHAPE
+        /* Answer to our own SET_MESSAGE_INTERVAL */
+        if (shape_snoop(frame, v1, idx, now)) {
+            pos += packet_len;
+            continue;
+        }
+#endif
+        
+        /* Source routed off */
+        if (bridge.src[src].prio == BRIDGE_PRIO_OFF) {
+            bridge_link.route_dropped++;
+            pos += packet_len;
+            continue;
+        }
+        
+#if ANOMALY_ENABLE
+        /* Autopilot state scored before any limit decimates it */
+        if (bridge.src[src].compid == MAV_COMP_ID_AUTOPILOT1 && Anomaly_Wants(msg_table[idx].msgid)) {
+            uint8_t payload[ANOMALY_PAYLOAD_MAX];
+            
+            frame_payload(frame, header_len, 0, payload, sizeof(payload));
+            Anomaly_Feed(msg_table[idx].msgid, span_byte(&frame[0], &frame[1], v1 ? 2 : 4), payload, now);
+        }
+#endif
+        
+#if FIELDS_ENABLE
+        /* Latest position, battery and mode for the decoded-fields topic, online or not */
+        if (bridge.src[src].compid == MAV_COMP_ID_AUTOPILOT1 && TelemFields_Wants(msg_table[idx].msgid)) {
+            uint8_t payload[FIELDS_PAYLOAD_MAX];
+            
+            frame_payload(frame, header_len, 0, payload, sizeof(payload));
+            TelemFields_Feed(msg_table[idx].msgid, bridge.src[src].sysid, payload, now);
+        }
+#endif
+
+#if BRIDGE_SNAPSHOT
+        /* Slow autopilot state, kept for the snapshot after a connect (frame as it came) */
+        if (bridge.src[src].compid == MAV_COMP_ID_AUTOPILOT1) {
+            snap_keep(frame, packet_len, msg_table[idx].msgid);
+        }
+#endif
+
+#if BRIDGE_PRESENCE
+        /* A HEARTBEAT repeating its source's state - counted into the presence record */
+        if (msg_table[idx].msgid == HEARTBEAT_ID && presence_fold(frame, header_len, src, online)) {
+            bridge_link.hb_folded++;
+            pos += packet_len;
+            continue;
+        }
+#endif
+        
+        /* No link - decimated into the outage log, the rest is lost */
+        if (!online) {
+            if (keep_due(idx, (uint16_t)now) && OutageLog_Put(frame, packet_len)) {
+                bridge.last_sent[idx] = (uint16_t)now;
+                bridge_link.outage_kept++;
+            } else {
+                bridge_link.outage_dropped++;
+            }
+            pos += packet_len;
+            continue;
+        }
+        
+#if SUMMARY_ENABLE
+        /* Summarized - the samples go into the interval's statistics, not up */
+        if (bridge.summary_ms > 0 && bridge.src[src].compid == MAV_COMP_ID_AUTOPILOT1 &&
+            Summary_Wants(msg_table[idx].msgid)) {
+            uint8_t payload[SUMMARY_PAYLOAD_MAX];
+            
+            frame_payload(frame, header_len, 0, payload, sizeof(payload));
+            Summary_Feed(msg_table[idx].msgid, payload);
+            bridge_link.summarized++;
+            pos += packet_len;
+            continue;
+        }
+#endif
+        
+#if BRIDGE_XFER
+        if (msg_table[idx].msgid == LOG_DATA_ID || msg_table[idx].msgid == FILE_TRANSFER_PROTOCOL_ID) {
+            xfer_frame(now);
+        }
+#endif
+        
+        /* Over its uplink limit - decimated */
+        if (!rate_due(idx, (uint16_t)now)) {
+            bridge_link.rate_dropped++;
+            pos += packet_len;
+            continue;
+        }
+        
+#if BRIDGE_SHAPER
+        /* Over the link's capacity: limited messages thinned to their outage
+         * log rate while the bucket is empty. A batch it holds raises the
+         * congestion level (backpressure_step): low priority is shed below,
+         * the rest waits for the bucket up to BP_DROP */
+        if (bridge.shaper.tokens < 0 && bridge.rate[idx] != RATE_ALWAYS && !keep_due(idx, (uint16_t)now)) {
+            bridge_link.shaper_thinned++;
+            pos += packet_len;
+            continue;
+        }
+#endif
+        
+#if BRIDGE_XFER
+        /* A transfer runs: it goes ahead of limited messages, thinned to their outage log rate */
+        if (bridge.xfer && bridge.rate[idx] != RATE_ALWAYS && !keep_due(idx, (uint16_t)now)) {
+            bridge_link.xfer_thinned++;
+            pos += packet_len;
+            continue;
+        }
+#endif
+
+#if BRIDGE_BACKPRESSURE
+        /* Congested: low priority goes first - limited messages thinned to
+         * their outage log rate, then dropped along with bulk-priority
+         * sources while the loss-tolerant streams are thinned (critical
+         * messages stay) */
+        if (bridge.bp_level >= BP_SHED && msg_table[idx].lane != LANE_CRITICAL &&
+            (bridge.rate[idx] != RATE_ALWAYS || bridge.src[src].prio == BRIDGE_PRIO_BULK ||
+             (msg_table[idx].lane == LANE_STREAM && !keep_due(idx, (uint16_t)now)))) {
+            bridge_link.bp_shed++;
+            pos += packet_len;
+            continue;
+        }
+        if (bridge.bp_level >= BP_THIN && bridge.rate[idx] != RATE_ALWAYS && !keep_due(idx, (uint16_t)now)) {
+            bridge_link.bp_thinned++;
+            pos += packet_len;
+            continue;
+        }
+#endif
+        
+        /* Same source and payload as the last one sent - suppressed until the refresh */
+        uint16_t hash = 0;
+        if (BRIDGE_DEDUP_REFRESH && msg_table[idx].dedup != DEDUP_OFF) {
+            hash = frame_hash(frame, v1, header_len, (size_t)header_len + payload_len, msg_table[idx].dedup);
+        }
+        if (frame_unchanged(idx, hash, (uint16_t)now)) {
+            bridge_link.deduped++;
+            pos += packet_len;
+            continue;
+        }
+        
+        /* What goes up: the frame as it came, or re-encoded as a shorter v2 frame */
+        const UART_DMA_Span_t *send = frame;
+        uint8_t parts = 2;
+        size_t send_len = packet_len;
+        const Pack_t *pk = NULL;
+#if BRIDGE_V2_PACK
+        Pack_t pack;
+        
+        if (frame_pack(frame, v1, msg_table[idx].extra, &pack)) {
+            pk = &pack;
+            send = pack.part;
+            parts = PACK_PARTS;
+            send_len = pack.len;
+        }
+#endif
+        uint8_t lane = (bridge.src[src].prio == BRIDGE_PRIO_BULK) ? LANE_BULK : msg_table[idx].lane;
+        uint16_t route = source_route(src);
+        uint32_t arrival = UART_DMA_RxArrivalTick(bridge.uart, pos + packet_len - 1);
+#if BRIDGE_FAIR
+        /* Congested: a source past its share of the round gives way to the others */
+        if (lane != LANE_CRITICAL && fair_congested() && !fair_due(src, send_len, now)) {
+            bridge_link.fair_dropped++;
+            pos += packet_len;
+            continue;
+        }
+#endif
+        if (lane == LANE_CRITICAL && ENCODED_LEN(send_len) <= CRIT_TEXT_MAX) {
+            /* Published as soon as the driver is free - the batch waits (crit_buf may be in flight) */
+            if (!busy && lane_fits(&bridge.crit, send_len) && lane_takes(&bridge.crit, route)) {
+                bridge.crit.route = route;
+                lane_add_parts(&bridge.crit, send, parts, send_len, arrival);
+                frame_sent(idx, hash, pk, (uint16_t)now);
+                pos += packet_len;
+                held = true;
+                break;
+            }
+            /* ... with the ring about to lap it joins the open batch rather than hold the parser */
+            if (!bp_dropping()) {
+                held = true;
+                break;
+            }
+        }
+        if (lane == LANE_STREAM && BRIDGE_STREAM_UDP && A7600_MQTT_DatagramReady(bridge.mqtt)) {
+            /* Datagram needs tx_buf - an open batch goes out first (a busy driver: both wait) */
+            if (!busy && bridge.bulk.frames > 0) {
+                lane_flush(&bridge.bulk);
+            } else if (!busy && send_datagram(send, parts, send_len)) {
+                frame_sent(idx, hash, pk, (uint16_t)now);
+#if BRIDGE_FAIR
+                fair_charge(src, send_len);
+#endif
+                pos += packet_len;
+                bridge.frames++;
+                bridge.bytes += send_len;
+                held = true;
+                break;
+            }
+            /* ... the same */
+            if (!bp_dropping()) {
+                held = true;
+                break;
+            }
+        }
+        lane_stamp(&bridge.bulk, send_len, arrival);
+        if (!lane_fits(&bridge.bulk, send_len) || !lane_takes(&bridge.bulk, route) || bridge.bulk.stored) {
+            /* Byte budget reached, another source's topic or stored frames - the frame opens the next batch */
+            if (!busy) {
+                lane_flush(&bridge.bulk);
+            }
+            /* ... unless the batch could not go (in flight, held by the
+             * shaper or the driver's window full) and the ring is about to
+             * lap: this frame is dropped, not the ones the FC sends next */
+            if (bp_dropping() && (busy || bridge.bulk.frames > 0)) {
+                bridge_link.bp_dropped++;
+                pos += packet_len;
+                continue;
+            }
+            held = true;    /* ... once the batch in flight is out */
+            break;
+        }
+        bridge.bulk.route = route;
+        if (pk != NULL || !lane_add_zc(&bridge.bulk, &s1, pos, packet_len, arrival)) {
+            lane_add_parts(&bridge.bulk, send, parts, send_len, arrival);
+        }
+        frame_sent(idx, hash, pk, (uint16_t)now);
+#if BRIDGE_FAIR
+        fair_charge(src, send_len);
+#endif
+        pos += packet_len;
+    }
+    
+    /* Rest is looked at once the publish is done - not a stale partial */
+    if (held) {
+        if (bridge.crit.frames > 0 && !A7600_MQTT_IsBusy(bridge.mqtt)) {
+            lane_flush(&bridge.crit);
+        }
+        rx_release(pos);
+        bridge.rx_len = 0;
+        bridge.rx_new = true;
+        return;
+    }
+
+    /* Drop leading garbage, keep partial frame for next pass */
+    if (pos < available) {
+        bridge.partial_due = partial_due(&s1, &s2, pos, available, &bridge.partial_len);
+    }
+    bridge.rx_len = available - rx_release(pos);
+}
+
+void MavlinkBridge_Process(void)
+{
+    if (bridge.uart == NULL || bridge.mqtt == NULL || bridge.in_pass) return;
+    PROF_BEGIN(PROF_BRIDGE_PROCESS);
+    bridge.in_pass = true;
+    bridge_pass(true);
+    bridge.in_pass = false;
+    PROF_END(PROF_BRIDGE_PROCESS);
+}
+
+bool MavlinkBridge_Downlink(void)
+{
+    if (bridge.uart == NULL || bridge.mqtt == NULL || bridge.in_pass) return false;
+    bridge.in_pass = true;
+    radio_status(HAL_GetTick());
+    dl_pump();
+    bridge.in_pass = false;
+    return (bridge.dl_commit > 0);
+}
+
+void MavlinkBridge_Idle(void)
+{
+    if (bridge.uart == NULL || bridge.mqtt == NULL || bridge.in_pass) return;
+    bridge.in_pass = true;
+    bridge_pass(false);
+    bridge.in_pass = false;
+}
+
+void MavlinkBridge_OnChunk(const char *topic, const uint8_t *data, size_t len,
+                          size_t offset, size_t total)
+{
+    (void)topic;
+    if (bridge.uart == NULL) return;
+
+    if (offset == 0) {
+        LOG_INFO("Bridge Rx Msg: Topic=%s Len=%d", topic, (int)total);
+        bridge.dec_n = 0;
+        bridge.dec_acc = 0;
+        bridge.dec_bad = 0;
+        bridge.dl_dropped = 0;
+        bridge.dl_rejected = 0;
+        bridge.dl_unrouted = 0;
+        bridge.dec_codec = bridge.codec;    /* A switch takes effect between messages */
+        dl_reset();
+    }
+
+    /* Decode as the payload streams in - message size is not limited by RAM */
+    bridge.dec_codec->decode(data, len);
+    
+    /* Frames go out as they complete; one spanning messages is not one */
+    dl_pump();
+    if (offset + len >= total) {
+        if (bridge.dl_cur > 0) {
+            LOG_WARN("Bridge Rx: message ends inside a frame");
+            dl_reset();
+        }
+        if (bridge.dl_rejected > 0) {
+            LOG_WARN("Bridge Rx: %u invalid frames not forwarded", (unsigned)bridge.dl_rejected);
+        }
+        if (bridge.dl_unrouted > 0) {
+            LOG_WARN("Bridge Rx: %u frames for unknown targets not forwarded", (unsigned)bridge.dl_unrouted);
+        }
+        if (bridge.dl_dropped > 0) {
+            LOG_WARN("Bridge Rx: downlink queue full - dropped %u frames", (unsigned)bridge.dl_dropped);
+        }
+        if (bridge.dec_bad > 0) {
+            LOG_WARN("Bridge Rx: %u invalid characters skipped", (unsigned)bridge.dec_bad);
         }
-    } else {
-        LOG_WARN("Bridge Ignored Topic: %s", topic);
     }
 }
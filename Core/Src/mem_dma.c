@@ -0,0 +1,197 @@
+/**
+ * @file    mem_dma.c
+ * @brief   Memory-to-memory copies and fills on DMA1 channel 1, in the background
+ * @version 1.0
+ */
+
+#include "mem_dma.h"
+
+MemDma_Stats_t mem_dma_stats;
+
+#if MEM_DMA_ENABLE && !defined(BENCH_HOST)
+
+#include "main.h"
+#include "scheduler.h"
+
+#define DMA_UNITS_MAX       0xFFFFU     /* CNDTR is 16 bits */
+#define DMA_BY_BYTE         (DMA_CCR_MEM2MEM | DMA_CCR_MINC)
+#define DMA_BY_WORD         (DMA_CCR_MEM2MEM | DMA_CCR_MINC | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1)
+
+/* Channel owner */
+enum {
+    OWNER_NONE = 0,
+    OWNER_COPY,                         /* A MemDma_Move / MemDma_Fill runs */
+    OWNER_CLAIM                         /* MemDma_Claim */
+};
+
+static volatile uint8_t owner;
+static uint32_t fill_word;              /* Fill source: the value in each byte */
+static uint8_t tail[3];                 /* Bytes behind the words, written when done */
+static uint8_t *tail_at;
+static uint8_t tail_len;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Take the channel if free (a thread or interrupt may try at the same time)
+ */
+static bool take(uint8_t who)
+{
+    uint32_t primask = __get_PRIMASK();
+    bool free;
+    
+    __disable_irq();
+    free = (owner == OWNER_NONE);
+    if (free) {
+        owner = who;
+    }
+    __set_PRIMASK(primask);
+    return free;
+}
+
+/**
+ * @brief Program and enable the channel: CPAR is read, CMAR written (DIR 0)
+ */
+static void start(void *dst, const void *src, uint32_t units, uint32_t ccr)
+{
+    DMA1_Channel1->CCR = 0;
+    DMA1_Channel1->CPAR = (uintptr_t)src;
+    DMA1_Channel1->CMAR = (uintptr_t)dst;
+    DMA1_Channel1->CNDTR = units;
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    DMA1_Channel1->CCR = ccr | DMA_CCR_EN;
+    mem_dma_stats.moves++;
+}
+
+/**
+ * @brief Copy by DMA - the caller checked length and overlap and took the channel
+ */
+static void move_dma(uint8_t *d, const uint8_t *s, size_t len)
+{
+    if ((((uintptr_t)d ^ (uintptr_t)s) & 3U) != 0) {
+        tail_len = 0;
+        start(d, s, (uint32_t)len, DMA_BY_BYTE | DMA_CCR_PINC);
+        return;
+    }
+    /* Same alignment: bytes up to a word boundary now, the tail kept - the
+     * words written are below the source's or clear of it, never its tail */
+    while (((uintptr_t)d & 3U) != 0) {
+        *d++ = *s++;
+        len--;
+    }
+    tail_len = (uint8_t)(len & 3U);
+    tail_at = d + (len & ~(size_t)3U);
+    for (uint8_t i = 0; i < tail_len; i++) {
+        tail[i] = s[(len & ~(size_t)3U) + i];
+    }
+    start(d, s, (uint32_t)(len / 4U), DMA_BY_WORD | DMA_CCR_PINC);
+}
+
+/**
+ * @brief The copy is done: free the channel, write the tail
+ */
+static void finish(void)
+{
+    DMA1_Channel1->CCR = 0;
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    for (uint8_t i = 0; i < tail_len; i++) {
+        tail_at[i] = tail[i];
+    }
+    tail_len = 0;
+    owner = OWNER_NONE;
+}
+
+/* ==================== Public Functions ==================== */
+
+void MemDma_Init(void)
+{
+    uint32_t buf[MEM_DMA_TEST_LEN / 4];
+    const uint8_t *block = (const uint8_t *)FLASH_BASE;
+    uint32_t t0, t1, t2, t3;
+    
+    t0 = Sched_Cycles();
+    memcpy(buf, block, sizeof(buf));
+    mem_dma_stats.cpu_cycles = Sched_Cycles() - t0;
+    
+    if (!take(OWNER_COPY)) {
+        return;
+    }
+    t0 = Sched_Cycles();
+    move_dma((uint8_t *)buf, block, sizeof(buf));
+    t1 = Sched_Cycles();
+    while (!(DMA1->ISR & (DMA_ISR_TCIF1 | DMA_ISR_TEIF1))) {
+    }
+    t2 = Sched_Cycles();
+    MemDma_Wait();
+    t3 = Sched_Cycles();
+    
+    mem_dma_stats.start_cycles = (t1 - t0) + (t3 - t2);
+    mem_dma_stats.dma_cycles = t2 - t0;
+    if (mem_dma_stats.cpu_cycles > 0) {
+        uint32_t cross = mem_dma_stats.start_cycles * MEM_DMA_TEST_LEN / mem_dma_stats.cpu_cycles;
+        
+        mem_dma_stats.cross = (uint16_t)((cross > 0xFFFFU) ? 0xFFFFU : cross);
+    }
+    mem_dma_stats.moves = 0;
+}
+
+void MemDma_Move(void *dst, const void *src, size_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    
+    /* The channel runs upwards: a destination above an overlapping source is the core's */
+    if (len < MEM_DMA_MIN || len > DMA_UNITS_MAX || (d > s && d < s + len) || !take(OWNER_COPY)) {
+        memmove(dst, src, len);
+        return;
+    }
+    move_dma(d, s, len);
+}
+
+void MemDma_Fill(void *dst, uint8_t value, size_t len)
+{
+    uint8_t *d = (uint8_t *)dst;
+    
+    if (len < MEM_DMA_MIN || len / 4U > DMA_UNITS_MAX || !take(OWNER_COPY)) {
+        memset(dst, value, len);
+        return;
+    }
+    while (((uintptr_t)d & 3U) != 0) {
+        *d++ = value;
+        len--;
+    }
+    memset(d + (len & ~(size_t)3U), value, len & 3U);    /* Not under the transfer */
+    fill_word = value * 0x01010101U;
+    tail_len = 0;
+    start(d, &fill_word, (uint32_t)(len / 4U), DMA_BY_WORD);
+}
+
+bool MemDma_Busy(void)
+{
+    if (owner != OWNER_COPY) {
+        return false;
+    }
+    if (DMA1->ISR & (DMA_ISR_TCIF1 | DMA_ISR_TEIF1)) {
+        finish();
+        return false;
+    }
+    return true;
+}
+
+void MemDma_Wait(void)
+{
+    while (MemDma_Busy()) {
+    }
+}
+
+bool MemDma_Claim(void)
+{
+    return take(OWNER_CLAIM);
+}
+
+void MemDma_Release(void)
+{
+    owner = OWNER_NONE;
+}
+
+#endif /* MEM_DMA_ENABLE */
@@ -0,0 +1,270 @@
+/**
+ * @file    metrics.c
+ * @brief   Static metrics registry: counters read in place, one serializer for status and RTT
+ * @version 1.1
+ */
+
+#include "metrics.h"
+#include "app.h"
+#include "mavlink_bridge.h"
+#include "echo_probe.h"
+#include "link_profile.h"
+#include "crc32.h"
+#include "mem_dma.h"
+#include "debug_log.h"
+
+#if METRICS_RTT && (!DEBUG_RTT || DEBUG_RTT_CAPTURE == 0)
+#error "METRICS_RTT needs DEBUG_RTT and the capture channel (build with -DMETRICS_RTT=1)"
+#endif
+
+#define METRICS_RTT_HDR     7       /* Type, length, tick - as AT_CAPTURE_HDR */
+#define METRICS_RTT_PAGE    64      /* Body bytes per record: a histogram and some */
+
+/* The modules' variables (main.c) */
+extern UART_DMA_Handle_t sim_uart;
+extern UART_DMA_Handle_t telem_uart;
+extern App_Handle_t app;
+
+#define METRIC_DESC(id, name, type, addr)   { name, addr, type },
+
+const Metric_Desc_t metrics_table[METRICS_COUNT] = {
+    METRICS_TABLE(METRIC_DESC)
+};
+
+/* ==================== Private Functions ==================== */
+
+static uint8_t metric_values(uint8_t type)
+{
+    return (type == METRIC_HIST) ? BRIDGE_LAT_BUCKETS : 1U;
+}
+
+static uint8_t metric_width(uint8_t type)
+{
+    return (type == METRIC_U16 || type == METRIC_I16) ? 2U : (type == METRIC_U8 || type == METRIC_I8) ? 1U : 4U;
+}
+
+static bool metric_signed(uint8_t type)
+{
+    return (type == METRIC_I16 || type == METRIC_I8);
+}
+
+/**
+ * @brief Value i of a metric (bucket i of a histogram), read in place - signed ones sign-extended
+ */
+static uint32_t metric_value(const Metric_Desc_t *m, uint8_t i)
+{
+    switch (m->type) {
+        case METRIC_U16:
+            return *(const volatile uint16_t *)m->addr;
+        case METRIC_U8:
+            return *(const volatile uint8_t *)m->addr;
+        case METRIC_I16:
+            return (uint32_t)(int32_t)*(const volatile int16_t *)m->addr;
+        case METRIC_I8:
+            return (uint32_t)(int32_t)*(const volatile int8_t *)m->addr;
+        default:
+            return ((const volatile uint32_t *)m->addr)[i];
+    }
+}
+
+/**
+ * @brief Append text at n
+ * @return Offset past it; more than size if it does not fit
+ */
+static size_t text_put(char *buf, size_t n, size_t size, const char *s)
+{
+    while (*s != '\0') {
+        if (n >= size) {
+            return size + 1;
+        }
+        buf[n++] = *s++;
+    }
+    return n;
+}
+
+static size_t text_u32(char *buf, size_t n, size_t size, uint32_t value)
+{
+    char digits[11];
+    uint8_t len = 0;
+    
+    do {
+        digits[len++] = (char)('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0);
+    if (n + len > size) {
+        return size + 1;
+    }
+    while (len > 0) {
+        buf[n++] = digits[--len];
+    }
+    return n;
+}
+
+/**
+ * @brief Append ,"name":value - or ,"name":[v,...] for a histogram
+ * @return Offset past it; more than size if it does not fit
+ */
+static size_t text_metric(char *buf, size_t n, size_t size, const Metric_Desc_t *m)
+{
+    uint8_t values = metric_values(m->type);
+    
+    if (n > 0) {
+        n = text_put(buf, n, size, ",");
+    }
+    if (n <= size) {
+        n = text_put(buf, n, size, "\"");
+    }
+    if (n <= size) {
+        n = text_put(buf, n, size, m->name);
+    }
+    if (n <= size) {
+        n = text_put(buf, n, size, (m->type == METRIC_HIST) ? "\":[" : "\":");
+    }
+    for (uint8_t i = 0; i < values && n <= size; i++) {
+        uint32_t value = metric_value(m, i);
+        
+        if (i > 0) {
+            n = text_put(buf, n, size, ",");
+        }
+        if (metric_signed(m->type) && (int32_t)value < 0 && n <= size) {
+            n = text_put(buf, n, size, "-");
+            value = 0U - value;
+        }
+        if (n <= size) {
+            n = text_u32(buf, n, size, value);
+        }
+    }
+    if (m->type == METRIC_HIST && n <= size) {
+        n = text_put(buf, n, size, "]");
+    }
+    return n;
+}
+
+/* ==================== Public Functions ==================== */
+
+size_t Metrics_Text(char *buf, size_t size, uint8_t *next)
+{
+    size_t n = 0;
+    uint8_t id = *next;
+    
+    while (id < METRICS_COUNT) {
+        size_t end = text_metric(buf, n, size, &metrics_table[id]);
+        
+        if (end > size) {
+            break;              /* Stays for the next page */
+        }
+        n = end;
+        id++;
+    }
+    *next = (id < METRICS_COUNT) ? id : 0U;
+    return n;
+}
+
+size_t Metrics_Binary(uint8_t *buf, size_t size, uint8_t *next)
+{
+    size_t n = 1;
+    uint8_t id = *next;
+    
+    if (size < 1) {
+        return 0;
+    }
+    buf[0] = id;
+    while (id < METRICS_COUNT) {
+        const Metric_Desc_t *m = &metrics_table[id];
+        uint8_t width = metric_width(m->type);
+        uint8_t values = metric_values(m->type);
+        
+        if (n + (size_t)width * values > size) {
+            break;
+        }
+        for (uint8_t i = 0; i < values; i++) {
+            uint32_t value = metric_value(m, i);
+            
+            for (uint8_t b = 0; b < width; b++) {
+                buf[n++] = (uint8_t)(value >> (8U * b));
+            }
+        }
+        id++;
+    }
+    if (id == *next) {
+        return 0;
+    }
+    *next = (id < METRICS_COUNT) ? id : 0U;
+    return n;
+}
+
+#if METRICS_PERF
+static void put_le32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+uint32_t Metrics_Schema(void)
+{
+    static uint32_t schema;
+    
+    /* Fixed by the image: hashed once */
+    if (schema == 0) {
+        uint32_t h = 2166136261U;
+        
+        for (uint8_t id = 0; id < METRICS_COUNT; id++) {
+            const char *c = metrics_table[id].name;
+            
+            do {
+                h = (h ^ (uint8_t)*c) * 16777619U;
+            } while (*c++ != '\0');
+            h = (h ^ metrics_table[id].type) * 16777619U;
+            h = (h ^ metric_values(metrics_table[id].type)) * 16777619U;
+        }
+        schema = h;
+    }
+    return schema;
+}
+
+size_t Metrics_Perf(uint8_t *buf, size_t size, uint32_t now)
+{
+    uint8_t next = 0;
+    
+    if (size < METRICS_PERF_SIZE) {
+        return 0;
+    }
+    buf[0] = METRICS_PERF_TYPE;
+    buf[1] = METRICS_PERF_VERSION;
+    put_le32(&buf[2], Metrics_Schema());
+    put_le32(&buf[6], now);
+    return METRICS_PERF_HDR + Metrics_Binary(&buf[METRICS_PERF_HDR], size - METRICS_PERF_HDR, &next);
+}
+#endif /* METRICS_PERF */
+
+#if METRICS_RTT
+void Metrics_Capture(uint32_t now)
+{
+    static uint32_t last;
+    uint8_t hdr[METRICS_RTT_HDR];
+    uint8_t page[METRICS_RTT_PAGE];
+    uint8_t next = 0;
+    
+    if (now - last < METRICS_RTT_INTERVAL) {
+        return;
+    }
+    last = now;
+    hdr[0] = METRICS_RTT_TYPE;
+    hdr[3] = (uint8_t)now;
+    hdr[4] = (uint8_t)(now >> 8);
+    hdr[5] = (uint8_t)(now >> 16);
+    hdr[6] = (uint8_t)(now >> 24);
+    
+    do {
+        size_t len = Metrics_Binary(page, sizeof(page), &next);
+        
+        hdr[1] = (uint8_t)len;
+        hdr[2] = (uint8_t)(len >> 8);
+        if (len == 0 || !Debug_CaptureWrite(hdr, sizeof(hdr), page, len)) {
+            break;              /* Probe behind: the whole registry again next interval */
+        }
+    } while (next != 0);
+}
+#endif /* METRICS_RTT */
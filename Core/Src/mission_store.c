@@ -0,0 +1,117 @@
+/**
+ * @file    mission_store.c
+ * @brief   Flash copy of a mission upload, kept for the bridge's local handshake with the FC
+ * @version 1.0
+ */
+
+#include "mission_store.h"
+#include "outage_log.h"
+#include <string.h>
+
+#if MISSION_STORE_ADDR + MISSION_STORE_PAGES * MISSION_STORE_PAGE_SIZE > OUTAGE_LOG_ADDR
+#error "Mission store overlaps the outage log"
+#endif
+
+#define MS_PER_PAGE     (MISSION_STORE_PAGE_SIZE / MISSION_STORE_RECORD)
+#define MS_ADDR(s)      (MISSION_STORE_ADDR + (uint32_t)(s) * MISSION_STORE_RECORD)
+
+/* MISSION_ITEM_INT payload offsets (common.xml, wire order) */
+#define ITEM_COORDS     28      /* param1-4, x, y, z */
+#define ITEM_COMMAND    30
+#define ITEM_FRAME      34
+#define ITEM_CURRENT    35
+#define ITEM_AUTOCONT   36
+
+/* Items held and pages erased in this upload - RAM only, so a reset empties it */
+static struct {
+    uint16_t count;
+    uint8_t erased;     /* Page bits */
+    uint8_t held[(MISSION_STORE_MAX + 7) / 8];
+} store;
+
+/* ==================== Private Functions ==================== */
+
+static HAL_StatusTypeDef erase_page(uint8_t page)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error;
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = MISSION_STORE_ADDR + (uint32_t)page * MISSION_STORE_PAGE_SIZE;
+    erase.NbPages = 1;
+    return HAL_FLASHEx_Erase(&erase, &error);
+}
+
+/* ==================== Public Functions ==================== */
+
+void MissionStore_Clear(void)
+{
+    memset(&store, 0, sizeof(store));
+}
+
+bool MissionStore_Put(uint16_t seq, const uint8_t *item)
+{
+    uint8_t rec[MISSION_STORE_RECORD];
+    uint8_t page = (uint8_t)(seq / MS_PER_PAGE);
+    HAL_StatusTypeDef status = HAL_OK;
+    
+    if (seq >= MISSION_STORE_MAX) {
+        return false;
+    }
+    if (MissionStore_Has(seq)) {
+        return true;
+    }
+    memcpy(rec, item, ITEM_COORDS);
+    rec[28] = item[ITEM_COMMAND];
+    rec[29] = item[ITEM_COMMAND + 1];
+    rec[30] = item[ITEM_FRAME];
+    rec[31] = (uint8_t)((item[ITEM_CURRENT] & 1) | ((item[ITEM_AUTOCONT] & 1) << 1));
+    
+    HAL_FLASH_Unlock();
+    if (!(store.erased & (1u << page))) {
+        status = erase_page(page);
+        if (status == HAL_OK) {
+            store.erased |= (uint8_t)(1u << page);
+        }
+    }
+    for (uint8_t i = 0; status == HAL_OK && i < MISSION_STORE_RECORD / 2; i++) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, MS_ADDR(seq) + 2U * i,
+                                   (uint16_t)(rec[2 * i] | (rec[2 * i + 1] << 8)));
+    }
+    HAL_FLASH_Lock();
+    
+    if (status != HAL_OK) {
+        return false;
+    }
+    store.held[seq / 8] |= (uint8_t)(1u << (seq % 8));
+    store.count++;
+    return true;
+}
+
+bool MissionStore_Has(uint16_t seq)
+{
+    return (seq < MISSION_STORE_MAX && (store.held[seq / 8] & (1u << (seq % 8))) != 0);
+}
+
+bool MissionStore_Get(uint16_t seq, uint8_t *item)
+{
+    const uint8_t *rec;
+    
+    if (!MissionStore_Has(seq)) {
+        return false;
+    }
+    rec = (const uint8_t *)(uintptr_t)MS_ADDR(seq);
+    memset(item, 0, MISSION_ITEM_INT_LEN);
+    memcpy(item, rec, ITEM_COORDS);
+    item[ITEM_COMMAND] = rec[28];
+    item[ITEM_COMMAND + 1] = rec[29];
+    item[ITEM_FRAME] = rec[30];
+    item[ITEM_CURRENT] = rec[31] & 1;
+    item[ITEM_AUTOCONT] = (rec[31] >> 1) & 1;
+    return true;
+}
+
+uint16_t MissionStore_Count(void)
+{
+    return store.count;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file    modem_power.c
+ * @brief   Modem power-on pulse, timed by the scheduler instead of a blocking delay
+ * @version 1.0
+ */
+
+#include "modem_power.h"
+#include "boot_profile.h"
+
+static bool pending;
+static uint32_t pulse_start;
+
+/**
+ * @brief Power lines high - module powering up
+ */
+static void release(void)
+{
+    GPIOB->ODR |= (0x01 << 11);
+    GPIOC->ODR |= (0x01 << 13);
+    GPIOA->ODR |= (0x01 << 15);
+    pending = false;
+    BootProfile_Mark(BOOT_MARK_POWER);
+}
+
+/* ==================== Public Functions ==================== */
+
+void ModemPower_Start(bool warm)
+{
+    if (warm) {
+        release();
+        return;
+    }
+    
+    /* MX_GPIO_Init set the lines low; make sure of it if called elsewhere */
+    GPIOB->ODR &= ~(0x01 << 11);
+    GPIOC->ODR &= ~(0x01 << 13);
+    GPIOA->ODR &= ~(0x01 << 15);
+    pulse_start = HAL_GetTick();
+    pending = true;
+}
+
+void ModemPower_Process(void)
+{
+    if (pending && HAL_GetTick() - pulse_start >= MODEM_PWRKEY_MS) {
+        release();
+    }
+}
+
+bool ModemPower_Released(void)
+{
+    return !pending;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file    mqtt_packet.c
+ * @brief   MQTT 3.1.1 packet encoding and streaming decoding on the MCU
+ * @version 1.0
+ */
+
+#include "mqtt_packet.h"
+#include <string.h>
+
+/* Decoder states */
+enum {
+    RX_TYPE = 0,
+    RX_LENGTH,
+    RX_HEAD,            /* Non-PUBLISH body: first bytes kept in head, rest skipped */
+    RX_TOPIC_LEN,
+    RX_TOPIC,
+    RX_ID,
+    RX_PAYLOAD
+};
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Body fully received - report it and wait for the next packet
+ */
+static void rx_end(MQTT_PacketRx_t *rx, const MQTT_PacketOps_t *ops, void *ctx)
+{
+    rx->state = RX_TYPE;
+    ops->packet(ctx, rx->type, rx->head);
+}
+
+/**
+ * @brief Topic (and packet id) done - payload follows
+ */
+static void rx_payload_start(MQTT_PacketRx_t *rx, const MQTT_PacketOps_t *ops, void *ctx)
+{
+    rx->total = rx->remaining;
+    if (rx->remaining == 0) {
+        ops->payload(ctx, NULL, 0, 0, 0);
+        rx_end(rx, ops, ctx);
+        return;
+    }
+    rx->state = RX_PAYLOAD;
+}
+
+/* ==================== Public Functions ==================== */
+
+size_t MQTT_Packet_Header(uint8_t *out, uint8_t type, size_t remaining)
+{
+    size_t n = 1;
+    
+    if (out != NULL) {
+        out[0] = type;
+    }
+    do {
+        uint8_t digit = (uint8_t)(remaining & 0x7F);
+    
+        remaining >>= 7;
+        if (out != NULL) {
+            out[n] = (uint8_t)(digit | (remaining ? 0x80 : 0));
+        }
+        n++;
+    } while (remaining != 0 && n < MQTT_PKT_HEADER_MAX);
+    return n;
+}
+
+size_t MQTT_Packet_String(uint8_t *out, const char *str, size_t len)
+{
+    out[0] = (uint8_t)(len >> 8);
+    out[1] = (uint8_t)len;
+    memcpy(&out[2], str, len);
+    return len + 2;
+}
+
+size_t MQTT_Packet_Connect(uint8_t *out, size_t size, const char *client_id, const char *username,
+                           const char *password, uint16_t keepalive, bool clean_session, const MQTT_Will_t *will)
+{
+    size_t id_len = strlen(client_id);
+    size_t user_len = (username != NULL) ? strlen(username) : 0;
+    size_t pass_len = (password != NULL) ? strlen(password) : 0;
+    size_t will_topic_len = 0;
+    size_t will_msg_len = 0;
+    size_t remaining = 10 + 2 + id_len;
+    uint8_t flags = clean_session ? 0x02 : 0x00;
+    size_t n;
+    
+    if (will != NULL && will->topic != NULL) {
+        will_topic_len = strlen(will->topic);
+        will_msg_len = (will->msg != NULL) ? strlen(will->msg) : 0;
+        remaining += 2 + will_topic_len + 2 + will_msg_len;
+        flags |= (uint8_t)(0x04 | ((will->qos & 0x03) << 3) | (will->retain ? 0x20 : 0x00));
+    }
+    if (user_len > 0) {
+        remaining += 2 + user_len;
+        flags |= 0x80;
+    }
+    if (pass_len > 0) {
+        remaining += 2 + pass_len;
+        flags |= 0x40;
+    }
+    
+    n = MQTT_Packet_Header(NULL, MQTT_PKT_CONNECT, remaining);
+    if (out == NULL) {
+        return n + remaining;
+    }
+    if (n + remaining > size) {
+        return 0;
+    }
+    
+    /* Protocol name "MQTT", level 4 (3.1.1), flags, keepalive */
+    n = MQTT_Packet_Header(out, MQTT_PKT_CONNECT, remaining);
+    n += MQTT_Packet_String(&out[n], "MQTT", 4);
+    out[n++] = 4;
+    out[n++] = flags;
+    out[n++] = (uint8_t)(keepalive >> 8);
+    out[n++] = (uint8_t)keepalive;
+    
+    n += MQTT_Packet_String(&out[n], client_id, id_len);
+    if (flags & 0x04) {
+        n += MQTT_Packet_String(&out[n], will->topic, will_topic_len);
+        n += MQTT_Packet_String(&out[n], will_msg_len > 0 ? will->msg : "", will_msg_len);
+    }
+    if (user_len > 0) {
+        n += MQTT_Packet_String(&out[n], username, user_len);
+    }
+    if (pass_len > 0) {
+        n += MQTT_Packet_String(&out[n], password, pass_len);
+    }
+    return n;
+}
+
+void MQTT_PacketRx_Init(MQTT_PacketRx_t *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+    rx->state = RX_TYPE;
+}
+
+void MQTT_PacketRx_Feed(MQTT_PacketRx_t *rx, const uint8_t *data, size_t len,
+                        const MQTT_PacketOps_t *ops, void *ctx)
+{
+    size_t i = 0;
+    
+    while (i < len) {
+        uint8_t b = data[i];
+        size_t n;
+    
+        switch (rx->state) {
+        case RX_TYPE:
+            rx->type = b;
+            rx->remaining = 0;
+            rx->shift = 0;
+            rx->pos = 0;
+            memset(rx->head, 0, sizeof(rx->head));
+            rx->state = RX_LENGTH;
+            i++;
+            break;
+    
+        case RX_LENGTH:
+            rx->remaining |= (uint32_t)(b & 0x7F) << rx->shift;
+            rx->shift += 7;
+            i++;
+            if (b & 0x80) {
+                if (rx->shift >= 28) {
+                    rx->state = RX_TYPE;    /* Malformed - resync on the next byte */
+                }
+                break;
+            }
+            if ((rx->type & 0xF0) == MQTT_PKT_PUBLISH) {
+                rx->state = (rx->remaining >= 2) ? RX_TOPIC_LEN : RX_TYPE;
+            } else if (rx->remaining == 0) {
+                rx_end(rx, ops, ctx);
+            } else {
+                rx->state = RX_HEAD;
+            }
+            break;
+    
+        case RX_HEAD:
+            if (rx->pos < sizeof(rx->head)) {
+                rx->head[rx->pos++] = b;
+            }
+            i++;
+            if (--rx->remaining == 0) {
+                rx_end(rx, ops, ctx);
+            }
+            break;
+    
+        case RX_TOPIC_LEN:
+            rx->head[rx->pos++] = b;
+            i++;
+            rx->remaining--;
+            if (rx->pos < 2) {
+                break;
+            }
+            rx->topic_left = (uint16_t)((rx->head[0] << 8) | rx->head[1]);
+            if (rx->topic_left > rx->remaining) {
+                rx->state = RX_TYPE;        /* Malformed */
+            } else if (rx->topic_left > 0) {
+                rx->state = RX_TOPIC;
+            } else {
+                rx->state = (rx->type & 0x06) ? RX_ID : RX_PAYLOAD;
+            }
+            if (rx->state == RX_PAYLOAD) {
+                rx_payload_start(rx, ops, ctx);
+            }
+            break;
+    
+        case RX_TOPIC:
+            n = len - i;
+            if (n > rx->topic_left) {
+                n = rx->topic_left;
+            }
+            ops->topic(ctx, &data[i], n);
+            i += n;
+            rx->topic_left -= (uint16_t)n;
+            rx->remaining -= (uint32_t)n;
+            if (rx->topic_left > 0) {
+                break;
+            }
+            if (rx->type & 0x06) {
+                rx->state = RX_ID;          /* QoS 1/2: packet identifier */
+            } else {
+                rx_payload_start(rx, ops, ctx);
+            }
+            break;
+    
+        case RX_ID:
+            rx->head[rx->pos++] = b;
+            i++;
+            if (rx->remaining > 0) {
+                rx->remaining--;
+            }
+            if (rx->pos == 4) {
+                rx_payload_start(rx, ops, ctx);
+            }
+            break;
+    
+        case RX_PAYLOAD:
+        default:
+            n = len - i;
+            if (n > rx->remaining) {
+                n = rx->remaining;
+            }
+            ops->payload(ctx, &data[i], n, rx->total - rx->remaining, rx->total);
+            i += n;
+            rx->remaining -= (uint32_t)n;
+            if (rx->remaining == 0) {
+                rx_end(rx, ops, ctx);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,199 @@
+/**
+ * @file    nv_store.c
+ * @brief   Settings kept across resets in the last flash page
+ * @version 1.3
+ */
+
+#include "nv_store.h"
+#include <string.h>
+
+#if NV_STORE_ADDR + FLASH_PAGE_SIZE - 1U > FLASH_BANK1_END
+#error "nv_store lies past the end of flash"
+#endif
+
+/**
+ * @brief Keepalive learned on one network
+ */
+typedef struct {
+    uint32_t plmn;                          /**< MCC * 1000 + MNC, 0xFFFFFFFF = free */
+    uint16_t good;                          /**< Longest keepalive that survived, s */
+    uint16_t bad;                           /**< Shortest keepalive lost, s */
+} NV_KeepaliveSlot_t;
+
+/**
+ * @brief Page layout (word multiple - programmed a word at a time)
+ */
+typedef struct {
+    uint32_t magic;
+    NV_KeepaliveSlot_t keepalive[NV_KEEPALIVE_SLOTS];  /**< Most recently written last */
+    uint32_t host_hash;                     /**< Host the address below belongs to */
+    uint32_t host_ip;                       /**< Its last resolved IPv4 address */
+    uint32_t sim_hash;                      /**< ICCID hash of the SIM below */
+    uint32_t sim_plmn;                      /**< Its first six IMSI digits */
+    uint32_t cell_plmn;                     /**< Network of the last full connect */
+    uint32_t cell_band;                     /**< Its LTE band */
+} NV_Page_t;
+
+#define NV_PAGE         ((const NV_Page_t *)NV_STORE_ADDR)
+#define NV_FREE         0xFFFFFFFFU
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Erase the page and program a new image
+ */
+static HAL_StatusTypeDef nv_write(const NV_Page_t *page)
+{
+    const uint32_t *src = (const uint32_t *)page;
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error;
+    HAL_StatusTypeDef status;
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = NV_STORE_ADDR;
+    erase.NbPages = 1;
+    
+    HAL_FLASH_Unlock();
+    status = HAL_FLASHEx_Erase(&erase, &error);
+    for (uint32_t i = 0; status == HAL_OK && i < sizeof(*page) / 4; i++) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, NV_STORE_ADDR + i * 4, src[i]);
+    }
+    HAL_FLASH_Lock();
+    return status;
+}
+
+/**
+ * @brief Current page contents, or an empty image if the page holds no valid record
+ */
+static void nv_image(NV_Page_t *page)
+{
+    if (NV_PAGE->magic == NV_STORE_MAGIC) {
+        *page = *NV_PAGE;
+    } else {
+        memset(page, 0xFF, sizeof(*page));
+        page->magic = NV_STORE_MAGIC;
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+bool NV_Store_GetKeepalive(uint32_t plmn, uint16_t *good, uint16_t *bad)
+{
+    if (NV_PAGE->magic != NV_STORE_MAGIC || plmn == NV_FREE) {
+        return false;
+    }
+    for (uint8_t i = 0; i < NV_KEEPALIVE_SLOTS; i++) {
+        if (NV_PAGE->keepalive[i].plmn == plmn) {
+            *good = NV_PAGE->keepalive[i].good;
+            *bad = NV_PAGE->keepalive[i].bad;
+            return true;
+        }
+    }
+    return false;
+}
+
+HAL_StatusTypeDef NV_Store_SetKeepalive(uint32_t plmn, uint16_t good, uint16_t bad)
+{
+    NV_Page_t page;
+    uint8_t n = 0;
+    
+    if (plmn == NV_FREE) {
+        return HAL_ERROR;
+    }
+    
+    /* Keep the other networks in order (compacted in place); this one moves to the end */
+    nv_image(&page);
+    for (uint8_t i = 0; i < NV_KEEPALIVE_SLOTS; i++) {
+        NV_KeepaliveSlot_t slot = page.keepalive[i];
+        
+        if (slot.plmn == plmn) {
+            if (slot.good == good && slot.bad == bad) {
+                return HAL_OK;  /* Unchanged - spare the page an erase cycle */
+            }
+            continue;
+        }
+        if (slot.plmn != NV_FREE) {
+            page.keepalive[n++] = slot;
+        }
+    }
+    if (n == NV_KEEPALIVE_SLOTS) {
+        n--;
+        memmove(&page.keepalive[0], &page.keepalive[1], n * sizeof(page.keepalive[0]));
+    }
+    page.keepalive[n].plmn = plmn;
+    page.keepalive[n].good = good;
+    page.keepalive[n].bad = bad;
+    for (n++; n < NV_KEEPALIVE_SLOTS; n++) {
+        memset(&page.keepalive[n], 0xFF, sizeof(page.keepalive[n]));
+    }
+    
+    return nv_write(&page);
+}
+
+bool NV_Store_GetHostIp(uint32_t host_hash, uint32_t *ip)
+{
+    if (NV_PAGE->magic != NV_STORE_MAGIC || NV_PAGE->host_hash != host_hash ||
+        NV_PAGE->host_ip == 0 || NV_PAGE->host_ip == NV_FREE) {
+        return false;
+    }
+    *ip = NV_PAGE->host_ip;
+    return true;
+}
+
+HAL_StatusTypeDef NV_Store_SetHostIp(uint32_t host_hash, uint32_t ip)
+{
+    NV_Page_t page;
+    
+    nv_image(&page);
+    if (page.host_hash == host_hash && page.host_ip == ip) {
+        return HAL_OK;  /* Unchanged */
+    }
+    page.host_hash = host_hash;
+    page.host_ip = ip;
+    return nv_write(&page);
+}
+
+bool NV_Store_GetCarrier(uint32_t iccid_hash, uint32_t *plmn)
+{
+    if (NV_PAGE->magic != NV_STORE_MAGIC || NV_PAGE->sim_hash != iccid_hash || NV_PAGE->sim_plmn == NV_FREE) {
+        return false;
+    }
+    *plmn = NV_PAGE->sim_plmn;
+    return true;
+}
+
+HAL_StatusTypeDef NV_Store_SetCarrier(uint32_t iccid_hash, uint32_t plmn)
+{
+    NV_Page_t page;
+    
+    nv_image(&page);
+    if (page.sim_hash == iccid_hash && page.sim_plmn == plmn) {
+        return HAL_OK;  /* Unchanged */
+    }
+    page.sim_hash = iccid_hash;
+    page.sim_plmn = plmn;
+    return nv_write(&page);
+}
+
+bool NV_Store_GetCell(uint32_t *plmn, uint8_t *band)
+{
+    if (NV_PAGE->magic != NV_STORE_MAGIC || NV_PAGE->cell_plmn == NV_FREE || NV_PAGE->cell_band == NV_FREE) {
+        return false;
+    }
+    *plmn = NV_PAGE->cell_plmn;
+    *band = (uint8_t)NV_PAGE->cell_band;
+    return true;
+}
+
+HAL_StatusTypeDef NV_Store_SetCell(uint32_t plmn, uint8_t band)
+{
+    NV_Page_t page;
+    
+    nv_image(&page);
+    if (page.cell_plmn == plmn && page.cell_band == band) {
+        return HAL_OK;  /* Unchanged */
+    }
+    page.cell_plmn = plmn;
+    page.cell_band = band;
+    return nv_write(&page);
+}
@@ -0,0 +1,286 @@
+/**
+ * @file    ota.c
+ * @brief   Firmware update over MQTT: image into a flash slot, credit-paced, installed from SRAM
+ * @version 1.0
+ */
+
+#include "ota.h"
+#include "crc32.h"
+#include <string.h>
+
+#if OTA_ENABLE
+
+/* The install copy runs from SRAM (the flash it reads code from is being erased) */
+#define OTA_RAMFUNC         __attribute__((section(".ramfunc"), noinline))
+#define OTA_HDR_LEN         4               /* <offset, u32 LE> ahead of the data of a message */
+#define OTA_IWDG_RELOAD     0xAAAAU         /* IWDG key register: refresh */
+
+/* ==================== Private Variables ==================== */
+
+typedef struct {
+    Ota_State_t state;
+    uint32_t size;
+    uint32_t crc_expected;
+    uint32_t crc;                       /* Running CRC-32 of the programmed bytes, read back */
+    uint32_t next;                      /* Bytes received in order (FIFO write position) */
+    uint32_t done;                      /* Bytes programmed (FIFO read position) */
+    uint32_t erased;                    /* Slot bytes erased (whole pages) */
+    uint32_t granted;                   /* Credit limit of the last ack */
+    uint32_t dropped;
+    uint32_t ack_tick;
+    bool ack_pending;
+    bool apply;
+    
+    /* Message being received */
+    uint8_t hdr[OTA_HDR_LEN];
+    uint8_t hdr_len;
+    bool taking;                        /* Its data goes into the FIFO */
+    
+    uint8_t fifo[OTA_FIFO_SIZE];
+} Ota_t;
+
+static Ota_t ota;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief End of the bytes the sender may have: FIFO room, erased pages, image
+ */
+static uint32_t credit_limit(void)
+{
+    uint32_t limit = ota.done + OTA_FIFO_SIZE;
+    
+    if (limit > ota.erased) {
+        limit = ota.erased;
+    }
+    return (limit > ota.size) ? ota.size : limit;
+}
+
+static void finish(Ota_State_t state)
+{
+    ota.state = state;
+    ota.ack_pending = true;
+}
+
+/**
+ * @brief Erase the slot page the writer reached
+ */
+static bool erase_next(void)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error;
+    HAL_StatusTypeDef status;
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = OTA_SLOT_ADDR + ota.erased;
+    erase.NbPages = 1;
+    HAL_FLASH_Unlock();
+    status = HAL_FLASHEx_Erase(&erase, &error);
+    HAL_FLASH_Lock();
+    if (status != HAL_OK) {
+        return false;
+    }
+    ota.erased += OTA_PAGE_SIZE;
+    return true;
+}
+
+/**
+ * @brief Copy the slot over the application and reset - SRAM only, interrupts off
+ * @note  Registers only: no HAL (in flash), no library calls
+ */
+static void OTA_RAMFUNC install(uint32_t pages)
+{
+    for (uint32_t page = 0; page < pages; page++) {
+        uint32_t base = page * OTA_PAGE_SIZE;
+        
+        while (FLASH->SR & FLASH_SR_BSY) {
+        }
+        FLASH->CR |= FLASH_CR_PER;
+        FLASH->AR = OTA_APP_ADDR + base;
+        FLASH->CR |= FLASH_CR_STRT;
+        while (FLASH->SR & FLASH_SR_BSY) {
+        }
+        FLASH->SR = FLASH_SR_EOP;
+        FLASH->CR &= ~FLASH_CR_PER;
+        
+        FLASH->CR |= FLASH_CR_PG;
+        for (uint32_t i = 0; i < OTA_PAGE_SIZE; i += 2) {
+            *(volatile uint16_t *)(OTA_APP_ADDR + base + i) =
+                *(const volatile uint16_t *)(OTA_SLOT_ADDR + base + i);
+            while (FLASH->SR & FLASH_SR_BSY) {
+            }
+        }
+        FLASH->SR = FLASH_SR_EOP;
+        FLASH->CR &= ~FLASH_CR_PG;
+        
+        /* ~70 ms a page: well inside the watchdog, which the supervisor can no longer reach */
+        IWDG->KR = OTA_IWDG_RELOAD;
+    }
+    
+    __DSB();
+    SCB->AIRCR = (0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | SCB_AIRCR_SYSRESETREQ_Msk;
+    __DSB();
+    for (;;) {
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+bool Ota_Begin(uint32_t size, uint32_t crc)
+{
+    if (size == 0 || size > OTA_APP_MAX) {
+        return false;
+    }
+    memset(&ota, 0, offsetof(Ota_t, fifo));
+    ota.state = OTA_RX;
+    ota.size = size;
+    ota.crc_expected = crc;
+    ota.crc = 0;
+    return true;
+}
+
+void Ota_OnChunk(const char *topic, const uint8_t *data, size_t len, size_t offset, size_t total)
+{
+    uint32_t room;
+    
+    (void)topic;
+    if (offset == 0) {
+        ota.hdr_len = 0;
+        ota.taking = false;
+    }
+    if (ota.state != OTA_RX || total <= OTA_HDR_LEN) {
+        return;
+    }
+    
+    /* Header, possibly split across pieces */
+    while (ota.hdr_len < OTA_HDR_LEN && len > 0) {
+        ota.hdr[ota.hdr_len++] = *data++;
+        len--;
+        if (ota.hdr_len == OTA_HDR_LEN) {
+            uint32_t at = (uint32_t)ota.hdr[0] | ((uint32_t)ota.hdr[1] << 8) |
+                          ((uint32_t)ota.hdr[2] << 16) | ((uint32_t)ota.hdr[3] << 24);
+            
+            ota.taking = (at == ota.next);
+            if (!ota.taking) {
+                ota.dropped++;      /* Old retransmission or a gap: the ack sends it back to next */
+            }
+        }
+    }
+    if (!ota.taking || len == 0) {
+        return;
+    }
+    
+    room = credit_limit() - ota.next;
+    if (len > room) {
+        len = room;
+        ota.taking = false;         /* The rest of the message is over the credit */
+        ota.dropped++;
+    }
+    for (size_t i = 0; i < len; i++) {
+        ota.fifo[(ota.next + i) & (OTA_FIFO_SIZE - 1)] = data[i];
+    }
+    ota.next += (uint32_t)len;
+}
+
+bool Ota_Process(void)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+    uint32_t limit, from;
+    
+    if (ota.state != OTA_RX) {
+        return false;
+    }
+    
+    /* Everything granted is programmed: the sender waits, the line is quiet for the erase */
+    if (ota.done == ota.erased) {
+        if (!erase_next()) {
+            finish(OTA_FAILED);
+            return false;
+        }
+        ota.ack_pending = true;
+        return true;
+    }
+    
+    HAL_FLASH_Unlock();
+    from = ota.done;
+    for (uint8_t n = 0; n < OTA_BURST && ota.done < ota.next; n++) {
+        uint32_t addr = OTA_SLOT_ADDR + ota.done;
+        bool last = (ota.done + 1 == ota.size);
+        uint16_t half;
+        
+        if (ota.next - ota.done < 2 && !last) {
+            break;                  /* Wait for the other byte of the halfword */
+        }
+        half = ota.fifo[ota.done & (OTA_FIFO_SIZE - 1)];
+        half |= last ? 0xFF00U : (uint16_t)(ota.fifo[(ota.done + 1) & (OTA_FIFO_SIZE - 1)] << 8);
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr, half);
+        if (status != HAL_OK) {
+            break;
+        }
+        ota.done += last ? 1U : 2U;
+    }
+    HAL_FLASH_Lock();
+    
+    /* The burst as the flash holds it, read back */
+    ota.crc = Crc32_Update(ota.crc, (const uint8_t *)(OTA_SLOT_ADDR + from), ota.done - from);
+    
+    if (status != HAL_OK) {
+        finish(OTA_FAILED);
+        return false;
+    }
+    if (ota.done == ota.size) {
+        finish((ota.crc == ota.crc_expected) ? OTA_READY : OTA_FAILED);
+        return false;
+    }
+    
+    /* Credit as FIFO room frees up, half a FIFO at a time, or the rest of the erased pages */
+    limit = credit_limit();
+    if (limit >= ota.granted + OTA_FIFO_SIZE / 2 || (limit == ota.erased && limit > ota.granted)) {
+        ota.ack_pending = true;
+    }
+    return (ota.done < ota.next) || (ota.done == ota.erased);
+}
+
+bool Ota_AckDue(uint32_t now)
+{
+    return ota.ack_pending || (ota.state == OTA_RX && now - ota.ack_tick >= OTA_ACK_REPEAT);
+}
+
+const Ota_Progress_t *Ota_TakeAck(uint32_t now)
+{
+    static Ota_Progress_t progress;
+    
+    ota.granted = (ota.state == OTA_RX) ? credit_limit() : ota.next;
+    progress.state = ota.state;
+    progress.size = ota.size;
+    progress.next = ota.next;
+    progress.win = ota.granted - ota.next;
+    progress.dropped = ota.dropped;
+    ota.ack_tick = now;
+    ota.ack_pending = false;
+    return &progress;
+}
+
+bool Ota_RequestApply(void)
+{
+    ota.apply = (ota.state == OTA_READY);
+    return ota.apply;
+}
+
+bool Ota_ApplyPending(void)
+{
+    return ota.apply;
+}
+
+void Ota_Install(void)
+{
+    if (ota.state != OTA_READY) {
+        ota.apply = false;
+        return;
+    }
+    __disable_irq();
+    HAL_FLASH_Unlock();
+    install((ota.size + OTA_PAGE_SIZE - 1) / OTA_PAGE_SIZE);
+}
+
+#endif /* OTA_ENABLE */
@@ -0,0 +1,603 @@
+/**
+ * @file    outage_log.c
+ * @brief   Flash ring holding telemetry while the cellular link is down
+ * @version 1.3
+ */
+
+#include "outage_log.h"
+#include "config_store.h"
+#include "spi_nor.h"
+#include <string.h>
+
+#if OUTAGE_LOG_ADDR + OUTAGE_LOG_PAGES * OUTAGE_LOG_PAGE_SIZE > CONFIG_STORE_ADDR
+#error "Outage log overlaps the config store"
+#endif
+
+#if OUTAGE_LOG_SPI
+
+#define OL_SECTORS      (OUTAGE_LOG_SPI_SIZE / SPI_NOR_SECTOR)
+#define OL_CAPACITY     (OUTAGE_LOG_SPI_SIZE - SPI_NOR_SECTOR)  /* The writer's sector is not held */
+#define OL_MAGIC        0x474C4F55U     /* "UOLG" */
+#define OL_SEC_HDR      8               /* Magic, seq */
+#define OL_SEC_END      (SPI_NOR_SECTOR - 2U)   /* Footer: where the sector's records end */
+#define OL_REC_HDR      3               /* Length, state */
+#define OL_REC(len)     ((len) + OL_REC_HDR + 2U)
+#define OL_LIVE         0xFF            /* State: a frame */
+#define OL_JUMP         0x01            /* ... the address a newest-first walk goes on at (LE32) */
+#define OL_FRAME_MAX    280             /* MAVLink v2 with signature */
+#define OL_WALK         8               /* Records and sector ends stepped over a Peek */
+
+#if OL_SECTORS < 4 || OUTAGE_LOG_SPI_FIFO < OL_REC(OL_FRAME_MAX)
+#error "OUTAGE_LOG_SPI needs 4 sectors and a queue that holds the longest frame"
+#endif
+
+/* What the writer does next */
+enum {
+    OL_STEP_ERASE,      /* Erase the sector it entered */
+    OL_STEP_HEADER,     /* Program its header */
+    OL_STEP_DATA,       /* Program records */
+    OL_STEP_FOOTER      /* Close the full sector */
+};
+
+/* Ring positions are chip addresses - RAM only, so a reset empties the backlog */
+static struct {
+    bool present;
+    uint8_t step;
+    uint16_t wr_sector;
+    uint32_t seq;           /* Of the next sector header */
+    uint32_t wr;            /* Next byte to program */
+    uint32_t top;           /* End of the last whole record */
+    uint32_t rd;            /* Oldest record not sent */
+#if OUTAGE_LOG_NEWEST_FIRST
+    uint32_t nf;            /* A walk starts here: above it, only sent records and jumps */
+    bool jumping;           /* The record being programmed is the jump */
+    uint8_t jump[OL_REC(4)];
+#endif
+    uint16_t rec_left;      /* Bytes of the record being programmed still to go */
+    uint32_t peek;          /* Record OutageLog_Peek returned */
+    uint16_t peek_len;
+    uint8_t *fifo;          /* Queue: fifo_own, or RAM lent by OutageLog_Lend */
+    uint16_t fifo_size;
+    uint16_t fifo_head;
+    uint16_t fifo_used;
+    uint32_t overwrites;
+    uint8_t fifo_own[OUTAGE_LOG_SPI_FIFO];
+    uint8_t frame[OL_FRAME_MAX];
+} nor;
+
+/* ==================== Private Functions ==================== */
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t sector_of(uint32_t addr)
+{
+    return (uint16_t)(addr / SPI_NOR_SECTOR);
+}
+
+static uint32_t offset_of(uint32_t addr)
+{
+    return addr % SPI_NOR_SECTOR;
+}
+
+/* First record position of the sector after (or before) that of addr */
+static uint32_t sector_next(uint32_t addr)
+{
+    return ((sector_of(addr) + 1U) % OL_SECTORS) * SPI_NOR_SECTOR + OL_SEC_HDR;
+}
+
+static uint32_t sector_prev(uint32_t addr)
+{
+    return ((sector_of(addr) + OL_SECTORS - 1U) % OL_SECTORS) * SPI_NOR_SECTOR;
+}
+
+/* Bytes from a to b going forward round the ring */
+static uint32_t ring_dist(uint32_t a, uint32_t b)
+{
+    return (b + OUTAGE_LOG_SPI_SIZE - a) % OUTAGE_LOG_SPI_SIZE;
+}
+
+static void fifo_put(const uint8_t *data, size_t len)
+{
+    while (len-- > 0) {
+        nor.fifo[(nor.fifo_head + nor.fifo_used) % nor.fifo_size] = *data++;
+        nor.fifo_used++;
+    }
+}
+
+/**
+ * @brief Move the queued bytes to the front of another buffer (oldest first)
+ */
+static void fifo_move(uint8_t *to, uint16_t size)
+{
+    uint16_t first = (uint16_t)(nor.fifo_size - nor.fifo_head);
+    
+    if (first > nor.fifo_used) {
+        first = nor.fifo_used;
+    }
+    memcpy(to, &nor.fifo[nor.fifo_head], first);
+    memcpy(&to[first], nor.fifo, (size_t)(nor.fifo_used - first));
+    nor.fifo = to;
+    nor.fifo_size = size;
+    nor.fifo_head = 0;
+}
+
+/**
+ * @brief Start the next record: a jump first if pops left a gap under the top
+ * @return false if nothing is queued or it needs the next sector
+ */
+static bool record_start(void)
+{
+    uint32_t rec;
+
+#if OUTAGE_LOG_NEWEST_FIRST
+    nor.jumping = (nor.nf != nor.top);
+    if (nor.jumping) {
+        nor.jump[0] = 4;
+        nor.jump[1] = 0;
+        nor.jump[2] = OL_JUMP;
+        put_le32(&nor.jump[OL_REC_HDR], nor.nf);
+        nor.jump[OL_REC_HDR + 4] = 4;
+        nor.jump[OL_REC_HDR + 5] = 0;
+        rec = OL_REC(4);
+    } else
+#endif
+    if (nor.fifo_used == 0) {
+        return false;
+    } else {
+        rec = OL_REC(nor.fifo[nor.fifo_head] | (nor.fifo[(nor.fifo_head + 1U) % nor.fifo_size] << 8));
+    }
+    if (offset_of(nor.wr) + rec > OL_SEC_END) {
+        nor.step = OL_STEP_FOOTER;
+        return false;
+    }
+    nor.rec_left = (uint16_t)rec;
+    return true;
+}
+
+/**
+ * @brief Program the next slice of the record: to the page end at most
+ */
+static void record_slice(void)
+{
+    const uint8_t *src;
+    uint32_t chunk = SPI_NOR_PAGE - nor.wr % SPI_NOR_PAGE;
+    
+    if (chunk > OUTAGE_LOG_SPI_SLICE) {
+        chunk = OUTAGE_LOG_SPI_SLICE;
+    }
+    if (chunk > nor.rec_left) {
+        chunk = nor.rec_left;
+    }
+#if OUTAGE_LOG_NEWEST_FIRST
+    if (nor.jumping) {
+        src = &nor.jump[OL_REC(4) - nor.rec_left];
+    } else
+#endif
+    {
+        src = &nor.fifo[nor.fifo_head];
+        if (chunk > (uint32_t)(nor.fifo_size - nor.fifo_head)) {
+            chunk = (uint32_t)(nor.fifo_size - nor.fifo_head);
+        }
+        nor.fifo_head = (uint16_t)((nor.fifo_head + chunk) % nor.fifo_size);
+        nor.fifo_used -= (uint16_t)chunk;
+    }
+    SpiNor_Program(nor.wr, src, chunk);
+    nor.wr += chunk;
+    nor.rec_left -= (uint16_t)chunk;
+    if (nor.rec_left == 0) {
+        nor.top = nor.wr;
+#if OUTAGE_LOG_NEWEST_FIRST
+        nor.nf = nor.top;       /* No pops meanwhile: Peek waits for whole records */
+#endif
+    }
+}
+
+#if OUTAGE_LOG_NEWEST_FIRST
+/**
+ * @brief Walk down from nf to the newest record not sent, through jumps and sector ends
+ * @return Frame length (record at nor.peek), 0 if none
+ */
+static size_t walk(void)
+{
+    uint32_t pos = nor.nf;
+    uint8_t hdr[OL_REC_HDR + 4];
+    uint8_t trl[2];
+    
+    for (uint8_t i = 0; i < OL_WALK; i++) {
+        uint16_t len;
+        
+        if (pos == nor.rd || ring_dist(nor.rd, pos) > ring_dist(nor.rd, nor.top)) {
+            pos = nor.rd;       /* Down to the tail, or under a given-up sector */
+            break;
+        }
+        if (offset_of(pos) == OL_SEC_HDR) {
+            uint32_t prev = sector_prev(pos);
+            
+            SpiNor_Read(prev + OL_SEC_END, trl, sizeof(trl));
+            if (le16(trl) < OL_SEC_HDR || le16(trl) > OL_SEC_END) {
+                pos = nor.rd;
+                break;
+            }
+            pos = prev + le16(trl);
+            continue;
+        }
+        SpiNor_Read(pos - sizeof(trl), trl, sizeof(trl));
+        len = le16(trl);
+        if (len == 0 || len > OL_FRAME_MAX || OL_REC(len) > offset_of(pos) - OL_SEC_HDR) {
+            pos = nor.rd;
+            break;
+        }
+        SpiNor_Read(pos - OL_REC(len), hdr, sizeof(hdr));
+        if (le16(hdr) != len) {
+            pos = nor.rd;
+            break;
+        }
+        if (hdr[2] == OL_JUMP && len == 4) {
+            pos = le32(&hdr[OL_REC_HDR]);
+            continue;
+        }
+        nor.nf = pos;
+        nor.peek = pos - OL_REC(len);
+        return len;
+    }
+    if (pos == nor.rd) {
+        nor.rd = nor.top;   /* All sent (or unreadable): the backlog is empty */
+        pos = nor.top;
+    }
+    nor.nf = pos;           /* The next walk goes on from here */
+    return 0;
+}
+#else
+/**
+ * @brief Walk up from rd to the oldest record, over sector ends
+ * @return Frame length (record at nor.peek), 0 if none
+ */
+static size_t walk(void)
+{
+    uint8_t hdr[OL_REC_HDR];
+    
+    for (uint8_t i = 0; i < OL_WALK && nor.rd != nor.top; i++) {
+        uint16_t len = 0xFFFF;
+        
+        if (offset_of(nor.rd) + OL_REC(1) <= OL_SEC_END) {
+            SpiNor_Read(nor.rd, hdr, sizeof(hdr));
+            len = le16(hdr);
+        }
+        if (len == 0 || len > OL_FRAME_MAX) {
+            nor.rd = sector_next(nor.rd);       /* Sector closed here */
+            continue;
+        }
+        nor.peek = nor.rd;
+        return len;
+    }
+    return 0;
+}
+#endif
+
+/* ==================== Public Functions ==================== */
+
+void OutageLog_Init(void)
+{
+    uint8_t hdr[OL_SEC_HDR];
+    bool found = false;
+    uint16_t newest = 0;
+    
+    memset(&nor, 0, sizeof(nor));
+    nor.fifo = nor.fifo_own;
+    nor.fifo_size = OUTAGE_LOG_SPI_FIFO;
+    nor.present = SpiNor_Init();
+    if (!nor.present) {
+        return;
+    }
+    while (SpiNor_Busy()) {
+    }
+    for (uint16_t s = 0; s < OL_SECTORS; s++) {
+        uint32_t seq;
+        
+        SpiNor_Read((uint32_t)s * SPI_NOR_SECTOR, hdr, sizeof(hdr));
+        seq = le32(&hdr[4]);
+        if (le32(hdr) == OL_MAGIC && (!found || (int32_t)(seq - nor.seq) > 0)) {
+            found = true;
+            newest = s;
+            nor.seq = seq;
+        }
+    }
+    
+    /* Past the newest sector: what the chip holds stays as the black box */
+    nor.wr_sector = found ? (uint16_t)((newest + 1U) % OL_SECTORS) : 0U;
+    nor.seq = found ? nor.seq + 1U : 0U;
+    nor.wr = nor.top = nor.rd = (uint32_t)nor.wr_sector * SPI_NOR_SECTOR + OL_SEC_HDR;
+#if OUTAGE_LOG_NEWEST_FIRST
+    nor.nf = nor.top;
+#endif
+    nor.step = OL_STEP_ERASE;
+}
+
+void OutageLog_Process(void)
+{
+    uint8_t buf[OL_SEC_HDR];
+    
+    if (!nor.present || SpiNor_Busy()) {
+        return;
+    }
+    switch (nor.step) {
+        case OL_STEP_ERASE:
+            /* Ring full: the tail's sector is given up */
+            if (nor.rd != nor.top && sector_of(nor.rd) == nor.wr_sector) {
+                nor.rd = sector_next(nor.rd);
+                nor.overwrites++;
+            }
+            SpiNor_EraseSector((uint32_t)nor.wr_sector * SPI_NOR_SECTOR);
+            nor.step = OL_STEP_HEADER;
+            break;
+        
+        case OL_STEP_HEADER:
+            put_le32(&buf[0], OL_MAGIC);
+            put_le32(&buf[4], nor.seq++);
+            SpiNor_Program((uint32_t)nor.wr_sector * SPI_NOR_SECTOR, buf, OL_SEC_HDR);
+            nor.step = OL_STEP_DATA;
+            break;
+        
+        case OL_STEP_DATA:
+            if (nor.rec_left > 0 || record_start()) {
+                record_slice();
+            }
+            break;
+        
+        default:
+            buf[0] = (uint8_t)offset_of(nor.wr);
+            buf[1] = (uint8_t)(offset_of(nor.wr) >> 8);
+            SpiNor_Program((uint32_t)nor.wr_sector * SPI_NOR_SECTOR + OL_SEC_END, buf, 2);
+            nor.wr_sector = (uint16_t)((nor.wr_sector + 1U) % OL_SECTORS);
+            nor.wr = (uint32_t)nor.wr_sector * SPI_NOR_SECTOR + OL_SEC_HDR;
+            nor.step = OL_STEP_ERASE;
+            break;
+    }
+}
+
+bool OutageLog_Put(const UART_DMA_Span_t part[2], size_t len)
+{
+    uint8_t hdr[OL_REC_HDR] = { (uint8_t)len, (uint8_t)(len >> 8), OL_LIVE };
+    
+    if (!nor.present || len == 0 || len > OL_FRAME_MAX ||
+        OL_REC(len) > (size_t)(nor.fifo_size - nor.fifo_used)) {
+        return false;
+    }
+    fifo_put(hdr, OL_REC_HDR);
+    fifo_put(part[0].data, part[0].len);
+    fifo_put(part[1].data, part[1].len);
+    fifo_put(hdr, 2);                   /* Trailing length */
+    return true;
+}
+
+size_t OutageLog_Peek(const uint8_t **frame)
+{
+    size_t len = 0;
+    
+    /* Newest first pops move nf, which a record being programmed must not see move */
+    if (nor.present && !SpiNor_Busy() && (!OUTAGE_LOG_NEWEST_FIRST || nor.rec_left == 0)) {
+        len = walk();
+    }
+    if (len > 0) {
+        SpiNor_Read(nor.peek + OL_REC_HDR, nor.frame, len);
+        *frame = nor.frame;
+    }
+    nor.peek_len = (uint16_t)len;
+    return len;
+}
+
+void OutageLog_Pop(void)
+{
+    if (nor.peek_len == 0) {
+        return;
+    }
+#if OUTAGE_LOG_NEWEST_FIRST
+    nor.nf = nor.peek;
+#else
+    nor.rd = nor.peek + OL_REC(nor.peek_len);
+#endif
+    nor.peek_len = 0;
+}
+
+uint8_t OutageLog_PagesUsed(void)
+{
+#if OUTAGE_LOG_NEWEST_FIRST
+    uint32_t used = ring_dist(nor.rd, nor.nf) + nor.fifo_used;
+#else
+    uint32_t used = ring_dist(nor.rd, nor.top) + nor.fifo_used;
+#endif
+    
+    if (used == 0) {
+        return 0;
+    }
+    used = (used * OUTAGE_LOG_PAGES + OL_CAPACITY - 1U) / OL_CAPACITY;
+    return (uint8_t)((used < OUTAGE_LOG_PAGES) ? used : OUTAGE_LOG_PAGES);
+}
+
+uint32_t OutageLog_GetOverwrites(void)
+{
+    return nor.overwrites;
+}
+
+bool OutageLog_Lend(uint8_t *buf, size_t len)
+{
+    if (!nor.present || nor.fifo != nor.fifo_own || len <= OUTAGE_LOG_SPI_FIFO) {
+        return false;
+    }
+    fifo_move(buf, (uint16_t)((len < 0xFFFFU) ? len : 0xFFFFU));
+    return true;
+}
+
+bool OutageLog_Reclaim(void)
+{
+    if (nor.fifo == nor.fifo_own) {
+        return true;
+    }
+    if (nor.fifo_used > OUTAGE_LOG_SPI_FIFO) {
+        return false;   /* Still more queued than the own RAM holds: Process drains it */
+    }
+    fifo_move(nor.fifo_own, OUTAGE_LOG_SPI_FIFO);
+    return true;
+}
+
+#else /* Internal flash */
+
+#define OL_PAGE_ADDR(p) (OUTAGE_LOG_ADDR + (uint32_t)(p) * OUTAGE_LOG_PAGE_SIZE)
+#define OL_HEADER       2               /* Record length halfword */
+#define OL_EMPTY        0xFFFF          /* Erased header - rest of the page is unused */
+#define OL_RECORD(len)  (OL_HEADER + (((len) + 1) & ~(size_t)1))
+
+/* Ring positions (page, offset in page) - RAM only, so a reset empties it */
+static struct {
+    uint8_t wr_page;
+    uint16_t wr_off;
+    bool wr_ready;      /* Writer page erased */
+    uint8_t rd_page;
+    uint16_t rd_off;
+    uint32_t overwrites;
+} ring;
+
+/* ==================== Private Functions ==================== */
+
+static uint8_t next_page(uint8_t page)
+{
+    return (uint8_t)((page + 1) % OUTAGE_LOG_PAGES);
+}
+
+static HAL_StatusTypeDef erase_page(uint8_t page)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error;
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = OL_PAGE_ADDR(page);
+    erase.NbPages = 1;
+    return HAL_FLASHEx_Erase(&erase, &error);
+}
+
+/**
+ * @brief Move the writer to the next page, giving up the oldest one if it is there
+ */
+static HAL_StatusTypeDef advance_writer(void)
+{
+    uint8_t next = next_page(ring.wr_page);
+    
+    if (next == ring.rd_page) {
+        ring.rd_page = next_page(next);
+        ring.rd_off = 0;
+        ring.overwrites++;
+    }
+    ring.wr_page = next;
+    ring.wr_off = 0;
+    return erase_page(next);
+}
+
+/* ==================== Public Functions ==================== */
+
+bool OutageLog_Put(const UART_DMA_Span_t part[2], size_t len)
+{
+    uint32_t addr;
+    HAL_StatusTypeDef status = HAL_OK;
+    
+    if (len == 0 || OL_RECORD(len) > OUTAGE_LOG_PAGE_SIZE) {
+        return false;
+    }
+    
+    HAL_FLASH_Unlock();
+    if (!ring.wr_ready) {
+        status = erase_page(ring.wr_page);
+        ring.wr_ready = (status == HAL_OK);
+        ring.wr_off = 0;
+    } else if (ring.wr_off + OL_RECORD(len) > OUTAGE_LOG_PAGE_SIZE) {
+        status = advance_writer();
+    }
+    
+    addr = OL_PAGE_ADDR(ring.wr_page) + ring.wr_off;
+    if (status == HAL_OK) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr, len);
+    }
+    
+    /* Bytes paired into halfwords across the two pieces */
+    for (size_t i = 0; status == HAL_OK && i < len; i += 2) {
+        uint8_t lo = (i < part[0].len) ? part[0].data[i] : part[1].data[i - part[0].len];
+        uint8_t hi = 0xFF;
+        
+        if (i + 1 < len) {
+            hi = (i + 1 < part[0].len) ? part[0].data[i + 1] : part[1].data[i + 1 - part[0].len];
+        }
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + OL_HEADER + i, lo | ((uint16_t)hi << 8));
+    }
+    HAL_FLASH_Lock();
+    
+    /* A failed record is skipped with the rest of its page */
+    if (status != HAL_OK) {
+        ring.wr_off = OUTAGE_LOG_PAGE_SIZE;
+        return false;
+    }
+    ring.wr_off += (uint16_t)OL_RECORD(len);
+    return true;
+}
+
+size_t OutageLog_Peek(const uint8_t **frame)
+{
+    while (ring.rd_page != ring.wr_page || ring.rd_off < ring.wr_off) {
+        const uint8_t *rec = (const uint8_t *)(uintptr_t)(OL_PAGE_ADDR(ring.rd_page) + ring.rd_off);
+        uint16_t len = OL_EMPTY;
+        
+        if ((uint32_t)ring.rd_off + OL_HEADER <= OUTAGE_LOG_PAGE_SIZE) {
+            len = (uint16_t)(rec[0] | (rec[1] << 8));
+        }
+        if (len == OL_EMPTY || len == 0) {
+            if (ring.rd_page == ring.wr_page) {
+                break;      /* Writer gave up this page - caught up */
+            }
+            ring.rd_page = next_page(ring.rd_page);
+            ring.rd_off = 0;
+            continue;
+        }
+        *frame = rec + OL_HEADER;
+        return len;
+    }
+    return 0;
+}
+
+void OutageLog_Pop(void)
+{
+    const uint8_t *frame;
+    size_t len = OutageLog_Peek(&frame);
+    
+    if (len > 0) {
+        ring.rd_off += (uint16_t)OL_RECORD(len);
+    }
+}
+
+uint8_t OutageLog_PagesUsed(void)
+{
+    if (ring.rd_page == ring.wr_page && ring.rd_off >= ring.wr_off) {
+        return 0;
+    }
+    return (uint8_t)((ring.wr_page + OUTAGE_LOG_PAGES - ring.rd_page) % OUTAGE_LOG_PAGES + 1);
+}
+
+uint32_t OutageLog_GetOverwrites(void)
+{
+    return ring.overwrites;
+}
+
+#endif /* OUTAGE_LOG_SPI */
@@ -0,0 +1,271 @@
+/**
+ * @file    param_cache.c
+ * @brief   Flash copy of the autopilot's parameters, learned from PARAM_VALUE
+ * @version 1.0
+ */
+
+#include "param_cache.h"
+#include "mission_store.h"
+#include "ota.h"
+#include <string.h>
+
+#if PARAM_CACHE_ADDR + PARAM_CACHE_PAGES * PARAM_CACHE_PAGE_SIZE > MISSION_STORE_ADDR
+#error "Parameter cache overlaps the mission store"
+#endif
+#if OTA_APP_ADDR + OTA_APP_MAX > PARAM_CACHE_ADDR
+#error "Parameter cache overlaps the application (OTA_APP_MAX, IROM1 of the scatter file)"
+#endif
+
+#define PC_PER_PAGE     (PARAM_CACHE_PAGE_SIZE / PARAM_CACHE_RECORD)
+#define PC_ADDR(r)      (PARAM_CACHE_ADDR + (uint32_t)((r) / PC_PER_PAGE) * PARAM_CACHE_PAGE_SIZE + \
+                         (uint32_t)((r) % PC_PER_PAGE) * PARAM_CACHE_RECORD)
+#define PC_ID_BYTES     (PARAM_ID_LEN * 6 / 8)
+#define PC_NO_CODE      0xFF
+
+/* Written records and which indices they cover - RAM only, so a reset empties it */
+static struct {
+    uint16_t records;
+    uint16_t count;     /* param_count of the autopilot */
+    uint16_t have;      /* Distinct indices stored */
+    bool failed;        /* A parameter could not be stored - not complete until started over */
+    uint8_t seen[(PARAM_CACHE_MAX + 7) / 8];
+} cache;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief 6-bit code of a param_id character: NUL, A-Z, 0-9, '_', a-z (PC_NO_CODE otherwise)
+ */
+static uint8_t id_code(char c)
+{
+    if (c == '\0') {
+        return 0;
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return (uint8_t)(1 + c - 'A');
+    }
+    if (c >= '0' && c <= '9') {
+        return (uint8_t)(27 + c - '0');
+    }
+    if (c == '_') {
+        return 37;
+    }
+    if (c >= 'a' && c <= 'z') {
+        return (uint8_t)(38 + c - 'a');
+    }
+    return PC_NO_CODE;
+}
+
+static char id_char(uint8_t code)
+{
+    if (code == 0) {
+        return '\0';
+    }
+    if (code <= 26) {
+        return (char)('A' + code - 1);
+    }
+    if (code <= 36) {
+        return (char)('0' + code - 27);
+    }
+    if (code == 37) {
+        return '_';
+    }
+    return (char)('a' + code - 38);
+}
+
+/**
+ * @brief Pack a param_id, 6 bits per character from bit 0 up (anything after a NUL is NUL)
+ * @return false if a character has no code
+ */
+static bool id_pack(const char *id, uint8_t *out)
+{
+    memset(out, 0, PC_ID_BYTES);
+    for (uint8_t i = 0; i < PARAM_ID_LEN && id[i] != '\0'; i++) {
+        uint8_t code = id_code(id[i]);
+        uint16_t bit = (uint16_t)(i * 6);
+        
+        if (code == PC_NO_CODE) {
+            return false;
+        }
+        out[bit / 8] |= (uint8_t)(code << (bit % 8));
+        if (bit % 8 > 2) {
+            out[bit / 8 + 1] |= (uint8_t)(code >> (8 - bit % 8));
+        }
+    }
+    return true;
+}
+
+static void id_unpack(const uint8_t *in, char *id)
+{
+    for (uint8_t i = 0; i < PARAM_ID_LEN; i++) {
+        uint16_t bit = (uint16_t)(i * 6);
+        uint16_t pair = in[bit / 8];
+        
+        if (bit / 8 + 1 < PC_ID_BYTES) {
+            pair |= (uint16_t)(in[bit / 8 + 1] << 8);
+        }
+        id[i] = id_char((uint8_t)((pair >> (bit % 8)) & 0x3F));
+    }
+}
+
+static bool seen(uint16_t index)
+{
+    return (cache.seen[index / 8] & (1u << (index % 8))) != 0;
+}
+
+static HAL_StatusTypeDef erase_page(uint16_t page)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t error;
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = PARAM_CACHE_ADDR + (uint32_t)page * PARAM_CACHE_PAGE_SIZE;
+    erase.NbPages = 1;
+    return HAL_FLASHEx_Erase(&erase, &error);
+}
+
+/**
+ * @brief Append a record (the page is erased first when the record opens it)
+ */
+static bool append(const ParamCache_Entry_t *entry, const uint8_t *packed)
+{
+    uint32_t addr = PC_ADDR(cache.records);
+    uint16_t half[PARAM_CACHE_RECORD / 2];
+    HAL_StatusTypeDef status = HAL_OK;
+    
+    half[0] = (uint16_t)(entry->index | ((uint16_t)entry->type << 12));
+    half[1] = (uint16_t)(entry->value[0] | (entry->value[1] << 8));
+    half[2] = (uint16_t)(entry->value[2] | (entry->value[3] << 8));
+    for (uint8_t i = 0; i < PC_ID_BYTES / 2; i++) {
+        half[3 + i] = (uint16_t)(packed[2 * i] | (packed[2 * i + 1] << 8));
+    }
+    
+    HAL_FLASH_Unlock();
+    if (cache.records % PC_PER_PAGE == 0) {
+        status = erase_page(cache.records / PC_PER_PAGE);
+    }
+    for (uint8_t i = 0; status == HAL_OK && i < PARAM_CACHE_RECORD / 2; i++) {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + 2U * i, half[i]);
+    }
+    HAL_FLASH_Lock();
+    
+    if (status != HAL_OK) {
+        return false;
+    }
+    cache.records++;
+    return true;
+}
+
+/* ==================== Public Functions ==================== */
+
+bool ParamCache_Put(const ParamCache_Entry_t *report, uint16_t count)
+{
+    ParamCache_Entry_t copy = *report;
+    const ParamCache_Entry_t *entry = &copy;
+    uint8_t packed[PC_ID_BYTES];
+    
+    /* Change reports may come without an index (-1): the id gives it */
+    if (copy.index == 0xFFFF) {
+        ParamCache_Entry_t held;
+        
+        if (!ParamCache_Get((uint16_t)ParamCache_Find(-1, copy.id), &held)) {
+            return false;
+        }
+        copy.index = held.index;
+        count = cache.count;
+    }
+    if (count != cache.count) {
+        ParamCache_Clear();
+        cache.count = count;
+        cache.failed = (count > PARAM_CACHE_MAX);
+    }
+    if (cache.failed) {
+        return false;
+    }
+    if (entry->index >= count || entry->type > 0x0F || !id_pack(entry->id, packed)) {
+        cache.failed = true;
+        return false;
+    }
+    
+    /* Unchanged: nothing to write */
+    if (seen(entry->index)) {
+        ParamCache_Entry_t held;
+        
+        if (ParamCache_Get((uint16_t)ParamCache_Find(entry->index, NULL), &held) &&
+            held.type == entry->type && memcmp(held.value, entry->value, sizeof(held.value)) == 0 &&
+            strncmp(held.id, entry->id, PARAM_ID_LEN) == 0) {
+            return true;
+        }
+    }
+    
+    /* Full of changed values: start over, the autopilot's next list refills it */
+    if (cache.records >= PARAM_CACHE_MAX) {
+        uint16_t keep = cache.count;
+        
+        ParamCache_Clear();
+        cache.count = keep;
+    }
+    if (!append(entry, packed)) {
+        cache.failed = true;
+        return false;
+    }
+    if (!seen(entry->index)) {
+        cache.seen[entry->index / 8] |= (uint8_t)(1u << (entry->index % 8));
+        cache.have++;
+    }
+    return true;
+}
+
+bool ParamCache_Complete(void)
+{
+    return (!cache.failed && cache.count > 0 && cache.have == cache.count);
+}
+
+uint16_t ParamCache_Records(void)
+{
+    return cache.records;
+}
+
+uint16_t ParamCache_Count(void)
+{
+    return cache.count;
+}
+
+bool ParamCache_Get(uint16_t record, ParamCache_Entry_t *entry)
+{
+    const uint8_t *rec;
+    
+    if (record >= cache.records) {
+        return false;
+    }
+    rec = (const uint8_t *)(uintptr_t)PC_ADDR(record);
+    entry->index = (uint16_t)((rec[0] | (rec[1] << 8)) & 0x0FFF);
+    entry->type = (uint8_t)(rec[1] >> 4);
+    memcpy(entry->value, &rec[2], sizeof(entry->value));
+    id_unpack(&rec[6], entry->id);
+    return true;
+}
+
+int ParamCache_Find(int index, const char *id)
+{
+    ParamCache_Entry_t entry;
+    
+    /* Newest first - a changed value was appended after the old one */
+    for (int r = (int)cache.records - 1; r >= 0; r--) {
+        const uint8_t *rec = (const uint8_t *)(uintptr_t)PC_ADDR(r);
+        
+        if (index >= 0) {
+            if (((rec[0] | (rec[1] << 8)) & 0x0FFF) == index) {
+                return r;
+            }
+        } else if (ParamCache_Get((uint16_t)r, &entry) && strncmp(entry.id, id, PARAM_ID_LEN) == 0) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+void ParamCache_Clear(void)
+{
+    memset(&cache, 0, sizeof(cache));
+}
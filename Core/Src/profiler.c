@@ -0,0 +1,69 @@
+/**
+ * @file    profiler.c
+ * @brief   Hot-path profiler: cycles per call at fixed code sites
+ * @version 1.0
+ */
+
+#include "profiler.h"
+
+#if PROFILER_ENABLE
+
+static const char *const site_names[PROF_SITES] = { "bridge", "b64", "uart_rd", "anomaly", "uart_isr", "crc" };
+
+static Prof_Stats_t prof_stats[PROF_SITES];
+static uint32_t prof_overhead;      /* Cycles of an empty BEGIN / END pair */
+
+/* ==================== Public Functions ==================== */
+
+void Profiler_Init(void)
+{
+    prof_overhead = UINT32_MAX;
+    
+    /* Least of a few tries: a SysTick interrupt in between adds to one */
+    for (uint8_t i = 0; i < 8; i++) {
+        uint32_t start = Sched_Cycles();
+        uint32_t cycles = Sched_Cycles() - start;
+        
+        if (cycles < prof_overhead) {
+            prof_overhead = cycles;
+        }
+    }
+    Profiler_Reset();
+}
+
+void Profiler_Record(Prof_Site_t site, uint32_t cycles)
+{
+    Prof_Stats_t *st = &prof_stats[site];
+    
+    cycles = (cycles > prof_overhead) ? cycles - prof_overhead : 0;
+    st->count++;
+    st->sum += cycles;
+    if (cycles < st->min) {
+        st->min = cycles;
+    }
+    if (cycles > st->max) {
+        st->max = cycles;
+    }
+}
+
+const Prof_Stats_t *Profiler_Get(void)
+{
+    return prof_stats;
+}
+
+const char *Profiler_SiteName(Prof_Site_t site)
+{
+    return (site < PROF_SITES) ? site_names[site] : "";
+}
+
+void Profiler_Reset(void)
+{
+    for (uint8_t i = 0; i < PROF_SITES; i++) {
+        prof_stats[i].count = 0;
+        prof_stats[i].min = UINT32_MAX;
+        prof_stats[i].max = 0;
+        prof_stats[i].sum = 0;
+    }
+}
+
+#endif /* PROFILER_ENABLE */
@@ -0,0 +1,46 @@
+/**
+ * @file    ram_usage.c
+ * @brief   RAM budget: static data from the linker, main stack high-water mark
+ * @version 1.0
+ */
+
+#include "ram_usage.h"
+
+/* Linker-defined region bounds (default scatter file of the Keil target) */
+extern uint32_t Image$$RW_IRAM1$$Base;
+extern uint32_t Image$$RW_IRAM1$$ZI$$Limit;
+
+/* Top of the main stack: the initial SP, first word of the vector table */
+#define STACK_TOP       (((const uint32_t *)FLASH_BASE)[0])
+#define STACK_BOTTOM    ((volatile uint32_t *)(uintptr_t)(STACK_TOP - RAM_STACK_SIZE))
+
+/* ==================== Public Functions ==================== */
+
+void RamUsage_Paint(void)
+{
+    volatile uint32_t *word = STACK_BOTTOM;
+    /* Stop short of this frame */
+    volatile uint32_t *end = (volatile uint32_t *)(uintptr_t)(__get_MSP() - 32U);
+    
+    while (word < end) {
+        *word++ = RAM_PAINT;
+    }
+}
+
+uint32_t RamUsage_StackUsed(void)
+{
+    volatile uint32_t *word = STACK_BOTTOM;
+    uint32_t free = 0;
+    
+    while (free < RAM_STACK_SIZE && *word++ == RAM_PAINT) {
+        free += 4U;
+    }
+    return RAM_STACK_SIZE - free;
+}
+
+uint32_t RamUsage_Static(void)
+{
+    uint32_t span = (uint32_t)(uintptr_t)&Image$$RW_IRAM1$$ZI$$Limit - (uint32_t)(uintptr_t)&Image$$RW_IRAM1$$Base;
+    
+    return span - RAM_STACK_SIZE - RAM_HEAP_SIZE;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file    retain.c
+ * @brief   State carried over watchdog and software resets in SRAM the C startup leaves alone
+ * @version 1.0
+ */
+
+#include "retain.h"
+#include "crc32.h"
+
+#define RETAIN_MAGIC    0x52544E44U     /* "RTND" */
+
+/**
+ * @brief Copy kept across resets (not cleared by the C startup)
+ */
+typedef struct {
+    volatile uint32_t magic;
+    uint32_t len;               /* sizeof(Retain_State_t): a build with another layout ignores it */
+    uint32_t crc;               /* CRC-32 of state */
+    Retain_State_t state;
+} Retain_Record_t;
+
+#define RETAIN_RECORD   ((Retain_Record_t *)RETAIN_ADDR)
+
+/* The record has to fit the region the scatter file leaves out (compile error otherwise) */
+typedef char Retain_Fits_t[(sizeof(Retain_Record_t) <= RETAIN_SIZE) ? 1 : -1];
+
+/* ==================== Public Functions ==================== */
+
+const Retain_State_t *Retain_Boot(bool warm)
+{
+    Retain_Record_t *rec = RETAIN_RECORD;
+    
+    if (!warm || rec->magic != RETAIN_MAGIC || rec->len != sizeof(Retain_State_t) ||
+        rec->crc != Crc32_Update(0, &rec->state, sizeof(rec->state))) {
+        rec->magic = 0;
+        return NULL;
+    }
+    return &rec->state;
+}
+
+Retain_State_t *Retain_Open(void)
+{
+    RETAIN_RECORD->magic = 0;
+    return &RETAIN_RECORD->state;
+}
+
+void Retain_Close(void)
+{
+    Retain_Record_t *rec = RETAIN_RECORD;
+    
+    rec->len = sizeof(Retain_State_t);
+    rec->crc = Crc32_Update(0, &rec->state, sizeof(rec->state));
+    rec->magic = RETAIN_MAGIC;
+}
@@ -0,0 +1,228 @@
+/**
+ * @file    scheduler.c
+ * @brief   Cooperative run-to-completion task scheduler
+ * @version 1.4
+ */
+
+#include "scheduler.h"
+#include "debug_log.h"
+#include <string.h>
+
+#define LOG_FILE_ID     6
+#define LOG_MODULE      LOG_MOD_APP
+
+/* Longest tick interrupt entry latency, core cycles (written from SysTick_Handler) */
+static volatile uint32_t tick_late;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Book one run: max, moving average, and a warning on a new worst overrun
+ */
+static void account(Sched_t *sched, uint8_t i, uint32_t cycles)
+{
+    const Sched_Task_t *task = &sched->tasks[i];
+    Sched_Stats_t *st = &sched->stats[i];
+    
+    st->load_cycles += cycles;
+    if (st->runs++ == 0) {
+        st->avg_cycles = cycles;
+    } else {
+        st->avg_cycles = st->avg_cycles - (st->avg_cycles >> SCHED_AVG_SHIFT) + (cycles >> SCHED_AVG_SHIFT);
+    }
+    if (cycles > (uint32_t)task->budget_us * sched->cycles_per_us) {
+        st->overruns++;
+        if (cycles > st->max_cycles) {
+            LOG_WARN("Task %s: %lu us (budget %u)", task->name,
+                     (unsigned long)Sched_CyclesToUs(sched, cycles), (unsigned)task->budget_us);
+        }
+    }
+    if (cycles > st->max_cycles) {
+        st->max_cycles = cycles;
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+void Sched_Init(Sched_t *sched, const Sched_Task_t *tasks, Sched_Stats_t *stats, uint8_t count, void *ctx)
+{
+    sched->tasks = tasks;
+    sched->stats = stats;
+    sched->count = count;
+    sched->ctx = ctx;
+    memset(stats, 0, sizeof(Sched_Stats_t) * count);
+    for (uint8_t i = 0; i < count; i++) {
+        stats[i].last_tick = HAL_GetTick();
+    }
+    sched->pass_max_cycles = 0;
+    sched->busy = 0;
+    sched->running = SCHED_IDLE;
+    sched->run_start = 0;
+    sched->trace = NULL;
+    sched->ran = false;
+    sched->load_start = Sched_Cycles();
+    sched->idle_cycles = 0;
+    sched->empty_cycles = 0;
+    sched->load_pm = 0;
+    sched->cycles_per_us = SystemCoreClock / 1000000U;
+    if (sched->cycles_per_us == 0) {
+        sched->cycles_per_us = 1;
+    }
+}
+
+void Sched_Run(Sched_t *sched, uint8_t events)
+{
+    uint32_t pass_start = Sched_Cycles();
+    
+    sched->ran = false;
+    Sched_RunTasks(sched, events, 0, sched->count);
+    
+    uint32_t pass = Sched_Cycles() - pass_start;
+    if (pass > sched->pass_max_cycles) {
+        sched->pass_max_cycles = pass;
+    }
+    
+    /* Nothing ran: the loop idles (a superloop that never sleeps is measured this way alone) */
+    if (!sched->ran) {
+        sched->idle_cycles += pass;
+        if (sched->empty_cycles == 0 || pass < sched->empty_cycles) {
+            sched->empty_cycles = pass;
+        }
+    }
+}
+
+bool Sched_RunTasks(Sched_t *sched, uint8_t events, uint8_t first, uint8_t count)
+{
+    bool busy = false;
+    
+    for (uint8_t i = first; i < first + count && i < sched->count; i++) {
+        const Sched_Task_t *task = &sched->tasks[i];
+        Sched_Stats_t *st = &sched->stats[i];
+        uint32_t now = HAL_GetTick();
+        
+        if ((events & task->events) == 0 && now - st->last_tick < task->period_ms &&
+            (sched->busy & (1UL << i)) == 0) {
+            continue;
+        }
+        st->last_tick = now;
+        
+        sched->run_start = now;
+        sched->running = i;
+        sched->ran = true;
+        if (sched->trace != NULL) {
+            *sched->trace = i;
+        }
+        
+        uint32_t start = Sched_Cycles();
+        bool more = task->fn(sched->ctx);
+        account(sched, i, Sched_Cycles() - start);
+        
+        sched->running = SCHED_IDLE;
+        if (sched->trace != NULL) {
+            *sched->trace = SCHED_IDLE;
+        }
+        
+        if (more) {
+            sched->busy |= (1UL << i);
+            busy = true;
+        } else {
+            sched->busy &= ~(1UL << i);
+        }
+    }
+    return busy;
+}
+
+uint32_t Sched_NextDue(const Sched_t *sched)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t next = UINT32_MAX;
+    
+    if (sched->busy != 0) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < sched->count; i++) {
+        uint32_t elapsed = now - sched->stats[i].last_tick;
+        
+        if (elapsed >= sched->tasks[i].period_ms) {
+            return 0;
+        }
+        if (sched->tasks[i].period_ms - elapsed < next) {
+            next = sched->tasks[i].period_ms - elapsed;
+        }
+    }
+    return next;
+}
+
+uint32_t Sched_Cycles(void)
+{
+    uint32_t ms, val;
+    
+    /* SysTick counts core cycles down from LOAD each millisecond; a wrap
+     * between the two reads shows as a changed tick and is read again */
+    do {
+        ms = HAL_GetTick();
+        val = SysTick->VAL;
+    } while (ms != HAL_GetTick());
+    
+    return ms * (SysTick->LOAD + 1U) + (SysTick->LOAD - val);
+}
+
+void Sched_TickIrq(void)
+{
+    /* The counter reloaded when the interrupt was raised - what it counted since is the wait */
+    uint32_t late = SysTick->LOAD - SysTick->VAL;
+    
+    if (late > tick_late) {
+        tick_late = late;
+    }
+}
+
+uint32_t Sched_TickLate(void)
+{
+    return tick_late;
+}
+
+uint32_t Sched_CyclesToUs(const Sched_t *sched, uint32_t cycles)
+{
+    return cycles / sched->cycles_per_us;
+}
+
+void Sched_AddIdle(Sched_t *sched, uint32_t cycles)
+{
+    sched->idle_cycles += cycles;
+}
+
+uint16_t Sched_TakeLoad(Sched_t *sched)
+{
+    uint32_t now = Sched_Cycles();
+    uint32_t per_mille = (now - sched->load_start) / 1000U;    /* Window cycles per mille (no 64-bit divide) */
+    
+    if (per_mille == 0) {
+        return sched->load_pm;
+    }
+    sched->load_pm = (sched->idle_cycles >= per_mille * 1000U) ? 0 :
+                     (uint16_t)(1000U - sched->idle_cycles / per_mille);
+    for (uint8_t i = 0; i < sched->count; i++) {
+        Sched_Stats_t *st = &sched->stats[i];
+        uint32_t pm = st->load_cycles / per_mille;
+        
+        st->load_pm = (uint16_t)((pm > 1000U) ? 1000U : pm);
+        st->load_cycles = 0;
+    }
+    sched->load_start = now;
+    sched->idle_cycles = 0;
+    return sched->load_pm;
+}
+
+void Sched_ResetStats(Sched_t *sched)
+{
+    for (uint8_t i = 0; i < sched->count; i++) {
+        Sched_Stats_t *st = &sched->stats[i];
+        
+        st->runs = 0;
+        st->overruns = 0;
+        st->max_cycles = 0;
+        st->avg_cycles = 0;
+    }
+    sched->pass_max_cycles = 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file    spi_nor.c
+ * @brief   SPI NOR flash on SPI1 (W25Qxx command set), never waiting on the chip
+ * @version 1.0
+ */
+
+#include "spi_nor.h"
+#include "outage_log.h"
+
+#if OUTAGE_LOG_SPI              /* The outage log is the chip's only user */
+
+/* Commands */
+#define NOR_WREN        0x06
+#define NOR_RDSR        0x05
+#define NOR_READ        0x03
+#define NOR_PP          0x02
+#define NOR_SE          0x20
+#define NOR_JEDEC       0x9F
+#define NOR_RELEASE     0xAB        /* Out of deep power-down */
+#define NOR_WIP         0x01        /* Status: write in progress */
+
+static bool busy;                   /* A program or erase started and not seen done */
+
+/* ==================== Private Functions ==================== */
+
+static uint8_t xfer(uint8_t out)
+{
+    while ((SPI1->SR & SPI_SR_TXE) == 0) {
+    }
+    *(volatile uint8_t *)&SPI1->DR = out;
+    while ((SPI1->SR & SPI_SR_RXNE) == 0) {
+    }
+    return *(volatile uint8_t *)&SPI1->DR;
+}
+
+static void nor_select(void)
+{
+    SPI_NOR_CS_GPIO_Port->BRR = SPI_NOR_CS_Pin;
+}
+
+static void nor_deselect(void)
+{
+    while ((SPI1->SR & SPI_SR_BSY) != 0) {
+    }
+    SPI_NOR_CS_GPIO_Port->BSRR = SPI_NOR_CS_Pin;
+}
+
+/**
+ * @brief Select the chip and send a command with a 24-bit address
+ */
+static void command(uint8_t cmd, uint32_t addr)
+{
+    nor_select();
+    xfer(cmd);
+    xfer((uint8_t)(addr >> 16));
+    xfer((uint8_t)(addr >> 8));
+    xfer((uint8_t)addr);
+}
+
+static void write_enable(void)
+{
+    nor_select();
+    xfer(NOR_WREN);
+    nor_deselect();
+}
+
+/* ==================== Public Functions ==================== */
+
+bool SpiNor_Init(void)
+{
+    GPIO_InitTypeDef gpio = {0};
+    uint8_t id;
+    
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_SPI1_CLK_ENABLE();
+    
+    HAL_GPIO_WritePin(SPI_NOR_CS_GPIO_Port, SPI_NOR_CS_Pin, GPIO_PIN_SET);
+    gpio.Pin = SPI_NOR_CS_Pin;
+    gpio.Mode = GPIO_MODE_OUTPUT_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(SPI_NOR_CS_GPIO_Port, &gpio);
+    gpio.Pin = SPI_NOR_BUS_Pins;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Alternate = GPIO_AF0_SPI1;
+    HAL_GPIO_Init(GPIOA, &gpio);
+    
+    /* Master, mode 0, PCLK/4, software NSS; 8-bit frames, RXNE per byte */
+    SPI1->CR1 = 0;
+    SPI1->CR2 = SPI_CR2_FRXTH | SPI_CR2_DS_2 | SPI_CR2_DS_1 | SPI_CR2_DS_0;
+    SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_BR_0 | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_SPE;
+    
+    nor_select();
+    xfer(NOR_RELEASE);
+    nor_deselect();
+    HAL_Delay(1);                   /* tRES1 */
+    
+    nor_select();
+    xfer(NOR_JEDEC);
+    id = xfer(0xFF);                /* Manufacturer; type and capacity follow */
+    nor_deselect();
+    
+    busy = true;                    /* A reset may have cut in on an erase: ask first */
+    return id != 0x00 && id != 0xFF;
+}
+
+bool SpiNor_Busy(void)
+{
+    if (busy) {
+        nor_select();
+        xfer(NOR_RDSR);
+        busy = (xfer(0xFF) & NOR_WIP) != 0;
+        nor_deselect();
+    }
+    return busy;
+}
+
+void SpiNor_Read(uint32_t addr, uint8_t *buf, size_t len)
+{
+    command(NOR_READ, addr);
+    while (len-- > 0) {
+        *buf++ = xfer(0xFF);
+    }
+    nor_deselect();
+}
+
+void SpiNor_Program(uint32_t addr, const uint8_t *data, size_t len)
+{
+    write_enable();
+    command(NOR_PP, addr);
+    while (len-- > 0) {
+        xfer(*data++);
+    }
+    nor_deselect();
+    busy = true;
+}
+
+void SpiNor_EraseSector(uint32_t addr)
+{
+    write_enable();
+    command(NOR_SE, addr);
+    nor_deselect();
+    busy = true;
+}
+
+#endif /* OUTAGE_LOG_SPI */
@@ -23,6 +23,8 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "uart_dma.h"
+#include "low_power.h"
+#include "scheduler.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -102,6 +104,7 @@ void HardFault_Handler(void)
   }
 }
 
+#if !APP_RTOS   /* Threaded build: SVC, PendSV and SysTick belong to RTX5 */
 /**
   * @brief This function handles System service call via SWI instruction.
   */
@@ -134,13 +137,14 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
-
+  Sched_TickIrq();
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
 
   /* USER CODE END SysTick_IRQn 1 */
 }
+#endif /* !APP_RTOS */
 
 /******************************************************************************/
 /* STM32F0xx Peripheral Interrupt Handlers                                    */
@@ -155,7 +159,10 @@ void SysTick_Handler(void)
 void DMA1_Channel2_3_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel2_3_IRQn 0 */
-
+#if UART_DMA_LL
+  UART_DMA_DMA_IRQHandler(&telem_uart);
+  return;
+#endif
   /* USER CODE END DMA1_Channel2_3_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart1_tx);
   HAL_DMA_IRQHandler(&hdma_usart1_rx);
@@ -170,7 +177,10 @@ void DMA1_Channel2_3_IRQHandler(void)
 void DMA1_Channel4_5_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel4_5_IRQn 0 */
-
+#if UART_DMA_LL
+  UART_DMA_DMA_IRQHandler(&sim_uart);
+  return;
+#endif
   /* USER CODE END DMA1_Channel4_5_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_usart2_tx);
   HAL_DMA_IRQHandler(&hdma_usart2_rx);
@@ -186,6 +196,9 @@ void USART1_IRQHandler(void)
 {
   /* USER CODE BEGIN USART1_IRQn 0 */
   UART_DMA_IDLE_IRQHandler(&telem_uart);
+#if UART_DMA_LL
+  return;
+#endif
   /* USER CODE END USART1_IRQn 0 */
   HAL_UART_IRQHandler(&huart1);
   /* USER CODE BEGIN USART1_IRQn 1 */
@@ -200,6 +213,9 @@ void USART2_IRQHandler(void)
 {
   /* USER CODE BEGIN USART2_IRQn 0 */
   UART_DMA_IDLE_IRQHandler(&sim_uart);
+#if UART_DMA_LL
+  return;
+#endif
   /* USER CODE END USART2_IRQn 0 */
   HAL_UART_IRQHandler(&huart2);
   /* USER CODE BEGIN USART2_IRQn 1 */
@@ -208,5 +224,11 @@ void USART2_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
-
+/**
+  * @brief This function handles TIM14 global interrupt (idle sleep wake-up).
+  */
+void TIM14_IRQHandler(void)
+{
+  LowPower_TimerIRQHandler();
+}
 /* USER CODE END 1 */
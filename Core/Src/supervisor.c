@@ -0,0 +1,153 @@
+/**
+ * @file    supervisor.c
+ * @brief   Task liveness supervisor - the only place the IWDG is refreshed
+ * @version 1.0
+ */
+
+#include "supervisor.h"
+#include "debug_log.h"
+
+#define LOG_FILE_ID     7
+#define LOG_MODULE      LOG_MOD_APP
+#define SUP_MAGIC       0x53555056U     /* "SUPV" */
+
+/**
+ * @brief Record kept across resets (top of RAM, not cleared by the C startup)
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t check;             /* ~magic - a power-on leaves random contents */
+    uint32_t up_s;
+    uint32_t run_ms;
+    volatile uint8_t running;   /* Sched_t.trace: task being run */
+    uint8_t stuck;              /* Task given up on (SCHED_IDLE: none) */
+    uint8_t reserved[2];
+} Sup_Record_t;
+
+#define SUP_RECORD      ((Sup_Record_t *)SUPERVISOR_NOINIT_ADDR)
+
+static Sched_t *supervised;
+static bool given_up;
+static Supervisor_Boot_t boot;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Reset cause from the RCC flags (the watchdogs and software first:
+ *        they also drive NRST, so PINRSTF is set with them)
+ */
+static Supervisor_Reset_t reset_cause(uint32_t csr)
+{
+    if (csr & RCC_CSR_IWDGRSTF) {
+        return SUPERVISOR_RESET_IWDG;
+    }
+    if (csr & RCC_CSR_WWDGRSTF) {
+        return SUPERVISOR_RESET_WWDG;
+    }
+    if (csr & RCC_CSR_SFTRSTF) {
+        return SUPERVISOR_RESET_SOFTWARE;
+    }
+    if (csr & RCC_CSR_LPWRRSTF) {
+        return SUPERVISOR_RESET_LOW_POWER;
+    }
+    if (csr & RCC_CSR_PORRSTF) {
+        return SUPERVISOR_RESET_POWER;
+    }
+    if (csr & RCC_CSR_OBLRSTF) {
+        return SUPERVISOR_RESET_OPTION_BYTES;
+    }
+    return SUPERVISOR_RESET_PIN;
+}
+
+/* ==================== Public Functions ==================== */
+
+void Supervisor_Boot(void)
+{
+    Sup_Record_t *rec = SUP_RECORD;
+    
+    boot.cause = reset_cause(RCC->CSR);
+    RCC->CSR |= RCC_CSR_RMVF;
+    
+    boot.task = SCHED_IDLE;
+    boot.stuck = false;
+    boot.run_ms = 0;
+    boot.up_s = 0;
+    if (boot.cause != SUPERVISOR_RESET_POWER && rec->magic == SUP_MAGIC && rec->check == ~SUP_MAGIC) {
+        boot.stuck = (rec->stuck != SCHED_IDLE);
+        boot.task = boot.stuck ? rec->stuck : rec->running;
+        boot.run_ms = rec->run_ms;
+        boot.up_s = rec->up_s;
+    }
+    
+    rec->magic = SUP_MAGIC;
+    rec->check = ~SUP_MAGIC;
+    rec->up_s = 0;
+    rec->run_ms = 0;
+    rec->running = SCHED_IDLE;
+    rec->stuck = SCHED_IDLE;
+}
+
+void Supervisor_Init(Sched_t *sched)
+{
+    supervised = sched;
+    given_up = false;
+    sched->trace = &SUP_RECORD->running;
+    
+    if (boot.cause == SUPERVISOR_RESET_IWDG) {
+        LOG_WARN("Watchdog reset: task %s %s, %lu ms",
+                 boot.task < sched->count ? sched->tasks[boot.task].name : "-",
+                 boot.stuck ? "stuck" : "running", (unsigned long)boot.run_ms);
+    }
+}
+
+void Supervisor_Service(void)
+{
+    Sup_Record_t *rec = SUP_RECORD;
+    uint32_t now = HAL_GetTick();
+    extern IWDG_HandleTypeDef hiwdg;
+    
+    if (given_up) {
+        return;     /* The IWDG resets us */
+    }
+    rec->up_s = now / 1000U;
+    
+    if (supervised != NULL) {
+        uint8_t i = supervised->running;
+        
+        if (i < supervised->count) {
+            const Sched_Task_t *task = &supervised->tasks[i];
+            uint32_t run_ms = now - supervised->run_start;
+            
+            rec->run_ms = run_ms;
+            if (task->deadline_ms != 0 && run_ms > task->deadline_ms) {
+                given_up = true;
+                rec->stuck = i;
+                LOG_ERROR("Task %s: %lu ms (deadline %u) - watchdog reset",
+                          task->name, (unsigned long)run_ms, (unsigned)task->deadline_ms);
+                return;
+            }
+        }
+    }
+    HAL_IWDG_Refresh(&hiwdg);
+}
+
+const Supervisor_Boot_t *Supervisor_GetBoot(void)
+{
+    return &boot;
+}
+
+bool Supervisor_WarmBoot(void)
+{
+    return (boot.cause == SUPERVISOR_RESET_IWDG || boot.cause == SUPERVISOR_RESET_WWDG ||
+            boot.cause == SUPERVISOR_RESET_SOFTWARE);
+}
+
+const char *Supervisor_ResetName(Supervisor_Reset_t cause)
+{
+    static const char *const names[] = { "power", "pin", "iwdg", "wwdg", "soft", "lowpower", "obl" };
+    
+    if ((unsigned)cause >= sizeof(names) / sizeof(names[0])) {
+        return "?";
+    }
+    return names[cause];
+}
@@ -0,0 +1,241 @@
+/**
+ * @file    telem_fields.c
+ * @brief   A few autopilot fields decoded on board, published as one CBOR map on a topic of their own
+ * @version 1.0
+ */
+
+#include "telem_fields.h"
+
+#if FIELDS_ENABLE
+
+#include "mav_field.h"
+#include <string.h>
+
+/* Messages read (common.xml) */
+#define HEARTBEAT_ID            0
+#define GLOBAL_POSITION_INT_ID  33
+#define BATTERY_STATUS_ID       147
+
+/* Messages heard since boot */
+#define HAVE_POS        0x01
+#define HAVE_BAT        0x02
+#define HAVE_HB         0x04
+
+#define BAT_CELLS       10          /* voltages[] of BATTERY_STATUS */
+#define MAV_MODE_FLAG_SAFETY_ARMED  0x80
+
+/* CBOR major types */
+#define CBOR_UINT       0
+#define CBOR_NINT       1
+#define CBOR_TEXT       3
+#define CBOR_MAP        5
+#define CBOR_FALSE      0xF4
+#define CBOR_TRUE       0xF5
+
+static struct {
+    A7600_MQTT_Handle_t *mqtt;
+    bool fresh;             /* Fed since the last record */
+    bool in_flight;         /* The record is read by the modem until done */
+    uint8_t have;           /* HAVE_x */
+    uint8_t sysid;
+    uint32_t tick;          /* Last record */
+    /* GLOBAL_POSITION_INT */
+    uint32_t pos_tick;
+    int32_t lat;            /* degE7 */
+    int32_t lon;
+    int32_t alt;            /* mm, MSL */
+    int32_t ralt;           /* mm, above home */
+    uint16_t hdg;           /* cdeg, UINT16_MAX unknown */
+    /* BATTERY_STATUS, battery 0 */
+    uint32_t vbat;          /* mV, cells added up */
+    int16_t ibat;           /* cA, -1 unknown */
+    int8_t remaining;       /* %, -1 unknown */
+    /* HEARTBEAT */
+    uint32_t mode;          /* custom_mode */
+    uint8_t type;
+    uint8_t base_mode;
+    uint8_t state;          /* system_status */
+    uint8_t record[FIELDS_RECORD_MAX];
+} fld;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Write a CBOR head: major type and argument, shortest form
+ * @return Bytes written (1 to 5)
+ */
+static size_t cbor_head(uint8_t *p, uint8_t major, uint32_t value)
+{
+    major = (uint8_t)(major << 5);
+    if (value < 24) {
+        p[0] = (uint8_t)(major | value);
+        return 1;
+    }
+    if (value <= 0xFF) {
+        p[0] = major | 24;
+        p[1] = (uint8_t)value;
+        return 2;
+    }
+    if (value <= 0xFFFF) {
+        p[0] = major | 25;
+        p[1] = (uint8_t)(value >> 8);
+        p[2] = (uint8_t)value;
+        return 3;
+    }
+    p[0] = major | 26;
+    p[1] = (uint8_t)(value >> 24);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 8);
+    p[4] = (uint8_t)value;
+    return 5;
+}
+
+/**
+ * @brief Write a text key and an integer value
+ */
+static size_t cbor_pair(uint8_t *p, const char *key, int32_t value)
+{
+    size_t len = strlen(key);
+    size_t n = cbor_head(p, CBOR_TEXT, (uint32_t)len);
+    
+    memcpy(&p[n], key, len);
+    n += len;
+    if (value < 0) {
+        return n + cbor_head(&p[n], CBOR_NINT, (uint32_t)(-1 - value));
+    }
+    return n + cbor_head(&p[n], CBOR_UINT, (uint32_t)value);
+}
+
+/**
+ * @brief Write the record: a map of the values heard so far
+ * @return Record length
+ */
+static size_t fields_record(uint8_t *out, uint32_t now)
+{
+    size_t n = 1;
+    uint8_t pairs = 1;
+    uint32_t age = now - fld.pos_tick;
+    
+    n += cbor_pair(&out[n], "sys", fld.sysid);
+    if (fld.have & HAVE_POS) {
+        n += cbor_pair(&out[n], "lat", fld.lat);
+        n += cbor_pair(&out[n], "lon", fld.lon);
+        n += cbor_pair(&out[n], "alt", fld.alt);
+        n += cbor_pair(&out[n], "ralt", fld.ralt);
+        n += cbor_pair(&out[n], "age", (int32_t)((age > INT32_MAX) ? INT32_MAX : age));
+        pairs += 5;
+        if (fld.hdg != UINT16_MAX) {
+            n += cbor_pair(&out[n], "hdg", fld.hdg);
+            pairs++;
+        }
+    }
+    if (fld.have & HAVE_BAT) {
+        n += cbor_pair(&out[n], "vbat", (int32_t)fld.vbat);
+        pairs++;
+        if (fld.ibat >= 0) {
+            n += cbor_pair(&out[n], "ibat", fld.ibat);
+            pairs++;
+        }
+        if (fld.remaining >= 0) {
+            n += cbor_pair(&out[n], "rem", fld.remaining);
+            pairs++;
+        }
+    }
+    if (fld.have & HAVE_HB) {
+        n += cbor_pair(&out[n], "mode", (int32_t)(fld.mode & INT32_MAX));
+        n += cbor_pair(&out[n], "base", fld.base_mode);
+        n += cbor_pair(&out[n], "state", fld.state);
+        n += cbor_pair(&out[n], "type", fld.type);
+        n += cbor_head(&out[n], CBOR_TEXT, 3);
+        memcpy(&out[n], "arm", 3);
+        n += 3;
+        out[n++] = (fld.base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? CBOR_TRUE : CBOR_FALSE;
+        pairs += 5;
+    }
+    out[0] = (uint8_t)((CBOR_MAP << 5) | pairs);    /* 15 pairs at most */
+    return n;
+}
+
+static void fields_done(void *ctx, MQTT_Result_t result)
+{
+    (void)ctx;
+    (void)result;
+    fld.in_flight = false;
+}
+
+/* ==================== Public Functions ==================== */
+
+void TelemFields_Init(A7600_MQTT_Handle_t *mqtt)
+{
+    memset(&fld, 0, sizeof(fld));
+    fld.mqtt = mqtt;
+    fld.tick = HAL_GetTick();
+}
+
+bool TelemFields_Wants(uint32_t msgid)
+{
+    return (msgid == HEARTBEAT_ID || msgid == GLOBAL_POSITION_INT_ID || msgid == BATTERY_STATUS_ID);
+}
+
+void TelemFields_Feed(uint32_t msgid, uint8_t sysid, const uint8_t *payload, uint32_t now)
+{
+    switch (msgid) {
+        case GLOBAL_POSITION_INT_ID:
+            fld.lat = (int32_t)MavField_U32(&payload[4]);
+            fld.lon = (int32_t)MavField_U32(&payload[8]);
+            fld.alt = (int32_t)MavField_U32(&payload[12]);
+            fld.ralt = (int32_t)MavField_U32(&payload[16]);
+            fld.hdg = MavField_U16(&payload[26]);
+            fld.pos_tick = now;
+            fld.have |= HAVE_POS;
+            break;
+        
+        case BATTERY_STATUS_ID:
+            if (payload[32] != 0) {
+                return;             /* Battery 0 only */
+            }
+            fld.vbat = 0;
+            for (uint8_t i = 0; i < BAT_CELLS; i++) {
+                uint16_t mv = MavField_U16(&payload[10 + 2 * i]);
+                
+                if (mv == UINT16_MAX) {
+                    break;          /* Cells past the pack's */
+                }
+                fld.vbat += mv;
+            }
+            fld.ibat = (int16_t)MavField_U16(&payload[30]);
+            fld.remaining = (int8_t)payload[35];
+            fld.have |= HAVE_BAT;
+            break;
+        
+        default:
+            fld.mode = MavField_U32(&payload[0]);
+            fld.type = payload[4];
+            fld.base_mode = payload[6];
+            fld.state = payload[7];
+            fld.have |= HAVE_HB;
+            break;
+    }
+    fld.sysid = sysid;
+    fld.fresh = true;
+}
+
+void TelemFields_Process(void)
+{
+    uint32_t now = HAL_GetTick();
+    size_t len;
+    
+    if (!fld.fresh || fld.in_flight || now - fld.tick < FIELDS_INTERVAL ||
+        !A7600_MQTT_IsConnected(fld.mqtt)) {
+        return;
+    }
+    len = fields_record(fld.record, now);
+    if (A7600_MQTT_PublishAsync(fld.mqtt, FIELDS_TOPIC, fld.record, len, MQTT_QOS_0,
+                                fields_done, NULL) == MQTT_OK) {
+        fld.in_flight = true;
+        fld.fresh = false;
+        fld.tick = now;
+    }
+}
+
+#endif /* FIELDS_ENABLE */
@@ -0,0 +1,155 @@
+/**
+ * @file    telem_summary.c
+ * @brief   Windowed statistics of the autopilot's ATTITUDE / VFR_HUD fields, sent in place of the samples
+ * @version 1.0
+ */
+
+#include "telem_summary.h"
+
+#if SUMMARY_ENABLE
+
+#include "arm_math.h"
+#include "mav_field.h"
+#include <string.h>
+
+/* Messages summarized (common.xml) */
+#define ATTITUDE_ID     30
+#define VFR_HUD_ID      74
+
+/* Sample groups: the fields of one message share their sampling */
+enum {
+    G_ATTITUDE = 0,
+    G_VFR_HUD,
+    G_COUNT
+};
+
+/* Fields: float at offset, kept as value * 2^frac (scales in Core/Doc/telemetry_summary.md) */
+static const struct {
+    uint8_t group;
+    uint8_t offset;
+    uint8_t frac;
+} fields[SUMMARY_FIELDS] = {
+    { G_ATTITUDE, 4, 13 },      /* roll, rad */
+    { G_ATTITUDE, 8, 13 },      /* pitch, rad */
+    { G_ATTITUDE, 16, 12 },     /* rollspeed, rad/s */
+    { G_ATTITUDE, 20, 12 },     /* pitchspeed, rad/s */
+    { G_ATTITUDE, 24, 12 },     /* yawspeed, rad/s */
+    { G_VFR_HUD, 0, 9 },        /* airspeed, m/s */
+    { G_VFR_HUD, 4, 9 },        /* groundspeed, m/s */
+    { G_VFR_HUD, 8, 1 },        /* alt, m */
+    { G_VFR_HUD, 12, 9 }        /* climb, m/s */
+};
+
+static struct {
+    q15_t samples[SUMMARY_FIELDS][SUMMARY_SAMPLES];
+    struct {
+        uint8_t count;      /* Samples held per field */
+        uint8_t stride;     /* Every stride-th payload is taken */
+        uint8_t skip;       /* Payloads to pass over before the next sample */
+    } group[G_COUNT];
+} sum;
+
+/* ==================== Private Functions ==================== */
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void group_reset(void)
+{
+    for (uint8_t g = 0; g < G_COUNT; g++) {
+        sum.group[g].count = 0;
+        sum.group[g].stride = 1;
+        sum.group[g].skip = 0;
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+void Summary_Init(void)
+{
+    group_reset();
+}
+
+bool Summary_Wants(uint32_t msgid)
+{
+    return (msgid == ATTITUDE_ID || msgid == VFR_HUD_ID);
+}
+
+void Summary_Feed(uint32_t msgid, const uint8_t *payload)
+{
+    uint8_t g = (msgid == ATTITUDE_ID) ? G_ATTITUDE : G_VFR_HUD;
+    
+    if (sum.group[g].skip > 0) {
+        sum.group[g].skip--;
+        return;
+    }
+    for (uint8_t f = 0; f < SUMMARY_FIELDS; f++) {
+        if (fields[f].group == g) {
+            sum.samples[f][sum.group[g].count] = (q15_t)MavField_Fixed(&payload[fields[f].offset], fields[f].frac);
+        }
+    }
+    sum.group[g].count++;
+    
+    /* Full: keep every other sample, take half as many from now on */
+    if (sum.group[g].count == SUMMARY_SAMPLES) {
+        for (uint8_t f = 0; f < SUMMARY_FIELDS; f++) {
+            if (fields[f].group == g) {
+                for (uint8_t i = 0; i < SUMMARY_SAMPLES / 2; i++) {
+                    sum.samples[f][i] = sum.samples[f][2 * i];
+                }
+            }
+        }
+        sum.group[g].count = SUMMARY_SAMPLES / 2;
+        if (sum.group[g].stride < 128) {
+            sum.group[g].stride *= 2;
+        }
+    }
+    sum.group[g].skip = sum.group[g].stride - 1;
+}
+
+size_t Summary_Take(uint8_t *out, uint32_t span_ms)
+{
+    size_t n = 4;
+    
+    out[0] = SUMMARY_VERSION;
+    out[1] = SUMMARY_FIELDS;
+    put16(&out[2], (uint16_t)((span_ms > 0xFFFF) ? 0xFFFF : span_ms));
+    
+    for (uint8_t f = 0; f < SUMMARY_FIELDS; f++) {
+        uint8_t count = sum.group[fields[f].group].count;
+        q15_t min = 0, max = 0, mean = 0, rms = 0;
+        uint32_t idx;
+        
+        if (count > 0) {
+            arm_min_q15(sum.samples[f], count, &min, &idx);
+            arm_max_q15(sum.samples[f], count, &max, &idx);
+            arm_mean_q15(sum.samples[f], count, &mean);
+            
+            /* Block floating point: the mean square is truncated to q15, so
+             * small values are scaled up to full range first (the samples are
+             * not needed after this) */
+            int32_t peak = (-min > max) ? -min : max;
+            uint8_t k = 0;
+            
+            while (k < 14 && (peak << (k + 1)) <= INT16_MAX) {
+                k++;
+            }
+            arm_shift_q15(sum.samples[f], (int8_t)k, sum.samples[f], count);
+            arm_rms_q15(sum.samples[f], count, &rms);
+            rms = (q15_t)(k ? (rms + (1 << (k - 1))) >> k : rms);
+        }
+        out[n] = count;
+        put16(&out[n + 1], (uint16_t)min);
+        put16(&out[n + 3], (uint16_t)max);
+        put16(&out[n + 5], (uint16_t)mean);
+        put16(&out[n + 7], (uint16_t)rms);
+        n += SUMMARY_FIELD_LEN;
+    }
+    group_reset();
+    return n;
+}
+
+#endif /* SUMMARY_ENABLE */
@@ -0,0 +1,54 @@
+/**
+ * @file    timebase.c
+ * @brief   Free-running microsecond clock (TIM3 into TIM15) and wrap-safe timeouts
+ * @version 1.0
+ */
+
+#include "timebase.h"
+
+#ifndef BENCH_HOST
+
+#define TIME_HZ         1000000U    /* TIM3 count rate */
+
+/* ==================== Public Functions ==================== */
+
+void Time_Init(void)
+{
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    __HAL_RCC_TIM15_CLK_ENABLE();
+    
+    /* TIM3: microseconds, update (overflow) out on TRGO */
+    TIM3->CR1 = 0;
+    TIM3->PSC = SystemCoreClock / TIME_HZ - 1U;
+    TIM3->ARR = 0xFFFF;
+    TIM3->EGR = TIM_EGR_UG;                     /* Load the prescaler - before TIM15 listens */
+    TIM3->SR = 0;
+    TIM3->CR2 = TIM_CR2_MMS_1;                  /* MMS 010: update as TRGO */
+    
+    /* TIM15: clocked by TIM3's TRGO (TS 001 = ITR1, SMS 111 = external clock mode 1) */
+    TIM15->CR1 = 0;
+    TIM15->PSC = 0;
+    TIM15->ARR = 0xFFFF;
+    TIM15->SMCR = TIM_SMCR_TS_0 | TIM_SMCR_SMS;
+    TIM15->CNT = 0;
+    TIM15->CR1 = TIM_CR1_CEN;
+    
+    TIM3->CNT = 0;
+    TIM3->CR1 = TIM_CR1_CEN;
+}
+
+uint32_t Time_Us(void)
+{
+    uint32_t hi, lo;
+    
+    /* An overflow between the reads shows as a changed high half; TIM15 follows
+     * TIM3's update within a few clocks, sooner than the second read */
+    do {
+        hi = TIM15->CNT;
+        lo = TIM3->CNT;
+    } while (hi != TIM15->CNT);
+    
+    return (hi << 16) | lo;
+}
+
+#endif /* BENCH_HOST */
@@ -0,0 +1,116 @@
+/**
+ * @file    topic_ns.c
+ * @brief   Per-device topic namespace and client ID, rendered once at boot
+ * @version 1.0
+ */
+
+#include "topic_ns.h"
+
+#if TOPIC_NS_ENABLE
+
+#include "main.h"
+#include "app.h"
+#include "config_store.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define FNV_OFFSET      2166136261U
+#define FNV_PRIME       16777619U
+
+char topic_ns_pool[TOPIC_NS_POOL];
+
+static char ns_id[TOPIC_NS_ID_MAX + 1];
+static char ns_client_id[sizeof(APP_MQTT_CLIENT_ID) + 1 + TOPIC_NS_ID_MAX];
+
+/* Suffixes and slots, in table order */
+#define TOPIC_NS_ENTRY(id, suffix)  { suffix, TOPIC_NS_##id },
+static const struct {
+    const char *suffix;
+    uint16_t offset;
+} ns_topics[] = {
+    TOPIC_NS_TABLE(TOPIC_NS_ENTRY)
+};
+#undef TOPIC_NS_ENTRY
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Check a stored id: 1 to TOPIC_NS_ID_MAX of [0-9A-Za-z_-], nothing a topic filter reads
+ */
+static bool ns_id_valid(const char *id)
+{
+    size_t len = strlen(id);
+    
+    if (len == 0 || len > TOPIC_NS_ID_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = id[i];
+        
+        if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+              c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 8 hex digits of FNV-1a over the 12 UID bytes
+ */
+static void ns_id_from_uid(char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint32_t words[3] = { HAL_GetUIDw0(), HAL_GetUIDw1(), HAL_GetUIDw2() };
+    uint32_t hash = FNV_OFFSET;
+    
+    for (uint8_t i = 0; i < 12; i++) {
+        hash ^= (uint8_t)(words[i / 4] >> (8 * (i % 4)));
+        hash *= FNV_PRIME;
+    }
+    for (uint8_t i = 0; i < 8; i++) {
+        out[i] = hex[(hash >> (28 - 4 * i)) & 0x0F];
+    }
+    out[8] = '\0';
+}
+
+/* ==================== Public Functions ==================== */
+
+void TopicNs_Init(void)
+{
+    const char *stored = ConfigStore_GetText(CONFIG_DEVICE_ID);
+    size_t prefix, id_len;
+    
+    if (stored != NULL && ns_id_valid(stored)) {
+        strcpy(ns_id, stored);
+    } else {
+        ns_id_from_uid(ns_id);
+    }
+    id_len = strlen(ns_id);
+    
+    /* TOPIC_NS_ROOT "<id>/" ahead of each suffix */
+    prefix = sizeof(TOPIC_NS_ROOT) - 1;
+    for (uint8_t i = 0; i < sizeof(ns_topics) / sizeof(ns_topics[0]); i++) {
+        char *topic = &topic_ns_pool[ns_topics[i].offset];
+        
+        memcpy(topic, TOPIC_NS_ROOT, prefix);
+        memcpy(&topic[prefix], ns_id, id_len);
+        topic[prefix + id_len] = '/';
+        strcpy(&topic[prefix + id_len + 1], ns_topics[i].suffix);
+    }
+    
+    memcpy(ns_client_id, APP_MQTT_CLIENT_ID "-", sizeof(APP_MQTT_CLIENT_ID));
+    memcpy(&ns_client_id[sizeof(APP_MQTT_CLIENT_ID)], ns_id, id_len + 1);
+}
+
+const char *TopicNs_Id(void)
+{
+    return ns_id;
+}
+
+const char *TopicNs_ClientId(void)
+{
+    return ns_client_id;
+}
+
+#endif /* TOPIC_NS_ENABLE */
@@ -2,86 +2,976 @@
  * @file    uart_dma.c
  * @brief   UART DMA Library Implementation
  * @author  Auto-generated
- * @version 1.2 - No ring buffer, simple DMA TX
+ * @version 2.12 - RX stamps, TX drain and waits on the microsecond clock (timebase.h)
  */
 
 #include "uart_dma.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "ramfunc.h"
+#include "timebase.h"
 #include <string.h>
 
+/* Ring masks (sizes are validated as powers of two in UART_DMA_Init) */
+#define RX_MASK(h)      ((h)->rx_size - 1)
+#define TX_MASK(h)      ((h)->tx_size - 1)
+
+#if UART_DMA_FRAMING
+/* Piece of a framed zero-copy write on DMA */
+#define ZC_DATA         0       /* A slice of the caller's buffer */
+#define ZC_GLUE         1       /* Tail of one frame, head of the next */
+#define ZC_END          2       /* Tail of the last frame */
+#endif
+
+#if UART_DMA_LL
+/* USART errors the ISR counts - circular RX DMA runs on through them */
+#define UART_ERR_FLAGS  (UART_FLAG_PE | UART_FLAG_FE | UART_FLAG_NE | UART_FLAG_ORE)
+#define UART_ERR_CLEAR  (UART_CLEAR_PEF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_OREF)
+#define TX_DRAIN_CHARS  3       /* Character times TC is waited for: shift and data register, one spare */
+
+/**
+ * @brief Point a channel set up by HAL_DMA_Init (MSP) at a buffer and start it
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static void dma_start(DMA_HandleTypeDef *hdma, const uint8_t *buf, size_t len)
+{
+    __HAL_DMA_DISABLE(hdma);
+    hdma->DmaBaseAddress->IFCR = DMA_IFCR_CGIF1 << hdma->ChannelIndex;
+    hdma->Instance->CMAR = (uintptr_t)buf;
+    hdma->Instance->CNDTR = (uint32_t)len;
+    __HAL_DMA_ENABLE(hdma);
+}
+
+/**
+ * @brief Core cycles since a SysTick reading - the counter reloads every
+ *        millisecond, far longer than a handler runs
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static uint32_t irq_cycles(uint32_t start)
+{
+    uint32_t now = SysTick->VAL;
+    
+    return (start >= now) ? start - now : start + SysTick->LOAD + 1U - now;
+}
+
+/**
+ * @brief Book an RX DMA handler entry: bytes past the point it was raised at
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static void irq_rx_late(UART_DMA_Handle_t *handle, size_t point)
+{
+    uint32_t late = (uint32_t)((UART_DMA_GetDMAPos(handle) - point) & RX_MASK(handle));
+    
+    if (late > handle->irq.rx_late) {
+        handle->irq.rx_late = late;
+    }
+}
+#endif
+
+/**
+ * @brief Hand a span to the TX DMA
+ * @return false if it could not start (data stays queued)
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static bool tx_dma(UART_DMA_Handle_t *handle, const uint8_t *buf, size_t len)
+{
+#if UART_DMA_LL
+    dma_start(handle->huart->hdmatx, buf, len);
+    return true;
+#else
+    return (HAL_UART_Transmit_DMA(handle->huart, buf, (uint16_t)len) == HAL_OK);
+#endif
+}
+
+/**
+ * @brief Wait for the last bytes handed to the USART to leave the line
+ * @note  The register-level path completes a transfer at DMA TC, up to two
+ *        characters before the line is quiet; HAL completes at USART TC
+ */
+static void tx_drain(UART_DMA_Handle_t *handle)
+{
+#if UART_DMA_LL
+    Timeout_t drain;
+    
+    Timeout_Start(&drain, TX_DRAIN_CHARS * 10U * 1000000U / UART_DMA_GetBaudRate(handle));
+    while (!__HAL_UART_GET_FLAG(handle->huart, UART_FLAG_TC) && !Timeout_Expired(&drain)) {
+    }
+#else
+    (void)handle;
+#endif
+}
+
+#if UART_DMA_FRAMING
+/**
+ * @brief Next piece of a framed zero-copy write: a slice of the buffer or the frame bytes around it
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static const uint8_t *zc_piece(UART_DMA_Handle_t *handle, size_t *len)
+{
+    size_t left = handle->zc_len - handle->zc_off;
+    
+    if (handle->zc_stage == ZC_GLUE) {
+        if (left > handle->zc_slice) {
+            *len = handle->zc_glue_len;
+            return handle->zc_glue;
+        }
+        *len = handle->zc_glue_last_len;
+        return handle->zc_glue_last;
+    }
+    if (handle->zc_stage == ZC_END) {
+        *len = handle->zc_end_len;
+        return handle->zc_end;
+    }
+    *len = (handle->zc_slice != 0 && left > handle->zc_slice) ? handle->zc_slice : left;
+    return &handle->zc_buf[handle->zc_off];
+}
+
+/**
+ * @brief Move past the piece just sent
+ * @return true if more of the write follows
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static bool zc_more(UART_DMA_Handle_t *handle)
+{
+    if (handle->zc_stage == ZC_DATA) {
+        handle->zc_off += handle->tx_dma_len;
+        if (handle->zc_slice == 0) {
+            return false;
+        }
+        handle->zc_stage = (handle->zc_off < handle->zc_len) ? ZC_GLUE : ZC_END;
+        return true;
+    }
+    if (handle->zc_stage == ZC_GLUE) {
+        handle->zc_stage = ZC_DATA;
+        return true;
+    }
+    return false;
+}
+#endif
+
+/**
+ * @brief Start DMA on the next contiguous span of the TX ring
+ * @note  Must run from the TX complete ISR or with interrupts masked
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static void tx_start_next(UART_DMA_Handle_t *handle)
+{
+    size_t pending = handle->tx_head - handle->tx_tail;
+    
+    if (handle->zc_buf != NULL) {
+        size_t before_zc = handle->zc_pos - handle->tx_tail;
+        
+        if (before_zc == 0) {
+            /* Ring caught up with the ordering point - send caller buffer */
+#if UART_DMA_FRAMING
+            size_t len;
+            const uint8_t *buf = zc_piece(handle, &len);
+            
+            handle->tx_dma_len = (handle->zc_stage == ZC_DATA) ? len : 0;
+#else
+            const uint8_t *buf = handle->zc_buf;
+            size_t len = handle->zc_len;
+            
+            handle->tx_dma_len = 0;
+#endif
+            handle->zc_active = true;
+            handle->tx_busy = true;
+            if (!tx_dma(handle, buf, len)) {
+                handle->zc_active = false;
+                handle->tx_busy = false;
+            }
+            return;
+        }
+        
+        /* Bytes queued after the zero-copy buffer must wait for it */
+        pending = before_zc;
+    }
+    
+    if (pending == 0) {
+        handle->tx_dma_len = 0;
+        handle->tx_busy = false;
+        return;
+    }
+    
+    /* Send up to the end of the ring; the wrapped part follows on next TC */
+    size_t offset = handle->tx_tail & TX_MASK(handle);
+    size_t span = handle->tx_size - offset;
+    if (span > pending) {
+        span = pending;
+    }
+    
+    handle->tx_dma_len = span;
+    handle->tx_busy = true;
+    
+    if (!tx_dma(handle, &handle->tx_buffer[offset], span)) {
+        /* UART busy elsewhere - data stays queued, next Transmit retries */
+        handle->tx_dma_len = 0;
+        handle->tx_busy = false;
+    }
+}
+
 /**
  * @brief Get current DMA write position
  */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
 size_t UART_DMA_GetDMAPos(UART_DMA_Handle_t *handle)
 {
-    /* DMA Counter decreases, so position = SIZE - Counter */
-    return UART_DMA_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(handle->huart->hdmarx);
+    /* DMA Counter decreases, so position = SIZE - Counter (masked in case
+     * the counter is sampled at 0 just before circular reload) */
+    return (handle->rx_size - __HAL_DMA_GET_COUNTER(handle->huart->hdmarx)) & RX_MASK(handle);
 }
 
-HAL_StatusTypeDef UART_DMA_Init(UART_DMA_Handle_t *handle, UART_HandleTypeDef *huart)
+/**
+ * @brief Set or clear an RTS hold reason; the pin follows whether any is set
+ * @note  Main loop and ISR - the read-modify-write runs with interrupts off
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static void rts_set(UART_DMA_Handle_t *handle, uint8_t reason, bool hold)
 {
-    HAL_StatusTypeDef status;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t was = handle->rts_hold;
+    uint8_t now = hold ? (uint8_t)(was | reason) : (uint8_t)(was & ~reason);
+    
+    handle->rts_hold = now;
+    if ((was == 0) != (now == 0)) {
+        handle->rts_port->BSRR = (now != 0) ? handle->rts_pin : (uint32_t)handle->rts_pin << 16;
+        if (now != 0) {
+            METRIC_INC(handle->rts_raises);
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief RTS against the watermarks for unread bytes
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static void rts_check(UART_DMA_Handle_t *handle, size_t unread)
+{
+    bool held = (handle->rts_hold & UART_DMA_RTS_RING) != 0;
+    
+    if (handle->rts_port == NULL) {
+        return;
+    }
+    if (!held && unread >= handle->rts_high) {
+        rts_set(handle, UART_DMA_RTS_RING, true);
+    } else if (held && unread <= handle->rts_low) {
+        rts_set(handle, UART_DMA_RTS_RING, false);
+    }
+}
+
+/**
+ * @brief Latch an RX event and account bytes written by DMA since the last one
+ * @note  Called from ISR context only
+ */
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+static void rx_signal(UART_DMA_Handle_t *handle, uint8_t event)
+{
+    size_t pos = UART_DMA_GetDMAPos(handle);
+    
+    size_t delta = (pos - handle->rx_event_pos) & RX_MASK(handle);
+    
+    handle->rx_event_bytes += delta;
+    handle->rx_write_total += delta;
+    handle->rx_event_pos = pos;
+    handle->rx_events |= event;
+    
+    if (delta > 0) {
+        handle->stamp_total[handle->stamp_head] = handle->rx_write_total;
+        handle->stamp_us[handle->stamp_head] = Time_Us();
+        handle->stamp_head = (uint8_t)((handle->stamp_head + 1) % UART_DMA_RX_STAMPS);
+    }
+    rts_check(handle, handle->rx_write_total - handle->rx_read_total);
+    if (handle->event_hook != NULL) {
+        handle->event_hook(handle->event_ctx, event);
+    }
+}
+
+/**
+ * @brief Free-running count of bytes written by DMA, sampled now
+ * @param pos Receives the DMA position the count refers to
+ */
+static size_t rx_written(UART_DMA_Handle_t *handle, size_t *pos)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *pos = UART_DMA_GetDMAPos(handle);
+    size_t written = handle->rx_write_total + ((*pos - handle->rx_event_pos) & RX_MASK(handle));
+    __set_PRIMASK(primask);
+    
+    return written;
+}
+
+/**
+ * @brief Detect DMA lapping the reader and resync to the write position
+ * @note  HT/TC events bound the gap between rx_event_pos updates to half
+ *        the ring, so the masked delta below never aliases.
+ */
+static void rx_check_overrun(UART_DMA_Handle_t *handle)
+{
+    size_t pos;
+    size_t written = rx_written(handle, &pos);
+    
+    size_t unread = written - handle->rx_read_total;
+    if (unread >= handle->rx_size) {
+        /* Oldest unread data already overwritten - drop it all */
+        METRIC_INC_SHARED(handle->overrun_events);     /* Main loop and RX error interrupt */
+        METRIC_ADD_SHARED(handle->overrun_bytes, unread);
+        handle->rx_read_pos = pos;
+        handle->rx_read_total = written;
+    }
+}
+
+static HAL_StatusTypeDef rx_arm(UART_DMA_Handle_t *handle);
+#if UART_DMA_LL
+static void rx_restart(UART_DMA_Handle_t *handle);
+#endif
+
+/**
+ * @brief (Re)start circular RX DMA from the start of the ring
+ * @note  Unread data is discarded; statistics are kept
+ */
+static HAL_StatusTypeDef rx_start(UART_DMA_Handle_t *handle)
+{
+    handle->rx_read_pos = 0;
+    handle->rx_events = 0;
+    handle->rx_event_pos = 0;
+    handle->rx_event_bytes = 0;
+    handle->rx_write_total = 0;
+    handle->rx_read_total = 0;
+    handle->burst_end_total = 0;
+    memset((void *)handle->stamp_total, 0, sizeof(handle->stamp_total));
+    memset((void *)handle->stamp_us, 0, sizeof(handle->stamp_us));
+    handle->stamp_head = 0;
+    handle->chunk_total = 0;
+    
+    return rx_arm(handle);
+}
+
+/**
+ * @brief Enable RX interrupts and start circular DMA at ring index 0
+ */
+static HAL_StatusTypeDef rx_arm(UART_DMA_Handle_t *handle)
+{
+#if UART_DMA_LL
+    UART_HandleTypeDef *huart = handle->huart;
+#endif
+    
+    /* Enable IDLE interrupt (and character match if armed - ADD is kept in CR2) */
+    __HAL_UART_ENABLE_IT(handle->huart, UART_IT_IDLE);
+    if (handle->line_match) {
+        __HAL_UART_CLEAR_FLAG(handle->huart, UART_CLEAR_CMF);
+        __HAL_UART_ENABLE_IT(handle->huart, UART_IT_CM);
+    }
+    if (handle->rx_timeout) {
+        __HAL_UART_CLEAR_FLAG(handle->huart, UART_CLEAR_RTOF);
+        __HAL_UART_ENABLE_IT(handle->huart, UART_IT_RTO);
+    }
+    
+#if UART_DMA_LL
+    /* Circular mode is the channel's (MSP); errors interrupt but never stop it */
+    huart->hdmarx->Instance->CPAR = (uintptr_t)&huart->Instance->RDR;
+    SET_BIT(huart->hdmarx->Instance->CCR, DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_TEIE);
+    dma_start(huart->hdmarx, handle->rx_buffer, handle->rx_size);
+    __HAL_UART_CLEAR_FLAG(huart, UART_ERR_CLEAR);
+    SET_BIT(huart->Instance->CR3, USART_CR3_EIE | USART_CR3_DMAR);
+    return HAL_OK;
+#else
+    /* Start DMA reception in circular mode */
+    return HAL_UART_Receive_DMA(handle->huart, handle->rx_buffer, handle->rx_size);
+#endif
+}
+
+#if UART_DMA_LL
+/**
+ * @brief Stop circular RX before the USART is set up again
+ */
+static void rx_stop(UART_DMA_Handle_t *handle)
+{
+    CLEAR_BIT(handle->huart->Instance->CR3, USART_CR3_DMAR);
+    __HAL_DMA_DISABLE(handle->huart->hdmarx);
+}
+
+/**
+ * @brief Point the TX channel at the USART and enable its interrupts (spans start in tx_dma)
+ */
+static void tx_arm(UART_DMA_Handle_t *handle)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    
+    __HAL_DMA_DISABLE(huart->hdmatx);
+    huart->hdmatx->Instance->CPAR = (uintptr_t)&huart->Instance->TDR;
+    SET_BIT(huart->hdmatx->Instance->CCR, DMA_CCR_TCIE | DMA_CCR_TEIE);
+    SET_BIT(huart->Instance->CR3, USART_CR3_DMAT);
+}
+#endif
+
+HAL_StatusTypeDef UART_DMA_Init(UART_DMA_Handle_t *handle, UART_HandleTypeDef *huart,
+                                uint8_t *rx_buf, size_t rx_size,
+                                uint8_t *tx_buf, size_t tx_size)
+{
+    if (rx_buf == NULL || tx_buf == NULL ||
+        !UART_DMA_IS_POW2(rx_size) || !UART_DMA_IS_POW2(tx_size) || rx_size > 0xFFFF) {
+        return HAL_ERROR;
+    }
     
-    /* Store UART handle */
+    /* Store UART handle and caller-owned storage */
     handle->huart = huart;
+    handle->rx_buffer = rx_buf;
+    handle->rx_size = rx_size;
+    handle->tx_buffer = tx_buf;
+    handle->tx_size = tx_size;
     
     /* Clear buffers */
-    memset(handle->rx_buffer, 0, UART_DMA_RX_BUFFER_SIZE);
-    memset(handle->tx_buffer, 0, UART_DMA_TX_BUFFER_SIZE);
+    memset(handle->rx_buffer, 0, handle->rx_size);
+    memset(handle->tx_buffer, 0, handle->tx_size);
     
-    /* Initialize state - read position starts at 0 */
-    handle->rx_read_pos = 0;
+    /* Initialize state - read position starts at 0 (set in rx_start) */
+    handle->overrun_events = 0;
+    handle->overrun_bytes = 0;
+    handle->tx_total = 0;
+    memset(&handle->errors, 0, sizeof(handle->errors));
+#if UART_DMA_LL
+    memset(&handle->irq, 0, sizeof(handle->irq));
+#endif
+    handle->line_match = false;
+    handle->rx_timeout = false;
+    handle->abr_request = false;
+    handle->tx_head = 0;
+    handle->tx_tail = 0;
+    handle->tx_dma_len = 0;
     handle->tx_busy = false;
+    handle->zc_buf = NULL;
+    handle->zc_len = 0;
+    handle->zc_pos = 0;
+    handle->zc_done = NULL;
+    handle->zc_ctx = NULL;
+    handle->zc_active = false;
+#if UART_DMA_FRAMING
+    handle->framer = NULL;
+    handle->zc_slice = 0;
+#endif
+    handle->event_hook = NULL;
+    handle->event_ctx = NULL;
+    handle->rts_port = NULL;
+    handle->rts_hold = 0;
+    handle->rts_raises = 0;
+#if UART_DMA_TAP
+    handle->tap = NULL;
+    handle->tap_ctx = NULL;
+#endif
+#if UART_DMA_LL
+    tx_arm(handle);
+#endif
+    
+    return rx_start(handle);
+}
+
+/**
+ * @brief Apply huart->Init changes and restart circular RX
+ */
+static HAL_StatusTypeDef reconfigure(UART_DMA_Handle_t *handle)
+{
+    HAL_StatusTypeDef status;
     
-    /* Enable IDLE interrupt */
-    __HAL_UART_ENABLE_IT(huart, UART_IT_IDLE);
+    tx_drain(handle);
+#if UART_DMA_LL
+    rx_stop(handle);
+#else
+    HAL_UART_AbortReceive(handle->huart);
+#endif
     
-    /* Start DMA reception in circular mode */
-    status = HAL_UART_Receive_DMA(huart, handle->rx_buffer, UART_DMA_RX_BUFFER_SIZE);
+    /* Re-run UART config only (MSP/GPIO/DMA links are kept) */
+    status = HAL_UART_Init(handle->huart);
+    if (status != HAL_OK) {
+        return status;
+    }
+    
+    return rx_start(handle);
+}
+
+HAL_StatusTypeDef UART_DMA_SetBaudRate(UART_DMA_Handle_t *handle, uint32_t baudrate)
+{
+    if (handle->tx_busy) {
+        /* Queued bytes must leave at the old rate first */
+        return HAL_BUSY;
+    }
+    
+    handle->huart->Init.BaudRate = baudrate;
+    return reconfigure(handle);
+}
+
+HAL_StatusTypeDef UART_DMA_SetFlowControl(UART_DMA_Handle_t *handle, bool enable)
+{
+    if (handle->tx_busy) {
+        return HAL_BUSY;
+    }
+    
+    handle->huart->Init.HwFlowCtl = enable ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+    return reconfigure(handle);
+}
+
+bool UART_DMA_IsFlowControlled(UART_DMA_Handle_t *handle)
+{
+    return (handle->huart->Init.HwFlowCtl == UART_HWCONTROL_RTS_CTS);
+}
+
+void UART_DMA_SetRts(UART_DMA_Handle_t *handle, GPIO_TypeDef *port, uint16_t pin, size_t high, size_t low)
+{
+    handle->rts_port = NULL;            /* No ISR check while the marks change */
+    handle->rts_pin = pin;
+    handle->rts_high = (uint16_t)high;
+    handle->rts_low = (uint16_t)low;
+    handle->rts_hold = 0;
+    if (port != NULL) {
+        port->BSRR = (uint32_t)pin << 16;
+        handle->rts_port = port;
+    }
+}
+
+void UART_DMA_HoldRts(UART_DMA_Handle_t *handle, uint8_t reason, bool hold)
+{
+    if (handle->rts_port != NULL) {
+        rts_set(handle, reason, hold);
+    }
+}
+
+uint32_t UART_DMA_GetRtsRaises(UART_DMA_Handle_t *handle)
+{
+    return handle->rts_raises;
+}
+
+void UART_DMA_EnableLineMatch(UART_DMA_Handle_t *handle, uint8_t match)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    
+    /* ADD may only be written with the USART disabled; DMA just pauses */
+    __HAL_UART_DISABLE(huart);
+    MODIFY_REG(huart->Instance->CR2, USART_CR2_ADD | USART_CR2_ADDM7,
+               ((uint32_t)match << USART_CR2_ADD_Pos) | USART_CR2_ADDM7);
+    __HAL_UART_ENABLE(huart);
+    
+    handle->line_match = true;
+    __HAL_UART_CLEAR_FLAG(huart, UART_CLEAR_CMF);
+    __HAL_UART_ENABLE_IT(huart, UART_IT_CM);
+}
+
+void UART_DMA_EnableRxTimeout(UART_DMA_Handle_t *handle, uint32_t bits)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    
+    MODIFY_REG(huart->Instance->RTOR, USART_RTOR_RTO, bits & USART_RTOR_RTO);
+    SET_BIT(huart->Instance->CR2, USART_CR2_RTOEN);
+    
+    handle->rx_timeout = true;
+    __HAL_UART_CLEAR_FLAG(huart, UART_CLEAR_RTOF);
+    __HAL_UART_ENABLE_IT(huart, UART_IT_RTO);
+}
+
+bool UART_DMA_RxBurstEnded(UART_DMA_Handle_t *handle)
+{
+    size_t pos;
+    
+    if (!handle->rx_timeout) {
+        return false;
+    }
+    return (rx_written(handle, &pos) == handle->burst_end_total);
+}
+
+uint32_t UART_DMA_RxArrivalUs(UART_DMA_Handle_t *handle, size_t offset)
+{
+    size_t target = handle->rx_read_total + offset;
+    uint32_t us = Time_Us();
+    uint32_t primask = __get_PRIMASK();
+    
+    /* Oldest stamp first - the first one past the byte saw it arrive */
+    __disable_irq();
+    for (uint8_t i = 0; i < UART_DMA_RX_STAMPS; i++) {
+        uint8_t slot = (uint8_t)((handle->stamp_head + i) % UART_DMA_RX_STAMPS);
+        
+        if ((ptrdiff_t)(handle->stamp_total[slot] - target) > 0) {   /* Wrap-safe "past" */
+            us = handle->stamp_us[slot];
+            break;
+        }
+    }
+    __set_PRIMASK(primask);
+    
+    return us;
+}
+
+uint32_t UART_DMA_RxArrivalTick(UART_DMA_Handle_t *handle, size_t offset)
+{
+    uint32_t age = Time_Us() - UART_DMA_RxArrivalUs(handle, offset);
+    
+    return HAL_GetTick() - age / 1000U;
+}
+
+bool UART_DMA_NextChunk(UART_DMA_Handle_t *handle, UART_DMA_Chunk_t *chunk)
+{
+    size_t start = handle->chunk_total;
+    
+    for (;;) {
+        bool found = false;
+        uint32_t primask = __get_PRIMASK();
+        
+        /* Oldest stamp past the last chunk closes the next one */
+        __disable_irq();
+        for (uint8_t i = 0; i < UART_DMA_RX_STAMPS; i++) {
+            uint8_t slot = (uint8_t)((handle->stamp_head + i) % UART_DMA_RX_STAMPS);
+            
+            if ((ptrdiff_t)(handle->stamp_total[slot] - start) > 0) {
+                chunk->end = handle->stamp_total[slot];
+                chunk->us = handle->stamp_us[slot];
+                found = true;
+                break;
+            }
+        }
+        __set_PRIMASK(primask);
+        
+        if (!found) {
+            return false;
+        }
+        handle->chunk_total = chunk->end;
+        if ((ptrdiff_t)(chunk->end - handle->rx_read_total) > 0) {
+            /* Bytes consumed or flushed meanwhile are not new */
+            chunk->start = ((ptrdiff_t)(handle->rx_read_total - start) > 0) ? handle->rx_read_total : start;
+            return true;
+        }
+        start = chunk->end;
+    }
+}
+
+uint32_t UART_DMA_GetBaudRate(UART_DMA_Handle_t *handle)
+{
+    return handle->huart->Init.BaudRate;
+}
+
+void UART_DMA_AutoBaudStart(UART_DMA_Handle_t *handle)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    
+    /* ABREN / ABRMOD may only be written with the USART disabled; DMA just pauses */
+    if (!READ_BIT(huart->Instance->CR2, USART_CR2_ABREN)) {
+        __HAL_UART_DISABLE(huart);
+        MODIFY_REG(huart->Instance->CR2, USART_CR2_ABRMODE, USART_CR2_ABREN);   /* Start bit measurement */
+        __HAL_UART_ENABLE(huart);
+    }
+    
+    /* Mid-frame the next falling edge may be a data bit: the request waits
+     * for the IDLE interrupt, after which the next edge is a start bit */
+    handle->abr_request = true;
+}
+
+uint32_t UART_DMA_AutoBaudResult(UART_DMA_Handle_t *handle)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    uint32_t brr = huart->Instance->BRR;
+    
+    if (handle->abr_request || !__HAL_UART_GET_FLAG(huart, UART_FLAG_ABRF)) {
+        return 0;
+    }
+    if (__HAL_UART_GET_FLAG(huart, UART_FLAG_ABRE) || brr < 16) {
+        handle->abr_request = true;
+        return 0;
+    }
+    
+    /* Oversampling by 16: BRR = f_ck / baud (USART1 runs from PCLK1) */
+    huart->Init.BaudRate = (HAL_RCC_GetPCLK1Freq() + brr / 2) / brr;
+    return huart->Init.BaudRate;
+}
+
+HAL_StatusTypeDef UART_DMA_RetuneBaudRate(UART_DMA_Handle_t *handle, uint32_t baudrate, bool detect)
+{
+    UART_HandleTypeDef *huart = handle->huart;
+    
+    if (handle->tx_busy) {
+        return HAL_BUSY;
+    }
+    
+    /* BRR may only be written with the USART disabled; DMA just pauses */
+    tx_drain(handle);
+    __HAL_UART_DISABLE(huart);
+    if (!detect) {
+        CLEAR_BIT(huart->Instance->CR2, USART_CR2_ABREN);
+        handle->abr_request = false;
+    }
+    huart->Instance->BRR = (HAL_RCC_GetPCLK1Freq() + baudrate / 2) / baudrate;
+    __HAL_UART_ENABLE(huart);
     
-    return status;
+    huart->Init.BaudRate = baudrate;
+    return HAL_OK;
 }
 
+RAMFUNC_IF(RAMFUNC_UART_ISR)
 void UART_DMA_IDLE_IRQHandler(UART_DMA_Handle_t *handle)
 {
+    PROF_BEGIN(PROF_UART_ISR);
+#if UART_DMA_LL
+    uint32_t irq_start = SysTick->VAL;
+#endif
+    
     if (__HAL_UART_GET_FLAG(handle->huart, UART_FLAG_IDLE)) {
         /* Clear IDLE flag by reading SR then DR */
         __HAL_UART_CLEAR_IDLEFLAG(handle->huart);
         
         /* IDLE detected - data is now available in rx_buffer */
-        /* No processing needed, just clear the flag */
+        rx_signal(handle, UART_DMA_EVT_IDLE);
+        
+        /* Line high for a character time: the next falling edge starts one */
+        if (handle->abr_request) {
+            handle->abr_request = false;
+            __HAL_UART_SEND_REQ(handle->huart, UART_AUTOBAUD_REQUEST);
+        }
+    }
+    
+    if (handle->line_match && __HAL_UART_GET_FLAG(handle->huart, UART_FLAG_CMF)) {
+        __HAL_UART_CLEAR_FLAG(handle->huart, UART_CLEAR_CMF);
+        
+        /* DMA serves RXNE long before this ISR runs, so the matched byte is
+         * already in the ring - everything up to the DMA position is whole lines */
+        rx_signal(handle, UART_DMA_EVT_LINE);
     }
+    
+    /* Cleared here, before HAL_UART_IRQHandler would treat RTOF as an
+     * error and abort the circular DMA */
+    if (handle->rx_timeout && __HAL_UART_GET_FLAG(handle->huart, UART_FLAG_RTOF)) {
+        __HAL_UART_CLEAR_FLAG(handle->huart, UART_CLEAR_RTOF);
+        
+        rx_signal(handle, UART_DMA_EVT_RTO);
+        handle->burst_end_total = handle->rx_write_total;
+    }
+
+#if UART_DMA_LL
+    /* Counted and cleared in one go - the DMA keeps receiving, nothing to restart */
+    uint32_t errors = handle->huart->Instance->ISR & UART_ERR_FLAGS;
+    
+    if (errors != 0) {
+        __HAL_UART_CLEAR_FLAG(handle->huart, UART_ERR_CLEAR);
+        if (errors & UART_FLAG_ORE) METRIC_INC(handle->errors.ore);
+        if (errors & UART_FLAG_FE)  METRIC_INC(handle->errors.fe);
+        if (errors & UART_FLAG_NE)  METRIC_INC(handle->errors.ne);
+        if (errors & UART_FLAG_PE)  METRIC_INC(handle->errors.pe);
+    }
+    
+    uint32_t cycles = irq_cycles(irq_start);
+    if (cycles > handle->irq.usart_cycles) {
+        handle->irq.usart_cycles = cycles;
+    }
+#endif
+    PROF_END(PROF_UART_ISR);
+}
+
+#if UART_DMA_LL
+RAMFUNC_IF(RAMFUNC_UART_ISR)
+void UART_DMA_DMA_IRQHandler(UART_DMA_Handle_t *handle)
+{
+    PROF_BEGIN(PROF_UART_ISR);
+    uint32_t irq_start = SysTick->VAL;
+    DMA_HandleTypeDef *rx = handle->huart->hdmarx;
+    DMA_HandleTypeDef *tx = handle->huart->hdmatx;
+    uint32_t flags = rx->DmaBaseAddress->ISR;       /* Both channels' flags in one read */
+    uint32_t points = (DMA_ISR_HTIF1 | DMA_ISR_TCIF1) << rx->ChannelIndex;
+    
+    /* Entry latency first: how far the DMA got past the point that raised this */
+    if ((flags & points) == points) {
+        handle->irq.rx_missed++;
+    } else if (flags & (DMA_ISR_HTIF1 << rx->ChannelIndex)) {
+        irq_rx_late(handle, handle->rx_size / 2);
+    } else if (flags & (DMA_ISR_TCIF1 << rx->ChannelIndex)) {
+        irq_rx_late(handle, 0);
+    }
+    
+    if (flags & (DMA_ISR_TEIF1 << rx->ChannelIndex)) {
+        /* The channel disabled itself - restart it, unread data kept */
+        rx->DmaBaseAddress->IFCR = DMA_IFCR_CGIF1 << rx->ChannelIndex;
+        METRIC_INC(handle->errors.dma);
+        rx_restart(handle);
+    } else {
+        if (flags & (DMA_ISR_HTIF1 << rx->ChannelIndex)) {
+            rx->DmaBaseAddress->IFCR = DMA_IFCR_CHTIF1 << rx->ChannelIndex;
+            rx_signal(handle, UART_DMA_EVT_HT);
+        }
+        if (flags & (DMA_ISR_TCIF1 << rx->ChannelIndex)) {
+            rx->DmaBaseAddress->IFCR = DMA_IFCR_CTCIF1 << rx->ChannelIndex;
+            rx_signal(handle, UART_DMA_EVT_TC);
+        }
+    }
+    
+    if (flags & ((DMA_ISR_TCIF1 | DMA_ISR_TEIF1) << tx->ChannelIndex)) {
+        tx->DmaBaseAddress->IFCR = DMA_IFCR_CGIF1 << tx->ChannelIndex;
+        if (flags & (DMA_ISR_TEIF1 << tx->ChannelIndex)) {
+            METRIC_INC(handle->errors.dma);       /* Span dropped, not retried */
+        }
+        /* The USART has the span's last byte: release it and chain the next at once */
+        UART_DMA_TxCplt_Callback(handle);
+    }
+    
+    uint32_t cycles = irq_cycles(irq_start);
+    if (cycles > handle->irq.dma_cycles) {
+        handle->irq.dma_cycles = cycles;
+    }
+    PROF_END(PROF_UART_ISR);
+}
+#endif
+
+void UART_DMA_RxHalfCplt_Callback(UART_DMA_Handle_t *handle)
+{
+    rx_signal(handle, UART_DMA_EVT_HT);
+}
+
+void UART_DMA_RxCplt_Callback(UART_DMA_Handle_t *handle)
+{
+    rx_signal(handle, UART_DMA_EVT_TC);
+}
+
+uint8_t UART_DMA_GetEvents(UART_DMA_Handle_t *handle, size_t *rx_bytes)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t events = handle->rx_events;
+    size_t bytes = handle->rx_event_bytes;
+    handle->rx_events = 0;
+    handle->rx_event_bytes = 0;
+    __set_PRIMASK(primask);
+    
+    if (rx_bytes != NULL) {
+        *rx_bytes = bytes;
+    }
+    return events;
+}
+
+bool UART_DMA_HasEvents(const UART_DMA_Handle_t *handle)
+{
+    return (handle->rx_events != 0);
+}
+
+#if UART_DMA_TAP
+void UART_DMA_SetTap(UART_DMA_Handle_t *handle, UART_DMA_TapFn_t tap, void *ctx)
+{
+    handle->tap = tap;
+    handle->tap_ctx = ctx;
+}
+#endif
+
+#if UART_DMA_FRAMING
+void UART_DMA_SetFramer(UART_DMA_Handle_t *handle, UART_DMA_FrameFn_t fn, void *ctx, size_t max)
+{
+    handle->framer = fn;
+    handle->frame_ctx = ctx;
+    handle->frame_max = max;
+}
+#endif
+
+void UART_DMA_SetEventHook(UART_DMA_Handle_t *handle, UART_DMA_EventFn_t hook, void *ctx)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    handle->event_hook = hook;
+    handle->event_ctx = ctx;
+    __set_PRIMASK(primask);
+}
+
+bool UART_DMA_WaitEvent(UART_DMA_Handle_t *handle, uint32_t timeout_ms)
+{
+    Timeout_t wait;
+    
+    Timeout_Start(&wait, TIME_MS(timeout_ms));
+    /* SysTick wakes the core every 1 ms, so the timeout is always honoured */
+    while (handle->rx_events == 0) {
+        if (Timeout_Expired(&wait)) {
+            return false;
+        }
+        __WFI();
+    }
+    
+    UART_DMA_GetEvents(handle, NULL);
+    return true;
 }
 
 size_t UART_DMA_Available(UART_DMA_Handle_t *handle)
 {
+    rx_check_overrun(handle);
+    
     size_t dma_pos = UART_DMA_GetDMAPos(handle);
     size_t read_pos = handle->rx_read_pos;
+    size_t unread = (dma_pos - read_pos) & RX_MASK(handle);
     
-    if (dma_pos >= read_pos) {
-        return dma_pos - read_pos;
-    } else {
-        /* Wrap around case */
-        return UART_DMA_RX_BUFFER_SIZE - read_pos + dma_pos;
+    rts_check(handle, unread);
+    return unread;
+}
+
+/**
+ * @brief Lower RTS once the reader is back down to the low-water mark
+ */
+static void rts_consumed(UART_DMA_Handle_t *handle)
+{
+    if (handle->rts_hold & UART_DMA_RTS_RING) {
+        (void)UART_DMA_Available(handle);   /* Checks the watermarks */
     }
 }
 
 size_t UART_DMA_Read(UART_DMA_Handle_t *handle, uint8_t *data, size_t len)
 {
-    size_t available = UART_DMA_Available(handle);
+    PROF_BEGIN(PROF_UART_READ);
+    UART_DMA_Span_t s1, s2;
+    size_t available = UART_DMA_Peek(handle, &s1, &s2);
     size_t to_read = (len < available) ? len : available;
-    size_t read_count = 0;
-    size_t read_pos = handle->rx_read_pos;
     
-    for (size_t i = 0; i < to_read; i++) {
-        data[i] = handle->rx_buffer[read_pos];
-        read_pos = (read_pos + 1) % UART_DMA_RX_BUFFER_SIZE;
-        read_count++;
+    /* At most two block copies: tail of ring, then wrapped head */
+    size_t first = (to_read < s1.len) ? to_read : s1.len;
+    memcpy(data, s1.data, first);
+    if (to_read > first) {
+        memcpy(&data[first], s2.data, to_read - first);
     }
     
     /* Update read position */
-    handle->rx_read_pos = read_pos;
+    handle->rx_read_pos = (handle->rx_read_pos + to_read) & RX_MASK(handle);
+    handle->rx_read_total += to_read;
+    rts_consumed(handle);
+#if UART_DMA_TAP
+    if (handle->tap != NULL && to_read > 0) {
+        handle->tap(handle->tap_ctx, false, data, to_read);
+    }
+#endif
+    
+    PROF_END(PROF_UART_READ);
+    return to_read;
+}
+
+size_t UART_DMA_Peek(UART_DMA_Handle_t *handle, UART_DMA_Span_t *span1, UART_DMA_Span_t *span2)
+{
+    rx_check_overrun(handle);
+    
+    size_t dma_pos = UART_DMA_GetDMAPos(handle);
+    size_t read_pos = handle->rx_read_pos;
+    
+    span1->data = &handle->rx_buffer[read_pos];
+    
+    if (dma_pos >= read_pos) {
+        span1->len = dma_pos - read_pos;
+        span2->data = handle->rx_buffer;
+        span2->len = 0;
+    } else {
+        /* Wrap around case - tail of ring, then head */
+        span1->len = handle->rx_size - read_pos;
+        span2->data = handle->rx_buffer;
+        span2->len = dma_pos;
+    }
     
-    return read_count;
+    return span1->len + span2->len;
+}
+
+void UART_DMA_Consume(UART_DMA_Handle_t *handle, size_t len)
+{
+    size_t available = UART_DMA_Available(handle);
+    if (len > available) {
+        len = available;
+    }
+    
+    handle->rx_read_pos = (handle->rx_read_pos + len) & RX_MASK(handle);
+    handle->rx_read_total += len;
+    rts_consumed(handle);
 }
 
 bool UART_DMA_ReadByte(UART_DMA_Handle_t *handle, uint8_t *data)
@@ -91,15 +981,76 @@ bool UART_DMA_ReadByte(UART_DMA_Handle_t *handle, uint8_t *data)
     }
     
     *data = handle->rx_buffer[handle->rx_read_pos];
-    handle->rx_read_pos = (handle->rx_read_pos + 1) % UART_DMA_RX_BUFFER_SIZE;
+    handle->rx_read_pos = (handle->rx_read_pos + 1) & RX_MASK(handle);
+    handle->rx_read_total++;
+    rts_consumed(handle);
     
     return true;
 }
 
+RAMFUNC_IF(RAMFUNC_UART_ISR)
 void UART_DMA_TxCplt_Callback(UART_DMA_Handle_t *handle)
 {
-    /* TX complete - mark as idle */
-    handle->tx_busy = false;
+    if (handle->zc_active) {
+        UART_DMA_TxDoneCallback_t done = handle->zc_done;
+        void *ctx = handle->zc_ctx;
+        
+        handle->zc_active = false;
+#if UART_DMA_FRAMING
+        if (zc_more(handle)) {
+            /* Frame bytes or the next slice */
+            tx_start_next(handle);
+            return;
+        }
+#endif
+        /* Caller buffer released - free the slot before notifying */
+        handle->zc_buf = NULL;
+        if (done != NULL) {
+            done(ctx);
+        }
+    } else {
+        /* Release the finished span */
+        handle->tx_tail += handle->tx_dma_len;
+    }
+    
+    /* Chain the next one */
+    tx_start_next(handle);
+}
+
+/**
+ * @brief Copy bytes into TX ring at head (caller checked space)
+ */
+static size_t tx_copy_in(UART_DMA_Handle_t *handle, size_t head, const uint8_t *data, size_t len)
+{
+    /* Copy into ring, split in two if it wraps */
+    size_t offset = head & TX_MASK(handle);
+    size_t first = handle->tx_size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&handle->tx_buffer[offset], data, first);
+    if (len > first) {
+        memcpy(handle->tx_buffer, &data[first], len - first);
+    }
+    return head + len;
+}
+
+/**
+ * @brief Publish new head and kick DMA if idle
+ */
+static void tx_commit(UART_DMA_Handle_t *handle, size_t head)
+{
+    /* Publish new head only after data is in place */
+    handle->tx_total += (uint32_t)(head - handle->tx_head);
+    handle->tx_head = head;
+    
+    /* Kick DMA if idle - masked so the TC ISR cannot race the restart */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!handle->tx_busy) {
+        tx_start_next(handle);
+    }
+    __set_PRIMASK(primask);
 }
 
 HAL_StatusTypeDef UART_DMA_Transmit(UART_DMA_Handle_t *handle, const uint8_t *data, size_t len)
@@ -107,27 +1058,143 @@ HAL_StatusTypeDef UART_DMA_Transmit(UART_DMA_Handle_t *handle, const uint8_t *da
     if (len == 0) {
         return HAL_OK;
     }
+#if UART_DMA_FRAMING
+    if (handle->framer != NULL) {
+        UART_DMA_Span_t span = { data, len };
+        
+        return UART_DMA_TransmitV(handle, &span, 1);
+    }
+#endif
     
-    if (handle->tx_busy) {
-        /* TX in progress - return busy */
+    if (len > UART_DMA_TxFree(handle)) {
+        /* Not enough room - never enqueue a partial frame */
         return HAL_BUSY;
     }
     
-    /* Limit to buffer size */
-    size_t to_send = (len > UART_DMA_TX_BUFFER_SIZE) ? UART_DMA_TX_BUFFER_SIZE : len;
+#if UART_DMA_TAP
+    if (handle->tap != NULL) {
+        handle->tap(handle->tap_ctx, true, data, len);
+    }
+#endif
+    tx_commit(handle, tx_copy_in(handle, handle->tx_head, data, len));
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef UART_DMA_TransmitV(UART_DMA_Handle_t *handle, const UART_DMA_Span_t *iov, size_t count)
+{
+    size_t total = 0;
     
-    /* Copy data to TX buffer */
-    memcpy(handle->tx_buffer, data, to_send);
+    for (size_t i = 0; i < count; i++) {
+        total += iov[i].len;
+    }
+    if (total == 0) {
+        return HAL_OK;
+    }
+#if UART_DMA_FRAMING
+    UART_DMA_Frame_t frame;
     
-    /* Start transmission */
-    handle->tx_busy = true;
-    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(handle->huart, handle->tx_buffer, to_send);
+    /* The whole write in one frame */
+    if (handle->framer == NULL || !handle->framer(handle->frame_ctx, total, &frame)) {
+        frame.head_len = 0;
+        frame.tail_len = 0;
+    }
+    if (total + frame.head_len + frame.tail_len > UART_DMA_TxFree(handle)) {
+        return HAL_BUSY;
+    }
     
-    if (status != HAL_OK) {
-        handle->tx_busy = false;
+    size_t head = tx_copy_in(handle, handle->tx_head, frame.head, frame.head_len);
+#else
+    if (total > UART_DMA_TxFree(handle)) {
+        return HAL_BUSY;
     }
     
-    return status;
+    size_t head = handle->tx_head;
+#endif
+    for (size_t i = 0; i < count; i++) {
+    #if UART_DMA_TAP
+        if (handle->tap != NULL && iov[i].len > 0) {
+            handle->tap(handle->tap_ctx, true, iov[i].data, iov[i].len);
+        }
+    #endif
+        head = tx_copy_in(handle, head, iov[i].data, iov[i].len);
+    }
+#if UART_DMA_FRAMING
+    head = tx_copy_in(handle, head, frame.tail, frame.tail_len);
+#endif
+    tx_commit(handle, head);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef UART_DMA_TransmitZC(UART_DMA_Handle_t *handle, const uint8_t *buf, size_t len,
+                                      UART_DMA_TxDoneCallback_t done_cb, void *ctx)
+{
+    if (buf == NULL || len == 0 || len > 0xFFFF) {
+        return HAL_ERROR;
+    }
+#if UART_DMA_FRAMING
+    UART_DMA_Frame_t mid, last;
+    size_t slice = 0;
+    
+    /* Full slices of frame_max, the rest in the last frame */
+    if (handle->framer != NULL &&
+        handle->framer(handle->frame_ctx, len - (len - 1) / handle->frame_max * handle->frame_max, &last)) {
+        slice = handle->frame_max;
+        mid = last;
+        if (len > slice) {
+            handle->framer(handle->frame_ctx, slice, &mid);
+        }
+    }
+#endif
+    
+    /* Slot is shared with the TC ISR - fill it with IRQs masked */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+#if UART_DMA_FRAMING
+    if (handle->zc_buf != NULL || (slice != 0 && mid.head_len > UART_DMA_TxFree(handle))) {
+        __set_PRIMASK(primask);
+        return HAL_BUSY;
+    }
+    if (slice != 0) {
+        /* First head through the ring, the rest of the frame bytes from the ISR */
+        handle->tx_head = tx_copy_in(handle, handle->tx_head, mid.head, mid.head_len);
+        handle->tx_total += mid.head_len;
+        memcpy(handle->zc_glue, mid.tail, mid.tail_len);
+        memcpy(&handle->zc_glue[mid.tail_len], mid.head, mid.head_len);
+        handle->zc_glue_len = (uint8_t)(mid.tail_len + mid.head_len);
+        memcpy(handle->zc_glue_last, mid.tail, mid.tail_len);
+        memcpy(&handle->zc_glue_last[mid.tail_len], last.head, last.head_len);
+        handle->zc_glue_last_len = (uint8_t)(mid.tail_len + last.head_len);
+        memcpy(handle->zc_end, last.tail, last.tail_len);
+        handle->zc_end_len = last.tail_len;
+    }
+    handle->zc_slice = slice;
+    handle->zc_off = 0;
+    handle->zc_stage = ZC_DATA;
+#else
+    if (handle->zc_buf != NULL) {
+        __set_PRIMASK(primask);
+        return HAL_BUSY;
+    }
+#endif
+    
+    handle->zc_buf = buf;
+    handle->zc_len = len;
+    handle->zc_done = done_cb;
+    handle->zc_ctx = ctx;
+    handle->zc_pos = handle->tx_head;
+    handle->tx_total += (uint32_t)len;
+    
+    if (!handle->tx_busy) {
+        tx_start_next(handle);
+    }
+    __set_PRIMASK(primask);
+#if UART_DMA_TAP
+    /* buf stays the caller's until it returns, even if the transfer is done already */
+    if (handle->tap != NULL) {
+        handle->tap(handle->tap_ctx, true, buf, len);
+    }
+#endif
+    return HAL_OK;
 }
 
 HAL_StatusTypeDef UART_DMA_TransmitString(UART_DMA_Handle_t *handle, const char *str)
@@ -140,8 +1207,176 @@ bool UART_DMA_IsTxBusy(UART_DMA_Handle_t *handle)
     return handle->tx_busy;
 }
 
+size_t UART_DMA_TxFree(UART_DMA_Handle_t *handle)
+{
+    return handle->tx_size - (handle->tx_head - handle->tx_tail);
+}
+
+/**
+ * @brief Run the caller's hook, or sleep until the next interrupt
+ */
+static void tx_wait_step(UART_DMA_YieldFn_t yield, void *ctx)
+{
+    if (yield != NULL) {
+        yield(ctx);
+    } else {
+        __WFI();
+    }
+}
+
+HAL_StatusTypeDef UART_DMA_WaitTxFree(UART_DMA_Handle_t *handle, size_t len, uint32_t timeout_ms,
+                                      UART_DMA_YieldFn_t yield, void *ctx)
+{
+    Timeout_t wait;
+    
+    Timeout_Start(&wait, TIME_MS(timeout_ms));
+#if UART_DMA_FRAMING
+    if (handle->framer != NULL) {
+        len += UART_DMA_FRAME_HEAD + UART_DMA_FRAME_TAIL;
+        if (len > handle->tx_size) {
+            len = handle->tx_size;
+        }
+    }
+#endif
+    while (UART_DMA_TxFree(handle) < len) {
+        if (Timeout_Expired(&wait)) {
+            return HAL_TIMEOUT;
+        }
+        tx_wait_step(yield, ctx);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef UART_DMA_WaitTxIdle(UART_DMA_Handle_t *handle, uint32_t timeout_ms,
+                                      UART_DMA_YieldFn_t yield, void *ctx)
+{
+    Timeout_t wait;
+    
+    Timeout_Start(&wait, TIME_MS(timeout_ms));
+    while (handle->tx_busy || handle->zc_buf != NULL) {
+        if (Timeout_Expired(&wait)) {
+            return HAL_TIMEOUT;
+        }
+        tx_wait_step(yield, ctx);
+    }
+    tx_drain(handle);
+    return HAL_OK;
+}
+
+void UART_DMA_GetOverrun(UART_DMA_Handle_t *handle, uint32_t *events, uint32_t *bytes)
+{
+    rx_check_overrun(handle);
+    
+    if (events != NULL) {
+        *events = handle->overrun_events;
+    }
+    if (bytes != NULL) {
+        *bytes = handle->overrun_bytes;
+    }
+}
+
+/**
+ * @brief Reverse ring bytes [from, to) in place
+ */
+static void rx_reverse(uint8_t *buf, size_t from, size_t to)
+{
+    while (from + 1 < to) {
+        uint8_t b = buf[from];
+        buf[from++] = buf[--to];
+        buf[to] = b;
+    }
+}
+
+/**
+ * @brief Restart circular RX after HAL aborted it (or a DMA transfer error stopped it), keeping unread data
+ * @note  DMA can only restart at index 0, so unread bytes are moved to the
+ *        end of the ring; the reader then wraps straight into the new data.
+ *        Free-running totals are unchanged, so boundaries stay valid.
+ */
+static void rx_restart(UART_DMA_Handle_t *handle)
+{
+    size_t pos;
+    size_t written = rx_written(handle, &pos);
+    size_t unread = written - handle->rx_read_total;
+    size_t read_pos = handle->rx_read_pos;
+    size_t size = handle->rx_size;
+    
+    if (unread >= size) {
+        METRIC_INC_SHARED(handle->overrun_events);
+        METRIC_ADD_SHARED(handle->overrun_bytes, unread);
+        handle->rx_read_total = written;
+        unread = 0;
+    }
+    
+    if (unread > 0) {
+        if (read_pos + unread <= size) {
+            memmove(&handle->rx_buffer[size - unread], &handle->rx_buffer[read_pos], unread);
+        } else {
+            /* Wrapped: the ring reads head part, gap, tail part. Rotating it left by
+             * the head part's length (three reversals, in place) gives gap, tail, head */
+            size_t second = unread - (size - read_pos);
+            rx_reverse(handle->rx_buffer, 0, second);
+            rx_reverse(handle->rx_buffer, second, size);
+            rx_reverse(handle->rx_buffer, 0, size);
+        }
+    }
+    
+    handle->rx_read_pos = (size - unread) & RX_MASK(handle);
+    handle->rx_write_total = written;
+    handle->rx_event_pos = 0;
+    METRIC_INC(handle->errors.rx_restarts);
+    
+    rx_arm(handle);
+}
+
+void UART_DMA_Error_Callback(UART_DMA_Handle_t *handle)
+{
+    uint32_t code = handle->huart->ErrorCode;
+    
+    if (code & HAL_UART_ERROR_ORE) METRIC_INC(handle->errors.ore);
+    if (code & HAL_UART_ERROR_FE)  METRIC_INC(handle->errors.fe);
+    if (code & HAL_UART_ERROR_NE)  METRIC_INC(handle->errors.ne);
+    if (code & HAL_UART_ERROR_PE)  METRIC_INC(handle->errors.pe);
+    if (code & HAL_UART_ERROR_DMA) METRIC_INC(handle->errors.dma);
+    
+    /* Any error during DMA reception is blocking in HAL - RX is now stopped */
+    if (handle->huart->RxState == HAL_UART_STATE_READY) {
+        rx_restart(handle);
+    }
+}
+
+void UART_DMA_GetErrors(UART_DMA_Handle_t *handle, UART_DMA_ErrorStats_t *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = handle->errors;
+    __set_PRIMASK(primask);
+}
+
+#if UART_DMA_LL
+void UART_DMA_GetIrqStats(UART_DMA_Handle_t *handle, UART_DMA_IrqStats_t *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = handle->irq;
+    __set_PRIMASK(primask);
+}
+#endif
+
+void UART_DMA_GetTraffic(UART_DMA_Handle_t *handle, uint32_t *tx, uint32_t *rx)
+{
+    if (tx != NULL) {
+        *tx = handle->tx_total;
+    }
+    if (rx != NULL) {
+        *rx = (uint32_t)handle->rx_read_total;
+    }
+}
+
 void UART_DMA_FlushRx(UART_DMA_Handle_t *handle)
 {
     /* Set read position to current DMA position */
-    handle->rx_read_pos = UART_DMA_GetDMAPos(handle);
+    size_t available = UART_DMA_Available(handle);
+    handle->rx_read_pos = (handle->rx_read_pos + available) & RX_MASK(handle);
+    handle->rx_read_total += available;
 }
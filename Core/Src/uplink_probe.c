@@ -0,0 +1,180 @@
+/**
+ * @file    uplink_probe.c
+ * @brief   Uplink capacity probe after a connect - seeds the bridge's shaper and batching
+ * @version 1.0
+ */
+
+#include "uplink_probe.h"
+
+#if PROBE_ENABLE
+
+#include "mavlink_bridge.h"
+#include "debug_log.h"
+
+#define LOG_FILE_ID     10
+#define LOG_MODULE      LOG_MOD_APP
+
+/* Publish sizes, growing (PROBE_BYTES in all) */
+static const uint16_t probe_sizes[PROBE_COUNT] = { 64, 192, 320, 512 };
+
+static struct {
+    A7600_MQTT_Handle_t *mqtt;
+    const uint8_t *fill;
+    bool active;
+    bool waiting;           /* A publish of ours is out */
+    uint8_t next;           /* Size to send next */
+    uint8_t gen;            /* Probe a report belongs to (one cut short may report late) */
+    uint8_t count;          /* Samples */
+    uint16_t len[PROBE_COUNT];
+    uint16_t ms[PROBE_COUNT];
+    uint32_t start;         /* Probe */
+    uint32_t sent;          /* Publish out */
+    UplinkProbe_Result_t result;
+} probe;
+
+/* ==================== Private Functions ==================== */
+
+/**
+ * @brief Least-squares line through the samples: capacity from the slope, fixed cost from the intercept
+ * @return false below two samples or without a slope
+ */
+static bool probe_fit(uint32_t *bps, uint16_t *overhead_ms)
+{
+    int32_t n = probe.count, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int64_t num, den, icpt;
+    
+    for (uint8_t i = 0; i < probe.count; i++) {
+        sx += probe.len[i];
+        sy += probe.ms[i];
+        sxx += (int32_t)probe.len[i] * probe.len[i];
+        sxy += (int32_t)probe.len[i] * probe.ms[i];
+    }
+    den = (int64_t)n * sxx - (int64_t)sx * sx;      /* Bytes^2 */
+    num = (int64_t)n * sxy - (int64_t)sx * sy;      /* Bytes * ms */
+    if (n < 2 || den <= 0) {
+        return false;
+    }
+    
+    /* A line flat within the tick: faster than the probe can tell */
+    *bps = (num > 0) ? (uint32_t)((den * 1000) / num) : UINT32_MAX;
+    icpt = (sy * den - num * sx) / (n * den);
+    *overhead_ms = (icpt < 0) ? 0 : (icpt > UINT16_MAX) ? UINT16_MAX : (uint16_t)icpt;
+    return true;
+}
+
+/**
+ * @brief Close the probe: fit, seed the bridge, keep the result for the cell
+ */
+static void probe_end(void)
+{
+    const MQTT_LinkQuality_t *lq = A7600_MQTT_GetLinkQuality(probe.mqtt);
+    uint32_t bps;
+    uint16_t overhead_ms;
+    
+    probe.active = false;
+    probe.gen++;
+    if (!probe_fit(&bps, &overhead_ms)) {
+        probe.result.failed++;
+        LOG_WARN("Uplink probe: %u samples, no estimate", (unsigned)probe.count);
+        return;
+    }
+    probe.result.bps = bps;
+    probe.result.overhead_ms = overhead_ms;
+    probe.result.samples = probe.count;
+    probe.result.cell_id = lq->cell_id;
+    probe.result.tick = HAL_GetTick();
+    MavlinkBridge_SeedUplink(bps, overhead_ms);
+    LOG_INFO("Uplink probe: %lu B/s, %u ms a publish (%u samples, %lu ms)", (unsigned long)bps,
+             (unsigned)overhead_ms, (unsigned)probe.count, (unsigned long)(probe.result.tick - probe.start));
+}
+
+/**
+ * @brief One of our publishes was reported
+ */
+static void probe_done(void *ctx, MQTT_Result_t result)
+{
+    if ((uint8_t)(uintptr_t)ctx != probe.gen || !probe.active) {
+        return;     /* Of a probe already closed */
+    }
+    probe.waiting = false;
+    if (result != MQTT_OK) {
+        probe_end();    /* Session lost - what was measured stands */
+        return;
+    }
+    probe.len[probe.count] = probe_sizes[probe.next - 1];
+    probe.ms[probe.count] = (uint16_t)(HAL_GetTick() - probe.sent);
+    probe.count++;
+    if (probe.next == PROBE_COUNT) {
+        probe_end();
+    }
+}
+
+/* ==================== Public Functions ==================== */
+
+void UplinkProbe_Init(A7600_MQTT_Handle_t *mqtt, const uint8_t *fill, size_t fill_len)
+{
+    probe.mqtt = mqtt;
+    probe.fill = (fill_len >= probe_sizes[PROBE_COUNT - 1]) ? fill : NULL;
+    probe.active = false;
+    probe.waiting = false;
+    probe.result.bps = 0;
+    probe.result.cell_id = 0;
+}
+
+void UplinkProbe_Start(void)
+{
+    const MQTT_LinkQuality_t *lq = A7600_MQTT_GetLinkQuality(probe.mqtt);
+    uint32_t now = HAL_GetTick();
+    
+    if (probe.fill == NULL) {
+        return;
+    }
+    if (probe.active) {
+        probe.gen++;    /* A connect again mid-probe: start over */
+    }
+    
+    /* Same cell, measured lately: the link is what it was, and the bridge
+     * has gone on from that seed with what its publishes showed since */
+    if (probe.result.bps != 0 && lq->cell_id != 0 && lq->cell_id == probe.result.cell_id &&
+        now - probe.result.tick < PROBE_TTL) {
+        probe.active = false;
+        probe.result.skipped++;
+        return;
+    }
+    probe.active = true;
+    probe.waiting = false;
+    probe.next = 0;
+    probe.count = 0;
+    probe.start = now;
+    probe.result.probes++;
+}
+
+bool UplinkProbe_Process(void)
+{
+    if (!probe.active) {
+        return false;
+    }
+    if (HAL_GetTick() - probe.start >= PROBE_TIMEOUT) {
+        probe_end();
+        return false;
+    }
+    
+    /* One at a time, on an idle driver - nothing of the bridge's in front */
+    if (!probe.waiting && probe.next < PROBE_COUNT && A7600_MQTT_IsConnected(probe.mqtt) &&
+        !A7600_MQTT_IsBusy(probe.mqtt) && A7600_MQTT_PublishInFlight(probe.mqtt) == 0) {
+        probe.sent = HAL_GetTick();
+        if (A7600_MQTT_PublishAsync(probe.mqtt, PROBE_TOPIC, probe.fill, probe_sizes[probe.next], MQTT_QOS_1,
+                                    probe_done, (void *)(uintptr_t)probe.gen) == MQTT_OK) {
+            probe.next++;
+            probe.waiting = true;
+        }
+    }
+    return probe.active;
+}
+
+const UplinkProbe_Result_t *UplinkProbe_GetResult(void)
+{
+    return &probe.result;
+}
+
+#endif /* PROBE_ENABLE */
@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""Expand tokenized debug log records (debug_log.h, DEBUG_TOKENS).
+
+Usage: log_decode.py [--axf test_a7600/test_a7600.axf] [--src ../Core/Src] [capture]
+
+The string table is rebuilt from the sources the image was built from:
+every LOG_* call of a file with a LOG_FILE_ID gets the token of each line
+it spans (in LOG_*_M calls the format follows the module argument). The
+capture is the raw byte stream of RTT channel 0 or USART1 (stdin if
+omitted); MAVLink frames and cut records between the log records are
+skipped by the sync byte and the checksum. String arguments that pointed
+into flash are read from the .axf; without it they print as their address.
+"""
+
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+
+LOG_SYNC = 0xA5
+
+CALL = re.compile(r'\bLOG_(INFO|WARN|ERROR|RAW)(_M)?\s*\(')
+FILE_ID = re.compile(r'^#define\s+LOG_FILE_ID\s+(\d+)', re.M)
+CONV = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+ESCAPES = {'n': '\n', 'r': '\r', 't': '\t', '0': '\0', '\\': '\\', '"': '"', "'": "'"}
+
+
+def c_literals(text, pos):
+    """Adjacent string literals from pos: (value, end)."""
+    value = ''
+    while True:
+        while pos < len(text) and text[pos].isspace():
+            pos += 1
+        if pos >= len(text) or text[pos] != '"':
+            return value, pos
+        pos += 1
+        while text[pos] != '"':
+            if text[pos] == '\\':
+                pos += 1
+                value += ESCAPES.get(text[pos], text[pos])
+            else:
+                value += text[pos]
+            pos += 1
+        pos += 1
+
+
+def call_end(text, pos, stop=')'):
+    """Index of the parenthesis closing the call whose '(' is just before pos
+    (with stop=',': of the comma ending its first argument)."""
+    depth = 1
+    while True:
+        c = text[pos]
+        if c in '"\'':
+            pos += 1
+            while text[pos] != c:
+                pos += 2 if text[pos] == '\\' else 1
+        elif c == '(':
+            depth += 1
+        elif c == ')':
+            depth -= 1
+            if depth == 0:
+                return pos
+        elif c == stop and depth == 1:
+            return pos
+        pos += 1
+
+
+def build_table(src_dir):
+    """token -> (file, line, level, format)"""
+    table = {}
+    for path in sorted(glob.glob(os.path.join(src_dir, '*.c'))):
+        with open(path, encoding='latin-1') as f:
+            text = f.read()
+        m = FILE_ID.search(text)
+        if m is None:
+            continue
+        file_id = int(m.group(1))
+        for call in CALL.finditer(text):
+            if text.rfind('#define', text.rfind('\n', 0, call.start()), call.start()) >= 0:
+                continue
+            start = call_end(text, call.end(), ',') + 1 if call.group(2) else call.end()
+            fmt, _ = c_literals(text, start)
+            first = text.count('\n', 0, call.start()) + 1
+            last = text.count('\n', 0, call_end(text, call.end())) + 1
+            for line in range(first, last + 1):
+                if line > 0xFFF:
+                    sys.exit('%s:%d: line too large for a token' % (path, line))
+                token = (file_id << 12) | line
+                if token in table and table[token][1] != first:
+                    print('warning: %s:%d shares token 0x%04X' % (path, line, token), file=sys.stderr)
+                table[token] = (os.path.basename(path), first, call.group(1), fmt)
+    return table
+
+
+class Image:
+    """Loadable segments of an ELF32 little-endian image (.axf)."""
+
+    def __init__(self, path):
+        self.segments = []
+        if path is None:
+            return
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF':
+            sys.exit('%s: not an ELF file' % path)
+        phoff, = struct.unpack_from('<I', data, 28)
+        phentsize, phnum = struct.unpack_from('<HH', data, 42)
+        for i in range(phnum):
+            ptype, offset, _, paddr, filesz = struct.unpack_from('<IIIII', data, phoff + i * phentsize)
+            if ptype == 1 and filesz:
+                self.segments.append((paddr, data[offset:offset + filesz]))
+
+    def string(self, addr):
+        for base, blob in self.segments:
+            if base <= addr < base + len(blob):
+                end = blob.find(b'\0', addr - base)
+                return blob[addr - base:end if end >= 0 else len(blob)].decode('latin-1')
+        return None
+
+
+def expand(fmt, args, strings, image):
+    """printf the raw words the way the target would have."""
+    out = []
+    pos = 0
+    argi = iter(range(len(args)))
+
+    def word():
+        i = next(argi, None)
+        return (None, None) if i is None else (args[i], strings.get(i))
+
+    for m in CONV.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        if width == '*':
+            width = str(word()[0])
+        if prec == '*':
+            prec = str(word()[0])
+        value, text = word()
+        if value is None:
+            out.append('<?>')
+            continue
+        spec = '%' + flags + (width or '') + ('.' + prec if prec is not None else '')
+        if conv == 's':
+            if text is None:
+                text = image.string(value)
+            out.append((spec + 's') % (text if text is not None else '<0x%08X>' % value))
+        elif conv == 'c':
+            out.append((spec + 'c') % chr(value & 0xFF))
+        elif conv in 'di':
+            out.append((spec + 'd') % (value - (1 << 32) if value & 0x80000000 else value))
+        elif conv == 'p':
+            out.append('0x%08X' % value)
+        else:
+            out.append((spec + conv) % value)
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+def records(data):
+    """(token, args, strings) per valid record."""
+    i = 0
+    while True:
+        i = data.find(bytes([LOG_SYNC]), i)
+        if i < 0 or i + 6 > len(data):
+            return
+        length = data[i + 3]
+        end = i + 4 + length
+        if end >= len(data) or length < 2 or (sum(data[i + 1:end]) & 0xFF) != data[end]:
+            i += 1
+            continue
+        nargs, mask = data[i + 4], data[i + 5]
+        pos = i + 6 + 4 * nargs
+        if pos > end:
+            i += 1
+            continue
+        args = list(struct.unpack_from('<%dI' % nargs, data, i + 6))
+        strings = {}
+        for a in range(nargs):
+            if mask & (1 << a) and pos < end:
+                n = data[pos]
+                strings[a] = data[pos + 1:pos + 1 + n].decode('latin-1')
+                pos += 1 + n
+        yield struct.unpack_from('<H', data, i + 1)[0], args, strings
+        i = end + 1
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description='Expand tokenized debug log records')
+    parser.add_argument('capture', nargs='?', help='raw RTT channel 0 / USART1 bytes (default: stdin)')
+    parser.add_argument('--axf', help='image, for strings in flash')
+    parser.add_argument('--src', default=os.path.join(here, '..', 'Core', 'Src'), help='source directory')
+    opts = parser.parse_args()
+
+    table = build_table(opts.src)
+    image = Image(opts.axf)
+    if opts.capture:
+        with open(opts.capture, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    for token, args, strings in records(data):
+        entry = table.get(token)
+        if entry is None:
+            print('[?] token 0x%04X %s' % (token, ' '.join('0x%X' % a for a in args)))
+            continue
+        level, fmt = entry[2], entry[3]
+        text = expand(fmt, args, strings, image)
+        if level == 'RAW':
+            sys.stdout.write(text)
+        else:
+            print('[%s] %s' % (level, text.rstrip('\r\n')))
+
+
+if __name__ == '__main__':
+    main()
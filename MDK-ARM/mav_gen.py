@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Generate Core/Inc/mav_msgs.h, the MAVLink metadata of the bridged messages.
+
+Usage: mav_gen.py [--src ../Core/Src/mavlink_bridge.c] [--out ../Core/Inc/mav_msgs.h]
+                  common.xml [ardupilotmega.xml ...]
+
+The subset is the messages mavlink_bridge.c gives a policy to (a
+"#define MSG_POLICY_<NAME>" line each); every one of them must be defined in
+the dialect files given (their <include>s are followed). Per message the
+header gets CRC_EXTRA, the payload length of the base fields (a MAVLink 1
+frame's exact length) and with the extensions (the longest MAVLink 2
+payload), and the wire offset of target_system. Rerun it after adding or
+removing a policy line.
+
+IDs map to table indexes through a multiplicative hash searched here to be
+collision-free over the subset (the smallest power-of-two table that has
+one), so the bridge finds a message with one multiply and one compare.
+"""
+
+import argparse
+import os
+import random
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+POLICY = re.compile(r'^#define\s+MSG_POLICY_(\w+)\s', re.M)
+SIZES = {'char': 1, 'uint8_t': 1, 'int8_t': 1, 'uint16_t': 2, 'int16_t': 2, 'uint32_t': 4,
+         'int32_t': 4, 'float': 4, 'uint64_t': 8, 'int64_t': 8, 'double': 8}
+HASH_BITS_MAX = 10
+HASH_TRIES = 200000
+TGT_NONE = 'MAV_TGT_NONE'
+
+
+def crc_accumulate(crc, data):
+    """X.25 (CRC-16/MCRF4XX), as the frame checksum."""
+    for b in data:
+        tmp = (b ^ crc) & 0xFF
+        tmp = (tmp ^ (tmp << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4)) & 0xFFFF
+    return crc
+
+
+def parse_type(text):
+    """(base type, array length or 0) of a field type attribute."""
+    m = re.match(r'^(\w+?)(?:_mavlink_version)?(?:\[(\d+)\])?$', text)
+    if m is None or m.group(1) not in SIZES:
+        sys.exit('unknown field type %s' % text)
+    return m.group(1), int(m.group(2) or 0)
+
+
+def load(path, messages, seen):
+    """Add the messages of a dialect file and of what it includes."""
+    path = os.path.abspath(path)
+    if path in seen:
+        return
+    seen.add(path)
+    root = ET.parse(path).getroot()
+    for inc in root.findall('include'):
+        load(os.path.join(os.path.dirname(path), inc.text.strip()), messages, seen)
+    for msg in root.iter('message'):
+        fields, ext = [], False
+        for child in msg:
+            if child.tag == 'extensions':
+                ext = True
+            elif child.tag == 'field':
+                kind, count = parse_type(child.get('type'))
+                fields.append((child.get('name'), kind, count, ext))
+        messages[msg.get('name')] = (int(msg.get('id')), fields)
+
+
+def describe(name, msgid, fields):
+    """(msgid, name, crc_extra, min_len, max_len, target) of one message."""
+    base = [f for f in fields if not f[3]]
+    # Wire order: base fields by element size, largest first (stable), then the extensions as declared
+    wire = sorted(base, key=lambda f: -SIZES[f[1]]) + [f for f in fields if f[3]]
+
+    crc = crc_accumulate(0xFFFF, (name + ' ').encode())
+    for fname, kind, count, _ in sorted(base, key=lambda f: -SIZES[f[1]]):
+        crc = crc_accumulate(crc, (kind + ' ' + fname + ' ').encode())
+        if count:
+            crc = crc_accumulate(crc, bytes([count]))
+    extra = (crc & 0xFF) ^ (crc >> 8)
+
+    offsets, pos = {}, 0
+    for fname, kind, count, _ in wire:
+        offsets[fname] = pos
+        pos += SIZES[kind] * max(count, 1)
+    min_len = sum(SIZES[f[1]] * max(f[2], 1) for f in base)
+
+    target = TGT_NONE
+    system = offsets.get('target_system', offsets.get('target'))
+    if system is not None:
+        if offsets.get('target_component') == system + 1:
+            target = str(system)
+        else:
+            target = 'MAV_TGT_SYS_ONLY | %d' % system
+    return msgid, name, extra, min_len, pos, target
+
+
+def find_hash(ids):
+    """(bits, multiplier) of the smallest collision-free table; fixed seed, same result each run."""
+    rng = random.Random(0x4D41564C)
+    bits = max(1, (len(ids) - 1).bit_length())
+    while bits <= HASH_BITS_MAX:
+        for _ in range(HASH_TRIES):
+            mul = rng.getrandbits(32) | 1
+            if len({((i * mul) & 0xFFFFFFFF) >> (32 - bits) for i in ids}) == len(ids):
+                return bits, mul
+        bits += 1
+    sys.exit('no collision-free hash up to %d bits' % HASH_BITS_MAX)
+
+
+def render(rows, bits, mul, dialects):
+    slots = [0] * (1 << bits)
+    for index, row in enumerate(rows):
+        slots[((row[0] * mul) & 0xFFFFFFFF) >> (32 - bits)] = index + 1
+    width = max(len(r[1]) for r in rows) + 1
+
+    out = ['/**',
+           ' * @file    mav_msgs.h',
+           ' * @brief   MAVLink metadata of the bridged messages - generated by MDK-ARM/mav_gen.py, do not edit',
+           ' *',
+           ' * Dialects: %s' % ', '.join(dialects),
+           ' *',
+           ' * The messages mavlink_bridge.c has a MSG_POLICY_<NAME> for, sorted by ID.',
+           ' * X(name, msgid, crc_extra, min_len, max_len, target): min_len is the',
+           ' * payload of the base fields (exactly a MAVLink 1 frame\'s), max_len with',
+           ' * the extensions (a MAVLink 2 payload is at most that, trailing zeros',
+           ' * cut); target is the payload offset of target_system, target_component',
+           ' * after it, or MAV_TGT_NONE.',
+           ' *',
+           ' * MAV_MSGS_HASH maps an ID to a slot of MAV_MSGS_SLOTS holding its table',
+           ' * index + 1 (0: none) - collision-free over the IDs below, so a lookup is',
+           ' * one multiply and one compare of the entry\'s msgid (an ID not in the',
+           ' * table may land on any slot).',
+           ' */',
+           '',
+           '#ifndef MAV_MSGS_H',
+           '#define MAV_MSGS_H',
+           '',
+           '#include <stdint.h>',
+           '',
+           '#define MAV_TGT_NONE            0xFF    /**< Not addressed */',
+           '#define MAV_TGT_SYS_ONLY        0x80    /**< Flag: target_system without a target_component */',
+           '',
+           '#define MAV_MSGS_TABLE(X) \\']
+    for i, (msgid, name, extra, min_len, max_len, target) in enumerate(rows):
+        line = '    X(%s %5d, %3d, %3d, %3d, %s)' % ((name + ',').ljust(width), msgid, extra, min_len, max_len, target)
+        out.append(line + ('' if i == len(rows) - 1 else ' \\'))
+    out += ['',
+            '#define MAV_MSGS_COUNT          %d' % len(rows),
+            '#define MAV_MSGS_HASH_BITS      %d' % bits,
+            '#define MAV_MSGS_HASH_MUL       0x%08XU' % mul,
+            '#define MAV_MSGS_HASH(msgid)    (((uint32_t)(msgid) * MAV_MSGS_HASH_MUL) >> (32 - MAV_MSGS_HASH_BITS))',
+            '',
+            '#define MAV_MSGS_SLOTS { \\']
+    for i in range(0, len(slots), 16):
+        chunk = ', '.join('%2d' % s for s in slots[i:i + 16])
+        out.append('    %s%s \\' % (chunk, ',' if i + 16 < len(slots) else ''))
+    out += ['}',
+            '',
+            '#endif /* MAV_MSGS_H */',
+            '']
+    return '\n'.join(out)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description='Generate the bridged MAVLink message metadata')
+    parser.add_argument('xml', nargs='+', help='dialect files (common.xml, ardupilotmega.xml ...)')
+    parser.add_argument('--src', default=os.path.join(here, '..', 'Core', 'Src', 'mavlink_bridge.c'),
+                        help='bridge source with the MSG_POLICY_ lines')
+    parser.add_argument('--out', default=os.path.join(here, '..', 'Core', 'Inc', 'mav_msgs.h'),
+                        help='header written')
+    opts = parser.parse_args()
+
+    with open(opts.src) as f:
+        subset = POLICY.findall(f.read())
+    messages, seen = {}, set()
+    for path in opts.xml:
+        load(path, messages, seen)
+    missing = [n for n in subset if n not in messages]
+    if missing:
+        sys.exit('not in the dialects: %s' % ', '.join(missing))
+
+    rows = sorted(describe(n, *messages[n]) for n in subset)
+    bits, mul = find_hash([r[0] for r in rows])
+    with open(opts.out, 'w', newline='\n') as f:
+        f.write(render(rows, bits, mul, [os.path.basename(p) for p in opts.xml]))
+    print('%s: %d messages, %d-slot hash' % (opts.out, len(rows), 1 << bits))
+
+
+if __name__ == '__main__':
+    main()
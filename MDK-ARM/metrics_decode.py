@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Expand metrics registry records (metrics.h): RTT capture (METRICS_RTT) or uplink performance records.
+
+Usage: metrics_decode.py [--inc ../Core/Inc] [capture]
+       metrics_decode.py --perf [--inc DIR ...] [records]
+
+Names and types come from METRICS_TABLE in metrics.h, so the sources must
+be the ones the image was built from. The capture is the raw byte stream of
+RTT up channel 1 (stdin if omitted); AT capture records in it are skipped.
+Each registry snapshot prints as one line: tick (ms), then name=value.
+
+--perf reads performance records as published on uav4g/perf, one per line in
+hex with optional leading fields, e.g.
+    mosquitto_sub -t 'uav4g/+/perf' -t uav4g/perf -F '%U %t %x' | metrics_decode.py --perf
+or raw records back to back, and writes CSV: time,topic,tick,schema,name,value,
+one row per value (histogram buckets as name[i]). Each record carries the
+schema hash of the table it was built with: give --inc once per firmware
+release in the fleet and every record is decoded with its own table.
+"""
+
+import argparse
+import csv
+import os
+import re
+import struct
+import sys
+
+RECORD = re.compile(r'X\(\s*(\w+)\s*,\s*"(\w+)"\s*,\s*(METRIC_\w+)\s*,')
+BUCKETS = re.compile(r'^#define\s+BRIDGE_LAT_BUCKETS\s+(\d+)', re.M)
+TYPES = re.compile(r'^#define\s+(METRIC_[A-Z0-9]+)\s+(\d+)\b', re.M)
+HEX = re.compile(r'(?:[0-9A-Fa-f]{2})+')
+WIDTH = {'METRIC_U32': 4, 'METRIC_U16': 2, 'METRIC_U8': 1, 'METRIC_HIST': 4, 'METRIC_I16': 2, 'METRIC_I8': 1}
+SIGNED = ('METRIC_I16', 'METRIC_I8')
+HDR = 7                                     # type, length LE16, tick LE32
+PERF_HDR = 10                               # type, version, schema LE32, tick LE32
+PERF_TYPE = b'P'
+PERF_VERSION = 1
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+
+def build_table(inc_dir):
+    """[(name, width, values, signed)] in id order, and the schema hash (Metrics_Schema)."""
+    with open(os.path.join(inc_dir, 'metrics.h')) as f:
+        text = f.read()
+    with open(os.path.join(inc_dir, 'mavlink_bridge.h')) as f:
+        buckets = int(BUCKETS.search(f.read()).group(1))
+    codes = {kind: int(code) for kind, code in TYPES.findall(text)}
+    body = text[text.index('#define METRICS_TABLE(X)'):]
+    body = body[:body.index('\n\n')]
+    table, schema = [], FNV_OFFSET
+    for _, name, kind in RECORD.findall(body):
+        count = buckets if kind == 'METRIC_HIST' else 1
+        table.append((name, WIDTH[kind], count, kind in SIGNED))
+        for byte in name.encode() + b'\0' + bytes([codes[kind], count]):
+            schema = ((schema ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return table, schema
+
+
+def records(data):
+    """(type, tick, body) of each whole capture record."""
+    pos = 0
+    while pos + HDR <= len(data):
+        kind, length, tick = struct.unpack_from('<cHI', data, pos)
+        if pos + HDR + length > len(data):
+            return
+        yield kind, tick, data[pos + HDR:pos + HDR + length]
+        pos += HDR + length
+
+
+def values(table, ident, body, pos):
+    """(name, [values]) of the metrics in body from id ident at pos on."""
+    while ident < len(table) and pos < len(body):
+        name, width, count, signed = table[ident]
+        yield name, [int.from_bytes(body[pos + i * width:pos + (i + 1) * width], 'little', signed=signed)
+                     for i in range(count)]
+        pos += width * count
+        ident += 1
+
+
+def table_size(table):
+    return sum(width * count for _, width, count, _ in table)
+
+
+def perf_payloads(data):
+    """(fields before the payload, payload) of each hex line - or all of data, raw records back to back."""
+    lines = [line.split() for line in data.decode('ascii', 'replace').splitlines() if line.strip()]
+    if lines and all(HEX.fullmatch(words[-1]) for words in lines):
+        for words in lines:
+            yield words[:-1], bytes.fromhex(words[-1])
+    else:
+        yield [], data
+
+
+def decode_perf(data, tables, out):
+    """CSV rows of every performance record in data."""
+    writer = csv.writer(out, lineterminator='\n')
+    writer.writerow(['time', 'topic', 'tick', 'schema', 'name', 'value'])
+    unknown = set()
+    for fields, payload in perf_payloads(data):
+        pos = 0
+        while pos + PERF_HDR <= len(payload):
+            kind, version, schema, tick = struct.unpack_from('<cBII', payload, pos)
+            if kind != PERF_TYPE or version != PERF_VERSION:
+                sys.stderr.write('not a version %d performance record\n' % PERF_VERSION)
+                break
+            if schema not in tables:
+                if schema not in unknown:
+                    sys.stderr.write('schema %08x: no metrics.h given for it (--inc)\n' % schema)
+                    unknown.add(schema)
+                break
+            table = tables[schema]
+            end = pos + PERF_HDR + 1 + table_size(table)
+            if end > len(payload):
+                sys.stderr.write('record cut short at tick %u\n' % tick)
+                break
+            time = fields[0] if fields else ''
+            topic = ' '.join(fields[1:])
+            for name, vals in values(table, payload[pos + PERF_HDR], payload[:end], pos + PERF_HDR + 1):
+                for i, value in enumerate(vals):
+                    writer.writerow([time, topic, tick, '%08x' % schema,
+                                     name if len(vals) == 1 else '%s[%d]' % (name, i), value])
+            pos = end
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description='Expand metrics registry records')
+    parser.add_argument('capture', nargs='?', help='raw RTT channel 1 bytes, or records with --perf '
+                        '(default: stdin)')
+    parser.add_argument('--inc', action='append', help='header directory (--perf: one per firmware release)')
+    parser.add_argument('--perf', action='store_true', help='performance records (uav4g/perf) to CSV')
+    opts = parser.parse_args()
+
+    incs = opts.inc or [os.path.join(here, '..', 'Core', 'Inc')]
+    if opts.capture:
+        with open(opts.capture, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    if opts.perf:
+        tables = {}
+        for inc in incs:
+            table, schema = build_table(inc)
+            tables[schema] = table
+        decode_perf(data, tables, sys.stdout)
+        return
+
+    table, _ = build_table(incs[-1])
+    line = []
+    for kind, tick, body in records(data):
+        if kind != b'M' or not body:
+            continue
+        if body[0] == 0 and line:
+            print(' '.join(line))
+            line = []
+        if not line:
+            line.append('%10u' % tick)
+        for name, vals in values(table, body[0], body, 1):
+            line.append('%s=%s' % (name, vals[0] if len(vals) == 1 else ','.join(map(str, vals))))
+    if line:
+        print(' '.join(line))
+
+
+if __name__ == '__main__':
+    main()
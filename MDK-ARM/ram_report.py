@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Static RAM per module from a Keil linker map.
+
+Usage: ram_report.py [test_a7600/test_a7600.map]
+
+Reads the "Image component sizes" tables (objects, then library members)
+and lists RW + ZI data per object, largest first, against the IRAM1 size
+of the target (top of RAM is kept for the no-init records). The stack and
+heap are the ZI of the startup object.
+
+Code placed in SRAM (the .ramfunc section, Core/Inc/ramfunc.h) is part of
+the Code column, not RW; it is read from the image symbol table and listed
+per function, and counts against the same IRAM1 size.
+"""
+
+import re
+import sys
+
+IRAM_SIZE = 0x1EA0      # test_a7600.uvprojx IRAM1 size
+
+ROW = re.compile(r'^\s*(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\S.*?)\s*$')
+RAMFUNC = re.compile(r'^\s*(\S+)\s+0x2[0-9a-fA-F]{7}\s+Thumb Code\s+(\d+)\s+(\S+)\(\.ramfunc\)')
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else 'test_a7600/test_a7600.map'
+    with open(path, encoding='latin-1') as f:
+        text = f.read()
+    start = text.find('Image component sizes')
+    if start < 0:
+        sys.exit('%s: no "Image component sizes" section' % path)
+
+    modules = []
+    for line in text[start:].splitlines():
+        if 'Library Name' in line:
+            break       # Per-library sums of the members already listed
+        m = ROW.match(line)
+        if m is None:
+            continue
+        name = m.group(7)
+        if 'Totals' in name or name.startswith('('):
+            continue
+        rw, zi = int(m.group(4)), int(m.group(5))
+        if rw + zi:
+            modules.append((rw + zi, rw, zi, name))
+
+    modules.sort(reverse=True)
+    total = sum(m[0] for m in modules)
+    print('%8s %8s %8s  %s' % ('RAM', 'RW', 'ZI', 'Object'))
+    for ram, rw, zi, name in modules:
+        print('%8d %8d %8d  %s' % (ram, rw, zi, name))
+
+    # Symbol table: local and global symbols, each listed once
+    funcs = sorted(((int(m.group(2)), m.group(1), m.group(3))
+                    for m in map(RAMFUNC.match, text[:start].splitlines()) if m), reverse=True)
+    if funcs:
+        code = sum(f[0] for f in funcs)
+        print()
+        print('%8s  %s' % ('Code', 'Function in SRAM (.ramfunc)'))
+        for size, name, obj in funcs:
+            print('%8d  %s (%s)' % (size, name, obj))
+        print('%8d in %d functions' % (code, len(funcs)))
+        total += code
+    print('%8d of %d bytes, %d free' % (total, IRAM_SIZE, IRAM_SIZE - total))
+
+
+if __name__ == '__main__':
+    main()
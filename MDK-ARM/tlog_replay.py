@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Replay a recorded flight (.tlog) into the board's USART1 (FC input).
+
+Usage: tlog_replay.py [--speed 1] [--baud 115200] PORT flight.tlog
+
+A .tlog holds each frame as received behind an 8-byte big-endian UNIX time
+in microseconds. The frames are written to PORT (a USB-UART on PA10 in
+place of the FC) at their recorded times, scaled by --speed (0: back to
+back). Build the bench_bridge target with BENCH_LOOPBACK_EXTERNAL 1 and send
+"bench 0" first: the generator stops, and the bench report on the status
+topic then covers the replayed stream (forwarded, losses by stage,
+latency). The same capture runs on the host with `make -C Bench replay`.
+Needs pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+
+def frames(data):
+    """(us, frame) per record; bytes that start no frame are skipped."""
+    pos = 0
+    while pos + 10 < len(data):
+        start = data[pos + 8]
+        if start == 0xFD:
+            n = 10 + data[pos + 9] + 2 + (13 if data[pos + 10] & 0x01 else 0)
+        elif start == 0xFE:
+            n = 6 + data[pos + 9] + 2
+        else:
+            pos += 1
+            continue
+        if pos + 8 + n > len(data):
+            return
+        yield struct.unpack_from('>Q', data, pos)[0], data[pos + 8:pos + 8 + n]
+        pos += 8 + n
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay a .tlog into USART1')
+    parser.add_argument('port', help='serial port wired to PA10 (USART1 RX)')
+    parser.add_argument('tlog', help='recorded flight')
+    parser.add_argument('--baud', type=int, default=115200, help='USART1 rate (main.c)')
+    parser.add_argument('--speed', type=float, default=1.0, help='time scale, 0: as fast as the UART goes')
+    opts = parser.parse_args()
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit('pyserial is needed: pip install pyserial')
+
+    with open(opts.tlog, 'rb') as f:
+        data = f.read()
+    port = serial.Serial(opts.port, opts.baud)
+    first = None
+    start = time.monotonic()
+    count = 0
+    total = 0
+    for us, frame in frames(data):
+        if first is None:
+            first = us
+        if opts.speed > 0:
+            wait = start + max(us - first, 0) / 1e6 / opts.speed - time.monotonic()
+            if wait > 0:
+                time.sleep(wait)
+        port.write(frame)
+        count += 1
+        total += len(frame)
+    port.flush()
+    print('%d frames, %d bytes in %.1f s' % (count, total, time.monotonic() - start))
+
+
+if __name__ == '__main__':
+    main()